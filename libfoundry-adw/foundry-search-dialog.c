@@ -24,6 +24,7 @@
 #include "foundry-util.h"
 
 #define DELAY_MSEC 100
+#define DEADLINE_MSEC 5000
 
 struct _FoundrySearchDialog
 {
@@ -37,6 +38,8 @@ struct _FoundrySearchDialog
   GtkSingleSelection *selection;
   GtkText            *text;
 
+  DexCancellable     *cancellable;
+
   guint               update_source;
   guint               stamp;
 };
@@ -56,6 +59,7 @@ static DexFuture *
 foundry_search_dialog_update_fiber (FoundrySearchDialog  *self,
                                     FoundrySearchManager *search_manager,
                                     FoundrySearchRequest *request,
+                                    DexCancellable       *cancellable,
                                     guint                 stamp)
 {
   g_autoptr(GListModel) results = NULL;
@@ -64,11 +68,12 @@ foundry_search_dialog_update_fiber (FoundrySearchDialog  *self,
   g_assert (FOUNDRY_IS_SEARCH_DIALOG (self));
   g_assert (FOUNDRY_IS_SEARCH_MANAGER (search_manager));
   g_assert (FOUNDRY_IS_SEARCH_REQUEST (request));
+  g_assert (DEX_IS_CANCELLABLE (cancellable));
 
   if (self->stamp != stamp)
     return dex_future_new_true ();
 
-  if (!(results = dex_await_object (foundry_search_manager_search (search_manager, request), &error)))
+  if (!(results = dex_await_object (foundry_search_manager_search_full (search_manager, request, cancellable, DEADLINE_MSEC, FALSE), &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
   if (self->stamp != stamp)
@@ -120,6 +125,11 @@ foundry_search_dialog_do_update (gpointer data)
 
   g_clear_handle_id (&self->update_source, g_source_remove);
 
+  /* Stop waiting on providers for the previous search text */
+  if (self->cancellable != NULL)
+    dex_cancellable_cancel (self->cancellable);
+  dex_clear (&self->cancellable);
+
   if (self->context == NULL)
     return G_SOURCE_REMOVE;
 
@@ -136,12 +146,15 @@ foundry_search_dialog_do_update (gpointer data)
 
       /* TODO: Use the first character to set the categories */
 
+      self->cancellable = dex_cancellable_new ();
+
       future = FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
                                         foundry_search_dialog_update_fiber,
-                                        4,
+                                        5,
                                         FOUNDRY_TYPE_SEARCH_DIALOG, self,
                                         FOUNDRY_TYPE_SEARCH_MANAGER, search_manager,
                                         FOUNDRY_TYPE_SEARCH_REQUEST, request,
+                                        DEX_TYPE_FUTURE, self->cancellable,
                                         G_TYPE_UINT, self->stamp);
 
       dex_future_disown (future);
@@ -240,6 +253,10 @@ foundry_search_dialog_dispose (GObject *object)
   g_clear_handle_id (&self->update_source, g_source_remove);
   g_clear_object (&self->context);
 
+  if (self->cancellable != NULL)
+    dex_cancellable_cancel (self->cancellable);
+  dex_clear (&self->cancellable);
+
   G_OBJECT_CLASS (foundry_search_dialog_parent_class)->dispose (object);
 }
 
@@ -0,0 +1,43 @@
+/* foundry-acp-file-cache-private.h
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <libdex.h>
+
+#include "foundry-context.h"
+
+G_BEGIN_DECLS
+
+#define FOUNDRY_TYPE_ACP_FILE_CACHE (foundry_acp_file_cache_get_type())
+
+G_DECLARE_FINAL_TYPE (FoundryAcpFileCache, foundry_acp_file_cache, FOUNDRY, ACP_FILE_CACHE, GObject)
+
+FoundryAcpFileCache *foundry_acp_file_cache_new          (FoundryContext      *context);
+FoundryAcpFileCache *foundry_acp_file_cache_from_context (FoundryContext      *context);
+DexFuture           *foundry_acp_file_cache_read         (FoundryAcpFileCache *self,
+                                                          GFile               *file,
+                                                          guint                line,
+                                                          guint                limit) G_GNUC_WARN_UNUSED_RESULT;
+void                 foundry_acp_file_cache_invalidate   (FoundryAcpFileCache *self,
+                                                          GFile               *file);
+guint                foundry_acp_file_cache_get_size     (FoundryAcpFileCache *self);
+
+G_END_DECLS
@@ -0,0 +1,722 @@
+/* foundry-acp-file-cache.c
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "foundry-acp-file-cache-private.h"
+#include "foundry-debug.h"
+#include "foundry-file-monitor.h"
+#include "foundry-file-monitor-event.h"
+#include "foundry-util.h"
+
+#ifdef FOUNDRY_FEATURE_TEXT
+# include "foundry-text-buffer.h"
+# include "foundry-text-document.h"
+# include "foundry-text-manager-private.h"
+#endif
+
+/* Agents tend to page through a handful of files at a time, so we only
+ * need to keep enough around to cover the working set.
+ */
+#define MAX_ENTRIES 32
+
+/* Files up to this size are copied into memory. Larger files are read
+ * on demand with pread() instead of being mapped, as a mapping faults
+ * with SIGBUS if another process truncates the file while we read it.
+ * Opening, indexing and reading happen on the thread pool.
+ */
+#define SMALL_FILE_SIZE (256 * 1024)
+#define SCAN_SIZE       (64 * 1024)
+#define CACHE_KEY   "FOUNDRY_ACP_FILE_CACHE"
+#define ATTRIBUTES  G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+                    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+                    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC
+
+struct _FoundryAcpFileCache
+{
+  GObject     parent_instance;
+  GWeakRef    context_wr;
+  GHashTable *files;
+  GHashTable *monitors;
+};
+
+typedef struct _CachedFile
+{
+  /* Either the contents or a path to open and read from on demand.
+   * The FD and line index are used from the thread pool and guarded
+   * by @mutex, everything else belongs to the main thread.
+   */
+  GMutex    mutex;
+  GBytes   *bytes;
+  char     *path;
+  int       fd;
+  gsize     len;
+  GArray   *lines;
+  gsize     scanned;
+  gint64    mtime_usec;
+  goffset   size;
+  GWeakRef  buffer_wr;
+  gint64    change_count;
+  gint64    last_access;
+  guint     from_buffer : 1;
+} CachedFile;
+
+typedef struct _ReadRange
+{
+  CachedFile *cf;
+  guint       line;
+  guint       limit;
+} ReadRange;
+
+typedef struct _Watch
+{
+  GWeakRef           *self_wr;
+  FoundryFileMonitor *monitor;
+} Watch;
+
+G_DEFINE_FINAL_TYPE (FoundryAcpFileCache, foundry_acp_file_cache, G_TYPE_OBJECT)
+
+static CachedFile *
+cached_file_new (GBytes     *bytes,
+                 const char *path,
+                 gsize       len)
+{
+  CachedFile *cf;
+  gsize zero = 0;
+
+  cf = g_atomic_rc_box_new0 (CachedFile);
+  g_mutex_init (&cf->mutex);
+  cf->bytes = bytes ? g_bytes_ref (bytes) : NULL;
+  cf->path = g_strdup (path);
+  cf->fd = -1;
+  cf->len = bytes ? g_bytes_get_size (bytes) : len;
+  cf->lines = g_array_new (FALSE, FALSE, sizeof (gsize));
+  g_array_append_val (cf->lines, zero);
+  g_weak_ref_init (&cf->buffer_wr, NULL);
+
+  return cf;
+}
+
+static void
+cached_file_finalize (gpointer data)
+{
+  CachedFile *cf = data;
+
+  g_clear_pointer (&cf->bytes, g_bytes_unref);
+  g_clear_pointer (&cf->path, g_free);
+  g_clear_pointer (&cf->lines, g_array_unref);
+  g_clear_fd (&cf->fd, NULL);
+  g_weak_ref_clear (&cf->buffer_wr);
+  g_mutex_clear (&cf->mutex);
+}
+
+static CachedFile *
+cached_file_ref (CachedFile *cf)
+{
+  return g_atomic_rc_box_acquire (cf);
+}
+
+static void
+cached_file_unref (CachedFile *cf)
+{
+  g_atomic_rc_box_release_full (cf, cached_file_finalize);
+}
+
+/* Reads up to @len bytes at @offset, returning fewer if the file was
+ * truncated since it was opened.
+ */
+static gsize
+cached_file_pread (CachedFile *cf,
+                   char       *buf,
+                   gsize       len,
+                   gsize       offset)
+{
+  gsize n_read = 0;
+
+  while (n_read < len)
+    {
+      gssize n = pread (cf->fd, buf + n_read, len - n_read, offset + n_read);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        break;
+
+      n_read += n;
+    }
+
+  return n_read;
+}
+
+/*
+ * cached_file_get_line_offset:
+ *
+ * Returns the byte offset at which @line (1-based) begins, or the length
+ * of the contents if the file has fewer lines.
+ *
+ * The index is only extended (a block at a time) as far as the furthest
+ * line requested so far, so reading the top of a large file never scans
+ * the remainder. Must be called with the mutex held.
+ */
+static gsize
+cached_file_get_line_offset (CachedFile *cf,
+                             guint64     line)
+{
+  g_autofree char *buf = NULL;
+
+  if (line <= 1)
+    return 0;
+
+  while (cf->lines->len < line && cf->scanned < cf->len)
+    {
+      const char *block;
+      const char *nl;
+      gsize n;
+
+      n = MIN (SCAN_SIZE, cf->len - cf->scanned);
+
+      if (cf->bytes != NULL)
+        {
+          block = (const char *)g_bytes_get_data (cf->bytes, NULL) + cf->scanned;
+        }
+      else
+        {
+          if (buf == NULL)
+            buf = g_malloc (SCAN_SIZE);
+
+          /* Stop at whatever is left of a truncated file */
+          if ((n = cached_file_pread (cf, buf, n, cf->scanned)) == 0)
+            {
+              cf->len = cf->scanned;
+              break;
+            }
+
+          block = buf;
+        }
+
+      for (const char *p = block; (nl = memchr (p, '\n', block + n - p)); p = nl + 1)
+        {
+          gsize offset = cf->scanned + (nl - block) + 1;
+          g_array_append_val (cf->lines, offset);
+        }
+
+      cf->scanned += n;
+    }
+
+  if (line - 1 < cf->lines->len)
+    return MIN (g_array_index (cf->lines, gsize, line - 1), cf->len);
+
+  return cf->len;
+}
+
+static GBytes *
+cached_file_dup_range (CachedFile *cf,
+                       gsize       begin,
+                       gsize       end)
+{
+  char *buf;
+  gsize n;
+
+  g_assert (begin <= end);
+  g_assert (end <= cf->len);
+
+  if (begin == end)
+    return g_bytes_new (NULL, 0);
+
+  if (cf->bytes != NULL)
+    return g_bytes_new_from_bytes (cf->bytes, begin, end - begin);
+
+  buf = g_malloc (end - begin);
+  n = cached_file_pread (cf, buf, end - begin, begin);
+
+  return g_bytes_new_take (g_realloc (buf, n), n);
+}
+
+static void
+watch_free (Watch *watch)
+{
+  g_clear_pointer (&watch->self_wr, foundry_weak_ref_free);
+  g_clear_object (&watch->monitor);
+  g_free (watch);
+}
+
+static void
+monitor_free (gpointer data)
+{
+  FoundryFileMonitor *monitor = data;
+
+  foundry_file_monitor_cancel (monitor);
+  g_object_unref (monitor);
+}
+
+static void
+foundry_acp_file_cache_remove (FoundryAcpFileCache *self,
+                               GFile               *file)
+{
+  g_autoptr(GFile) directory = NULL;
+  GHashTableIter iter;
+  GFile *key;
+
+  if (!g_hash_table_remove (self->files, file))
+    return;
+
+  if (!(directory = g_file_get_parent (file)))
+    return;
+
+  /* Drop the directory monitor once nothing in it is cached */
+  g_hash_table_iter_init (&iter, self->files);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, NULL))
+    {
+      if (g_file_has_parent (key, directory))
+        return;
+    }
+
+  g_hash_table_remove (self->monitors, directory);
+}
+
+static DexFuture *
+foundry_acp_file_cache_monitor_fiber (gpointer data)
+{
+  Watch *watch = data;
+  gpointer ptr;
+
+  g_assert (watch != NULL);
+  g_assert (FOUNDRY_IS_FILE_MONITOR (watch->monitor));
+
+  while ((ptr = dex_await_object (foundry_file_monitor_next (watch->monitor), NULL)))
+    {
+      g_autoptr(FoundryFileMonitorEvent) event = ptr;
+      g_autoptr(FoundryAcpFileCache) self = g_weak_ref_get (watch->self_wr);
+      g_autoptr(GFile) file = NULL;
+      g_autoptr(GFile) other_file = NULL;
+
+      if (self == NULL)
+        break;
+
+      if ((file = foundry_file_monitor_event_dup_file (event)))
+        foundry_acp_file_cache_remove (self, file);
+
+      if ((other_file = foundry_file_monitor_event_dup_other_file (event)))
+        foundry_acp_file_cache_remove (self, other_file);
+    }
+
+  return dex_future_new_true ();
+}
+
+static void
+foundry_acp_file_cache_watch (FoundryAcpFileCache *self,
+                              GFile               *file)
+{
+  g_autoptr(FoundryFileMonitor) monitor = NULL;
+  g_autoptr(GFile) directory = NULL;
+  Watch *watch;
+
+  if (!(directory = g_file_get_parent (file)) ||
+      g_hash_table_contains (self->monitors, directory))
+    return;
+
+  /* Without a monitor we still notice changes from the mtime check */
+  if (!(monitor = foundry_file_monitor_new (directory, NULL)))
+    return;
+
+  g_hash_table_replace (self->monitors,
+                        g_steal_pointer (&directory),
+                        g_object_ref (monitor));
+
+  watch = g_new0 (Watch, 1);
+  watch->self_wr = foundry_weak_ref_new (self);
+  watch->monitor = g_steal_pointer (&monitor);
+
+  dex_future_disown (dex_scheduler_spawn (NULL, 0,
+                                          foundry_acp_file_cache_monitor_fiber,
+                                          watch,
+                                          (GDestroyNotify) watch_free));
+}
+
+static CachedFile *
+foundry_acp_file_cache_insert (FoundryAcpFileCache *self,
+                               GFile               *file,
+                               CachedFile          *cf)
+{
+  g_hash_table_remove (self->files, file);
+
+  if (g_hash_table_size (self->files) >= MAX_ENTRIES)
+    {
+      GHashTableIter iter;
+      GFile *oldest = NULL;
+      gint64 oldest_access = G_MAXINT64;
+      GFile *key;
+      CachedFile *value;
+
+      g_hash_table_iter_init (&iter, self->files);
+      while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+        {
+          if (value->last_access < oldest_access)
+            {
+              oldest = key;
+              oldest_access = value->last_access;
+            }
+        }
+
+      if (oldest != NULL)
+        {
+          g_autoptr(GFile) evict = g_object_ref (oldest);
+
+          foundry_acp_file_cache_remove (self, evict);
+        }
+    }
+
+  g_hash_table_replace (self->files, g_object_ref (file), cf);
+
+  return cf;
+}
+
+static CachedFile *
+load_file (GFile    *file,
+           goffset   size,
+           GError  **error)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  g_autofree char *path = NULL;
+
+  /* Large files are indexed and read on demand, so only the ranges an
+   * agent asks for are ever read, which is what keeps reads O(range).
+   * The file is opened by the first read on the thread pool.
+   */
+  if (size > SMALL_FILE_SIZE && (path = g_file_get_path (file)))
+    return cached_file_new (NULL, path, size);
+
+  if (!(bytes = dex_await_boxed (dex_file_load_contents_bytes (file), error)))
+    return NULL;
+
+  return cached_file_new (bytes, NULL, 0);
+}
+
+static void
+read_range_free (ReadRange *state)
+{
+  g_clear_pointer (&state->cf, cached_file_unref);
+  g_free (state);
+}
+
+static DexFuture *
+foundry_acp_file_cache_read_range_fiber (gpointer data)
+{
+  ReadRange *state = data;
+  CachedFile *cf = state->cf;
+  g_autoptr(GMutexLocker) locker = NULL;
+  gsize begin;
+  gsize end;
+
+  g_assert (state != NULL);
+  g_assert (cf != NULL);
+
+  locker = g_mutex_locker_new (&cf->mutex);
+
+  if (cf->bytes == NULL && cf->fd == -1)
+    {
+      if (-1 == (cf->fd = g_open (cf->path, O_RDONLY | O_CLOEXEC, 0)))
+        return dex_future_new_for_errno (errno);
+    }
+
+  begin = cached_file_get_line_offset (cf, state->line);
+  end = state->limit > 0 ? cached_file_get_line_offset (cf, (guint64)MAX (state->line, 1) + state->limit) : cf->len;
+
+  /* Scanning may have found the file truncated and shortened it */
+  begin = MIN (begin, cf->len);
+  end = MIN (end, cf->len);
+
+  return dex_future_new_take_boxed (G_TYPE_BYTES, cached_file_dup_range (cf, begin, end));
+}
+
+#ifdef FOUNDRY_FEATURE_TEXT
+static FoundryTextBuffer *
+foundry_acp_file_cache_dup_open_buffer (FoundryAcpFileCache *self,
+                                        GFile               *file)
+{
+  g_autoptr(FoundryTextDocument) document = NULL;
+  g_autoptr(FoundryTextManager) text_manager = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+
+  if (!(context = g_weak_ref_get (&self->context_wr)) ||
+      !(text_manager = foundry_context_dup_text_manager (context)) ||
+      !(document = _foundry_text_manager_dup_document (text_manager, file)))
+    return NULL;
+
+  return foundry_text_document_dup_buffer (document);
+}
+#endif
+
+static DexFuture *
+foundry_acp_file_cache_read_fiber (FoundryAcpFileCache *self,
+                                   GFile               *file,
+                                   guint                line,
+                                   guint                limit)
+{
+  CachedFile *cf = NULL;
+  ReadRange *state;
+
+  g_assert (FOUNDRY_IS_ACP_FILE_CACHE (self));
+  g_assert (G_IS_FILE (file));
+
+#ifdef FOUNDRY_FEATURE_TEXT
+  {
+    g_autoptr(FoundryTextBuffer) buffer = NULL;
+
+    /* Serve unsaved edits when the file is open in the editor */
+    if ((buffer = foundry_acp_file_cache_dup_open_buffer (self, file)))
+      {
+        gint64 change_count = foundry_text_buffer_get_change_count (buffer);
+        g_autoptr(FoundryTextBuffer) cached = NULL;
+
+        /* A weak ref so that a new buffer reusing the address of a
+         * closed one is never mistaken for it.
+         */
+        if ((cf = g_hash_table_lookup (self->files, file)))
+          cached = g_weak_ref_get (&cf->buffer_wr);
+
+        if (cf == NULL || cached != buffer || cf->change_count != change_count)
+          {
+            g_autoptr(GBytes) bytes = foundry_text_buffer_dup_contents (buffer);
+
+            cf = foundry_acp_file_cache_insert (self, file, cached_file_new (bytes, NULL, 0));
+            g_weak_ref_set (&cf->buffer_wr, buffer);
+            cf->change_count = change_count;
+            cf->from_buffer = TRUE;
+          }
+      }
+  }
+#endif
+
+  if (cf == NULL)
+    {
+      g_autoptr(GFileInfo) info = NULL;
+      g_autoptr(GDateTime) mtime = NULL;
+      g_autoptr(GError) error = NULL;
+      gint64 mtime_usec = 0;
+      goffset size;
+
+      if (!(info = dex_await_object (dex_file_query_info (file, ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT), &error)))
+        {
+          foundry_acp_file_cache_remove (self, file);
+          return dex_future_new_for_error (g_steal_pointer (&error));
+        }
+
+      if ((mtime = g_file_info_get_modification_date_time (info)))
+        mtime_usec = g_date_time_to_unix_usec (mtime);
+
+      size = g_file_info_get_size (info);
+
+      /* The monitor may not have delivered yet, so also compare against
+       * what we saw when the file was loaded.
+       */
+      cf = g_hash_table_lookup (self->files, file);
+
+      if (cf == NULL || cf->from_buffer || cf->mtime_usec != mtime_usec || cf->size != size)
+        {
+          CachedFile *loaded;
+
+          if (!(loaded = load_file (file, size, &error)))
+            {
+              foundry_acp_file_cache_remove (self, file);
+              return dex_future_new_for_error (g_steal_pointer (&error));
+            }
+
+          cf = foundry_acp_file_cache_insert (self, file, loaded);
+          cf->mtime_usec = mtime_usec;
+          cf->size = size;
+
+          foundry_acp_file_cache_watch (self, file);
+        }
+    }
+
+  cf->last_access = g_get_monotonic_time ();
+
+  /* Indexing and reading large files block, so keep them off of the
+   * main thread. The entry is kept alive even if it is evicted meanwhile.
+   */
+  state = g_new0 (ReadRange, 1);
+  state->cf = cached_file_ref (cf);
+  state->line = line;
+  state->limit = limit;
+
+  return dex_scheduler_spawn (dex_thread_pool_scheduler_get_default (), 0,
+                              foundry_acp_file_cache_read_range_fiber,
+                              state,
+                              (GDestroyNotify) read_range_free);
+}
+
+static void
+foundry_acp_file_cache_dispose (GObject *object)
+{
+  FoundryAcpFileCache *self = (FoundryAcpFileCache *)object;
+
+  g_hash_table_remove_all (self->monitors);
+  g_hash_table_remove_all (self->files);
+
+  G_OBJECT_CLASS (foundry_acp_file_cache_parent_class)->dispose (object);
+}
+
+static void
+foundry_acp_file_cache_finalize (GObject *object)
+{
+  FoundryAcpFileCache *self = (FoundryAcpFileCache *)object;
+
+  g_weak_ref_clear (&self->context_wr);
+  g_clear_pointer (&self->files, g_hash_table_unref);
+  g_clear_pointer (&self->monitors, g_hash_table_unref);
+
+  G_OBJECT_CLASS (foundry_acp_file_cache_parent_class)->finalize (object);
+}
+
+static void
+foundry_acp_file_cache_class_init (FoundryAcpFileCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = foundry_acp_file_cache_dispose;
+  object_class->finalize = foundry_acp_file_cache_finalize;
+}
+
+static void
+foundry_acp_file_cache_init (FoundryAcpFileCache *self)
+{
+  g_weak_ref_init (&self->context_wr, NULL);
+  self->files = g_hash_table_new_full ((GHashFunc) g_file_hash,
+                                       (GEqualFunc) g_file_equal,
+                                       g_object_unref,
+                                       (GDestroyNotify) cached_file_unref);
+  self->monitors = g_hash_table_new_full ((GHashFunc) g_file_hash,
+                                          (GEqualFunc) g_file_equal,
+                                          g_object_unref,
+                                          monitor_free);
+}
+
+/**
+ * foundry_acp_file_cache_new:
+ * @context: (nullable): a [class@Foundry.Context]
+ *
+ * Creates a new cache of file contents. If @context is set, open
+ * documents from its text manager are preferred over the file on disk.
+ *
+ * Returns: (transfer full):
+ */
+FoundryAcpFileCache *
+foundry_acp_file_cache_new (FoundryContext *context)
+{
+  FoundryAcpFileCache *self;
+
+  g_return_val_if_fail (!context || FOUNDRY_IS_CONTEXT (context), NULL);
+
+  self = g_object_new (FOUNDRY_TYPE_ACP_FILE_CACHE, NULL);
+  g_weak_ref_set (&self->context_wr, context);
+
+  return self;
+}
+
+/**
+ * foundry_acp_file_cache_from_context:
+ * @context: a [class@Foundry.Context]
+ *
+ * Gets the cache shared by all ACP clients of @context.
+ *
+ * Returns: (transfer full):
+ */
+FoundryAcpFileCache *
+foundry_acp_file_cache_from_context (FoundryContext *context)
+{
+  FoundryAcpFileCache *self;
+
+  g_return_val_if_fail (FOUNDRY_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (FOUNDRY_IS_CONTEXT (context), NULL);
+
+  if (!(self = g_object_get_data (G_OBJECT (context), CACHE_KEY)))
+    {
+      self = foundry_acp_file_cache_new (context);
+      g_object_set_data_full (G_OBJECT (context), CACHE_KEY, self, g_object_unref);
+    }
+
+  return g_object_ref (self);
+}
+
+/**
+ * foundry_acp_file_cache_read:
+ * @self: a [class@Foundry.AcpFileCache]
+ * @file: the file to read
+ * @line: the 1-based line to start from, or 0 for the beginning
+ * @limit: the maximum number of lines, or 0 for the rest of the file
+ *
+ * Reads a range of lines from @file. The contents are not validated
+ * as UTF-8.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to a
+ *   [struct@GLib.Bytes] or rejects with error.
+ */
+DexFuture *
+foundry_acp_file_cache_read (FoundryAcpFileCache *self,
+                             GFile               *file,
+                             guint                line,
+                             guint                limit)
+{
+  dex_return_error_if_fail (FOUNDRY_IS_ACP_FILE_CACHE (self));
+  dex_return_error_if_fail (G_IS_FILE (file));
+
+  return foundry_scheduler_spawn (NULL, 0,
+                                  G_CALLBACK (foundry_acp_file_cache_read_fiber),
+                                  4,
+                                  FOUNDRY_TYPE_ACP_FILE_CACHE, self,
+                                  G_TYPE_FILE, file,
+                                  G_TYPE_UINT, line,
+                                  G_TYPE_UINT, limit);
+}
+
+/**
+ * foundry_acp_file_cache_invalidate:
+ * @self: a [class@Foundry.AcpFileCache]
+ * @file: the file that changed
+ *
+ * Drops any cached contents for @file. Use this after writing to
+ * @file rather than waiting for the directory monitor.
+ */
+void
+foundry_acp_file_cache_invalidate (FoundryAcpFileCache *self,
+                                   GFile               *file)
+{
+  g_return_if_fail (FOUNDRY_IS_ACP_FILE_CACHE (self));
+  g_return_if_fail (G_IS_FILE (file));
+
+  foundry_acp_file_cache_remove (self, file);
+}
+
+guint
+foundry_acp_file_cache_get_size (FoundryAcpFileCache *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_ACP_FILE_CACHE (self), 0);
+
+  return g_hash_table_size (self->files);
+}
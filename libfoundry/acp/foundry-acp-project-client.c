@@ -22,6 +22,7 @@
 
 #include "foundry-acp-client.h"
 #include "foundry-acp-enums.h"
+#include "foundry-acp-file-cache-private.h"
 #include "foundry-acp-permission-policy.h"
 #include "foundry-acp-project-client.h"
 #include "foundry-acp-session.h"
@@ -45,6 +46,7 @@ struct _FoundryAcpProjectClient
   FoundryContext *context;
   GFile *project_directory;
   FoundryAcpPermissionPolicy *permission_policy;
+  FoundryAcpFileCache *file_cache;
   FoundryVcsManager *vcs_manager;
   GHashTable *terminals;
   GHashTable *file_snapshot;
@@ -152,6 +154,7 @@ foundry_acp_project_client_finalize (GObject *object)
   g_clear_object (&self->context);
   g_clear_object (&self->project_directory);
   g_clear_object (&self->permission_policy);
+  g_clear_object (&self->file_cache);
   g_clear_object (&self->vcs_manager);
   g_clear_pointer (&self->terminals, g_hash_table_unref);
   g_clear_pointer (&self->file_snapshot, g_hash_table_unref);
@@ -635,46 +638,6 @@ foundry_acp_project_client_dup_file_for_path (FoundryAcpProjectClient  *self,
   return g_steal_pointer (&file);
 }
 
-static char *
-slice_lines (const char *content,
-             guint       line,
-             guint       limit)
-{
-  const char *begin = content;
-  const char *end = content + strlen (content);
-  const char *iter = content;
-  guint current_line = 1;
-  guint lines_seen = 0;
-
-  g_assert (content != NULL);
-
-  if (line > 1)
-    {
-      while (*iter != '\0' && current_line < line)
-        {
-          if (*iter++ == '\n')
-            current_line++;
-        }
-
-      begin = iter;
-    }
-
-  if (limit > 0)
-    {
-      iter = begin;
-
-      while (*iter != '\0' && lines_seen < limit)
-        {
-          if (*iter++ == '\n')
-            lines_seen++;
-        }
-
-      end = iter;
-    }
-
-  return g_strndup (begin, end - begin);
-}
-
 static DexFuture *
 project_client_read_text_file_fiber (FoundryAcpProjectClient *self,
                                      FoundryAcpSession       *session,
@@ -685,7 +648,6 @@ project_client_read_text_file_fiber (FoundryAcpProjectClient *self,
   g_autoptr(GBytes) bytes = NULL;
   g_autoptr(GError) error = NULL;
   g_autoptr(GFile) file = NULL;
-  g_autofree char *content = NULL;
   const char *data;
   gsize len;
 
@@ -696,20 +658,21 @@ project_client_read_text_file_fiber (FoundryAcpProjectClient *self,
   if (!(file = foundry_acp_project_client_dup_file_for_path (self, path, &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
-  if (!(bytes = dex_await_boxed (dex_file_load_contents_bytes (file), &error)))
+  /* Only the requested range is validated. Lines are split at '\n' which
+   * never appears inside a multi-byte sequence.
+   */
+  if (!(bytes = dex_await_boxed (foundry_acp_file_cache_read (self->file_cache, file, line, limit), &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
   data = g_bytes_get_data (bytes, &len);
 
-  if (!g_utf8_validate (data, len, NULL))
+  if (len > 0 && !g_utf8_validate (data, len, NULL))
     return dex_future_new_reject (G_IO_ERROR,
                                   G_IO_ERROR_INVALID_DATA,
                                   "File `%s` is not valid UTF-8",
                                   path);
 
-  content = g_strndup (data, len);
-
-  return dex_future_new_take_string (slice_lines (content, line, limit));
+  return dex_future_new_take_string (g_strndup (data ? data : "", len));
 }
 
 static DexFuture *
@@ -751,6 +714,8 @@ project_client_write_text_file_fiber (FoundryAcpProjectClient *self,
                   &error))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
+  foundry_acp_file_cache_invalidate (self->file_cache, file);
+
   _foundry_acp_session_note_changed_file (session,
                                           path,
                                           kind,
@@ -1081,6 +1046,8 @@ foundry_acp_project_client_new (FoundryContext *context)
   self = foundry_acp_project_client_new_for_project_directory (project_directory);
   self->context = g_object_ref (context);
   self->vcs_manager = foundry_context_dup_vcs_manager (context);
+  g_clear_object (&self->file_cache);
+  self->file_cache = foundry_acp_file_cache_from_context (context);
 
   return self;
 }
@@ -1106,6 +1073,7 @@ foundry_acp_project_client_new_for_project_directory (GFile *project_directory)
   self->project_directory = g_object_ref (project_directory);
   self->permission_policy =
     foundry_acp_permission_policy_new_for_project_directory (project_directory);
+  self->file_cache = foundry_acp_file_cache_new (NULL);
   g_hash_table_unref (self->file_snapshot);
   self->file_snapshot = project_client_take_file_snapshot (self);
 
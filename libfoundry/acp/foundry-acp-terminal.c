@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "foundry-acp-enums.h"
 #include "foundry-acp-terminal-private.h"
 #include "foundry-acp-terminal.h"
@@ -33,7 +35,9 @@ struct _FoundryAcpTerminal
   char **argv;
   char *cwd;
   char *latest_output;
-  GString *scrollback;
+  GQueue scrollback;
+  gsize scrollback_len;
+  guint64 scrollback_start;
   char *exit_signal;
   gint64 created_at;
   gint64 started_at;
@@ -47,6 +51,11 @@ struct _FoundryAcpTerminal
 
 G_DEFINE_FINAL_TYPE (FoundryAcpTerminal, foundry_acp_terminal, G_TYPE_OBJECT)
 
+/* Small appends are merged into the tail chunk until it reaches this
+ * size so that chatty commands do not create a chunk per write.
+ */
+#define SCROLLBACK_MERGE_SIZE 4096
+
 enum {
   PROP_0,
   PROP_ID,
@@ -68,12 +77,160 @@ enum {
   N_PROPS
 };
 
+enum {
+  SCROLLBACK_APPENDED,
+  N_SIGNALS
+};
+
 static GParamSpec *properties[N_PROPS];
+static guint signals[N_SIGNALS];
 
-static void
-clear_string (GString *string)
+/* Drops the oldest output so that at most output-byte-limit bytes are
+ * retained. The cut is moved forward to a character boundary so readers
+ * never see a partial UTF-8 sequence at the start.
+ *
+ * Returns %TRUE if any output was dropped.
+ */
+static gboolean
+foundry_acp_terminal_scrollback_trim (FoundryAcpTerminal *self)
 {
-  g_string_free (string, TRUE);
+  gsize limit;
+
+  if (self->output_byte_limit < 0 ||
+      self->scrollback_len <= (gsize)self->output_byte_limit)
+    return FALSE;
+
+  limit = self->output_byte_limit;
+
+  while (self->scrollback_len > limit)
+    {
+      GBytes *head = g_queue_peek_head (&self->scrollback);
+      gsize head_len = g_bytes_get_size (head);
+      gsize drop = self->scrollback_len - limit;
+
+      if (drop >= head_len)
+        {
+          g_bytes_unref (g_queue_pop_head (&self->scrollback));
+          self->scrollback_len -= head_len;
+          self->scrollback_start += head_len;
+        }
+      else
+        {
+          const guint8 *data = g_bytes_get_data (head, NULL);
+
+          while (drop < head_len && (data[drop] & 0xC0) == 0x80)
+            drop++;
+
+          self->scrollback.head->data = g_bytes_new_from_bytes (head, drop, head_len - drop);
+          g_bytes_unref (head);
+
+          self->scrollback_len -= drop;
+          self->scrollback_start += drop;
+          break;
+        }
+    }
+
+  return TRUE;
+}
+
+static gboolean
+foundry_acp_terminal_scrollback_append (FoundryAcpTerminal *self,
+                                        const char         *text,
+                                        gsize               len)
+{
+  g_autoptr(GBytes) delta = NULL;
+  GBytes *tail;
+  gboolean trimmed;
+
+  g_assert (FOUNDRY_IS_ACP_TERMINAL (self));
+  g_assert (text != NULL);
+  g_assert (len > 0);
+
+  delta = g_bytes_new (text, len);
+
+  if ((tail = g_queue_peek_tail (&self->scrollback)) &&
+      g_bytes_get_size (tail) + len <= SCROLLBACK_MERGE_SIZE)
+    {
+      gsize tail_len = g_bytes_get_size (tail);
+      guint8 *merged = g_malloc (tail_len + len);
+
+      memcpy (merged, g_bytes_get_data (tail, NULL), tail_len);
+      memcpy (merged + tail_len, text, len);
+
+      self->scrollback.tail->data = g_bytes_new_take (merged, tail_len + len);
+      g_bytes_unref (tail);
+    }
+  else
+    {
+      g_queue_push_tail (&self->scrollback, g_bytes_ref (delta));
+    }
+
+  self->scrollback_len += len;
+
+  trimmed = foundry_acp_terminal_scrollback_trim (self);
+
+  g_signal_emit (self, signals[SCROLLBACK_APPENDED], 0, delta);
+
+  return trimmed;
+}
+
+static GBytes *
+foundry_acp_terminal_scrollback_range (FoundryAcpTerminal *self,
+                                       gsize               offset,
+                                       gsize               length)
+{
+  g_autoptr(GByteArray) buffer = NULL;
+  gsize chunk_offset = 0;
+
+  g_assert (FOUNDRY_IS_ACP_TERMINAL (self));
+
+  if (offset >= self->scrollback_len)
+    return g_bytes_new (NULL, 0);
+
+  length = MIN (length, self->scrollback_len - offset);
+
+  for (const GList *iter = self->scrollback.head; iter; iter = iter->next)
+    {
+      GBytes *chunk = iter->data;
+      gsize chunk_len = g_bytes_get_size (chunk);
+      gsize begin;
+      gsize n;
+
+      if (chunk_offset + chunk_len <= offset)
+        {
+          chunk_offset += chunk_len;
+          continue;
+        }
+
+      begin = offset > chunk_offset ? offset - chunk_offset : 0;
+      n = MIN (chunk_len - begin, length - (buffer ? buffer->len : 0));
+
+      /* Ranges inside a single chunk can share its memory */
+      if (buffer == NULL && n == length)
+        return g_bytes_new_from_bytes (chunk, begin, n);
+
+      if (buffer == NULL)
+        buffer = g_byte_array_sized_new (length);
+
+      g_byte_array_append (buffer, (const guint8 *)g_bytes_get_data (chunk, NULL) + begin, n);
+
+      if (buffer->len == length)
+        break;
+
+      chunk_offset += chunk_len;
+    }
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&buffer));
+}
+
+static char *
+foundry_acp_terminal_scrollback_to_string (FoundryAcpTerminal *self)
+{
+  g_autoptr(GBytes) bytes = foundry_acp_terminal_scrollback_range (self, 0, self->scrollback_len);
+  gsize len;
+  const char *data = g_bytes_get_data (bytes, &len);
+
+  return g_strndup (data ? data : "", len);
 }
 
 static void
@@ -87,7 +244,7 @@ foundry_acp_terminal_finalize (GObject *object)
   g_clear_pointer (&self->argv, g_strfreev);
   g_clear_pointer (&self->cwd, g_free);
   g_clear_pointer (&self->latest_output, g_free);
-  g_clear_pointer (&self->scrollback, clear_string);
+  g_queue_clear_full (&self->scrollback, (GDestroyNotify) g_bytes_unref);
   g_clear_pointer (&self->exit_signal, g_free);
 
   G_OBJECT_CLASS (foundry_acp_terminal_parent_class)->finalize (object);
@@ -152,7 +309,7 @@ foundry_acp_terminal_get_property (GObject    *object,
       break;
 
     case PROP_SCROLLBACK:
-      g_value_set_string (value, self->scrollback != NULL ? self->scrollback->str : NULL);
+      g_value_take_string (value, foundry_acp_terminal_scrollback_to_string (self));
       break;
 
     case PROP_HAS_EXIT_STATUS:
@@ -259,6 +416,25 @@ foundry_acp_terminal_class_init (FoundryAcpTerminalClass *klass)
                          (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
   g_object_class_install_properties (object_class, N_PROPS, properties);
+
+  /**
+   * FoundryAcpTerminal::scrollback-appended:
+   * @self: a [class@Foundry.AcpTerminal]
+   * @delta: the newly appended output
+   *
+   * Emitted when output is appended to the scrollback. Consumers should
+   * prefer this over reading the whole scrollback after each change.
+   *
+   * Since: 1.2
+   */
+  signals[SCROLLBACK_APPENDED] =
+    g_signal_new ("scrollback-appended",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 1, G_TYPE_BYTES | G_SIGNAL_TYPE_STATIC_SCOPE);
 }
 
 static void
@@ -266,7 +442,7 @@ foundry_acp_terminal_init (FoundryAcpTerminal *self)
 {
   self->created_at = g_get_real_time ();
   self->output_byte_limit = -1;
-  self->scrollback = g_string_new (NULL);
+  g_queue_init (&self->scrollback);
   self->state = FOUNDRY_ACP_TERMINAL_RUNNING;
 }
 
@@ -502,7 +678,89 @@ foundry_acp_terminal_dup_scrollback (FoundryAcpTerminal *self)
 {
   g_return_val_if_fail (FOUNDRY_IS_ACP_TERMINAL (self), NULL);
 
-  return g_strdup (self->scrollback != NULL ? self->scrollback->str : "");
+  return foundry_acp_terminal_scrollback_to_string (self);
+}
+
+/**
+ * foundry_acp_terminal_get_scrollback_length:
+ * @self: a [class@Foundry.AcpTerminal]
+ *
+ * Returns: the number of bytes of output currently retained
+ *
+ * Since: 1.2
+ */
+gsize
+foundry_acp_terminal_get_scrollback_length (FoundryAcpTerminal *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_ACP_TERMINAL (self), 0);
+
+  return self->scrollback_len;
+}
+
+/**
+ * foundry_acp_terminal_get_scrollback_start:
+ * @self: a [class@Foundry.AcpTerminal]
+ *
+ * Gets the number of bytes of output that have been discarded to honor
+ * [property@Foundry.AcpTerminal:output-byte-limit].
+ *
+ * Returns: the absolute position of the first retained byte
+ *
+ * Since: 1.2
+ */
+guint64
+foundry_acp_terminal_get_scrollback_start (FoundryAcpTerminal *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_ACP_TERMINAL (self), 0);
+
+  return self->scrollback_start;
+}
+
+/**
+ * foundry_acp_terminal_dup_scrollback_range:
+ * @self: a [class@Foundry.AcpTerminal]
+ * @offset: the offset relative to the first retained byte
+ * @length: the maximum number of bytes to read
+ *
+ * Reads part of the scrollback. The range is clamped to the output
+ * that is retained and is not copied if it lies within one chunk.
+ *
+ * Returns: (transfer full): a [struct@GLib.Bytes]
+ *
+ * Since: 1.2
+ */
+GBytes *
+foundry_acp_terminal_dup_scrollback_range (FoundryAcpTerminal *self,
+                                           gsize               offset,
+                                           gsize               length)
+{
+  g_return_val_if_fail (FOUNDRY_IS_ACP_TERMINAL (self), NULL);
+
+  return foundry_acp_terminal_scrollback_range (self, offset, length);
+}
+
+/**
+ * foundry_acp_terminal_dup_scrollback_tail:
+ * @self: a [class@Foundry.AcpTerminal]
+ * @max_length: the maximum number of bytes to read
+ *
+ * Reads up to @max_length bytes from the end of the scrollback.
+ *
+ * Returns: (transfer full): a [struct@GLib.Bytes]
+ *
+ * Since: 1.2
+ */
+GBytes *
+foundry_acp_terminal_dup_scrollback_tail (FoundryAcpTerminal *self,
+                                          gsize               max_length)
+{
+  gsize offset;
+
+  g_return_val_if_fail (FOUNDRY_IS_ACP_TERMINAL (self), NULL);
+
+  offset = self->scrollback_len - MIN (max_length, self->scrollback_len);
+
+  return foundry_acp_terminal_scrollback_range (self, offset, max_length);
 }
 
 /**
@@ -642,6 +900,8 @@ _foundry_acp_terminal_set_output_byte_limit (FoundryAcpTerminal *self,
   if (self->output_byte_limit != output_byte_limit)
     {
       self->output_byte_limit = output_byte_limit;
+      if (foundry_acp_terminal_scrollback_trim (self))
+        _foundry_acp_terminal_set_truncated (self, TRUE);
       g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_OUTPUT_BYTE_LIMIT]);
     }
 }
@@ -668,6 +928,7 @@ _foundry_acp_terminal_apply_output (FoundryAcpTerminal       *self,
   g_autofree char *exit_signal = NULL;
   g_autofree char *text = NULL;
   gboolean has_exit_status;
+  gboolean truncated;
   int exit_status;
 
   g_return_if_fail (FOUNDRY_IS_ACP_TERMINAL (self));
@@ -678,17 +939,19 @@ _foundry_acp_terminal_apply_output (FoundryAcpTerminal       *self,
   exit_status = foundry_acp_terminal_output_get_exit_code (output);
   exit_signal = foundry_acp_terminal_output_dup_signal (output);
 
-  _foundry_acp_terminal_set_truncated (self,
-                                       foundry_acp_terminal_output_get_truncated (output));
+  truncated = foundry_acp_terminal_output_get_truncated (output);
 
   if (g_set_str (&self->latest_output, text))
     g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_LATEST_OUTPUT]);
 
   if (text != NULL && text[0] != 0)
-    {
-      g_string_append (self->scrollback, text);
-      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_SCROLLBACK]);
-    }
+    truncated |= foundry_acp_terminal_scrollback_append (self, text, strlen (text));
+
+  /* Once output has been dropped it stays dropped, so the flag is sticky
+   * rather than following whatever the latest update reported.
+   */
+  if (truncated)
+    _foundry_acp_terminal_set_truncated (self, TRUE);
 
   if (has_exit_status != self->has_exit_status)
     {
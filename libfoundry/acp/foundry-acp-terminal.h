@@ -59,6 +59,17 @@ char                     *foundry_acp_terminal_dup_latest_output     (FoundryAcp
 FOUNDRY_AVAILABLE_IN_1_2
 char                     *foundry_acp_terminal_dup_scrollback        (FoundryAcpTerminal *self);
 FOUNDRY_AVAILABLE_IN_1_2
+gsize                     foundry_acp_terminal_get_scrollback_length (FoundryAcpTerminal *self);
+FOUNDRY_AVAILABLE_IN_1_2
+guint64                   foundry_acp_terminal_get_scrollback_start  (FoundryAcpTerminal *self);
+FOUNDRY_AVAILABLE_IN_1_2
+GBytes                   *foundry_acp_terminal_dup_scrollback_range  (FoundryAcpTerminal *self,
+                                                                      gsize               offset,
+                                                                      gsize               length);
+FOUNDRY_AVAILABLE_IN_1_2
+GBytes                   *foundry_acp_terminal_dup_scrollback_tail   (FoundryAcpTerminal *self,
+                                                                      gsize               max_length);
+FOUNDRY_AVAILABLE_IN_1_2
 gboolean                  foundry_acp_terminal_has_exit_status       (FoundryAcpTerminal *self);
 FOUNDRY_AVAILABLE_IN_1_2
 int                       foundry_acp_terminal_get_exit_status       (FoundryAcpTerminal *self);
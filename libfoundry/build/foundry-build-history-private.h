@@ -0,0 +1,77 @@
+/* foundry-build-history-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <json-glib/json-glib.h>
+
+#include "foundry-build-stage.h"
+#include "foundry-context.h"
+
+G_BEGIN_DECLS
+
+typedef enum _FoundryBuildHistoryStatus
+{
+  FOUNDRY_BUILD_HISTORY_STATUS_NOT_RUN = 0,
+  FOUNDRY_BUILD_HISTORY_STATUS_SKIPPED,
+  FOUNDRY_BUILD_HISTORY_STATUS_SUCCESS,
+  FOUNDRY_BUILD_HISTORY_STATUS_FAILED,
+} FoundryBuildHistoryStatus;
+
+typedef struct _FoundryBuildHistoryStage
+{
+  FoundryBuildStage         *stage;
+  gint64                     query_begin;
+  gint64                     query_usec;
+  gint64                     begin;
+  gint64                     end;
+  gint64                     cpu_begin;
+  gint64                     cpu_usec;
+  FoundryBuildHistoryStatus  status;
+  char                      *message;
+} FoundryBuildHistoryStage;
+
+FoundryBuildHistoryStage *_foundry_build_history_stage_new         (FoundryBuildStage               *stage);
+FoundryBuildHistoryStage *_foundry_build_history_stage_ref         (FoundryBuildHistoryStage        *self);
+void                      _foundry_build_history_stage_unref       (FoundryBuildHistoryStage        *self);
+void                      _foundry_build_history_stage_query_begin (FoundryBuildHistoryStage        *self);
+void                      _foundry_build_history_stage_query_end   (FoundryBuildHistoryStage        *self);
+void                      _foundry_build_history_stage_begin       (FoundryBuildHistoryStage        *self);
+void                      _foundry_build_history_stage_end         (FoundryBuildHistoryStage        *self,
+                                                                    FoundryBuildHistoryStatus        status,
+                                                                    const GError                    *error);
+JsonNode                 *_foundry_build_history_run_new           (const char                      *operation,
+                                                                    FoundryBuildPipelinePhase        phase,
+                                                                    GDateTime                       *started_at,
+                                                                    gint64                           begin,
+                                                                    gint64                           end,
+                                                                    FoundryBuildHistoryStage * const *stages,
+                                                                    guint                            n_stages,
+                                                                    gboolean                         sequential,
+                                                                    const GError                    *error);
+DexFuture                *_foundry_build_history_append            (FoundryContext                  *context,
+                                                                    const char                      *builddir,
+                                                                    JsonNode                        *run) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture                *_foundry_build_history_load              (FoundryContext                  *context,
+                                                                    const char                      *builddir) G_GNUC_WARN_UNUSED_RESULT;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryBuildHistoryStage, _foundry_build_history_stage_unref)
+
+G_END_DECLS
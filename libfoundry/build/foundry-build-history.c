@@ -0,0 +1,523 @@
+/* foundry-build-history.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <sys/resource.h>
+
+#include "foundry-build-history-private.h"
+#include "foundry-build-stage-private.h"
+#include "foundry-inhibitor-private.h"
+#include "foundry-json.h"
+#include "foundry-util-private.h"
+
+/* Number of runs to keep per pipeline */
+#define MAX_RUNS 25
+
+static const char *
+status_to_string (FoundryBuildHistoryStatus status)
+{
+  switch (status)
+    {
+    case FOUNDRY_BUILD_HISTORY_STATUS_SKIPPED:
+      return "skipped";
+
+    case FOUNDRY_BUILD_HISTORY_STATUS_SUCCESS:
+      return "success";
+
+    case FOUNDRY_BUILD_HISTORY_STATUS_FAILED:
+      return "failed";
+
+    case FOUNDRY_BUILD_HISTORY_STATUS_NOT_RUN:
+    default:
+      return "not-run";
+    }
+}
+
+static const char *
+phase_to_string (FoundryBuildPipelinePhase phase)
+{
+  static GFlagsClass *klass;
+  GFlagsValue *value;
+
+  if (g_once_init_enter (&klass))
+    g_once_init_leave (&klass, g_type_class_ref (FOUNDRY_TYPE_BUILD_PIPELINE_PHASE));
+
+  if ((value = g_flags_get_first_value (klass, FOUNDRY_BUILD_PIPELINE_PHASE_MASK (phase))))
+    return value->value_nick;
+
+  return "none";
+}
+
+/*
+ * CPU time of reaped children, which is where nearly all of the work
+ * of a build stage happens. With stages running concurrently this is
+ * an approximation as children of other stages may be reaped while
+ * the stage is running.
+ */
+static gint64
+get_children_cpu_usec (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_CHILDREN, &usage) != 0)
+    return 0;
+
+  return ((gint64)usage.ru_utime.tv_sec * G_USEC_PER_SEC + usage.ru_utime.tv_usec +
+          (gint64)usage.ru_stime.tv_sec * G_USEC_PER_SEC + usage.ru_stime.tv_usec);
+}
+
+static void
+foundry_build_history_stage_finalize (gpointer data)
+{
+  FoundryBuildHistoryStage *self = data;
+
+  g_clear_object (&self->stage);
+  g_clear_pointer (&self->message, g_free);
+}
+
+FoundryBuildHistoryStage *
+_foundry_build_history_stage_new (FoundryBuildStage *stage)
+{
+  FoundryBuildHistoryStage *self;
+
+  g_return_val_if_fail (FOUNDRY_IS_BUILD_STAGE (stage), NULL);
+
+  self = g_atomic_rc_box_new0 (FoundryBuildHistoryStage);
+  self->stage = g_object_ref (stage);
+
+  return self;
+}
+
+FoundryBuildHistoryStage *
+_foundry_build_history_stage_ref (FoundryBuildHistoryStage *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+void
+_foundry_build_history_stage_unref (FoundryBuildHistoryStage *self)
+{
+  g_atomic_rc_box_release_full (self, foundry_build_history_stage_finalize);
+}
+
+void
+_foundry_build_history_stage_query_begin (FoundryBuildHistoryStage *self)
+{
+  g_return_if_fail (self != NULL);
+
+  self->query_begin = g_get_monotonic_time ();
+}
+
+void
+_foundry_build_history_stage_query_end (FoundryBuildHistoryStage *self)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (self->query_begin != 0);
+
+  self->query_usec += g_get_monotonic_time () - self->query_begin;
+  self->query_begin = 0;
+}
+
+void
+_foundry_build_history_stage_begin (FoundryBuildHistoryStage *self)
+{
+  g_return_if_fail (self != NULL);
+
+  self->begin = g_get_monotonic_time ();
+  self->cpu_begin = get_children_cpu_usec ();
+}
+
+void
+_foundry_build_history_stage_end (FoundryBuildHistoryStage  *self,
+                                  FoundryBuildHistoryStatus  status,
+                                  const GError              *error)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->begin != 0)
+    {
+      self->end = g_get_monotonic_time ();
+      self->cpu_usec = MAX (0, get_children_cpu_usec () - self->cpu_begin);
+    }
+
+  self->status = status;
+
+  if (error != NULL)
+    g_set_str (&self->message, error->message);
+}
+
+static gint64
+stage_wall_usec (const FoundryBuildHistoryStage *self)
+{
+  if (self->begin == 0 || self->end < self->begin)
+    return 0;
+
+  return self->end - self->begin;
+}
+
+/*
+ * Finds the longest chain of dependent stages by wall-clock time. Any
+ * stage may only depend on those before it so a single pass in pipeline
+ * order is enough to walk the DAG.
+ */
+static gboolean
+depends_on (FoundryBuildHistoryStage * const *stages,
+            guint                             i,
+            guint                             j,
+            gboolean                          sequential)
+{
+  g_assert (j < i);
+
+  if (sequential)
+    return TRUE;
+
+  return _foundry_build_stage_depends_on (stages[i]->stage, stages[j]->stage);
+}
+
+static JsonNode *
+compute_critical_path (FoundryBuildHistoryStage * const *stages,
+                       guint                             n_stages,
+                       gboolean                          sequential,
+                       gint64                           *critical_usec)
+{
+  g_autofree gint64 *dist = NULL;
+  g_autofree int *prev = NULL;
+  g_autoptr(GArray) path = NULL;
+  JsonArray *ar;
+  int last = -1;
+
+  *critical_usec = 0;
+
+  if (n_stages == 0)
+    return json_node_init_array (json_node_alloc (), json_array_new ());
+
+  dist = g_new0 (gint64, n_stages);
+  prev = g_new (int, n_stages);
+
+  for (guint i = 0; i < n_stages; i++)
+    {
+      gint64 best = 0;
+
+      prev[i] = -1;
+
+      for (guint j = 0; j < i; j++)
+        {
+          if (dist[j] > best && depends_on (stages, i, j, sequential))
+            {
+              best = dist[j];
+              prev[i] = j;
+            }
+        }
+
+      dist[i] = best + stages[i]->query_usec + stage_wall_usec (stages[i]);
+
+      if (last < 0 || dist[i] > dist[last])
+        last = i;
+    }
+
+  *critical_usec = dist[last];
+
+  path = g_array_new (FALSE, FALSE, sizeof (int));
+  for (int i = last; i >= 0; i = prev[i])
+    g_array_prepend_val (path, i);
+
+  ar = json_array_sized_new (path->len);
+  for (guint i = 0; i < path->len; i++)
+    json_array_add_int_element (ar, g_array_index (path, int, i));
+
+  return json_node_init_array (json_node_alloc (), ar);
+}
+
+JsonNode *
+_foundry_build_history_run_new (const char                       *operation,
+                                FoundryBuildPipelinePhase         phase,
+                                GDateTime                        *started_at,
+                                gint64                            begin,
+                                gint64                            end,
+                                FoundryBuildHistoryStage * const *stages,
+                                guint                             n_stages,
+                                gboolean                          sequential,
+                                const GError                     *error)
+{
+  g_autofree char *started_at_str = NULL;
+  JsonObject *obj;
+  JsonArray *stages_ar;
+  JsonNode *critical_path;
+  gint64 critical_usec;
+
+  g_return_val_if_fail (operation != NULL, NULL);
+  g_return_val_if_fail (started_at != NULL, NULL);
+  g_return_val_if_fail (stages != NULL || n_stages == 0, NULL);
+
+  started_at_str = g_date_time_format_iso8601 (started_at);
+  critical_path = compute_critical_path (stages, n_stages, sequential, &critical_usec);
+  stages_ar = json_array_sized_new (n_stages);
+
+  for (guint i = 0; i < n_stages; i++)
+    {
+      const FoundryBuildHistoryStage *stage = stages[i];
+      g_autofree char *title = foundry_build_stage_dup_title (stage->stage);
+      g_autofree char *kind = foundry_build_stage_dup_kind (stage->stage);
+      JsonObject *stage_obj = json_object_new ();
+      JsonArray *deps_ar = json_array_new ();
+
+      for (guint j = 0; j < i; j++)
+        {
+          if (depends_on (stages, i, j, sequential))
+            json_array_add_int_element (deps_ar, j);
+        }
+
+      json_object_set_string_member (stage_obj, "title", title);
+      json_object_set_string_member (stage_obj, "kind", kind);
+      json_object_set_string_member (stage_obj, "type", G_OBJECT_TYPE_NAME (stage->stage));
+      json_object_set_string_member (stage_obj, "phase", phase_to_string (foundry_build_stage_get_phase (stage->stage)));
+      json_object_set_string_member (stage_obj, "status", status_to_string (stage->status));
+      json_object_set_int_member (stage_obj, "start-usec", stage->begin ? stage->begin - begin : 0);
+      json_object_set_int_member (stage_obj, "query-usec", stage->query_usec);
+      json_object_set_int_member (stage_obj, "wall-usec", stage_wall_usec (stage));
+      json_object_set_int_member (stage_obj, "cpu-usec", stage->cpu_usec);
+      json_object_set_array_member (stage_obj, "dependencies", deps_ar);
+
+      if (stage->message != NULL)
+        json_object_set_string_member (stage_obj, "error", stage->message);
+
+      json_array_add_object_element (stages_ar, stage_obj);
+    }
+
+  obj = json_object_new ();
+  json_object_set_string_member (obj, "operation", operation);
+  json_object_set_string_member (obj, "phase", phase_to_string (phase));
+  json_object_set_string_member (obj, "started-at", started_at_str);
+  json_object_set_string_member (obj, "status", error ? "failed" : "success");
+  json_object_set_int_member (obj, "wall-usec", MAX (0, end - begin));
+  json_object_set_int_member (obj, "critical-path-usec", critical_usec);
+  json_object_set_member (obj, "critical-path", critical_path);
+  json_object_set_array_member (obj, "stages", stages_ar);
+
+  if (error != NULL)
+    json_object_set_string_member (obj, "error", error->message);
+
+  return json_node_init_object (json_node_alloc (), obj);
+}
+
+static GFile *
+get_history_file (FoundryContext *context,
+                  const char     *builddir)
+{
+  g_autofree char *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, builddir, -1);
+  g_autofree char *name = g_strdup_printf ("%s.json", checksum);
+
+  return foundry_context_cache_file (context, "build-history", name, NULL);
+}
+
+static DexFuture *
+foundry_build_history_load_fiber (gpointer data)
+{
+  GFile *file = data;
+  g_autoptr(JsonNode) node = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (G_IS_FILE (file));
+
+  if (!(bytes = dex_await_boxed (dex_file_load_contents_bytes (file), &error)))
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        return dex_future_new_for_error (g_steal_pointer (&error));
+    }
+  else if (!(node = dex_await_boxed (foundry_json_node_from_bytes (bytes), &error)))
+    {
+      g_debug ("Ignoring corrupt build history: %s", error->message);
+    }
+
+  if (node == NULL || !JSON_NODE_HOLDS_ARRAY (node))
+    {
+      g_clear_pointer (&node, json_node_unref);
+      node = json_node_init_array (json_node_alloc (), json_array_new ());
+    }
+
+  return dex_future_new_take_boxed (JSON_TYPE_NODE, g_steal_pointer (&node));
+}
+
+/**
+ * _foundry_build_history_load:
+ * @context: a [class@Foundry.Context]
+ * @builddir: the build directory of the pipeline
+ *
+ * Loads the recorded runs for the pipeline using @builddir.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to a
+ *   [struct@Json.Node] containing an array of runs, oldest first.
+ */
+DexFuture *
+_foundry_build_history_load (FoundryContext *context,
+                             const char     *builddir)
+{
+  dex_return_error_if_fail (FOUNDRY_IS_CONTEXT (context));
+  dex_return_error_if_fail (builddir != NULL);
+
+  return dex_scheduler_spawn (NULL, 0,
+                              foundry_build_history_load_fiber,
+                              get_history_file (context, builddir),
+                              g_object_unref);
+}
+
+typedef struct _Append
+{
+  GFile    *file;
+  JsonNode *run;
+} Append;
+
+static void
+append_free (Append *state)
+{
+  g_clear_object (&state->file);
+  g_clear_pointer (&state->run, json_node_unref);
+  g_free (state);
+}
+
+static DexFuture *
+foundry_build_history_append_fiber (gpointer data)
+{
+  Append *state = data;
+  g_autoptr(GFile) directory = NULL;
+  g_autoptr(JsonNode) history = NULL;
+  g_autoptr(JsonNode) node = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *lock_path = NULL;
+  g_autofree char *path = NULL;
+  g_autofd int lock_fd = -1;
+  JsonArray *runs;
+  JsonArray *ar;
+  guint length;
+  guint first;
+
+  g_assert (state != NULL);
+  g_assert (G_IS_FILE (state->file));
+  g_assert (state->run != NULL);
+
+  directory = g_file_get_parent (state->file);
+  path = g_file_get_path (directory);
+
+  if (!dex_await (dex_mkdir_with_parents (path, 0750), &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  /* Builds of the same pipeline may finish together, possibly from another
+   * process, so hold a lock across the read-modify-write of the history.
+   */
+  lock_path = g_strconcat (g_file_peek_path (state->file), ".lock", NULL);
+
+  lock_fd = dex_await_int (_foundry_lock_file (lock_path), &error);
+
+  if (error != NULL)
+    {
+      lock_fd = -1;
+      return dex_future_new_for_error (g_steal_pointer (&error));
+    }
+
+  if (!(history = dex_await_boxed (dex_scheduler_spawn (NULL, 0,
+                                                        foundry_build_history_load_fiber,
+                                                        g_object_ref (state->file),
+                                                        g_object_unref),
+                                   &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  runs = json_node_get_array (history);
+  length = json_array_get_length (runs);
+  first = length >= MAX_RUNS ? length - MAX_RUNS + 1 : 0;
+
+  ar = json_array_sized_new (MAX_RUNS);
+  for (guint i = first; i < length; i++)
+    json_array_add_element (ar, json_array_dup_element (runs, i));
+  json_array_add_element (ar, json_node_ref (state->run));
+
+  node = json_node_init_array (json_node_alloc (), ar);
+
+  if (!(bytes = dex_await_boxed (foundry_json_node_to_bytes_full (node, FALSE), &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  if (!dex_await (dex_file_replace_contents_bytes (state->file,
+                                                   bytes,
+                                                   NULL,
+                                                   FALSE,
+                                                   G_FILE_CREATE_REPLACE_DESTINATION),
+                  &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+foundry_build_history_append_finally (DexFuture *completed,
+                                      gpointer   user_data)
+{
+  FoundryInhibitor *inhibitor = user_data;
+
+  g_assert (FOUNDRY_IS_INHIBITOR (inhibitor));
+
+  foundry_inhibitor_uninhibit (inhibitor);
+
+  return dex_ref (completed);
+}
+
+/**
+ * _foundry_build_history_append:
+ * @context: a [class@Foundry.Context]
+ * @builddir: the build directory of the pipeline
+ * @run: a run created with _foundry_build_history_run_new()
+ *
+ * Appends @run to the history of the pipeline, dropping the oldest
+ * runs so that only the most recent are kept.
+ *
+ * Appends are serialized with a lock file and the context will not
+ * complete shutdown until the history has been written.
+ *
+ * Returns: (transfer full): a [class@Dex.Future]
+ */
+DexFuture *
+_foundry_build_history_append (FoundryContext *context,
+                               const char     *builddir,
+                               JsonNode       *run)
+{
+  g_autoptr(FoundryInhibitor) inhibitor = NULL;
+  g_autoptr(GError) error = NULL;
+  Append *state;
+
+  dex_return_error_if_fail (FOUNDRY_IS_CONTEXT (context));
+  dex_return_error_if_fail (builddir != NULL);
+  dex_return_error_if_fail (run != NULL);
+
+  if (!(inhibitor = foundry_inhibitor_new (context, &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  state = g_new0 (Append, 1);
+  state->file = get_history_file (context, builddir);
+  state->run = json_node_ref (run);
+
+  return dex_future_finally (dex_scheduler_spawn (dex_thread_pool_scheduler_get_default (), 0,
+                                                  foundry_build_history_append_fiber,
+                                                  state,
+                                                  (GDestroyNotify) append_free),
+                             foundry_build_history_append_finally,
+                             g_steal_pointer (&inhibitor),
+                             g_object_unref);
+}
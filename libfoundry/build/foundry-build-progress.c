@@ -25,11 +25,13 @@
 
 #include "line-reader-private.h"
 
+#include "foundry-build-history-private.h"
 #include "foundry-build-pipeline-private.h"
 #include "foundry-build-progress-private.h"
 #include "foundry-build-stage-private.h"
 #include "foundry-directory-reaper.h"
 #include "foundry-inhibitor.h"
+#include "foundry-metrics-private.h"
 #include "foundry-process-launcher.h"
 #include "foundry-path.h"
 #include "foundry-util.h"
@@ -45,6 +47,17 @@
  * on build operations.
  */
 
+#define MAX_RUNNING_STAGES 4
+
+typedef enum _StageState
+{
+  STAGE_STATE_PENDING = 0,
+  STAGE_STATE_RUNNING,
+  STAGE_STATE_BUILT,
+  STAGE_STATE_SKIPPED,
+  STAGE_STATE_FAILED,
+} StageState;
+
 struct _FoundryBuildProgress
 {
   FoundryContextual           parent_instance;
@@ -226,14 +239,203 @@ _foundry_build_progress_new (FoundryBuildPipeline      *pipeline,
   return self;
 }
 
+typedef struct _RunStage
+{
+  FoundryBuildProgress     *self;
+  FoundryBuildStage        *stage;
+  FoundryBuildHistoryStage *record;
+  guint                     requery : 1;
+} RunStage;
+
+static void
+run_stage_free (RunStage *state)
+{
+  g_clear_object (&state->self);
+  g_clear_object (&state->stage);
+  g_clear_pointer (&state->record, _foundry_build_history_stage_unref);
+  g_free (state);
+}
+
+static DexFuture *
+foundry_build_progress_query_finally (DexFuture *completed,
+                                      gpointer   user_data)
+{
+  _foundry_build_history_stage_query_end (user_data);
+  return dex_ref (completed);
+}
+
+static DexFuture *
+foundry_build_progress_record_failed (DexFuture *completed,
+                                      gpointer   user_data)
+{
+  g_autoptr(GError) error = NULL;
+
+  if (!dex_future_get_value (completed, &error))
+    g_debug ("Failed to save build history: %s", error->message);
+
+  return dex_future_new_true ();
+}
+
+/* The history is written in the background so that the result of the
+ * build is not delayed by it.
+ */
+static void
+foundry_build_progress_record (FoundryBuildProgress *self,
+                               const char           *operation,
+                               GDateTime            *started_at,
+                               gint64                begin,
+                               GPtrArray            *records,
+                               gboolean              sequential,
+                               const GError         *error)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(JsonNode) run = NULL;
+
+  g_assert (FOUNDRY_IS_BUILD_PROGRESS (self));
+  g_assert (operation != NULL);
+  g_assert (records != NULL);
+
+  if (!(context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
+    return;
+
+  run = _foundry_build_history_run_new (operation,
+                                        self->phase,
+                                        started_at,
+                                        begin,
+                                        g_get_monotonic_time (),
+                                        (FoundryBuildHistoryStage * const *)records->pdata,
+                                        records->len,
+                                        sequential,
+                                        error);
+
+  dex_future_disown (dex_future_catch (_foundry_build_history_append (context, self->builddir, run),
+                                       foundry_build_progress_record_failed,
+                                       NULL, NULL));
+}
+
+static DexFuture *
+foundry_build_progress_run_stage_fiber (gpointer user_data)
+{
+  RunStage *state = user_data;
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+  gint64 duration;
+  gint64 begin;
+
+  g_assert (state != NULL);
+  g_assert (FOUNDRY_IS_BUILD_PROGRESS (state->self));
+  g_assert (FOUNDRY_IS_BUILD_STAGE (state->stage));
+
+  /* Something we depend on was built, so our state may have changed
+   * since the initial query was performed.
+   */
+  if (state->requery)
+    {
+      _foundry_build_history_stage_query_begin (state->record);
+
+      if (!dex_await (foundry_build_stage_query (state->stage), &error))
+        {
+          g_warning ("%s query failed: %s", G_OBJECT_TYPE_NAME (state->stage), error->message);
+          g_clear_error (&error);
+        }
+
+      _foundry_build_history_stage_query_end (state->record);
+    }
+
+  if (foundry_build_stage_get_completed (state->stage))
+    {
+      _foundry_build_history_stage_end (state->record, FOUNDRY_BUILD_HISTORY_STATUS_SKIPPED, NULL);
+      return dex_future_new_for_boolean (FALSE);
+    }
+
+  _foundry_build_history_stage_begin (state->record);
+
+  begin = _foundry_metrics_now ();
+  ret = dex_await (foundry_build_stage_build (state->stage, state->self), &error);
+  duration = _foundry_metrics_now () - begin;
+
+  FOUNDRY_METRICS_RECORD ("build.stage", duration);
+  _foundry_metrics_record (_foundry_metrics_register_for_type ("build.stage",
+                                                               G_OBJECT_TYPE (state->stage),
+                                                               FOUNDRY_METRIC_HISTOGRAM),
+                           duration);
+
+  if (!ret)
+    {
+      _foundry_build_history_stage_end (state->record, FOUNDRY_BUILD_HISTORY_STATUS_FAILED, error);
+      return dex_future_new_for_error (g_steal_pointer (&error));
+    }
+
+  _foundry_build_history_stage_end (state->record, FOUNDRY_BUILD_HISTORY_STATUS_SUCCESS, NULL);
+
+  return dex_future_new_true ();
+}
+
+static gboolean
+foundry_build_progress_stage_is_ready (FoundryBuildProgress      *self,
+                                       guint                      position,
+                                       const StageState          *states,
+                                       FoundryBuildStageResource  busy,
+                                       gboolean                  *requery)
+{
+  FoundryBuildStage *stage = g_ptr_array_index (self->stages, position);
+  FoundryBuildStageResource resources = _foundry_build_stage_get_resources (stage);
+
+  g_assert (states[position] == STAGE_STATE_PENDING);
+
+  /* CPU and network bound stages generally saturate the resource on
+   * their own (ninja, make, flatpak-builder) so only run one at a time.
+   */
+  if ((resources & busy & (FOUNDRY_BUILD_STAGE_RESOURCE_CPU |
+                           FOUNDRY_BUILD_STAGE_RESOURCE_NETWORK)) != 0)
+    return FALSE;
+
+  *requery = FALSE;
+
+  for (guint i = 0; i < position; i++)
+    {
+      FoundryBuildStage *other = g_ptr_array_index (self->stages, i);
+
+      if (!_foundry_build_stage_depends_on (stage, other))
+        continue;
+
+      if (states[i] != STAGE_STATE_BUILT && states[i] != STAGE_STATE_SKIPPED)
+        return FALSE;
+
+      if (states[i] == STAGE_STATE_BUILT)
+        *requery = TRUE;
+    }
+
+  return TRUE;
+}
+
+static void
+foundry_build_progress_set_current_stage (FoundryBuildProgress *self,
+                                          FoundryBuildStage    *stage)
+{
+  g_assert (FOUNDRY_IS_BUILD_PROGRESS (self));
+  g_assert (!stage || FOUNDRY_IS_BUILD_STAGE (stage));
+
+  if (g_set_object (&self->current_stage, stage))
+    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PHASE]);
+}
+
 static DexFuture *
 foundry_build_progress_build_fiber (gpointer user_data)
 {
   FoundryBuildProgress *self = user_data;
   g_autoptr(FoundryInhibitor) inhibitor = NULL;
   g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(GPtrArray) queries = NULL;
+  g_autoptr(GPtrArray) records = NULL;
+  g_autoptr(GPtrArray) running = NULL;
+  g_autoptr(GArray) running_positions = NULL;
+  g_autoptr(GDateTime) started_at = NULL;
+  g_autofree StageState *states = NULL;
   g_autofree char *builddir = NULL;
   g_autoptr(GError) error = NULL;
+  FoundryBuildStageResource busy = 0;
+  gint64 begin;
 
   g_assert (FOUNDRY_IS_BUILD_PROGRESS (self));
   g_assert (self->builddir != NULL);
@@ -247,33 +449,143 @@ foundry_build_progress_build_fiber (gpointer user_data)
   if (!dex_await (dex_mkdir_with_parents (self->builddir, 0750), &error))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
+  if (self->stages->len == 0)
+    return dex_future_new_true ();
+
+  started_at = g_date_time_new_now_local ();
+  begin = g_get_monotonic_time ();
+
+  /* Query every stage up front and concurrently. Stages which have a
+   * dependency that gets built will be queried again before they run.
+   */
+  queries = g_ptr_array_new_with_free_func (dex_unref);
+  records = g_ptr_array_new_with_free_func ((GDestroyNotify) _foundry_build_history_stage_unref);
+
   for (guint i = 0; i < self->stages->len; i++)
     {
       FoundryBuildStage *stage = g_ptr_array_index (self->stages, i);
-      FoundryBuildPipelinePhase phase = foundry_build_stage_get_phase (stage);
+      FoundryBuildHistoryStage *record = _foundry_build_history_stage_new (stage);
+
+      g_ptr_array_add (records, record);
+
+      _foundry_build_history_stage_query_begin (record);
+      g_ptr_array_add (queries,
+                       dex_future_finally (foundry_build_stage_query (stage),
+                                           foundry_build_progress_query_finally,
+                                           _foundry_build_history_stage_ref (record),
+                                           (GDestroyNotify) _foundry_build_history_stage_unref));
+    }
 
-      if (g_set_object (&self->current_stage, stage))
-        g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PHASE]);
+  dex_await (dex_future_allv ((DexFuture **)queries->pdata, queries->len), NULL);
 
-      if (!dex_await (foundry_build_stage_query (stage), &error))
+  for (guint i = 0; i < queries->len; i++)
+    {
+      if (!dex_await (dex_ref (g_ptr_array_index (queries, i)), &error))
         {
-          g_warning ("%s query failed: %s", G_OBJECT_TYPE_NAME (stage), error->message);
+          g_warning ("%s query failed: %s",
+                     G_OBJECT_TYPE_NAME (g_ptr_array_index (self->stages, i)),
+                     error->message);
           g_clear_error (&error);
         }
+    }
 
-      if (foundry_build_stage_get_completed (stage))
-        continue;
+  states = g_new0 (StageState, self->stages->len);
+  running = g_ptr_array_new_with_free_func (dex_unref);
+  running_positions = g_array_new (FALSE, FALSE, sizeof (guint));
 
-      if (!dex_await (foundry_build_stage_build (stage, self), &error))
-        return dex_future_new_for_error (g_steal_pointer (&error));
+  for (;;)
+    {
+      /* Start everything that is ready unless a stage has failed, in
+       * which case we only wait for the remaining stages to complete.
+       */
+      if (error == NULL)
+        {
+          for (guint i = 0; i < self->stages->len && running->len < MAX_RUNNING_STAGES; i++)
+            {
+              FoundryBuildStage *stage = g_ptr_array_index (self->stages, i);
+              RunStage *state;
+              gboolean requery;
+
+              if (states[i] != STAGE_STATE_PENDING ||
+                  !foundry_build_progress_stage_is_ready (self, i, states, busy, &requery))
+                continue;
+
+              state = g_new0 (RunStage, 1);
+              state->self = g_object_ref (self);
+              state->stage = g_object_ref (stage);
+              state->record = _foundry_build_history_stage_ref (g_ptr_array_index (records, i));
+              state->requery = !!requery;
+
+              states[i] = STAGE_STATE_RUNNING;
+              busy |= _foundry_build_stage_get_resources (stage);
+
+              foundry_build_progress_set_current_stage (self, stage);
+
+              g_ptr_array_add (running,
+                               dex_scheduler_spawn (NULL, 0,
+                                                    foundry_build_progress_run_stage_fiber,
+                                                    state,
+                                                    (GDestroyNotify) run_stage_free));
+              g_array_append_val (running_positions, i);
+            }
+        }
 
-      /* Reset compile commands if this might have affected it */
-      if (phase == FOUNDRY_BUILD_PIPELINE_PHASE_CONFIGURE)
-        _foundry_build_pipeline_reset_compile_commands (pipeline);
+      if (running->len == 0)
+        break;
+
+      dex_await (dex_future_firstv ((DexFuture **)running->pdata, running->len), NULL);
+
+      busy = 0;
+
+      for (guint j = running->len; j > 0; j--)
+        {
+          DexFuture *future = g_ptr_array_index (running, j - 1);
+          guint position = g_array_index (running_positions, guint, j - 1);
+          FoundryBuildStage *stage = g_ptr_array_index (self->stages, position);
+          g_autoptr(GError) stage_error = NULL;
+          gboolean built;
+
+          if (dex_future_is_pending (future))
+            {
+              busy |= _foundry_build_stage_get_resources (stage);
+              continue;
+            }
+
+          built = dex_await_boolean (dex_ref (future), &stage_error);
+
+          g_ptr_array_remove_index (running, j - 1);
+          g_array_remove_index (running_positions, j - 1);
+
+          if (stage_error != NULL)
+            {
+              states[position] = STAGE_STATE_FAILED;
+
+              if (error == NULL)
+                error = g_steal_pointer (&stage_error);
+
+              continue;
+            }
+
+          states[position] = built ? STAGE_STATE_BUILT : STAGE_STATE_SKIPPED;
+
+          /* Reset compile commands if this might have affected it */
+          if (built && foundry_build_stage_get_phase (stage) == FOUNDRY_BUILD_PIPELINE_PHASE_CONFIGURE)
+            _foundry_build_pipeline_reset_compile_commands (pipeline);
+        }
+
+      if (running->len > 0)
+        {
+          guint position = g_array_index (running_positions, guint, running_positions->len - 1);
+          foundry_build_progress_set_current_stage (self, g_ptr_array_index (self->stages, position));
+        }
     }
 
-  if (g_set_object (&self->current_stage, NULL))
-    g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_PHASE]);
+  foundry_build_progress_set_current_stage (self, NULL);
+
+  foundry_build_progress_record (self, "build", started_at, begin, records, FALSE, error);
+
+  if (error != NULL)
+    return dex_future_new_for_error (g_steal_pointer (&error));
 
   return dex_future_new_true ();
 }
@@ -297,23 +609,45 @@ foundry_build_progress_clean_fiber (gpointer user_data)
 {
   FoundryBuildProgress *self = user_data;
   g_autoptr(FoundryInhibitor) inhibitor = NULL;
+  g_autoptr(GDateTime) started_at = NULL;
+  g_autoptr(GPtrArray) records = NULL;
   g_autoptr(GError) error = NULL;
+  gint64 begin;
 
   g_assert (FOUNDRY_IS_BUILD_PROGRESS (self));
 
   if (!(inhibitor = foundry_contextual_inhibit (FOUNDRY_CONTEXTUAL (self), &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
+  started_at = g_date_time_new_now_local ();
+  begin = g_get_monotonic_time ();
+  records = g_ptr_array_new_with_free_func ((GDestroyNotify) _foundry_build_history_stage_unref);
+
   for (guint i = self->stages->len; i > 0; i--)
     {
       g_autoptr(FoundryBuildStage) stage = g_object_ref (g_ptr_array_index (self->stages, i - 1));
+      FoundryBuildHistoryStage *record = _foundry_build_history_stage_new (stage);
 
       g_assert (FOUNDRY_IS_BUILD_STAGE (stage));
 
+      g_ptr_array_add (records, record);
+
+      _foundry_build_history_stage_begin (record);
+
       if (!dex_await (foundry_build_stage_clean (stage, self), &error))
-        return dex_future_new_for_error (g_steal_pointer (&error));
+        {
+          _foundry_build_history_stage_end (record, FOUNDRY_BUILD_HISTORY_STATUS_FAILED, error);
+          break;
+        }
+
+      _foundry_build_history_stage_end (record, FOUNDRY_BUILD_HISTORY_STATUS_SUCCESS, NULL);
     }
 
+  foundry_build_progress_record (self, "clean", started_at, begin, records, TRUE, error);
+
+  if (error != NULL)
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
   return dex_future_new_true ();
 }
 
@@ -24,9 +24,27 @@
 
 G_BEGIN_DECLS
 
-gboolean _foundry_build_stage_matches      (FoundryBuildStage         *self,
-                                            FoundryBuildPipelinePhase  phase);
-void     _foundry_build_stage_set_pipeline (FoundryBuildStage         *self,
-                                            FoundryBuildPipeline      *pipeline);
+typedef enum _FoundryBuildStageResource
+{
+  FOUNDRY_BUILD_STAGE_RESOURCE_NONE    = 0,
+  FOUNDRY_BUILD_STAGE_RESOURCE_CPU     = 1 << 0,
+  FOUNDRY_BUILD_STAGE_RESOURCE_IO      = 1 << 1,
+  FOUNDRY_BUILD_STAGE_RESOURCE_NETWORK = 1 << 2,
+} FoundryBuildStageResource;
+
+gboolean                  _foundry_build_stage_matches        (FoundryBuildStage         *self,
+                                                               FoundryBuildPipelinePhase  phase);
+void                      _foundry_build_stage_set_pipeline   (FoundryBuildStage         *self,
+                                                               FoundryBuildPipeline      *pipeline);
+gboolean                  _foundry_build_stage_depends_on     (FoundryBuildStage         *self,
+                                                               FoundryBuildStage         *other);
+FoundryBuildStageResource _foundry_build_stage_get_resources  (FoundryBuildStage         *self);
+void                      _foundry_build_stage_set_resources  (FoundryBuildStage         *self,
+                                                               FoundryBuildStageResource  resources);
+gboolean                  _foundry_build_stage_get_ordered    (FoundryBuildStage         *self);
+void                      _foundry_build_stage_set_ordered    (FoundryBuildStage         *self,
+                                                               gboolean                   ordered);
+void                      _foundry_build_stage_add_dependency (FoundryBuildStage         *self,
+                                                               FoundryBuildStage         *dependency);
 
 G_END_DECLS
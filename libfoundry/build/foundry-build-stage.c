@@ -37,7 +37,10 @@ typedef struct
   GWeakRef pipeline_wr;
   char *kind;
   char *title;
+  GPtrArray *dependencies;
+  FoundryBuildStageResource resources;
   guint completed : 1;
+  guint unordered : 1;
 } FoundryBuildStagePrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (FoundryBuildStage, foundry_build_stage, FOUNDRY_TYPE_CONTEXTUAL)
@@ -118,6 +121,7 @@ foundry_build_stage_finalize (GObject *object)
 
   g_weak_ref_clear (&priv->pipeline_wr);
 
+  g_clear_pointer (&priv->dependencies, g_ptr_array_unref);
   g_clear_pointer (&priv->kind, g_free);
   g_clear_pointer (&priv->title, g_free);
 
@@ -253,6 +257,7 @@ foundry_build_stage_init (FoundryBuildStage *self)
   FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
 
   priv->kind = g_strdup ("unspecified");
+  priv->resources = FOUNDRY_BUILD_STAGE_RESOURCE_CPU;
 }
 
 FoundryBuildPipelinePhase
@@ -571,3 +576,98 @@ foundry_build_stage_list_build_targets (FoundryBuildStage *self)
 
   return foundry_future_new_not_supported ();
 }
+
+/* Stages default to FOUNDRY_BUILD_STAGE_RESOURCE_CPU. The build progress
+ * avoids running more than one CPU or network bound stage at a time since
+ * those generally saturate the resource on their own.
+ */
+FoundryBuildStageResource
+_foundry_build_stage_get_resources (FoundryBuildStage *self)
+{
+  FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
+
+  g_return_val_if_fail (FOUNDRY_IS_BUILD_STAGE (self), 0);
+
+  return priv->resources;
+}
+
+void
+_foundry_build_stage_set_resources (FoundryBuildStage         *self,
+                                    FoundryBuildStageResource  resources)
+{
+  FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
+
+  g_return_if_fail (FOUNDRY_IS_BUILD_STAGE (self));
+
+  priv->resources = resources;
+}
+
+gboolean
+_foundry_build_stage_get_ordered (FoundryBuildStage *self)
+{
+  FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
+
+  g_return_val_if_fail (FOUNDRY_IS_BUILD_STAGE (self), FALSE);
+
+  return !priv->unordered;
+}
+
+/* By default a stage will not run until every stage before it in the
+ * pipeline has completed. Unordered stages only wait for the stages
+ * added with _foundry_build_stage_add_dependency().
+ */
+void
+_foundry_build_stage_set_ordered (FoundryBuildStage *self,
+                                  gboolean           ordered)
+{
+  FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
+
+  g_return_if_fail (FOUNDRY_IS_BUILD_STAGE (self));
+
+  priv->unordered = !ordered;
+}
+
+/* Dependencies on stages which are not part of the same build, or which
+ * would run after @self in the pipeline, are ignored.
+ */
+void
+_foundry_build_stage_add_dependency (FoundryBuildStage *self,
+                                     FoundryBuildStage *dependency)
+{
+  FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
+
+  g_return_if_fail (FOUNDRY_IS_BUILD_STAGE (self));
+  g_return_if_fail (FOUNDRY_IS_BUILD_STAGE (dependency));
+  g_return_if_fail (self != dependency);
+
+  if (priv->dependencies == NULL)
+    priv->dependencies = g_ptr_array_new_with_free_func ((GDestroyNotify) foundry_weak_ref_free);
+
+  g_ptr_array_add (priv->dependencies, foundry_weak_ref_new (dependency));
+}
+
+gboolean
+_foundry_build_stage_depends_on (FoundryBuildStage *self,
+                                 FoundryBuildStage *other)
+{
+  FoundryBuildStagePrivate *priv = foundry_build_stage_get_instance_private (self);
+
+  g_return_val_if_fail (FOUNDRY_IS_BUILD_STAGE (self), FALSE);
+  g_return_val_if_fail (FOUNDRY_IS_BUILD_STAGE (other), FALSE);
+
+  if (!priv->unordered)
+    return TRUE;
+
+  if (priv->dependencies == NULL)
+    return FALSE;
+
+  for (guint i = 0; i < priv->dependencies->len; i++)
+    {
+      g_autoptr(FoundryBuildStage) dependency = g_weak_ref_get (g_ptr_array_index (priv->dependencies, i));
+
+      if (dependency == other)
+        return TRUE;
+    }
+
+  return FALSE;
+}
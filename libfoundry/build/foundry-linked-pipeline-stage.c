@@ -22,8 +22,9 @@
 
 #include <glib/gi18n-lib.h>
 
-#include "foundry-linked-pipeline-stage.h"
 #include "foundry-build-progress.h"
+#include "foundry-build-stage-private.h"
+#include "foundry-linked-pipeline-stage.h"
 
 /**
  * FoundryLinkedPipelineStage:
@@ -247,12 +248,32 @@ foundry_linked_pipeline_stage_set_property (GObject      *object,
     }
 }
 
+static void
+foundry_linked_pipeline_stage_constructed (GObject *object)
+{
+  FoundryLinkedPipelineStage *self = (FoundryLinkedPipelineStage *)object;
+
+  G_OBJECT_CLASS (foundry_linked_pipeline_stage_parent_class)->constructed (object);
+
+  /* Stopping the linked pipeline short of installing it cannot affect
+   * anything in our pipeline, so there is no reason to wait for earlier
+   * stages. This lets the autogen of several linked pipelines run at the
+   * same time. The linked pipeline limits its own stages.
+   */
+  if (FOUNDRY_BUILD_PIPELINE_PHASE_MASK (self->linked_phase) < FOUNDRY_BUILD_PIPELINE_PHASE_INSTALL)
+    {
+      _foundry_build_stage_set_ordered (FOUNDRY_BUILD_STAGE (self), FALSE);
+      _foundry_build_stage_set_resources (FOUNDRY_BUILD_STAGE (self), FOUNDRY_BUILD_STAGE_RESOURCE_NONE);
+    }
+}
+
 static void
 foundry_linked_pipeline_stage_class_init (FoundryLinkedPipelineStageClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   FoundryBuildStageClass *build_stage_class = FOUNDRY_BUILD_STAGE_CLASS (klass);
 
+  object_class->constructed = foundry_linked_pipeline_stage_constructed;
   object_class->dispose = foundry_linked_pipeline_stage_dispose;
   object_class->get_property = foundry_linked_pipeline_stage_get_property;
   object_class->set_property = foundry_linked_pipeline_stage_set_property;
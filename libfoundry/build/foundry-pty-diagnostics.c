@@ -20,6 +20,12 @@
 
 #include "config.h"
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
+#include <string.h>
+
 #include <glib/gstdio.h>
 
 #include "foundry-build-manager.h"
@@ -29,7 +35,8 @@
 #include "foundry-diagnostic-builder.h"
 #include "foundry-diagnostic-manager-private.h"
 #include "foundry-path.h"
-#include "foundry-pty-diagnostics.h"
+#include "foundry-pty-diagnostics-private.h"
+#include "foundry-util.h"
 
 #include "line-reader-private.h"
 #include "pty-intercept.h"
@@ -40,16 +47,65 @@
  * Custom PTY intermediate that can extract diagnostics.
  */
 
+/* Complete lines are handed to a worker fiber on the thread pool so that
+ * matching regexes never stalls the main loop. At most MAX_QUEUED chunks
+ * are in the channel at once; while it is full, output accumulates in a
+ * backlog which is sent as a single chunk once there is room again.
+ *
+ * Lines longer than MAX_CARRY without a newline are scanned anyway so a
+ * misbehaving program cannot grow the carry buffer without bound.
+ *
+ * Chunks and the matches delivered back are stamped with the generation
+ * they were queued in. foundry_pty_diagnostics_reset() starts a new
+ * generation so that output already in flight is discarded.
+ */
+#define MAX_QUEUED 16
+#define MAX_CARRY  (64 * 1024)
+
+typedef struct _Pattern
+{
+  GRegex   *regex;
+  gboolean  prefilter;
+} Pattern;
+
+typedef struct _Match
+{
+  char   *filename;
+  char   *message;
+  char   *level;
+  gint64  line;
+  gint64  column;
+  guint   relative_to_directory : 1;
+} Match;
+
+typedef struct _Chunk
+{
+  GBytes *bytes;
+  guint   generation;
+} Chunk;
+
+typedef struct _Worker
+{
+  GWeakRef   *self_wr;
+  DexChannel *channel;
+  char       *errfmt_current_dir;
+  char       *errfmt_top_dir;
+  guint       generation;
+} Worker;
+
 struct _FoundryPtyDiagnostics
 {
   FoundryContextual  parent_instance;
   GListStore        *diagnostics;
   GFile             *workdir;
   char              *builddir;
-  char              *errfmt_current_dir;
-  char              *errfmt_top_dir;
+  DexChannel        *channel;
+  DexFuture         *send;
+  GByteArray        *carry;
+  GByteArray        *backlog;
   int                pty_fd;
   PtyIntercept       intercept;
+  guint              generation;
   guint              registered : 1;
 };
 
@@ -83,10 +139,91 @@ list_model_iface_init (GListModelInterface *iface)
 G_DEFINE_FINAL_TYPE_WITH_CODE (FoundryPtyDiagnostics, foundry_pty_diagnostics, FOUNDRY_TYPE_CONTEXTUAL,
                                G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, list_model_iface_init))
 
-G_LOCK_DEFINE (all_regexes);
-static GPtrArray *all_regexes;
+/* all_patterns is replaced rather than modified when registering so the
+ * worker only needs the lock long enough to take a reference.
+ */
+G_LOCK_DEFINE (all_patterns);
+static GArray *all_patterns;
 static GHashTable *severities;
 
+static void foundry_pty_diagnostics_register_full (GRegex   *regex,
+                                                   gboolean  prefilter);
+
+static void
+pattern_clear (gpointer data)
+{
+  Pattern *pattern = data;
+
+  g_clear_pointer (&pattern->regex, g_regex_unref);
+}
+
+static Chunk *
+chunk_new (GBytes *bytes,
+           guint   generation)
+{
+  Chunk *chunk = g_atomic_rc_box_new0 (Chunk);
+  chunk->bytes = bytes;
+  chunk->generation = generation;
+  return chunk;
+}
+
+static Chunk *
+chunk_ref (Chunk *chunk)
+{
+  return g_atomic_rc_box_acquire (chunk);
+}
+
+static void
+chunk_finalize (gpointer data)
+{
+  Chunk *chunk = data;
+
+  g_clear_pointer (&chunk->bytes, g_bytes_unref);
+}
+
+static void
+chunk_unref (Chunk *chunk)
+{
+  g_atomic_rc_box_release_full (chunk, chunk_finalize);
+}
+
+G_DEFINE_BOXED_TYPE (Chunk, chunk, chunk_ref, chunk_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Chunk, chunk_unref)
+
+static void
+match_free (Match *match)
+{
+  g_clear_pointer (&match->filename, g_free);
+  g_clear_pointer (&match->message, g_free);
+  g_clear_pointer (&match->level, g_free);
+  g_free (match);
+}
+
+/* Shared between the worker and each delivery to the main thread */
+static GWeakRef *
+shared_weak_ref_new (gpointer instance)
+{
+  GWeakRef *wr = g_atomic_rc_box_new0 (GWeakRef);
+  g_weak_ref_init (wr, instance);
+  return wr;
+}
+
+static void
+shared_weak_ref_release (GWeakRef *wr)
+{
+  g_atomic_rc_box_release_full (wr, (GDestroyNotify) g_weak_ref_clear);
+}
+
+static void
+worker_free (Worker *worker)
+{
+  g_clear_pointer (&worker->self_wr, shared_weak_ref_release);
+  g_clear_pointer (&worker->errfmt_current_dir, g_free);
+  g_clear_pointer (&worker->errfmt_top_dir, g_free);
+  dex_clear (&worker->channel);
+  g_free (worker);
+}
+
 static void
 foundry_pty_diagnostics_dispose (GObject *object)
 {
@@ -104,6 +241,10 @@ foundry_pty_diagnostics_dispose (GObject *object)
       self->registered = FALSE;
     }
 
+  /* Lets the worker drain what was queued and then exit */
+  if (self->channel != NULL && dex_channel_can_send (self->channel))
+    dex_channel_close_send (self->channel);
+
   G_OBJECT_CLASS (foundry_pty_diagnostics_parent_class)->dispose (object);
 }
 
@@ -116,8 +257,11 @@ foundry_pty_diagnostics_finalize (GObject *object)
   g_clear_object (&self->workdir);
 
   g_clear_pointer (&self->builddir, g_free);
-  g_clear_pointer (&self->errfmt_current_dir, g_free);
-  g_clear_pointer (&self->errfmt_top_dir, g_free);
+  g_clear_pointer (&self->carry, g_byte_array_unref);
+  g_clear_pointer (&self->backlog, g_byte_array_unref);
+
+  dex_clear (&self->send);
+  dex_clear (&self->channel);
 
   if (IS_PTY_INTERCEPT (&self->intercept))
     pty_intercept_clear (&self->intercept);
@@ -180,49 +324,71 @@ foundry_pty_diagnostics_class_init (FoundryPtyDiagnosticsClass *klass)
 #undef ADD
 
   /* Arduino */
-  foundry_pty_diagnostics_register (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+\\.ino):"
-                                                 "(?<line>\\d+):"
-                                                 "(?<column>\\d+): "
-                                                 ".+(?<level>(?:error|warning)): "
-                                                 "(?<message>.*)",
-                                                 G_REGEX_OPTIMIZE, 0, NULL));
+  foundry_pty_diagnostics_register_full (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+\\.ino):"
+                                                      "(?<line>\\d+):"
+                                                      "(?<column>\\d+): "
+                                                      ".+(?<level>(?:error|warning)): "
+                                                      "(?<message>.*)",
+                                                      G_REGEX_OPTIMIZE, 0, NULL),
+                                         TRUE);
 
   /* Dub */
-  foundry_pty_diagnostics_register (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+.d)"
-                                                 "(?<line>\\(\\d+),(?<column>\\d+)\\)"
-                                                 ": (?<level>.+(?=:))(?<message>.*)",
-                                                 G_REGEX_OPTIMIZE, 0, NULL));
+  foundry_pty_diagnostics_register_full (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+.d)"
+                                                      "(?<line>\\(\\d+),(?<column>\\d+)\\)"
+                                                      ": (?<level>.+(?=:))(?<message>.*)",
+                                                      G_REGEX_OPTIMIZE, 0, NULL),
+                                         TRUE);
 
   /* GCC */
-  foundry_pty_diagnostics_register (g_regex_new ("(?<filename>[a-zA-Z0-9\\+\\-\\.\\/_]+):"
-                                                 "(?<line>\\d+):"
-                                                 "(?<column>\\d+): "
-                                                 "(?<level>[\\w\\s]+): "
-                                                 "(?<message>.*)",
-                                                 G_REGEX_OPTIMIZE, 0, NULL));
+  foundry_pty_diagnostics_register_full (g_regex_new ("(?<filename>[a-zA-Z0-9\\+\\-\\.\\/_]+):"
+                                                      "(?<line>\\d+):"
+                                                      "(?<column>\\d+): "
+                                                      "(?<level>[\\w\\s]+): "
+                                                      "(?<message>.*)",
+                                                      G_REGEX_OPTIMIZE, 0, NULL),
+                                         TRUE);
 
   /* Mono */
-  foundry_pty_diagnostics_register (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+.cs)"
-                                                 "\\((?<line>\\d+),(?<column>\\d+)\\): "
-                                                 "(?<level>[\\w\\s]+) "
-                                                 "(?<code>CS[0-9]+): "
-                                                 "(?<message>.*)",
-                                                 G_REGEX_OPTIMIZE, 0, NULL));
+  foundry_pty_diagnostics_register_full (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+.cs)"
+                                                      "\\((?<line>\\d+),(?<column>\\d+)\\): "
+                                                      "(?<level>[\\w\\s]+) "
+                                                      "(?<code>CS[0-9]+): "
+                                                      "(?<message>.*)",
+                                                      G_REGEX_OPTIMIZE, 0, NULL),
+                                         TRUE);
 
   /* Vala */
-  foundry_pty_diagnostics_register (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+.vala):"
-                                                 "(?<line>\\d+).(?<column>\\d+)-(?<line2>\\d+).(?<column2>\\d+): "
-                                                 "(?<level>[\\w\\s]+): "
-                                                 "(?<message>.*)",
-                                                 G_REGEX_OPTIMIZE, 0, NULL));
+  foundry_pty_diagnostics_register_full (g_regex_new ("(?<filename>[a-zA-Z0-9\\-\\.\\/_]+.vala):"
+                                                      "(?<line>\\d+).(?<column>\\d+)-(?<line2>\\d+).(?<column2>\\d+): "
+                                                      "(?<level>[\\w\\s]+): "
+                                                      "(?<message>.*)",
+                                                      G_REGEX_OPTIMIZE, 0, NULL),
+                                         TRUE);
 }
 
+static DexFuture *foundry_pty_diagnostics_worker_fiber (gpointer data);
+
 static void
 foundry_pty_diagnostics_init (FoundryPtyDiagnostics *self)
 {
+  Worker *worker;
+
   self->diagnostics = g_list_store_new (FOUNDRY_TYPE_DIAGNOSTIC);
+  self->channel = dex_channel_new (MAX_QUEUED);
+  self->carry = g_byte_array_new ();
+  self->backlog = g_byte_array_new ();
   self->pty_fd = -1;
 
+  worker = g_new0 (Worker, 1);
+  worker->self_wr = shared_weak_ref_new (self);
+  worker->channel = dex_ref (self->channel);
+
+  dex_future_disown (dex_scheduler_spawn (dex_thread_pool_scheduler_get_default (),
+                                          0,
+                                          foundry_pty_diagnostics_worker_fiber,
+                                          worker,
+                                          (GDestroyNotify) worker_free));
+
   g_signal_connect_object (self->diagnostics,
                            "items-changed",
                            G_CALLBACK (g_list_model_items_changed),
@@ -231,16 +397,16 @@ foundry_pty_diagnostics_init (FoundryPtyDiagnostics *self)
 }
 
 static gboolean
-extract_directory_change (FoundryPtyDiagnostics *self,
-                          const guint8          *data,
-                          gsize                  len)
+extract_directory_change (Worker       *worker,
+                          const guint8 *data,
+                          gsize         len)
 {
   g_autofree gchar *dir = NULL;
   const guint8 *begin;
 
-  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+  g_assert (worker != NULL);
 
-  if (len == 0)
+  if (len == 0 || data[len - 1] != '\'')
     return FALSE;
 
 #define ENTERING_DIRECTORY_BEGIN "Entering directory '"
@@ -260,15 +426,15 @@ extract_directory_change (FoundryPtyDiagnostics *self,
 
   if (g_utf8_validate (dir, len, NULL))
     {
-      g_free (self->errfmt_current_dir);
+      g_free (worker->errfmt_current_dir);
 
       if (len == 0)
-        self->errfmt_current_dir = g_strdup (self->errfmt_top_dir);
+        worker->errfmt_current_dir = g_strdup (worker->errfmt_top_dir);
       else
-        self->errfmt_current_dir = g_strndup (dir, len);
+        worker->errfmt_current_dir = g_strndup (dir, len);
 
-      if (self->errfmt_top_dir == NULL)
-        self->errfmt_top_dir = g_strdup (self->errfmt_current_dir);
+      if (worker->errfmt_top_dir == NULL)
+        worker->errfmt_top_dir = g_strdup (worker->errfmt_current_dir);
 
       return TRUE;
     }
@@ -344,33 +510,35 @@ filter_color_codes (const guint8 *data,
 static inline FoundryDiagnosticSeverity
 parse_severity (const char *str)
 {
-  guint value = GPOINTER_TO_UINT (g_hash_table_lookup (severities, str));
+  guint value;
+
+  if (str == NULL)
+    return FOUNDRY_DIAGNOSTIC_WARNING;
+
+  value = GPOINTER_TO_UINT (g_hash_table_lookup (severities, str));
+
   return value ? value : FOUNDRY_DIAGNOSTIC_WARNING;
 }
 
-static FoundryDiagnostic *
-create_diagnostic (FoundryPtyDiagnostics *self,
-                   GMatchInfo            *match_info)
+/* Parses the capture groups of a match. This runs on the worker so it
+ * must not touch the FoundryPtyDiagnostics; anything which needs the
+ * context is resolved later by create_diagnostic() on the main thread.
+ */
+static Match *
+parse_match (Worker     *worker,
+             GMatchInfo *match_info)
 {
-  g_autoptr(FoundryDiagnosticBuilder) builder = NULL;
-  g_autoptr(FoundryContext) context = NULL;
   g_autofree char *filename = NULL;
   g_autofree char *line = NULL;
   g_autofree char *column = NULL;
   g_autofree char *message = NULL;
-  g_autofree char *level = NULL;
-  g_autoptr(GFile) project_dir = NULL;
-  g_autoptr(GFile) file = NULL;
-  struct {
-    gint64 line;
-    gint64 column;
-    FoundryDiagnosticSeverity severity;
-  } parsed = { 0 };
+  Match *match;
+  gint64 parsed_line = 0;
+  gint64 parsed_column = 0;
 
-  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+  g_assert (worker != NULL);
   g_assert (match_info != NULL);
 
-  context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self));
   message = g_match_info_fetch_named (match_info, "message");
 
   /* XXX: This is a hack to ignore a common but unuseful error message.
@@ -384,62 +552,86 @@ create_diagnostic (FoundryPtyDiagnostics *self,
   filename = g_match_info_fetch_named (match_info, "filename");
   line = g_match_info_fetch_named (match_info, "line");
   column = g_match_info_fetch_named (match_info, "column");
-  level = g_match_info_fetch_named (match_info, "level");
+
+  if (filename == NULL)
+    return NULL;
 
   if (line != NULL)
     {
-      parsed.line = g_ascii_strtoll (line, NULL, 10);
-      if (parsed.line < 1 || parsed.line > G_MAXINT32)
+      parsed_line = g_ascii_strtoll (line, NULL, 10);
+      if (parsed_line < 1 || parsed_line > G_MAXINT32)
         return NULL;
-      parsed.line--;
+      parsed_line--;
     }
 
   if (column != NULL)
     {
-      parsed.column = g_ascii_strtoll (column, NULL, 10);
-      if (parsed.column < 1 || parsed.column > G_MAXINT32)
+      parsed_column = g_ascii_strtoll (column, NULL, 10);
+      if (parsed_column < 1 || parsed_column > G_MAXINT32)
         return NULL;
-      parsed.column--;
+      parsed_column--;
     }
 
-  parsed.severity = parse_severity (level);
+  match = g_new0 (Match, 1);
+  match->message = g_steal_pointer (&message);
+  match->level = g_match_info_fetch_named (match_info, "level");
+  match->line = parsed_line;
+  match->column = parsed_column;
 
   /* Expand local user only, if we get a home-relative path */
-  if (filename != NULL && strncmp (filename, "~/", 2) == 0)
+  if (strncmp (filename, "~/", 2) == 0)
     {
       char *expanded = foundry_path_expand (filename);
       g_free (filename);
       filename = expanded;
     }
 
-  if (!g_path_is_absolute (filename))
+  if (!g_path_is_absolute (filename) && worker->errfmt_current_dir != NULL)
     {
-      char *path;
+      const char *basedir = worker->errfmt_current_dir;
 
-      if (self->errfmt_current_dir != NULL)
+      if (g_str_has_prefix (basedir, worker->errfmt_top_dir))
         {
-          const char *basedir = self->errfmt_current_dir;
-
-          if (g_str_has_prefix (basedir, self->errfmt_top_dir))
-            {
-              basedir += strlen (self->errfmt_top_dir);
-              if (*basedir == G_DIR_SEPARATOR)
-                basedir++;
-            }
-
-          path = g_build_filename (basedir, filename, NULL);
-          g_free (filename);
-          filename = path;
-        }
-      else if (self->builddir != NULL)
-        {
-          path = g_build_filename (self->builddir, filename, NULL);
-          g_free (filename);
-          filename = path;
+          basedir += strlen (worker->errfmt_top_dir);
+          if (*basedir == G_DIR_SEPARATOR)
+            basedir++;
         }
+
+      match->filename = g_build_filename (basedir, filename, NULL);
+      match->relative_to_directory = TRUE;
+    }
+  else
+    {
+      match->filename = g_steal_pointer (&filename);
     }
 
-  project_dir = foundry_context_dup_project_directory (context);
+  return match;
+}
+
+static FoundryDiagnostic *
+create_diagnostic (FoundryPtyDiagnostics *self,
+                   FoundryContext        *context,
+                   GFile                 *project_dir,
+                   Match                 *match)
+{
+  g_autoptr(FoundryDiagnosticBuilder) builder = NULL;
+  g_autofree char *filename = NULL;
+
+  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+  g_assert (FOUNDRY_IS_CONTEXT (context));
+  g_assert (G_IS_FILE (project_dir));
+  g_assert (match != NULL);
+
+  filename = g_steal_pointer (&match->filename);
+
+  if (!g_path_is_absolute (filename) &&
+      !match->relative_to_directory &&
+      self->builddir != NULL)
+    {
+      char *path = g_build_filename (self->builddir, filename, NULL);
+      g_free (filename);
+      filename = path;
+    }
 
   if (!g_path_is_absolute (filename))
     {
@@ -451,30 +643,89 @@ create_diagnostic (FoundryPtyDiagnostics *self,
     }
 
   builder = foundry_diagnostic_builder_new (context);
-  foundry_diagnostic_builder_take_message (builder, g_steal_pointer (&message));
-  foundry_diagnostic_builder_set_severity (builder, parsed.severity);
+  foundry_diagnostic_builder_take_message (builder, g_steal_pointer (&match->message));
+  foundry_diagnostic_builder_set_severity (builder, parse_severity (match->level));
   foundry_diagnostic_builder_set_path (builder, filename);
-  foundry_diagnostic_builder_set_line (builder, parsed.line);
-  foundry_diagnostic_builder_set_line_offset (builder, parsed.column);
+  foundry_diagnostic_builder_set_line (builder, match->line);
+  foundry_diagnostic_builder_set_line_offset (builder, match->column);
 
   return foundry_diagnostic_builder_end (builder);
 }
 
-static void
-extract_diagnostics (FoundryPtyDiagnostics *self,
-                     const guint8          *data,
-                     gsize                  len)
+static inline gboolean
+has_prefix_ascii_ci (const char *str,
+                     gsize       len,
+                     const char *prefix,
+                     gsize       prefix_len)
 {
+  return len >= prefix_len && g_ascii_strncasecmp (str, prefix, prefix_len) == 0;
+}
+
+/* Cheap check for whether @line could be a diagnostic from one of the
+ * built-in patterns. All of them have a severity word right after a
+ * ": " so we only need to look at what follows each colon.
+ */
+static gboolean
+line_is_candidate (const char *line,
+                   gsize       len)
+{
+  static const struct {
+    const char *word;
+    gsize       len;
+  } words[] = {
+#define WORD(w) { w, sizeof w - 1 }
+    WORD ("error"),
+    WORD ("warning"),
+    WORD ("note"),
+    WORD ("fatal"),
+    WORD ("deprecat"),
+    WORD ("remark"),
+    WORD ("unused"),
+    WORD ("ignored"),
+#undef WORD
+  };
+  const char *end = line + len;
+  const char *p = line;
+
+  while ((p = memchr (p, ':', end - p)))
+    {
+      p++;
+
+      if (p < end && *p == ' ')
+        {
+          const char *word = p + 1;
+
+          for (guint i = 0; i < G_N_ELEMENTS (words); i++)
+            {
+              if (has_prefix_ascii_ci (word, end - word, words[i].word, words[i].len))
+                return TRUE;
+            }
+        }
+    }
+
+  return FALSE;
+}
+
+static GPtrArray *
+extract_diagnostics (Worker       *worker,
+                     GArray       *patterns,
+                     const guint8 *data,
+                     gsize         len)
+{
+  g_autoptr(GPtrArray) matches = NULL;
   g_autofree guint8 *unescaped = NULL;
   LineReader reader;
   gsize line_len;
   char *line;
 
-  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+  g_assert (worker != NULL);
+  g_assert (patterns != NULL);
   g_assert (data != NULL);
 
-  if (len == 0 || all_regexes == NULL)
-    return;
+  matches = g_ptr_array_new_with_free_func ((GDestroyNotify) match_free);
+
+  if (len == 0 || patterns->len == 0)
+    return g_steal_pointer (&matches);
 
   /* If we have any color escape sequences, remove them */
   if G_UNLIKELY (memchr (data, '\033', len) || memmem (data, len, "\\e", 2))
@@ -484,7 +735,7 @@ extract_diagnostics (FoundryPtyDiagnostics *self,
       unescaped = filter_color_codes (data, len, &out_len);
 
       if (out_len == 0)
-        return;
+        return g_steal_pointer (&matches);
 
       data = unescaped;
       len = out_len;
@@ -492,32 +743,243 @@ extract_diagnostics (FoundryPtyDiagnostics *self,
 
   line_reader_init (&reader, (char *)data, len);
 
-  G_LOCK (all_regexes);
-
   while (NULL != (line = line_reader_next (&reader, &line_len)))
     {
-      if (extract_directory_change (self, (const guint8 *)line, line_len))
+      gboolean candidate;
+
+      if (extract_directory_change (worker, (const guint8 *)line, line_len))
         continue;
 
-      for (guint i = 0; i < all_regexes->len; i++)
+      candidate = line_is_candidate (line, line_len);
+
+      for (guint i = 0; i < patterns->len; i++)
         {
-          const GRegex *regex = g_ptr_array_index (all_regexes, i);
+          const Pattern *pattern = &g_array_index (patterns, Pattern, i);
           g_autoptr(GMatchInfo) match_info = NULL;
 
-          if (g_regex_match_full (regex, line, line_len, 0, 0, &match_info, NULL))
+          if (pattern->prefilter && !candidate)
+            continue;
+
+          if (g_regex_match_full (pattern->regex, line, line_len, 0, 0, &match_info, NULL))
             {
-              g_autoptr(FoundryDiagnostic) diagnostic = create_diagnostic (self, match_info);
+              Match *match = parse_match (worker, match_info);
 
-              if (diagnostic != NULL)
+              if (match != NULL)
                 {
-                  g_list_store_append (self->diagnostics, diagnostic);
+                  g_ptr_array_add (matches, match);
                   break;
                 }
             }
         }
     }
 
-  G_UNLOCK (all_regexes);
+  return g_steal_pointer (&matches);
+}
+
+static void
+foundry_pty_diagnostics_take_matches (FoundryPtyDiagnostics *self,
+                                      GPtrArray             *matches,
+                                      guint                  generation)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GPtrArray) diagnostics = NULL;
+  g_autoptr(GFile) project_dir = NULL;
+
+  g_assert (FOUNDRY_IS_MAIN_THREAD ());
+  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+  g_assert (matches != NULL);
+
+  /* Output from before a reset */
+  if (generation != self->generation)
+    return;
+
+  if (!(context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
+    return;
+
+  project_dir = foundry_context_dup_project_directory (context);
+  diagnostics = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < matches->len; i++)
+    g_ptr_array_add (diagnostics,
+                     create_diagnostic (self, context, project_dir, g_ptr_array_index (matches, i)));
+
+  /* One items-changed for the whole batch */
+  g_list_store_splice (self->diagnostics,
+                       g_list_model_get_n_items (G_LIST_MODEL (self->diagnostics)),
+                       0,
+                       diagnostics->pdata,
+                       diagnostics->len);
+}
+
+typedef struct _Delivery
+{
+  GWeakRef  *self_wr;
+  GPtrArray *matches;
+  guint      generation;
+} Delivery;
+
+static void
+foundry_pty_diagnostics_deliver (gpointer data)
+{
+  Delivery *delivery = data;
+  g_autoptr(FoundryPtyDiagnostics) self = g_weak_ref_get (delivery->self_wr);
+
+  g_assert (FOUNDRY_IS_MAIN_THREAD ());
+
+  if (self != NULL)
+    foundry_pty_diagnostics_take_matches (self, delivery->matches, delivery->generation);
+
+  g_clear_pointer (&delivery->self_wr, shared_weak_ref_release);
+  g_clear_pointer (&delivery->matches, g_ptr_array_unref);
+  g_free (delivery);
+}
+
+static DexFuture *
+foundry_pty_diagnostics_worker_fiber (gpointer data)
+{
+  Worker *worker = data;
+
+  g_assert (worker != NULL);
+  g_assert (!FOUNDRY_IS_MAIN_THREAD ());
+
+  for (;;)
+    {
+      g_autoptr(GPtrArray) matches = NULL;
+      g_autoptr(GArray) patterns = NULL;
+      g_autoptr(Chunk) chunk = NULL;
+      Delivery *delivery;
+      gconstpointer buf;
+      gsize len;
+
+      if (!(chunk = dex_await_boxed (dex_channel_receive (worker->channel), NULL)))
+        break;
+
+      /* Directory changes seen before a reset no longer apply */
+      if (chunk->generation != worker->generation)
+        {
+          g_clear_pointer (&worker->errfmt_current_dir, g_free);
+          g_clear_pointer (&worker->errfmt_top_dir, g_free);
+          worker->generation = chunk->generation;
+        }
+
+      G_LOCK (all_patterns);
+      if (all_patterns != NULL)
+        patterns = g_array_ref (all_patterns);
+      G_UNLOCK (all_patterns);
+
+      if (patterns == NULL)
+        continue;
+
+      buf = g_bytes_get_data (chunk->bytes, &len);
+      matches = extract_diagnostics (worker, patterns, buf, len);
+
+      if (matches->len == 0)
+        continue;
+
+      /* The weak ref is only resolved on the main thread so the last
+       * reference to the FoundryPtyDiagnostics is never dropped here.
+       */
+      delivery = g_new0 (Delivery, 1);
+      delivery->self_wr = g_atomic_rc_box_acquire (worker->self_wr);
+      delivery->matches = g_steal_pointer (&matches);
+      delivery->generation = chunk->generation;
+
+      dex_scheduler_push (dex_scheduler_get_default (),
+                          foundry_pty_diagnostics_deliver,
+                          delivery);
+    }
+
+  return dex_future_new_true ();
+}
+
+static void foundry_pty_diagnostics_flush (FoundryPtyDiagnostics *self);
+
+static DexFuture *
+foundry_pty_diagnostics_send_fiber (gpointer data)
+{
+  GWeakRef *self_wr = data;
+  g_autoptr(FoundryPtyDiagnostics) self = NULL;
+  g_autoptr(DexFuture) send = NULL;
+
+  g_assert (FOUNDRY_IS_MAIN_THREAD ());
+
+  if (!(self = g_weak_ref_get (self_wr)) || self->send == NULL)
+    return dex_future_new_true ();
+
+  send = dex_ref (self->send);
+  g_clear_object (&self);
+
+  /* Wait for the worker to make room in the channel */
+  dex_await (dex_ref (send), NULL);
+
+  if ((self = g_weak_ref_get (self_wr)) && self->send == send)
+    {
+      dex_clear (&self->send);
+      foundry_pty_diagnostics_flush (self);
+    }
+
+  return dex_future_new_true ();
+}
+
+static void
+foundry_pty_diagnostics_flush (FoundryPtyDiagnostics *self)
+{
+  g_autoptr(GBytes) bytes = NULL;
+
+  g_assert (FOUNDRY_IS_MAIN_THREAD ());
+  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+
+  if (self->backlog->len == 0 || !dex_channel_can_send (self->channel))
+    return;
+
+  /* A send is still waiting for room, it will flush when it completes */
+  if (self->send != NULL && dex_future_is_pending (self->send))
+    return;
+
+  dex_clear (&self->send);
+
+  bytes = g_byte_array_free_to_bytes (g_steal_pointer (&self->backlog));
+  self->backlog = g_byte_array_new ();
+
+  self->send = dex_channel_send (self->channel,
+                                 dex_future_new_take_boxed (chunk_get_type (),
+                                                            chunk_new (g_steal_pointer (&bytes),
+                                                                       self->generation)));
+
+  if (dex_future_is_pending (self->send))
+    dex_future_disown (dex_scheduler_spawn (NULL, 0,
+                                            foundry_pty_diagnostics_send_fiber,
+                                            foundry_weak_ref_new (self),
+                                            (GDestroyNotify) foundry_weak_ref_free));
+}
+
+static void
+foundry_pty_diagnostics_queue (FoundryPtyDiagnostics *self,
+                               const guint8          *data,
+                               gsize                  len)
+{
+  const guint8 *last_newline;
+  gsize n_complete;
+
+  g_assert (FOUNDRY_IS_MAIN_THREAD ());
+  g_assert (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+
+  g_byte_array_append (self->carry, data, len);
+
+  /* Only complete lines are sent so that diagnostics split across
+   * reads from the PTY are not lost. The remainder is carried over.
+   */
+  if ((last_newline = memrchr (self->carry->data, '\n', self->carry->len)))
+    n_complete = last_newline - self->carry->data + 1;
+  else if (self->carry->len >= MAX_CARRY)
+    n_complete = self->carry->len;
+  else
+    return;
+
+  g_byte_array_append (self->backlog, self->carry->data, n_complete);
+  g_byte_array_remove_range (self->carry, 0, n_complete);
+
+  foundry_pty_diagnostics_flush (self);
 }
 
 static void
@@ -536,7 +998,7 @@ intercept_pty_consumer_cb (const PtyIntercept     *intercept,
   g_assert (data != NULL);
   g_assert (len > 0);
 
-  extract_diagnostics (self, data, len);
+  foundry_pty_diagnostics_queue (self, data, len);
 }
 
 static DexFuture *
@@ -610,7 +1072,10 @@ foundry_pty_diagnostics_new (FoundryContext *context,
 
   self->pty_fd = pty_fd;
 
-  pty_intercept_init (&self->intercept, self->pty_fd, NULL);
+  /* Builds can produce a lot of output. Pump it from a thread so the
+   * main loop only sees coalesced chunks for diagnostic extraction.
+   */
+  pty_intercept_init_threaded (&self->intercept, self->pty_fd, NULL);
 
   pty_intercept_set_callback (&self->intercept,
                               &self->intercept.consumer,
@@ -643,9 +1108,30 @@ foundry_pty_diagnostics_reset (FoundryPtyDiagnostics *self)
   g_return_if_fail (FOUNDRY_IS_MAIN_THREAD ());
   g_return_if_fail (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
 
+  /* Drop partial lines and the backlog not yet handed to the worker.
+   * Anything already queued or being matched belongs to the previous
+   * generation and is discarded when it is delivered.
+   */
+  g_byte_array_set_size (self->carry, 0);
+  g_byte_array_set_size (self->backlog, 0);
+  self->generation++;
+
   g_list_store_remove_all (self->diagnostics);
 }
 
+void
+_foundry_pty_diagnostics_feed (FoundryPtyDiagnostics *self,
+                               const guint8          *data,
+                               gsize                  len)
+{
+  g_return_if_fail (FOUNDRY_IS_MAIN_THREAD ());
+  g_return_if_fail (FOUNDRY_IS_PTY_DIAGNOSTICS (self));
+  g_return_if_fail (data != NULL || len == 0);
+
+  if (len > 0)
+    foundry_pty_diagnostics_queue (self, data, len);
+}
+
 /**
  * foundry_pty_diagnostics_register:
  * @regex: (transfer full):
@@ -666,14 +1152,42 @@ foundry_pty_diagnostics_reset (FoundryPtyDiagnostics *self)
 void
 foundry_pty_diagnostics_register (GRegex *regex)
 {
-  G_LOCK (all_regexes);
+  /* We cannot know what third-party patterns match, so they always run */
+  foundry_pty_diagnostics_register_full (regex, FALSE);
+}
+
+static void
+foundry_pty_diagnostics_register_full (GRegex   *regex,
+                                       gboolean  prefilter)
+{
+  GArray *patterns;
+  Pattern pattern;
+
+  g_return_if_fail (regex != NULL);
+
+  G_LOCK (all_patterns);
+
+  patterns = g_array_new (FALSE, FALSE, sizeof (Pattern));
+  g_array_set_clear_func (patterns, pattern_clear);
+
+  if (all_patterns != NULL)
+    {
+      for (guint i = 0; i < all_patterns->len; i++)
+        {
+          pattern = g_array_index (all_patterns, Pattern, i);
+          g_regex_ref (pattern.regex);
+          g_array_append_val (patterns, pattern);
+        }
+    }
 
-  if (all_regexes == NULL)
-    all_regexes = g_ptr_array_new_with_free_func ((GDestroyNotify) g_regex_unref);
+  pattern.regex = g_steal_pointer (&regex);
+  pattern.prefilter = !!prefilter;
+  g_array_append_val (patterns, pattern);
 
-  g_ptr_array_add (all_regexes, g_steal_pointer (&regex));
+  g_clear_pointer (&all_patterns, g_array_unref);
+  all_patterns = patterns;
 
-  G_UNLOCK (all_regexes);
+  G_UNLOCK (all_patterns);
 }
 
 int
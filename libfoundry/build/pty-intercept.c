@@ -26,6 +26,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -49,6 +50,47 @@
 #define MASTER_READ_PRIORITY  G_PRIORITY_DEFAULT_IDLE
 #define MASTER_WRITE_PRIORITY G_PRIORITY_HIGH
 
+/*
+ * When pumping from a thread we are no longer competing with the main loop
+ * so we can afford to batch. Reads from a PTY are capped by the line
+ * discipline (4k on Linux) so we keep reading until the buffer is full and
+ * then issue a single write. The buffer doubles every time it fills and is
+ * halved again after a run of mostly-empty reads.
+ */
+#define THREAD_BUFFER_MIN    CHANNEL_BUFFER_SIZE
+#define THREAD_BUFFER_MAX    (1024 * 1024)
+#define THREAD_SHRINK_AFTER  64
+#define THREAD_NOTIFY_MSEC   10
+#define THREAD_PENDING_MAX   (4 * 1024 * 1024)
+
+typedef struct _PtyInterceptPump
+{
+  PtyInterceptSide *side;
+  int               in_fd;
+  int               out_fd;
+  guint8           *buf;
+  gsize             buf_size;
+  gsize             buf_pos;
+  gsize             buf_len;
+  guint             n_idle;
+  GByteArray       *pending;
+} PtyInterceptPump;
+
+struct _PtyInterceptThread
+{
+  PtyIntercept     *intercept;
+  GThread          *thread;
+  GMainContext     *main_context;
+  GMutex            mutex;
+  GCond             cond;
+  GSource          *notify;
+  int               consumer_fd;
+  int               producer_fd;
+  int               wakeup[2];
+  PtyInterceptPump  pumps[2];
+  guint             shutdown : 1;
+};
+
 static void     _pty_intercept_sclose (PtyInterceptSide *side);
 static gboolean _pty_intercept_in_cb  (GIOChannel          *channel,
                                        GIOCondition         condition,
@@ -423,9 +465,9 @@ pty_intercept_set_size (PtyIntercept *self,
 
   g_return_val_if_fail (IS_PTY_INTERCEPT (self), FALSE);
 
-  if (self->consumer.channel != NULL)
+  if (self->thread != NULL || self->consumer.channel != NULL)
     {
-      int fd = g_io_channel_unix_get_fd (self->consumer.channel);
+      int fd = pty_intercept_get_fd (self);
       struct winsize ws = {0};
 
       ws.ws_col = columns;
@@ -478,21 +520,15 @@ _g_io_add_watch_full_with_context (GMainContext   *main_context,
  *
  * Returns: %TRUE if successful; otherwise %FALSE
  */
-gboolean
-pty_intercept_init (PtyIntercept *self,
-                    int           fd,
-                    GMainContext *main_context)
+static gboolean
+_pty_intercept_open (int  fd,
+                     int *producer_fd_out,
+                     int *consumer_fd_out)
 {
   g_autofd int producer_fd = PTY_FD_INVALID;
   g_autofd int consumer_fd = PTY_FD_INVALID;
   struct winsize ws;
 
-  g_return_val_if_fail (self != NULL, FALSE);
-  g_return_val_if_fail (fd != -1, FALSE);
-
-  memset (self, 0, sizeof *self);
-  self->magic = PTY_INTERCEPT_MAGIC;
-
   producer_fd = pty_intercept_create_producer (fd, FALSE);
   if (producer_fd == PTY_FD_INVALID)
     return FALSE;
@@ -512,6 +548,29 @@ pty_intercept_init (PtyIntercept *self,
   if (ioctl (producer_fd, TIOCGWINSZ, &ws) >= 0)
     ioctl (consumer_fd, TIOCSWINSZ, &ws);
 
+  *producer_fd_out = g_steal_fd (&producer_fd);
+  *consumer_fd_out = g_steal_fd (&consumer_fd);
+
+  return TRUE;
+}
+
+gboolean
+pty_intercept_init (PtyIntercept *self,
+                    int           fd,
+                    GMainContext *main_context)
+{
+  g_autofd int producer_fd = PTY_FD_INVALID;
+  g_autofd int consumer_fd = PTY_FD_INVALID;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (fd != -1, FALSE);
+
+  memset (self, 0, sizeof *self);
+  self->magic = PTY_INTERCEPT_MAGIC;
+
+  if (!_pty_intercept_open (fd, &producer_fd, &consumer_fd))
+    return FALSE;
+
   if (main_context == NULL)
     main_context = g_main_context_get_thread_default ();
 
@@ -551,15 +610,385 @@ pty_intercept_init (PtyIntercept *self,
   return TRUE;
 }
 
+static gboolean
+_pty_intercept_thread_dispatch (gpointer user_data)
+{
+  PtyInterceptThread *thread = user_data;
+  g_autoptr(GByteArray) consumer = NULL;
+  g_autoptr(GByteArray) producer = NULL;
+  PtyIntercept *self = thread->intercept;
+
+  g_mutex_lock (&thread->mutex);
+
+  g_clear_pointer (&thread->notify, g_source_unref);
+
+  if (thread->pumps[0].pending->len > 0)
+    {
+      consumer = g_steal_pointer (&thread->pumps[0].pending);
+      thread->pumps[0].pending = g_byte_array_new ();
+    }
+
+  if (thread->pumps[1].pending->len > 0)
+    {
+      producer = g_steal_pointer (&thread->pumps[1].pending);
+      thread->pumps[1].pending = g_byte_array_new ();
+    }
+
+  g_cond_broadcast (&thread->cond);
+  g_mutex_unlock (&thread->mutex);
+
+  if (consumer != NULL && self->consumer.callback != NULL)
+    self->consumer.callback (self, &self->consumer, consumer->data, consumer->len, self->consumer.callback_data);
+
+  if (producer != NULL && self->producer.callback != NULL)
+    self->producer.callback (self, &self->producer, producer->data, producer->len, self->producer.callback_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * _pty_intercept_thread_notify:
+ *
+ * Called from the pump thread with data that was just read. Rather than
+ * waking the main context for every read we accumulate the data and let
+ * a single timeout deliver everything that arrived in the meantime.
+ *
+ * If the main context falls too far behind we block the pump which in
+ * turn applies back-pressure to the inferior through the PTY.
+ */
+static void
+_pty_intercept_thread_notify (PtyInterceptThread *thread,
+                              PtyInterceptPump   *pump,
+                              const guint8       *data,
+                              gsize               len)
+{
+  g_mutex_lock (&thread->mutex);
+
+  if (pump->side->callback == NULL)
+    goto unlock;
+
+  while (!thread->shutdown &&
+         pump->pending->len > 0 &&
+         pump->pending->len + len > THREAD_PENDING_MAX)
+    g_cond_wait (&thread->cond, &thread->mutex);
+
+  if (thread->shutdown)
+    goto unlock;
+
+  g_byte_array_append (pump->pending, data, len);
+
+  if (thread->notify == NULL)
+    {
+      thread->notify = g_timeout_source_new (THREAD_NOTIFY_MSEC);
+      g_source_set_static_name (thread->notify, "[pty-intercept-notify]");
+      g_source_set_callback (thread->notify, _pty_intercept_thread_dispatch, thread, NULL);
+      g_source_attach (thread->notify, thread->main_context);
+    }
+
+unlock:
+  g_mutex_unlock (&thread->mutex);
+}
+
+static void
+_pty_intercept_pump_resize (PtyInterceptPump *pump,
+                            gsize             buf_size)
+{
+  g_assert (pump->buf_len <= buf_size);
+
+  pump->buf = g_realloc (pump->buf, buf_size);
+  pump->buf_size = buf_size;
+}
+
+/* Returns FALSE if the input side has closed or failed. */
+static gboolean
+_pty_intercept_pump_read (PtyInterceptThread *thread,
+                          PtyInterceptPump   *pump)
+{
+  gsize begin;
+
+  if (pump->buf_pos > 0)
+    {
+      memmove (pump->buf, pump->buf + pump->buf_pos, pump->buf_len - pump->buf_pos);
+      pump->buf_len -= pump->buf_pos;
+      pump->buf_pos = 0;
+    }
+
+  begin = pump->buf_len;
+
+  while (pump->buf_len < pump->buf_size)
+    {
+      gssize n = read (pump->in_fd, pump->buf + pump->buf_len, pump->buf_size - pump->buf_len);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        break;
+
+      if (n <= 0)
+        {
+          if (pump->buf_len > begin)
+            _pty_intercept_thread_notify (thread, pump, pump->buf + begin, pump->buf_len - begin);
+          return FALSE;
+        }
+
+      pump->buf_len += n;
+    }
+
+  if (pump->buf_len > begin)
+    _pty_intercept_thread_notify (thread, pump, pump->buf + begin, pump->buf_len - begin);
+
+  /* We filled the buffer without draining the PTY, so allow for more
+   * next time around. Otherwise track how often we were mostly idle
+   * so that a burst doesn't pin a large buffer forever.
+   */
+  if (pump->buf_len == pump->buf_size)
+    {
+      pump->n_idle = 0;
+
+      if (pump->buf_size < THREAD_BUFFER_MAX)
+        _pty_intercept_pump_resize (pump, pump->buf_size * 2);
+    }
+  else if (pump->buf_len < pump->buf_size / 4)
+    {
+      if (++pump->n_idle >= THREAD_SHRINK_AFTER && pump->buf_size > THREAD_BUFFER_MIN)
+        {
+          pump->n_idle = 0;
+          _pty_intercept_pump_resize (pump, MAX (pump->buf_size / 2, MAX (THREAD_BUFFER_MIN, pump->buf_len)));
+        }
+    }
+
+  return TRUE;
+}
+
+/* Returns FALSE if the output side has closed or failed. */
+static gboolean
+_pty_intercept_pump_write (PtyInterceptPump *pump)
+{
+  while (pump->buf_pos < pump->buf_len)
+    {
+      gssize n = write (pump->out_fd, pump->buf + pump->buf_pos, pump->buf_len - pump->buf_pos);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return TRUE;
+
+      if (n <= 0)
+        return FALSE;
+
+      pump->buf_pos += n;
+    }
+
+  pump->buf_pos = 0;
+  pump->buf_len = 0;
+
+  return TRUE;
+}
+
+static gpointer
+_pty_intercept_thread_func (gpointer data)
+{
+  PtyInterceptThread *thread = data;
+
+  for (;;)
+    {
+      struct pollfd pfd[5];
+      guint slot[2][2];
+      guint n_pfd = 0;
+
+      pfd[n_pfd].fd = thread->wakeup[0];
+      pfd[n_pfd].events = POLLIN;
+      pfd[n_pfd].revents = 0;
+      n_pfd++;
+
+      for (guint i = 0; i < G_N_ELEMENTS (thread->pumps); i++)
+        {
+          PtyInterceptPump *pump = &thread->pumps[i];
+
+          slot[i][0] = slot[i][1] = 0;
+
+          /* Stop reading while the buffer is full so that the inferior
+           * is throttled by the PTY rather than by our memory.
+           */
+          if (pump->buf_len < pump->buf_size)
+            {
+              pfd[n_pfd].fd = pump->in_fd;
+              pfd[n_pfd].events = POLLIN;
+              pfd[n_pfd].revents = 0;
+              slot[i][0] = n_pfd++;
+            }
+
+          if (pump->buf_pos < pump->buf_len)
+            {
+              pfd[n_pfd].fd = pump->out_fd;
+              pfd[n_pfd].events = POLLOUT;
+              pfd[n_pfd].revents = 0;
+              slot[i][1] = n_pfd++;
+            }
+        }
+
+      if (poll (pfd, n_pfd, -1) < 0)
+        {
+          if (errno == EINTR)
+            continue;
+          break;
+        }
+
+      if (pfd[0].revents != 0)
+        break;
+
+      for (guint i = 0; i < G_N_ELEMENTS (thread->pumps); i++)
+        {
+          PtyInterceptPump *pump = &thread->pumps[i];
+
+          if (slot[i][0] != 0)
+            {
+              short revents = pfd[slot[i][0]].revents;
+
+              if (revents & POLLIN)
+                {
+                  if (!_pty_intercept_pump_read (thread, pump))
+                    goto finish;
+                }
+              else if (revents & (POLLERR | POLLHUP | POLLNVAL))
+                goto finish;
+            }
+
+          if (slot[i][1] != 0 && (pfd[slot[i][1]].revents & (POLLERR | POLLNVAL)))
+            goto finish;
+
+          /* Write optimistically, we most likely have room */
+          if (!_pty_intercept_pump_write (pump))
+            goto finish;
+        }
+    }
+
+finish:
+
+  return NULL;
+}
+
+/**
+ * pty_intercept_init_threaded:
+ * @self: a location of memory to store a #PtyIntercept
+ * @fd: the PTY consumer fd, possibly from a #VtePty
+ * @main_context: (nullable): a #GMainContext or %NULL for thread-default
+ *
+ * Like pty_intercept_init() but data is pumped between the PTYs from
+ * a dedicated thread instead of from @main_context.
+ *
+ * The pump uses buffers which grow while the inferior is producing
+ * output faster than we read it, so high-throughput commands do not
+ * cost a main loop iteration per 4k of output.
+ *
+ * Callbacks registered with pty_intercept_set_callback() are still
+ * executed on @main_context but are coalesced, so a single invocation
+ * may contain the data from many reads.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE
+ */
+gboolean
+pty_intercept_init_threaded (PtyIntercept *self,
+                             int           fd,
+                             GMainContext *main_context)
+{
+  g_autofd int producer_fd = PTY_FD_INVALID;
+  g_autofd int consumer_fd = PTY_FD_INVALID;
+  PtyInterceptThread *thread;
+  int wakeup[2];
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (fd != -1, FALSE);
+
+  memset (self, 0, sizeof *self);
+  self->magic = PTY_INTERCEPT_MAGIC;
+
+  if (!_pty_intercept_open (fd, &producer_fd, &consumer_fd))
+    return FALSE;
+
+  if (!g_unix_open_pipe (wakeup, O_CLOEXEC | O_NONBLOCK, NULL))
+    return FALSE;
+
+  if (main_context == NULL)
+    main_context = g_main_context_get_thread_default ();
+
+  if (main_context == NULL)
+    main_context = g_main_context_default ();
+
+  thread = g_new0 (PtyInterceptThread, 1);
+  thread->intercept = self;
+  thread->main_context = g_main_context_ref (main_context);
+  thread->consumer_fd = g_steal_fd (&consumer_fd);
+  thread->producer_fd = g_steal_fd (&producer_fd);
+  thread->wakeup[0] = wakeup[0];
+  thread->wakeup[1] = wakeup[1];
+  g_mutex_init (&thread->mutex);
+  g_cond_init (&thread->cond);
+
+  thread->pumps[0].side = &self->consumer;
+  thread->pumps[0].in_fd = thread->consumer_fd;
+  thread->pumps[0].out_fd = thread->producer_fd;
+
+  thread->pumps[1].side = &self->producer;
+  thread->pumps[1].in_fd = thread->producer_fd;
+  thread->pumps[1].out_fd = thread->consumer_fd;
+
+  for (guint i = 0; i < G_N_ELEMENTS (thread->pumps); i++)
+    {
+      thread->pumps[i].pending = g_byte_array_new ();
+      _pty_intercept_pump_resize (&thread->pumps[i], THREAD_BUFFER_MIN);
+    }
+
+  self->thread = thread;
+  self->thread->thread = g_thread_new ("[pty-intercept]", _pty_intercept_thread_func, thread);
+
+  return TRUE;
+}
+
+static void
+_pty_intercept_thread_free (PtyInterceptThread *thread)
+{
+  g_mutex_lock (&thread->mutex);
+  thread->shutdown = TRUE;
+  g_cond_broadcast (&thread->cond);
+  if (thread->notify != NULL)
+    {
+      g_source_destroy (thread->notify);
+      g_clear_pointer (&thread->notify, g_source_unref);
+    }
+  g_mutex_unlock (&thread->mutex);
+
+  while (write (thread->wakeup[1], "x", 1) < 0 && errno == EINTR) { /* Do Nothing */ }
+
+  g_thread_join (g_steal_pointer (&thread->thread));
+
+  for (guint i = 0; i < G_N_ELEMENTS (thread->pumps); i++)
+    {
+      g_clear_pointer (&thread->pumps[i].buf, g_free);
+      g_clear_pointer (&thread->pumps[i].pending, g_byte_array_unref);
+    }
+
+  g_clear_fd (&thread->consumer_fd, NULL);
+  g_clear_fd (&thread->producer_fd, NULL);
+  g_clear_fd (&thread->wakeup[0], NULL);
+  g_clear_fd (&thread->wakeup[1], NULL);
+  g_clear_pointer (&thread->main_context, g_main_context_unref);
+  g_mutex_clear (&thread->mutex);
+  g_cond_clear (&thread->cond);
+  g_free (thread);
+}
+
 /**
  * pty_intercept_clear:
  * @self: a #PtyIntercept
  *
  * Cleans up a #PtyIntercept previously initialized with
- * pty_intercept_init().
+ * pty_intercept_init() or pty_intercept_init_threaded().
  *
- * This diconnects any #GIOChannel that have been attached and
- * releases any allocated memory.
+ * This diconnects any #GIOChannel that have been attached, stops
+ * the pump thread, and releases any allocated memory.
  *
  * It is invalid to use @self after calling this function.
  */
@@ -568,6 +997,8 @@ pty_intercept_clear (PtyIntercept *self)
 {
   g_return_if_fail (IS_PTY_INTERCEPT (self));
 
+  g_clear_pointer (&self->thread, _pty_intercept_thread_free);
+
   clear_source (&self->producer.in_watch);
   clear_source (&self->producer.out_watch);
   g_clear_pointer (&self->producer.channel, g_io_channel_unref);
@@ -594,6 +1025,10 @@ int
 pty_intercept_get_fd (PtyIntercept *self)
 {
   g_return_val_if_fail (IS_PTY_INTERCEPT (self), PTY_FD_INVALID);
+
+  if (self->thread != NULL)
+    return self->thread->consumer_fd;
+
   g_return_val_if_fail (self->consumer.channel != NULL, PTY_FD_INVALID);
 
   return g_io_channel_unix_get_fd (self->consumer.channel);
@@ -620,6 +1055,12 @@ pty_intercept_set_callback (PtyIntercept         *self,
   g_return_if_fail (IS_PTY_INTERCEPT (self));
   g_return_if_fail (side == &self->consumer || side == &self->producer);
 
+  if (self->thread != NULL)
+    g_mutex_lock (&self->thread->mutex);
+
   side->callback = callback;
   side->callback_data = callback_data;
+
+  if (self->thread != NULL)
+    g_mutex_unlock (&self->thread->mutex);
 }
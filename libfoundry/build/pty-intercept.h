@@ -30,6 +30,7 @@ G_BEGIN_DECLS
 
 typedef struct _PtyIntercept PtyIntercept;
 typedef struct _PtyInterceptSide PtyInterceptSide;
+typedef struct _PtyInterceptThread PtyInterceptThread;
 
 typedef void (*PtyInterceptCallback) (const PtyIntercept     *intercept,
                                       const PtyInterceptSide *side,
@@ -51,9 +52,10 @@ struct _PtyInterceptSide
 
 struct _PtyIntercept
 {
-  gsize            magic;
-  PtyInterceptSide consumer;
-  PtyInterceptSide producer;
+  gsize               magic;
+  PtyInterceptSide    consumer;
+  PtyInterceptSide    producer;
+  PtyInterceptThread *thread;
 };
 
 int      pty_intercept_create_consumer (void);
@@ -62,6 +64,9 @@ int      pty_intercept_create_producer (int                   consumer_fd,
 gboolean pty_intercept_init            (PtyIntercept         *self,
                                         int                   fd,
                                         GMainContext         *main_context);
+gboolean pty_intercept_init_threaded   (PtyIntercept         *self,
+                                        int                   fd,
+                                        GMainContext         *main_context);
 int      pty_intercept_get_fd          (PtyIntercept         *self);
 gboolean pty_intercept_set_size        (PtyIntercept         *self,
                                         guint                 rows,
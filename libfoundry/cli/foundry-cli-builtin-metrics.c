@@ -0,0 +1,178 @@
+/* foundry-cli-builtin-metrics.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gi18n-lib.h>
+
+#include "foundry-cli-builtin-private.h"
+#include "foundry-cli-command-private.h"
+#include "foundry-context.h"
+#include "foundry-json.h"
+#include "foundry-metrics-private.h"
+#include "foundry-util-private.h"
+
+static char *
+format_nsec (gint64 nsec)
+{
+  if (nsec < 1000)
+    return g_strdup_printf ("%"G_GINT64_FORMAT"ns", nsec);
+
+  if (nsec < 1000000)
+    return g_strdup_printf ("%.1lfµs", nsec / 1000.);
+
+  if (nsec < G_GINT64_CONSTANT (1000000000))
+    return g_strdup_printf ("%.1lfms", nsec / 1000000.);
+
+  return g_strdup_printf ("%.2lfs", nsec / 1000000000.);
+}
+
+static gint64
+get_int (JsonObject *obj,
+         const char *member)
+{
+  return json_object_get_int_member_with_default (obj, member, 0);
+}
+
+static void
+print_counters (FoundryCommandLine *command_line,
+                JsonArray          *metrics)
+{
+  gboolean header = FALSE;
+
+  for (guint i = 0; i < json_array_get_length (metrics); i++)
+    {
+      JsonObject *metric = json_array_get_object_element (metrics, i);
+
+      if (metric == NULL ||
+          !foundry_str_equal0 (json_object_get_string_member_with_default (metric, "kind", NULL), "counter"))
+        continue;
+
+      if (!header)
+        {
+          foundry_command_line_print (command_line, "%-48s  %10s\n", _("Counter"), _("Value"));
+          header = TRUE;
+        }
+
+      foundry_command_line_print (command_line, "%-48s  %10"G_GINT64_FORMAT"\n",
+                                  json_object_get_string_member (metric, "name"),
+                                  get_int (metric, "value"));
+    }
+
+  if (header)
+    foundry_command_line_print (command_line, "\n");
+}
+
+static void
+print_histograms (FoundryCommandLine *command_line,
+                  JsonArray          *metrics)
+{
+  foundry_command_line_print (command_line, "%-48s  %8s  %9s  %9s  %9s  %9s  %9s\n",
+                              _("Histogram"), _("Count"), _("Mean"), _("p50"), _("p90"), _("p99"), _("Max"));
+
+  for (guint i = 0; i < json_array_get_length (metrics); i++)
+    {
+      JsonObject *metric = json_array_get_object_element (metrics, i);
+      g_autofree char *mean = NULL;
+      g_autofree char *p50 = NULL;
+      g_autofree char *p90 = NULL;
+      g_autofree char *p99 = NULL;
+      g_autofree char *max = NULL;
+
+      if (metric == NULL ||
+          !foundry_str_equal0 (json_object_get_string_member_with_default (metric, "kind", NULL), "histogram") ||
+          get_int (metric, "count") == 0)
+        continue;
+
+      mean = format_nsec (get_int (metric, "mean"));
+      p50 = format_nsec (get_int (metric, "p50"));
+      p90 = format_nsec (get_int (metric, "p90"));
+      p99 = format_nsec (get_int (metric, "p99"));
+      max = format_nsec (get_int (metric, "max"));
+
+      foundry_command_line_print (command_line, "%-48s  %8"G_GINT64_FORMAT"  %9s  %9s  %9s  %9s  %9s\n",
+                                  json_object_get_string_member (metric, "name"),
+                                  get_int (metric, "count"),
+                                  mean, p50, p90, p99, max);
+    }
+}
+
+static int
+foundry_cli_builtin_metrics_run (FoundryCommandLine *command_line,
+                                 const char * const *argv,
+                                 FoundryCliOptions  *options,
+                                 DexCancellable     *cancellable)
+{
+  FoundryObjectSerializerFormat format;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(JsonNode) metrics = NULL;
+  g_autoptr(GError) error = NULL;
+  const char *format_arg;
+
+  g_assert (FOUNDRY_IS_COMMAND_LINE (command_line));
+  g_assert (argv != NULL);
+  g_assert (!cancellable || DEX_IS_CANCELLABLE (cancellable));
+
+  /* Metrics are per-process. When run through the daemon this is the
+   * already loaded context, otherwise loading it provides the startup
+   * costs of the project.
+   */
+  if (!(context = dex_await_object (foundry_cli_options_load_context (options, command_line), &error)))
+    {
+      foundry_command_line_printerr (command_line, "%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  metrics = _foundry_metrics_dump ();
+
+  format_arg = foundry_cli_options_get_string (options, "format");
+  format = foundry_object_serializer_format_parse (format_arg);
+
+  if (format == FOUNDRY_OBJECT_SERIALIZER_FORMAT_JSON)
+    {
+      g_autofree char *str = foundry_json_node_to_string (metrics, TRUE);
+
+      foundry_command_line_print (command_line, "%s\n", str);
+
+      return EXIT_SUCCESS;
+    }
+
+  print_counters (command_line, json_node_get_array (metrics));
+  print_histograms (command_line, json_node_get_array (metrics));
+
+  return EXIT_SUCCESS;
+}
+
+void
+foundry_cli_builtin_metrics (FoundryCliCommandTree *tree)
+{
+  foundry_cli_command_tree_register (tree,
+                                     FOUNDRY_STRV_INIT ("foundry", "metrics"),
+                                     &(FoundryCliCommand) {
+                                       .options = (GOptionEntry[]) {
+                                         { "help", 0, 0, G_OPTION_ARG_NONE },
+                                         { "format", 'f', 0, G_OPTION_ARG_STRING, NULL, N_("Output format (text, json)"), N_("FORMAT") },
+                                         {0}
+                                       },
+                                       .run = foundry_cli_builtin_metrics_run,
+                                       .gettext_package = GETTEXT_PACKAGE,
+                                       .description = N_("Show latency histograms and counters for this process"),
+                                     });
+}
@@ -0,0 +1,333 @@
+/* foundry-cli-builtin-pipeline-history.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gi18n-lib.h>
+
+#include "foundry-build-history-private.h"
+#include "foundry-build-manager.h"
+#include "foundry-build-pipeline.h"
+#include "foundry-cli-builtin-private.h"
+#include "foundry-cli-command-private.h"
+#include "foundry-context.h"
+#include "foundry-json.h"
+#include "foundry-util-private.h"
+
+static char *
+format_usec (gint64 usec)
+{
+  if (ABS (usec) < G_USEC_PER_SEC)
+    return g_strdup_printf ("%"G_GINT64_FORMAT"ms", usec / 1000);
+
+  return g_strdup_printf ("%.1lfs", usec / (double)G_USEC_PER_SEC);
+}
+
+static char *
+format_delta (gint64 usec)
+{
+  g_autofree char *str = format_usec (ABS (usec));
+
+  return g_strdup_printf ("%c%s", usec < 0 ? '-' : '+', str);
+}
+
+static const char *
+get_string (JsonObject *obj,
+            const char *member)
+{
+  return json_object_get_string_member_with_default (obj, member, "");
+}
+
+static gint64
+get_int (JsonObject *obj,
+         const char *member)
+{
+  return json_object_get_int_member_with_default (obj, member, 0);
+}
+
+static gint64
+stage_usec (JsonObject *stage)
+{
+  return get_int (stage, "query-usec") + get_int (stage, "wall-usec");
+}
+
+/* Mean time spent in the stage titled @title across the runs of
+ * @operation before @last. Returns -1 if there is no prior run.
+ */
+static gint64
+average_stage_usec (JsonArray  *runs,
+                    guint       last,
+                    const char *operation,
+                    const char *title)
+{
+  gint64 total = 0;
+  guint count = 0;
+
+  for (guint i = 0; i < last; i++)
+    {
+      JsonObject *run = json_array_get_object_element (runs, i);
+      JsonArray *stages;
+
+      if (run == NULL ||
+          !g_str_equal (get_string (run, "operation"), operation) ||
+          !(stages = json_object_get_array_member (run, "stages")))
+        continue;
+
+      for (guint j = 0; j < json_array_get_length (stages); j++)
+        {
+          JsonObject *stage = json_array_get_object_element (stages, j);
+
+          if (stage != NULL &&
+              g_str_equal (get_string (stage, "title"), title) &&
+              !g_str_equal (get_string (stage, "status"), "not-run"))
+            {
+              total += stage_usec (stage);
+              count++;
+              break;
+            }
+        }
+    }
+
+  return count ? total / count : -1;
+}
+
+static gint64
+average_critical_path_usec (JsonArray  *runs,
+                            guint       last,
+                            const char *operation)
+{
+  gint64 total = 0;
+  guint count = 0;
+
+  for (guint i = 0; i < last; i++)
+    {
+      JsonObject *run = json_array_get_object_element (runs, i);
+
+      if (run != NULL &&
+          g_str_equal (get_string (run, "operation"), operation) &&
+          g_str_equal (get_string (run, "status"), "success"))
+        {
+          total += get_int (run, "critical-path-usec");
+          count++;
+        }
+    }
+
+  return count ? total / count : -1;
+}
+
+static void
+print_runs (FoundryCommandLine *command_line,
+            JsonArray          *runs)
+{
+  guint n_runs = json_array_get_length (runs);
+
+  foundry_command_line_print (command_line, "%-26s  %-9s  %-8s  %10s  %14s\n",
+                              _("Started"), _("Operation"), _("Status"), _("Wall"), _("Critical Path"));
+
+  for (guint i = 0; i < n_runs; i++)
+    {
+      JsonObject *run = json_array_get_object_element (runs, i);
+      g_autofree char *wall = NULL;
+      g_autofree char *critical = NULL;
+
+      if (run == NULL)
+        continue;
+
+      wall = format_usec (get_int (run, "wall-usec"));
+      critical = format_usec (get_int (run, "critical-path-usec"));
+
+      foundry_command_line_print (command_line, "%-26s  %-9s  %-8s  %10s  %14s\n",
+                                  get_string (run, "started-at"),
+                                  get_string (run, "operation"),
+                                  get_string (run, "status"),
+                                  wall,
+                                  critical);
+    }
+}
+
+static void
+print_last_run (FoundryCommandLine *command_line,
+                JsonArray          *runs)
+{
+  guint last = json_array_get_length (runs) - 1;
+  JsonObject *run = json_array_get_object_element (runs, last);
+  const char *operation;
+  g_autoptr(GString) path = NULL;
+  g_autofree char *critical = NULL;
+  JsonArray *critical_path;
+  JsonArray *stages;
+  gint64 critical_usec;
+  gint64 average;
+
+  if (run == NULL ||
+      !(stages = json_object_get_array_member (run, "stages")) ||
+      !(critical_path = json_object_get_array_member (run, "critical-path")))
+    return;
+
+  operation = get_string (run, "operation");
+
+  foundry_command_line_print (command_line, "\n");
+  foundry_command_line_print (command_line, "%-40s  %-8s  %8s  %8s  %8s  %10s\n",
+                              _("Stage"), _("Status"), _("Query"), _("Wall"), _("CPU"), _("Average"));
+
+  for (guint i = 0; i < json_array_get_length (stages); i++)
+    {
+      JsonObject *stage = json_array_get_object_element (stages, i);
+      g_autofree char *query = NULL;
+      g_autofree char *wall = NULL;
+      g_autofree char *cpu = NULL;
+      g_autofree char *delta = NULL;
+
+      if (stage == NULL)
+        continue;
+
+      query = format_usec (get_int (stage, "query-usec"));
+      wall = format_usec (get_int (stage, "wall-usec"));
+      cpu = format_usec (get_int (stage, "cpu-usec"));
+
+      if ((average = average_stage_usec (runs, last, operation, get_string (stage, "title"))) >= 0)
+        delta = format_delta (stage_usec (stage) - average);
+
+      foundry_command_line_print (command_line, "%-40s  %-8s  %8s  %8s  %8s  %10s\n",
+                                  get_string (stage, "title"),
+                                  get_string (stage, "status"),
+                                  query, wall, cpu,
+                                  delta ? delta : "");
+    }
+
+  path = g_string_new (NULL);
+
+  for (guint i = 0; i < json_array_get_length (critical_path); i++)
+    {
+      gint64 position = json_array_get_int_element (critical_path, i);
+      JsonObject *stage;
+
+      if (position < 0 ||
+          position >= json_array_get_length (stages) ||
+          !(stage = json_array_get_object_element (stages, position)))
+        continue;
+
+      if (path->len > 0)
+        g_string_append (path, " → ");
+
+      g_string_append (path, get_string (stage, "title"));
+    }
+
+  critical_usec = get_int (run, "critical-path-usec");
+  critical = format_usec (critical_usec);
+
+  foundry_command_line_print (command_line, "\n");
+
+  if ((average = average_critical_path_usec (runs, last, operation)) >= 0)
+    {
+      g_autofree char *delta = format_delta (critical_usec - average);
+
+      /* translators: the first %s is the duration, the second is the change compared to the average of previous runs */
+      foundry_command_line_print (command_line, _("Critical path: %s (%s compared to average)\n"), critical, delta);
+    }
+  else
+    {
+      /* translators: %s is the duration of the critical path */
+      foundry_command_line_print (command_line, _("Critical path: %s\n"), critical);
+    }
+
+  foundry_command_line_print (command_line, "  %s\n", path->str);
+}
+
+static int
+foundry_cli_builtin_pipeline_history_run (FoundryCommandLine *command_line,
+                                          const char * const *argv,
+                                          FoundryCliOptions  *options,
+                                          DexCancellable     *cancellable)
+{
+  FoundryObjectSerializerFormat format;
+  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(FoundryBuildManager) build_manager = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(JsonNode) history = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *builddir = NULL;
+  const char *format_arg;
+  JsonArray *runs;
+
+  g_assert (FOUNDRY_IS_COMMAND_LINE (command_line));
+  g_assert (argv != NULL);
+  g_assert (!cancellable || DEX_IS_CANCELLABLE (cancellable));
+
+  if (!(context = dex_await_object (foundry_cli_options_load_context (options, command_line), &error)))
+    goto handle_error;
+
+  build_manager = foundry_context_dup_build_manager (context);
+
+  if (!(pipeline = dex_await_object (foundry_build_manager_load_pipeline (build_manager), &error)))
+    goto handle_error;
+
+  builddir = foundry_build_pipeline_dup_builddir (pipeline);
+
+  if (!(history = dex_await_boxed (_foundry_build_history_load (context, builddir), &error)))
+    goto handle_error;
+
+  format_arg = foundry_cli_options_get_string (options, "format");
+  format = foundry_object_serializer_format_parse (format_arg);
+
+  if (format == FOUNDRY_OBJECT_SERIALIZER_FORMAT_JSON)
+    {
+      g_autofree char *str = foundry_json_node_to_string (history, TRUE);
+
+      foundry_command_line_print (command_line, "%s\n", str);
+
+      return EXIT_SUCCESS;
+    }
+
+  runs = json_node_get_array (history);
+
+  if (json_array_get_length (runs) == 0)
+    {
+      foundry_command_line_printerr (command_line, "%s\n", _("The pipeline has not been run yet"));
+      return EXIT_SUCCESS;
+    }
+
+  print_runs (command_line, runs);
+  print_last_run (command_line, runs);
+
+  return EXIT_SUCCESS;
+
+handle_error:
+
+  foundry_command_line_printerr (command_line, "%s\n", error->message);
+  return EXIT_FAILURE;
+}
+
+void
+foundry_cli_builtin_pipeline_history (FoundryCliCommandTree *tree)
+{
+  foundry_cli_command_tree_register (tree,
+                                     FOUNDRY_STRV_INIT ("foundry", "pipeline", "history"),
+                                     &(FoundryCliCommand) {
+                                       .options = (GOptionEntry[]) {
+                                         { "help", 0, 0, G_OPTION_ARG_NONE },
+                                         { "format", 'f', 0, G_OPTION_ARG_STRING, NULL, N_("Output format (text, json)"), N_("FORMAT") },
+                                         {0}
+                                       },
+                                       .run = foundry_cli_builtin_pipeline_history_run,
+                                       .gettext_package = GETTEXT_PACKAGE,
+                                       .description = N_("Show timing of recent pipeline runs"),
+                                     });
+}
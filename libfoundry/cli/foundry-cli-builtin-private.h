@@ -73,7 +73,9 @@ void foundry_cli_builtin_lsp_run                   (FoundryCliCommandTree *tree)
 void foundry_cli_builtin_mcp                       (FoundryCliCommandTree *tree);
 #endif
 void foundry_cli_builtin_mdoc                      (FoundryCliCommandTree *tree);
+void foundry_cli_builtin_metrics                   (FoundryCliCommandTree *tree);
 void foundry_cli_builtin_pipeline_flags            (FoundryCliCommandTree *tree);
+void foundry_cli_builtin_pipeline_history          (FoundryCliCommandTree *tree);
 void foundry_cli_builtin_pipeline_info             (FoundryCliCommandTree *tree);
 void foundry_cli_builtin_pipeline_invalidate       (FoundryCliCommandTree *tree);
 void foundry_cli_builtin_pipeline_link             (FoundryCliCommandTree *tree);
@@ -191,7 +193,9 @@ _foundry_cli_builtin_register (FoundryCliCommandTree *tree)
   foundry_cli_builtin_mcp (tree);
 #endif
   foundry_cli_builtin_mdoc (tree);
+  foundry_cli_builtin_metrics (tree);
   foundry_cli_builtin_pipeline_flags (tree);
+  foundry_cli_builtin_pipeline_history (tree);
   foundry_cli_builtin_pipeline_info (tree);
   foundry_cli_builtin_pipeline_invalidate (tree);
   foundry_cli_builtin_pipeline_link (tree);
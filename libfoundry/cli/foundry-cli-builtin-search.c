@@ -82,9 +82,12 @@ foundry_cli_builtin_search_run (FoundryCommandLine *command_line,
 
   request = foundry_search_request_new (foundry, str->str);
 
-  if (!(results = dex_await_object (foundry_search_manager_search (search_manager, request), &error)))
+  /* Wait on every provider since nothing is shown until they complete */
+  if (!(results = dex_await_object (foundry_search_manager_search_full (search_manager, request, NULL, 0, FALSE), &error)))
     goto handle_error;
 
+  dex_await (foundry_list_model_await (G_LIST_MODEL (results)), NULL);
+
   format_arg = foundry_cli_options_get_string (options, "format");
   format = foundry_object_serializer_format_parse (format_arg);
   foundry_command_line_print_list (command_line, G_LIST_MODEL (results), fields, format, FOUNDRY_TYPE_SEARCH_RESULT);
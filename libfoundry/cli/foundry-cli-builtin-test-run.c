@@ -22,86 +22,248 @@
 
 #include <glib/gi18n-lib.h>
 
-#include "foundry-build-manager.h"
-#include "foundry-build-pipeline.h"
 #include "foundry-cli-builtin-private.h"
-#include "foundry-command.h"
 #include "foundry-context.h"
+#include "foundry-json.h"
 #include "foundry-model-manager.h"
-#include "foundry-process-launcher.h"
 #include "foundry-test-manager.h"
+#include "foundry-test-runner-private.h"
 #include "foundry-test.h"
 #include "foundry-service.h"
 #include "foundry-util-private.h"
 
+static const char *
+status_to_label (FoundryTestStatus status)
+{
+  switch (status)
+    {
+    case FOUNDRY_TEST_STATUS_PASSED:
+      return "PASS";
+
+    case FOUNDRY_TEST_STATUS_FAILED:
+      return "FAIL";
+
+    case FOUNDRY_TEST_STATUS_TIMEOUT:
+      return "TIMEOUT";
+
+    case FOUNDRY_TEST_STATUS_ERROR:
+      return "ERROR";
+
+    case FOUNDRY_TEST_STATUS_NOT_RUN:
+    default:
+      return "SKIP";
+    }
+}
+
+static void
+print_result (FoundryTest       *test,
+              FoundryTestStatus  status,
+              gint64             duration_usec,
+              GBytes            *output,
+              gpointer           user_data)
+{
+  FoundryCommandLine *command_line = user_data;
+  g_autofree char *id = foundry_test_dup_id (test);
+
+  foundry_command_line_print (command_line,
+                              "%-7s %s (%.2lfs)\n",
+                              status_to_label (status),
+                              id,
+                              duration_usec / (double)G_USEC_PER_SEC);
+
+  if (status != FOUNDRY_TEST_STATUS_PASSED && output != NULL && g_bytes_get_size (output) > 0)
+    {
+      g_autofree char *str = g_utf8_make_valid (g_bytes_get_data (output, NULL), g_bytes_get_size (output));
+
+      foundry_command_line_print (command_line, "%s\n", str);
+    }
+}
+
+static gboolean
+parse_shard (const char  *str,
+             guint       *index,
+             guint       *count)
+{
+  guint64 i, n;
+  char *endptr;
+
+  /* Shards are numbered from 1 like most CI systems */
+  if (str == NULL ||
+      !(i = g_ascii_strtoull (str, &endptr, 10)) ||
+      *endptr != '/' ||
+      !(n = g_ascii_strtoull (endptr + 1, &endptr, 10)) ||
+      *endptr != 0 ||
+      i > n ||
+      n > G_MAXUINT)
+    return FALSE;
+
+  *index = i - 1;
+  *count = n;
+
+  return TRUE;
+}
+
+static gboolean
+test_in_suite (FoundryTest *test,
+               const char  *suite)
+{
+  g_auto(GStrv) suites = foundry_test_dup_suites (test);
+
+  return suites != NULL && g_strv_contains ((const char * const *)suites, suite);
+}
+
 static int
 foundry_cli_builtin_test_run_run (FoundryCommandLine *command_line,
                                   const char * const *argv,
                                   FoundryCliOptions  *options,
                                   DexCancellable     *cancellable)
 {
-  g_autoptr(FoundryProcessLauncher) launcher = NULL;
-  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
-  g_autoptr(FoundryBuildManager) build_manager = NULL;
   g_autoptr(FoundryTestManager) test_manager = NULL;
+  g_autoptr(FoundryTestRunner) runner = NULL;
   g_autoptr(FoundryContext) foundry = NULL;
-  g_autoptr(FoundryCommand) command = NULL;
-  g_autoptr(FoundryTest) test = NULL;
-  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(GListStore) selected = NULL;
   g_autoptr(GError) error = NULL;
-  const char *test_name;
+  const char *format_arg;
+  const char *shard_arg;
+  const char *suite;
+  gboolean fail_fast = FALSE;
+  gboolean junit = FALSE;
+  FoundryObjectSerializerFormat format;
+  int timeout = 0;
+  int jobs = 0;
 
   g_assert (FOUNDRY_IS_COMMAND_LINE (command_line));
   g_assert (argv != NULL);
   g_assert (!cancellable || DEX_IS_CANCELLABLE (cancellable));
 
-  if (g_strv_length ((char **)argv) < 2)
+  format_arg = foundry_cli_options_get_string (options, "format");
+  shard_arg = foundry_cli_options_get_string (options, "shard");
+  suite = foundry_cli_options_get_string (options, "suite");
+  foundry_cli_options_get_boolean (options, "fail-fast", &fail_fast);
+  foundry_cli_options_get_int (options, "timeout", &timeout);
+  foundry_cli_options_get_int (options, "jobs", &jobs);
+
+  if (g_strcmp0 (format_arg, "junit") == 0)
     {
-      foundry_command_line_printerr (command_line, "usage: %s TEST_NAME\n", argv[0]);
-      return EXIT_FAILURE;
+      junit = TRUE;
+      format = FOUNDRY_OBJECT_SERIALIZER_FORMAT_TEXT;
+    }
+  else
+    {
+      format = foundry_object_serializer_format_parse (format_arg);
     }
-
-  test_name = argv[1];
 
   if (!(foundry = dex_await_object (foundry_cli_options_load_context (options, command_line), &error)))
     goto handle_error;
 
   test_manager = foundry_context_dup_test_manager (foundry);
-  build_manager = foundry_context_dup_build_manager (foundry);
 
-  if (!dex_await (foundry_service_when_ready (FOUNDRY_SERVICE (test_manager)), &error) ||
-      !dex_await (foundry_service_when_ready (FOUNDRY_SERVICE (build_manager)), &error))
+  if (!dex_await (foundry_service_when_ready (FOUNDRY_SERVICE (test_manager)), &error))
     goto handle_error;
 
-  if (!(test = dex_await_object (foundry_test_manager_find_test (test_manager, test_name), &error)))
-    goto handle_error;
+  selected = g_list_store_new (FOUNDRY_TYPE_TEST);
 
-  if (!(command = foundry_test_dup_command (test)))
+  if (argv[1] != NULL)
     {
-      foundry_command_line_printerr (command_line, "Error: `%s` is missing a test command", test_name);
-      return EXIT_FAILURE;
+      for (guint i = 1; argv[i]; i++)
+        {
+          g_autoptr(FoundryTest) test = NULL;
+
+          if (!(test = dex_await_object (foundry_test_manager_find_test (test_manager, argv[i]), &error)))
+            goto handle_error;
+
+          /* Named tests must also match --suite when both are given */
+          if (suite != NULL && !test_in_suite (test, suite))
+            {
+              g_set_error (&error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_ARGUMENT,
+                           "Test `%s` is not in suite `%s`",
+                           argv[i], suite);
+              goto handle_error;
+            }
+
+          g_list_store_append (selected, test);
+        }
     }
+  else
+    {
+      g_autoptr(GListModel) tests = NULL;
+      guint n_items;
 
-  pipeline = dex_await_object (foundry_build_manager_load_pipeline (build_manager), NULL);
-  launcher = foundry_process_launcher_new ();
+      if (!(tests = dex_await_object (foundry_test_manager_list_tests (test_manager), &error)))
+        goto handle_error;
 
-  if (!dex_await (foundry_command_prepare (command, pipeline, launcher, FOUNDRY_BUILD_PIPELINE_PHASE_BUILD), &error))
-    goto handle_error;
+      dex_await (foundry_list_model_await (tests), NULL);
 
-  foundry_process_launcher_take_fd (launcher,
-                                    dup (foundry_command_line_get_stdout (command_line)),
-                                    STDOUT_FILENO);
-  foundry_process_launcher_take_fd (launcher,
-                                    dup (foundry_command_line_get_stderr (command_line)),
-                                    STDERR_FILENO);
+      n_items = g_list_model_get_n_items (tests);
 
-  if (!(subprocess = foundry_process_launcher_spawn (launcher, &error)))
-    goto handle_error;
+      for (guint i = 0; i < n_items; i++)
+        {
+          g_autoptr(FoundryTest) test = g_list_model_get_item (tests, i);
+
+          if (suite == NULL || test_in_suite (test, suite))
+            g_list_store_append (selected, test);
+        }
+    }
+
+  runner = foundry_test_runner_new (foundry);
+  foundry_test_runner_set_jobs (runner, MAX (0, jobs));
+  foundry_test_runner_set_fail_fast (runner, fail_fast);
+  foundry_test_runner_set_timeout (runner, (gint64)MAX (0, timeout) * G_USEC_PER_SEC);
+
+  if (shard_arg != NULL)
+    {
+      guint index;
+      guint count;
+
+      if (!parse_shard (shard_arg, &index, &count))
+        {
+          foundry_command_line_printerr (command_line, "%s\n", _("--shard must be in the form INDEX/COUNT"));
+          return EXIT_FAILURE;
+        }
+
+      foundry_test_runner_set_shard (runner, index, count);
+    }
+
+  /* A single test streams straight to the terminal like it always has */
+  if (!junit &&
+      format != FOUNDRY_OBJECT_SERIALIZER_FORMAT_JSON &&
+      g_list_model_get_n_items (G_LIST_MODEL (selected)) == 1)
+    {
+      foundry_test_runner_set_jobs (runner, 1);
+      foundry_test_runner_set_passthrough (runner,
+                                           foundry_command_line_get_stdout (command_line),
+                                           foundry_command_line_get_stderr (command_line));
+    }
+  else if (!junit && format != FOUNDRY_OBJECT_SERIALIZER_FORMAT_JSON)
+    {
+      foundry_test_runner_set_callback (runner, print_result, command_line);
+    }
 
-  if (!dex_await (dex_subprocess_wait_check (subprocess), &error))
+  if (!dex_await (foundry_test_runner_run (runner, G_LIST_MODEL (selected)), &error))
     goto handle_error;
 
-  return EXIT_SUCCESS;
+  if (junit)
+    {
+      g_autofree char *str = foundry_test_runner_to_junit (runner);
+
+      foundry_command_line_print (command_line, "%s", str);
+    }
+  else if (format == FOUNDRY_OBJECT_SERIALIZER_FORMAT_JSON)
+    {
+      g_autoptr(JsonNode) node = foundry_test_runner_to_json (runner);
+      g_autofree char *str = foundry_json_node_to_string (node, TRUE);
+
+      foundry_command_line_print (command_line, "%s\n", str);
+    }
+  else if (g_list_model_get_n_items (G_LIST_MODEL (selected)) > 1)
+    {
+      /* translators: %u is the number of tests which did not pass */
+      foundry_command_line_print (command_line, _("%u failed\n"), foundry_test_runner_get_n_failed (runner));
+    }
+
+  return foundry_test_runner_get_n_failed (runner) ? EXIT_FAILURE : EXIT_SUCCESS;
 
 handle_error:
 
@@ -117,7 +279,12 @@ foundry_cli_builtin_test_run (FoundryCliCommandTree *tree)
                                           &(FoundryCliCommand) {
                                             .options = (GOptionEntry[]) {
                                               { "help", 0, 0, G_OPTION_ARG_NONE },
-                                              { "format", 'f', 0, G_OPTION_ARG_STRING, NULL, N_("Output format (text, json)"), N_("FORMAT") },
+                                              { "format", 'f', 0, G_OPTION_ARG_STRING, NULL, N_("Output format (text, json, junit)"), N_("FORMAT") },
+                                              { "jobs", 'j', 0, G_OPTION_ARG_INT, NULL, N_("Number of tests to run at once"), N_("COUNT") },
+                                              { "shard", 0, 0, G_OPTION_ARG_STRING, NULL, N_("Only run a slice of the tests"), N_("INDEX/COUNT") },
+                                              { "suite", 0, 0, G_OPTION_ARG_STRING, NULL, N_("Only run tests in suite"), N_("SUITE") },
+                                              { "fail-fast", 0, 0, G_OPTION_ARG_NONE, NULL, N_("Stop after the first failure") },
+                                              { "timeout", 't', 0, G_OPTION_ARG_INT, NULL, N_("Timeout for each test in seconds"), N_("SECONDS") },
                                               {0}
                                             },
                                             .run = foundry_cli_builtin_test_run_run,
@@ -125,6 +292,6 @@ foundry_cli_builtin_test_run (FoundryCliCommandTree *tree)
                                             .complete = NULL,
                                             .gettext_package = GETTEXT_PACKAGE,
                                           },
-                                          N_("Run a project test"),
-                                          N_("TEST_NAME"));
+                                          N_("Run project tests"),
+                                          N_("[TEST_NAME…]"));
 }
@@ -74,7 +74,31 @@ foundry_diagnostic_builder_finalize (gpointer data)
   g_clear_object (&self->file);
   g_clear_object (&self->ranges);
   g_clear_object (&self->fixes);
+  g_clear_object (&self->markup);
   g_clear_pointer (&self->message, g_free);
+  g_clear_pointer (&self->rule_id, g_free);
+}
+
+static GListModel *
+copy_list_store (GListStore *store)
+{
+  GListModel *model = G_LIST_MODEL (store);
+  GListStore *copy;
+  guint n_items;
+
+  if (store == NULL)
+    return NULL;
+
+  copy = g_list_store_new (g_list_model_get_item_type (model));
+  n_items = g_list_model_get_n_items (model);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(GObject) item = g_list_model_get_item (model, i);
+      g_list_store_append (copy, item);
+    }
+
+  return G_LIST_MODEL (copy);
 }
 
 void
@@ -104,11 +128,15 @@ foundry_diagnostic_builder_end (FoundryDiagnosticBuilder *self)
   result->line_offset = self->line_offset;
   result->severity = self->severity;
 
+  g_set_object (&result->markup, self->markup);
   g_clear_object (&result->ranges);
   g_clear_object (&result->fixes);
 
-  result->ranges = g_steal_pointer (&result->ranges);
-  result->fixes = g_steal_pointer (&result->fixes);
+  /* The builder may be reused for further diagnostics so each one gets
+   * its own snapshot of the ranges and fixes added so far.
+   */
+  result->ranges = copy_list_store (self->ranges);
+  result->fixes = copy_list_store (self->fixes);
 
   return result;
 }
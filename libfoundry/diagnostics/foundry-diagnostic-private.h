@@ -41,4 +41,8 @@ struct _FoundryDiagnostic
   FoundryDiagnosticSeverity  severity;
 };
 
+void _foundry_diagnostic_store_update (GListStore                *store,
+                                       FoundryDiagnostic * const *diagnostics,
+                                       guint                      n_diagnostics);
+
 G_END_DECLS
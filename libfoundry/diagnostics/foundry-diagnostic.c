@@ -20,8 +20,11 @@
 
 #include "config.h"
 
+#include "foundry-diagnostic-fix-private.h"
 #include "foundry-diagnostic-private.h"
 #include "foundry-diagnostic-range.h"
+#include "foundry-markup.h"
+#include "foundry-text-edit.h"
 
 /**
  * FoundryDiagnostic:
@@ -208,6 +211,360 @@ foundry_diagnostic_init (FoundryDiagnostic *self)
 {
 }
 
+static gboolean
+foundry_diagnostic_ranges_equal (GListModel *left,
+                                 GListModel *right)
+{
+  guint n_left = left ? g_list_model_get_n_items (left) : 0;
+  guint n_right = right ? g_list_model_get_n_items (right) : 0;
+
+  if (n_left != n_right)
+    return FALSE;
+
+  for (guint i = 0; i < n_left; i++)
+    {
+      g_autoptr(FoundryDiagnosticRange) a = g_list_model_get_item (left, i);
+      g_autoptr(FoundryDiagnosticRange) b = g_list_model_get_item (right, i);
+
+      if (foundry_diagnostic_range_get_start_line (a) != foundry_diagnostic_range_get_start_line (b) ||
+          foundry_diagnostic_range_get_start_line_offset (a) != foundry_diagnostic_range_get_start_line_offset (b) ||
+          foundry_diagnostic_range_get_end_line (a) != foundry_diagnostic_range_get_end_line (b) ||
+          foundry_diagnostic_range_get_end_line_offset (a) != foundry_diagnostic_range_get_end_line_offset (b))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+foundry_diagnostic_text_edits_equal (GListModel *left,
+                                     GListModel *right)
+{
+  guint n_left = left ? g_list_model_get_n_items (left) : 0;
+  guint n_right = right ? g_list_model_get_n_items (right) : 0;
+
+  if (n_left != n_right)
+    return FALSE;
+
+  for (guint i = 0; i < n_left; i++)
+    {
+      g_autoptr(FoundryTextEdit) a = g_list_model_get_item (left, i);
+      g_autoptr(FoundryTextEdit) b = g_list_model_get_item (right, i);
+      g_autofree char *a_replacement = NULL;
+      g_autofree char *b_replacement = NULL;
+
+      if (foundry_text_edit_compare (a, b) != 0)
+        return FALSE;
+
+      a_replacement = foundry_text_edit_dup_replacement (a);
+      b_replacement = foundry_text_edit_dup_replacement (b);
+
+      if (g_strcmp0 (a_replacement, b_replacement) != 0)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+foundry_diagnostic_fixes_equal (GListModel *left,
+                                GListModel *right)
+{
+  guint n_left = left ? g_list_model_get_n_items (left) : 0;
+  guint n_right = right ? g_list_model_get_n_items (right) : 0;
+
+  if (n_left != n_right)
+    return FALSE;
+
+  for (guint i = 0; i < n_left; i++)
+    {
+      g_autoptr(FoundryDiagnosticFix) a = g_list_model_get_item (left, i);
+      g_autoptr(FoundryDiagnosticFix) b = g_list_model_get_item (right, i);
+
+      if (g_strcmp0 (a->description, b->description) != 0 ||
+          !foundry_diagnostic_text_edits_equal (a->text_edits, b->text_edits))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+foundry_diagnostic_markup_equal (FoundryMarkup *left,
+                                 FoundryMarkup *right)
+{
+  g_autoptr(GBytes) left_contents = NULL;
+  g_autoptr(GBytes) right_contents = NULL;
+
+  if (left == right)
+    return TRUE;
+
+  if (left == NULL || right == NULL)
+    return FALSE;
+
+  if (foundry_markup_get_kind (left) != foundry_markup_get_kind (right))
+    return FALSE;
+
+  left_contents = foundry_markup_dup_contents (left);
+  right_contents = foundry_markup_dup_contents (right);
+
+  return g_bytes_equal (left_contents, right_contents);
+}
+
+/**
+ * foundry_diagnostic_equal:
+ * @left: (nullable): a [class@Foundry.Diagnostic]
+ * @right: (nullable): a [class@Foundry.Diagnostic]
+ *
+ * Checks if two diagnostics describe the same problem at the same
+ * location, comparing the file, position, ranges, severity, rule,
+ * message, markup and fixes.
+ *
+ * Returns: %TRUE if @left and @right are equivalent
+ */
+gboolean
+foundry_diagnostic_equal (const FoundryDiagnostic *left,
+                          const FoundryDiagnostic *right)
+{
+  if (left == right)
+    return TRUE;
+
+  if (left == NULL || right == NULL)
+    return FALSE;
+
+  return left->line == right->line &&
+         left->line_offset == right->line_offset &&
+         left->severity == right->severity &&
+         g_strcmp0 (left->message, right->message) == 0 &&
+         g_strcmp0 (left->rule_id, right->rule_id) == 0 &&
+         (left->file == right->file ||
+          (left->file != NULL && right->file != NULL && g_file_equal (left->file, right->file))) &&
+         foundry_diagnostic_ranges_equal (left->ranges, right->ranges) &&
+         foundry_diagnostic_markup_equal (left->markup, right->markup) &&
+         foundry_diagnostic_fixes_equal (left->fixes, right->fixes);
+}
+
+/**
+ * foundry_diagnostic_hash:
+ * @data: (type Foundry.Diagnostic): a [class@Foundry.Diagnostic]
+ *
+ * Hashes the fields compared by [func@Foundry.Diagnostic.equal].
+ *
+ * Returns: a hash value suitable for a [struct@GLib.HashTable]
+ */
+guint
+foundry_diagnostic_hash (gconstpointer data)
+{
+  const FoundryDiagnostic *self = data;
+  guint hash;
+
+  if (self == NULL)
+    return 0;
+
+  hash = self->line;
+  hash = (hash << 5) - hash + self->line_offset;
+  hash = (hash << 5) - hash + self->severity;
+
+  if (self->message != NULL)
+    hash ^= g_str_hash (self->message);
+
+  return hash;
+}
+
+/**
+ * foundry_diagnostic_compare:
+ * @left: a [class@Foundry.Diagnostic]
+ * @right: a [class@Foundry.Diagnostic]
+ *
+ * Orders diagnostics by position, then by descending severity and
+ * finally by message.
+ *
+ * Returns: less than zero if @left sorts before @right, zero if they
+ *   are equivalent, and greater than zero otherwise
+ */
+int
+foundry_diagnostic_compare (FoundryDiagnostic *left,
+                            FoundryDiagnostic *right)
+{
+  g_return_val_if_fail (FOUNDRY_IS_DIAGNOSTIC (left), 0);
+  g_return_val_if_fail (FOUNDRY_IS_DIAGNOSTIC (right), 0);
+
+  if (left->line != right->line)
+    return left->line < right->line ? -1 : 1;
+
+  if (left->line_offset != right->line_offset)
+    return left->line_offset < right->line_offset ? -1 : 1;
+
+  if (left->severity != right->severity)
+    return left->severity > right->severity ? -1 : 1;
+
+  return g_strcmp0 (left->message, right->message);
+}
+
+typedef struct _Splice
+{
+  guint old_position;
+  guint n_removed;
+  guint new_position;
+  guint n_added;
+} Splice;
+
+/* Beyond this many cells of the LCS table the middle section is
+ * replaced as a single splice which is what would have happened
+ * anyway for a wholesale change like a reformat.
+ */
+#define MAX_LCS_CELLS (256 * 256)
+
+/**
+ * _foundry_diagnostic_store_update:
+ * @store: a [class@Gio.ListStore] of [class@Foundry.Diagnostic]
+ * @diagnostics: (array length=n_diagnostics): the new diagnostics
+ * @n_diagnostics: the number of elements in @diagnostics
+ *
+ * Updates @store to contain @diagnostics while keeping equivalent
+ * diagnostics already in @store in place.
+ *
+ * The common prefix and suffix are skipped and the remainder is
+ * diffed using the longest common subsequence so that only the
+ * diagnostics which actually changed are spliced. Views connected to
+ * @store therefore only re-render the affected rows.
+ */
+void
+_foundry_diagnostic_store_update (GListStore                *store,
+                                  FoundryDiagnostic * const *diagnostics,
+                                  guint                      n_diagnostics)
+{
+  g_autoptr(GPtrArray) old = NULL;
+  g_autoptr(GArray) splices = NULL;
+  g_autofree guint *old_hash = NULL;
+  g_autofree guint *new_hash = NULL;
+  g_autofree guint *lcs = NULL;
+  Splice pending = {0};
+  guint n_old;
+  guint prefix = 0;
+  guint suffix = 0;
+  guint old_len;
+  guint new_len;
+  guint stride;
+  guint i, j;
+
+  g_return_if_fail (G_IS_LIST_STORE (store));
+  g_return_if_fail (diagnostics != NULL || n_diagnostics == 0);
+
+  n_old = g_list_model_get_n_items (G_LIST_MODEL (store));
+  old = g_ptr_array_new_full (n_old, g_object_unref);
+
+  for (i = 0; i < n_old; i++)
+    g_ptr_array_add (old, g_list_model_get_item (G_LIST_MODEL (store), i));
+
+  while (prefix < n_old &&
+         prefix < n_diagnostics &&
+         foundry_diagnostic_equal (g_ptr_array_index (old, prefix), diagnostics[prefix]))
+    prefix++;
+
+  while (suffix < n_old - prefix &&
+         suffix < n_diagnostics - prefix &&
+         foundry_diagnostic_equal (g_ptr_array_index (old, n_old - suffix - 1),
+                                   diagnostics[n_diagnostics - suffix - 1]))
+    suffix++;
+
+  old_len = n_old - prefix - suffix;
+  new_len = n_diagnostics - prefix - suffix;
+
+  if (old_len == 0 && new_len == 0)
+    return;
+
+  if (old_len == 0 || new_len == 0 || (guint64)old_len * new_len > MAX_LCS_CELLS)
+    {
+      g_list_store_splice (store,
+                           prefix,
+                           old_len,
+                           (gpointer *)&diagnostics[prefix],
+                           new_len);
+      return;
+    }
+
+  old_hash = g_new (guint, old_len);
+  new_hash = g_new (guint, new_len);
+
+  for (i = 0; i < old_len; i++)
+    old_hash[i] = foundry_diagnostic_hash (g_ptr_array_index (old, prefix + i));
+
+  for (j = 0; j < new_len; j++)
+    new_hash[j] = foundry_diagnostic_hash (diagnostics[prefix + j]);
+
+#define OLD(_i) ((FoundryDiagnostic *)g_ptr_array_index (old, prefix + (_i)))
+#define NEW(_j) (diagnostics[prefix + (_j)])
+#define SAME(_i,_j) (old_hash[_i] == new_hash[_j] && foundry_diagnostic_equal (OLD (_i), NEW (_j)))
+#define LCS(_i,_j) lcs[(_i) * stride + (_j)]
+
+  /* lcs[i,j] is the length of the common subsequence of the tails
+   * starting at old[i] and new[j] so that we can walk forward.
+   */
+  stride = new_len + 1;
+  lcs = g_new0 (guint, (old_len + 1) * stride);
+
+  for (i = old_len; i-- > 0;)
+    {
+      for (j = new_len; j-- > 0;)
+        {
+          if (SAME (i, j))
+            LCS (i, j) = LCS (i + 1, j + 1) + 1;
+          else
+            LCS (i, j) = MAX (LCS (i + 1, j), LCS (i, j + 1));
+        }
+    }
+
+  splices = g_array_new (FALSE, FALSE, sizeof (Splice));
+  i = j = 0;
+
+  while (i < old_len || j < new_len)
+    {
+      if (i < old_len && j < new_len && SAME (i, j))
+        {
+          if (pending.n_removed || pending.n_added)
+            g_array_append_val (splices, pending);
+
+          i++, j++;
+
+          pending.old_position = i;
+          pending.new_position = j;
+          pending.n_removed = 0;
+          pending.n_added = 0;
+        }
+      else if (j == new_len || (i < old_len && LCS (i + 1, j) >= LCS (i, j + 1)))
+        {
+          pending.n_removed++;
+          i++;
+        }
+      else
+        {
+          pending.n_added++;
+          j++;
+        }
+    }
+
+  if (pending.n_removed || pending.n_added)
+    g_array_append_val (splices, pending);
+
+#undef OLD
+#undef NEW
+#undef SAME
+#undef LCS
+
+  /* Apply from the end so earlier positions remain valid */
+  for (guint k = splices->len; k > 0; k--)
+    {
+      const Splice *splice = &g_array_index (splices, Splice, k - 1);
+
+      g_list_store_splice (store,
+                           prefix + splice->old_position,
+                           splice->n_removed,
+                           (gpointer *)&diagnostics[prefix + splice->new_position],
+                           splice->n_added);
+    }
+}
+
 /**
  * foundry_diagnostic_get_line:
  * @self: a [class@Foundry.Diagnostic]
@@ -20,7 +20,7 @@
 
 #include "config.h"
 
-#include "foundry-diagnostic.h"
+#include "foundry-diagnostic-private.h"
 #include "foundry-model-manager.h"
 #include "foundry-on-type-diagnostics.h"
 #include "foundry-text-document.h"
@@ -41,6 +41,7 @@ struct _FoundryOnTypeDiagnostics
   GWeakRef    document_wr;
   DexPromise *disposed;
   GListModel *model;
+  GListStore *store;
   GArray     *cache;
   gulong      items_changed_handler;
 };
@@ -56,10 +57,7 @@ foundry_on_type_diagnostics_get_n_items (GListModel *model)
 {
   FoundryOnTypeDiagnostics *self = FOUNDRY_ON_TYPE_DIAGNOSTICS (model);
 
-  if (self->model == NULL)
-    return 0;
-
-  return g_list_model_get_n_items (self->model);
+  return g_list_model_get_n_items (G_LIST_MODEL (self->store));
 }
 
 static gpointer
@@ -68,10 +66,7 @@ foundry_on_type_diagnostics_get_item (GListModel *model,
 {
   FoundryOnTypeDiagnostics *self = FOUNDRY_ON_TYPE_DIAGNOSTICS (model);
 
-  if (self->model == NULL)
-    return NULL;
-
-  return g_list_model_get_item (self->model, position);
+  return g_list_model_get_item (G_LIST_MODEL (self->store), position);
 }
 
 static void
@@ -113,17 +108,17 @@ foundry_on_type_diagnostics_ensure_cache (FoundryOnTypeDiagnostics *self)
 
   g_assert (FOUNDRY_IS_ON_TYPE_DIAGNOSTICS (self));
 
-  if (self->cache != NULL || self->model == NULL)
+  if (self->cache != NULL)
     return;
 
-  n_items = g_list_model_get_n_items (G_LIST_MODEL (self));
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (self->store));
 
   self->cache = g_array_new (FALSE, FALSE, sizeof (CacheEntry));
   g_array_set_size (self->cache, n_items);
 
   for (guint i = 0; i < n_items; i++)
     {
-      g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (self->model, i);
+      g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (self->store), i);
       CacheEntry *entry = &g_array_index (self->cache, CacheEntry, i);
 
       entry->line = foundry_diagnostic_get_line (diagnostic);
@@ -157,6 +152,7 @@ foundry_on_type_diagnostics_finalize (GObject *object)
   FoundryOnTypeDiagnostics *self = (FoundryOnTypeDiagnostics *)object;
 
   dex_clear (&self->disposed);
+  g_clear_object (&self->store);
   g_weak_ref_clear (&self->document_wr);
 
   G_OBJECT_CLASS (foundry_on_type_diagnostics_parent_class)->finalize (object);
@@ -171,21 +167,85 @@ foundry_on_type_diagnostics_class_init (FoundryOnTypeDiagnosticsClass *klass)
   object_class->finalize = foundry_on_type_diagnostics_finalize;
 }
 
+static void
+foundry_on_type_diagnostics_store_items_changed (FoundryOnTypeDiagnostics *self,
+                                                 guint                     position,
+                                                 guint                     removed,
+                                                 guint                     added,
+                                                 GListModel               *store)
+{
+  g_assert (FOUNDRY_IS_ON_TYPE_DIAGNOSTICS (self));
+  g_assert (G_IS_LIST_STORE (store));
+
+  g_clear_pointer (&self->cache, g_array_unref);
+  g_list_model_items_changed (G_LIST_MODEL (self), position, removed, added);
+}
+
 static void
 foundry_on_type_diagnostics_init (FoundryOnTypeDiagnostics *self)
 {
   self->disposed = dex_promise_new ();
+  self->store = g_list_store_new (FOUNDRY_TYPE_DIAGNOSTIC);
+
+  g_signal_connect_object (self->store,
+                           "items-changed",
+                           G_CALLBACK (foundry_on_type_diagnostics_store_items_changed),
+                           self,
+                           G_CONNECT_SWAPPED);
 
   dex_future_disown (dex_ref (DEX_FUTURE (self->disposed)));
 }
 
+/* Diagnose passes produce a new model each time, most of which is
+ * identical to the previous one. Rather than swapping models and
+ * invalidating every row, diff against what we already expose so
+ * that views only see splices for the diagnostics that changed.
+ */
+static void
+foundry_on_type_diagnostics_sync (FoundryOnTypeDiagnostics *self)
+{
+  g_autoptr(GPtrArray) diagnostics = NULL;
+  guint n_items = 0;
+
+  g_assert (FOUNDRY_IS_ON_TYPE_DIAGNOSTICS (self));
+
+  if (self->model != NULL)
+    n_items = g_list_model_get_n_items (self->model);
+
+  diagnostics = g_ptr_array_new_full (n_items, g_object_unref);
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      gpointer item = g_list_model_get_item (self->model, i);
+
+      if (FOUNDRY_IS_DIAGNOSTIC (item))
+        g_ptr_array_add (diagnostics, item);
+      else
+        g_clear_object (&item);
+    }
+
+  _foundry_diagnostic_store_update (self->store,
+                                    (FoundryDiagnostic * const *)diagnostics->pdata,
+                                    diagnostics->len);
+}
+
+static void
+foundry_on_type_diagnostics_model_items_changed (FoundryOnTypeDiagnostics *self,
+                                                 guint                     position,
+                                                 guint                     removed,
+                                                 guint                     added,
+                                                 GListModel               *model)
+{
+  g_assert (FOUNDRY_IS_ON_TYPE_DIAGNOSTICS (self));
+  g_assert (G_IS_LIST_MODEL (model));
+
+  foundry_on_type_diagnostics_sync (self);
+}
+
 static void
 foundry_on_type_diagnostics_replace (FoundryOnTypeDiagnostics *self,
                                      GListModel               *model)
 {
-  guint old_n_items = 0;
-  guint new_n_items = 0;
-
   g_assert (FOUNDRY_IS_ON_TYPE_DIAGNOSTICS (self));
   g_assert (!model || G_IS_LIST_MODEL (model));
 
@@ -194,11 +254,8 @@ foundry_on_type_diagnostics_replace (FoundryOnTypeDiagnostics *self,
   if (self->model == model)
     return;
 
-  g_clear_pointer (&self->cache, g_array_unref);
-
   if (self->model != NULL)
     {
-      old_n_items = g_list_model_get_n_items (self->model);
       g_clear_signal_handler (&self->items_changed_handler, self->model);
       g_clear_object (&self->model);
     }
@@ -208,14 +265,12 @@ foundry_on_type_diagnostics_replace (FoundryOnTypeDiagnostics *self,
       self->model = g_object_ref (model);
       self->items_changed_handler = g_signal_connect_object (model,
                                                              "items-changed",
-                                                             G_CALLBACK (g_list_model_items_changed),
+                                                             G_CALLBACK (foundry_on_type_diagnostics_model_items_changed),
                                                              self,
                                                              G_CONNECT_SWAPPED);
-      new_n_items = g_list_model_get_n_items (model);
     }
 
-  if (old_n_items || new_n_items)
-    g_list_model_items_changed (G_LIST_MODEL (self), 0, old_n_items, new_n_items);
+  foundry_on_type_diagnostics_sync (self);
 }
 
 static DexFuture *
@@ -343,7 +398,7 @@ foundry_on_type_diagnostics_foreach_in_range (FoundryOnTypeDiagnostics
 
   foundry_on_type_diagnostics_ensure_cache (self);
 
-  if (self->model == NULL || self->cache == NULL || self->cache->len == 0)
+  if (self->cache == NULL || self->cache->len == 0)
     return;
 
   /* TODO: Opportunity to bsearch here when the number of diagnostics
@@ -362,7 +417,7 @@ foundry_on_type_diagnostics_foreach_in_range (FoundryOnTypeDiagnostics
         break;
 
       {
-        g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (self->model, entry->index);
+        g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (self->store), entry->index);
 
         if (diagnostic == NULL)
           break;
@@ -380,7 +435,7 @@ foundry_on_type_diagnostics_line_has_diagnostic (FoundryOnTypeDiagnostics *self,
 
   foundry_on_type_diagnostics_ensure_cache (self);
 
-  if (self->model == NULL || self->cache == NULL || self->cache->len == 0)
+  if (self->cache == NULL || self->cache->len == 0)
     return FALSE;
 
   for (guint i = 0; i < self->cache->len; i++)
@@ -44,9 +44,20 @@ struct _FoundrySimpleTextBuffer
   FoundryContext *context;
   GString        *contents;
   char           *language_id;
+  GArray         *commit_notify;
   guint           stamp;
+  guint           last_commit_notify_id;
 };
 
+typedef struct _CommitNotify
+{
+  guint                          handler_id;
+  FoundryTextBufferNotifyFlags   flags;
+  FoundryTextBufferCommitNotify  callback;
+  gpointer                       user_data;
+  GDestroyNotify                 destroy;
+} CommitNotify;
+
 enum {
   PROP_0,
   PROP_CONTEXT,
@@ -61,6 +72,15 @@ G_DEFINE_FINAL_TYPE_WITH_CODE (FoundrySimpleTextBuffer, foundry_simple_text_buff
 
 static GParamSpec *properties[N_PROPS];
 
+static void
+commit_notify_clear (gpointer data)
+{
+  CommitNotify *notify = data;
+
+  if (notify->destroy != NULL)
+    notify->destroy (notify->user_data);
+}
+
 static void
 foundry_simple_text_buffer_finalize (GObject *object)
 {
@@ -69,6 +89,7 @@ foundry_simple_text_buffer_finalize (GObject *object)
   g_clear_weak_pointer (&self->context);
 
   g_clear_pointer (&self->language_id, g_free);
+  g_clear_pointer (&self->commit_notify, g_array_unref);
 
   g_string_free (self->contents, TRUE);
   self->contents = NULL;
@@ -147,6 +168,8 @@ static void
 foundry_simple_text_buffer_init (FoundrySimpleTextBuffer *self)
 {
   self->contents = g_string_new (NULL);
+  self->commit_notify = g_array_new (FALSE, FALSE, sizeof (CommitNotify));
+  g_array_set_clear_func (self->commit_notify, commit_notify_clear);
 }
 
 /**
@@ -250,6 +273,105 @@ foundry_simple_text_buffer_get_offset_at (FoundrySimpleTextBuffer *self,
   *iter = self->contents->len;
 }
 
+/* Counts characters the same way the iterators do, where "\r\n" is
+ * a single position.
+ */
+static guint
+count_chars (const char *str,
+             gsize       len)
+{
+  const char *end = str + len;
+  guint n_chars = 0;
+
+  while (str < end)
+    {
+      if (str[0] == '\r' && str + 1 < end && str[1] == '\n')
+        str++;
+
+      str = g_utf8_next_char (str);
+      n_chars++;
+    }
+
+  return n_chars;
+}
+
+static void
+foundry_simple_text_buffer_commit_notify (FoundrySimpleTextBuffer      *self,
+                                          FoundryTextBufferNotifyFlags  flags,
+                                          guint                         position,
+                                          guint                         length)
+{
+  g_autofree guint *handler_ids = NULL;
+  guint n_handlers;
+
+  g_assert (FOUNDRY_IS_SIMPLE_TEXT_BUFFER (self));
+
+  if (self->commit_notify->len == 0)
+    return;
+
+  /* Callbacks may add or remove commit notifies, which reallocates or
+   * shifts the array. Dispatch from a snapshot of the handler ids and
+   * skip any that were removed by an earlier callback.
+   */
+  n_handlers = self->commit_notify->len;
+  handler_ids = g_new (guint, n_handlers);
+
+  for (guint i = 0; i < n_handlers; i++)
+    handler_ids[i] = g_array_index (self->commit_notify, CommitNotify, i).handler_id;
+
+  for (guint i = 0; i < n_handlers; i++)
+    {
+      for (guint j = 0; j < self->commit_notify->len; j++)
+        {
+          CommitNotify notify = g_array_index (self->commit_notify, CommitNotify, j);
+
+          if (notify.handler_id != handler_ids[i])
+            continue;
+
+          if (notify.flags & flags)
+            notify.callback (FOUNDRY_TEXT_BUFFER (self), flags, position, length, notify.user_data);
+
+          break;
+        }
+    }
+}
+
+static void
+foundry_simple_text_buffer_replace (FoundrySimpleTextBuffer *self,
+                                    gsize                    begin,
+                                    gsize                    end,
+                                    const char              *text,
+                                    gsize                    text_len)
+{
+  guint position;
+
+  g_assert (FOUNDRY_IS_SIMPLE_TEXT_BUFFER (self));
+  g_assert (begin <= end);
+  g_assert (end <= self->contents->len);
+
+  position = count_chars (self->contents->str, begin);
+
+  if (end > begin)
+    {
+      guint length = count_chars (self->contents->str + begin, end - begin);
+
+      foundry_simple_text_buffer_commit_notify (self, FOUNDRY_TEXT_BUFFER_NOTIFY_BEFORE_DELETE, position, length);
+      g_string_erase (self->contents, begin, end - begin);
+      self->stamp++;
+      foundry_simple_text_buffer_commit_notify (self, FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_DELETE, position, length);
+    }
+
+  if (text_len > 0)
+    {
+      guint length = count_chars (text, text_len);
+
+      foundry_simple_text_buffer_commit_notify (self, FOUNDRY_TEXT_BUFFER_NOTIFY_BEFORE_INSERT, position, length);
+      g_string_insert_len (self->contents, begin, text, text_len);
+      self->stamp++;
+      foundry_simple_text_buffer_commit_notify (self, FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT, position, length);
+    }
+}
+
 static gboolean
 foundry_simple_text_buffer_apply_edit (FoundryTextBuffer *text_editor,
                                        FoundryTextEdit   *edit)
@@ -275,10 +397,11 @@ foundry_simple_text_buffer_apply_edit (FoundryTextBuffer *text_editor,
 
   order (&begin, &end);
 
-  g_string_erase (self->contents, begin, end - begin);
+  replacement = foundry_text_edit_dup_replacement (edit);
 
-  if ((replacement = foundry_text_edit_dup_replacement (edit)))
-    g_string_insert (self->contents, begin, replacement);
+  foundry_simple_text_buffer_replace (self, begin, end,
+                                      replacement ? replacement : "",
+                                      replacement ? strlen (replacement) : 0);
 
   self->stamp++;
 
@@ -402,7 +525,7 @@ foundry_simple_text_iter_forward_char (FoundryTextIter *iter)
   simple->offset++;
   simple->ptr = g_utf8_next_char (simple->ptr);
 
-  return foundry_simple_text_iter_is_end (iter);
+  return !foundry_simple_text_iter_is_end (iter);
 }
 
 static gboolean
@@ -631,6 +754,46 @@ foundry_simple_text_buffer_dup_language_id (FoundryTextBuffer *buffer)
   return g_strdup (self->language_id);
 }
 
+static guint
+foundry_simple_text_buffer_add_commit_notify (FoundryTextBuffer             *buffer,
+                                              FoundryTextBufferNotifyFlags   flags,
+                                              FoundryTextBufferCommitNotify  commit_notify,
+                                              gpointer                       user_data,
+                                              GDestroyNotify                 destroy)
+{
+  FoundrySimpleTextBuffer *self = FOUNDRY_SIMPLE_TEXT_BUFFER (buffer);
+  CommitNotify notify;
+
+  notify.handler_id = ++self->last_commit_notify_id;
+  notify.flags = flags;
+  notify.callback = commit_notify;
+  notify.user_data = user_data;
+  notify.destroy = destroy;
+
+  g_array_append_val (self->commit_notify, notify);
+
+  return notify.handler_id;
+}
+
+static void
+foundry_simple_text_buffer_remove_commit_notify (FoundryTextBuffer *buffer,
+                                                 guint              commit_notify_handler)
+{
+  FoundrySimpleTextBuffer *self = FOUNDRY_SIMPLE_TEXT_BUFFER (buffer);
+
+  for (guint i = 0; i < self->commit_notify->len; i++)
+    {
+      if (g_array_index (self->commit_notify, CommitNotify, i).handler_id == commit_notify_handler)
+        {
+          g_array_remove_index (self->commit_notify, i);
+          return;
+        }
+    }
+
+  g_critical ("%s did not contain commit notify %u",
+              G_OBJECT_TYPE_NAME (self), commit_notify_handler);
+}
+
 static void
 text_buffer_iface_init (FoundryTextBufferInterface *iface)
 {
@@ -640,6 +803,8 @@ text_buffer_iface_init (FoundryTextBufferInterface *iface)
   iface->iter_init = foundry_simple_text_buffer_iter_init;
   iface->get_change_count = foundry_simple_text_buffer_get_change_count;
   iface->dup_language_id = foundry_simple_text_buffer_dup_language_id;
+  iface->add_commit_notify = foundry_simple_text_buffer_add_commit_notify;
+  iface->remove_commit_notify = foundry_simple_text_buffer_remove_commit_notify;
 }
 
 void
@@ -653,8 +818,7 @@ foundry_simple_text_buffer_set_text (FoundrySimpleTextBuffer *self,
   if (text_len < 0)
     text_len = strlen (text);
 
-  g_string_truncate (self->contents, 0);
-  g_string_append_len (self->contents, text, text_len);
+  foundry_simple_text_buffer_replace (self, 0, self->contents->len, text, text_len);
 
   self->stamp++;
 
@@ -33,5 +33,8 @@ DexFuture *_foundry_text_document_new       (FoundryContext      *context,
 void       _foundry_text_document_changed   (FoundryTextDocument *self);
 DexFuture *_foundry_text_document_pre_load  (FoundryTextDocument *self) G_GNUC_WARN_UNUSED_RESULT;
 DexFuture *_foundry_text_document_post_load (FoundryTextDocument *self) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture *_foundry_text_document_pre_save  (FoundryTextDocument *self) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture *_foundry_text_document_post_save (FoundryTextDocument *self,
+                                             GFile               *file) G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
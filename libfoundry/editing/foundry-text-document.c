@@ -885,13 +885,11 @@ typedef struct _Save
   FoundryTextBuffer   *buffer;
   GFile               *file;
   FoundryOperation    *operation;
-  GListModel          *addins;
 } Save;
 
 static void
 save_free (Save *state)
 {
-  g_clear_object (&state->addins);
   g_clear_object (&state->operation);
   g_clear_object (&state->file);
   g_clear_object (&state->buffer);
@@ -906,8 +904,6 @@ foundry_text_document_save_as_fiber (gpointer data)
   Save *state = data;
   g_autoptr(FoundryTextBufferProvider) text_buffer_provider = NULL;
   g_autoptr(FoundryTextManager) text_manager = NULL;
-  g_autoptr(GPtrArray) pre = NULL;
-  g_autoptr(GPtrArray) post = NULL;
   g_autoptr(GError) error = NULL;
 
   g_assert (state != NULL);
@@ -915,22 +911,13 @@ foundry_text_document_save_as_fiber (gpointer data)
   g_assert (FOUNDRY_IS_TEXT_DOCUMENT (state->document));
   g_assert (FOUNDRY_IS_TEXT_BUFFER (state->buffer));
   g_assert (G_IS_FILE (state->file));
-  g_assert (!state->addins || G_IS_LIST_MODEL (state->addins));
   g_assert (!state->operation || FOUNDRY_IS_OPERATION (state->operation));
 
   text_manager = foundry_context_dup_text_manager (state->context);
   text_buffer_provider = _foundry_text_manager_dup_provider (text_manager);
 
   /* Pre save phase */
-  pre = g_ptr_array_new_with_free_func (dex_unref);
-  for (guint i = 0; i < g_list_model_get_n_items (state->addins); i++)
-    {
-      g_autoptr(FoundryTextDocumentAddin) addin = g_list_model_get_item (state->addins, i);
-      g_ptr_array_add (pre, foundry_text_document_addin_pre_save (addin));
-    }
-
-  if (pre->len > 0)
-    dex_await (foundry_future_all (pre), NULL);
+  dex_await (_foundry_text_document_pre_save (state->document), NULL);
 
   /* Actual save operation */
   if (!dex_await (foundry_text_buffer_provider_save (text_buffer_provider,
@@ -943,22 +930,7 @@ foundry_text_document_save_as_fiber (gpointer data)
     return dex_future_new_for_error (g_steal_pointer (&error));
 
   /* Post save phase */
-  post = g_ptr_array_new_with_free_func (dex_unref);
-  for (guint i = 0; i < g_list_model_get_n_items (state->addins); i++)
-    {
-      g_autoptr(FoundryTextDocumentAddin) addin = g_list_model_get_item (state->addins, i);
-      g_ptr_array_add (post, foundry_text_document_addin_post_save (addin));
-    }
-
-  /* Clear settings as things may have changed */
-  dex_clear (&state->document->settings);
-
-  if (post->len > 0)
-    dex_await (foundry_future_all (post), NULL);
-
-  g_signal_emit (state->document, signals[SAVED], 0, state->file);
-
-  return dex_future_new_true ();
+  return _foundry_text_document_post_save (state->document, state->file);
 }
 
 /**
@@ -987,7 +959,6 @@ foundry_text_document_save_as (FoundryTextDocument *self,
   state->buffer = g_object_ref (self->buffer);
   state->file = g_object_ref (file);
   state->operation = operation ? g_object_ref (operation) : NULL;
-  state->addins = self->addins ? g_object_ref (G_LIST_MODEL (self->addins)) : NULL;
 
   return dex_scheduler_spawn (NULL, 0,
                               foundry_text_document_save_as_fiber,
@@ -1058,6 +1029,97 @@ _foundry_text_document_post_load (FoundryTextDocument *self)
   return dex_future_new_true ();
 }
 
+/*
+ * _foundry_text_document_pre_save:
+ *
+ * Runs the pre-save phase of the document addins. This is separate
+ * from saving so that [class@Foundry.TextManager] can save many
+ * documents as a single batch.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves when
+ *   all addins have completed.
+ */
+DexFuture *
+_foundry_text_document_pre_save (FoundryTextDocument *self)
+{
+  g_autoptr(GPtrArray) pre = NULL;
+
+  dex_return_error_if_fail (FOUNDRY_IS_TEXT_DOCUMENT (self));
+
+  if (self->addins == NULL)
+    return dex_future_new_true ();
+
+  pre = g_ptr_array_new_with_free_func (dex_unref);
+
+  for (guint i = 0; i < g_list_model_get_n_items (G_LIST_MODEL (self->addins)); i++)
+    {
+      g_autoptr(FoundryTextDocumentAddin) addin = g_list_model_get_item (G_LIST_MODEL (self->addins), i);
+
+      g_ptr_array_add (pre, foundry_text_document_addin_pre_save (addin));
+    }
+
+  if (pre->len > 0)
+    return foundry_future_all (pre);
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+foundry_text_document_post_save_fiber (FoundryTextDocument *self,
+                                       GFile               *file)
+{
+  g_autoptr(GPtrArray) post = NULL;
+
+  g_assert (FOUNDRY_IS_TEXT_DOCUMENT (self));
+  g_assert (G_IS_FILE (file));
+
+  post = g_ptr_array_new_with_free_func (dex_unref);
+
+  if (self->addins != NULL)
+    {
+      for (guint i = 0; i < g_list_model_get_n_items (G_LIST_MODEL (self->addins)); i++)
+        {
+          g_autoptr(FoundryTextDocumentAddin) addin = g_list_model_get_item (G_LIST_MODEL (self->addins), i);
+
+          g_ptr_array_add (post, foundry_text_document_addin_post_save (addin));
+        }
+    }
+
+  /* Clear settings as things may have changed */
+  dex_clear (&self->settings);
+
+  if (post->len > 0)
+    dex_await (foundry_future_all (post), NULL);
+
+  g_signal_emit (self, signals[SAVED], 0, file);
+
+  return dex_future_new_true ();
+}
+
+/*
+ * _foundry_text_document_post_save:
+ * @file: the file the document was written to
+ *
+ * Runs the post-save phase of the document addins and emits
+ * [signal@Foundry.TextDocument::saved] once they complete.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to any
+ *   value once the signal has been emitted.
+ */
+DexFuture *
+_foundry_text_document_post_save (FoundryTextDocument *self,
+                                  GFile               *file)
+{
+  dex_return_error_if_fail (FOUNDRY_IS_TEXT_DOCUMENT (self));
+  dex_return_error_if_fail (G_IS_FILE (file));
+
+  return FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
+                                  foundry_text_document_post_save_fiber,
+                                  2,
+                                  FOUNDRY_TYPE_TEXT_DOCUMENT, self,
+                                  G_TYPE_FILE, file);
+}
+
 /**
  * foundry_text_document_load_settings:
  * @self: a [class@Foundry.TextDocument]
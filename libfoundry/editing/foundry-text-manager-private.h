@@ -27,6 +27,8 @@
 G_BEGIN_DECLS
 
 FoundryTextBufferProvider *_foundry_text_manager_dup_provider (FoundryTextManager  *self);
+FoundryTextDocument       *_foundry_text_manager_dup_document (FoundryTextManager  *self,
+                                                               GFile               *file);
 void                       _foundry_text_manager_release      (FoundryTextManager  *self,
                                                                FoundryTextDocument *document);
 
@@ -22,6 +22,7 @@
 
 #include <libpeas.h>
 
+#include "foundry-context.h"
 #include "foundry-extension.h"
 #include "foundry-inhibitor.h"
 #include "foundry-operation.h"
@@ -34,6 +35,8 @@
 #include "foundry-service-private.h"
 #include "foundry-util-private.h"
 
+#define MAX_CONCURRENT_DOCUMENTS 8
+
 /**
  * FoundryTextManager:
  *
@@ -339,58 +342,425 @@ _foundry_text_manager_dup_provider (FoundryTextManager *self)
   return g_object_ref (self->text_buffer_provider);
 }
 
+/*
+ * _foundry_text_manager_dup_document:
+ *
+ * Looks up the open document for @file without creating one.
+ *
+ * Returns: (transfer full) (nullable):
+ */
+FoundryTextDocument *
+_foundry_text_manager_dup_document (FoundryTextManager *self,
+                                    GFile              *file)
+{
+  FoundryTextDocument *document;
+
+  g_return_val_if_fail (FOUNDRY_IS_TEXT_MANAGER (self), NULL);
+  g_return_val_if_fail (G_IS_FILE (file), NULL);
+
+  if ((document = g_hash_table_lookup (self->documents_by_file, file)))
+    return g_object_ref (document);
+
+  return NULL;
+}
+
 typedef struct _ApplyEdits
 {
   FoundryTextManager *self;
-  FoundryOperation *operation;
-  GHashTable *by_file;
+  FoundryOperation   *operation;
+  DexLimiter         *limiter;
+  GPtrArray          *files;
+  char               *backup_dir;
+  guint               restore : 1;
 } ApplyEdits;
 
+typedef struct _ApplyEditsFile
+{
+  ApplyEdits          *state;
+  GFile               *file;
+  GPtrArray           *edits;
+  FoundryTextDocument *document;
+  GFile               *backup;
+  GBytes              *contents;
+  gint64               change_count;
+  guint                index;
+  guint                saved : 1;
+} ApplyEditsFile;
+
+static void
+apply_edits_file_free (ApplyEditsFile *item)
+{
+  g_clear_object (&item->file);
+  g_clear_pointer (&item->edits, g_ptr_array_unref);
+  g_clear_object (&item->document);
+  g_clear_object (&item->backup);
+  g_clear_pointer (&item->contents, g_bytes_unref);
+  g_free (item);
+}
+
 static void
 apply_edits_free (ApplyEdits *state)
 {
   g_clear_object (&state->self);
   g_clear_object (&state->operation);
-  g_clear_pointer (&state->by_file, g_hash_table_unref);
+  dex_clear (&state->limiter);
+  g_clear_pointer (&state->files, g_ptr_array_unref);
+  g_clear_pointer (&state->backup_dir, g_free);
   g_free (state);
 }
 
+/* Runs @fiber_func for every file through the limiter and resolves
+ * once all of them have completed, rejecting if any of them failed.
+ * Items are borrowed by the fibers as the batch awaits all of them.
+ */
+static DexFuture *
+apply_edits_run (ApplyEdits   *state,
+                 DexScheduler *scheduler,
+                 DexFiberFunc  fiber_func)
+{
+  g_autoptr(GPtrArray) futures = NULL;
+
+  g_assert (state != NULL);
+  g_assert (state->files->len > 0);
+
+  futures = g_ptr_array_new_with_free_func (dex_unref);
+
+  for (guint i = 0; i < state->files->len; i++)
+    g_ptr_array_add (futures,
+                     dex_limiter_run (state->limiter,
+                                      scheduler,
+                                      0,
+                                      fiber_func,
+                                      g_ptr_array_index (state->files, i),
+                                      NULL));
+
+  return foundry_future_all (futures);
+}
+
+static DexFuture *
+apply_edits_load_fiber (gpointer data)
+{
+  ApplyEditsFile *item = data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (item != NULL);
+  g_assert (G_IS_FILE (item->file));
+
+  if (!(item->document = dex_await_object (foundry_text_manager_load (item->state->self,
+                                                                      item->file,
+                                                                      item->state->operation,
+                                                                      NULL),
+                                           &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_true ();
+}
+
+/* Runs on the thread pool. The backup is a copy rather than a hard
+ * link because GIO rewrites files in place (instead of replacing them
+ * through a temporary file) when they have more than one link.
+ */
+static DexFuture *
+apply_edits_backup_fiber (gpointer data)
+{
+  ApplyEditsFile *item = data;
+  g_autofree char *name = NULL;
+  g_autoptr(GFile) backup = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (item != NULL);
+  g_assert (G_IS_FILE (item->file));
+  g_assert (item->state->backup_dir != NULL);
+
+  name = g_strdup_printf ("%u", item->index);
+  backup = g_file_new_build_filename (item->state->backup_dir, name, NULL);
+
+  if (!g_file_copy (item->file, backup,
+                    G_FILE_COPY_NOFOLLOW_SYMLINKS | G_FILE_COPY_ALL_METADATA,
+                    NULL, NULL, NULL, &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  item->backup = g_steal_pointer (&backup);
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+apply_edits_save_fiber (gpointer data)
+{
+  ApplyEditsFile *item = data;
+  g_autoptr(FoundryTextBuffer) buffer = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (item != NULL);
+  g_assert (FOUNDRY_IS_TEXT_DOCUMENT (item->document));
+
+  buffer = foundry_text_document_dup_buffer (item->document);
+
+  dex_await (_foundry_text_document_pre_save (item->document), NULL);
+
+  /* Providers write through g_file_replace() which, for local files,
+   * writes a temporary file, syncs it and renames it over the original.
+   * A failed save therefore leaves the file untouched.
+   */
+  if (!dex_await (foundry_text_buffer_provider_save (item->state->self->text_buffer_provider,
+                                                     buffer,
+                                                     item->file,
+                                                     item->state->operation,
+                                                     NULL,  /* encoding */
+                                                     NULL), /* CRLF */
+                  &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  item->saved = TRUE;
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+apply_edits_post_save_fiber (gpointer data)
+{
+  ApplyEditsFile *item = data;
+
+  g_assert (item != NULL);
+  g_assert (FOUNDRY_IS_TEXT_DOCUMENT (item->document));
+
+  return _foundry_text_document_post_save (item->document, item->file);
+}
+
+/* Runs on the thread pool. When restoring, the backups are moved back
+ * over the files that were written, otherwise they are no longer
+ * needed. The backup directory is only left behind if a backup could
+ * not be restored.
+ */
+static DexFuture *
+apply_edits_finish_fiber (gpointer data)
+{
+  ApplyEdits *state = data;
+
+  g_assert (state != NULL);
+
+  for (guint i = 0; i < state->files->len; i++)
+    {
+      ApplyEditsFile *item = g_ptr_array_index (state->files, i);
+      g_autoptr(GError) error = NULL;
+
+      if (item->backup == NULL)
+        continue;
+
+      if (state->restore && item->saved)
+        {
+          if (!g_file_move (item->backup, item->file,
+                            G_FILE_COPY_OVERWRITE | G_FILE_COPY_NOFOLLOW_SYMLINKS,
+                            NULL, NULL, NULL, &error))
+            {
+              g_autofree char *uri = g_file_get_uri (item->backup);
+
+              g_warning ("Failed to restore backup “%s”: %s", uri, error->message);
+            }
+        }
+      else if (!g_file_delete (item->backup, NULL, &error))
+        {
+          g_autofree char *uri = g_file_get_uri (item->backup);
+
+          g_debug ("Failed to remove backup “%s”: %s", uri, error->message);
+        }
+
+      g_clear_object (&item->backup);
+    }
+
+  if (state->backup_dir != NULL)
+    g_rmdir (state->backup_dir);
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+apply_edits_finish (ApplyEdits *state,
+                    gboolean    restore)
+{
+  g_assert (state != NULL);
+
+  state->restore = !!restore;
+
+  return dex_scheduler_spawn (dex_thread_pool_scheduler_get_default (), 0,
+                              apply_edits_finish_fiber,
+                              state,
+                              NULL);
+}
+
+/* Replaces the whole buffer with the contents captured before the edits
+ * were applied. A trailing newline shared by both is left in place so
+ * that buffers with an implicit trailing newline do not gain a line.
+ */
+static void
+apply_edits_restore_buffers (ApplyEdits *state)
+{
+  g_assert (state != NULL);
+
+  for (guint i = 0; i < state->files->len; i++)
+    {
+      ApplyEditsFile *item = g_ptr_array_index (state->files, i);
+      g_autoptr(FoundryTextBuffer) buffer = NULL;
+      g_autoptr(FoundryTextEdit) edit = NULL;
+      g_autoptr(GBytes) current = NULL;
+      g_autofree char *replacement = NULL;
+      const char *data;
+      const char *line;
+      const char *old;
+      gsize old_len;
+      gsize len;
+      guint n_lines = 0;
+
+      if (item->contents == NULL)
+        continue;
+
+      buffer = foundry_text_document_dup_buffer (item->document);
+
+      if (foundry_text_buffer_get_change_count (buffer) == item->change_count)
+        continue;
+
+      current = foundry_text_buffer_dup_contents (buffer);
+      data = g_bytes_get_data (current, &len);
+      old = g_bytes_get_data (item->contents, &old_len);
+
+      if (len > 0 && old_len > 0 && data[len - 1] == '\n' && old[old_len - 1] == '\n')
+        {
+          len--;
+          old_len--;
+        }
+
+      line = data;
+
+      for (const char *p = data; p < data + len; p++)
+        {
+          if (*p == '\n')
+            {
+              n_lines++;
+              line = p + 1;
+            }
+        }
+
+      replacement = g_strndup (old ? old : "", old_len);
+      edit = foundry_text_edit_new (item->file,
+                                    0, 0,
+                                    n_lines, g_utf8_strlen (line ? line : "", data + len - line),
+                                    replacement);
+
+      if (!foundry_text_buffer_apply_edit (buffer, edit))
+        {
+          g_autofree char *uri = g_file_get_uri (item->file);
+
+          g_warning ("Failed to restore contents of “%s”", uri);
+        }
+    }
+}
+
+/* Backups are kept in a private directory below the context's tmp
+ * directory rather than next to the files so that nothing is ever left
+ * behind in the source tree.
+ */
+static DexFuture *
+apply_edits_create_backup_dir (ApplyEdits *state)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GFile) tmpdir = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *path = NULL;
+
+  g_assert (state != NULL);
+
+  if (!(context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (state->self))))
+    return dex_future_new_reject (G_IO_ERROR,
+                                  G_IO_ERROR_CLOSED,
+                                  "Context was disposed");
+
+  path = foundry_context_tmp_filename (context, NULL);
+  tmpdir = g_file_new_for_path (path);
+
+  /* Ignore failure, we'll catch it again when creating the directory */
+  dex_await (dex_file_make_directory_with_parents (tmpdir), NULL);
+
+  if (!(state->backup_dir = dex_await_string (_foundry_mkdtemp (g_file_peek_path (tmpdir),
+                                                                "apply-edits-XXXXXX"),
+                                              &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_true ();
+}
+
 static DexFuture *
 foundry_text_manager_apply_edits_fiber (gpointer data)
 {
   ApplyEdits *state = data;
-  GHashTableIter hiter;
-  gpointer key, value;
+  g_autoptr(GError) error = NULL;
 
   g_assert (state != NULL);
   g_assert (FOUNDRY_IS_TEXT_MANAGER (state->self));
-  g_assert (state->by_file != NULL);
+  g_assert (state->files != NULL);
 
-  g_hash_table_iter_init (&hiter, state->by_file);
+  if (state->files->len == 0)
+    return dex_future_new_true ();
 
-  while (g_hash_table_iter_next (&hiter, &key, &value))
+  /* Load every document first so that a missing or unreadable file
+   * fails the batch before anything is modified.
+   */
+  if (!dex_await (apply_edits_run (state, NULL, apply_edits_load_fiber), &error) ||
+      !dex_await (apply_edits_create_backup_dir (state), &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  if (!dex_await (apply_edits_run (state,
+                                   dex_thread_pool_scheduler_get_default (),
+                                   apply_edits_backup_fiber),
+                  &error))
     {
-      g_autoptr(FoundryTextDocument) document = NULL;
-      g_autoptr(GError) error = NULL;
-      GPtrArray *edits = value;
-      GFile *file = key;
+      dex_await (apply_edits_finish (state, FALSE), NULL);
+      return dex_future_new_for_error (g_steal_pointer (&error));
+    }
 
-      g_assert (G_IS_FILE (file));
-      g_assert (edits != NULL);
-      g_assert (edits->len > 0);
+  /* Remember what each buffer contained, including unsaved changes,
+   * so that a failure below can put the buffers back as well.
+   */
+  for (guint i = 0; i < state->files->len; i++)
+    {
+      ApplyEditsFile *item = g_ptr_array_index (state->files, i);
+      g_autoptr(FoundryTextBuffer) buffer = foundry_text_document_dup_buffer (item->document);
 
-      if (!(document = dex_await_object (foundry_text_manager_load (state->self, file, state->operation, NULL), &error)))
-        return dex_future_new_for_error (g_steal_pointer (&error));
+      item->contents = foundry_text_buffer_dup_contents (buffer);
+      item->change_count = foundry_text_buffer_get_change_count (buffer);
+    }
 
-      if (!foundry_text_document_apply_edits (document, (FoundryTextEdit **)edits->pdata, edits->len))
-        return dex_future_new_reject (G_IO_ERROR,
-                                      G_IO_ERROR_INVALID_DATA,
-                                      "Failed to apply edits to document");
+  for (guint i = 0; i < state->files->len; i++)
+    {
+      ApplyEditsFile *item = g_ptr_array_index (state->files, i);
 
-      if (!dex_await (foundry_text_document_save (document, state->operation), &error))
-        return dex_future_new_for_error (g_steal_pointer (&error));
+      if (!foundry_text_document_apply_edits (item->document,
+                                              (FoundryTextEdit **)item->edits->pdata,
+                                              item->edits->len))
+        {
+          apply_edits_restore_buffers (state);
+          dex_await (apply_edits_finish (state, FALSE), NULL);
+          return dex_future_new_reject (G_IO_ERROR,
+                                        G_IO_ERROR_INVALID_DATA,
+                                        "Failed to apply edits to document");
+        }
     }
 
+  /* If any file fails to save, put every file and buffer back the way
+   * it was so the tree is never left partially edited.
+   */
+  if (!dex_await (apply_edits_run (state, NULL, apply_edits_save_fiber), &error))
+    {
+      dex_await (apply_edits_finish (state, TRUE), NULL);
+      apply_edits_restore_buffers (state);
+      return dex_future_new_for_error (g_steal_pointer (&error));
+    }
+
+  dex_await (apply_edits_finish (state, FALSE), NULL);
+
+  if (!dex_await (apply_edits_run (state, NULL, apply_edits_post_save_fiber), &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
   return dex_future_new_true ();
 }
 
@@ -402,6 +772,10 @@ foundry_text_manager_apply_edits_fiber (gpointer data)
  *
  * Applies all of @edits to the respective files.
  *
+ * Documents are loaded and saved concurrently. The files are saved as
+ * a batch so that if any of them fails to save, all of them and their
+ * open buffers are restored to their previous contents.
+ *
  * Returns: (transfer full): a [class@Dex.Future] that resolves to
  *   any value or rejects with error.
  */
@@ -418,35 +792,39 @@ foundry_text_manager_apply_edits (FoundryTextManager *self,
   dex_return_error_if_fail (G_IS_LIST_MODEL (edits));
   dex_return_error_if_fail (FOUNDRY_IS_OPERATION (operation));
 
+  state = g_new0 (ApplyEdits, 1);
+  state->self = g_object_ref (self);
+  state->operation = operation ? g_object_ref (operation) : foundry_operation_new ();
+  state->limiter = dex_limiter_new (MAX_CONCURRENT_DOCUMENTS);
+  state->files = g_ptr_array_new_with_free_func ((GDestroyNotify) apply_edits_file_free);
+
   n_items = g_list_model_get_n_items (edits);
-  by_file = g_hash_table_new_full ((GHashFunc) g_file_hash,
-                                   (GEqualFunc) g_file_equal,
-                                   g_object_unref,
-                                   (GDestroyNotify) g_ptr_array_unref);
+  by_file = g_hash_table_new ((GHashFunc) g_file_hash, (GEqualFunc) g_file_equal);
 
   for (guint i = 0; i < n_items; i++)
     {
       g_autoptr(FoundryTextEdit) edit = g_list_model_get_item (edits, i);
       g_autoptr(GFile) file = foundry_text_edit_dup_file (edit);
-      GPtrArray *ar;
+      ApplyEditsFile *item;
 
       g_assert (FOUNDRY_IS_TEXT_EDIT (edit));
       g_assert (G_IS_FILE (file));
 
-      if (!(ar = g_hash_table_lookup (by_file, file)))
+      if (!(item = g_hash_table_lookup (by_file, file)))
         {
-          ar = g_ptr_array_new_with_free_func (g_object_unref);
-          g_hash_table_replace (by_file, g_object_ref (file), ar);
+          item = g_new0 (ApplyEditsFile, 1);
+          item->state = state;
+          item->file = g_object_ref (file);
+          item->edits = g_ptr_array_new_with_free_func (g_object_unref);
+          item->index = state->files->len;
+
+          g_ptr_array_add (state->files, item);
+          g_hash_table_replace (by_file, item->file, item);
         }
 
-      g_ptr_array_add (ar, g_steal_pointer (&edit));
+      g_ptr_array_add (item->edits, g_steal_pointer (&edit));
     }
 
-  state = g_new0 (ApplyEdits, 1);
-  state->self = g_object_ref (self);
-  state->operation = operation ? g_object_ref (operation) : foundry_operation_new ();
-  state->by_file = g_steal_pointer (&by_file);
-
   return dex_scheduler_spawn (NULL, 0,
                               foundry_text_manager_apply_edits_fiber,
                               state,
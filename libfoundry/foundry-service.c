@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include "foundry-action-muxer.h"
+#include "foundry-metrics-private.h"
 #include "foundry-service-private.h"
 
 /**
@@ -38,6 +39,7 @@ typedef struct
 {
   DexPromise *started;
   DexPromise *stopped;
+  gint64      start_time;
   guint       has_started : 1;
   guint       has_stopped : 1;
 } FoundryServicePrivate;
@@ -180,6 +182,23 @@ foundry_service_propagate (DexFuture *from,
   return NULL;
 }
 
+static DexFuture *
+foundry_service_record_start (DexFuture *completed,
+                              gpointer   user_data)
+{
+  FoundryService *self = user_data;
+  FoundryServicePrivate *priv = foundry_service_get_instance_private (self);
+  gint64 duration = _foundry_metrics_now () - priv->start_time;
+
+  FOUNDRY_METRICS_RECORD ("service.start", duration);
+  _foundry_metrics_record (_foundry_metrics_register_for_type ("service.start",
+                                                               G_OBJECT_TYPE (self),
+                                                               FOUNDRY_METRIC_HISTOGRAM),
+                           duration);
+
+  return dex_ref (completed);
+}
+
 DexFuture *
 foundry_service_start (FoundryService *self)
 {
@@ -197,7 +216,13 @@ foundry_service_start (FoundryService *self)
 
   g_debug ("Starting service %s", G_OBJECT_TYPE_NAME (self));
 
+  priv->start_time = _foundry_metrics_now ();
+
   future = FOUNDRY_SERVICE_GET_CLASS (self)->start (self);
+  future = dex_future_finally (future,
+                               foundry_service_record_start,
+                               g_object_ref (self),
+                               g_object_unref);
   future = dex_future_finally (future,
                                foundry_service_propagate,
                                dex_ref (priv->started),
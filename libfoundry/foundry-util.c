@@ -25,8 +25,10 @@
 #endif
 
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/utsname.h>
 #include <unistd.h>
+#include <sys/file.h>
 #include <sys/types.h>
 
 #include <glib/gi18n-lib.h>
@@ -1443,3 +1445,71 @@ _foundry_inhibit_suspend (void)
 {
   return dex_scheduler_spawn (NULL, 0, _foundry_inhibit_suspend_fiber, NULL, NULL);
 }
+
+/* Lock holders only keep the lock across a short read-modify-write, so
+ * waiting longer than this means the holder is stuck.
+ */
+#define LOCK_FILE_TIMEOUT_USEC  (30 * G_USEC_PER_SEC)
+#define LOCK_FILE_MIN_WAIT_MSEC 5
+#define LOCK_FILE_MAX_WAIT_MSEC 500
+
+static DexFuture *
+_foundry_lock_file_fiber (gpointer data)
+{
+  const char *path = data;
+  g_autofd int fd = -1;
+  guint wait_msec = LOCK_FILE_MIN_WAIT_MSEC;
+  gint64 deadline;
+
+  g_assert (path != NULL);
+
+  if (-1 == (fd = g_open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0640)))
+    return dex_future_new_for_errno (errno);
+
+  deadline = g_get_monotonic_time () + LOCK_FILE_TIMEOUT_USEC;
+
+  /* Never block in flock() as the holder may be a fiber on this thread */
+  while (flock (fd, LOCK_EX | LOCK_NB) != 0)
+    {
+      if (errno != EWOULDBLOCK && errno != EINTR)
+        return dex_future_new_for_errno (errno);
+
+      if (errno == EINTR)
+        continue;
+
+      if (g_get_monotonic_time () >= deadline)
+        return dex_future_new_reject (G_IO_ERROR,
+                                      G_IO_ERROR_TIMED_OUT,
+                                      "Timed out waiting for lock on `%s`",
+                                      path);
+
+      dex_await (dex_timeout_new_msec (wait_msec), NULL);
+      wait_msec = MIN (wait_msec * 2, LOCK_FILE_MAX_WAIT_MSEC);
+    }
+
+  return dex_future_new_for_int (g_steal_fd (&fd));
+}
+
+/**
+ * _foundry_lock_file:
+ * @path: the path to a lock file, which is created if necessary
+ *
+ * Takes an exclusive lock on @path which is also honored by other
+ * processes. The lock is released when the resulting FD is closed.
+ *
+ * Contention is retried with exponential backoff. If the lock cannot be
+ * taken within 30 seconds the future rejects with %G_IO_ERROR_TIMED_OUT.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to an
+ *   FD holding the lock, which the caller must close.
+ */
+DexFuture *
+_foundry_lock_file (const char *path)
+{
+  dex_return_error_if_fail (path != NULL);
+
+  return dex_scheduler_spawn (NULL, 0,
+                              _foundry_lock_file_fiber,
+                              g_strdup (path),
+                              g_free);
+}
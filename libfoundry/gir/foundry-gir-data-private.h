@@ -0,0 +1,81 @@
+/* foundry-gir-data-private.h
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define FOUNDRY_GIR_DATA_NONE G_MAXUINT32
+
+typedef struct _FoundryGirData FoundryGirData;
+
+/* Fixed-size node record. Strings are offsets into the string table where
+ * offset zero is the empty string. The children of a node are stored
+ * contiguously, always after the node itself.
+ */
+typedef struct _FoundryGirDataNode
+{
+  guint32 tag;
+  guint32 content;
+  guint32 parent;
+  guint32 first_child;
+  guint32 n_children;
+  guint32 first_attribute;
+  guint32 n_attributes;
+  guint32 type;
+} FoundryGirDataNode;
+
+typedef struct _FoundryGirDataAttribute
+{
+  guint32 key;
+  guint32 value;
+} FoundryGirDataAttribute;
+
+FoundryGirData                *_foundry_gir_data_parse          (GBytes          *contents,
+                                                                 guint64          source_mtime,
+                                                                 guint64          source_size,
+                                                                 GError         **error);
+FoundryGirData                *_foundry_gir_data_load           (const char      *path,
+                                                                 guint64          source_mtime,
+                                                                 guint64          source_size,
+                                                                 GError         **error);
+gboolean                       _foundry_gir_data_save           (FoundryGirData  *self,
+                                                                 const char      *path,
+                                                                 GError         **error);
+FoundryGirData                *_foundry_gir_data_ref            (FoundryGirData  *self);
+void                           _foundry_gir_data_unref          (FoundryGirData  *self);
+gsize                          _foundry_gir_data_get_size       (FoundryGirData  *self);
+guint                          _foundry_gir_data_get_n_nodes    (FoundryGirData  *self);
+const FoundryGirDataNode      *_foundry_gir_data_get_node       (FoundryGirData  *self,
+                                                                 guint            index);
+const FoundryGirDataAttribute *_foundry_gir_data_get_attributes (FoundryGirData  *self,
+                                                                 guint            index,
+                                                                 guint           *n_attributes);
+const char                    *_foundry_gir_data_get_string     (FoundryGirData  *self,
+                                                                 guint32          offset);
+const char                    *_foundry_gir_data_get_attribute  (FoundryGirData  *self,
+                                                                 guint            index,
+                                                                 const char      *key);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryGirData, _foundry_gir_data_unref)
+
+G_END_DECLS
@@ -0,0 +1,807 @@
+/* foundry-gir-data.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "foundry-gir.h"
+#include "foundry-gir-data-private.h"
+
+/* The parsed GIR is kept as a single flat buffer: a header, an array of
+ * fixed-size node records in breadth-first order, an array of attribute
+ * records and a table of NUL-terminated strings. Tag names, attribute
+ * keys and attribute values are interned so that the many repeated type
+ * names are only stored once.
+ *
+ * The same buffer is written to disk as a cache and later mapped back
+ * in, so loading a cached GIR is a validation pass over the records.
+ * It is written in host byte order since it never leaves the machine;
+ * a file from another byte order fails the version check.
+ */
+
+#define GIR_DATA_MAGIC   "FGIRDATA"
+#define GIR_DATA_VERSION 1
+
+typedef struct _FoundryGirDataHeader
+{
+  char    magic[8];
+  guint32 version;
+  guint32 n_nodes;
+  guint32 n_attributes;
+  guint32 strings_len;
+  guint64 source_mtime;
+  guint64 source_size;
+} FoundryGirDataHeader;
+
+G_STATIC_ASSERT (sizeof (FoundryGirDataHeader) == 40);
+G_STATIC_ASSERT (sizeof (FoundryGirDataNode) == 32);
+G_STATIC_ASSERT (sizeof (FoundryGirDataAttribute) == 8);
+
+struct _FoundryGirData
+{
+  gatomicrefcount                ref_count;
+  GBytes                        *bytes;
+  const FoundryGirDataHeader    *header;
+  const FoundryGirDataNode      *nodes;
+  const FoundryGirDataAttribute *attributes;
+  const char                    *strings;
+};
+
+typedef struct _BuildNode
+{
+  FoundryGirDataNode node;
+  guint32            last_child;
+  guint32            next_sibling;
+} BuildNode;
+
+typedef struct _OpenElement
+{
+  guint32  index;
+  GString *text;
+} OpenElement;
+
+typedef struct _Builder
+{
+  GArray     *nodes;
+  GArray     *attributes;
+  GArray     *stack;
+  GString    *strings;
+  GHashTable *interned;
+} Builder;
+
+static FoundryGirNodeType
+foundry_gir_node_type_from_element (const char *element_name)
+{
+  static const struct
+  {
+    const char *element;
+    FoundryGirNodeType type;
+  } map[] = {
+    { "repository",         FOUNDRY_GIR_NODE_REPOSITORY },
+    { "include",            FOUNDRY_GIR_NODE_INCLUDE },
+    { "c:include",          FOUNDRY_GIR_NODE_C_INCLUDE },
+    { "package",            FOUNDRY_GIR_NODE_PACKAGE },
+    { "namespace",          FOUNDRY_GIR_NODE_NAMESPACE },
+    { "alias",              FOUNDRY_GIR_NODE_ALIAS },
+    { "array",              FOUNDRY_GIR_NODE_ARRAY },
+    { "bitfield",           FOUNDRY_GIR_NODE_BITFIELD },
+    { "callback",           FOUNDRY_GIR_NODE_CALLBACK },
+    { "class",              FOUNDRY_GIR_NODE_CLASS },
+    { "method",             FOUNDRY_GIR_NODE_METHOD },
+    { "constructor",        FOUNDRY_GIR_NODE_CONSTRUCTOR },
+    { "virtual-method",     FOUNDRY_GIR_NODE_VIRTUAL_METHOD },
+    { "function",           FOUNDRY_GIR_NODE_FUNCTION },
+    { "function-macro",     FOUNDRY_GIR_NODE_FUNCTION_MACRO },
+    { "constant",           FOUNDRY_GIR_NODE_CONSTANT },
+    { "doc:doc",            FOUNDRY_GIR_NODE_DOC },
+    { "doc:para",           FOUNDRY_GIR_NODE_DOC_PARA },
+    { "doc:text",           FOUNDRY_GIR_NODE_DOC_TEXT },
+    { "enumeration",        FOUNDRY_GIR_NODE_ENUM },
+    { "member",             FOUNDRY_GIR_NODE_ENUM_MEMBER },
+    { "field",              FOUNDRY_GIR_NODE_FIELD },
+    { "property",           FOUNDRY_GIR_NODE_PROPERTY },
+    { "glib:property",      FOUNDRY_GIR_NODE_PROPERTY },
+    { "glib:signal",        FOUNDRY_GIR_NODE_GLIB_SIGNAL },
+    { "glib:error-domain",  FOUNDRY_GIR_NODE_GLIB_ERROR_DOMAIN },
+    { "glib:boxed",         FOUNDRY_GIR_NODE_GLIB_BOXED },
+    { "implements",         FOUNDRY_GIR_NODE_IMPLEMENTS },
+    { "prerequisite",       FOUNDRY_GIR_NODE_PREREQUISITE },
+    { "parameters",         FOUNDRY_GIR_NODE_PARAMETERS },
+    { "parameter",          FOUNDRY_GIR_NODE_PARAMETER },
+    { "instance-parameter", FOUNDRY_GIR_NODE_INSTANCE_PARAMETER },
+    { "return-value",       FOUNDRY_GIR_NODE_RETURN_VALUE },
+    { "type",               FOUNDRY_GIR_NODE_TYPE },
+    { "union",              FOUNDRY_GIR_NODE_UNION },
+    { "record",             FOUNDRY_GIR_NODE_RECORD },
+    { "interface",          FOUNDRY_GIR_NODE_INTERFACE },
+    { "source-position",    FOUNDRY_GIR_NODE_SOURCE_POSITION },
+    { "varargs",            FOUNDRY_GIR_NODE_VARARGS },
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (map); i++)
+    {
+      if (g_strcmp0 (element_name, map[i].element) == 0)
+        return map[i].type;
+    }
+
+  if (g_str_has_prefix (element_name, "doc:"))
+    return FOUNDRY_GIR_NODE_DOC;
+
+  return FOUNDRY_GIR_NODE_UNKNOWN;
+}
+
+static void
+open_element_clear (gpointer data)
+{
+  OpenElement *element = data;
+
+  if (element->text != NULL)
+    g_string_free (g_steal_pointer (&element->text), TRUE);
+}
+
+static void
+builder_init (Builder *builder)
+{
+  builder->nodes = g_array_new (FALSE, FALSE, sizeof (BuildNode));
+  builder->attributes = g_array_new (FALSE, FALSE, sizeof (FoundryGirDataAttribute));
+  builder->stack = g_array_new (FALSE, FALSE, sizeof (OpenElement));
+  builder->strings = g_string_new (NULL);
+  builder->interned = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_array_set_clear_func (builder->stack, open_element_clear);
+
+  /* Offset zero is the empty string */
+  g_string_append_c (builder->strings, 0);
+}
+
+static void
+builder_clear (Builder *builder)
+{
+  g_clear_pointer (&builder->nodes, g_array_unref);
+  g_clear_pointer (&builder->attributes, g_array_unref);
+  g_clear_pointer (&builder->stack, g_array_unref);
+  g_clear_pointer (&builder->interned, g_hash_table_unref);
+
+  if (builder->strings != NULL)
+    g_string_free (g_steal_pointer (&builder->strings), TRUE);
+}
+
+static guint32
+builder_append_string (Builder    *builder,
+                       const char *str,
+                       gsize       len)
+{
+  guint32 offset = builder->strings->len;
+
+  g_string_append_len (builder->strings, str, len);
+  g_string_append_c (builder->strings, 0);
+
+  return offset;
+}
+
+static guint32
+builder_intern (Builder    *builder,
+                const char *str)
+{
+  gpointer value;
+  guint32 offset;
+
+  if (str == NULL || str[0] == 0)
+    return 0;
+
+  if (g_hash_table_lookup_extended (builder->interned, str, NULL, &value))
+    return GPOINTER_TO_UINT (value);
+
+  offset = builder_append_string (builder, str, strlen (str));
+  g_hash_table_insert (builder->interned, g_strdup (str), GUINT_TO_POINTER (offset));
+
+  return offset;
+}
+
+static void
+foundry_gir_data_start_element (GMarkupParseContext  *context,
+                                const char           *element_name,
+                                const char          **attribute_names,
+                                const char          **attribute_values,
+                                gpointer              user_data,
+                                GError              **error)
+{
+  Builder *builder = user_data;
+  OpenElement element = {0};
+  BuildNode node = {0};
+  guint32 parent = FOUNDRY_GIR_DATA_NONE;
+
+  if (builder->stack->len > 0)
+    parent = g_array_index (builder->stack, OpenElement, builder->stack->len - 1).index;
+  else if (builder->nodes->len > 0)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Multiple root elements encountered, expected a single <repository>");
+      return;
+    }
+
+  node.node.tag = builder_intern (builder, element_name);
+  node.node.type = foundry_gir_node_type_from_element (element_name);
+  node.node.parent = parent;
+  node.node.first_child = FOUNDRY_GIR_DATA_NONE;
+  node.node.first_attribute = builder->attributes->len;
+  node.last_child = FOUNDRY_GIR_DATA_NONE;
+  node.next_sibling = FOUNDRY_GIR_DATA_NONE;
+
+  for (guint i = 0; attribute_names[i] != NULL; i++)
+    {
+      FoundryGirDataAttribute attribute;
+
+      attribute.key = builder_intern (builder, attribute_names[i]);
+      attribute.value = builder_intern (builder, attribute_values[i]);
+
+      g_array_append_val (builder->attributes, attribute);
+      node.node.n_attributes++;
+    }
+
+  element.index = builder->nodes->len;
+  g_array_append_val (builder->nodes, node);
+
+  if (parent != FOUNDRY_GIR_DATA_NONE)
+    {
+      BuildNode *parent_node = &g_array_index (builder->nodes, BuildNode, parent);
+
+      if (parent_node->node.first_child == FOUNDRY_GIR_DATA_NONE)
+        parent_node->node.first_child = element.index;
+      else
+        g_array_index (builder->nodes, BuildNode, parent_node->last_child).next_sibling = element.index;
+
+      parent_node->last_child = element.index;
+      parent_node->node.n_children++;
+    }
+
+  g_array_append_val (builder->stack, element);
+}
+
+static void
+foundry_gir_data_end_element (GMarkupParseContext  *context,
+                              const char           *element_name,
+                              gpointer              user_data,
+                              GError              **error)
+{
+  Builder *builder = user_data;
+  OpenElement *element;
+  BuildNode *node;
+  const char *tag_name;
+
+  if (builder->stack->len == 0)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Unexpected closing element </%s>", element_name);
+      return;
+    }
+
+  element = &g_array_index (builder->stack, OpenElement, builder->stack->len - 1);
+  node = &g_array_index (builder->nodes, BuildNode, element->index);
+  tag_name = builder->strings->str + node->node.tag;
+
+  if (g_strcmp0 (tag_name, element_name) != 0)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Mismatched closing element </%s>, expected </%s>",
+                   element_name,
+                   tag_name);
+      return;
+    }
+
+  /* Whitespace between child elements is not content */
+  if (element->text != NULL)
+    {
+      for (gsize i = 0; i < element->text->len; i++)
+        {
+          if (!g_ascii_isspace (element->text->str[i]))
+            {
+              node->node.content = builder_append_string (builder,
+                                                          element->text->str,
+                                                          element->text->len);
+              break;
+            }
+        }
+    }
+
+  g_array_remove_index (builder->stack, builder->stack->len - 1);
+}
+
+static void
+foundry_gir_data_text (GMarkupParseContext  *context,
+                       const char           *text,
+                       gsize                 text_len,
+                       gpointer              user_data,
+                       GError              **error)
+{
+  Builder *builder = user_data;
+  OpenElement *element;
+
+  if (builder->stack->len == 0 || text_len == 0)
+    return;
+
+  element = &g_array_index (builder->stack, OpenElement, builder->stack->len - 1);
+
+  if (element->text == NULL)
+    element->text = g_string_new_len (text, text_len);
+  else
+    g_string_append_len (element->text, text, text_len);
+}
+
+static const GMarkupParser gir_data_markup_parser = {
+  .start_element = foundry_gir_data_start_element,
+  .end_element = foundry_gir_data_end_element,
+  .text = foundry_gir_data_text,
+};
+
+static FoundryGirData *
+foundry_gir_data_new_take (GBytes *bytes)
+{
+  FoundryGirData *self;
+  const guint8 *data;
+
+  g_assert (bytes != NULL);
+
+  data = g_bytes_get_data (bytes, NULL);
+
+  self = g_new0 (FoundryGirData, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  self->bytes = bytes;
+  self->header = (const FoundryGirDataHeader *)(gconstpointer)data;
+  self->nodes = (const FoundryGirDataNode *)(gconstpointer)(data + sizeof *self->header);
+  self->attributes = (const FoundryGirDataAttribute *)(gconstpointer)&self->nodes[self->header->n_nodes];
+  self->strings = (const char *)&self->attributes[self->header->n_attributes];
+
+  return self;
+}
+
+/* Lays the nodes out breadth-first so the children of every node are
+ * contiguous, then packs everything into a single buffer.
+ */
+static FoundryGirData *
+builder_finish (Builder  *builder,
+                guint64   source_mtime,
+                guint64   source_size,
+                GError  **error)
+{
+  g_autofree guint32 *order = NULL;
+  g_autofree guint32 *new_index = NULL;
+  FoundryGirDataHeader *header;
+  FoundryGirDataNode *nodes;
+  guint8 *data;
+  guint n_nodes = builder->nodes->len;
+  guint n_ordered = 1;
+  gsize size;
+
+  g_assert (n_nodes > 0);
+
+  if (builder->strings->len >= G_MAXUINT32 ||
+      builder->attributes->len >= G_MAXUINT32 ||
+      n_nodes >= G_MAXUINT32)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Input length exceeds supported range");
+      return NULL;
+    }
+
+  order = g_new (guint32, n_nodes);
+  new_index = g_new (guint32, n_nodes);
+
+  order[0] = 0;
+
+  for (guint i = 0; i < n_ordered; i++)
+    {
+      const BuildNode *node = &g_array_index (builder->nodes, BuildNode, order[i]);
+
+      for (guint32 child = node->node.first_child;
+           child != FOUNDRY_GIR_DATA_NONE;
+           child = g_array_index (builder->nodes, BuildNode, child).next_sibling)
+        order[n_ordered++] = child;
+    }
+
+  g_assert (n_ordered == n_nodes);
+
+  for (guint i = 0; i < n_nodes; i++)
+    new_index[order[i]] = i;
+
+  size = sizeof *header
+       + (gsize)n_nodes * sizeof (FoundryGirDataNode)
+       + (gsize)builder->attributes->len * sizeof (FoundryGirDataAttribute)
+       + builder->strings->len;
+
+  data = g_malloc (size);
+
+  header = (FoundryGirDataHeader *)(gpointer)data;
+  memcpy (header->magic, GIR_DATA_MAGIC, sizeof header->magic);
+  header->version = GIR_DATA_VERSION;
+  header->n_nodes = n_nodes;
+  header->n_attributes = builder->attributes->len;
+  header->strings_len = builder->strings->len;
+  header->source_mtime = source_mtime;
+  header->source_size = source_size;
+
+  nodes = (FoundryGirDataNode *)(gpointer)(data + sizeof *header);
+
+  for (guint i = 0; i < n_nodes; i++)
+    {
+      const FoundryGirDataNode *src = &g_array_index (builder->nodes, BuildNode, order[i]).node;
+      FoundryGirDataNode *dst = &nodes[i];
+
+      *dst = *src;
+      dst->parent = src->parent == FOUNDRY_GIR_DATA_NONE ? FOUNDRY_GIR_DATA_NONE : new_index[src->parent];
+      dst->first_child = src->n_children == 0 ? 0 : new_index[src->first_child];
+    }
+
+  memcpy (&nodes[n_nodes],
+          builder->attributes->data,
+          builder->attributes->len * sizeof (FoundryGirDataAttribute));
+  memcpy (data + size - builder->strings->len,
+          builder->strings->str,
+          builder->strings->len);
+
+  return foundry_gir_data_new_take (g_bytes_new_take (data, size));
+}
+
+/*
+ * _foundry_gir_data_parse:
+ * @contents: the contents of a .gir file
+ * @source_mtime: modification time of the file in microseconds
+ * @source_size: size of the file in bytes
+ *
+ * Parses @contents into the compact representation. @source_mtime and
+ * @source_size are recorded so that a saved copy can be checked for
+ * staleness by _foundry_gir_data_load().
+ *
+ * Returns: (transfer full) (nullable): the parsed data or %NULL and
+ *   @error is set
+ */
+FoundryGirData *
+_foundry_gir_data_parse (GBytes   *contents,
+                         guint64   source_mtime,
+                         guint64   source_size,
+                         GError  **error)
+{
+  g_autoptr(GMarkupParseContext) context = NULL;
+  FoundryGirData *ret = NULL;
+  Builder builder;
+  const char *data;
+  gsize length;
+
+  g_return_val_if_fail (contents != NULL, NULL);
+
+  data = (const char *)g_bytes_get_data (contents, &length);
+
+  if (length > (gsize)SSIZE_MAX)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Input length exceeds supported range");
+      return NULL;
+    }
+
+  builder_init (&builder);
+
+  context = g_markup_parse_context_new (&gir_data_markup_parser,
+                                        G_MARKUP_TREAT_CDATA_AS_TEXT,
+                                        &builder,
+                                        NULL);
+
+  if (!g_markup_parse_context_parse (context, data, length, error) ||
+      !g_markup_parse_context_end_parse (context, error))
+    goto cleanup;
+
+  if (builder.nodes->len == 0)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Missing <repository> root element");
+      goto cleanup;
+    }
+
+  if (g_array_index (builder.nodes, BuildNode, 0).node.type != FOUNDRY_GIR_NODE_REPOSITORY)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Unexpected root element <%s>, expected <repository>",
+                   builder.strings->str + g_array_index (builder.nodes, BuildNode, 0).node.tag);
+      goto cleanup;
+    }
+
+  if (builder.stack->len != 0)
+    {
+      g_set_error (error,
+                   FOUNDRY_GIR_ERROR,
+                   FOUNDRY_GIR_ERROR_PARSE,
+                   "Unbalanced XML elements while parsing GIR");
+      goto cleanup;
+    }
+
+  ret = builder_finish (&builder, source_mtime, source_size, error);
+
+cleanup:
+  g_clear_pointer (&context, g_markup_parse_context_free);
+  builder_clear (&builder);
+
+  return ret;
+}
+
+static gboolean
+invalid (GError **error)
+{
+  g_set_error_literal (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Invalid GIR cache");
+  return FALSE;
+}
+
+static gboolean
+foundry_gir_data_validate (GBytes  *bytes,
+                           GError **error)
+{
+  const FoundryGirDataHeader *header;
+  const FoundryGirDataAttribute *attributes;
+  const FoundryGirDataNode *nodes;
+  const guint8 *data;
+  const char *strings;
+  guint64 expected;
+  gsize size;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  if (size < sizeof *header)
+    return invalid (error);
+
+  header = (const FoundryGirDataHeader *)(gconstpointer)data;
+
+  if (memcmp (header->magic, GIR_DATA_MAGIC, sizeof header->magic) != 0 ||
+      header->version != GIR_DATA_VERSION ||
+      header->n_nodes == 0 ||
+      header->strings_len == 0)
+    return invalid (error);
+
+  expected = (guint64)sizeof *header
+           + (guint64)header->n_nodes * sizeof (FoundryGirDataNode)
+           + (guint64)header->n_attributes * sizeof (FoundryGirDataAttribute)
+           + (guint64)header->strings_len;
+
+  if (expected != size)
+    return invalid (error);
+
+  nodes = (const FoundryGirDataNode *)(gconstpointer)(data + sizeof *header);
+  attributes = (const FoundryGirDataAttribute *)(gconstpointer)&nodes[header->n_nodes];
+  strings = (const char *)&attributes[header->n_attributes];
+
+  /* Every offset below strings_len is then inside a terminated string */
+  if (strings[0] != 0 || strings[header->strings_len - 1] != 0)
+    return invalid (error);
+
+  for (guint i = 0; i < header->n_attributes; i++)
+    {
+      if (attributes[i].key >= header->strings_len ||
+          attributes[i].value >= header->strings_len)
+        return invalid (error);
+    }
+
+  if (nodes[0].type != FOUNDRY_GIR_NODE_REPOSITORY ||
+      nodes[0].parent != FOUNDRY_GIR_DATA_NONE)
+    return invalid (error);
+
+  for (guint i = 0; i < header->n_nodes; i++)
+    {
+      const FoundryGirDataNode *node = &nodes[i];
+
+      if (node->tag >= header->strings_len ||
+          node->content >= header->strings_len ||
+          node->type >= FOUNDRY_GIR_NODE_LAST ||
+          node->first_attribute > header->n_attributes ||
+          node->n_attributes > header->n_attributes - node->first_attribute)
+        return invalid (error);
+
+      /* Children always come after their parent so there are no cycles */
+      if (node->n_children > 0 &&
+          (node->first_child <= i ||
+           node->first_child >= header->n_nodes ||
+           node->n_children > header->n_nodes - node->first_child))
+        return invalid (error);
+
+      if (i > 0 && node->parent >= i)
+        return invalid (error);
+    }
+
+  return TRUE;
+}
+
+/*
+ * _foundry_gir_data_load:
+ * @path: the path of a file written with _foundry_gir_data_save()
+ * @source_mtime: expected modification time of the .gir in microseconds
+ * @source_size: expected size of the .gir in bytes
+ *
+ * Maps a previously saved copy of the data. Fails if the file is corrupt
+ * or was created from a .gir with a different mtime or size.
+ *
+ * Returns: (transfer full) (nullable): the data or %NULL and @error is set
+ */
+FoundryGirData *
+_foundry_gir_data_load (const char  *path,
+                        guint64      source_mtime,
+                        guint64      source_size,
+                        GError     **error)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  const FoundryGirDataHeader *header;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, error)))
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+
+  if (!foundry_gir_data_validate (bytes, error))
+    return NULL;
+
+  header = g_bytes_get_data (bytes, NULL);
+
+  if (header->source_mtime != source_mtime ||
+      header->source_size != source_size)
+    {
+      g_set_error_literal (error,
+                           G_IO_ERROR,
+                           G_IO_ERROR_INVALID_DATA,
+                           "GIR cache is out of date");
+      return NULL;
+    }
+
+  return foundry_gir_data_new_take (g_steal_pointer (&bytes));
+}
+
+gboolean
+_foundry_gir_data_save (FoundryGirData  *self,
+                        const char      *path,
+                        GError         **error)
+{
+  gconstpointer data;
+  gsize size;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  data = g_bytes_get_data (self->bytes, &size);
+
+  return g_file_set_contents_full (path,
+                                   data,
+                                   size,
+                                   G_FILE_SET_CONTENTS_CONSISTENT,
+                                   0644,
+                                   error);
+}
+
+FoundryGirData *
+_foundry_gir_data_ref (FoundryGirData *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+_foundry_gir_data_unref (FoundryGirData *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (g_atomic_ref_count_dec (&self->ref_count))
+    {
+      g_clear_pointer (&self->bytes, g_bytes_unref);
+      g_free (self);
+    }
+}
+
+gsize
+_foundry_gir_data_get_size (FoundryGirData *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return g_bytes_get_size (self->bytes);
+}
+
+guint
+_foundry_gir_data_get_n_nodes (FoundryGirData *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->header->n_nodes;
+}
+
+const FoundryGirDataNode *
+_foundry_gir_data_get_node (FoundryGirData *self,
+                            guint           index)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (index < self->header->n_nodes, NULL);
+
+  return &self->nodes[index];
+}
+
+const FoundryGirDataAttribute *
+_foundry_gir_data_get_attributes (FoundryGirData *self,
+                                  guint           index,
+                                  guint          *n_attributes)
+{
+  const FoundryGirDataNode *node;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (index < self->header->n_nodes, NULL);
+  g_return_val_if_fail (n_attributes != NULL, NULL);
+
+  node = &self->nodes[index];
+  *n_attributes = node->n_attributes;
+
+  return &self->attributes[node->first_attribute];
+}
+
+const char *
+_foundry_gir_data_get_string (FoundryGirData *self,
+                              guint32         offset)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (offset < self->header->strings_len, NULL);
+
+  return &self->strings[offset];
+}
+
+const char *
+_foundry_gir_data_get_attribute (FoundryGirData *self,
+                                 guint           index,
+                                 const char     *key)
+{
+  const FoundryGirDataAttribute *attributes;
+  guint n_attributes;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+
+  attributes = _foundry_gir_data_get_attributes (self, index, &n_attributes);
+
+  for (guint i = 0; i < n_attributes; i++)
+    {
+      if (strcmp (&self->strings[attributes[i].key], key) == 0)
+        return &self->strings[attributes[i].value];
+    }
+
+  return NULL;
+}
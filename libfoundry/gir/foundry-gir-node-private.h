@@ -20,17 +20,21 @@
 
 #pragma once
 
+#include "foundry-gir-data-private.h"
 #include "foundry-gir-node.h"
 
 G_BEGIN_DECLS
 
-void _foundry_gir_node_add_attribute (FoundryGirNode *node,
-                                      const char     *name,
-                                      const char     *value);
-void _foundry_gir_node_add_child     (FoundryGirNode *parent,
-                                      FoundryGirNode *child);
-void _foundry_gir_node_append_text   (FoundryGirNode *node,
-                                      const char     *text,
-                                      size_t          text_len);
+FoundryGirNode *_foundry_gir_node_new_for_data  (FoundryGirData *data,
+                                                 guint           index,
+                                                 FoundryGirNode *parent);
+void            _foundry_gir_node_add_attribute (FoundryGirNode *node,
+                                                 const char     *name,
+                                                 const char     *value);
+void            _foundry_gir_node_add_child     (FoundryGirNode *parent,
+                                                 FoundryGirNode *child);
+void            _foundry_gir_node_append_text   (FoundryGirNode *node,
+                                                 const char     *text,
+                                                 size_t          text_len);
 
 G_END_DECLS
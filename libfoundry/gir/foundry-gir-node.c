@@ -49,6 +49,13 @@ struct _FoundryGirNode
   GQueue               children;
   GList                parent_link;
   FoundryGirNodeType   type;
+
+  /* Nodes loaded from a file are views into @data. Attributes and content
+   * are read from there and children are created on first access.
+   */
+  FoundryGirData      *data;
+  guint                index;
+  int                  children_loaded;
 };
 
 struct _FoundryGirAttribute
@@ -60,6 +67,8 @@ struct _FoundryGirAttribute
 
 G_DEFINE_FINAL_TYPE (FoundryGirNode, foundry_gir_node, G_TYPE_OBJECT)
 
+G_LOCK_DEFINE_STATIC (children);
+
 static void
 foundry_gir_node_dispose (GObject *object)
 {
@@ -89,6 +98,7 @@ foundry_gir_node_finalize (GObject *object)
     }
 
   g_clear_pointer (&self->name, g_free);
+  g_clear_pointer (&self->data, _foundry_gir_data_unref);
 
   if (self->content != NULL)
     g_string_free (g_steal_pointer (&self->content), TRUE);
@@ -126,6 +136,56 @@ foundry_gir_node_new (FoundryGirNodeType  type,
   return self;
 }
 
+FoundryGirNode *
+_foundry_gir_node_new_for_data (FoundryGirData *data,
+                                guint           index,
+                                FoundryGirNode *parent)
+{
+  const FoundryGirDataNode *record;
+  FoundryGirNode *self;
+
+  g_return_val_if_fail (data != NULL, NULL);
+  g_return_val_if_fail (index < _foundry_gir_data_get_n_nodes (data), NULL);
+
+  record = _foundry_gir_data_get_node (data, index);
+
+  self = g_object_new (FOUNDRY_TYPE_GIR_NODE, NULL);
+  self->type = record->type;
+  self->tag_name = g_intern_string (_foundry_gir_data_get_string (data, record->tag));
+  self->data = _foundry_gir_data_ref (data);
+  self->index = index;
+  self->parent = parent;
+
+  return self;
+}
+
+static void
+foundry_gir_node_ensure_children (FoundryGirNode *node)
+{
+  const FoundryGirDataNode *record;
+
+  if (node->data == NULL || g_atomic_int_get (&node->children_loaded))
+    return;
+
+  G_LOCK (children);
+
+  if (!node->children_loaded)
+    {
+      record = _foundry_gir_data_get_node (node->data, node->index);
+
+      for (guint i = 0; i < record->n_children; i++)
+        {
+          FoundryGirNode *child = _foundry_gir_node_new_for_data (node->data, record->first_child + i, node);
+
+          g_queue_push_tail_link (&node->children, &child->parent_link);
+        }
+
+      g_atomic_int_set (&node->children_loaded, TRUE);
+    }
+
+  G_UNLOCK (children);
+}
+
 FoundryGirNodeType
 foundry_gir_node_get_node_type (FoundryGirNode *node)
 {
@@ -152,7 +212,11 @@ foundry_gir_node_get_name (FoundryGirNode *node)
   if (node->name != NULL)
     return node->name;
 
-  name = foundry_gir_node_get_attribute (node, "glib:name");
+  if (node->data != NULL)
+    name = _foundry_gir_data_get_attribute (node->data, node->index, "name");
+
+  if (name == NULL)
+    name = foundry_gir_node_get_attribute (node, "glib:name");
 
   if (name == NULL)
     name = foundry_gir_node_get_attribute (node, "c:identifier");
@@ -168,6 +232,14 @@ foundry_gir_node_get_content (FoundryGirNode *node)
 {
   g_return_val_if_fail (FOUNDRY_IS_GIR_NODE (node), NULL);
 
+  /* Whitespace-only content is never stored in the data */
+  if (node->data != NULL)
+    {
+      guint32 content = _foundry_gir_data_get_node (node->data, node->index)->content;
+
+      return content ? _foundry_gir_data_get_string (node->data, content) : NULL;
+    }
+
   if (node->content == NULL || node->content->len == 0)
     return NULL;
 
@@ -187,6 +259,9 @@ foundry_gir_node_get_attribute (FoundryGirNode *node,
   g_return_val_if_fail (FOUNDRY_IS_GIR_NODE (node), NULL);
   g_return_val_if_fail (attribute != NULL, NULL);
 
+  if (node->data != NULL)
+    return _foundry_gir_data_get_attribute (node->data, node->index, attribute);
+
   for (const GList *iter = node->attributes.head; iter; iter = iter->next)
     {
       const FoundryGirAttribute *attr = iter->data;
@@ -205,6 +280,9 @@ foundry_gir_node_has_attribute (FoundryGirNode *node,
   g_return_val_if_fail (FOUNDRY_IS_GIR_NODE (node), FALSE);
   g_return_val_if_fail (attribute != NULL, FALSE);
 
+  if (node->data != NULL)
+    return _foundry_gir_data_get_attribute (node->data, node->index, attribute) != NULL;
+
   for (const GList *iter = node->attributes.head; iter; iter = iter->next)
     {
       const FoundryGirAttribute *attr = iter->data;
@@ -237,6 +315,24 @@ foundry_gir_node_list_attributes (FoundryGirNode *node,
 
   g_return_val_if_fail (FOUNDRY_IS_GIR_NODE (node), NULL);
 
+  if (node->data != NULL)
+    {
+      const FoundryGirDataAttribute *attrs;
+      guint n_attrs;
+
+      attrs = _foundry_gir_data_get_attributes (node->data, node->index, &n_attrs);
+
+      if (n_attributes != NULL)
+        *n_attributes = n_attrs;
+
+      ret = g_new0 (const char *, (gsize)n_attrs + 1);
+
+      for (i = 0; i < n_attrs; i++)
+        ret[i] = _foundry_gir_data_get_string (node->data, attrs[i].key);
+
+      return ret;
+    }
+
   if (n_attributes != NULL)
     *n_attributes = node->attributes.length;
 
@@ -265,6 +361,8 @@ foundry_gir_node_get_children (FoundryGirNode *node)
 {
   g_return_val_if_fail (FOUNDRY_IS_GIR_NODE (node), NULL);
 
+  foundry_gir_node_ensure_children (node);
+
   return node->children.head;
 }
 
@@ -314,6 +412,8 @@ foundry_gir_node_foreach_typed (FoundryGirNode     *node,
 {
   g_assert (FOUNDRY_IS_GIR_NODE (node));
 
+  foundry_gir_node_ensure_children (node);
+
   for (const GList *iter = node->children.head; iter; iter = iter->next)
     {
       FoundryGirNode *child = iter->data;
@@ -427,6 +527,7 @@ _foundry_gir_node_add_attribute (FoundryGirNode *node,
   FoundryGirAttribute *attr;
 
   g_return_if_fail (FOUNDRY_IS_GIR_NODE (node));
+  g_return_if_fail (node->data == NULL);
   g_return_if_fail (name != NULL);
 
   if (value == NULL)
@@ -448,6 +549,7 @@ _foundry_gir_node_add_child (FoundryGirNode *parent,
                              FoundryGirNode *child)
 {
   g_return_if_fail (FOUNDRY_IS_GIR_NODE (parent));
+  g_return_if_fail (parent->data == NULL);
   g_return_if_fail (FOUNDRY_IS_GIR_NODE (child));
   g_return_if_fail (child->parent == NULL);
   g_return_if_fail (child->parent_link.data == child);
@@ -469,6 +571,7 @@ _foundry_gir_node_append_text (FoundryGirNode *node,
                                gsize           text_len)
 {
   g_return_if_fail (FOUNDRY_IS_GIR_NODE (node));
+  g_return_if_fail (node->data == NULL);
   g_return_if_fail (text != NULL);
 
   if (text_len == 0)
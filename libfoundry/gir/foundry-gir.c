@@ -20,6 +20,8 @@
 
 #include "config.h"
 
+#include <errno.h>
+
 #include "foundry-gir.h"
 
 #include "foundry-gir-node-private.h"
@@ -42,12 +44,6 @@ struct _FoundryGir
   FoundryGirNode *repository;
 };
 
-typedef struct
-{
-  GPtrArray      *stack;
-  FoundryGirNode *root;
-} FoundryGirParserState;
-
 G_DEFINE_FINAL_TYPE (FoundryGir, foundry_gir, G_TYPE_OBJECT)
 
 static void
@@ -80,272 +76,76 @@ foundry_gir_error_quark (void)
   return g_quark_from_static_string ("foundry-gir-error");
 }
 
-static FoundryGirNodeType
-foundry_gir_node_type_from_element (const char *element_name)
-{
-  static const struct
-  {
-    const char *element;
-    FoundryGirNodeType type;
-  } map[] = {
-    { "repository",         FOUNDRY_GIR_NODE_REPOSITORY },
-    { "include",            FOUNDRY_GIR_NODE_INCLUDE },
-    { "c:include",          FOUNDRY_GIR_NODE_C_INCLUDE },
-    { "package",            FOUNDRY_GIR_NODE_PACKAGE },
-    { "namespace",          FOUNDRY_GIR_NODE_NAMESPACE },
-    { "alias",              FOUNDRY_GIR_NODE_ALIAS },
-    { "array",              FOUNDRY_GIR_NODE_ARRAY },
-    { "bitfield",           FOUNDRY_GIR_NODE_BITFIELD },
-    { "callback",           FOUNDRY_GIR_NODE_CALLBACK },
-    { "class",              FOUNDRY_GIR_NODE_CLASS },
-    { "method",             FOUNDRY_GIR_NODE_METHOD },
-    { "constructor",        FOUNDRY_GIR_NODE_CONSTRUCTOR },
-    { "virtual-method",     FOUNDRY_GIR_NODE_VIRTUAL_METHOD },
-    { "function",           FOUNDRY_GIR_NODE_FUNCTION },
-    { "function-macro",     FOUNDRY_GIR_NODE_FUNCTION_MACRO },
-    { "constant",           FOUNDRY_GIR_NODE_CONSTANT },
-    { "doc:doc",            FOUNDRY_GIR_NODE_DOC },
-    { "doc:para",           FOUNDRY_GIR_NODE_DOC_PARA },
-    { "doc:text",           FOUNDRY_GIR_NODE_DOC_TEXT },
-    { "enumeration",        FOUNDRY_GIR_NODE_ENUM },
-    { "member",             FOUNDRY_GIR_NODE_ENUM_MEMBER },
-    { "field",              FOUNDRY_GIR_NODE_FIELD },
-    { "property",           FOUNDRY_GIR_NODE_PROPERTY },
-    { "glib:property",      FOUNDRY_GIR_NODE_PROPERTY },
-    { "glib:signal",        FOUNDRY_GIR_NODE_GLIB_SIGNAL },
-    { "glib:error-domain",  FOUNDRY_GIR_NODE_GLIB_ERROR_DOMAIN },
-    { "glib:boxed",         FOUNDRY_GIR_NODE_GLIB_BOXED },
-    { "implements",         FOUNDRY_GIR_NODE_IMPLEMENTS },
-    { "prerequisite",       FOUNDRY_GIR_NODE_PREREQUISITE },
-    { "parameters",         FOUNDRY_GIR_NODE_PARAMETERS },
-    { "parameter",          FOUNDRY_GIR_NODE_PARAMETER },
-    { "instance-parameter", FOUNDRY_GIR_NODE_INSTANCE_PARAMETER },
-    { "return-value",       FOUNDRY_GIR_NODE_RETURN_VALUE },
-    { "type",               FOUNDRY_GIR_NODE_TYPE },
-    { "union",              FOUNDRY_GIR_NODE_UNION },
-    { "record",             FOUNDRY_GIR_NODE_RECORD },
-    { "interface",          FOUNDRY_GIR_NODE_INTERFACE },
-    { "source-position",    FOUNDRY_GIR_NODE_SOURCE_POSITION },
-    { "varargs",            FOUNDRY_GIR_NODE_VARARGS },
-  };
-
-  for (guint i = 0; i < G_N_ELEMENTS (map); i++)
-    {
-      if (g_strcmp0 (element_name, map[i].element) == 0)
-        return map[i].type;
-    }
-
-  if (g_str_has_prefix (element_name, "doc:"))
-    return FOUNDRY_GIR_NODE_DOC;
-
-  return FOUNDRY_GIR_NODE_UNKNOWN;
-}
-
-static inline FoundryGirNode *
-foundry_gir_parser_state_peek (FoundryGirParserState *state)
-{
-  if (state->stack->len == 0)
-    return NULL;
-
-  return g_ptr_array_index (state->stack, state->stack->len - 1);
-}
-
-static void
-foundry_gir_parser_start_element (GMarkupParseContext  *context,
-                                  const char           *element_name,
-                                  const char          **attribute_names,
-                                  const char          **attribute_values,
-                                  gpointer              user_data,
-                                  GError              **error)
-{
-  FoundryGirParserState *state = user_data;
-  FoundryGirNode *parent = foundry_gir_parser_state_peek (state);
-  FoundryGirNodeType node_type = foundry_gir_node_type_from_element (element_name);
-  g_autoptr(FoundryGirNode) node = NULL;
-
-  node = foundry_gir_node_new (node_type, element_name);
-
-  for (guint i = 0; attribute_names[i] != NULL; i++)
-    _foundry_gir_node_add_attribute (node, attribute_names[i], attribute_values[i]);
-
-  if (parent == NULL)
-    {
-      if (state->root != NULL)
-        {
-          g_set_error (error,
-                       FOUNDRY_GIR_ERROR,
-                       FOUNDRY_GIR_ERROR_PARSE,
-                       "Multiple root elements encountered, expected a single <repository>");
-          return;
-        }
-
-      state->root = g_object_ref (node);
-    }
-  else
-    {
-      _foundry_gir_node_add_child (parent, node);
-    }
-
-  g_ptr_array_add (state->stack, g_steal_pointer (&node));
-}
-
-static void
-foundry_gir_parser_end_element (GMarkupParseContext  *context,
-                                const char           *element_name,
-                                gpointer              user_data,
-                                GError              **error)
-{
-  FoundryGirParserState *state = user_data;
-  FoundryGirNode *node = NULL;
-
-  if (state->stack->len == 0)
-    {
-      g_set_error (error,
-                   FOUNDRY_GIR_ERROR,
-                   FOUNDRY_GIR_ERROR_PARSE,
-                   "Unexpected closing element </%s>", element_name);
-      return;
-    }
-
-  node = g_ptr_array_index (state->stack, state->stack->len - 1);
-
-  if (g_strcmp0 (foundry_gir_node_get_tag_name (node), element_name) != 0)
-    {
-      g_set_error (error,
-                   FOUNDRY_GIR_ERROR,
-                   FOUNDRY_GIR_ERROR_PARSE,
-                   "Mismatched closing element </%s>, expected </%s>",
-                   element_name,
-                   foundry_gir_node_get_tag_name (node));
-      return;
-    }
-
-  g_ptr_array_remove_index (state->stack, state->stack->len - 1);
-  g_object_unref (node);
-}
-
-static void
-foundry_gir_parser_text (GMarkupParseContext  *context,
-                         const char           *text,
-                         gsize                 text_len,
-                         gpointer              user_data,
-                         GError              **error)
+static char *
+foundry_gir_get_cache_path (GFile *file)
 {
-  FoundryGirParserState *state = user_data;
-  FoundryGirNode *node = foundry_gir_parser_state_peek (state);
-
-  if (node == NULL)
-    return;
+  g_autofree char *uri = g_file_get_uri (file);
+  g_autofree char *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+  g_autofree char *name = g_strconcat (checksum, ".cache", NULL);
 
-  _foundry_gir_node_append_text (node, text, text_len);
-}
-
-static const GMarkupParser gir_markup_parser = {
-  .start_element = foundry_gir_parser_start_element,
-  .end_element = foundry_gir_parser_end_element,
-  .text = foundry_gir_parser_text,
-};
-
-static gboolean
-foundry_gir_parse (FoundryGirParserState  *state,
-                   GBytes                 *bytes,
-                   GError                **error)
-{
-  g_autoptr(GMarkupParseContext) context = NULL;
-  const char *data;
-  gboolean success = FALSE;
-  gsize length;
-
-  g_assert (state != NULL);
-  g_assert (bytes != NULL);
-
-  data = (const char *)g_bytes_get_data (bytes, &length);
-  context = g_markup_parse_context_new (&gir_markup_parser,
-                                        G_MARKUP_TREAT_CDATA_AS_TEXT,
-                                        state,
-                                        NULL);
-
-  if (length > (gsize)SSIZE_MAX)
-    {
-      g_set_error (error,
-                   FOUNDRY_GIR_ERROR,
-                   FOUNDRY_GIR_ERROR_PARSE,
-                   "Input length exceeds supported range");
-      return FALSE;
-    }
-
-  success = g_markup_parse_context_parse (context, data, length, error);
-
-  if (success)
-    success = g_markup_parse_context_end_parse (context, error);
-
-  if (!success)
-    return FALSE;
-
-  if (state->root == NULL)
-    {
-      g_set_error (error,
-                   FOUNDRY_GIR_ERROR,
-                   FOUNDRY_GIR_ERROR_PARSE,
-                   "Missing <repository> root element");
-      return FALSE;
-    }
-
-  if (foundry_gir_node_get_node_type (state->root) != FOUNDRY_GIR_NODE_REPOSITORY)
-    {
-      g_set_error (error,
-                   FOUNDRY_GIR_ERROR,
-                   FOUNDRY_GIR_ERROR_PARSE,
-                   "Unexpected root element <%s>, expected <repository>",
-                   foundry_gir_node_get_tag_name (state->root));
-      return FALSE;
-    }
-
-  if (state->stack->len != 0)
-    {
-      g_set_error (error,
-                   FOUNDRY_GIR_ERROR,
-                   FOUNDRY_GIR_ERROR_PARSE,
-                   "Unbalanced XML elements while parsing GIR");
-      return FALSE;
-    }
-
-  return TRUE;
+  return g_build_filename (g_get_user_cache_dir (), "foundry", "gir", name, NULL);
 }
 
+/* Parsing a large .gir is expensive, so the parsed form is saved to the
+ * user cache keyed by the mtime and size of the file. Later loads map
+ * the cache and only create nodes as they are visited.
+ */
 static DexFuture *
 foundry_gir_new_fiber (gpointer data)
 {
   GFile *file = data;
+  g_autoptr(FoundryGirData) gir_data = NULL;
   g_autoptr(FoundryGir) gir = NULL;
+  g_autoptr(GFileInfo) info = NULL;
   g_autoptr(GError) error = NULL;
-  g_autoptr(GBytes) bytes = NULL;
-  FoundryGirParserState state = {0};
-  gboolean success = FALSE;
+  g_autofree char *cache_path = NULL;
+  guint64 mtime = 0;
+  guint64 size = 0;
 
   g_assert (G_IS_FILE (file));
 
-  if (!(bytes = dex_await_boxed (dex_file_load_contents_bytes (file), &error)))
-    return dex_future_new_for_error (g_steal_pointer (&error));
-
-  state.stack = g_ptr_array_new ();
-  success = foundry_gir_parse (&state, bytes, &error);
-
-  if (success)
+  if ((info = dex_await_object (dex_file_query_info (file,
+                                                     G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                                                     G_FILE_ATTRIBUTE_TIME_MODIFIED","
+                                                     G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+                                                     G_FILE_QUERY_INFO_NONE,
+                                                     G_PRIORITY_DEFAULT),
+                                NULL)))
     {
-      gir = g_object_new (FOUNDRY_TYPE_GIR, NULL);
-      gir->file = g_object_ref (file);
-      gir->repository = g_object_ref (state.root);
+      size = g_file_info_get_size (info);
+      mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC
+            + g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+      cache_path = foundry_gir_get_cache_path (file);
+      gir_data = _foundry_gir_data_load (cache_path, mtime, size, NULL);
     }
 
-  g_ptr_array_set_free_func (state.stack, g_object_unref);
-  g_clear_pointer (&state.stack, g_ptr_array_unref);
-  g_clear_object (&state.root);
+  if (gir_data == NULL)
+    {
+      g_autoptr(GBytes) bytes = NULL;
+
+      if (!(bytes = dex_await_boxed (dex_file_load_contents_bytes (file), &error)))
+        return dex_future_new_for_error (g_steal_pointer (&error));
+
+      if (!(gir_data = _foundry_gir_data_parse (bytes, mtime, size, &error)))
+        return dex_future_new_for_error (g_steal_pointer (&error));
+
+      if (cache_path != NULL)
+        {
+          g_autofree char *directory = g_path_get_dirname (cache_path);
+
+          if (g_mkdir_with_parents (directory, 0750) != 0 ||
+              !_foundry_gir_data_save (gir_data, cache_path, &error))
+            g_debug ("Failed to save GIR cache to `%s`: %s",
+                     cache_path,
+                     error ? error->message : g_strerror (errno));
+        }
+    }
 
-  if (success)
-    return dex_future_new_take_object (g_steal_pointer (&gir));
+  gir = g_object_new (FOUNDRY_TYPE_GIR, NULL);
+  gir->file = g_object_ref (file);
+  gir->repository = _foundry_gir_node_new_for_data (gir_data, 0, NULL);
 
-  return dex_future_new_for_error (g_steal_pointer (&error));
+  return dex_future_new_take_object (g_steal_pointer (&gir));
 }
 
 /**
@@ -26,7 +26,14 @@
 
 G_BEGIN_DECLS
 
-FoundryGitBlame *_foundry_git_blame_new (git_blame *base_blame,
-                                         git_blame *bytes_blame);
+FoundryGitBlame *_foundry_git_blame_new     (git_blame       *base_blame,
+                                             git_blame       *bytes_blame);
+void             _foundry_git_blame_edit    (FoundryGitBlame *self,
+                                             guint            line,
+                                             guint            n_removed,
+                                             guint            n_inserted);
+#ifdef FOUNDRY_FEATURE_TEXT
+DexFuture       *_foundry_git_blame_reblame (FoundryGitBlame *self) G_GNUC_WARN_UNUSED_RESULT;
+#endif
 
 G_END_DECLS
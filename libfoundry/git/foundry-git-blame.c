@@ -22,10 +22,16 @@
 
 #include "foundry-git-autocleanups.h"
 #include "foundry-git-blame-private.h"
+#include "foundry-git-error.h"
 #include "foundry-git-private.h"
 #include "foundry-git-signature-private.h"
 #include "foundry-vcs-file.h"
 
+#ifdef FOUNDRY_FEATURE_TEXT
+# include "foundry-text-buffer.h"
+# include "foundry-text-iter.h"
+#endif
+
 /**
  * FoundryGitBlame:
  *
@@ -35,29 +41,186 @@
  * managing blame information for files in version control. It handles
  * blame data retrieval, caching, and provides efficient access to
  * authorship and modification information for code analysis and display.
+ *
+ * Hunks are kept in a sorted array of line intervals so that they can be
+ * shifted as a followed buffer is edited, without blaming the whole file
+ * again for every keystroke.
  */
 
+/* How long edits must be idle before the buffer is blamed again */
+#define REBLAME_DELAY_MSEC 500
+
 struct _FoundryGitBlame
 {
   FoundryVcsBlame  parent_instance;
   GMutex           mutex;
   DexLimiter      *update_limiter;
   git_blame       *base_blame;
-  git_blame       *bytes_blame;
+  GArray          *hunks;
+  guint            n_lines;
+  guint            edit_serial;
+#ifdef FOUNDRY_FEATURE_TEXT
+  GWeakRef         buffer_wr;
+  guint            commit_notify;
+  guint            reblame_source;
+#endif
 };
 
 G_DEFINE_FINAL_TYPE (FoundryGitBlame, foundry_git_blame, FOUNDRY_TYPE_VCS_BLAME)
 
+/* A run of lines attributed to the same commit. Lines which have been
+ * edited since the last blame have a zeroed @commit_id, the same as
+ * git_blame_buffer() uses for lines which are not yet committed.
+ */
+typedef struct _BlameHunk
+{
+  guint          start_line;
+  guint          n_lines;
+  git_oid        commit_id;
+  git_signature *signature;
+} BlameHunk;
+
 typedef struct _Update
 {
   FoundryGitBlame *self;
   GBytes          *contents;
+  guint            edit_serial;
+  guint            check_serial : 1;
 } Update;
 
-static git_blame *
-get_blame_locked (FoundryGitBlame *self)
+static void
+blame_hunk_clear (gpointer data)
+{
+  BlameHunk *hunk = data;
+
+  g_clear_pointer (&hunk->signature, git_signature_free);
+}
+
+static inline gboolean
+blame_hunk_is_uncommitted (const BlameHunk *hunk)
+{
+  return git_oid_is_zero (&hunk->commit_id);
+}
+
+static GArray *
+blame_hunks_new (git_blame *blame,
+                 guint     *n_lines)
+{
+  GArray *hunks;
+  gsize hunk_count;
+
+  g_assert (blame != NULL);
+  g_assert (n_lines != NULL);
+
+  hunk_count = git_blame_get_hunk_count (blame);
+
+  hunks = g_array_sized_new (FALSE, FALSE, sizeof (BlameHunk), hunk_count);
+  g_array_set_clear_func (hunks, blame_hunk_clear);
+
+  *n_lines = 0;
+
+  for (gsize i = 0; i < hunk_count; i++)
+    {
+      const git_blame_hunk *ghunk = git_blame_get_hunk_byindex (blame, i);
+      BlameHunk hunk = {0};
+
+      if (ghunk == NULL || ghunk->lines_in_hunk == 0)
+        continue;
+
+      hunk.start_line = *n_lines;
+      hunk.n_lines = ghunk->lines_in_hunk;
+      hunk.commit_id = ghunk->final_commit_id;
+
+      if (ghunk->final_signature != NULL &&
+          git_signature_dup (&hunk.signature, ghunk->final_signature) != 0)
+        hunk.signature = NULL;
+
+      g_array_append_val (hunks, hunk);
+
+      *n_lines += hunk.n_lines;
+    }
+
+  return hunks;
+}
+
+/* Returns the index of the hunk containing @line, or the number of
+ * hunks if @line is past the end of the file.
+ */
+static guint
+blame_hunks_find (GArray *hunks,
+                  guint   line)
 {
-  return self->bytes_blame ? self->bytes_blame : self->base_blame;
+  guint lo = 0;
+  guint hi = hunks->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      const BlameHunk *hunk = &g_array_index (hunks, BlameHunk, mid);
+
+      if (hunk->start_line + hunk->n_lines <= line)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+  return lo;
+}
+
+/* Splits the hunk containing @line so that a hunk starts at @line and
+ * returns the index of that hunk.
+ */
+static guint
+blame_hunks_split (GArray *hunks,
+                   guint   line)
+{
+  BlameHunk *hunk;
+  BlameHunk tail;
+  guint index;
+
+  index = blame_hunks_find (hunks, line);
+
+  if (index == hunks->len)
+    return index;
+
+  hunk = &g_array_index (hunks, BlameHunk, index);
+
+  if (hunk->start_line == line)
+    return index;
+
+  tail = *hunk;
+  tail.start_line = line;
+  tail.n_lines = hunk->start_line + hunk->n_lines - line;
+  hunk->n_lines -= tail.n_lines;
+
+  if (hunk->signature != NULL &&
+      git_signature_dup (&tail.signature, hunk->signature) != 0)
+    tail.signature = NULL;
+
+  g_array_insert_val (hunks, index + 1, tail);
+
+  return index + 1;
+}
+
+/* Joins the hunk at @index with the previous one if both are uncommitted */
+static void
+blame_hunks_join (GArray *hunks,
+                  guint   index)
+{
+  BlameHunk *prev;
+  BlameHunk *hunk;
+
+  if (index == 0 || index >= hunks->len)
+    return;
+
+  prev = &g_array_index (hunks, BlameHunk, index - 1);
+  hunk = &g_array_index (hunks, BlameHunk, index);
+
+  if (!blame_hunk_is_uncommitted (prev) || !blame_hunk_is_uncommitted (hunk))
+    return;
+
+  prev->n_lines += hunk->n_lines;
+  g_array_remove_index (hunks, index);
 }
 
 static void
@@ -74,26 +237,40 @@ foundry_git_blame_update_thread (gpointer user_data)
   Update *state = user_data;
   g_autoptr(GMutexLocker) locker = NULL;
   g_autoptr(git_blame) blame = NULL;
-  gconstpointer data = NULL;
-  gsize size = 0;
+  GArray *hunks;
+  guint n_lines;
 
   g_assert (state != NULL);
   g_assert (FOUNDRY_IS_GIT_BLAME (state->self));
   g_assert (state->self->base_blame != NULL);
 
+  if (state->contents != NULL)
+    {
+      gconstpointer data;
+      gsize size;
+
+      data = g_bytes_get_data (state->contents, &size);
+
+      if (git_blame_buffer (&blame, state->self->base_blame, data, size) != 0)
+        return foundry_git_reject_last_error ();
+    }
+
+  hunks = blame_hunks_new (blame ? blame : state->self->base_blame, &n_lines);
+
   locker = g_mutex_locker_new (&state->self->mutex);
 
-  if (state->contents == NULL)
+  /* The buffer was edited while we were blaming it. Those edits will
+   * have scheduled another blame so just drop this one.
+   */
+  if (state->check_serial && state->edit_serial != state->self->edit_serial)
     {
-      g_clear_pointer (&state->self->bytes_blame, git_blame_free);
-      return dex_future_new_true ();
+      g_array_unref (hunks);
+      return dex_future_new_false ();
     }
 
-  data = g_bytes_get_data (state->contents, &size);
-  g_clear_pointer (&state->self->bytes_blame, git_blame_free);
-
-  if (git_blame_buffer (&blame, state->self->base_blame, data, size) == 0)
-    state->self->bytes_blame = g_steal_pointer (&blame);
+  g_clear_pointer (&state->self->hunks, g_array_unref);
+  state->self->hunks = hunks;
+  state->self->n_lines = n_lines;
 
   return dex_future_new_true ();
 }
@@ -126,34 +303,32 @@ foundry_git_blame_query_line (FoundryVcsBlame *blame,
 {
   FoundryGitBlame *self = (FoundryGitBlame *)blame;
   g_autoptr(GMutexLocker) locker = NULL;
-  const git_blame_hunk *hunk;
-  git_blame *gblame;
+  g_autoptr(git_signature) copy = NULL;
+  const BlameHunk *hunk;
+  guint index;
 
   g_assert (FOUNDRY_IS_GIT_BLAME (self));
-  g_assert (self->base_blame != NULL);
+  g_assert (self->hunks != NULL);
 
   locker = g_mutex_locker_new (&self->mutex);
-  gblame = get_blame_locked (self);
 
-  if ((hunk = git_blame_get_hunk_byline (gblame, line + 1)))
-    {
-      g_autoptr(git_signature) copy = NULL;
+  if ((index = blame_hunks_find (self->hunks, line)) == self->hunks->len)
+    return NULL;
 
-      /* TODO: This is often accessed sequentially so it might make
-       *       sense to keep the most-recently-used one and then
-       *       reuse it instead of copy/construct on each line.
-       */
+  hunk = &g_array_index (self->hunks, BlameHunk, index);
 
-      if (hunk->final_signature == NULL)
-        return NULL;
+  /* TODO: This is often accessed sequentially so it might make
+   *       sense to keep the most-recently-used one and then
+   *       reuse it instead of copy/construct on each line.
+   */
 
-      if (git_signature_dup (&copy, hunk->final_signature) != 0)
-        return NULL;
+  if (hunk->signature == NULL)
+    return NULL;
 
-      return _foundry_git_signature_new (g_steal_pointer (&copy));
-    }
+  if (git_signature_dup (&copy, hunk->signature) != 0)
+    return NULL;
 
-  return NULL;
+  return _foundry_git_signature_new (g_steal_pointer (&copy));
 }
 
 /**
@@ -165,6 +340,7 @@ foundry_git_blame_query_line (FoundryVcsBlame *blame,
  * information.
  *
  * The commit ID is the hash of the commit that last modified the line.
+ * Lines which have not been committed yet have an all-zero commit ID.
  *
  * Returns: (transfer full): a newly allocated string containing the commit ID,
  *   or %NULL if the line is not found or not tracked
@@ -176,19 +352,17 @@ foundry_git_blame_dup_commit_id (FoundryGitBlame *self,
                                  guint            line)
 {
   g_autoptr(GMutexLocker) locker = NULL;
-  const git_blame_hunk *hunk;
-  git_blame *gblame;
+  guint index;
 
   g_return_val_if_fail (FOUNDRY_IS_GIT_BLAME (self), NULL);
-  g_return_val_if_fail (self->base_blame != NULL, NULL);
+  g_return_val_if_fail (self->hunks != NULL, NULL);
 
   locker = g_mutex_locker_new (&self->mutex);
-  gblame = get_blame_locked (self);
 
-  if ((hunk = git_blame_get_hunk_byline (gblame, line + 1)))
-    return _foundry_git_oid_dup_string (&hunk->final_commit_id);
+  if ((index = blame_hunks_find (self->hunks, line)) == self->hunks->len)
+    return NULL;
 
-  return NULL;
+  return _foundry_git_oid_dup_string (&g_array_index (self->hunks, BlameHunk, index).commit_id);
 }
 
 static guint
@@ -196,35 +370,115 @@ foundry_git_blame_get_n_lines (FoundryVcsBlame *blame)
 {
   FoundryGitBlame *self = (FoundryGitBlame *)blame;
   g_autoptr(GMutexLocker) locker = NULL;
-  git_blame *gblame;
-  gsize hunk_count;
-  guint n_lines = 0;
 
   g_assert (FOUNDRY_IS_GIT_BLAME (self));
-  g_assert (self->base_blame != NULL);
 
   locker = g_mutex_locker_new (&self->mutex);
-  gblame = get_blame_locked (self);
 
-  hunk_count = git_blame_get_hunk_count (gblame);
+  return self->n_lines;
+}
 
-  for (gsize i = 0; i < hunk_count; i++)
-    {
-      const git_blame_hunk *hunk = git_blame_get_hunk_byindex (gblame, i);
+#ifdef FOUNDRY_FEATURE_TEXT
+static gboolean
+foundry_git_blame_reblame_timeout (gpointer data)
+{
+  FoundryGitBlame *self = data;
 
-      if (hunk != NULL)
-        n_lines += hunk->lines_in_hunk;
+  g_assert (FOUNDRY_IS_GIT_BLAME (self));
+
+  self->reblame_source = 0;
+
+  dex_future_disown (_foundry_git_blame_reblame (self));
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+foundry_git_blame_commit_notify (FoundryTextBuffer            *buffer,
+                                 FoundryTextBufferNotifyFlags  flags,
+                                 guint                         position,
+                                 guint                         length,
+                                 gpointer                      user_data)
+{
+  FoundryGitBlame *self = user_data;
+  FoundryTextIter begin;
+  FoundryTextIter end;
+  gboolean begin_starts_line;
+  gboolean end_starts_line;
+  guint line;
+  guint n_lines;
+
+  g_assert (FOUNDRY_IS_TEXT_BUFFER (buffer));
+  g_assert (FOUNDRY_IS_GIT_BLAME (self));
+
+  foundry_text_buffer_get_iter_at_offset (buffer, &begin, position);
+  foundry_text_buffer_get_iter_at_offset (buffer, &end, position + length);
+
+  line = foundry_text_iter_get_line (&begin);
+  n_lines = foundry_text_iter_get_line (&end) - line;
+  begin_starts_line = foundry_text_iter_get_line_offset (&begin) == 0;
+  end_starts_line = foundry_text_iter_get_line_offset (&end) == 0;
+
+  /* Whole lines added or removed leave their neighbors untouched. Otherwise
+   * the line where the edit begins is modified as well. An empty line after
+   * a trailing newline is not counted as a line by git.
+   */
+  if (flags == FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT)
+    {
+      if (n_lines > 0 && begin_starts_line && end_starts_line)
+        _foundry_git_blame_edit (self, line, 0, n_lines);
+      else if (end_starts_line && foundry_text_iter_is_end (&end))
+        _foundry_git_blame_edit (self, line, 1, n_lines);
+      else
+        _foundry_git_blame_edit (self, line, 1, n_lines + 1);
+    }
+  else if (flags == FOUNDRY_TEXT_BUFFER_NOTIFY_BEFORE_DELETE)
+    {
+      if (n_lines > 0 && begin_starts_line && end_starts_line)
+        _foundry_git_blame_edit (self, line, n_lines, 0);
+      else if (begin_starts_line && foundry_text_iter_is_end (&end))
+        _foundry_git_blame_edit (self, line, n_lines + 1, 0);
+      else
+        _foundry_git_blame_edit (self, line, n_lines + 1, 1);
     }
+  else
+    return;
 
-  return n_lines;
+  g_clear_handle_id (&self->reblame_source, g_source_remove);
+  self->reblame_source = g_timeout_add (REBLAME_DELAY_MSEC,
+                                        foundry_git_blame_reblame_timeout,
+                                        self);
 }
 
+static void
+foundry_git_blame_unfollow (FoundryGitBlame *self)
+{
+  g_autoptr(FoundryTextBuffer) buffer = NULL;
+
+  g_assert (FOUNDRY_IS_GIT_BLAME (self));
+
+  g_clear_handle_id (&self->reblame_source, g_source_remove);
+
+  if (self->commit_notify != 0 &&
+      (buffer = g_weak_ref_get (&self->buffer_wr)))
+    foundry_text_buffer_remove_commit_notify (buffer, self->commit_notify);
+
+  self->commit_notify = 0;
+  g_weak_ref_set (&self->buffer_wr, NULL);
+}
+#endif
+
 static void
 foundry_git_blame_finalize (GObject *object)
 {
   FoundryGitBlame *self = (FoundryGitBlame *)object;
 
-  g_clear_pointer (&self->bytes_blame, git_blame_free);
+#ifdef FOUNDRY_FEATURE_TEXT
+  foundry_git_blame_unfollow (self);
+  g_weak_ref_clear (&self->buffer_wr);
+#endif
+
+  g_clear_pointer (&self->hunks, g_array_unref);
   g_clear_pointer (&self->base_blame, git_blame_free);
   dex_clear (&self->update_limiter);
   g_mutex_clear (&self->mutex);
@@ -249,6 +503,9 @@ static void
 foundry_git_blame_init (FoundryGitBlame *self)
 {
   g_mutex_init (&self->mutex);
+#ifdef FOUNDRY_FEATURE_TEXT
+  g_weak_ref_init (&self->buffer_wr, NULL);
+#endif
   self->update_limiter = dex_limiter_new (1);
 }
 
@@ -262,7 +519,147 @@ _foundry_git_blame_new (git_blame *base_blame,
 
   self = g_object_new (FOUNDRY_TYPE_GIT_BLAME, NULL);
   self->base_blame = g_steal_pointer (&base_blame);
-  self->bytes_blame = g_steal_pointer (&bytes_blame);
+  self->hunks = blame_hunks_new (bytes_blame ? bytes_blame : self->base_blame, &self->n_lines);
+
+  g_clear_pointer (&bytes_blame, git_blame_free);
 
   return self;
 }
+
+/**
+ * _foundry_git_blame_edit:
+ * @self: a [class@Foundry.GitBlame]
+ * @line: the first line of the edit
+ * @n_removed: the number of lines removed starting at @line
+ * @n_inserted: the number of lines inserted in their place
+ *
+ * Replaces @n_removed lines at @line with @n_inserted uncommitted lines
+ * and shifts the hunks that follow.
+ */
+void
+_foundry_git_blame_edit (FoundryGitBlame *self,
+                         guint            line,
+                         guint            n_removed,
+                         guint            n_inserted)
+{
+  g_autoptr(GMutexLocker) locker = NULL;
+  guint first;
+  guint last;
+  int delta;
+
+  g_return_if_fail (FOUNDRY_IS_GIT_BLAME (self));
+
+  locker = g_mutex_locker_new (&self->mutex);
+
+  line = MIN (line, self->n_lines);
+  n_removed = MIN (n_removed, self->n_lines - line);
+  delta = (int)n_inserted - (int)n_removed;
+
+  first = blame_hunks_split (self->hunks, line);
+  last = blame_hunks_split (self->hunks, line + n_removed);
+
+  if (last > first)
+    g_array_remove_range (self->hunks, first, last - first);
+
+  if (n_inserted > 0)
+    {
+      BlameHunk hunk = {0};
+
+      hunk.start_line = line;
+      hunk.n_lines = n_inserted;
+
+      g_array_insert_val (self->hunks, first, hunk);
+      first++;
+    }
+
+  for (guint i = first; i < self->hunks->len; i++)
+    g_array_index (self->hunks, BlameHunk, i).start_line += delta;
+
+  blame_hunks_join (self->hunks, first);
+
+  if (n_inserted > 0)
+    blame_hunks_join (self->hunks, first - 1);
+
+  self->n_lines += delta;
+  self->edit_serial++;
+}
+
+#ifdef FOUNDRY_FEATURE_TEXT
+/**
+ * _foundry_git_blame_reblame:
+ * @self: a [class@Foundry.GitBlame]
+ *
+ * Blames the contents of the followed buffer now rather than waiting
+ * for edits to become idle.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to %TRUE
+ *   if the new blame was applied, or %FALSE if there is no buffer or it
+ *   was edited again in the meantime.
+ */
+DexFuture *
+_foundry_git_blame_reblame (FoundryGitBlame *self)
+{
+  g_autoptr(FoundryTextBuffer) buffer = NULL;
+  Update *state;
+
+  dex_return_error_if_fail (FOUNDRY_IS_GIT_BLAME (self));
+
+  g_clear_handle_id (&self->reblame_source, g_source_remove);
+
+  if (!(buffer = g_weak_ref_get (&self->buffer_wr)))
+    return dex_future_new_false ();
+
+  state = g_new0 (Update, 1);
+  state->self = g_object_ref (self);
+  state->contents = foundry_text_buffer_dup_contents (buffer);
+  state->edit_serial = self->edit_serial;
+  state->check_serial = TRUE;
+
+  return dex_limiter_run_on_pool (self->update_limiter,
+                                  _foundry_git_get_thread_pool (),
+                                  foundry_git_blame_update_thread,
+                                  state,
+                                  (GDestroyNotify) update_free);
+}
+
+/**
+ * foundry_git_blame_follow_buffer:
+ * @self: a [class@Foundry.GitBlame]
+ * @buffer: (nullable): a [iface@Foundry.TextBuffer]
+ *
+ * Keeps the blame in sync with edits made to @buffer.
+ *
+ * Lines touched by an edit are reported as uncommitted immediately and the
+ * hunks after them are shifted to match. The whole buffer is only blamed
+ * again once edits have been idle for a short while.
+ *
+ * @buffer is expected to contain the contents @self was created from, such
+ * as the buffer of the [class@Foundry.TextDocument] that was blamed.
+ * Buffers which do not support commit notifications are not followed.
+ *
+ * Pass %NULL to stop following a buffer.
+ *
+ * Since: 1.2
+ */
+void
+foundry_git_blame_follow_buffer (FoundryGitBlame   *self,
+                                 FoundryTextBuffer *buffer)
+{
+  g_return_if_fail (FOUNDRY_IS_GIT_BLAME (self));
+  g_return_if_fail (!buffer || FOUNDRY_IS_TEXT_BUFFER (buffer));
+
+  foundry_git_blame_unfollow (self);
+
+  if (buffer == NULL)
+    return;
+
+  g_weak_ref_set (&self->buffer_wr, buffer);
+
+  self->commit_notify =
+    foundry_text_buffer_add_commit_notify (buffer,
+                                           (FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT |
+                                            FOUNDRY_TEXT_BUFFER_NOTIFY_BEFORE_DELETE),
+                                           foundry_git_blame_commit_notify,
+                                           self, NULL);
+}
+#endif
@@ -30,7 +30,13 @@ FOUNDRY_AVAILABLE_IN_ALL
 G_DECLARE_FINAL_TYPE (FoundryGitBlame, foundry_git_blame, FOUNDRY, GIT_BLAME, FoundryVcsBlame)
 
 FOUNDRY_AVAILABLE_IN_1_1
-char *foundry_git_blame_dup_commit_id (FoundryGitBlame *self,
-                                       guint            line);
+char *foundry_git_blame_dup_commit_id (FoundryGitBlame   *self,
+                                       guint              line);
+
+#ifdef FOUNDRY_FEATURE_TEXT
+FOUNDRY_AVAILABLE_IN_1_2
+void  foundry_git_blame_follow_buffer (FoundryGitBlame   *self,
+                                       FoundryTextBuffer *buffer);
+#endif
 
 G_END_DECLS
@@ -0,0 +1,68 @@
+/* foundry-git-commit-graph-private.h
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <git2.h>
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define FOUNDRY_GIT_BLOOM_N_HASHES 7
+
+typedef struct _FoundryGitCommitGraph FoundryGitCommitGraph;
+
+typedef struct _FoundryGitBloomKey
+{
+  guint32 hashes[FOUNDRY_GIT_BLOOM_N_HASHES];
+} FoundryGitBloomKey;
+
+FoundryGitCommitGraph *_foundry_git_commit_graph_new            (void);
+FoundryGitCommitGraph *_foundry_git_commit_graph_load           (const char                  *path,
+                                                                 GError                     **error);
+void                   _foundry_git_commit_graph_free           (FoundryGitCommitGraph       *self);
+gboolean               _foundry_git_commit_graph_save           (FoundryGitCommitGraph       *self,
+                                                                 const char                  *path,
+                                                                 GError                     **error);
+gboolean               _foundry_git_commit_graph_update         (FoundryGitCommitGraph       *self,
+                                                                 git_repository              *repository,
+                                                                 const git_oid               *tip,
+                                                                 guint                       *n_added,
+                                                                 GError                     **error);
+guint                  _foundry_git_commit_graph_get_n_commits  (FoundryGitCommitGraph       *self);
+gboolean               _foundry_git_commit_graph_lookup         (FoundryGitCommitGraph       *self,
+                                                                 const git_oid               *oid,
+                                                                 guint                       *position);
+guint                  _foundry_git_commit_graph_get_generation (FoundryGitCommitGraph       *self,
+                                                                 guint                        position);
+guint                  _foundry_git_commit_graph_get_n_parents  (FoundryGitCommitGraph       *self,
+                                                                 guint                        position);
+gboolean               _foundry_git_commit_graph_maybe_changed  (FoundryGitCommitGraph       *self,
+                                                                 guint                        position,
+                                                                 const FoundryGitBloomKey    *key);
+void                   _foundry_git_bloom_key_init              (FoundryGitBloomKey          *key,
+                                                                 const char                  *path);
+guint32                _foundry_git_murmur3                     (guint32                      seed,
+                                                                 const char                  *data,
+                                                                 gsize                        len);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryGitCommitGraph, _foundry_git_commit_graph_free)
+
+G_END_DECLS
@@ -0,0 +1,1105 @@
+/* foundry-git-commit-graph.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <gio/gio.h>
+#include <string.h>
+
+#include "foundry-git-autocleanups.h"
+#include "foundry-git-commit-graph-private.h"
+
+/* This is a cache of commit parents, generation numbers and changed-path
+ * Bloom filters using the same layout as git's commit-graph file (see
+ * gitformat-commit-graph(5)) with the OIDF, OIDL, CDAT, EDGE, BIDX and
+ * BDAT chunks. It lives in Foundry's cache directory rather than in the
+ * repository so that it can be maintained without touching .git/.
+ *
+ * Filters are computed against the first parent like git does, and use
+ * version 2 of the Bloom filter hashing (murmur3 over unsigned bytes).
+ */
+
+#define GRAPH_SIGNATURE        0x43475048 /* CGPH */
+#define GRAPH_VERSION          1
+#define GRAPH_HASH_VERSION     1          /* SHA-1 */
+#define CHUNK_OID_FANOUT       0x4f494446 /* OIDF */
+#define CHUNK_OID_LOOKUP       0x4f49444c /* OIDL */
+#define CHUNK_COMMIT_DATA      0x43444154 /* CDAT */
+#define CHUNK_EXTRA_EDGES      0x45444745 /* EDGE */
+#define CHUNK_BLOOM_INDEXES    0x42494458 /* BIDX */
+#define CHUNK_BLOOM_DATA       0x42444154 /* BDAT */
+#define PARENT_NONE            0x70000000
+#define PARENT_EXTRA_EDGE      0x80000000
+#define GENERATION_MAX         0x3FFFFFFF
+#define OID_SIZE               GIT_OID_RAWSZ
+#define COMMIT_DATA_SIZE       (OID_SIZE + 16)
+#define HEADER_SIZE            8
+#define CHUNK_ENTRY_SIZE       12
+#define BLOOM_VERSION          2
+#define BLOOM_BITS_PER_ENTRY   10
+#define BLOOM_MAX_CHANGED      512
+#define BLOOM_HEADER_SIZE      12
+#define BLOOM_SEED_0           0x293ae76f
+#define BLOOM_SEED_1           0x7e646e2c
+
+typedef struct _Entry
+{
+  git_oid oid;
+  git_oid tree;
+  gint64  time;
+  guint   generation;
+  guint   parents_offset;
+  guint   n_parents;
+  guint   bloom_offset;
+  guint   bloom_len;
+} Entry;
+
+struct _FoundryGitCommitGraph
+{
+  /* Entry sorted by oid */
+  GArray     *entries;
+  /* git_oid of parents referenced by Entry.parents_offset */
+  GArray     *parents;
+  /* Concatenated filters referenced by Entry.bloom_offset */
+  GByteArray *bloom;
+};
+
+static inline guint32
+rotate_left (guint32 value,
+             guint   count)
+{
+  return (value << count) | (value >> (32 - count));
+}
+
+guint32
+_foundry_git_murmur3 (guint32     seed,
+                      const char *data,
+                      gsize       len)
+{
+  const guint32 c1 = 0xcc9e2d51;
+  const guint32 c2 = 0x1b873593;
+  const guchar *bytes = (const guchar *)data;
+  const guchar *tail;
+  guint32 hash = seed;
+  guint32 k1 = 0;
+  gsize n_blocks = len / 4;
+
+  for (gsize i = 0; i < n_blocks; i++)
+    {
+      guint32 k = ((guint32)bytes[4*i] |
+                   ((guint32)bytes[4*i+1] << 8) |
+                   ((guint32)bytes[4*i+2] << 16) |
+                   ((guint32)bytes[4*i+3] << 24));
+
+      k *= c1;
+      k = rotate_left (k, 15);
+      k *= c2;
+
+      hash ^= k;
+      hash = rotate_left (hash, 13) * 5 + 0xe6546b64;
+    }
+
+  tail = bytes + (n_blocks * 4);
+
+  switch (len & 3)
+    {
+    case 3:
+      k1 ^= (guint32)tail[2] << 16;
+      G_GNUC_FALLTHROUGH;
+    case 2:
+      k1 ^= (guint32)tail[1] << 8;
+      G_GNUC_FALLTHROUGH;
+    case 1:
+      k1 ^= (guint32)tail[0];
+      k1 *= c1;
+      k1 = rotate_left (k1, 15);
+      k1 *= c2;
+      hash ^= k1;
+      break;
+
+    default:
+      break;
+    }
+
+  hash ^= (guint32)len;
+  hash ^= (hash >> 16);
+  hash *= 0x85ebca6b;
+  hash ^= (hash >> 13);
+  hash *= 0xc2b2ae35;
+  hash ^= (hash >> 16);
+
+  return hash;
+}
+
+void
+_foundry_git_bloom_key_init (FoundryGitBloomKey *key,
+                             const char         *path)
+{
+  gsize len;
+  guint32 hash0;
+  guint32 hash1;
+
+  g_return_if_fail (key != NULL);
+  g_return_if_fail (path != NULL);
+
+  len = strlen (path);
+  hash0 = _foundry_git_murmur3 (BLOOM_SEED_0, path, len);
+  hash1 = _foundry_git_murmur3 (BLOOM_SEED_1, path, len);
+
+  for (guint i = 0; i < FOUNDRY_GIT_BLOOM_N_HASHES; i++)
+    key->hashes[i] = hash0 + i * hash1;
+}
+
+static inline gboolean
+bloom_contains (const guint8             *data,
+                gsize                     len,
+                const FoundryGitBloomKey *key)
+{
+  guint64 n_bits = (guint64)len * 8;
+
+  for (guint i = 0; i < FOUNDRY_GIT_BLOOM_N_HASHES; i++)
+    {
+      guint64 pos = key->hashes[i] % n_bits;
+
+      if (!(data[pos >> 3] & (1 << (pos & 7))))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static inline void
+bloom_add (guint8                   *data,
+           gsize                     len,
+           const FoundryGitBloomKey *key)
+{
+  guint64 n_bits = (guint64)len * 8;
+
+  for (guint i = 0; i < FOUNDRY_GIT_BLOOM_N_HASHES; i++)
+    {
+      guint64 pos = key->hashes[i] % n_bits;
+
+      data[pos >> 3] |= (1 << (pos & 7));
+    }
+}
+
+static int
+compare_entry (gconstpointer a,
+               gconstpointer b)
+{
+  return git_oid_cmp (&((const Entry *)a)->oid, &((const Entry *)b)->oid);
+}
+
+static guint
+oid_hash (gconstpointer data)
+{
+  const git_oid *oid = data;
+  guint hash;
+
+  memcpy (&hash, oid->id, sizeof hash);
+
+  return hash;
+}
+
+static gboolean
+oid_equal (gconstpointer a,
+           gconstpointer b)
+{
+  return git_oid_equal (a, b);
+}
+
+FoundryGitCommitGraph *
+_foundry_git_commit_graph_new (void)
+{
+  FoundryGitCommitGraph *self;
+
+  self = g_new0 (FoundryGitCommitGraph, 1);
+  self->entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+  self->parents = g_array_new (FALSE, FALSE, sizeof (git_oid));
+  self->bloom = g_byte_array_new ();
+
+  return self;
+}
+
+void
+_foundry_git_commit_graph_free (FoundryGitCommitGraph *self)
+{
+  if (self == NULL)
+    return;
+
+  g_clear_pointer (&self->entries, g_array_unref);
+  g_clear_pointer (&self->parents, g_array_unref);
+  g_clear_pointer (&self->bloom, g_byte_array_unref);
+  g_free (self);
+}
+
+guint
+_foundry_git_commit_graph_get_n_commits (FoundryGitCommitGraph *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->entries->len;
+}
+
+gboolean
+_foundry_git_commit_graph_lookup (FoundryGitCommitGraph *self,
+                                  const git_oid         *oid,
+                                  guint                 *position)
+{
+  guint lo = 0;
+  guint hi;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (oid != NULL, FALSE);
+
+  hi = self->entries->len;
+
+  while (lo < hi)
+    {
+      guint mid = lo + (hi - lo) / 2;
+      const Entry *entry = &g_array_index (self->entries, Entry, mid);
+      int cmp = git_oid_cmp (oid, &entry->oid);
+
+      if (cmp == 0)
+        {
+          if (position != NULL)
+            *position = mid;
+          return TRUE;
+        }
+
+      if (cmp < 0)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+
+  return FALSE;
+}
+
+guint
+_foundry_git_commit_graph_get_generation (FoundryGitCommitGraph *self,
+                                          guint                  position)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (position < self->entries->len, 0);
+
+  return g_array_index (self->entries, Entry, position).generation;
+}
+
+guint
+_foundry_git_commit_graph_get_n_parents (FoundryGitCommitGraph *self,
+                                         guint                  position)
+{
+  g_return_val_if_fail (self != NULL, 0);
+  g_return_val_if_fail (position < self->entries->len, 0);
+
+  return g_array_index (self->entries, Entry, position).n_parents;
+}
+
+/*
+ * _foundry_git_commit_graph_maybe_changed:
+ *
+ * Checks the changed-path filter of the commit at @position.
+ *
+ * Returns: %FALSE if the path of @key was definitely not changed by the
+ *   commit relative to its first parent, otherwise %TRUE.
+ */
+gboolean
+_foundry_git_commit_graph_maybe_changed (FoundryGitCommitGraph    *self,
+                                         guint                     position,
+                                         const FoundryGitBloomKey *key)
+{
+  const Entry *entry;
+
+  g_return_val_if_fail (self != NULL, TRUE);
+  g_return_val_if_fail (position < self->entries->len, TRUE);
+  g_return_val_if_fail (key != NULL, TRUE);
+
+  entry = &g_array_index (self->entries, Entry, position);
+
+  if (entry->bloom_len == 0)
+    return TRUE;
+
+  return bloom_contains (self->bloom->data + entry->bloom_offset, entry->bloom_len, key);
+}
+
+static void
+add_changed_path (GHashTable *paths,
+                  const char *path)
+{
+  char *copy;
+  char *slash;
+
+  if (path == NULL || g_hash_table_contains (paths, path))
+    return;
+
+  copy = g_strdup (path);
+  g_hash_table_add (paths, copy);
+
+  /* Leading directories are part of the filter too */
+  copy = g_strdup (path);
+  while ((slash = strrchr (copy, '/')))
+    {
+      *slash = 0;
+
+      if (g_hash_table_contains (paths, copy))
+        break;
+
+      g_hash_table_add (paths, g_strdup (copy));
+    }
+
+  g_free (copy);
+}
+
+static gboolean
+compute_bloom (FoundryGitCommitGraph  *self,
+               git_repository         *repository,
+               git_commit             *commit,
+               Entry                  *entry,
+               GError                **error)
+{
+  g_autoptr(GHashTable) paths = NULL;
+  g_autoptr(git_commit) parent = NULL;
+  g_autoptr(git_tree) parent_tree = NULL;
+  g_autoptr(git_tree) tree = NULL;
+  g_autoptr(git_diff) diff = NULL;
+  GHashTableIter iter;
+  const char *path;
+  gsize n_deltas;
+  guint n_paths;
+
+  if (git_commit_tree (&tree, commit) != 0)
+    goto failure;
+
+  /* Root commits (or missing parents in shallow clones) are compared
+   * against the empty tree.
+   */
+  if (git_commit_parentcount (commit) > 0 &&
+      git_commit_parent (&parent, commit, 0) == 0 &&
+      git_commit_tree (&parent_tree, parent) != 0)
+    goto failure;
+
+  if (git_diff_tree_to_tree (&diff, repository, parent_tree, tree, NULL) != 0)
+    goto failure;
+
+  paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  n_deltas = git_diff_num_deltas (diff);
+
+  for (gsize i = 0; i < n_deltas && g_hash_table_size (paths) <= BLOOM_MAX_CHANGED; i++)
+    {
+      const git_diff_delta *delta = git_diff_get_delta (diff, i);
+
+      add_changed_path (paths, delta->old_file.path);
+      add_changed_path (paths, delta->new_file.path);
+    }
+
+  n_paths = g_hash_table_size (paths);
+
+  entry->bloom_offset = self->bloom->len;
+
+  if (n_paths > BLOOM_MAX_CHANGED)
+    {
+      /* Too many changes, matches everything */
+      static const guint8 all[1] = { 0xFF };
+
+      entry->bloom_len = 1;
+      g_byte_array_append (self->bloom, all, 1);
+    }
+  else if (n_paths == 0)
+    {
+      /* No changes, matches nothing */
+      static const guint8 none[1] = { 0x00 };
+
+      entry->bloom_len = 1;
+      g_byte_array_append (self->bloom, none, 1);
+    }
+  else
+    {
+      entry->bloom_len = (n_paths * BLOOM_BITS_PER_ENTRY + 7) / 8;
+      g_byte_array_set_size (self->bloom, entry->bloom_offset + entry->bloom_len);
+      memset (self->bloom->data + entry->bloom_offset, 0, entry->bloom_len);
+
+      g_hash_table_iter_init (&iter, paths);
+      while (g_hash_table_iter_next (&iter, (gpointer *)&path, NULL))
+        {
+          FoundryGitBloomKey key;
+
+          _foundry_git_bloom_key_init (&key, path);
+          bloom_add (self->bloom->data + entry->bloom_offset, entry->bloom_len, &key);
+        }
+    }
+
+  return TRUE;
+
+failure:
+  {
+    const git_error *e = git_error_last ();
+
+    g_set_error (error,
+                 G_IO_ERROR,
+                 G_IO_ERROR_FAILED,
+                 "%s",
+                 e ? e->message : "Failed to diff commit");
+    return FALSE;
+  }
+}
+
+static void
+compute_generations (FoundryGitCommitGraph *self,
+                     GArray                *added,
+                     GHashTable            *added_index)
+{
+  g_autoptr(GArray) stack = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < added->len; i++)
+    {
+      g_array_append_val (stack, i);
+
+      while (stack->len > 0)
+        {
+          guint index = g_array_index (stack, guint, stack->len - 1);
+          Entry *entry = &g_array_index (added, Entry, index);
+          gboolean pending = FALSE;
+          guint generation = 0;
+
+          if (entry->generation != 0)
+            {
+              g_array_set_size (stack, stack->len - 1);
+              continue;
+            }
+
+          for (guint p = 0; p < entry->n_parents; p++)
+            {
+              const git_oid *parent = &g_array_index (self->parents, git_oid, entry->parents_offset + p);
+              gpointer value;
+              guint position;
+
+              if (_foundry_git_commit_graph_lookup (self, parent, &position))
+                {
+                  generation = MAX (generation, g_array_index (self->entries, Entry, position).generation);
+                }
+              else if ((value = g_hash_table_lookup (added_index, parent)))
+                {
+                  guint parent_index = GPOINTER_TO_UINT (value) - 1;
+                  const Entry *parent_entry = &g_array_index (added, Entry, parent_index);
+
+                  if (parent_entry->generation == 0)
+                    {
+                      g_array_append_val (stack, parent_index);
+                      pending = TRUE;
+                    }
+                  else
+                    {
+                      generation = MAX (generation, parent_entry->generation);
+                    }
+                }
+            }
+
+          if (!pending)
+            {
+              entry->generation = MIN (generation + 1, GENERATION_MAX);
+              g_array_set_size (stack, stack->len - 1);
+            }
+        }
+    }
+}
+
+/*
+ * _foundry_git_commit_graph_update:
+ * @tip: the commit to start walking from
+ * @n_added: (out) (optional): location for the number of new commits
+ *
+ * Adds every commit reachable from @tip that is not yet in the graph.
+ * The walk stops at commits which are already known so only new commits
+ * are diffed.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set
+ */
+gboolean
+_foundry_git_commit_graph_update (FoundryGitCommitGraph  *self,
+                                  git_repository         *repository,
+                                  const git_oid          *tip,
+                                  guint                  *n_added,
+                                  GError                **error)
+{
+  g_autoptr(GHashTable) added_index = NULL;
+  g_autoptr(GArray) added = NULL;
+  g_autoptr(GArray) stack = NULL;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (repository != NULL, FALSE);
+  g_return_val_if_fail (tip != NULL, FALSE);
+
+  added = g_array_new (FALSE, FALSE, sizeof (Entry));
+  added_index = g_hash_table_new_full (oid_hash, oid_equal, g_free, NULL);
+  stack = g_array_new (FALSE, FALSE, sizeof (git_oid));
+
+  g_array_append_vals (stack, tip, 1);
+
+  while (stack->len > 0)
+    {
+      g_autoptr(git_commit) commit = NULL;
+      git_oid oid = g_array_index (stack, git_oid, stack->len - 1);
+      Entry entry = {0};
+      guint n_parents;
+
+      g_array_set_size (stack, stack->len - 1);
+
+      if (_foundry_git_commit_graph_lookup (self, &oid, NULL) ||
+          g_hash_table_contains (added_index, &oid))
+        continue;
+
+      /* Parents may be missing in shallow clones */
+      if (git_commit_lookup (&commit, repository, &oid) != 0)
+        continue;
+
+      n_parents = git_commit_parentcount (commit);
+
+      entry.oid = oid;
+      entry.tree = *git_commit_tree_id (commit);
+      entry.time = git_commit_time (commit);
+      entry.parents_offset = self->parents->len;
+      entry.n_parents = n_parents;
+
+      for (guint i = 0; i < n_parents; i++)
+        {
+          const git_oid *parent = git_commit_parent_id (commit, i);
+
+          g_array_append_vals (self->parents, parent, 1);
+          g_array_append_vals (stack, parent, 1);
+        }
+
+      if (!compute_bloom (self, repository, commit, &entry, error))
+        return FALSE;
+
+      g_array_append_val (added, entry);
+      g_hash_table_insert (added_index,
+                           g_memdup2 (&oid, sizeof oid),
+                           GUINT_TO_POINTER (added->len));
+    }
+
+  if (added->len > 0)
+    {
+      compute_generations (self, added, added_index);
+
+      g_array_append_vals (self->entries, added->data, added->len);
+      g_array_sort (self->entries, compare_entry);
+    }
+
+  if (n_added != NULL)
+    *n_added = added->len;
+
+  return TRUE;
+}
+
+static inline void
+put_be32 (GByteArray *bytes,
+          guint32     value)
+{
+  value = GUINT32_TO_BE (value);
+  g_byte_array_append (bytes, (const guint8 *)&value, sizeof value);
+}
+
+static inline void
+put_be64 (GByteArray *bytes,
+          guint64     value)
+{
+  value = GUINT64_TO_BE (value);
+  g_byte_array_append (bytes, (const guint8 *)&value, sizeof value);
+}
+
+static inline guint32
+get_be32 (const guint8 *data)
+{
+  guint32 value;
+
+  memcpy (&value, data, sizeof value);
+
+  return GUINT32_FROM_BE (value);
+}
+
+static inline guint64
+get_be64 (const guint8 *data)
+{
+  guint64 value;
+
+  memcpy (&value, data, sizeof value);
+
+  return GUINT64_FROM_BE (value);
+}
+
+/* Parents which are not part of the graph (shallow clones) are dropped
+ * since they cannot be referenced by position.
+ */
+static guint
+collect_parent_positions (FoundryGitCommitGraph *self,
+                          const Entry           *entry,
+                          GArray                *positions)
+{
+  g_array_set_size (positions, 0);
+
+  for (guint p = 0; p < entry->n_parents; p++)
+    {
+      const git_oid *parent = &g_array_index (self->parents, git_oid, entry->parents_offset + p);
+      guint position;
+
+      if (_foundry_git_commit_graph_lookup (self, parent, &position))
+        g_array_append_val (positions, position);
+    }
+
+  return positions->len;
+}
+
+gboolean
+_foundry_git_commit_graph_save (FoundryGitCommitGraph  *self,
+                                const char             *path,
+                                GError                **error)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autoptr(GByteArray) bytes = NULL;
+  g_autoptr(GArray) positions = NULL;
+  guint8 digest[20];
+  gsize digest_len = sizeof digest;
+  guint32 fanout[256] = {0};
+  guint64 chunk_ids[6];
+  guint64 chunk_sizes[6];
+  guint64 offset;
+  guint n_chunks = 0;
+  guint n_edges = 0;
+  guint n_bloom = 0;
+  guint n_edge = 0;
+  guint32 bloom_end = 0;
+  guint n;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (path != NULL, FALSE);
+
+  n = self->entries->len;
+  positions = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = 0; i < n; i++)
+    {
+      const Entry *entry = &g_array_index (self->entries, Entry, i);
+      guint n_parents = collect_parent_positions (self, entry, positions);
+
+      fanout[entry->oid.id[0]]++;
+
+      if (n_parents > 2)
+        n_edges += n_parents - 1;
+
+      n_bloom += entry->bloom_len;
+    }
+
+  for (guint i = 1; i < G_N_ELEMENTS (fanout); i++)
+    fanout[i] += fanout[i - 1];
+
+#define ADD_CHUNK(id, size) \
+  G_STMT_START { \
+    chunk_ids[n_chunks] = (id); \
+    chunk_sizes[n_chunks] = (size); \
+    n_chunks++; \
+  } G_STMT_END
+
+  ADD_CHUNK (CHUNK_OID_FANOUT, 256 * 4);
+  ADD_CHUNK (CHUNK_OID_LOOKUP, (guint64)n * OID_SIZE);
+  ADD_CHUNK (CHUNK_COMMIT_DATA, (guint64)n * COMMIT_DATA_SIZE);
+  if (n_edges > 0)
+    ADD_CHUNK (CHUNK_EXTRA_EDGES, (guint64)n_edges * 4);
+  ADD_CHUNK (CHUNK_BLOOM_INDEXES, (guint64)n * 4);
+  ADD_CHUNK (CHUNK_BLOOM_DATA, BLOOM_HEADER_SIZE + (guint64)n_bloom);
+
+#undef ADD_CHUNK
+
+  bytes = g_byte_array_sized_new (HEADER_SIZE +
+                                  (n_chunks + 1) * CHUNK_ENTRY_SIZE +
+                                  n * (OID_SIZE + COMMIT_DATA_SIZE + 4) +
+                                  n_bloom + 4096);
+
+  /* Header */
+  put_be32 (bytes, GRAPH_SIGNATURE);
+  g_byte_array_append (bytes, (const guint8[]) { GRAPH_VERSION, GRAPH_HASH_VERSION, n_chunks, 0 }, 4);
+
+  /* Table of contents, terminated by a zero id with the end offset */
+  offset = HEADER_SIZE + (n_chunks + 1) * CHUNK_ENTRY_SIZE;
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      put_be32 (bytes, chunk_ids[i]);
+      put_be64 (bytes, offset);
+      offset += chunk_sizes[i];
+    }
+  put_be32 (bytes, 0);
+  put_be64 (bytes, offset);
+
+  /* OIDF */
+  for (guint i = 0; i < G_N_ELEMENTS (fanout); i++)
+    put_be32 (bytes, fanout[i]);
+
+  /* OIDL */
+  for (guint i = 0; i < n; i++)
+    g_byte_array_append (bytes, g_array_index (self->entries, Entry, i).oid.id, OID_SIZE);
+
+  /* CDAT */
+  for (guint i = 0; i < n; i++)
+    {
+      const Entry *entry = &g_array_index (self->entries, Entry, i);
+      guint n_parents = collect_parent_positions (self, entry, positions);
+      guint64 time = (guint64)MAX (entry->time, 0);
+
+      g_byte_array_append (bytes, entry->tree.id, OID_SIZE);
+
+      put_be32 (bytes, n_parents > 0 ? g_array_index (positions, guint, 0) : PARENT_NONE);
+
+      if (n_parents > 2)
+        {
+          put_be32 (bytes, PARENT_EXTRA_EDGE | n_edge);
+          n_edge += n_parents - 1;
+        }
+      else
+        {
+          put_be32 (bytes, n_parents > 1 ? g_array_index (positions, guint, 1) : PARENT_NONE);
+        }
+
+      put_be32 (bytes, (MIN (entry->generation, GENERATION_MAX) << 2) | ((time >> 32) & 0x3));
+      put_be32 (bytes, time & 0xFFFFFFFF);
+    }
+
+  /* EDGE */
+  if (n_edges > 0)
+    {
+      for (guint i = 0; i < n; i++)
+        {
+          const Entry *entry = &g_array_index (self->entries, Entry, i);
+          guint n_parents = collect_parent_positions (self, entry, positions);
+
+          if (n_parents <= 2)
+            continue;
+
+          for (guint p = 1; p < n_parents; p++)
+            {
+              guint32 value = g_array_index (positions, guint, p);
+
+              if (p + 1 == n_parents)
+                value |= PARENT_EXTRA_EDGE;
+
+              put_be32 (bytes, value);
+            }
+        }
+    }
+
+  /* BIDX */
+  for (guint i = 0; i < n; i++)
+    {
+      bloom_end += g_array_index (self->entries, Entry, i).bloom_len;
+      put_be32 (bytes, bloom_end);
+    }
+
+  /* BDAT */
+  put_be32 (bytes, BLOOM_VERSION);
+  put_be32 (bytes, FOUNDRY_GIT_BLOOM_N_HASHES);
+  put_be32 (bytes, BLOOM_BITS_PER_ENTRY);
+
+  for (guint i = 0; i < n; i++)
+    {
+      const Entry *entry = &g_array_index (self->entries, Entry, i);
+
+      g_byte_array_append (bytes, self->bloom->data + entry->bloom_offset, entry->bloom_len);
+    }
+
+  g_assert (bytes->len == offset);
+
+  /* Trailing checksum of the contents */
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, bytes->data, bytes->len);
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  g_byte_array_append (bytes, digest, digest_len);
+
+  return g_file_set_contents_full (path,
+                                   (const char *)bytes->data,
+                                   bytes->len,
+                                   G_FILE_SET_CONTENTS_CONSISTENT,
+                                   0644,
+                                   error);
+}
+
+static gboolean
+invalid (GError **error)
+{
+  g_set_error_literal (error,
+                       G_IO_ERROR,
+                       G_IO_ERROR_INVALID_DATA,
+                       "Invalid commit-graph");
+  return FALSE;
+}
+
+static gboolean
+parse_graph (FoundryGitCommitGraph  *self,
+             const guint8           *data,
+             gsize                   len,
+             GError                **error)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  const guint8 *fanout = NULL;
+  const guint8 *lookup = NULL;
+  const guint8 *commit_data = NULL;
+  const guint8 *edges = NULL;
+  const guint8 *bloom_indexes = NULL;
+  const guint8 *bloom_data = NULL;
+  guint64 edges_len = 0;
+  guint64 bloom_data_len = 0;
+  guint8 digest[20];
+  gsize digest_len = sizeof digest;
+  gboolean has_bloom;
+  guint n_chunks;
+  gsize end;
+  guint n;
+
+  if (len < HEADER_SIZE + CHUNK_ENTRY_SIZE + sizeof digest)
+    return invalid (error);
+
+  end = len - sizeof digest;
+
+  if (get_be32 (data) != GRAPH_SIGNATURE ||
+      data[4] != GRAPH_VERSION ||
+      data[5] != GRAPH_HASH_VERSION ||
+      data[7] != 0)
+    return invalid (error);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  g_checksum_update (checksum, data, end);
+  g_checksum_get_digest (checksum, digest, &digest_len);
+
+  if (memcmp (digest, data + end, sizeof digest) != 0)
+    return invalid (error);
+
+  n_chunks = data[6];
+
+  if (HEADER_SIZE + (gsize)(n_chunks + 1) * CHUNK_ENTRY_SIZE > end)
+    return invalid (error);
+
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      const guint8 *toc = data + HEADER_SIZE + i * CHUNK_ENTRY_SIZE;
+      guint32 id = get_be32 (toc);
+      guint64 chunk_offset = get_be64 (toc + 4);
+      guint64 next_offset = get_be64 (toc + 4 + CHUNK_ENTRY_SIZE);
+      guint64 chunk_len;
+
+      if (chunk_offset > next_offset || next_offset > end)
+        return invalid (error);
+
+      chunk_len = next_offset - chunk_offset;
+
+      switch (id)
+        {
+        case CHUNK_OID_FANOUT:
+          if (chunk_len != 256 * 4)
+            return invalid (error);
+          fanout = data + chunk_offset;
+          break;
+
+        case CHUNK_OID_LOOKUP:
+          lookup = data + chunk_offset;
+          break;
+
+        case CHUNK_COMMIT_DATA:
+          commit_data = data + chunk_offset;
+          break;
+
+        case CHUNK_EXTRA_EDGES:
+          edges = data + chunk_offset;
+          edges_len = chunk_len / 4;
+          break;
+
+        case CHUNK_BLOOM_INDEXES:
+          bloom_indexes = data + chunk_offset;
+          break;
+
+        case CHUNK_BLOOM_DATA:
+          if (chunk_len < BLOOM_HEADER_SIZE)
+            return invalid (error);
+          bloom_data = data + chunk_offset;
+          bloom_data_len = chunk_len;
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  if (fanout == NULL || lookup == NULL || commit_data == NULL)
+    return invalid (error);
+
+  n = get_be32 (fanout + 255 * 4);
+
+  /* Chunk sizes are implied by the number of commits */
+  for (guint i = 0; i < n_chunks; i++)
+    {
+      const guint8 *toc = data + HEADER_SIZE + i * CHUNK_ENTRY_SIZE;
+      guint64 chunk_len = get_be64 (toc + 4 + CHUNK_ENTRY_SIZE) - get_be64 (toc + 4);
+
+      switch (get_be32 (toc))
+        {
+        case CHUNK_OID_LOOKUP:
+          if (chunk_len != (guint64)n * OID_SIZE)
+            return invalid (error);
+          break;
+
+        case CHUNK_COMMIT_DATA:
+          if (chunk_len != (guint64)n * COMMIT_DATA_SIZE)
+            return invalid (error);
+          break;
+
+        case CHUNK_BLOOM_INDEXES:
+          if (chunk_len != (guint64)n * 4)
+            return invalid (error);
+          break;
+
+        default:
+          break;
+        }
+    }
+
+  /* Filters written with other settings are ignored, which makes every
+   * commit a candidate rather than producing wrong answers.
+   */
+  has_bloom = (bloom_indexes != NULL &&
+               bloom_data != NULL &&
+               get_be32 (bloom_data) == BLOOM_VERSION &&
+               get_be32 (bloom_data + 4) == FOUNDRY_GIT_BLOOM_N_HASHES &&
+               get_be32 (bloom_data + 8) == BLOOM_BITS_PER_ENTRY);
+
+  if (has_bloom)
+    g_byte_array_append (self->bloom,
+                         bloom_data + BLOOM_HEADER_SIZE,
+                         bloom_data_len - BLOOM_HEADER_SIZE);
+
+  g_array_set_size (self->entries, n);
+
+  for (guint i = 0; i < n; i++)
+    {
+      Entry *entry = &g_array_index (self->entries, Entry, i);
+
+      memset (entry, 0, sizeof *entry);
+      memcpy (entry->oid.id, lookup + (gsize)i * OID_SIZE, OID_SIZE);
+
+      if (i > 0 && git_oid_cmp (&entry[-1].oid, &entry->oid) >= 0)
+        return invalid (error);
+    }
+
+  for (guint i = 0; i < n; i++)
+    {
+      Entry *entry = &g_array_index (self->entries, Entry, i);
+      const guint8 *cdat = commit_data + (gsize)i * COMMIT_DATA_SIZE;
+      guint32 parent1 = get_be32 (cdat + OID_SIZE);
+      guint32 parent2 = get_be32 (cdat + OID_SIZE + 4);
+      guint32 generation = get_be32 (cdat + OID_SIZE + 8);
+      guint32 time = get_be32 (cdat + OID_SIZE + 12);
+
+      memcpy (entry->tree.id, cdat, OID_SIZE);
+      entry->generation = generation >> 2;
+      entry->time = ((gint64)(generation & 0x3) << 32) | time;
+      entry->parents_offset = self->parents->len;
+
+      if (parent1 != PARENT_NONE)
+        {
+          if (parent1 >= n)
+            return invalid (error);
+
+          g_array_append_vals (self->parents, &g_array_index (self->entries, Entry, parent1).oid, 1);
+        }
+
+      if (parent2 != PARENT_NONE && (parent2 & PARENT_EXTRA_EDGE) != 0)
+        {
+          guint64 edge = parent2 & ~PARENT_EXTRA_EDGE;
+          guint32 value;
+
+          do
+            {
+              if (edges == NULL || edge >= edges_len)
+                return invalid (error);
+
+              value = get_be32 (edges + edge * 4);
+
+              if ((value & ~PARENT_EXTRA_EDGE) >= n)
+                return invalid (error);
+
+              g_array_append_vals (self->parents,
+                                   &g_array_index (self->entries, Entry, value & ~PARENT_EXTRA_EDGE).oid,
+                                   1);
+              edge++;
+            }
+          while ((value & PARENT_EXTRA_EDGE) == 0);
+        }
+      else if (parent2 != PARENT_NONE)
+        {
+          if (parent2 >= n)
+            return invalid (error);
+
+          g_array_append_vals (self->parents, &g_array_index (self->entries, Entry, parent2).oid, 1);
+        }
+
+      entry->n_parents = self->parents->len - entry->parents_offset;
+
+      if (has_bloom)
+        {
+          guint32 begin = i > 0 ? get_be32 (bloom_indexes + (i - 1) * 4) : 0;
+          guint32 bloom_end = get_be32 (bloom_indexes + i * 4);
+
+          if (begin > bloom_end || bloom_end > self->bloom->len)
+            return invalid (error);
+
+          entry->bloom_offset = begin;
+          entry->bloom_len = bloom_end - begin;
+        }
+    }
+
+  return TRUE;
+}
+
+/*
+ * _foundry_git_commit_graph_load:
+ *
+ * Loads a commit-graph previously written with
+ * _foundry_git_commit_graph_save().
+ *
+ * Returns: (transfer full) (nullable): a graph or %NULL and @error is set
+ */
+FoundryGitCommitGraph *
+_foundry_git_commit_graph_load (const char  *path,
+                                GError     **error)
+{
+  g_autoptr(FoundryGitCommitGraph) self = NULL;
+  g_autoptr(GMappedFile) mapped = NULL;
+
+  g_return_val_if_fail (path != NULL, NULL);
+
+  if (!(mapped = g_mapped_file_new (path, FALSE, error)))
+    return NULL;
+
+  self = _foundry_git_commit_graph_new ();
+
+  if (!parse_graph (self,
+                    (const guint8 *)g_mapped_file_get_contents (mapped),
+                    g_mapped_file_get_length (mapped),
+                    error))
+    return NULL;
+
+  return g_steal_pointer (&self);
+}
@@ -0,0 +1,45 @@
+/* foundry-git-graph-layout-private.h
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <git2.h>
+
+#include "foundry-git-graph-private.h"
+
+G_BEGIN_DECLS
+
+FoundryGitGraphLayout *foundry_git_graph_layout_new         (git_repository          *repository,
+                                                             const git_oid           *start,
+                                                             const git_oid           *end,
+                                                             guint                    limit,
+                                                             GError                 **error);
+gboolean               foundry_git_graph_layout_step        (FoundryGitGraphLayout   *self,
+                                                             FoundryGitGraphBuilder  *builder,
+                                                             guint                    max_rows,
+                                                             guint                   *n_added,
+                                                             GError                 **error);
+gboolean               foundry_git_graph_layout_is_done     (FoundryGitGraphLayout   *self);
+guint                  foundry_git_graph_layout_get_n_lanes (FoundryGitGraphLayout   *self);
+void                   foundry_git_graph_layout_free        (FoundryGitGraphLayout   *self);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryGitGraphLayout, foundry_git_graph_layout_free)
+
+G_END_DECLS
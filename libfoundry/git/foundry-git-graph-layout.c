@@ -0,0 +1,648 @@
+/* foundry-git-graph-layout.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include "foundry-git-autocleanups.h"
+#include "foundry-git-error.h"
+#include "foundry-git-graph-layout-private.h"
+#include "foundry-git-private.h"
+#include "foundry-trace-private.h"
+
+/* The layout keeps the revwalk and the lane assignment between calls to
+ * foundry_git_graph_layout_step() so that a graph can be produced a page
+ * at a time while being identical to laying it out in a single pass.
+ *
+ * libgit2 sorts the reachable history topologically before returning the
+ * first commit, so paging defers the layout but not that walk. Its order
+ * is what the graph is defined by, so it is not replaced with our own.
+ */
+struct _FoundryGitGraphLayout
+{
+  git_repository *repository;
+  git_revwalk *walker;
+  GHashTable *collapsed;
+  GArray *lanes;
+  guint next_color_id;
+  guint n_items;
+  guint n_lanes;
+  guint limit;
+  guint done : 1;
+};
+
+static gboolean
+set_last_error (GError **error)
+{
+  const git_error *e = git_error_last ();
+
+  g_set_error_literal (error, FOUNDRY_GIT_ERROR, e->klass, e->message);
+
+  return FALSE;
+}
+
+typedef struct _HistoryLane
+{
+  git_oid oid;
+  guint color_id;
+  guint inactive;
+} HistoryLane;
+
+typedef struct _HistoryCollapsedLane
+{
+  git_oid oid;
+  guint color_id;
+  guint index;
+} HistoryCollapsedLane;
+
+static gssize
+history_find_lane (GArray        *lanes,
+                   const git_oid *oid)
+{
+  g_assert (lanes != NULL);
+  g_assert (oid != NULL);
+
+  for (guint i = 0; i < lanes->len; i++)
+    {
+      const HistoryLane *lane = &g_array_index (lanes, HistoryLane, i);
+
+      if (git_oid_equal (&lane->oid, oid))
+        return i;
+    }
+
+  return -1;
+}
+
+static guint
+history_append_lane (GArray        *lanes,
+                     const git_oid *oid,
+                     guint         *next_color_id)
+{
+  HistoryLane lane;
+
+  g_assert (lanes != NULL);
+  g_assert (oid != NULL);
+  g_assert (next_color_id != NULL);
+
+  lane.oid = *oid;
+  lane.color_id = (*next_color_id)++;
+  lane.inactive = 0;
+  g_array_append_val (lanes, lane);
+
+  return lanes->len - 1;
+}
+
+static guint
+history_insert_lane (GArray        *lanes,
+                     const git_oid *oid,
+                     guint          color_id,
+                     guint          index)
+{
+  HistoryLane lane;
+
+  g_assert (lanes != NULL);
+  g_assert (oid != NULL);
+
+  lane.oid = *oid;
+  lane.color_id = color_id;
+  lane.inactive = 0;
+
+  index = MIN (index, lanes->len);
+  g_array_insert_val (lanes, index, lane);
+
+  return index;
+}
+
+static gboolean
+history_expand_collapsed_lane (GArray        *lanes,
+                               GHashTable    *collapsed,
+                               const git_oid *oid)
+{
+  g_autofree char *key = NULL;
+  HistoryCollapsedLane *lane;
+
+  g_assert (lanes != NULL);
+  g_assert (collapsed != NULL);
+  g_assert (oid != NULL);
+
+  key = _foundry_git_oid_dup_string (oid);
+
+  if (!(lane = g_hash_table_lookup (collapsed, key)))
+    return FALSE;
+
+  history_insert_lane (lanes, &lane->oid, lane->color_id, lane->index);
+  g_hash_table_remove (collapsed, key);
+
+  return TRUE;
+}
+
+static void
+history_collapse_lane (GArray     *lanes,
+                       GHashTable *collapsed,
+                       guint       index)
+{
+  HistoryCollapsedLane *collapsed_lane;
+  const HistoryLane *lane;
+
+  g_assert (lanes != NULL);
+  g_assert (collapsed != NULL);
+  g_assert (index < lanes->len);
+
+  lane = &g_array_index (lanes, HistoryLane, index);
+  collapsed_lane = g_new0 (HistoryCollapsedLane, 1);
+  collapsed_lane->oid = lane->oid;
+  collapsed_lane->color_id = lane->color_id;
+  collapsed_lane->index = index;
+
+  g_hash_table_replace (collapsed,
+                        _foundry_git_oid_dup_string (&lane->oid),
+                        collapsed_lane);
+  g_array_remove_index (lanes, index);
+}
+
+static gboolean
+history_lane_is_parent_of_active_lane (git_repository *repository,
+                                       GArray         *lanes,
+                                       const git_oid  *parent_oid,
+                                       guint           parent_index)
+{
+  g_assert (repository != NULL);
+  g_assert (lanes != NULL);
+  g_assert (parent_oid != NULL);
+
+  for (guint i = 0; i < lanes->len; i++)
+    {
+      g_autoptr(git_commit) commit = NULL;
+      const HistoryLane *lane;
+      guint parent_count;
+
+      if (i == parent_index)
+        continue;
+
+      lane = &g_array_index (lanes, HistoryLane, i);
+
+      if (git_commit_lookup (&commit, repository, &lane->oid) != 0)
+        continue;
+
+      parent_count = git_commit_parentcount (commit);
+
+      for (guint j = 0; j < parent_count; j++)
+        {
+          const git_oid *oid = git_commit_parent_id (commit, j);
+
+          if (git_oid_equal (oid, parent_oid))
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static void
+history_collapse_inactive_lanes (git_repository *repository,
+                                 GArray         *lanes,
+                                 GHashTable     *collapsed)
+{
+  enum {
+    INACTIVE_MAX = 30,
+    INACTIVE_GAP = 10,
+  };
+
+  g_assert (repository != NULL);
+  g_assert (collapsed != NULL);
+  g_assert (lanes != NULL);
+
+  /* TODO: Render folded lanes before enabling this; hiding them creates breaks. */
+  return;
+
+  for (guint i = lanes->len; i > 0; i--)
+    {
+      const HistoryLane *lane = &g_array_index (lanes, HistoryLane, i - 1);
+
+      if (i > 1 &&
+          lane->inactive >= INACTIVE_MAX + INACTIVE_GAP &&
+          !history_lane_is_parent_of_active_lane (repository, lanes, &lane->oid, i - 1))
+        history_collapse_lane (lanes, collapsed, i - 1);
+    }
+}
+
+static void
+history_append_segment (GArray               *segments,
+                        guint                 from_lane,
+                        guint                 to_lane,
+                        FoundryVcsGraphPoint  from_point,
+                        FoundryVcsGraphPoint  to_point,
+                        guint                 color_id)
+{
+  FoundryVcsGraphSegment segment;
+
+  g_assert (segments != NULL);
+
+  segment.from_lane = from_lane;
+  segment.to_lane = to_lane;
+  segment.from_point = from_point;
+  segment.to_point = to_point;
+  segment.color_id = color_id;
+
+  g_array_append_val (segments, segment);
+}
+
+static GArray *
+history_copy_lanes (GArray *lanes)
+{
+  GArray *copy;
+
+  g_assert (lanes != NULL);
+
+  copy = g_array_sized_new (FALSE, FALSE, sizeof (HistoryLane), lanes->len);
+
+  if (lanes->len > 0)
+    g_array_append_vals (copy, lanes->data, lanes->len);
+
+  return copy;
+}
+
+static gssize
+history_find_matching_lane (GArray            *lanes,
+                            const HistoryLane *match)
+{
+  g_assert (lanes != NULL);
+  g_assert (match != NULL);
+
+  for (guint i = 0; i < lanes->len; i++)
+    {
+      const HistoryLane *lane = &g_array_index (lanes, HistoryLane, i);
+
+      if (lane->color_id == match->color_id &&
+          git_oid_equal (&lane->oid, &match->oid))
+        return i;
+    }
+
+  return -1;
+}
+
+static void
+history_remap_shifted_segments (GArray *segments,
+                                GArray *before,
+                                GArray *after)
+{
+  g_assert (segments != NULL);
+  g_assert (before != NULL);
+  g_assert (after != NULL);
+
+  if (before->len == after->len)
+    return;
+
+  for (guint i = 0; i < segments->len; i++)
+    {
+      FoundryVcsGraphSegment *segment;
+      const HistoryLane *lane;
+      gssize new_lane;
+
+      segment = &g_array_index (segments, FoundryVcsGraphSegment, i);
+
+      if (segment->to_point != FOUNDRY_VCS_GRAPH_POINT_BOTTOM ||
+          segment->to_lane >= before->len)
+        continue;
+
+      lane = &g_array_index (before, HistoryLane, segment->to_lane);
+
+      if ((new_lane = history_find_matching_lane (after, lane)) >= 0)
+        segment->to_lane = (guint)new_lane;
+    }
+}
+
+static void
+history_remap_expanded_segments (GArray *segments,
+                                 GArray *before,
+                                 GArray *after)
+{
+  g_assert (segments != NULL);
+  g_assert (before != NULL);
+  g_assert (after != NULL);
+
+  if (before->len == after->len)
+    return;
+
+  for (guint i = 0; i < segments->len; i++)
+    {
+      FoundryVcsGraphSegment *segment;
+      const HistoryLane *lane;
+      gssize old_lane;
+
+      segment = &g_array_index (segments, FoundryVcsGraphSegment, i);
+
+      if (segment->from_point != FOUNDRY_VCS_GRAPH_POINT_TOP ||
+          segment->from_lane >= after->len)
+        continue;
+
+      lane = &g_array_index (after, HistoryLane, segment->from_lane);
+
+      if ((old_lane = history_find_matching_lane (before, lane)) >= 0)
+        segment->from_lane = (guint)old_lane;
+    }
+}
+
+/*
+ * foundry_git_graph_layout_new:
+ * @repository: (transfer full): the repository to walk
+ * @start: the commit to start from
+ * @end: (nullable): a commit to stop at
+ * @limit: the maximum number of rows or 0 for no limit
+ *
+ * Returns: (transfer full) (nullable): a new layout or %NULL and @error is set
+ */
+FoundryGitGraphLayout *
+foundry_git_graph_layout_new (git_repository  *repository,
+                              const git_oid   *start,
+                              const git_oid   *end,
+                              guint            limit,
+                              GError         **error)
+{
+  g_autoptr(git_repository) owned = repository;
+  g_autoptr(git_revwalk) walker = NULL;
+  FoundryGitGraphLayout *self;
+
+  g_return_val_if_fail (repository != NULL, NULL);
+  g_return_val_if_fail (start != NULL, NULL);
+
+  if (git_revwalk_new (&walker, repository) != 0)
+    goto failure;
+
+  git_revwalk_sorting (walker, (GIT_SORT_TOPOLOGICAL | GIT_SORT_TIME));
+
+  if (git_revwalk_push (walker, start) != 0)
+    goto failure;
+
+  if (end != NULL && git_revwalk_hide (walker, end) != 0)
+    goto failure;
+
+  self = g_new0 (FoundryGitGraphLayout, 1);
+  self->repository = g_steal_pointer (&owned);
+  self->walker = g_steal_pointer (&walker);
+  self->lanes = g_array_new (FALSE, FALSE, sizeof (HistoryLane));
+  self->collapsed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  self->limit = limit;
+
+  return self;
+
+failure:
+  set_last_error (error);
+
+  return NULL;
+}
+
+void
+foundry_git_graph_layout_free (FoundryGitGraphLayout *self)
+{
+  if (self == NULL)
+    return;
+
+  g_clear_pointer (&self->walker, git_revwalk_free);
+  g_clear_pointer (&self->repository, git_repository_free);
+  g_clear_pointer (&self->collapsed, g_hash_table_unref);
+  g_clear_pointer (&self->lanes, g_array_unref);
+  g_free (self);
+}
+
+/*
+ * foundry_git_graph_layout_step:
+ * @builder: the builder to add rows to
+ * @max_rows: the maximum number of rows to add
+ * @n_added_out: (out) (optional): location for the number of rows added
+ *
+ * Lays out up to @max_rows more commits into @builder.
+ *
+ * Must not be called from multiple threads at the same time.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set
+ */
+gboolean
+foundry_git_graph_layout_step (FoundryGitGraphLayout   *self,
+                               FoundryGitGraphBuilder  *builder,
+                               guint                    max_rows,
+                               guint                   *n_added_out,
+                               GError                 **error)
+{
+  git_repository *repository;
+  GHashTable *collapsed;
+  GArray *lanes;
+  guint n_added = 0;
+  git_oid oid;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (builder != NULL, FALSE);
+
+  FOUNDRY_TRACE_SCOPE_FUNC ();
+
+  repository = self->repository;
+  collapsed = self->collapsed;
+  lanes = self->lanes;
+
+  while (!self->done && n_added < max_rows)
+    {
+      g_autoptr(git_commit) commit = NULL;
+      g_autoptr(GArray) parent_lanes = NULL;
+      g_autoptr(GArray) segments = NULL;
+      g_autoptr(GArray) lanes_before_expansion = NULL;
+      g_autoptr(GArray) lanes_before_removal = NULL;
+      gssize found_lane;
+      guint commit_lane;
+      guint commit_color_id;
+      guint n_lanes;
+      guint parent_count;
+      gboolean was_active;
+      gboolean was_expanded;
+      gboolean remove_commit_lane = FALSE;
+
+      if (self->limit > 0 && self->n_items >= self->limit)
+        {
+          self->done = TRUE;
+          break;
+        }
+
+      if (git_revwalk_next (&oid, self->walker) != 0)
+        {
+          self->done = TRUE;
+          break;
+        }
+
+      if (git_commit_lookup (&commit, repository, &oid) != 0)
+        {
+          self->done = TRUE;
+          return set_last_error (error);
+        }
+
+      parent_count = git_commit_parentcount (commit);
+
+      for (guint i = 0; i < lanes->len; i++)
+        {
+          HistoryLane *lane = &g_array_index (lanes, HistoryLane, i);
+
+          lane->inactive++;
+        }
+
+      lanes_before_expansion = history_copy_lanes (lanes);
+
+      was_expanded = history_expand_collapsed_lane (lanes, collapsed, &oid);
+
+      for (guint i = 0; i < parent_count; i++)
+        {
+          const git_oid *parent_oid = git_commit_parent_id (commit, i);
+
+          history_expand_collapsed_lane (lanes, collapsed, parent_oid);
+        }
+
+      parent_lanes = g_array_sized_new (FALSE, FALSE, sizeof (guint), parent_count);
+      segments = g_array_new (FALSE, FALSE, sizeof (FoundryVcsGraphSegment));
+      found_lane = history_find_lane (lanes, &oid);
+      was_active = found_lane >= 0;
+
+      if (was_active)
+        commit_lane = found_lane;
+      else
+        commit_lane = history_append_lane (lanes, &oid, &self->next_color_id);
+
+      {
+        HistoryLane *lane = &g_array_index (lanes, HistoryLane, commit_lane);
+
+        lane->inactive = 0;
+        commit_color_id = lane->color_id;
+      }
+
+      n_lanes = lanes->len;
+
+      for (guint i = 0; i < lanes->len; i++)
+        {
+          const HistoryLane *lane = &g_array_index (lanes, HistoryLane, i);
+
+          if (i == commit_lane)
+            {
+              if (was_active && !was_expanded)
+                history_append_segment (segments,
+                                        i,
+                                        i,
+                                        FOUNDRY_VCS_GRAPH_POINT_TOP,
+                                        FOUNDRY_VCS_GRAPH_POINT_CENTER,
+                                        lane->color_id);
+            }
+          else
+            {
+              history_append_segment (segments,
+                                      i,
+                                      i,
+                                      FOUNDRY_VCS_GRAPH_POINT_TOP,
+                                      FOUNDRY_VCS_GRAPH_POINT_BOTTOM,
+                                      lane->color_id);
+          }
+        }
+
+      history_remap_expanded_segments (segments, lanes_before_expansion, lanes);
+
+      for (guint i = 0; i < parent_count; i++)
+        {
+          const git_oid *parent_oid = git_commit_parent_id (commit, i);
+          gssize parent_lane;
+          guint lane_index;
+
+          if ((parent_lane = history_find_lane (lanes, parent_oid)) >= 0 &&
+              parent_lane != commit_lane)
+            {
+              lane_index = parent_lane;
+
+              if (i == 0)
+                remove_commit_lane = TRUE;
+            }
+          else if (i == 0)
+            {
+              lane_index = commit_lane;
+            }
+          else
+            {
+              lane_index = history_append_lane (lanes, parent_oid, &self->next_color_id);
+              n_lanes = MAX (n_lanes, lanes->len);
+            }
+
+          g_array_append_val (parent_lanes, lane_index);
+
+          {
+            HistoryLane *lane = &g_array_index (lanes, HistoryLane, lane_index);
+
+            lane->inactive = 0;
+          }
+        }
+
+      for (guint i = 0; i < parent_lanes->len; i++)
+        {
+          guint lane_index = g_array_index (parent_lanes, guint, i);
+          const HistoryLane *lane = &g_array_index (lanes, HistoryLane, lane_index);
+
+          history_append_segment (segments,
+                                  commit_lane,
+                                  lane_index,
+                                  FOUNDRY_VCS_GRAPH_POINT_CENTER,
+                                  FOUNDRY_VCS_GRAPH_POINT_BOTTOM,
+                                  i == 0 ? commit_color_id : lane->color_id);
+        }
+
+      if (parent_count > 0 && !remove_commit_lane)
+        {
+          const git_oid *parent_oid = git_commit_parent_id (commit, 0);
+          HistoryLane *lane = &g_array_index (lanes, HistoryLane, commit_lane);
+
+          lane->oid = *parent_oid;
+          lane->inactive = 0;
+        }
+
+      lanes_before_removal = history_copy_lanes (lanes);
+
+      if (parent_count == 0 || remove_commit_lane)
+        g_array_remove_index (lanes, commit_lane);
+
+      history_collapse_inactive_lanes (repository, lanes, collapsed);
+      history_remap_shifted_segments (segments, lanes_before_removal, lanes);
+
+      foundry_git_graph_builder_add (builder, &oid, commit_lane, n_lanes, segments);
+
+      self->n_lanes = MAX (self->n_lanes, n_lanes);
+      self->n_items++;
+      n_added++;
+    }
+
+  if (n_added_out != NULL)
+    *n_added_out = n_added;
+
+  return TRUE;
+}
+
+gboolean
+foundry_git_graph_layout_is_done (FoundryGitGraphLayout *self)
+{
+  g_return_val_if_fail (self != NULL, TRUE);
+
+  return self->done;
+}
+
+guint
+foundry_git_graph_layout_get_n_lanes (FoundryGitGraphLayout *self)
+{
+  g_return_val_if_fail (self != NULL, 0);
+
+  return self->n_lanes;
+}
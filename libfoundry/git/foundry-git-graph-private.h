@@ -21,6 +21,7 @@
 #pragma once
 
 #include <git2.h>
+#include <libdex.h>
 
 #include "foundry-vcs-graph.h"
 #include "foundry-vcs-graph-entry.h"
@@ -28,6 +29,7 @@
 G_BEGIN_DECLS
 
 typedef struct _FoundryGitGraphBuilder FoundryGitGraphBuilder;
+typedef struct _FoundryGitGraphLayout  FoundryGitGraphLayout;
 
 FoundryGitGraphBuilder *foundry_git_graph_builder_new    (void);
 void                    foundry_git_graph_builder_add    (FoundryGitGraphBuilder *builder,
@@ -38,6 +40,11 @@ void                    foundry_git_graph_builder_add    (FoundryGitGraphBuilder
 FoundryVcsGraph        *foundry_git_graph_builder_finish (FoundryGitGraphBuilder *builder,
                                                           guint                   n_lanes);
 void                    foundry_git_graph_builder_free   (FoundryGitGraphBuilder *builder);
+FoundryVcsGraph        *foundry_git_graph_new_paged      (FoundryGitGraphBuilder *builder,
+                                                          FoundryGitGraphLayout  *layout,
+                                                          guint                   page_size);
+DexFuture              *foundry_git_graph_load_more      (FoundryVcsGraph        *graph) G_GNUC_WARN_UNUSED_RESULT;
+gboolean                foundry_git_graph_is_complete    (FoundryVcsGraph        *graph);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryGitGraphBuilder, foundry_git_graph_builder_free)
 
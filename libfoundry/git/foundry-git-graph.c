@@ -20,9 +20,15 @@
 
 #include "config.h"
 
+#include "foundry-git-graph-layout-private.h"
 #include "foundry-git-graph-private.h"
 #include "foundry-git-private.h"
 
+/* Start laying out the next page when a row this close to the end of the
+ * loaded rows is requested.
+ */
+#define PREFETCH_DISTANCE 100
+
 typedef struct _FoundryGitGraph FoundryGitGraph;
 typedef struct _FoundryGitGraphClass FoundryGitGraphClass;
 typedef struct _FoundryGitGraphEntry FoundryGitGraphEntry;
@@ -58,6 +64,14 @@ struct _FoundryGitGraph
   Segments segments;
   GQueue inflated;
   guint n_lanes;
+
+  /* Only set for paged graphs. The layout and pending builder are only
+   * ever touched by the thread while @loading is in flight.
+   */
+  FoundryGitGraphLayout *layout;
+  FoundryGitGraphBuilder *pending;
+  DexFuture *loading;
+  guint page_size;
 };
 
 struct _FoundryGitGraphClass
@@ -149,6 +163,10 @@ foundry_git_graph_dup_entry (FoundryVcsGraph *graph,
   if (!(row = foundry_git_graph_get_row (self, position)))
     return NULL;
 
+  if (self->layout != NULL &&
+      position + PREFETCH_DISTANCE >= rows_get_size (&self->rows))
+    dex_future_disown (foundry_git_graph_load_more (graph));
+
   if (row->entry != NULL)
     return FOUNDRY_VCS_GRAPH_ENTRY (g_object_ref (row->entry));
 
@@ -176,6 +194,11 @@ foundry_git_graph_finalize (GObject *object)
       entry->link.data = NULL;
     }
 
+  g_assert (self->loading == NULL);
+
+  g_clear_pointer (&self->layout, foundry_git_graph_layout_free);
+  g_clear_pointer (&self->pending, foundry_git_graph_builder_free);
+
   segments_clear (&self->segments);
   rows_clear (&self->rows);
 
@@ -375,6 +398,190 @@ foundry_git_graph_builder_finish (FoundryGitGraphBuilder *builder,
   return FOUNDRY_VCS_GRAPH (self);
 }
 
+/* Moves the rows of @builder to the end of the graph, leaving the builder
+ * empty so it can be reused for the next page.
+ */
+static guint
+foundry_git_graph_take_rows (FoundryGitGraph        *self,
+                             FoundryGitGraphBuilder *builder)
+{
+  guint segment_offset;
+  guint n_rows;
+
+  g_assert (FOUNDRY_IS_GIT_GRAPH (self));
+  g_assert (builder != NULL);
+
+  segment_offset = segments_get_size (&self->segments);
+  n_rows = rows_get_size (&builder->rows);
+
+  if (segments_get_size (&builder->segments) > 0)
+    segments_splice (&self->segments,
+                     segment_offset,
+                     0,
+                     FALSE,
+                     segments_index (&builder->segments, 0),
+                     segments_get_size (&builder->segments));
+
+  for (guint i = 0; i < n_rows; i++)
+    {
+      FoundryGitGraphRow row = *rows_get (&builder->rows, i);
+
+      row.segment_offset += segment_offset;
+      rows_append (&self->rows, &row);
+    }
+
+  rows_set_size (&builder->rows, 0);
+  segments_set_size (&builder->segments, 0);
+
+  return n_rows;
+}
+
+/*
+ * foundry_git_graph_new_paged:
+ * @builder: (transfer full): the first page of rows
+ * @layout: (transfer full): the layout that produced @builder
+ * @page_size: the number of rows to lay out for each following page
+ *
+ * Creates a graph which continues @layout on a thread as rows near the
+ * end of the model are requested, emitting #GListModel::items-changed as
+ * each page is appended.
+ */
+FoundryVcsGraph *
+foundry_git_graph_new_paged (FoundryGitGraphBuilder *builder,
+                             FoundryGitGraphLayout  *layout,
+                             guint                   page_size)
+{
+  FoundryGitGraph *self;
+
+  g_return_val_if_fail (builder != NULL, NULL);
+  g_return_val_if_fail (layout != NULL, NULL);
+  g_return_val_if_fail (page_size > 0, NULL);
+
+  self = g_object_new (FOUNDRY_TYPE_GIT_GRAPH, NULL);
+  self->rows = builder->rows;
+  self->segments = builder->segments;
+  self->n_lanes = foundry_git_graph_layout_get_n_lanes (layout);
+  self->page_size = page_size;
+
+  if (foundry_git_graph_layout_is_done (layout))
+    {
+      foundry_git_graph_layout_free (layout);
+      rows_init (&builder->rows);
+      segments_init (&builder->segments);
+      foundry_git_graph_builder_free (builder);
+    }
+  else
+    {
+      self->layout = layout;
+      rows_init (&builder->rows);
+      segments_init (&builder->segments);
+      self->pending = builder;
+    }
+
+  return FOUNDRY_VCS_GRAPH (self);
+}
+
+static DexFuture *
+foundry_git_graph_load_page_thread (gpointer data)
+{
+  FoundryGitGraph *self = data;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (FOUNDRY_IS_GIT_GRAPH (self));
+  g_assert (self->layout != NULL);
+  g_assert (self->pending != NULL);
+
+  if (!foundry_git_graph_layout_step (self->layout, self->pending, self->page_size, NULL, &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+foundry_git_graph_load_more_fiber (gpointer data)
+{
+  FoundryGitGraph *self = data;
+  g_autoptr(GError) error = NULL;
+  guint position;
+  guint n_added;
+
+  g_assert (FOUNDRY_IS_GIT_GRAPH (self));
+  g_assert (self->layout != NULL);
+
+  dex_await (dex_thread_pool_submit (_foundry_git_get_thread_pool (),
+                                     "[git-graph-page]",
+                                     foundry_git_graph_load_page_thread,
+                                     g_object_ref (self),
+                                     g_object_unref),
+             &error);
+
+  position = rows_get_size (&self->rows);
+  n_added = foundry_git_graph_take_rows (self, self->pending);
+  self->n_lanes = MAX (self->n_lanes, foundry_git_graph_layout_get_n_lanes (self->layout));
+
+  if (error != NULL || foundry_git_graph_layout_is_done (self->layout))
+    {
+      g_clear_pointer (&self->layout, foundry_git_graph_layout_free);
+      g_clear_pointer (&self->pending, foundry_git_graph_builder_free);
+    }
+
+  dex_clear (&self->loading);
+
+  if (n_added > 0)
+    g_list_model_items_changed (G_LIST_MODEL (self), position, 0, n_added);
+
+  if (error != NULL)
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_for_uint (n_added);
+}
+
+/*
+ * foundry_git_graph_load_more:
+ *
+ * Lays out the next page of a graph created with
+ * foundry_git_graph_new_paged(). Only one page is loaded at a time so
+ * calling this while a page is loading returns the same future.
+ *
+ * Returns: (transfer full): a #DexFuture that resolves to the number of
+ *   rows that were added, which is 0 once the graph is complete.
+ */
+DexFuture *
+foundry_git_graph_load_more (FoundryVcsGraph *graph)
+{
+  FoundryGitGraph *self = (FoundryGitGraph *)graph;
+
+  dex_return_error_if_fail (FOUNDRY_IS_GIT_GRAPH (self));
+
+  if (self->loading != NULL)
+    return dex_ref (self->loading);
+
+  if (self->layout == NULL)
+    return dex_future_new_for_uint (0);
+
+  self->loading = dex_scheduler_spawn (NULL, 0,
+                                       foundry_git_graph_load_more_fiber,
+                                       g_object_ref (self),
+                                       g_object_unref);
+
+  return dex_ref (self->loading);
+}
+
+/*
+ * foundry_git_graph_is_complete:
+ *
+ * Returns: %TRUE if every row of the graph has been laid out
+ */
+gboolean
+foundry_git_graph_is_complete (FoundryVcsGraph *graph)
+{
+  FoundryGitGraph *self = (FoundryGitGraph *)graph;
+
+  g_return_val_if_fail (FOUNDRY_IS_GIT_GRAPH (self), TRUE);
+
+  return self->layout == NULL;
+}
+
 void
 foundry_git_graph_builder_free (FoundryGitGraphBuilder *builder)
 {
@@ -67,7 +67,8 @@ DexFuture                 *_foundry_git_repository_find_commit            (Found
 DexFuture                 *_foundry_git_repository_find_tree              (FoundryGitRepository  *self,
                                                                            const char            *id) G_GNUC_WARN_UNUSED_RESULT;
 DexFuture                 *_foundry_git_repository_list_commits_with_file (FoundryGitRepository  *self,
-                                                                           FoundryVcsFile        *file) G_GNUC_WARN_UNUSED_RESULT;
+                                                                           FoundryVcsFile        *file,
+                                                                           const char            *graph_path) G_GNUC_WARN_UNUSED_RESULT;
 DexFuture                 *_foundry_git_repository_load_graph             (FoundryGitRepository  *self,
                                                                            FoundryVcsCommit      *start,
                                                                            FoundryVcsCommit      *end,
@@ -221,11 +221,16 @@ foundry_git_vcs_list_commits_with_file (FoundryVcs     *vcs,
                                         FoundryVcsFile *file)
 {
   FoundryGitVcs *self = (FoundryGitVcs *)vcs;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autofree char *graph_path = NULL;
 
   dex_return_error_if_fail (FOUNDRY_IS_GIT_VCS (self));
   dex_return_error_if_fail (FOUNDRY_IS_GIT_FILE (file));
 
-  return _foundry_git_repository_list_commits_with_file (self->repository, file);
+  if ((context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
+    graph_path = foundry_context_cache_filename (context, "git", "commit-graph", NULL);
+
+  return _foundry_git_repository_list_commits_with_file (self->repository, file, graph_path);
 }
 
 static DexFuture *
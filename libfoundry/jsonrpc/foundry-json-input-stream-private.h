@@ -34,12 +34,30 @@ typedef enum _FoundryJsonError
 
 G_DECLARE_FINAL_TYPE (FoundryJsonInputStream, foundry_json_input_stream, FOUNDRY, JSON_INPUT_STREAM, GDataInputStream)
 
-GQuark                  foundry_json_error_quark            (void) G_GNUC_CONST;
-FoundryJsonInputStream *foundry_json_input_stream_new       (GInputStream           *base_stream,
-                                                             gboolean                close_base_stream);
-DexFuture              *foundry_json_input_stream_read_upto (FoundryJsonInputStream *self,
-                                                             const char             *stop_chars,
-                                                             gssize                  stop_chars_len) G_GNUC_WARN_UNUSED_RESULT;
-DexFuture              *foundry_json_input_stream_read_http (FoundryJsonInputStream *self) G_GNUC_WARN_UNUSED_RESULT;
+/**
+ * FoundryJsonInputStreamFilter:
+ * @method: (nullable): the top-level "method" member, if any
+ * @id: (nullable): the top-level "id" member as a string, if any
+ * @user_data: closure data
+ *
+ * Returns: %TRUE if the message should be decoded, %FALSE to drop it
+ */
+typedef gboolean (*FoundryJsonInputStreamFilter) (const char *method,
+                                                  const char *id,
+                                                  gpointer    user_data);
+
+GQuark                  foundry_json_error_quark                     (void) G_GNUC_CONST;
+FoundryJsonInputStream *foundry_json_input_stream_new                (GInputStream                 *base_stream,
+                                                                      gboolean                      close_base_stream);
+void                    foundry_json_input_stream_set_max_size_bytes (FoundryJsonInputStream       *self,
+                                                                      gsize                         max_size_bytes);
+void                    foundry_json_input_stream_set_filter         (FoundryJsonInputStream       *self,
+                                                                      FoundryJsonInputStreamFilter  filter,
+                                                                      gpointer                      filter_data,
+                                                                      GDestroyNotify                filter_data_destroy);
+DexFuture              *foundry_json_input_stream_read_upto          (FoundryJsonInputStream       *self,
+                                                                      const char                   *stop_chars,
+                                                                      gssize                        stop_chars_len) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture              *foundry_json_input_stream_read_http          (FoundryJsonInputStream       *self) G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
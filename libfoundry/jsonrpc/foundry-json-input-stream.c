@@ -24,10 +24,24 @@
 #include "foundry-json.h"
 #include "foundry-json-input-stream-private.h"
 
+/* The maximum size of the HTTP-style header block for a single message */
+#define MAX_HEADER_SIZE (8 * 1024)
+
+/* Messages up to this size are parsed on the reader fiber directly
+ * rather than hopping to the thread pool and back.
+ */
+#define INLINE_PARSE_SIZE (16 * 1024)
+
+/* Large enough for any header block and most messages in full */
+#define BUFFER_SIZE (64 * 1024)
+
 struct _FoundryJsonInputStream
 {
-  GDataInputStream parent_instance;
-  int max_size_bytes;
+  GDataInputStream              parent_instance;
+  FoundryJsonInputStreamFilter  filter;
+  gpointer                      filter_data;
+  GDestroyNotify                filter_data_destroy;
+  gsize                         max_size_bytes;
 };
 
 G_DEFINE_FINAL_TYPE (FoundryJsonInputStream, foundry_json_input_stream, G_TYPE_DATA_INPUT_STREAM)
@@ -36,9 +50,27 @@ G_DEFINE_QUARK (foundry-json-error, foundry_json_error)
 
 static gboolean debug_enabled;
 
+static void
+foundry_json_input_stream_finalize (GObject *object)
+{
+  FoundryJsonInputStream *self = (FoundryJsonInputStream *)object;
+
+  if (self->filter_data_destroy != NULL)
+    g_clear_pointer (&self->filter_data, self->filter_data_destroy);
+
+  self->filter = NULL;
+  self->filter_data_destroy = NULL;
+
+  G_OBJECT_CLASS (foundry_json_input_stream_parent_class)->finalize (object);
+}
+
 static void
 foundry_json_input_stream_class_init (FoundryJsonInputStreamClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = foundry_json_input_stream_finalize;
+
   debug_enabled = g_getenv ("JSONRPC_DEBUG") != NULL;
 }
 
@@ -143,133 +175,474 @@ foundry_json_input_stream_read_upto (FoundryJsonInputStream *self,
 }
 
 static void
-read_upto_cb (GObject      *object,
-              GAsyncResult *result,
-              gpointer      user_data)
+fill_cb (GObject      *object,
+         GAsyncResult *result,
+         gpointer      user_data)
 {
-  DexPromise *promise = user_data;
+  g_autoptr(DexPromise) promise = user_data;
   g_autoptr(GError) error = NULL;
-  g_autofree char *contents = NULL;
-  gsize len = 0;
+  gssize n_read;
 
   g_assert (FOUNDRY_IS_JSON_INPUT_STREAM (object));
   g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (DEX_IS_PROMISE (promise));
 
-  contents = g_data_input_stream_read_upto_finish (G_DATA_INPUT_STREAM (object), result, &len, &error);
+  n_read = g_buffered_input_stream_fill_finish (G_BUFFERED_INPUT_STREAM (object), result, &error);
+
+  if (n_read < 0)
+    dex_promise_reject (promise, g_steal_pointer (&error));
+  else
+    dex_promise_resolve_int64 (promise, n_read);
+}
+
+static DexFuture *
+fill (FoundryJsonInputStream *self)
+{
+  DexPromise *promise;
+
+  g_assert (FOUNDRY_IS_JSON_INPUT_STREAM (self));
+
+  promise = dex_promise_new_cancellable ();
+  g_buffered_input_stream_fill_async (G_BUFFERED_INPUT_STREAM (self),
+                                      -1,
+                                      G_PRIORITY_DEFAULT,
+                                      dex_promise_get_cancellable (promise),
+                                      fill_cb,
+                                      dex_ref (promise));
+  return DEX_FUTURE (promise);
+}
+
+static gboolean
+parse_content_length (const char *value,
+                      gsize       value_len,
+                      gsize       max_size,
+                      gsize      *content_length)
+{
+  gsize ret = 0;
+  gsize i = 0;
+
+  while (i < value_len && (value[i] == ' ' || value[i] == '\t'))
+    i++;
 
-  if (contents == NULL && error != NULL)
+  if (i == value_len)
+    return FALSE;
+
+  for (; i < value_len; i++)
     {
-      dex_promise_reject (promise, g_steal_pointer (&error));
+      if (value[i] == ' ' || value[i] == '\t')
+        break;
+
+      if (!g_ascii_isdigit (value[i]))
+        return FALSE;
+
+      ret = (ret * 10) + (value[i] - '0');
+
+      if (ret > max_size)
+        return FALSE;
     }
-  else if (contents == NULL)
+
+  for (; i < value_len; i++)
     {
-      dex_promise_resolve_string (promise, g_strdup (""));
+      if (value[i] != ' ' && value[i] != '\t')
+        return FALSE;
     }
-  else
+
+  *content_length = ret;
+
+  return TRUE;
+}
+
+/*
+ * parse_headers:
+ *
+ * Parses the HTTP-style headers in place from the buffered data without
+ * copying individual lines or key/value pairs.
+ *
+ * Returns: 1 if the headers were parsed and @header_len/@content_length
+ *   are set, 0 if more data is needed, or -1 if @error is set.
+ */
+static int
+parse_headers (const char  *data,
+               gsize        len,
+               gsize        max_size,
+               gsize       *header_len,
+               gssize      *content_length,
+               GError     **error)
+{
+  gsize pos = 0;
+
+  *content_length = -1;
+
+  /* Allow (and ignore) leading blank lines between messages */
+  while (pos < len && (data[pos] == '\r' || data[pos] == '\n'))
+    pos++;
+
+  while (pos < len)
     {
-      if G_UNLIKELY (debug_enabled)
-        FOUNDRY_DUMP_BYTES (read, contents, len);
+      const char *line = &data[pos];
+      const char *eol = memchr (line, '\n', len - pos);
+      const char *colon;
+      gsize line_len;
 
-      if (!g_utf8_validate_len (contents, len, NULL))
-        dex_promise_reject (promise,
-                            g_error_new (G_IO_ERROR,
-                                         G_IO_ERROR_INVALID_DATA,
-                                         "Invalid UTF-8"));
-      else
-        dex_promise_resolve_string (promise, g_steal_pointer (&contents));
+      if (eol == NULL)
+        return 0;
+
+      line_len = eol - line;
+      pos += line_len + 1;
+
+      if (line_len > 0 && line[line_len - 1] == '\r')
+        line_len--;
+
+      if (line_len == 0)
+        {
+          if (*content_length < 0)
+            {
+              g_set_error_literal (error,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_INVALID_DATA,
+                                   "Content-Length was not provided");
+              return -1;
+            }
+
+          *header_len = pos;
+
+          return 1;
+        }
+
+      if (!(colon = memchr (line, ':', line_len)))
+        {
+          g_set_error_literal (error,
+                               G_IO_ERROR,
+                               G_IO_ERROR_INVALID_DATA,
+                               "Expected HTTP header but got other data");
+          return -1;
+        }
+
+      if (colon - line == strlen ("Content-Length") &&
+          g_ascii_strncasecmp (line, "Content-Length", colon - line) == 0)
+        {
+          gsize value;
+
+          if (!parse_content_length (colon + 1, line_len - (colon - line) - 1, max_size, &value))
+            {
+              g_set_error_literal (error,
+                                   G_IO_ERROR,
+                                   G_IO_ERROR_INVALID_DATA,
+                                   "Invalid Content-Length provided");
+              return -1;
+            }
+
+          *content_length = value;
+        }
     }
+
+  return 0;
 }
 
-static DexFuture *
-read_upto (FoundryJsonInputStream *self,
-           const char             *stop_chars,
-           gsize                   stop_chars_len)
+static const char *
+skip_string (const char *p,
+             const char *end)
 {
-  DexPromise *promise;
+  /* @p points just past the opening quote */
+  while (p < end)
+    {
+      const char *quote = memchr (p, '"', end - p);
+      const char *bs;
 
-  g_assert (FOUNDRY_IS_JSON_INPUT_STREAM (self));
+      if (quote == NULL)
+        return NULL;
 
-  promise = dex_promise_new_cancellable ();
-  g_data_input_stream_read_upto_async (G_DATA_INPUT_STREAM (self),
-                                       stop_chars,
-                                       stop_chars_len,
-                                       G_PRIORITY_DEFAULT,
-                                       dex_promise_get_cancellable (promise),
-                                       read_upto_cb,
-                                       dex_ref (promise));
-  return DEX_FUTURE (promise);
+      /* An odd number of preceding backslashes escapes the quote */
+      for (bs = quote; bs > p && bs[-1] == '\\'; bs--) { }
+
+      if (((quote - bs) & 1) == 0)
+        return quote + 1;
+
+      p = quote + 1;
+    }
+
+  return NULL;
+}
+
+static const char *
+skip_whitespace (const char *p,
+                 const char *end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    p++;
+  return p;
+}
+
+static const char *
+skip_value (const char *p,
+            const char *end)
+{
+  guint depth = 0;
+
+  if (p >= end)
+    return NULL;
+
+  if (*p == '"')
+    return skip_string (p + 1, end);
+
+  if (*p != '{' && *p != '[')
+    {
+      while (p < end && !strchr (",}] \t\r\n", *p))
+        p++;
+      return p;
+    }
+
+  while (p < end)
+    {
+      switch (*p)
+        {
+        case '"':
+          if (!(p = skip_string (p + 1, end)))
+            return NULL;
+          continue;
+
+        case '{':
+        case '[':
+          depth++;
+          break;
+
+        case '}':
+        case ']':
+          if (--depth == 0)
+            return p + 1;
+          break;
+
+        default:
+          break;
+        }
+
+      p++;
+    }
+
+  return NULL;
+}
+
+/*
+ * scan_message:
+ *
+ * A lightweight scanner which extracts the top-level "id" and "method"
+ * members of a JSON-RPC message without building a DOM. Nested values
+ * are skipped over with memchr() rather than being decoded.
+ *
+ * Returns: %FALSE if the message could not be scanned (such as batches
+ *   or strings containing escapes) in which case it must be fully parsed.
+ */
+static gboolean
+scan_message (const char  *data,
+              gsize        len,
+              char       **method,
+              char       **id)
+{
+  const char *end = data + len;
+  const char *p = skip_whitespace (data, end);
+
+  *method = NULL;
+  *id = NULL;
+
+  if (p >= end || *p != '{')
+    return FALSE;
+
+  p = skip_whitespace (p + 1, end);
+
+  if (p < end && *p == '}')
+    return TRUE;
+
+  while (p < end)
+    {
+      const char *key;
+      const char *key_end;
+      const char *value;
+      const char *value_end;
+      char **target = NULL;
+
+      if (*p != '"')
+        goto failure;
+
+      key = p + 1;
+
+      if (!(p = skip_string (key, end)))
+        goto failure;
+
+      key_end = p - 1;
+
+      p = skip_whitespace (p, end);
+      if (p >= end || *p != ':')
+        goto failure;
+      value = p = skip_whitespace (p + 1, end);
+
+      if (!(p = value_end = skip_value (p, end)))
+        goto failure;
+
+      if (key_end - key == 2 && memcmp (key, "id", 2) == 0)
+        target = id;
+      else if (key_end - key == 6 && memcmp (key, "method", 6) == 0)
+        target = method;
+
+      if (target != NULL)
+        {
+          g_clear_pointer (target, g_free);
+
+          if (*value == '"')
+            {
+              if (memchr (value + 1, '\\', value_end - value - 2))
+                goto failure;
+              *target = g_strndup (value + 1, value_end - value - 2);
+            }
+          else if (target == id && (g_ascii_isdigit (*value) || *value == '-'))
+            *target = g_strndup (value, value_end - value);
+          else if (target == method || value_end - value != 4 || memcmp (value, "null", 4) != 0)
+            goto failure;
+        }
+
+      p = skip_whitespace (p, end);
+
+      if (p < end && *p == '}')
+        return TRUE;
+
+      if (p >= end || *p != ',')
+        goto failure;
+
+      p = skip_whitespace (p + 1, end);
+    }
+
+failure:
+  g_clear_pointer (method, g_free);
+  g_clear_pointer (id, g_free);
+
+  return FALSE;
 }
 
 static DexFuture *
 foundry_json_input_stream_read_fiber (gpointer user_data)
 {
   FoundryJsonInputStream *self = user_data;
-  g_autoptr(GBytes) bytes = NULL;
-  g_autoptr(GError) error = NULL;
-  gint64 content_length = -1;
+  GBufferedInputStream *buffered = user_data;
 
   g_assert (FOUNDRY_IS_JSON_INPUT_STREAM (self));
 
   for (;;)
     {
-      g_autofree char *line = dex_await_string (read_upto (self, "\n", 1), &error);
-      g_autofree char *key = NULL;
-      g_autofree char *value = NULL;
-      const char *colon;
+      g_autoptr(GBytes) bytes = NULL;
+      g_autoptr(GError) error = NULL;
+      g_autofree char *method = NULL;
+      g_autofree char *id = NULL;
+      g_autofree char *body = NULL;
+      gssize content_length = -1;
+      gsize header_len = 0;
+      gsize available;
+      gsize n_copied;
+      int ret;
+
+      /* Parse headers in place from the stream buffer, filling it as
+       * necessary, but never letting the header block exceed our budget.
+       */
+      for (;;)
+        {
+          const char *data = g_buffered_input_stream_peek_buffer (buffered, &available);
+          gssize n_read;
+
+          ret = parse_headers (data, available, self->max_size_bytes,
+                               &header_len, &content_length, &error);
+
+          if (ret < 0)
+            return dex_future_new_for_error (g_steal_pointer (&error));
+
+          if (ret > 0)
+            break;
+
+          if (available >= MAX_HEADER_SIZE)
+            return dex_future_new_reject (G_IO_ERROR,
+                                          G_IO_ERROR_INVALID_DATA,
+                                          "HTTP headers exceed maximum size");
+
+          if (!dex_await_int64 (fill (self), &error) && error != NULL)
+            return dex_future_new_for_error (g_steal_pointer (&error));
+
+          n_read = g_buffered_input_stream_get_available (buffered) - available;
 
-      if (line == NULL)
+          if (n_read <= 0)
+            {
+              if (available == 0)
+                return dex_future_new_reject (FOUNDRY_JSON_ERROR,
+                                              FOUNDRY_JSON_ERROR_EOF,
+                                              "End of Stream");
+
+              return dex_future_new_reject (G_IO_ERROR,
+                                            G_IO_ERROR_PARTIAL_INPUT,
+                                            "Unexpected end of stream within headers");
+            }
+        }
+
+      if (!g_input_stream_skip (G_INPUT_STREAM (self), header_len, NULL, &error))
         return dex_future_new_for_error (g_steal_pointer (&error));
 
-      if (line[0] == 0 || line[0] == '\r')
-        goto skip;
+      /* Copy the body exactly once. Whatever is already buffered is
+       * copied from the stream buffer and the rest is read directly
+       * into the destination.
+       */
+      body = g_malloc (content_length + 1);
+      body[content_length] = 0;
 
-      if (!(colon = strchr (line, ':')))
-        return dex_future_new_reject (G_IO_ERROR,
-                                      G_IO_ERROR_INVALID_DATA,
-                                      "Expected HTTP header but got other data");
+      g_buffered_input_stream_peek (buffered, body, 0, content_length);
+      n_copied = MIN ((gsize)content_length, g_buffered_input_stream_get_available (buffered));
 
-      key = g_strndup (line, colon - line);
-      value = g_strstrip (g_strdup (colon + 1));
+      if (n_copied > 0 &&
+          !g_input_stream_skip (G_INPUT_STREAM (self), n_copied, NULL, &error))
+        return dex_future_new_for_error (g_steal_pointer (&error));
 
-      if (strncasecmp (key, "Content-Length", 16) == 0)
+      while (n_copied < (gsize)content_length)
         {
-          content_length = g_ascii_strtoll (value, NULL, 10);
+          gssize n_read = dex_await_int64 (dex_input_stream_read (G_INPUT_STREAM (self),
+                                                                  &body[n_copied],
+                                                                  content_length - n_copied,
+                                                                  G_PRIORITY_DEFAULT),
+                                           &error);
+
+          if (error != NULL)
+            return dex_future_new_for_error (g_steal_pointer (&error));
 
-          if (((content_length == G_MININT64 || content_length == G_MAXINT64) && errno == ERANGE) ||
-              (content_length < 0) ||
-              (content_length == G_MAXSSIZE) ||
-              (content_length > (gint64)self->max_size_bytes))
+          if (n_read <= 0)
             return dex_future_new_reject (G_IO_ERROR,
-                                          G_IO_ERROR_INVALID_DATA,
-                                          "Invalid Content-Length provided");
-        }
+                                          G_IO_ERROR_PARTIAL_INPUT,
+                                          "Unexpected end of stream within message");
 
-    skip:
-      if (!dex_await (dex_input_stream_skip (G_INPUT_STREAM (self), 1, G_PRIORITY_DEFAULT), &error))
-        return dex_future_new_for_error (g_steal_pointer (&error));
+          n_copied += n_read;
+        }
 
-      if (key == NULL)
-        break;
-    }
+      if G_UNLIKELY (debug_enabled)
+        FOUNDRY_DUMP_BYTES (read, body, content_length);
+
+      /* Give the consumer a chance to drop the message (such as a reply
+       * to a request that has since been cancelled) before we pay for
+       * building the DOM.
+       */
+      if (self->filter != NULL &&
+          scan_message (body, content_length, &method, &id) &&
+          !self->filter (method, id, self->filter_data))
+        continue;
+
+      /* Small messages are parsed right here instead of paying for an
+       * additional hop to the thread pool and back.
+       */
+      if (content_length <= INLINE_PARSE_SIZE)
+        {
+          g_autoptr(JsonParser) parser = json_parser_new ();
 
-  if (content_length < 0)
-    return dex_future_new_reject (G_IO_ERROR,
-                                  G_IO_ERROR_INVALID_DATA,
-                                  "Content-Length was not provided");
+          if (!json_parser_load_from_data (parser, body, content_length, &error))
+            return dex_future_new_for_error (g_steal_pointer (&error));
 
-  if (!(bytes = dex_await_boxed (dex_input_stream_read_bytes (G_INPUT_STREAM (self),
-                                                              (gsize)content_length,
-                                                              G_PRIORITY_DEFAULT),
-                                 &error)))
-    return dex_future_new_for_error (g_steal_pointer (&error));
+          return dex_future_new_take_boxed (JSON_TYPE_NODE, json_parser_steal_root (parser));
+        }
 
-  if G_UNLIKELY (debug_enabled)
-    FOUNDRY_DUMP_BYTES (read,
-                        ((const char *)g_bytes_get_data (bytes, NULL)),
-                        (g_bytes_get_size (bytes)));
+      bytes = g_bytes_new_take (g_steal_pointer (&body), content_length);
 
-  return foundry_json_node_from_bytes (bytes);
+      return foundry_json_node_from_bytes (bytes);
+    }
 }
 
 /**
@@ -301,6 +674,57 @@ foundry_json_input_stream_new (GInputStream *base_stream,
 
   return g_object_new (FOUNDRY_TYPE_JSON_INPUT_STREAM,
                        "base-stream", base_stream,
+                       "buffer-size", BUFFER_SIZE,
                        "close-base-stream", close_base_stream,
                        NULL);
 }
+
+/**
+ * foundry_json_input_stream_set_max_size_bytes:
+ * @self: a [class@Foundry.JsonInputStream]
+ * @max_size_bytes: the maximum size of a single message
+ *
+ * Sets the memory budget for a single incoming message. Messages
+ * advertising a larger `Content-Length` are rejected before any
+ * of the body is read.
+ */
+void
+foundry_json_input_stream_set_max_size_bytes (FoundryJsonInputStream *self,
+                                              gsize                   max_size_bytes)
+{
+  g_return_if_fail (FOUNDRY_IS_JSON_INPUT_STREAM (self));
+  g_return_if_fail (max_size_bytes > 0);
+
+  self->max_size_bytes = max_size_bytes;
+}
+
+/**
+ * foundry_json_input_stream_set_filter:
+ * @self: a [class@Foundry.JsonInputStream]
+ * @filter: (nullable): a filter function
+ * @filter_data: closure data for @filter
+ * @filter_data_destroy: destroy notify for @filter_data
+ *
+ * Sets a filter that is consulted for messages read with
+ * [method@Foundry.JsonInputStream.read_http] after the top-level
+ * `id` and `method` members have been scanned but before the message
+ * is decoded into a [struct@Json.Node].
+ *
+ * If @filter returns %FALSE the message is discarded without being
+ * parsed and the next message is read instead.
+ */
+void
+foundry_json_input_stream_set_filter (FoundryJsonInputStream       *self,
+                                      FoundryJsonInputStreamFilter  filter,
+                                      gpointer                      filter_data,
+                                      GDestroyNotify                filter_data_destroy)
+{
+  g_return_if_fail (FOUNDRY_IS_JSON_INPUT_STREAM (self));
+
+  if (self->filter_data_destroy != NULL)
+    g_clear_pointer (&self->filter_data, self->filter_data_destroy);
+
+  self->filter = filter;
+  self->filter_data = filter_data;
+  self->filter_data_destroy = filter_data_destroy;
+}
@@ -29,11 +29,16 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (FoundryJsonOutputStream, foundry_json_output_stream, FOUNDRY, JSON_OUTPUT_STREAM, GDataOutputStream)
 
-FoundryJsonOutputStream *foundry_json_output_stream_new   (GOutputStream           *base_stream,
-                                                           gboolean                 close_base_stream);
-DexFuture               *foundry_json_output_stream_write (FoundryJsonOutputStream *self,
-                                                           GHashTable              *headers,
-                                                           JsonNode                *node,
-                                                           GBytes                  *delimiter) G_GNUC_WARN_UNUSED_RESULT;
+FoundryJsonOutputStream *foundry_json_output_stream_new         (GOutputStream           *base_stream,
+                                                                 gboolean                 close_base_stream);
+DexFuture               *foundry_json_output_stream_write       (FoundryJsonOutputStream *self,
+                                                                 GHashTable              *headers,
+                                                                 JsonNode                *node,
+                                                                 GBytes                  *delimiter) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture               *foundry_json_output_stream_write_batch (FoundryJsonOutputStream *self,
+                                                                 GHashTable              *headers,
+                                                                 JsonNode * const        *nodes,
+                                                                 guint                    n_nodes,
+                                                                 GBytes                  *delimiter) G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
@@ -64,6 +64,34 @@ write_free (Write *state)
   g_free (state);
 }
 
+/* Formats @headers in HTTP style, without the Content-Length which
+ * depends on the message it precedes.
+ */
+static GString *
+serialize_headers (GHashTable *headers)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  GString *str;
+
+  if (headers == NULL)
+    return NULL;
+
+  str = g_string_new (NULL);
+
+  g_hash_table_iter_init (&iter, headers);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      g_string_append (str, key);
+      g_string_append_c (str, ':');
+      g_string_append_c (str, ' ');
+      g_string_append (str, value);
+      g_string_append (str, "\r\n");
+    }
+
+  return str;
+}
+
 static DexFuture *
 foundry_json_output_stream_serialize_cb (DexFuture *completed,
                                          gpointer   user_data)
@@ -153,29 +181,172 @@ foundry_json_output_stream_write (FoundryJsonOutputStream *self,
   state->delimiter = g_bytes_ref (delimiter);
   state->stream = g_object_ref (G_OUTPUT_STREAM (self));
 
-  if (headers != NULL)
+  state->headers = serialize_headers (headers);
+
+  return dex_future_then (foundry_json_node_to_bytes (node),
+                          foundry_json_output_stream_serialize_cb,
+                          state,
+                          (GDestroyNotify) write_free);
+}
+
+typedef struct _WriteBatch
+{
+  DexPromise  *promise;
+  JsonNode   **nodes;
+  guint        n_nodes;
+  GBytes      *delimiter;
+  char        *headers;
+} WriteBatch;
+
+static void
+write_batch_free (WriteBatch *state)
+{
+  for (guint i = 0; i < state->n_nodes; i++)
+    g_clear_pointer (&state->nodes[i], json_node_unref);
+  g_clear_pointer (&state->nodes, g_free);
+  g_clear_pointer (&state->delimiter, g_bytes_unref);
+  g_clear_pointer (&state->headers, g_free);
+  dex_clear (&state->promise);
+  g_free (state);
+}
+
+static void
+foundry_json_output_stream_serialize_batch_worker (gpointer data)
+{
+  WriteBatch *state = data;
+  g_autoptr(JsonGenerator) generator = json_generator_new ();
+  g_autoptr(GPtrArray) to_write = NULL;
+  gsize delimiter_len;
+
+  g_assert (state != NULL);
+  g_assert (state->delimiter != NULL);
+  g_assert (state->n_nodes > 0);
+
+  to_write = g_ptr_array_new_with_free_func ((GDestroyNotify)g_bytes_unref);
+  delimiter_len = g_bytes_get_size (state->delimiter);
+
+  /* Serialize every message in a single hop to the thread pool so that
+   * a burst of queued messages does not pay for one hop per message.
+   * The result is a vector of buffers which is flushed with a single
+   * vectored write by the caller.
+   */
+  for (guint i = 0; i < state->n_nodes; i++)
     {
-      GString *str = g_string_new (NULL);
-      GHashTableIter iter;
-      gpointer key, value;
+      g_autofree char *contents = NULL;
+      gsize len;
+
+      json_generator_set_root (generator, state->nodes[i]);
+      contents = json_generator_to_data (generator, &len);
 
-      g_hash_table_iter_init (&iter, headers);
-      while (g_hash_table_iter_next (&iter, &key, &value))
+      if (state->headers != NULL)
         {
-          g_string_append (str, key);
-          g_string_append_c (str, ':');
-          g_string_append_c (str, ' ');
-          g_string_append (str, value);
-          g_string_append (str, "\r\n");
+          char *header = g_strdup_printf ("%sContent-Length: %"G_GSIZE_FORMAT"\r\n\r\n",
+                                          state->headers, len + delimiter_len);
+          g_ptr_array_add (to_write, g_bytes_new_take (header, strlen (header)));
         }
 
-      state->headers = g_steal_pointer (&str);
+      g_ptr_array_add (to_write, g_bytes_new_take (g_steal_pointer (&contents), len));
+
+      if (delimiter_len > 0)
+        g_ptr_array_add (to_write, g_bytes_ref (state->delimiter));
     }
 
-  return dex_future_then (foundry_json_node_to_bytes (node),
-                          foundry_json_output_stream_serialize_cb,
-                          state,
-                          (GDestroyNotify) write_free);
+  dex_promise_resolve_boxed (state->promise,
+                             G_TYPE_PTR_ARRAY,
+                             g_steal_pointer (&to_write));
+
+  write_batch_free (state);
+}
+
+static DexFuture *
+foundry_json_output_stream_write_batch_cb (DexFuture *completed,
+                                           gpointer   user_data)
+{
+  GOutputStream *stream = user_data;
+  g_autoptr(GPtrArray) to_write = NULL;
+
+  g_assert (DEX_IS_FUTURE (completed));
+  g_assert (FOUNDRY_IS_JSON_OUTPUT_STREAM (stream));
+
+  to_write = dex_await_boxed (dex_ref (completed), NULL);
+
+  g_assert (to_write != NULL);
+  g_assert (to_write->len > 0);
+
+  if G_UNLIKELY (debug_enabled)
+    {
+      for (guint j = 0; j < to_write->len; j++)
+        {
+          GBytes *bytes = g_ptr_array_index (to_write, j);
+
+          FOUNDRY_DUMP_BYTES (write,
+                              ((const char *)g_bytes_get_data (bytes, NULL)),
+                              (g_bytes_get_size (bytes)));
+        }
+    }
+
+  return _foundry_write_all_bytes_stream (stream,
+                                          (GBytes **)to_write->pdata,
+                                          to_write->len);
+}
+
+/**
+ * foundry_json_output_stream_write_batch:
+ * @self: a [class@Foundry.JsonOutputStream]
+ * @headers: (nullable): a hashtable of headers to write for each message
+ * @nodes: (array length=n_nodes): the JSON nodes to be written
+ * @n_nodes: the number of elements in @nodes
+ * @delimiter: the delimiter to use as the message suffix
+ *
+ * Like [method@Foundry.JsonOutputStream.write] but serializes all of
+ * @nodes together on the thread pool and then flushes them to the
+ * underlying stream with a single vectored write.
+ *
+ * The caller must not mutate any of @nodes until after the operation
+ * has completed.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to
+ *   any value or rejects with error.
+ */
+DexFuture *
+foundry_json_output_stream_write_batch (FoundryJsonOutputStream  *self,
+                                        GHashTable               *headers,
+                                        JsonNode * const         *nodes,
+                                        guint                     n_nodes,
+                                        GBytes                   *delimiter)
+{
+  WriteBatch *state;
+  DexPromise *promise;
+
+  dex_return_error_if_fail (FOUNDRY_IS_JSON_OUTPUT_STREAM (self));
+  dex_return_error_if_fail (nodes != NULL);
+  dex_return_error_if_fail (n_nodes > 0);
+
+  if (delimiter == NULL)
+    delimiter = null_bytes;
+
+  promise = dex_promise_new_cancellable ();
+
+  state = g_new0 (WriteBatch, 1);
+  state->promise = dex_ref (promise);
+  state->delimiter = g_bytes_ref (delimiter);
+  state->nodes = g_new0 (JsonNode *, n_nodes);
+  state->n_nodes = n_nodes;
+
+  for (guint i = 0; i < n_nodes; i++)
+    state->nodes[i] = json_node_ref (nodes[i]);
+
+  if (headers != NULL)
+    state->headers = g_string_free (serialize_headers (headers), FALSE);
+
+  dex_scheduler_push (dex_thread_pool_scheduler_get_default (),
+                      foundry_json_output_stream_serialize_batch_worker,
+                      state);
+
+  return dex_future_then (DEX_FUTURE (promise),
+                          foundry_json_output_stream_write_batch_cb,
+                          g_object_ref (self),
+                          g_object_unref);
 }
 
 FoundryJsonOutputStream *
@@ -36,23 +36,31 @@ typedef enum _FoundryJsonrpcStyle
 
 G_DECLARE_FINAL_TYPE (FoundryJsonrpcDriver, foundry_jsonrpc_driver, FOUNDRY, JSONRPC_DRIVER, GObject)
 
-FoundryJsonrpcDriver *foundry_jsonrpc_driver_new              (GIOStream            *stream,
-                                                               FoundryJsonrpcStyle   style);
-void                  foundry_jsonrpc_driver_start            (FoundryJsonrpcDriver *self);
-void                  foundry_jsonrpc_driver_stop             (FoundryJsonrpcDriver *self);
-DexFuture            *foundry_jsonrpc_driver_await            (FoundryJsonrpcDriver *self) G_GNUC_WARN_UNUSED_RESULT;
-DexFuture            *foundry_jsonrpc_driver_call             (FoundryJsonrpcDriver *self,
-                                                               const char           *method,
-                                                               JsonNode             *params) G_GNUC_WARN_UNUSED_RESULT;
-DexFuture            *foundry_jsonrpc_driver_reply            (FoundryJsonrpcDriver *self,
-                                                               JsonNode             *id,
-                                                               JsonNode             *reply) G_GNUC_WARN_UNUSED_RESULT;
-DexFuture            *foundry_jsonrpc_driver_reply_with_error (FoundryJsonrpcDriver *self,
-                                                               JsonNode             *id,
-                                                               int                   code,
-                                                               const char           *message) G_GNUC_WARN_UNUSED_RESULT;
-DexFuture            *foundry_jsonrpc_driver_notify           (FoundryJsonrpcDriver *self,
-                                                               const char           *method,
-                                                               JsonNode             *params) G_GNUC_WARN_UNUSED_RESULT;
+FoundryJsonrpcDriver *foundry_jsonrpc_driver_new               (GIOStream             *stream,
+                                                                FoundryJsonrpcStyle    style);
+void                  foundry_jsonrpc_driver_start             (FoundryJsonrpcDriver  *self);
+void                  foundry_jsonrpc_driver_stop              (FoundryJsonrpcDriver  *self);
+DexFuture            *foundry_jsonrpc_driver_await             (FoundryJsonrpcDriver  *self) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture            *foundry_jsonrpc_driver_call              (FoundryJsonrpcDriver  *self,
+                                                                const char            *method,
+                                                                JsonNode              *params) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture            *foundry_jsonrpc_driver_call_full         (FoundryJsonrpcDriver  *self,
+                                                                const char            *method,
+                                                                JsonNode              *params,
+                                                                JsonNode             **id) G_GNUC_WARN_UNUSED_RESULT;
+void                  foundry_jsonrpc_driver_cancel            (FoundryJsonrpcDriver  *self,
+                                                                JsonNode              *id);
+void                  foundry_jsonrpc_driver_set_cancel_method (FoundryJsonrpcDriver  *self,
+                                                                const char            *cancel_method);
+DexFuture            *foundry_jsonrpc_driver_reply             (FoundryJsonrpcDriver  *self,
+                                                                JsonNode              *id,
+                                                                JsonNode              *reply) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture            *foundry_jsonrpc_driver_reply_with_error  (FoundryJsonrpcDriver  *self,
+                                                                JsonNode              *id,
+                                                                int                    code,
+                                                                const char            *message) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture            *foundry_jsonrpc_driver_notify            (FoundryJsonrpcDriver  *self,
+                                                                const char            *method,
+                                                                JsonNode              *params) G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
@@ -23,14 +23,21 @@
 #include <json-glib/json-glib.h>
 
 #include "foundry-json-input-stream-private.h"
+#include "foundry-json-node.h"
 #include "foundry-json-output-stream-private.h"
 #include "foundry-jsonrpc-driver-private.h"
 #include "foundry-jsonrpc-waiter-private.h"
 #include "foundry-util-private.h"
 
+/* The maximum number of queued messages to coalesce into a single
+ * vectored write to the peer.
+ */
+#define MAX_WRITE_BATCH 64
+
 struct _FoundryJsonrpcDriver
 {
   GObject                  parent_instance;
+  DexScheduler            *scheduler;
   GIOStream               *stream;
   FoundryJsonInputStream  *input;
   FoundryJsonOutputStream *output;
@@ -38,6 +45,7 @@ struct _FoundryJsonrpcDriver
   DexFuture               *worker;
   GHashTable              *requests;
   GBytes                  *delimiter;
+  char                    *cancel_method;
   gint64                   last_seq;
   FoundryJsonrpcStyle      style : 2;
 };
@@ -256,6 +264,31 @@ node_equal (gconstpointer a,
   return g_strcmp0 (str_a, str_b) == 0;
 }
 
+static gboolean
+foundry_jsonrpc_driver_filter (const char *method,
+                               const char *id,
+                               gpointer    user_data)
+{
+  GWeakRef *wr = user_data;
+  g_autoptr(FoundryJsonrpcDriver) self = g_weak_ref_get (wr);
+  g_autoptr(JsonNode) node = NULL;
+
+  /* Only replies are candidates for dropping before they are parsed */
+  if (self == NULL || self->requests == NULL || method != NULL || id == NULL)
+    return TRUE;
+
+  /* Keys are compared by their string form so a string node will match
+   * the integer nodes we use for outgoing requests.
+   */
+  node = json_node_new (JSON_NODE_VALUE);
+  json_node_set_string (node, id);
+
+  /* Replies to requests we no longer track (such as those that were
+   * cancelled) are dropped without building a DOM.
+   */
+  return g_hash_table_contains (self->requests, node);
+}
+
 static void
 foundry_jsonrpc_driver_dispose (GObject *object)
 {
@@ -277,6 +310,9 @@ foundry_jsonrpc_driver_dispose (GObject *object)
 
   g_clear_pointer (&self->requests, g_hash_table_unref);
   g_clear_pointer (&self->delimiter, g_bytes_unref);
+  g_clear_pointer (&self->cancel_method, g_free);
+
+  dex_clear (&self->scheduler);
 
   G_OBJECT_CLASS (foundry_jsonrpc_driver_parent_class)->dispose (object);
 }
@@ -370,6 +406,12 @@ foundry_jsonrpc_driver_class_init (FoundryJsonrpcDriverClass *klass)
 static void
 foundry_jsonrpc_driver_init (FoundryJsonrpcDriver *self)
 {
+  /* Requests are tracked from the scheduler the driver was created on,
+   * which is also where the worker dispatches replies.
+   */
+  if (!(self->scheduler = dex_scheduler_ref_thread_default ()))
+    self->scheduler = dex_ref (dex_scheduler_get_default ());
+
   self->output_channel = dex_channel_new (0);
   self->requests = g_hash_table_new_full (node_hash,
                                           node_equal,
@@ -406,35 +448,110 @@ foundry_jsonrpc_driver_new (GIOStream           *stream,
   self->input = foundry_json_input_stream_new (input, TRUE);
   self->output = foundry_json_output_stream_new (output, TRUE);
 
+  foundry_json_input_stream_set_filter (self->input,
+                                        foundry_jsonrpc_driver_filter,
+                                        foundry_weak_ref_new (self),
+                                        (GDestroyNotify) foundry_weak_ref_free);
+
   return self;
 }
 
+typedef struct _CallCancelled
+{
+  GWeakRef      self_wr;
+  DexScheduler *scheduler;
+  JsonNode     *id;
+} CallCancelled;
+
+static void
+call_cancelled_finalize (gpointer data)
+{
+  CallCancelled *state = data;
+
+  g_weak_ref_clear (&state->self_wr);
+  dex_clear (&state->scheduler);
+  g_clear_pointer (&state->id, json_node_unref);
+}
+
+static void
+call_cancelled_unref (CallCancelled *state)
+{
+  g_atomic_rc_box_release_full (state, call_cancelled_finalize);
+}
+
+static void
+foundry_jsonrpc_driver_call_cancelled_cb (gpointer data)
+{
+  CallCancelled *state = data;
+  g_autoptr(FoundryJsonrpcDriver) self = NULL;
+
+  /* Every consumer of the reply has been discarded so there is no
+   * reason to keep the peer working on it.
+   */
+  if ((self = g_weak_ref_get (&state->self_wr)))
+    foundry_jsonrpc_driver_cancel (self, state->id);
+
+  call_cancelled_unref (state);
+}
+
+static void
+foundry_jsonrpc_driver_call_cancelled (GCancellable  *cancellable,
+                                       CallCancelled *state)
+{
+  g_assert (G_IS_CANCELLABLE (cancellable));
+  g_assert (state != NULL);
+
+  /* The cancellable may be triggered from any thread but the request
+   * table is only modified from the driver's scheduler. The weak ref is
+   * also only resolved there so the last reference to the driver is
+   * never dropped from another thread.
+   */
+  dex_scheduler_push (state->scheduler,
+                      foundry_jsonrpc_driver_call_cancelled_cb,
+                      g_atomic_rc_box_acquire (state));
+}
+
 /**
- * foundry_jsonrpc_driver_call:
+ * foundry_jsonrpc_driver_call_full:
  * @self: a [class@Foundry.JsonrpcDriver]
+ * @method: the method to call
+ * @params: (nullable): the params for the call
+ * @id: (out) (optional) (transfer full): location for the request id
+ *
+ * Like [method@Foundry.JsonrpcDriver.call] but also provides the id of
+ * the request so that it may later be passed to
+ * [method@Foundry.JsonrpcDriver.cancel].
+ *
+ * If every consumer of the resulting future is discarded before a reply
+ * has been received, the request is cancelled automatically.
  *
  * Returns: (transfer full): a future that resolves to a [struct@Json.Node]
  *   containing the reply.
  */
 DexFuture *
-foundry_jsonrpc_driver_call (FoundryJsonrpcDriver *self,
-                             const char           *method,
-                             JsonNode             *params)
+foundry_jsonrpc_driver_call_full (FoundryJsonrpcDriver  *self,
+                                  const char            *method,
+                                  JsonNode              *params,
+                                  JsonNode             **id)
 {
   g_autoptr(FoundryJsonrpcWaiter) waiter = NULL;
   g_autoptr(JsonObject) object = NULL;
   g_autoptr(JsonNode) node = NULL;
-  g_autoptr(JsonNode) id = NULL;
+  g_autoptr(JsonNode) request_id = NULL;
+  CallCancelled *cancelled;
+
+  if (id != NULL)
+    *id = NULL;
 
   dex_return_error_if_fail (FOUNDRY_IS_JSONRPC_DRIVER (self));
   dex_return_error_if_fail (method != NULL);
 
-  id = get_next_id (self);
+  request_id = get_next_id (self);
 
   object = json_object_new ();
 
   json_object_set_string_member (object, "jsonrpc", "2.0");
-  json_object_set_member (object, "id", json_node_ref (id));
+  json_object_set_member (object, "id", json_node_ref (request_id));
   json_object_set_string_member (object, "method", method);
 
   if (params != NULL)
@@ -445,21 +562,117 @@ foundry_jsonrpc_driver_call (FoundryJsonrpcDriver *self,
   node = json_node_new (JSON_NODE_OBJECT);
   json_node_set_object (node, object);
 
-  waiter = foundry_jsonrpc_waiter_new (node, id);
+  waiter = foundry_jsonrpc_waiter_new (node, request_id);
 
   g_hash_table_replace (self->requests,
-                        json_node_ref (id),
+                        json_node_ref (request_id),
                         g_object_ref (waiter));
 
+  cancelled = g_atomic_rc_box_new0 (CallCancelled);
+  g_weak_ref_init (&cancelled->self_wr, self);
+  cancelled->scheduler = dex_ref (self->scheduler);
+  cancelled->id = json_node_ref (request_id);
+
+  g_cancellable_connect (foundry_jsonrpc_waiter_get_cancellable (waiter),
+                         G_CALLBACK (foundry_jsonrpc_driver_call_cancelled),
+                         cancelled,
+                         (GDestroyNotify) call_cancelled_unref);
+
   dex_future_disown (dex_future_catch (dex_channel_send (self->output_channel,
                                                          dex_future_new_take_object (g_object_ref (waiter))),
                                        foundry_jsonrpc_waiter_catch,
                                        g_object_ref (waiter),
                                        g_object_unref));
 
+  if (id != NULL)
+    *id = g_steal_pointer (&request_id);
+
   return foundry_jsonrpc_waiter_await (waiter);
 }
 
+/**
+ * foundry_jsonrpc_driver_call:
+ * @self: a [class@Foundry.JsonrpcDriver]
+ *
+ * Returns: (transfer full): a future that resolves to a [struct@Json.Node]
+ *   containing the reply.
+ */
+DexFuture *
+foundry_jsonrpc_driver_call (FoundryJsonrpcDriver *self,
+                             const char           *method,
+                             JsonNode             *params)
+{
+  return foundry_jsonrpc_driver_call_full (self, method, params, NULL);
+}
+
+/**
+ * foundry_jsonrpc_driver_cancel:
+ * @self: a [class@Foundry.JsonrpcDriver]
+ * @id: the id of a request made with [method@Foundry.JsonrpcDriver.call_full]
+ *
+ * Cancels an outstanding request.
+ *
+ * The future for the request is rejected with %G_IO_ERROR_CANCELLED and
+ * any reply which arrives later is discarded without being decoded. If
+ * the request is still queued it is never written to the peer. Otherwise,
+ * if a cancel method has been set with
+ * [method@Foundry.JsonrpcDriver.set_cancel_method], the peer is notified
+ * so that it may stop working on the request.
+ *
+ * It is safe to call this for requests which have already completed.
+ */
+void
+foundry_jsonrpc_driver_cancel (FoundryJsonrpcDriver *self,
+                               JsonNode             *id)
+{
+  g_autoptr(FoundryJsonrpcWaiter) waiter = NULL;
+  g_autoptr(JsonNode) stolen_key = NULL;
+
+  g_return_if_fail (FOUNDRY_IS_JSONRPC_DRIVER (self));
+  g_return_if_fail (id != NULL);
+
+  if (self->requests == NULL ||
+      !g_hash_table_steal_extended (self->requests,
+                                    id,
+                                    (gpointer *)&stolen_key,
+                                    (gpointer *)&waiter))
+    return;
+
+  /* Only tell the peer about requests it has actually seen. Requests
+   * still sitting in the output channel are skipped by the worker.
+   */
+  if (self->cancel_method != NULL &&
+      foundry_jsonrpc_waiter_get_sent (waiter))
+    {
+      g_autoptr(JsonNode) params = FOUNDRY_JSON_OBJECT_NEW ("id", FOUNDRY_JSON_NODE_PUT_NODE (id));
+
+      dex_future_disown (foundry_jsonrpc_driver_notify (self, self->cancel_method, params));
+    }
+
+  foundry_jsonrpc_waiter_reject (waiter,
+                                 g_error_new_literal (G_IO_ERROR,
+                                                      G_IO_ERROR_CANCELLED,
+                                                      "Request was cancelled"));
+}
+
+/**
+ * foundry_jsonrpc_driver_set_cancel_method:
+ * @self: a [class@Foundry.JsonrpcDriver]
+ * @cancel_method: (nullable): the notification to send, such as
+ *   `$/cancelRequest`, or %NULL
+ *
+ * Sets the notification that is sent to the peer when a request is
+ * cancelled. The notification params contain the `id` of the request.
+ */
+void
+foundry_jsonrpc_driver_set_cancel_method (FoundryJsonrpcDriver *self,
+                                          const char           *cancel_method)
+{
+  g_return_if_fail (FOUNDRY_IS_JSONRPC_DRIVER (self));
+
+  g_set_str (&self->cancel_method, cancel_method);
+}
+
 /**
  * foundry_jsonrpc_driver_notify:
  * @self: a [class@Foundry.JsonrpcDriver]
@@ -741,28 +954,69 @@ foundry_jsonrpc_driver_worker (gpointer data)
                 }
             }
 
-          /* If we got a message to write, then submit it now. This
-           * awaits for the message to be buffered because otherwise
+          /* If we got a message to write, then drain everything else
+           * that is already queued and submit them together. This
+           * awaits for the messages to be buffered because otherwise
            * we could end up in a situation where we try to submit
-           * two outgoing messages at the same time.
+           * two outgoing batches at the same time.
            */
           if (dex_future_is_resolved (next_write))
             {
-              g_autoptr(FoundryJsonrpcWaiter) waiter = dex_await_object (g_steal_pointer (&next_write), NULL);
+              g_autoptr(GPtrArray) batch = g_ptr_array_new_with_free_func (g_object_unref);
+              FoundryJsonrpcWaiter *waiter = dex_await_object (g_steal_pointer (&next_write), NULL);
 
               g_assert (!waiter || FOUNDRY_IS_JSONRPC_WAITER (waiter));
 
               if (waiter != NULL)
+                g_ptr_array_add (batch, waiter);
+
+              while (batch->len < MAX_WRITE_BATCH)
                 {
-                  JsonNode *node = foundry_jsonrpc_waiter_get_node (waiter);
+                  next_write = dex_channel_receive (state->output_channel);
+                  dex_future_disown (dex_ref (next_write));
+
+                  /* Leave pending (or rejected) receives for the next
+                   * iteration of the main loop to handle.
+                   */
+                  if (!dex_future_is_resolved (next_write))
+                    break;
+
+                  if ((waiter = dex_await_object (g_steal_pointer (&next_write), NULL)))
+                    g_ptr_array_add (batch, waiter);
+                }
+
+              if (batch->len > 0)
+                {
+                  g_autofree JsonNode **nodes = g_new0 (JsonNode *, batch->len);
                   GHashTable *headers;
+                  guint n_nodes = 0;
+
+                  for (guint i = 0; i < batch->len; i++)
+                    {
+                      FoundryJsonrpcWaiter *item = g_ptr_array_index (batch, i);
+
+                      /* Requests that were cancelled (or superseded)
+                       * while queued are never written to the peer.
+                       */
+                      if (foundry_jsonrpc_waiter_is_abandoned (item))
+                        continue;
+
+                      foundry_jsonrpc_waiter_set_sent (item);
+                      nodes[n_nodes++] = foundry_jsonrpc_waiter_get_node (item);
+                    }
 
                   if (state->style == FOUNDRY_JSONRPC_STYLE_HTTP)
                     headers = empty_headers;
                   else
                     headers = NULL;
 
-                  if (!dex_await (foundry_json_output_stream_write (state->output, headers, node, state->delimiter), &error))
+                  if (n_nodes > 0 &&
+                      !dex_await (foundry_json_output_stream_write_batch (state->output,
+                                                                          headers,
+                                                                          (JsonNode * const *)nodes,
+                                                                          n_nodes,
+                                                                          state->delimiter),
+                                  &error))
                     return dex_future_new_for_error (g_steal_pointer (&error));
                 }
             }
@@ -817,7 +1071,7 @@ foundry_jsonrpc_driver_start (FoundryJsonrpcDriver *self)
   state->delimiter = self->delimiter ? g_bytes_ref (self->delimiter) : NULL;
   state->style = self->style;
 
-  worker = dex_scheduler_spawn (NULL, 0,
+  worker = dex_scheduler_spawn (self->scheduler, 0,
                                 foundry_jsonrpc_driver_worker,
                                 state,
                                 (GDestroyNotify) worker_free);
@@ -29,16 +29,20 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (FoundryJsonrpcWaiter, foundry_jsonrpc_waiter, FOUNDRY, JSONRPC_WAITER, GObject)
 
-FoundryJsonrpcWaiter *foundry_jsonrpc_waiter_new        (JsonNode             *node,
-                                                         JsonNode             *id);
-void                  foundry_jsonrpc_waiter_reply      (FoundryJsonrpcWaiter *self,
-                                                         JsonNode             *node);
-void                  foundry_jsonrpc_waiter_reject     (FoundryJsonrpcWaiter *self,
-                                                         GError               *error);
-DexFuture            *foundry_jsonrpc_waiter_await      (FoundryJsonrpcWaiter *self) G_GNUC_WARN_UNUSED_RESULT;
-DexFuture            *foundry_jsonrpc_waiter_catch      (DexFuture            *future,
-                                                         gpointer              user_data) G_GNUC_WARN_UNUSED_RESULT;
-JsonNode             *foundry_jsonrpc_waiter_get_id     (FoundryJsonrpcWaiter *self);
-JsonNode             *foundry_jsonrpc_waiter_get_node   (FoundryJsonrpcWaiter *self);
+FoundryJsonrpcWaiter *foundry_jsonrpc_waiter_new             (JsonNode             *node,
+                                                              JsonNode             *id);
+void                  foundry_jsonrpc_waiter_reply           (FoundryJsonrpcWaiter *self,
+                                                              JsonNode             *node);
+void                  foundry_jsonrpc_waiter_reject          (FoundryJsonrpcWaiter *self,
+                                                              GError               *error);
+DexFuture            *foundry_jsonrpc_waiter_await           (FoundryJsonrpcWaiter *self) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture            *foundry_jsonrpc_waiter_catch           (DexFuture            *future,
+                                                              gpointer              user_data) G_GNUC_WARN_UNUSED_RESULT;
+JsonNode             *foundry_jsonrpc_waiter_get_id          (FoundryJsonrpcWaiter *self);
+JsonNode             *foundry_jsonrpc_waiter_get_node        (FoundryJsonrpcWaiter *self);
+GCancellable         *foundry_jsonrpc_waiter_get_cancellable (FoundryJsonrpcWaiter *self);
+gboolean              foundry_jsonrpc_waiter_is_abandoned    (FoundryJsonrpcWaiter *self);
+gboolean              foundry_jsonrpc_waiter_get_sent        (FoundryJsonrpcWaiter *self);
+void                  foundry_jsonrpc_waiter_set_sent        (FoundryJsonrpcWaiter *self);
 
 G_END_DECLS
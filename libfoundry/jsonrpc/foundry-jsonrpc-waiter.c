@@ -28,6 +28,7 @@ struct _FoundryJsonrpcWaiter
   DexPromise *promise;
   JsonNode   *node;
   JsonNode   *id;
+  guint       sent : 1;
 };
 
 G_DEFINE_FINAL_TYPE (FoundryJsonrpcWaiter, foundry_jsonrpc_waiter, G_TYPE_OBJECT)
@@ -62,7 +63,7 @@ foundry_jsonrpc_waiter_class_init (FoundryJsonrpcWaiterClass *klass)
 static void
 foundry_jsonrpc_waiter_init (FoundryJsonrpcWaiter *self)
 {
-  self->promise = dex_promise_new ();
+  self->promise = dex_promise_new_cancellable ();
 }
 
 FoundryJsonrpcWaiter *
@@ -169,3 +170,66 @@ foundry_jsonrpc_waiter_get_id (FoundryJsonrpcWaiter *self)
 
   return self->id;
 }
+
+/**
+ * foundry_jsonrpc_waiter_get_cancellable:
+ * @self: a [class@Foundry.JsonrpcWaiter]
+ *
+ * Gets the cancellable which is cancelled when every consumer of the
+ * future returned from [method@Foundry.JsonrpcWaiter.await] has been
+ * discarded.
+ *
+ * Returns: (transfer none):
+ */
+GCancellable *
+foundry_jsonrpc_waiter_get_cancellable (FoundryJsonrpcWaiter *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_JSONRPC_WAITER (self), NULL);
+
+  return dex_promise_get_cancellable (self->promise);
+}
+
+/**
+ * foundry_jsonrpc_waiter_is_abandoned:
+ * @self: a [class@Foundry.JsonrpcWaiter]
+ *
+ * Checks if the waiter is for a request which has been cancelled or
+ * whose consumers have all been discarded. Such requests do not need
+ * to be written to the peer.
+ *
+ * Returns: %TRUE if the request no longer needs to be sent
+ */
+gboolean
+foundry_jsonrpc_waiter_is_abandoned (FoundryJsonrpcWaiter *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_JSONRPC_WAITER (self), FALSE);
+
+  /* Notifications and replies have no id and are always delivered */
+  if (self->id == NULL)
+    return FALSE;
+
+  return !dex_future_is_pending (DEX_FUTURE (self->promise)) ||
+         g_cancellable_is_cancelled (dex_promise_get_cancellable (self->promise));
+}
+
+/**
+ * foundry_jsonrpc_waiter_get_sent:
+ * @self: a [class@Foundry.JsonrpcWaiter]
+ *
+ * Returns: %TRUE if the message has been handed to the output stream
+ */
+gboolean
+foundry_jsonrpc_waiter_get_sent (FoundryJsonrpcWaiter *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_JSONRPC_WAITER (self), FALSE);
+
+  return self->sent;
+}
+
+void
+foundry_jsonrpc_waiter_set_sent (FoundryJsonrpcWaiter *self)
+{
+  g_return_if_fail (FOUNDRY_IS_JSONRPC_WAITER (self));
+
+  self->sent = TRUE;
+}
@@ -22,7 +22,7 @@
 
 #include <libpeas.h>
 
-#include "foundry-llm-manager.h"
+#include "foundry-llm-manager-private.h"
 #include "foundry-llm-model.h"
 #include "foundry-llm-provider-private.h"
 #include "foundry-llm-resource.h"
@@ -33,11 +33,15 @@
 #include "foundry-settings.h"
 #include "foundry-util-private.h"
 
+#define RESPONSE_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
 struct _FoundryLlmManager
 {
-  FoundryService    parent_instance;
-  PeasExtensionSet *addins;
-  PeasExtensionSet *tools;
+  FoundryService           parent_instance;
+  PeasExtensionSet        *addins;
+  PeasExtensionSet        *tools;
+  FoundryLlmResponseCache *response_cache;
+  guint                    response_cache_initialized : 1;
 };
 
 struct _FoundryLlmManagerClass
@@ -208,6 +212,7 @@ foundry_llm_manager_dispose (GObject *object)
   FoundryLlmManager *self = (FoundryLlmManager *)object;
 
   g_clear_object (&self->addins);
+  g_clear_object (&self->response_cache);
 
   G_OBJECT_CLASS (foundry_llm_manager_parent_class)->dispose (object);
 }
@@ -493,3 +498,64 @@ foundry_llm_manager_find_resource (FoundryLlmManager *self,
                           g_strdup (uri),
                           g_free);
 }
+
+/**
+ * _foundry_llm_manager_dup_response_cache:
+ * @self: a [class@Foundry.LlmManager]
+ *
+ * Gets the cache providers should consult before issuing a request.
+ *
+ * The cache lives in the project state directory and is disabled by
+ * default. Set `FOUNDRY_LLM_CACHE=1` (or `record`) to enable it, or
+ * `FOUNDRY_LLM_CACHE=replay` to only serve previously recorded
+ * responses, which is useful for reproducible agent benchmarks.
+ *
+ * Returns: (transfer full) (nullable): a [class@Foundry.LlmResponseCache]
+ *   or %NULL if caching is disabled
+ */
+FoundryLlmResponseCache *
+_foundry_llm_manager_dup_response_cache (FoundryLlmManager *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_LLM_MANAGER (self), NULL);
+
+  if (!self->response_cache_initialized)
+    {
+      g_autoptr(FoundryContext) context = NULL;
+      FoundryLlmResponseCacheMode mode = FOUNDRY_LLM_RESPONSE_CACHE_DISABLED;
+      const char *env = g_getenv ("FOUNDRY_LLM_CACHE");
+
+      self->response_cache_initialized = TRUE;
+
+      if (foundry_str_equal0 (env, "1") || foundry_str_equal0 (env, "record"))
+        mode = FOUNDRY_LLM_RESPONSE_CACHE_ENABLED;
+      else if (foundry_str_equal0 (env, "replay"))
+        mode = FOUNDRY_LLM_RESPONSE_CACHE_REPLAY;
+      else if (!foundry_str_empty0 (env) && !foundry_str_equal0 (env, "0"))
+        g_warning ("Unrecognized FOUNDRY_LLM_CACHE value `%s`, "
+                   "expected one of 0, 1, record, or replay",
+                   env);
+
+      if (mode != FOUNDRY_LLM_RESPONSE_CACHE_DISABLED &&
+          (context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
+        {
+          g_autoptr(GFile) state_dir = foundry_context_dup_state_directory (context);
+          g_autoptr(GFile) directory = g_file_get_child (state_dir, "llm-cache");
+
+          if (g_file_is_native (directory))
+            self->response_cache = foundry_llm_response_cache_new (directory, mode, RESPONSE_CACHE_MAX_SIZE);
+        }
+    }
+
+  return self->response_cache ? g_object_ref (self->response_cache) : NULL;
+}
+
+void
+_foundry_llm_manager_set_response_cache (FoundryLlmManager       *self,
+                                         FoundryLlmResponseCache *response_cache)
+{
+  g_return_if_fail (FOUNDRY_IS_LLM_MANAGER (self));
+  g_return_if_fail (!response_cache || FOUNDRY_IS_LLM_RESPONSE_CACHE (response_cache));
+
+  self->response_cache_initialized = TRUE;
+  g_set_object (&self->response_cache, response_cache);
+}
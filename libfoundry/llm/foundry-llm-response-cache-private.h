@@ -0,0 +1,56 @@
+/* foundry-llm-response-cache-private.h
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <json-glib/json-glib.h>
+#include <libdex.h>
+
+G_BEGIN_DECLS
+
+typedef enum _FoundryLlmResponseCacheMode
+{
+  FOUNDRY_LLM_RESPONSE_CACHE_DISABLED,
+  FOUNDRY_LLM_RESPONSE_CACHE_ENABLED,
+  FOUNDRY_LLM_RESPONSE_CACHE_REPLAY,
+} FoundryLlmResponseCacheMode;
+
+#define FOUNDRY_TYPE_LLM_RESPONSE_CACHE (foundry_llm_response_cache_get_type())
+
+G_DECLARE_FINAL_TYPE (FoundryLlmResponseCache, foundry_llm_response_cache, FOUNDRY, LLM_RESPONSE_CACHE, GObject)
+
+FoundryLlmResponseCache     *foundry_llm_response_cache_new      (GFile                       *directory,
+                                                                  FoundryLlmResponseCacheMode  mode,
+                                                                  guint64                      max_size);
+FoundryLlmResponseCacheMode  foundry_llm_response_cache_get_mode (FoundryLlmResponseCache     *self);
+guint64                      foundry_llm_response_cache_get_size (FoundryLlmResponseCache     *self);
+char                        *foundry_llm_response_cache_dup_key  (const char                  *url,
+                                                                  JsonNode                    *request);
+DexFuture                   *foundry_llm_response_cache_lookup   (FoundryLlmResponseCache     *self,
+                                                                  const char                  *key) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture                   *foundry_llm_response_cache_store    (FoundryLlmResponseCache     *self,
+                                                                  const char                  *key,
+                                                                  GBytes                      *bytes) G_GNUC_WARN_UNUSED_RESULT;
+GInputStream                *foundry_llm_response_cache_record   (FoundryLlmResponseCache     *self,
+                                                                  const char                  *key,
+                                                                  GInputStream                *response,
+                                                                  GError                     **error);
+
+G_END_DECLS
@@ -0,0 +1,635 @@
+/* foundry-llm-response-cache.c
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+
+#include <glib/gstdio.h>
+
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include "foundry-llm-response-cache-private.h"
+#include "foundry-util.h"
+
+#define KEY_LENGTH 64
+#define READ_SIZE  (64 * 1024)
+
+/* Responses are stored as the raw bytes received from the provider so
+ * that replaying them goes back through the exact same parser, whether
+ * the response was streamed or not. Files are named by the SHA-256 of
+ * the canonicalized request and evicted least-recently-used first once
+ * the directory grows beyond max_size.
+ */
+
+typedef struct _Entry
+{
+  GList    link;
+  char    *key;
+  guint64  size;
+  gint64   last_used;
+} Entry;
+
+struct _FoundryLlmResponseCache
+{
+  GObject                      parent_instance;
+  GMutex                       mutex;
+  GFile                       *directory;
+  GHashTable                  *entries;
+  GQueue                       lru;
+  guint64                      size;
+  guint64                      max_size;
+  FoundryLlmResponseCacheMode  mode;
+  guint                        loaded : 1;
+};
+
+G_DEFINE_FINAL_TYPE (FoundryLlmResponseCache, foundry_llm_response_cache, G_TYPE_OBJECT)
+
+static void
+entry_free (gpointer data)
+{
+  Entry *entry = data;
+
+  g_free (entry->key);
+  g_free (entry);
+}
+
+static int
+compare_by_last_used (gconstpointer a,
+                      gconstpointer b)
+{
+  const Entry *entry_a = *(const Entry * const *)a;
+  const Entry *entry_b = *(const Entry * const *)b;
+
+  if (entry_a->last_used > entry_b->last_used)
+    return -1;
+  else if (entry_a->last_used < entry_b->last_used)
+    return 1;
+
+  return 0;
+}
+
+static gboolean
+is_key (const char *name)
+{
+  if (strlen (name) != KEY_LENGTH)
+    return FALSE;
+
+  for (guint i = 0; i < KEY_LENGTH; i++)
+    {
+      if (!g_ascii_isxdigit (name[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+foundry_llm_response_cache_remove_locked (FoundryLlmResponseCache *self,
+                                          Entry                   *entry)
+{
+  g_assert (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  g_assert (entry != NULL);
+
+  g_queue_unlink (&self->lru, &entry->link);
+  self->size -= entry->size;
+  g_hash_table_remove (self->entries, entry->key);
+}
+
+static void
+foundry_llm_response_cache_insert_locked (FoundryLlmResponseCache *self,
+                                          const char              *key,
+                                          guint64                  size,
+                                          gint64                   last_used)
+{
+  Entry *entry;
+
+  g_assert (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  g_assert (key != NULL);
+
+  if ((entry = g_hash_table_lookup (self->entries, key)))
+    foundry_llm_response_cache_remove_locked (self, entry);
+
+  entry = g_new0 (Entry, 1);
+  entry->link.data = entry;
+  entry->key = g_strdup (key);
+  entry->size = size;
+  entry->last_used = last_used;
+
+  g_hash_table_insert (self->entries, entry->key, entry);
+  g_queue_push_head_link (&self->lru, &entry->link);
+  self->size += size;
+}
+
+/* Must be called from a thread-pool fiber as this does blocking I/O */
+static void
+foundry_llm_response_cache_ensure_loaded_locked (FoundryLlmResponseCache *self)
+{
+  g_autoptr(GFileEnumerator) enumerator = NULL;
+  g_autoptr(GPtrArray) found = NULL;
+  gpointer info_ptr;
+
+  g_assert (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+
+  if (self->loaded)
+    return;
+
+  self->loaded = TRUE;
+
+  if (!(enumerator = g_file_enumerate_children (self->directory,
+                                                G_FILE_ATTRIBUTE_STANDARD_NAME","
+                                                G_FILE_ATTRIBUTE_STANDARD_SIZE","
+                                                G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                NULL, NULL)))
+    return;
+
+  found = g_ptr_array_new ();
+
+  while ((info_ptr = g_file_enumerator_next_file (enumerator, NULL, NULL)))
+    {
+      g_autoptr(GFileInfo) info = info_ptr;
+      const char *name = g_file_info_get_name (info);
+      Entry *entry;
+
+      if (!is_key (name))
+        continue;
+
+      entry = g_new0 (Entry, 1);
+      entry->link.data = entry;
+      entry->key = g_strdup (name);
+      entry->size = g_file_info_get_size (info);
+      entry->last_used = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC;
+
+      g_ptr_array_add (found, entry);
+    }
+
+  g_ptr_array_sort (found, compare_by_last_used);
+
+  for (guint i = 0; i < found->len; i++)
+    {
+      Entry *entry = g_ptr_array_index (found, i);
+
+      g_hash_table_insert (self->entries, entry->key, entry);
+      g_queue_push_tail_link (&self->lru, &entry->link);
+      self->size += entry->size;
+    }
+}
+
+static void
+foundry_llm_response_cache_finalize (GObject *object)
+{
+  FoundryLlmResponseCache *self = (FoundryLlmResponseCache *)object;
+
+  g_queue_init (&self->lru);
+  g_clear_pointer (&self->entries, g_hash_table_unref);
+  g_clear_object (&self->directory);
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (foundry_llm_response_cache_parent_class)->finalize (object);
+}
+
+static void
+foundry_llm_response_cache_class_init (FoundryLlmResponseCacheClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = foundry_llm_response_cache_finalize;
+}
+
+static void
+foundry_llm_response_cache_init (FoundryLlmResponseCache *self)
+{
+  g_mutex_init (&self->mutex);
+  self->entries = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, entry_free);
+}
+
+/**
+ * foundry_llm_response_cache_new:
+ * @directory: where cached responses are stored
+ * @mode: the cache mode
+ * @max_size: the size in bytes after which old entries are evicted
+ *
+ * Creates a new response cache. In %FOUNDRY_LLM_RESPONSE_CACHE_REPLAY
+ * mode callers are expected to fail requests that miss the cache rather
+ * than reaching out to the provider, which makes agent runs reproducible.
+ */
+FoundryLlmResponseCache *
+foundry_llm_response_cache_new (GFile                       *directory,
+                                FoundryLlmResponseCacheMode  mode,
+                                guint64                      max_size)
+{
+  FoundryLlmResponseCache *self;
+
+  g_return_val_if_fail (G_IS_FILE (directory), NULL);
+  g_return_val_if_fail (g_file_is_native (directory), NULL);
+
+  self = g_object_new (FOUNDRY_TYPE_LLM_RESPONSE_CACHE, NULL);
+  self->directory = g_object_ref (directory);
+  self->mode = mode;
+  self->max_size = max_size;
+
+  return self;
+}
+
+FoundryLlmResponseCacheMode
+foundry_llm_response_cache_get_mode (FoundryLlmResponseCache *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_LLM_RESPONSE_CACHE (self), 0);
+
+  return self->mode;
+}
+
+/**
+ * foundry_llm_response_cache_get_size:
+ * @self: a [class@Foundry.LlmResponseCache]
+ *
+ * Gets the number of bytes of cached responses known to @self. This is
+ * zero until the cache directory has been scanned by the first lookup
+ * or store.
+ */
+guint64
+foundry_llm_response_cache_get_size (FoundryLlmResponseCache *self)
+{
+  guint64 size;
+
+  g_return_val_if_fail (FOUNDRY_IS_LLM_RESPONSE_CACHE (self), 0);
+
+  g_mutex_lock (&self->mutex);
+  size = self->size;
+  g_mutex_unlock (&self->mutex);
+
+  return size;
+}
+
+/* Rebuild the node with object members in sorted order so that two
+ * requests differing only by member order produce the same key.
+ */
+static JsonNode *
+canonicalize (JsonNode *node)
+{
+  if (JSON_NODE_HOLDS_OBJECT (node))
+    {
+      JsonObject *object = json_node_get_object (node);
+      g_autoptr(JsonObject) sorted = json_object_new ();
+      g_autoptr(GList) members = json_object_get_members (object);
+      JsonNode *ret;
+
+      members = g_list_sort (members, (GCompareFunc) g_strcmp0);
+
+      for (const GList *iter = members; iter; iter = iter->next)
+        json_object_set_member (sorted,
+                                iter->data,
+                                canonicalize (json_object_get_member (object, iter->data)));
+
+      ret = json_node_new (JSON_NODE_OBJECT);
+      json_node_set_object (ret, sorted);
+
+      return ret;
+    }
+
+  if (JSON_NODE_HOLDS_ARRAY (node))
+    {
+      JsonArray *array = json_node_get_array (node);
+      g_autoptr(JsonArray) copy = json_array_new ();
+      guint length = json_array_get_length (array);
+      JsonNode *ret;
+
+      for (guint i = 0; i < length; i++)
+        json_array_add_element (copy, canonicalize (json_array_get_element (array, i)));
+
+      ret = json_node_new (JSON_NODE_ARRAY);
+      json_node_set_array (ret, copy);
+
+      return ret;
+    }
+
+  return json_node_copy (node);
+}
+
+/**
+ * foundry_llm_response_cache_dup_key:
+ * @url: the endpoint the request is sent to
+ * @request: the request body
+ *
+ * Creates a content address for @request. Credentials are not part of
+ * the request body and therefore never part of the key.
+ *
+ * Returns: (transfer full): a hex encoded SHA-256 digest
+ */
+char *
+foundry_llm_response_cache_dup_key (const char *url,
+                                    JsonNode   *request)
+{
+  g_autoptr(GChecksum) checksum = NULL;
+  g_autoptr(JsonNode) canonical = NULL;
+  g_autofree char *json = NULL;
+
+  g_return_val_if_fail (url != NULL, NULL);
+  g_return_val_if_fail (request != NULL, NULL);
+
+  canonical = canonicalize (request);
+  json = json_to_string (canonical, FALSE);
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guint8 *)url, strlen (url));
+  g_checksum_update (checksum, (const guint8 *)"\n", 1);
+  g_checksum_update (checksum, (const guint8 *)json, strlen (json));
+
+  return g_strdup (g_checksum_get_string (checksum));
+}
+
+static DexFuture *
+foundry_llm_response_cache_lookup_fiber (FoundryLlmResponseCache *self,
+                                         const char              *key)
+{
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  Entry *entry;
+  gint64 now;
+
+  g_assert (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  g_assert (key != NULL);
+
+  now = g_get_real_time ();
+  file = g_file_get_child (self->directory, key);
+
+  g_mutex_lock (&self->mutex);
+  foundry_llm_response_cache_ensure_loaded_locked (self);
+  if ((entry = g_hash_table_lookup (self->entries, key)))
+    {
+      g_queue_unlink (&self->lru, &entry->link);
+      g_queue_push_head_link (&self->lru, &entry->link);
+      entry->last_used = now;
+    }
+  g_mutex_unlock (&self->mutex);
+
+  if (entry == NULL)
+    return dex_future_new_reject (G_IO_ERROR,
+                                  G_IO_ERROR_NOT_FOUND,
+                                  "No cached response");
+
+  if (!(bytes = g_file_load_bytes (file, NULL, NULL, &error)))
+    {
+      /* Removed behind our back, forget about it */
+      g_mutex_lock (&self->mutex);
+      if ((entry = g_hash_table_lookup (self->entries, key)))
+        foundry_llm_response_cache_remove_locked (self, entry);
+      g_mutex_unlock (&self->mutex);
+
+      return dex_future_new_for_error (g_steal_pointer (&error));
+    }
+
+  /* Persist recency so LRU order survives restarts */
+  g_file_set_attribute_uint64 (file,
+                               G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                               now / G_USEC_PER_SEC,
+                               G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                               NULL, NULL);
+
+  return dex_future_new_take_object (g_memory_input_stream_new_from_bytes (bytes));
+}
+
+/**
+ * foundry_llm_response_cache_lookup:
+ * @self: a [class@Foundry.LlmResponseCache]
+ * @key: a key from foundry_llm_response_cache_dup_key()
+ *
+ * Looks up a previously recorded response. The resulting stream reads
+ * from memory so streamed responses replay as fast as they are parsed.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to a
+ *   [class@Gio.InputStream] or rejects with %G_IO_ERROR_NOT_FOUND.
+ */
+DexFuture *
+foundry_llm_response_cache_lookup (FoundryLlmResponseCache *self,
+                                   const char              *key)
+{
+  dex_return_error_if_fail (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  dex_return_error_if_fail (key != NULL);
+
+  if (self->mode == FOUNDRY_LLM_RESPONSE_CACHE_DISABLED)
+    return dex_future_new_reject (G_IO_ERROR,
+                                  G_IO_ERROR_NOT_FOUND,
+                                  "Response cache is disabled");
+
+  return FOUNDRY_SCHEDULER_SPAWN (dex_thread_pool_scheduler_get_default (), 0,
+                                  foundry_llm_response_cache_lookup_fiber,
+                                  2,
+                                  FOUNDRY_TYPE_LLM_RESPONSE_CACHE, self,
+                                  G_TYPE_STRING, key);
+}
+
+static DexFuture *
+foundry_llm_response_cache_store_fiber (FoundryLlmResponseCache *self,
+                                        const char              *key,
+                                        GBytes                  *bytes)
+{
+  g_autoptr(GPtrArray) evicted = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *directory = NULL;
+  g_autofree char *path = NULL;
+  const guint8 *data;
+  gsize size;
+
+  g_assert (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  g_assert (key != NULL);
+  g_assert (bytes != NULL);
+
+  directory = g_file_get_path (self->directory);
+  path = g_build_filename (directory, key, NULL);
+  data = g_bytes_get_data (bytes, &size);
+
+  if (g_mkdir_with_parents (directory, 0750) != 0)
+    {
+      int errsv = errno;
+      return dex_future_new_reject (G_IO_ERROR,
+                                    g_io_error_from_errno (errsv),
+                                    "%s", g_strerror (errsv));
+    }
+
+  if (!g_file_set_contents_full (path, (const char *)data, size,
+                                 G_FILE_SET_CONTENTS_CONSISTENT,
+                                 0640, &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  evicted = g_ptr_array_new_with_free_func (g_free);
+
+  g_mutex_lock (&self->mutex);
+
+  foundry_llm_response_cache_ensure_loaded_locked (self);
+  foundry_llm_response_cache_insert_locked (self, key, size, g_get_real_time ());
+
+  while (self->size > self->max_size && self->lru.length > 1)
+    {
+      Entry *oldest = g_queue_peek_tail (&self->lru);
+
+      g_ptr_array_add (evicted, g_build_filename (directory, oldest->key, NULL));
+      foundry_llm_response_cache_remove_locked (self, oldest);
+    }
+
+  g_mutex_unlock (&self->mutex);
+
+  for (guint i = 0; i < evicted->len; i++)
+    g_unlink (g_ptr_array_index (evicted, i));
+
+  return dex_future_new_true ();
+}
+
+/**
+ * foundry_llm_response_cache_store:
+ * @self: a [class@Foundry.LlmResponseCache]
+ * @key: a key from foundry_llm_response_cache_dup_key()
+ * @bytes: the complete response body
+ *
+ * Stores @bytes for @key, evicting the least recently used responses
+ * if the cache has grown beyond its size limit.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to a
+ *   boolean or rejects with error.
+ */
+DexFuture *
+foundry_llm_response_cache_store (FoundryLlmResponseCache *self,
+                                  const char              *key,
+                                  GBytes                  *bytes)
+{
+  dex_return_error_if_fail (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  dex_return_error_if_fail (key != NULL && is_key (key));
+  dex_return_error_if_fail (bytes != NULL);
+
+  if (self->mode != FOUNDRY_LLM_RESPONSE_CACHE_ENABLED)
+    return dex_future_new_false ();
+
+  /* A single response should never be able to flush everything else */
+  if (g_bytes_get_size (bytes) > self->max_size / 4)
+    return dex_future_new_false ();
+
+  return FOUNDRY_SCHEDULER_SPAWN (dex_thread_pool_scheduler_get_default (), 0,
+                                  foundry_llm_response_cache_store_fiber,
+                                  3,
+                                  FOUNDRY_TYPE_LLM_RESPONSE_CACHE, self,
+                                  G_TYPE_STRING, key,
+                                  G_TYPE_BYTES, bytes);
+}
+
+static DexFuture *
+foundry_llm_response_cache_record_fiber (FoundryLlmResponseCache *self,
+                                         const char              *key,
+                                         GInputStream            *response,
+                                         GOutputStream           *output)
+{
+  g_autoptr(GByteArray) buffer = g_byte_array_new ();
+  g_autoptr(GError) error = NULL;
+
+  g_assert (FOUNDRY_IS_LLM_RESPONSE_CACHE (self));
+  g_assert (key != NULL);
+  g_assert (G_IS_INPUT_STREAM (response));
+  g_assert (G_IS_OUTPUT_STREAM (output));
+
+  for (;;)
+    {
+      g_autoptr(GBytes) bytes = NULL;
+      gsize size;
+
+      /* A truncated response is forwarded as-is but never cached */
+      if (!(bytes = dex_await_boxed (dex_input_stream_read_bytes (response, READ_SIZE, G_PRIORITY_DEFAULT), &error)))
+        return dex_future_new_for_error (g_steal_pointer (&error));
+
+      if ((size = g_bytes_get_size (bytes)) == 0)
+        break;
+
+      if (buffer != NULL && buffer->len + size > self->max_size / 4)
+        g_clear_pointer (&buffer, g_byte_array_unref);
+
+      if (buffer != NULL)
+        g_byte_array_append (buffer, g_bytes_get_data (bytes, NULL), size);
+
+      while (g_bytes_get_size (bytes) > 0)
+        {
+          gint64 n_written;
+
+          n_written = dex_await_int64 (dex_output_stream_write_bytes (output, bytes, G_PRIORITY_DEFAULT), &error);
+
+          if (error != NULL)
+            return dex_future_new_for_error (g_steal_pointer (&error));
+
+          if (n_written < (gint64)g_bytes_get_size (bytes))
+            {
+              GBytes *rest = g_bytes_new_from_bytes (bytes, n_written, g_bytes_get_size (bytes) - n_written);
+              g_bytes_unref (bytes);
+              bytes = rest;
+            }
+          else
+            break;
+        }
+    }
+
+  /* Store before closing so a reader that saw EOF also sees the entry */
+  if (buffer != NULL)
+    dex_await (foundry_llm_response_cache_store (self, key, g_byte_array_free_to_bytes (g_steal_pointer (&buffer))), NULL);
+
+  dex_await (dex_output_stream_close (output, G_PRIORITY_DEFAULT), NULL);
+
+  return dex_future_new_true ();
+}
+
+/**
+ * foundry_llm_response_cache_record:
+ * @self: a [class@Foundry.LlmResponseCache]
+ * @key: a key from foundry_llm_response_cache_dup_key()
+ * @response: the response body from the provider
+ *
+ * Forwards @response to the returned stream as data arrives, storing
+ * the body in the cache once it has been received in full.
+ *
+ * Returns: (transfer full): a [class@Gio.InputStream] or %NULL
+ */
+GInputStream *
+foundry_llm_response_cache_record (FoundryLlmResponseCache  *self,
+                                   const char               *key,
+                                   GInputStream             *response,
+                                   GError                  **error)
+{
+  g_autoptr(GOutputStream) output = NULL;
+  g_autofd int read_fd = -1;
+  g_autofd int write_fd = -1;
+
+  g_return_val_if_fail (FOUNDRY_IS_LLM_RESPONSE_CACHE (self), NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (G_IS_INPUT_STREAM (response), NULL);
+
+  if (!foundry_pipe (&read_fd, &write_fd, O_CLOEXEC|O_NONBLOCK, error))
+    return NULL;
+
+  output = g_unix_output_stream_new (g_steal_fd (&write_fd), TRUE);
+
+  dex_future_disown (FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
+                                              foundry_llm_response_cache_record_fiber,
+                                              4,
+                                              FOUNDRY_TYPE_LLM_RESPONSE_CACHE, self,
+                                              G_TYPE_STRING, key,
+                                              G_TYPE_INPUT_STREAM, response,
+                                              G_TYPE_OUTPUT_STREAM, output));
+
+  return g_unix_input_stream_new (g_steal_fd (&read_fd), TRUE);
+}
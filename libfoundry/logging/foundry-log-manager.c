@@ -20,6 +20,7 @@
 
 #include "config.h"
 
+#include "foundry-context.h"
 #include "foundry-contextual-private.h"
 #include "foundry-debug.h"
 #include "foundry-log-model-private.h"
@@ -47,9 +48,20 @@ G_DEFINE_FINAL_TYPE_WITH_CODE (FoundryLogManager, foundry_log_manager, FOUNDRY_T
 static DexFuture *
 foundry_log_manager_start (FoundryService *service)
 {
+  FoundryLogManager *self = (FoundryLogManager *)service;
+  g_autoptr(FoundryContext) context = NULL;
+
   g_assert (FOUNDRY_IS_MAIN_THREAD ());
   g_assert (FOUNDRY_IS_SERVICE (service));
 
+  /* Keep messages which fall out of the model around for bug reports */
+  if ((context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
+    {
+      g_autoptr(GFile) file = foundry_context_cache_file (context, "foundry.log", NULL);
+
+      _foundry_log_model_set_spill_file (self->log_model, file);
+    }
+
   return dex_future_new_true ();
 }
 
@@ -20,7 +20,7 @@
 
 #pragma once
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 
@@ -28,11 +28,15 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (FoundryLogModel, foundry_log_model, FOUNDRY, LOG_MODEL, GObject)
 
-FoundryLogModel *_foundry_log_model_new        (void);
-void             _foundry_log_model_remove_all (FoundryLogModel *self);
-void             _foundry_log_model_append     (FoundryLogModel *model,
-                                                const char      *domain,
-                                                GLogLevelFlags   flags,
-                                                char            *message);
+FoundryLogModel *_foundry_log_model_new             (void);
+void             _foundry_log_model_remove_all      (FoundryLogModel *self);
+void             _foundry_log_model_append          (FoundryLogModel *model,
+                                                     const char      *domain,
+                                                     GLogLevelFlags   flags,
+                                                     char            *message);
+void             _foundry_log_model_set_max_items   (FoundryLogModel *self,
+                                                     guint            max_items);
+void             _foundry_log_model_set_spill_file  (FoundryLogModel *self,
+                                                     GFile           *file);
 
 G_END_DECLS
@@ -20,18 +20,93 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include <libdex.h>
 
 #include "foundry-debug.h"
 #include "foundry-log-model-private.h"
 #include "foundry-log-message-private.h"
 
+/*
+ * FoundryLogModel stores log records in a bounded ring rather than as a
+ * GObject per message. Message text is copied into large append-only
+ * chunks which are released once every record pointing into them has
+ * been evicted, and domains are interned. A FoundryLogMessage is only
+ * created when a consumer asks for an item. The record keeps a weak
+ * reference to it so that asking again returns the same object for as
+ * long as anything holds on to it.
+ *
+ * Messages may be appended from any thread. Appends from the main thread
+ * are applied immediately. Others are queued under a mutex and a single
+ * idle callback moves the whole batch into the ring so that consumers see
+ * one items-changed per batch instead of one per message.
+ *
+ * Evicted records may optionally be spilled to a file so that nothing is
+ * lost when the cap is reached. Writing happens on the thread pool.
+ */
+
+#define DEFAULT_MAX_ITEMS 10000
+#define MIN_RING_SIZE     256
+#define CHUNK_SIZE        (64 * 1024)
+
+typedef struct _Chunk
+{
+  /* Number of records pointing into this chunk, plus one while it is
+   * the chunk being appended to.
+   */
+  guint n_refs;
+  gsize len;
+  gsize size;
+  char  data[];
+} Chunk;
+
+typedef struct _Record
+{
+  Chunk          *chunk;
+  GWeakRef       *item;
+  const char     *domain;
+  const char     *message;
+  gint64          created_at;
+  GLogLevelFlags  severity;
+} Record;
+
+typedef struct _Pending
+{
+  const char     *domain;
+  char           *message;
+  gint64          created_at;
+  GLogLevelFlags  severity;
+} Pending;
+
+typedef struct _Spill
+{
+  GMutex         mutex;
+  GFile         *file;
+  GOutputStream *stream;
+  GString       *buffer;
+  guint          writing : 1;
+  guint          failed : 1;
+} Spill;
+
 struct _FoundryLogModel
 {
-  GObject     parent_instance;
-  DexChannel *channel;
-  GSequence  *items;
-  guint       n_items;
+  GObject  parent_instance;
+
+  /* Ring of records, only accessed from the main thread */
+  Record  *ring;
+  guint    ring_size;
+  guint    head;
+  guint    n_items;
+  guint    max_items;
+  Chunk   *chunk;
+
+  /* Records appended but not yet visible to the main thread */
+  GMutex   pending_mutex;
+  GArray  *pending;
+  guint    flush_queued : 1;
+
+  Spill   *spill;
 };
 
 enum {
@@ -52,18 +127,55 @@ foundry_log_model_get_n_items (GListModel *model)
   return FOUNDRY_LOG_MODEL (model)->n_items;
 }
 
+static inline Record *
+foundry_log_model_get_record (FoundryLogModel *self,
+                              guint            position)
+{
+  return &self->ring[(self->head + position) % self->ring_size];
+}
+
+static void
+record_clear_item (Record *record)
+{
+  if (record->item != NULL)
+    {
+      g_weak_ref_clear (record->item);
+      g_clear_pointer (&record->item, g_free);
+    }
+}
+
 static gpointer
 foundry_log_model_get_item (GListModel *model,
                             guint       position)
 {
   FoundryLogModel *self = FOUNDRY_LOG_MODEL (model);
+  g_autoptr(GDateTime) created_at = NULL;
+  FoundryLogMessage *item;
+  Record *record;
 
   g_assert (FOUNDRY_IS_MAIN_THREAD ());
 
-  if (position < self->n_items)
-    return g_object_ref (g_sequence_get (g_sequence_get_iter_at_pos (self->items, position)));
+  if (position >= self->n_items)
+    return NULL;
+
+  record = foundry_log_model_get_record (self, position);
+
+  if (record->item != NULL && (item = g_weak_ref_get (record->item)))
+    return item;
+
+  created_at = g_date_time_new_from_unix_local_usec (record->created_at);
+  item = _foundry_log_message_new (record->severity,
+                                   record->domain,
+                                   g_strdup (record->message),
+                                   created_at);
 
-  return NULL;
+  /* The ring may be resized, so the weak ref needs a stable address */
+  if (record->item == NULL)
+    record->item = g_new0 (GWeakRef, 1);
+
+  g_weak_ref_set (record->item, item);
+
+  return item;
 }
 
 static void
@@ -79,97 +191,336 @@ G_DEFINE_FINAL_TYPE_WITH_CODE (FoundryLogModel, foundry_log_model, G_TYPE_OBJECT
 
 static GParamSpec *properties [N_PROPS];
 
-typedef struct
+static void
+chunk_unref (Chunk *chunk)
 {
-  GWeakRef    model_wr;
-  DexChannel *channel;
-} ChannelData;
+  g_assert (chunk != NULL);
+  g_assert (chunk->n_refs > 0);
+
+  if (--chunk->n_refs == 0)
+    g_free (chunk);
+}
 
-static ChannelData *
-channel_data_new (FoundryLogModel *self)
+static Chunk *
+chunk_new (gsize size)
 {
-  ChannelData *cd;
+  Chunk *chunk;
 
-  cd = g_new0 (ChannelData, 1);
-  g_weak_ref_init (&cd->model_wr, self);
-  cd->channel = dex_ref (self->channel);
+  chunk = g_malloc (sizeof *chunk + size);
+  chunk->n_refs = 1;
+  chunk->len = 0;
+  chunk->size = size;
+
+  return chunk;
+}
+
+static void
+pending_clear (gpointer data)
+{
+  Pending *pending = data;
+
+  g_clear_pointer (&pending->message, g_free);
+}
+
+static void
+spill_finalize (gpointer data)
+{
+  Spill *spill = data;
 
-  return cd;
+  g_mutex_clear (&spill->mutex);
+  g_clear_object (&spill->file);
+  g_clear_object (&spill->stream);
+  g_string_free (spill->buffer, TRUE);
 }
 
 static void
-channel_data_free (ChannelData *cd)
+spill_unref (Spill *spill)
 {
-  g_weak_ref_clear (&cd->model_wr);
-  dex_clear (&cd->channel);
-  g_free (cd);
+  g_atomic_rc_box_release_full (spill, spill_finalize);
+}
+
+static DexFuture *
+spill_fiber (gpointer data)
+{
+  Spill *spill = data;
+
+  for (;;)
+    {
+      g_autoptr(GError) error = NULL;
+      g_autoptr(GString) buffer = NULL;
+
+      g_mutex_lock (&spill->mutex);
+
+      if (spill->buffer->len == 0)
+        {
+          spill->writing = FALSE;
+          g_mutex_unlock (&spill->mutex);
+          break;
+        }
+
+      buffer = g_steal_pointer (&spill->buffer);
+      spill->buffer = g_string_new (NULL);
+
+      g_mutex_unlock (&spill->mutex);
+
+      /* We are on a thread pool worker, so blocking here is fine */
+      if (spill->stream == NULL)
+        spill->stream = G_OUTPUT_STREAM (g_file_replace (spill->file, NULL, FALSE,
+                                                         G_FILE_CREATE_REPLACE_DESTINATION,
+                                                         NULL, &error));
+
+      if (spill->stream == NULL ||
+          !g_output_stream_write_all (spill->stream, buffer->str, buffer->len, NULL, NULL, &error) ||
+          !g_output_stream_flush (spill->stream, NULL, &error))
+        {
+          g_mutex_lock (&spill->mutex);
+          spill->failed = TRUE;
+          spill->writing = FALSE;
+          g_mutex_unlock (&spill->mutex);
+          break;
+        }
+    }
+
+  return dex_future_new_true ();
+}
+
+static const char *
+severity_to_string (GLogLevelFlags severity)
+{
+  switch ((int)(severity & G_LOG_LEVEL_MASK))
+    {
+    case G_LOG_LEVEL_ERROR:    return "ERROR";
+    case G_LOG_LEVEL_CRITICAL: return "CRITICAL";
+    case G_LOG_LEVEL_WARNING:  return "WARNING";
+    case G_LOG_LEVEL_MESSAGE:  return "MESSAGE";
+    case G_LOG_LEVEL_INFO:     return "INFO";
+    case G_LOG_LEVEL_DEBUG:    return "DEBUG";
+    default:                   return "LOG";
+    }
 }
 
 static void
-foundry_log_model_take (FoundryLogModel   *self,
-                        FoundryLogMessage *item)
+foundry_log_model_spill (FoundryLogModel *self,
+                         const Record    *records,
+                         guint            n_records)
 {
-  guint position;
+  gboolean spawn = FALSE;
 
   g_assert (FOUNDRY_IS_LOG_MODEL (self));
-  g_assert (FOUNDRY_IS_LOG_MESSAGE (item));
 
-  /* We only want to emit log messages from the main thread so that
-   * consumers do not need to manually proxy messages back to the
-   * main thread on our behalf.
-   */
-  if G_UNLIKELY (!FOUNDRY_IS_MAIN_THREAD ())
+  if (self->spill == NULL || n_records == 0)
+    return;
+
+  g_mutex_lock (&self->spill->mutex);
+
+  if (!self->spill->failed)
     {
-      g_autoptr(DexFuture) future = NULL;
+      for (guint i = 0; i < n_records; i++)
+        {
+          g_autoptr(GDateTime) created_at = g_date_time_new_from_unix_local_usec (records[i].created_at);
+          g_autofree char *stamp = g_date_time_format (created_at, "%H:%M:%S.%f");
+
+          g_string_append_printf (self->spill->buffer,
+                                  "%s %s-%s: %s\n",
+                                  stamp,
+                                  records[i].domain,
+                                  severity_to_string (records[i].severity),
+                                  records[i].message);
+        }
+
+      if (!self->spill->writing)
+        spawn = self->spill->writing = TRUE;
+    }
 
-      future = dex_channel_send (self->channel,
-                                 dex_future_new_take_object (item));
-      return;
+  g_mutex_unlock (&self->spill->mutex);
+
+  if (spawn)
+    dex_future_disown (dex_scheduler_spawn (dex_thread_pool_scheduler_get_default (),
+                                            0,
+                                            spill_fiber,
+                                            g_atomic_rc_box_acquire (self->spill),
+                                            (GDestroyNotify) spill_unref));
+}
+
+static const char *
+foundry_log_model_copy_message (FoundryLogModel  *self,
+                                const char       *message,
+                                Chunk           **chunk)
+{
+  gsize len = strlen (message) + 1;
+  char *dest;
+
+  if (self->chunk == NULL || self->chunk->size - self->chunk->len < len)
+    {
+      /* Oversized messages get their own chunk so we do not throw
+       * away the remainder of the current one.
+       */
+      if (len > CHUNK_SIZE / 4)
+        {
+          *chunk = chunk_new (len);
+          dest = (*chunk)->data;
+          memcpy (dest, message, len);
+          (*chunk)->len = len;
+          return dest;
+        }
+
+      g_clear_pointer (&self->chunk, chunk_unref);
+      self->chunk = chunk_new (CHUNK_SIZE);
     }
 
-  position = self->n_items, self->n_items++;
-  g_sequence_append (self->items, g_steal_pointer (&item));
-  g_list_model_items_changed (G_LIST_MODEL (self), position, 0, 1);
-  g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_N_ITEMS]);
+  dest = &self->chunk->data[self->chunk->len];
+  memcpy (dest, message, len);
+  self->chunk->len += len;
+  self->chunk->n_refs++;
+
+  *chunk = self->chunk;
+
+  return dest;
 }
 
-static DexFuture *
-foundry_log_model_fiber_func (gpointer data)
+static void
+foundry_log_model_resize (FoundryLogModel *self,
+                          guint            ring_size)
 {
-  ChannelData *cd = data;
-  FoundryLogMessage *item;
+  Record *ring;
+
+  g_assert (ring_size >= self->n_items);
+
+  /* Linearize the ring while copying so that head is zero again */
+  ring = g_new (Record, ring_size);
+  for (guint i = 0; i < self->n_items; i++)
+    ring[i] = *foundry_log_model_get_record (self, i);
+
+  g_free (self->ring);
+  self->ring = ring;
+  self->ring_size = ring_size;
+  self->head = 0;
+}
+
+static gboolean
+foundry_log_model_flush (gpointer data)
+{
+  FoundryLogModel *self = data;
+  g_autoptr(GArray) pending = NULL;
+  g_autoptr(GArray) evicted = NULL;
+  guint old_n_items;
+  guint removed;
+  guint added;
 
   g_assert (FOUNDRY_IS_MAIN_THREAD ());
-  g_assert (cd != NULL);
-  g_assert (DEX_IS_CHANNEL (cd->channel));
+  g_assert (FOUNDRY_IS_LOG_MODEL (self));
+
+  g_mutex_lock (&self->pending_mutex);
+  pending = g_steal_pointer (&self->pending);
+  self->pending = g_array_new (FALSE, FALSE, sizeof (Pending));
+  g_array_set_clear_func (self->pending, pending_clear);
+  self->flush_queued = FALSE;
+  g_mutex_unlock (&self->pending_mutex);
+
+  if (pending->len == 0)
+    return G_SOURCE_REMOVE;
+
+  old_n_items = self->n_items;
+  removed = 0;
+
+  if (self->spill != NULL)
+    evicted = g_array_new (FALSE, FALSE, sizeof (Record));
 
-  while ((item = dex_await_object (dex_channel_receive (cd->channel), NULL)))
+  for (guint i = 0; i < pending->len; i++)
     {
-      g_autoptr(FoundryLogModel) self = g_weak_ref_get (&cd->model_wr);
+      const Pending *p = &g_array_index (pending, Pending, i);
+      Record *record;
 
-      if (self != NULL)
-        foundry_log_model_take (self, g_steal_pointer (&item));
-      else
-        g_object_unref (g_steal_pointer (&item));
+      if (self->n_items == self->ring_size && self->ring_size < self->max_items)
+        foundry_log_model_resize (self, MIN (self->max_items, MAX (MIN_RING_SIZE, self->ring_size * 2)));
+
+      if (self->n_items == self->ring_size)
+        {
+          record = &self->ring[self->head];
+
+          record_clear_item (record);
+
+          if (evicted != NULL)
+            {
+              g_array_append_vals (evicted, record, 1);
+              record->chunk->n_refs++;
+            }
+
+          chunk_unref (record->chunk);
+
+          self->head = (self->head + 1) % self->ring_size;
+          self->n_items--;
+          removed++;
+        }
+
+      record = foundry_log_model_get_record (self, self->n_items);
+      record->item = NULL;
+      record->domain = p->domain;
+      record->severity = p->severity;
+      record->created_at = p->created_at;
+      record->message = foundry_log_model_copy_message (self, p->message, &record->chunk);
+
+      self->n_items++;
+    }
+
+  if (evicted != NULL)
+    {
+      foundry_log_model_spill (self, &g_array_index (evicted, Record, 0), evicted->len);
+
+      for (guint i = 0; i < evicted->len; i++)
+        chunk_unref (g_array_index (evicted, Record, i).chunk);
     }
 
-  return NULL;
+  /* Records that were both added and evicted within this batch were
+   * never visible, so do not report them.
+   */
+  if (removed > old_n_items)
+    {
+      added = self->n_items;
+      removed = old_n_items;
+    }
+  else
+    {
+      added = self->n_items - (old_n_items - removed);
+    }
+
+  if (removed > 0)
+    g_list_model_items_changed (G_LIST_MODEL (self), 0, removed, 0);
+
+  if (added > 0)
+    g_list_model_items_changed (G_LIST_MODEL (self), old_n_items - removed, 0, added);
+
+  if (self->n_items != old_n_items)
+    g_object_notify_by_pspec (G_OBJECT (self), properties [PROP_N_ITEMS]);
+
+  return G_SOURCE_REMOVE;
 }
 
 static void
-foundry_log_model_dispose (GObject *object)
+foundry_log_model_clear_ring (FoundryLogModel *self)
 {
-  FoundryLogModel *self = (FoundryLogModel *)object;
-
-  if (self->n_items > 0)
+  for (guint i = 0; i < self->n_items; i++)
     {
-      self->n_items = 0;
-      g_sequence_remove_range (g_sequence_get_begin_iter (self->items),
-                               g_sequence_get_end_iter (self->items));
+      Record *record = foundry_log_model_get_record (self, i);
+
+      record_clear_item (record);
+      chunk_unref (record->chunk);
     }
 
-  if (dex_channel_can_send (self->channel))
-    dex_channel_close_send (self->channel);
+  g_clear_pointer (&self->ring, g_free);
+  g_clear_pointer (&self->chunk, chunk_unref);
+
+  self->ring_size = 0;
+  self->head = 0;
+  self->n_items = 0;
+}
+
+static void
+foundry_log_model_dispose (GObject *object)
+{
+  FoundryLogModel *self = (FoundryLogModel *)object;
+
+  foundry_log_model_clear_ring (self);
 
   G_OBJECT_CLASS (foundry_log_model_parent_class)->dispose (object);
 }
@@ -179,8 +530,10 @@ foundry_log_model_finalize (GObject *object)
 {
   FoundryLogModel *self = (FoundryLogModel *)object;
 
-  g_clear_pointer (&self->items, g_sequence_free);
-  dex_clear (&self->channel);
+  g_clear_pointer (&self->pending, g_array_unref);
+  g_mutex_clear (&self->pending_mutex);
+
+  g_clear_pointer (&self->spill, spill_unref);
 
   G_OBJECT_CLASS (foundry_log_model_parent_class)->finalize (object);
 }
@@ -225,14 +578,11 @@ foundry_log_model_class_init (FoundryLogModelClass *klass)
 static void
 foundry_log_model_init (FoundryLogModel *self)
 {
-  self->items = g_sequence_new (g_object_unref);
-  self->channel = dex_channel_new (0);
+  self->max_items = DEFAULT_MAX_ITEMS;
 
-  dex_future_disown (dex_scheduler_spawn (NULL,
-                                          0,
-                                          foundry_log_model_fiber_func,
-                                          channel_data_new (self),
-                                          (GDestroyNotify)channel_data_free));
+  g_mutex_init (&self->pending_mutex);
+  self->pending = g_array_new (FALSE, FALSE, sizeof (Pending));
+  g_array_set_clear_func (self->pending, pending_clear);
 }
 
 FoundryLogModel *
@@ -247,9 +597,48 @@ _foundry_log_model_append (FoundryLogModel *self,
                            GLogLevelFlags   flags,
                            char            *message)
 {
-  foundry_log_model_take (self, _foundry_log_message_new (flags, domain, message, NULL));
-}
+  Pending pending;
+  gboolean is_main_thread;
+  gboolean queue;
+
+  g_return_if_fail (FOUNDRY_IS_LOG_MODEL (self));
+  g_return_if_fail (domain != NULL);
+  g_return_if_fail (message != NULL);
 
+  pending.domain = g_intern_string (domain);
+  pending.message = message;
+  pending.created_at = g_get_real_time ();
+  pending.severity = flags;
+
+  is_main_thread = FOUNDRY_IS_MAIN_THREAD ();
+
+  g_mutex_lock (&self->pending_mutex);
+  g_array_append_val (self->pending, pending);
+  queue = !is_main_thread && !self->flush_queued;
+  if (queue)
+    self->flush_queued = TRUE;
+  g_mutex_unlock (&self->pending_mutex);
+
+  /* Flushing here also delivers anything queued by other threads
+   * first so that ordering is preserved.
+   */
+  if (is_main_thread)
+    {
+      foundry_log_model_flush (self);
+      return;
+    }
+
+  /* We only want to emit log messages from the main thread so that
+   * consumers do not need to manually proxy messages back to the
+   * main thread on our behalf. Everything appended until the idle
+   * callback runs is delivered as a single batch.
+   */
+  if (queue)
+    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                     foundry_log_model_flush,
+                     g_object_ref (self),
+                     g_object_unref);
+}
 
 void
 _foundry_log_model_remove_all (FoundryLogModel *self)
@@ -258,10 +647,13 @@ _foundry_log_model_remove_all (FoundryLogModel *self)
 
   g_return_if_fail (FOUNDRY_IS_LOG_MODEL (self));
 
-  n_items = g_list_model_get_n_items (G_LIST_MODEL (self));
-  g_clear_pointer (&self->items, g_sequence_free);
-  self->items = g_sequence_new (g_object_unref);
-  self->n_items = 0;
+  g_mutex_lock (&self->pending_mutex);
+  g_array_set_size (self->pending, 0);
+  g_mutex_unlock (&self->pending_mutex);
+
+  n_items = self->n_items;
+
+  foundry_log_model_clear_ring (self);
 
   if (n_items > 0)
     {
@@ -269,3 +661,81 @@ _foundry_log_model_remove_all (FoundryLogModel *self)
       g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
     }
 }
+
+/**
+ * _foundry_log_model_set_max_items:
+ * @self: a [class@Foundry.LogModel]
+ * @max_items: the maximum number of records to keep
+ *
+ * Sets the number of records retained before the oldest are evicted
+ * (and spilled, if a spill file has been set).
+ */
+void
+_foundry_log_model_set_max_items (FoundryLogModel *self,
+                                  guint            max_items)
+{
+  g_return_if_fail (FOUNDRY_IS_LOG_MODEL (self));
+  g_return_if_fail (FOUNDRY_IS_MAIN_THREAD ());
+
+  max_items = MAX (1, max_items);
+
+  if (max_items == self->max_items)
+    return;
+
+  if (max_items < self->n_items)
+    {
+      guint old_n_items = self->n_items;
+      guint removed = old_n_items - max_items;
+      g_autofree Record *evicted = g_new (Record, removed);
+
+      for (guint i = 0; i < removed; i++)
+        {
+          Record *record = foundry_log_model_get_record (self, i);
+
+          record_clear_item (record);
+          evicted[i] = *record;
+        }
+
+      foundry_log_model_spill (self, evicted, removed);
+
+      for (guint i = 0; i < removed; i++)
+        chunk_unref (evicted[i].chunk);
+
+      self->head = (self->head + removed) % self->ring_size;
+      self->n_items = max_items;
+
+      g_list_model_items_changed (G_LIST_MODEL (self), 0, removed, 0);
+      g_object_notify_by_pspec (G_OBJECT (self), properties[PROP_N_ITEMS]);
+    }
+
+  if (self->ring_size > max_items)
+    foundry_log_model_resize (self, max_items);
+
+  self->max_items = max_items;
+}
+
+/**
+ * _foundry_log_model_set_spill_file:
+ * @self: a [class@Foundry.LogModel]
+ * @file: (nullable): a [iface@Gio.File] or %NULL
+ *
+ * Sets a file which evicted records are written to. The file is
+ * replaced when the first record is evicted.
+ */
+void
+_foundry_log_model_set_spill_file (FoundryLogModel *self,
+                                   GFile           *file)
+{
+  g_return_if_fail (FOUNDRY_IS_LOG_MODEL (self));
+  g_return_if_fail (!file || G_IS_FILE (file));
+
+  g_clear_pointer (&self->spill, spill_unref);
+
+  if (file == NULL)
+    return;
+
+  self->spill = g_atomic_rc_box_new0 (Spill);
+  g_mutex_init (&self->spill->mutex);
+  self->spill->file = g_object_ref (file);
+  self->spill->buffer = g_string_new (NULL);
+}
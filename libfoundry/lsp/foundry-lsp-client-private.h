@@ -24,7 +24,8 @@
 
 G_BEGIN_DECLS
 
-GListModel *_foundry_lsp_client_get_diagnostics (FoundryLspClient *self,
-                                                 GFile            *file);
+GListModel *_foundry_lsp_client_get_diagnostics    (FoundryLspClient *self,
+                                                    GFile            *file);
+guint       _foundry_lsp_client_get_n_superseding (FoundryLspClient *self);
 
 G_END_DECLS
@@ -24,11 +24,13 @@
 
 #include "foundry-diagnostic.h"
 #include "foundry-diagnostic-builder.h"
+#include "foundry-diagnostic-private.h"
 #include "foundry-json.h"
 #include "foundry-json-node.h"
 #include "foundry-jsonrpc-driver-private.h"
 #include "foundry-lsp-client-private.h"
 #include "foundry-lsp-provider.h"
+#include "foundry-metrics-private.h"
 #include "foundry-operation-manager.h"
 #include "foundry-operation.h"
 #include "foundry-text-buffer.h"
@@ -48,6 +50,8 @@ struct _FoundryLspClient
   GHashTable           *diagnostics;
   GHashTable           *progress;
   GHashTable           *commit_notify;
+  GHashTable           *supersede;
+  GHashTable           *metric_ids;
   guint                 text_document_sync : 2;
 };
 
@@ -82,6 +86,20 @@ enum {
 
 static GParamSpec *properties[N_PROPS];
 
+/* Requests for which only the most recent reply per document is of any
+ * use. Issuing a new one cancels any outstanding request for the same
+ * method and document.
+ */
+static const char * const supersede_methods[] = {
+  "textDocument/codeAction",
+  "textDocument/completion",
+  "textDocument/documentHighlight",
+  "textDocument/hover",
+  "textDocument/inlayHint",
+  "textDocument/signatureHelp",
+  NULL
+};
+
 static void
 commit_notify_free (CommitNotify *notify)
 {
@@ -234,6 +252,7 @@ foundry_lsp_client_publish_diagnostics (FoundryLspClient *self,
 {
   g_autoptr(GFile) file = NULL;
   g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GPtrArray) items = NULL;
   const char *uri = NULL;
   JsonNode *diagnostics = NULL;
   GListStore *store;
@@ -252,13 +271,14 @@ foundry_lsp_client_publish_diagnostics (FoundryLspClient *self,
   if (!(store = g_hash_table_lookup (self->diagnostics, file)))
     return;
 
-  g_list_store_remove_all (store);
-
-  if (!(context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
-    return;
+  items = g_ptr_array_new_with_free_func (g_object_unref);
 
-  if (!diagnostics || !JSON_NODE_HOLDS_ARRAY (diagnostics))
-    return;
+  /* Servers republish the whole set for the document after every
+   * change, so splice in only what differs from the previous set.
+   */
+  if (!(context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))) ||
+      !diagnostics || !JSON_NODE_HOLDS_ARRAY (diagnostics))
+    goto update;
 
   diagnostics_array = json_node_get_array (diagnostics);
 
@@ -319,9 +339,14 @@ foundry_lsp_client_publish_diagnostics (FoundryLspClient *self,
         diagnostic = foundry_diagnostic_builder_end (builder);
 
         if (diagnostic != NULL)
-          g_list_store_append (store, diagnostic);
+          g_ptr_array_add (items, g_steal_pointer (&diagnostic));
       }
   }
+
+update:
+  _foundry_diagnostic_store_update (store,
+                                    (FoundryDiagnostic * const *)items->pdata,
+                                    items->len);
 }
 
 static gboolean
@@ -364,6 +389,7 @@ foundry_lsp_client_set_io_stream (FoundryLspClient *self,
   g_assert (G_IS_IO_STREAM (io_stream));
 
   self->driver = foundry_jsonrpc_driver_new (io_stream, FOUNDRY_JSONRPC_STYLE_HTTP);
+  foundry_jsonrpc_driver_set_cancel_method (self->driver, "$/cancelRequest");
 
   g_signal_connect_object (self->driver,
                            "handle-method-call",
@@ -434,6 +460,8 @@ foundry_lsp_client_finalize (GObject *object)
   g_clear_pointer (&self->diagnostics, g_hash_table_unref);
   g_clear_pointer (&self->progress, g_hash_table_unref);
   g_clear_pointer (&self->commit_notify, g_hash_table_unref);
+  g_clear_pointer (&self->supersede, g_hash_table_unref);
+  g_clear_pointer (&self->metric_ids, g_hash_table_unref);
   dex_clear (&self->future);
 
   G_OBJECT_CLASS (foundry_lsp_client_parent_class)->finalize (object);
@@ -552,6 +580,11 @@ foundry_lsp_client_init (FoundryLspClient *self)
                                                (GEqualFunc) g_file_equal,
                                                g_object_unref,
                                                (GDestroyNotify) commit_notify_free);
+  self->supersede = g_hash_table_new_full (g_str_hash,
+                                           g_str_equal,
+                                           g_free,
+                                           (GDestroyNotify) json_node_unref);
+  self->metric_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
 /**
@@ -576,12 +609,40 @@ foundry_lsp_client_query_capabilities (FoundryLspClient *self)
                                 "not supported");
 }
 
+typedef struct _CallTiming
+{
+  guint  metric_id;
+  gint64 begin;
+} CallTiming;
+
+static guint
+foundry_lsp_client_get_metric_id (FoundryLspClient *self,
+                                  const char       *method)
+{
+  gpointer value;
+
+  if (!g_hash_table_lookup_extended (self->metric_ids, method, NULL, &value))
+    {
+      g_autofree char *name = g_strconcat ("lsp.call.", method, NULL);
+
+      value = GUINT_TO_POINTER (_foundry_metrics_register (name, FOUNDRY_METRIC_HISTOGRAM));
+      g_hash_table_insert (self->metric_ids, g_strdup (method), value);
+    }
+
+  return GPOINTER_TO_UINT (value);
+}
+
 static DexFuture *
 foundry_lsp_client_call_cb (DexFuture *completed,
                             gpointer   user_data)
 {
+  CallTiming *timing = user_data;
+  gint64 duration = _foundry_metrics_now () - timing->begin;
   const GValue *value;
 
+  FOUNDRY_METRICS_RECORD ("lsp.call", duration);
+  _foundry_metrics_record (timing->metric_id, duration);
+
   if ((value = dex_future_get_value (completed, NULL)) &&
       G_VALUE_HOLDS (value, JSON_TYPE_NODE))
     return dex_ref (completed);
@@ -591,6 +652,58 @@ foundry_lsp_client_call_cb (DexFuture *completed,
                                 "Subprocess exited during JSONRPC call");
 }
 
+typedef struct _Supersede
+{
+  GWeakRef  self_wr;
+  char     *key;
+  JsonNode *id;
+} Supersede;
+
+static void
+supersede_free (Supersede *state)
+{
+  g_weak_ref_clear (&state->self_wr);
+  g_clear_pointer (&state->key, g_free);
+  g_clear_pointer (&state->id, json_node_unref);
+  g_free (state);
+}
+
+static DexFuture *
+foundry_lsp_client_supersede_cb (DexFuture *completed,
+                                 gpointer   user_data)
+{
+  Supersede *state = user_data;
+  g_autoptr(FoundryLspClient) self = g_weak_ref_get (&state->self_wr);
+
+  /* Forget the request once it settles, unless a newer request for the
+   * same method and document has already taken its place.
+   */
+  if (self != NULL &&
+      self->supersede != NULL &&
+      g_hash_table_lookup (self->supersede, state->key) == state->id)
+    g_hash_table_remove (self->supersede, state->key);
+
+  return dex_ref (completed);
+}
+
+static char *
+get_supersede_key (const char *method,
+                   JsonNode   *params)
+{
+  const char *uri = NULL;
+
+  if (params == NULL || !g_strv_contains (supersede_methods, method))
+    return NULL;
+
+  if (!FOUNDRY_JSON_OBJECT_PARSE (params,
+                                  "textDocument", "{",
+                                    "uri", FOUNDRY_JSON_NODE_GET_STRING (&uri),
+                                  "}"))
+    return NULL;
+
+  return g_strconcat (method, " ", uri, NULL);
+}
+
 /**
  * foundry_lsp_client_call:
  * @self: a #FoundryLspClient
@@ -599,6 +712,14 @@ foundry_lsp_client_call_cb (DexFuture *completed,
  *
  * If @params is floating, the reference will be consumed.
  *
+ * If the resulting future is discarded before a reply is received, a
+ * `$/cancelRequest` is sent to the server and the reply is dropped.
+ *
+ * Requests such as `textDocument/completion` or `textDocument/hover`
+ * supersede any outstanding request of the same method for the same
+ * document, which is then cancelled and rejected with
+ * %G_IO_ERROR_CANCELLED.
+ *
  * Returns: (transfer full): a [class@Dex.Future] that resolves when
  *   a reply is received for the method call.
  */
@@ -607,17 +728,58 @@ foundry_lsp_client_call (FoundryLspClient *self,
                          const char       *method,
                          JsonNode         *params)
 {
+  g_autofree char *supersede_key = NULL;
+  g_autoptr(JsonNode) id = NULL;
+  CallTiming *timing;
+  DexFuture *future;
+
   dex_return_error_if_fail (FOUNDRY_IS_LSP_CLIENT (self));
   dex_return_error_if_fail (method != NULL);
 
+  timing = g_new0 (CallTiming, 1);
+  timing->metric_id = foundry_lsp_client_get_metric_id (self, method);
+  timing->begin = _foundry_metrics_now ();
+
+  /* Cancel the previous request first so the server sees the
+   * $/cancelRequest before the request replacing it.
+   */
+  if ((supersede_key = get_supersede_key (method, params)))
+    {
+      JsonNode *previous = g_hash_table_lookup (self->supersede, supersede_key);
+
+      if (previous != NULL)
+        foundry_jsonrpc_driver_cancel (self->driver, previous);
+    }
+
+  future = foundry_jsonrpc_driver_call_full (self->driver, method, params, &id);
+
+  if (supersede_key != NULL)
+    {
+      Supersede *state = g_new0 (Supersede, 1);
+
+      g_weak_ref_init (&state->self_wr, self);
+      state->key = g_strdup (supersede_key);
+      state->id = json_node_ref (id);
+
+      g_hash_table_replace (self->supersede,
+                            g_steal_pointer (&supersede_key),
+                            g_steal_pointer (&id));
+
+      future = dex_future_finally (future,
+                                   foundry_lsp_client_supersede_cb,
+                                   state,
+                                   (GDestroyNotify) supersede_free);
+    }
+
   /* We want to return the call from the driver, but if our subprocess
    * LSP exits we want to early bail from the whole thing.
    */
   return dex_future_finally (dex_future_first (dex_ref (self->future),
-                                               foundry_jsonrpc_driver_call (self->driver, method, params),
+                                               future,
                                                NULL),
                              foundry_lsp_client_call_cb,
-                             NULL, NULL);
+                             timing,
+                             g_free);
 }
 
 /**
@@ -1243,6 +1405,14 @@ foundry_lsp_client_supports_language (FoundryLspClient *self,
   return FALSE;
 }
 
+guint
+_foundry_lsp_client_get_n_superseding (FoundryLspClient *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_LSP_CLIENT (self), 0);
+
+  return g_hash_table_size (self->supersede);
+}
+
 GListModel *
 _foundry_lsp_client_get_diagnostics (FoundryLspClient *self,
                                      GFile            *file)
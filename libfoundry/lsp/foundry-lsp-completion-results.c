@@ -35,6 +35,24 @@
 #define EGG_ARRAY_BY_VALUE 1
 #include "eggarrayimpl.c"
 
+/* The number of best matches which are fully ranked on each refilter.
+ * They are selected with a bounded heap rather than sorting every match.
+ * The remaining matches are not dropped. They follow the ranked head in
+ * the order provided by the server so that they are still reachable by
+ * scrolling.
+ */
+#define MAX_RANKED_RESULTS 1000
+
+typedef struct _Entry
+{
+  /* Offset of the casefolded filterText (or label) within strings */
+  guint filter_offset;
+  /* Offset of the sortText (or label) within strings */
+  guint sort_offset;
+  /* Score from the most recent match, lower is better */
+  guint score;
+} Entry;
+
 struct _FoundryLspCompletionResults
 {
   GObject           parent_instance;
@@ -45,6 +63,19 @@ struct _FoundryLspCompletionResults
   char             *typed_text;
   GQueue            children;
   Items             items;
+
+  /* Packed string arena and per-item records extracted once at load
+   * time so that refiltering never needs to touch the JSON DOM.
+   */
+  GByteArray       *strings;
+  GArray           *entries;
+
+  /* Matching item indexes. The first MAX_RANKED_RESULTS are ordered by
+   * score, sortText, then index and the rest by index.
+   */
+  GArray           *order;
+
+  guint             ranked : 1;
 };
 
 enum {
@@ -64,7 +95,7 @@ foundry_lsp_completion_results_get_n_items (GListModel *model)
 {
   FoundryLspCompletionResults *self = FOUNDRY_LSP_COMPLETION_RESULTS (model);
 
-  return egg_bitset_get_size (self->bitset);
+  return self->order->len;
 }
 
 static gpointer
@@ -75,10 +106,10 @@ foundry_lsp_completion_results_get_item (GListModel *model,
   gpointer *item;
   gsize index;
 
-  if (position >= egg_bitset_get_size (self->bitset))
+  if (position >= self->order->len)
     return NULL;
 
-  index = egg_bitset_get_nth (self->bitset, position);
+  index = g_array_index (self->order, guint, position);
   item = items_get (&self->items, index);
 
   if (*item == NULL)
@@ -126,6 +157,11 @@ foundry_lsp_completion_results_dispose (GObject *object)
   items_clear (&self->items);
 
   g_clear_pointer (&self->typed_text, g_free);
+  g_clear_pointer (&self->strings, g_byte_array_unref);
+  g_clear_pointer (&self->entries, g_array_unref);
+
+  if (self->order != NULL)
+    g_array_set_size (self->order, 0);
   g_clear_object (&self->client);
   g_clear_pointer (&self->reply, json_node_unref);
   g_clear_pointer (&self->results, json_node_unref);
@@ -139,6 +175,7 @@ foundry_lsp_completion_results_finalize (GObject *object)
   FoundryLspCompletionResults *self = (FoundryLspCompletionResults *)object;
 
   g_clear_pointer (&self->bitset, egg_bitset_unref);
+  g_clear_pointer (&self->order, g_array_unref);
 
   G_OBJECT_CLASS (foundry_lsp_completion_results_parent_class)->finalize (object);
 }
@@ -205,6 +242,7 @@ static void
 foundry_lsp_completion_results_init (FoundryLspCompletionResults *self)
 {
   self->bitset = egg_bitset_new_empty ();
+  self->order = g_array_new (FALSE, FALSE, sizeof (guint));
 }
 
 /**
@@ -221,20 +259,105 @@ foundry_lsp_completion_results_dup_client (FoundryLspCompletionResults *self)
   return g_object_ref (self->client);
 }
 
+static guint
+append_string (GByteArray *strings,
+               const char *str,
+               gboolean    casefold)
+{
+  guint offset = strings->len;
+
+  if (str == NULL)
+    str = "";
+
+  if (!casefold)
+    {
+      g_byte_array_append (strings, (const guint8 *)str, strlen (str) + 1);
+    }
+  else
+    {
+      const char *iter;
+
+      for (iter = str; *iter && !(*iter & 0x80); iter++) { }
+
+      if (*iter == 0)
+        {
+          /* Fast path for ASCII, which is nearly all symbol names */
+          for (iter = str; *iter; iter++)
+            {
+              guint8 ch = g_ascii_tolower (*iter);
+              g_byte_array_append (strings, &ch, 1);
+            }
+
+          g_byte_array_append (strings, (const guint8 *)"", 1);
+        }
+      else
+        {
+          g_autofree char *folded = g_utf8_casefold (str, -1);
+
+          g_byte_array_append (strings, (const guint8 *)folded, strlen (folded) + 1);
+        }
+    }
+
+  return offset;
+}
+
+static const char *
+get_member_string (JsonObject *obj,
+                   const char *member)
+{
+  JsonNode *node;
+
+  if ((node = json_object_get_member (obj, member)) &&
+      JSON_NODE_HOLDS_VALUE (node) &&
+      json_node_get_value_type (node) == G_TYPE_STRING)
+    return json_node_get_string (node);
+
+  return NULL;
+}
+
 static DexFuture *
 foundry_lsp_completion_results_load (FoundryLspCompletionResults *self,
                                      const char                  *typed_text)
 {
+  JsonArray *ar;
   gsize n_children;
 
   g_assert (FOUNDRY_IS_LSP_COMPLETION_RESULTS (self));
 
-  n_children = json_array_get_length (json_node_get_array (self->results));
+  ar = json_node_get_array (self->results);
+  n_children = json_array_get_length (ar);
 
   items_set_size (&self->items, n_children);
 
-  if (n_children > 0)
-    egg_bitset_add_range (self->bitset, 0, n_children);
+  /* Extract everything needed for filtering and ranking once, up front,
+   * on the thread pool. Items without a label can never match.
+   */
+  self->entries = g_array_sized_new (FALSE, TRUE, sizeof (Entry), n_children);
+  self->strings = g_byte_array_sized_new (n_children * 32);
+
+  for (gsize i = 0; i < n_children; i++)
+    {
+      JsonNode *child = json_array_get_element (ar, i);
+      const char *label = NULL;
+      const char *filter_text = NULL;
+      const char *sort_text = NULL;
+      Entry entry;
+
+      if (JSON_NODE_HOLDS_OBJECT (child))
+        {
+          JsonObject *obj = json_node_get_object (child);
+
+          label = get_member_string (obj, "label");
+          filter_text = get_member_string (obj, "filterText");
+          sort_text = get_member_string (obj, "sortText");
+        }
+
+      entry.filter_offset = append_string (self->strings, filter_text ? filter_text : label, TRUE);
+      entry.sort_offset = append_string (self->strings, sort_text ? sort_text : label, FALSE);
+      entry.score = 0;
+
+      g_array_append_val (self->entries, entry);
+    }
 
   foundry_lsp_completion_results_refilter (self, typed_text);
 
@@ -323,11 +446,12 @@ determine_change (const char *before,
 }
 
 static gboolean
-fuzzy_match (const char *haystack,
+fuzzy_match (const char *casefold_haystack,
              const char *casefold_needle,
              guint      *priority)
 {
-	int real_score = 0;
+  const char *haystack = casefold_haystack;
+  guint real_score = 0;
 
   if (haystack == NULL || haystack[0] == 0)
     return FALSE;
@@ -335,30 +459,15 @@ fuzzy_match (const char *haystack,
   for (; *casefold_needle; casefold_needle = g_utf8_next_char (casefold_needle))
     {
       gunichar ch = g_utf8_get_char (casefold_needle);
-      gunichar chup = g_unichar_toupper (ch);
-      const gchar *tmp;
-      const gchar *downtmp;
-      const gchar *uptmp;
+      const char *tmp;
 
-      /*
-       * Note that the following code is not really correct. We want
-       * to be relatively fast here, but we also don't want to convert
-       * strings to casefolded versions for querying on each compare.
-       * So we use the casefold version and compare with upper. This
-       * works relatively well since we are usually dealing with ASCII
-       * for function names and symbols.
-       */
-
-      downtmp = strchr (haystack, ch);
-      uptmp = strchr (haystack, chup);
-
-      if (downtmp && uptmp)
-        tmp = MIN (downtmp, uptmp);
-      else if (downtmp)
-        tmp = downtmp;
-      else if (uptmp)
-        tmp = uptmp;
+      /* Both strings are casefolded so this is a simple search */
+      if (ch < 0x80)
+        tmp = strchr (haystack, (char)ch);
       else
+        tmp = g_utf8_strchr (haystack, -1, ch);
+
+      if (tmp == NULL)
         return FALSE;
 
       /*
@@ -373,15 +482,10 @@ fuzzy_match (const char *haystack,
        */
       real_score += (tmp - haystack) * 2;
 
-      /* Add extra cost if we matched by using toupper */
-      if ((gunichar)*haystack == chup)
-        real_score += 1;
-
-      /*
-       * * Now move past our matching character so we cannot match
-       * * it a second time.
-       * */
-      haystack = tmp + 1;
+      /* Now move past our matching character so we cannot match
+       * it a second time.
+       */
+      haystack = g_utf8_next_char (tmp);
     }
 
   if (priority != NULL)
@@ -390,25 +494,172 @@ fuzzy_match (const char *haystack,
   return TRUE;
 }
 
+static inline gboolean
+match_entry (FoundryLspCompletionResults *self,
+             guint                        index,
+             const char                  *casefold)
+{
+  Entry *entry = &g_array_index (self->entries, Entry, index);
+  const char *filter_text = (const char *)&self->strings->data[entry->filter_offset];
+
+  return fuzzy_match (filter_text, casefold, &entry->score);
+}
+
+static int
+compare_ranked (gconstpointer a,
+                gconstpointer b,
+                gpointer      user_data)
+{
+  FoundryLspCompletionResults *self = user_data;
+  guint index_a = *(const guint *)a;
+  guint index_b = *(const guint *)b;
+  const Entry *entry_a = &g_array_index (self->entries, Entry, index_a);
+  const Entry *entry_b = &g_array_index (self->entries, Entry, index_b);
+  int ret;
+
+  if (entry_a->score != entry_b->score)
+    return entry_a->score < entry_b->score ? -1 : 1;
+
+  if ((ret = strcmp ((const char *)&self->strings->data[entry_a->sort_offset],
+                     (const char *)&self->strings->data[entry_b->sort_offset])))
+    return ret;
+
+  /* Stable tiebreak on the order provided by the server */
+  return index_a < index_b ? -1 : index_a > index_b;
+}
+
+static void
+heap_sift_down (FoundryLspCompletionResults *self,
+                guint                       *heap,
+                guint                        len,
+                guint                        pos)
+{
+  for (;;)
+    {
+      guint left = pos * 2 + 1;
+      guint right = left + 1;
+      guint largest = pos;
+      guint tmp;
+
+      if (left < len && compare_ranked (&heap[left], &heap[largest], self) > 0)
+        largest = left;
+
+      if (right < len && compare_ranked (&heap[right], &heap[largest], self) > 0)
+        largest = right;
+
+      if (largest == pos)
+        break;
+
+      tmp = heap[pos];
+      heap[pos] = heap[largest];
+      heap[largest] = tmp;
+
+      pos = largest;
+    }
+}
+
+static void
+foundry_lsp_completion_results_rank (FoundryLspCompletionResults *self)
+{
+  EggBitsetIter iter;
+  guint *heap;
+  guint n_matches;
+  guint n_head;
+  guint index;
+
+  g_assert (FOUNDRY_IS_LSP_COMPLETION_RESULTS (self));
+
+  n_matches = (guint)egg_bitset_get_size (self->bitset);
+  n_head = MIN (n_matches, MAX_RANKED_RESULTS);
+
+  g_array_set_size (self->order, n_matches);
+
+  if (n_matches == 0)
+    return;
+
+  heap = &g_array_index (self->order, guint, 0);
+
+  /* Keep the best n_head matches in a max-heap at the front of the
+   * order array so the worst of them is always at the root and can
+   * be replaced in O(log n_head).
+   */
+  egg_bitset_iter_init_first (&iter, self->bitset, &index);
+
+  for (guint i = 0; i < n_head; i++)
+    {
+      heap[i] = index;
+      egg_bitset_iter_next (&iter, &index);
+    }
+
+  for (guint i = n_head / 2; i > 0; i--)
+    heap_sift_down (self, heap, n_head, i - 1);
+
+  if (n_matches > n_head)
+    {
+      guint threshold;
+      guint n_tail = 0;
+
+      do
+        {
+          if (compare_ranked (&index, &heap[0], self) < 0)
+            {
+              heap[0] = index;
+              heap_sift_down (self, heap, n_head, 0);
+            }
+        }
+      while (egg_bitset_iter_next (&iter, &index));
+
+      /* The ordering is total (ties fall back to the index) so anything
+       * worse than the root is exactly the set of matches not in the heap.
+       */
+      threshold = heap[0];
+
+      egg_bitset_iter_init_first (&iter, self->bitset, &index);
+
+      do
+        {
+          if (compare_ranked (&index, &threshold, self) > 0)
+            heap[n_head + n_tail++] = index;
+        }
+      while (egg_bitset_iter_next (&iter, &index));
+
+      g_assert (n_head + n_tail == n_matches);
+    }
+
+  g_sort_array (heap, n_head, sizeof (guint), compare_ranked, self);
+}
+
 void
 foundry_lsp_completion_results_refilter (FoundryLspCompletionResults *self,
                                          const char                  *typed_text)
 {
   guint old_n_items;
   guint new_n_items;
+  guint n_entries;
 
   g_return_if_fail (FOUNDRY_IS_LSP_COMPLETION_RESULTS (self));
 
-  old_n_items = g_list_model_get_n_items (G_LIST_MODEL (self));
+  if (self->entries == NULL)
+    return;
+
+  old_n_items = self->order->len;
+  n_entries = self->entries->len;
 
   switch (determine_change (self->typed_text, typed_text))
     {
     case SAME:
-      return;
+      if (self->ranked)
+        return;
+      G_GNUC_FALLTHROUGH;
 
     case DIFFERENT:
+    case LESS_STRICT:
+      /* Scores of existing matches change when the typed text gets
+       * shorter, so we must visit every item again anyway.
+       */
       egg_bitset_remove_all (self->bitset);
-      egg_bitset_add_range (self->bitset, 0, items_get_size (&self->items));
+      if (n_entries > 0)
+        egg_bitset_add_range (self->bitset, 0, n_entries);
       G_GNUC_FALLTHROUGH;
 
     case MORE_STRICT:
@@ -416,24 +667,21 @@ foundry_lsp_completion_results_refilter (FoundryLspCompletionResults *self,
         EggBitsetIter iter;
         guint index;
 
-        if (typed_text != NULL &&
-            typed_text[0] != 0 &&
-            egg_bitset_iter_init_first (&iter, self->bitset, &index))
+        if (typed_text == NULL || typed_text[0] == 0)
+          {
+            for (guint i = 0; i < n_entries; i++)
+              g_array_index (self->entries, Entry, i).score = 0;
+          }
+        else if (egg_bitset_iter_init_first (&iter, self->bitset, &index))
           {
             g_autofree char *casefold = g_utf8_casefold (typed_text, -1);
-            JsonArray *ar = json_node_get_array (self->results);
 
+            /* Only items which matched the previous (less strict) text
+             * can possibly match now, so just narrow the bitset.
+             */
             do
               {
-                JsonNode *child = json_array_get_element (ar, index);
-                const char *label;
-                JsonObject *obj;
-
-                if (!(JSON_NODE_HOLDS_OBJECT (child) &&
-                      (obj = json_node_get_object (child)) &&
-                      json_object_has_member (obj, "label") &&
-                      (label = json_object_get_string_member (obj, "label")) &&
-                      fuzzy_match (label, casefold, NULL)))
+                if (!match_entry (self, index, casefold))
                   egg_bitset_remove (self->bitset, index);
               }
             while (egg_bitset_iter_next (&iter, &index));
@@ -441,56 +689,16 @@ foundry_lsp_completion_results_refilter (FoundryLspCompletionResults *self,
       }
       break;
 
-    case LESS_STRICT:
-      {
-        if (typed_text == NULL || typed_text[0] != 0)
-          {
-            egg_bitset_remove_all (self->bitset);
-            egg_bitset_add_range (self->bitset, 0, items_get_size (&self->items));
-          }
-        else
-          {
-            g_autoptr(EggBitset) other = NULL;
-            EggBitsetIter iter;
-            guint index;
-
-            other = egg_bitset_new_empty ();
-            egg_bitset_add_range (other, 0, items_get_size (&self->items));
-            egg_bitset_difference (other, self->bitset);
-
-            if (egg_bitset_iter_init_first (&iter, other, &index))
-              {
-                g_autofree char *casefold = g_utf8_casefold (typed_text, -1);
-                JsonArray *ar = json_node_get_array (self->results);
-
-                do
-                  {
-                    JsonNode *child = json_array_get_element (ar, index);
-                    const char *label;
-                    JsonObject *obj;
-
-                    g_assert (!egg_bitset_contains (self->bitset, index));
-
-                    if (JSON_NODE_HOLDS_OBJECT (child) &&
-                        (obj = json_node_get_object (child)) &&
-                        json_object_has_member (obj, "label") &&
-                        (label = json_object_get_string_member (obj, "label")) &&
-                        fuzzy_match (label, casefold, NULL))
-                      egg_bitset_add (self->bitset, index);
-                  }
-                while (egg_bitset_iter_next (&iter, &index));
-              }
-          }
-      }
-      break;
-
     default:
       g_assert_not_reached ();
     }
 
   g_set_str (&self->typed_text, typed_text);
 
-  new_n_items = g_list_model_get_n_items (G_LIST_MODEL (self));
+  foundry_lsp_completion_results_rank (self);
+  self->ranked = TRUE;
+
+  new_n_items = self->order->len;
 
   g_list_model_items_changed (G_LIST_MODEL (self), 0, old_n_items, new_n_items);
 }
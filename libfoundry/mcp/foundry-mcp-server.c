@@ -27,17 +27,30 @@
 #include "foundry-llm-message.h"
 #include "foundry-llm-resource.h"
 #include "foundry-llm-tool.h"
-#include "foundry-mcp-server.h"
+#include "foundry-mcp-server-private.h"
 #include "foundry-model-manager.h"
 #include "foundry-util.h"
 
+/* Tool calls each run on their own fiber. This caps how many calls
+ * to any single tool may be in flight so that one slow tool cannot
+ * consume every worker it dispatches to.
+ */
+#define MAX_CALLS_PER_TOOL 4
+
 struct _FoundryMcpServer
 {
   FoundryContextual     parent_instance;
   FoundryJsonrpcDriver *driver;
   GListModel           *tools;
+  GPtrArray            *tools_mirror;
+  GHashTable           *tools_by_name;
+  GHashTable           *tool_limiters;
+  GHashTable           *in_flight;
   GListModel           *resources;
   GHashTable           *subscribed_resources;
+  DexFuture            *loaded;
+  guint                 tools_changed_source;
+  guint                 resources_changed_source;
   guint                 started : 1;
   guint                 got_initialize : 1;
 };
@@ -55,6 +68,20 @@ typedef struct
   JsonNode *id;
 } PropagateError;
 
+typedef struct
+{
+  FoundryLlmTool *tool;
+  GArray         *values;
+} ToolCall;
+
+static void
+tool_call_free (ToolCall *call)
+{
+  g_clear_object (&call->tool);
+  g_clear_pointer (&call->values, g_array_unref);
+  g_free (call);
+}
+
 static PropagateError *
 propagate_error_new (FoundryJsonrpcDriver *driver,
                      JsonNode             *id)
@@ -114,6 +141,40 @@ foundry_mcp_server_resource_changed (FoundryMcpServer   *self,
     }
 }
 
+static gboolean
+foundry_mcp_server_flush_resources_changed (gpointer data)
+{
+  FoundryMcpServer *self = data;
+
+  g_assert (FOUNDRY_IS_MCP_SERVER (self));
+
+  self->resources_changed_source = 0;
+
+  if (self->started && self->got_initialize)
+    dex_future_disown (foundry_jsonrpc_driver_notify (self->driver,
+                                                      "notifications/resources/list_changed",
+                                                      NULL));
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+foundry_mcp_server_flush_tools_changed (gpointer data)
+{
+  FoundryMcpServer *self = data;
+
+  g_assert (FOUNDRY_IS_MCP_SERVER (self));
+
+  self->tools_changed_source = 0;
+
+  if (self->started && self->got_initialize)
+    dex_future_disown (foundry_jsonrpc_driver_notify (self->driver,
+                                                      "notifications/tools/list_changed",
+                                                      NULL));
+
+  return G_SOURCE_REMOVE;
+}
+
 static void
 foundry_mcp_server_resources_changed (FoundryMcpServer *self,
                                       guint             position,
@@ -124,12 +185,165 @@ foundry_mcp_server_resources_changed (FoundryMcpServer *self,
   g_assert (FOUNDRY_IS_MCP_SERVER (self));
   g_assert (G_IS_LIST_MODEL (model));
 
-  if (!self->started || !self->got_initialize)
+  /* Plugin reloads change the model many times in a row, so only
+   * tell the peer once things have settled.
+   */
+  if (self->resources_changed_source == 0)
+    self->resources_changed_source =
+      g_idle_add_full (G_PRIORITY_LOW,
+                       foundry_mcp_server_flush_resources_changed,
+                       self, NULL);
+}
+
+static void
+foundry_mcp_server_tools_changed (FoundryMcpServer *self,
+                                  guint             position,
+                                  guint             removed,
+                                  guint             added,
+                                  GListModel       *model)
+{
+  g_autoptr(GPtrArray) orphaned = NULL;
+
+  g_assert (FOUNDRY_IS_MCP_SERVER (self));
+  g_assert (G_IS_LIST_MODEL (model));
+  g_assert (position + removed <= self->tools_mirror->len);
+
+  for (guint i = 0; i < removed; i++)
+    {
+      FoundryLlmTool *tool = g_ptr_array_index (self->tools_mirror, position + i);
+      g_autofree char *name = foundry_llm_tool_dup_name (tool);
+
+      if (name != NULL && g_hash_table_lookup (self->tools_by_name, name) == (gpointer)tool)
+        {
+          g_hash_table_remove (self->tools_by_name, name);
+
+          if (orphaned == NULL)
+            orphaned = g_ptr_array_new_with_free_func (g_free);
+          g_ptr_array_add (orphaned, g_steal_pointer (&name));
+        }
+    }
+
+  g_ptr_array_remove_range (self->tools_mirror, position, removed);
+
+  for (guint i = 0; i < added; i++)
+    {
+      FoundryLlmTool *tool = g_list_model_get_item (model, position + i);
+      g_autofree char *name = foundry_llm_tool_dup_name (tool);
+
+      g_ptr_array_insert (self->tools_mirror, position + i, tool);
+
+      if (name != NULL && !g_hash_table_contains (self->tools_by_name, name))
+        g_hash_table_insert (self->tools_by_name, g_steal_pointer (&name), tool);
+    }
+
+  /* A removed tool may have shadowed another with the same name */
+  if (orphaned != NULL)
+    {
+      for (guint i = 0; i < self->tools_mirror->len; i++)
+        {
+          FoundryLlmTool *tool = g_ptr_array_index (self->tools_mirror, i);
+          g_autofree char *name = foundry_llm_tool_dup_name (tool);
+          guint index;
+
+          if (name != NULL &&
+              !g_hash_table_contains (self->tools_by_name, name) &&
+              g_ptr_array_find_with_equal_func (orphaned, name, g_str_equal, &index))
+            g_hash_table_insert (self->tools_by_name, g_steal_pointer (&name), tool);
+        }
+    }
+
+  if (self->tools_changed_source == 0)
+    self->tools_changed_source =
+      g_idle_add_full (G_PRIORITY_LOW,
+                       foundry_mcp_server_flush_tools_changed,
+                       self, NULL);
+}
+
+void
+_foundry_mcp_server_set_tools (FoundryMcpServer *self,
+                               GListModel       *tools)
+{
+  guint n_items = 0;
+
+  g_return_if_fail (FOUNDRY_IS_MCP_SERVER (self));
+  g_return_if_fail (!tools || G_IS_LIST_MODEL (tools));
+
+  if (self->tools == tools)
     return;
 
-  dex_future_disown (foundry_jsonrpc_driver_notify (self->driver,
-                                                    "notifications/resources/list_changed",
-                                                    NULL));
+  if (self->tools != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (self->tools,
+                                            G_CALLBACK (foundry_mcp_server_tools_changed),
+                                            self);
+      foundry_mcp_server_tools_changed (self, 0, self->tools_mirror->len, 0, self->tools);
+      g_clear_object (&self->tools);
+    }
+
+  if (tools != NULL)
+    {
+      self->tools = g_object_ref (tools);
+      n_items = g_list_model_get_n_items (tools);
+
+      g_signal_connect_object (self->tools,
+                               "items-changed",
+                               G_CALLBACK (foundry_mcp_server_tools_changed),
+                               self,
+                               G_CONNECT_SWAPPED);
+
+      foundry_mcp_server_tools_changed (self, 0, 0, n_items, self->tools);
+    }
+}
+
+static DexFuture *
+foundry_mcp_server_call_tool_fiber (gpointer data)
+{
+  ToolCall *call = data;
+  g_autoptr(GError) error = NULL;
+  gpointer message;
+
+  g_assert (call != NULL);
+  g_assert (FOUNDRY_IS_LLM_TOOL (call->tool));
+
+  if (!(message = dex_await_object (foundry_llm_tool_call (call->tool,
+                                                           (const GValue *)(gpointer)call->values->data,
+                                                           call->values->len),
+                                    &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_take_object (message);
+}
+
+static DexFuture *
+foundry_mcp_server_call_tool (FoundryMcpServer *self,
+                              const char       *name,
+                              FoundryLlmTool   *tool,
+                              GArray           *values)
+{
+  DexLimiter *limiter;
+  ToolCall *call;
+
+  g_assert (FOUNDRY_IS_MCP_SERVER (self));
+  g_assert (name != NULL);
+  g_assert (FOUNDRY_IS_LLM_TOOL (tool));
+  g_assert (values != NULL);
+
+  if (!(limiter = g_hash_table_lookup (self->tool_limiters, name)))
+    {
+      limiter = dex_limiter_new (MAX_CALLS_PER_TOOL);
+      g_hash_table_replace (self->tool_limiters, g_strdup (name), limiter);
+    }
+
+  call = g_new0 (ToolCall, 1);
+  call->tool = g_object_ref (tool);
+  call->values = g_array_ref (values);
+
+  return dex_limiter_run (limiter,
+                          NULL,
+                          0,
+                          foundry_mcp_server_call_tool_fiber,
+                          call,
+                          (GDestroyNotify) tool_call_free);
 }
 
 static DexFuture *
@@ -160,6 +374,7 @@ foundry_mcp_server_handle_method_call_fiber (FoundryMcpServer     *self,
                                         "capabilities", "{",
                                           "tools", "{",
                                             "list", FOUNDRY_JSON_NODE_PUT_BOOLEAN (TRUE),
+                                            "listChanged", FOUNDRY_JSON_NODE_PUT_BOOLEAN (TRUE),
                                             "call", FOUNDRY_JSON_NODE_PUT_BOOLEAN (TRUE),
                                           "}",
                                           "resources", "{",
@@ -180,21 +395,18 @@ foundry_mcp_server_handle_method_call_fiber (FoundryMcpServer     *self,
     }
   else if (foundry_str_equal0 (method, "tools/list"))
     {
-      g_autoptr(GListModel) tools = NULL;
+      g_autoptr(GPtrArray) tools = NULL;
       g_autoptr(JsonArray) tools_ar = json_array_new ();
       g_autoptr(JsonNode) tools_node = json_node_new (JSON_NODE_ARRAY);
-      guint n_items;
 
-      if (!(tools = dex_await_object (foundry_llm_manager_list_tools (llm_manager), &error)))
-        return dex_future_new_for_error (g_steal_pointer (&error));
+      dex_await (dex_ref (self->loaded), NULL);
 
-      dex_await (foundry_list_model_await (tools), NULL);
-
-      n_items = g_list_model_get_n_items (tools);
+      tools = g_ptr_array_copy (self->tools_mirror, (GCopyFunc) g_object_ref, NULL);
+      g_ptr_array_set_free_func (tools, g_object_unref);
 
-      for (guint i = 0; i < n_items; i++)
+      for (guint i = 0; i < tools->len; i++)
         {
-          g_autoptr(FoundryLlmTool) tool = g_list_model_get_item (tools, i);
+          FoundryLlmTool *tool = g_ptr_array_index (tools, i);
           g_autofree char *name = foundry_llm_tool_dup_name (tool);
           g_autofree char *desc = foundry_llm_tool_dup_description (tool);
           g_autoptr(JsonNode) properties_node = json_node_new (JSON_NODE_OBJECT);
@@ -252,11 +464,10 @@ foundry_mcp_server_handle_method_call_fiber (FoundryMcpServer     *self,
     {
       const char *name = NULL;
       JsonNode *arguments = NULL;
-      g_autoptr(GListModel) tools = NULL;
       g_autoptr(FoundryLlmTool) tool = NULL;
       g_autoptr(FoundryLlmMessage) message = NULL;
       g_autofree char *content = NULL;
-      guint n_items;
+      FoundryLlmTool *found;
 
       if (!FOUNDRY_JSON_OBJECT_PARSE (params,
                                        "name", FOUNDRY_JSON_NODE_GET_STRING (&name),
@@ -265,33 +476,20 @@ foundry_mcp_server_handle_method_call_fiber (FoundryMcpServer     *self,
                                       G_IO_ERROR_INVALID_DATA,
                                       "Invalid params for tools/call");
 
-      if (!(tools = dex_await_object (foundry_llm_manager_list_tools (llm_manager), &error)))
-        return dex_future_new_for_error (g_steal_pointer (&error));
-
-      dex_await (foundry_list_model_await (tools), NULL);
-
-      n_items = g_list_model_get_n_items (tools);
-
-      for (guint i = 0; i < n_items; i++)
-        {
-          g_autoptr(FoundryLlmTool) candidate = g_list_model_get_item (tools, i);
-          g_autofree char *tool_name = foundry_llm_tool_dup_name (candidate);
+      dex_await (dex_ref (self->loaded), NULL);
 
-          if (g_strcmp0 (tool_name, name) == 0)
-            {
-              tool = g_steal_pointer (&candidate);
-              break;
-            }
-        }
-
-      if (tool == NULL)
+      if (!(found = g_hash_table_lookup (self->tools_by_name, name)))
         return dex_future_new_reject (G_IO_ERROR,
                                       G_IO_ERROR_NOT_FOUND,
                                       "No such tool `%s`", name);
 
+      tool = g_object_ref (found);
+
       {
         g_autofree GParamSpec **params_pspecs = NULL;
+        g_autoptr(DexCancellable) cancellable = NULL;
         g_autoptr(GArray) values = NULL;
+        g_autofree char *key = NULL;
         guint n_params;
         g_auto(GValue) src_value = G_VALUE_INIT;
         JsonObject *obj;
@@ -346,10 +544,26 @@ foundry_mcp_server_handle_method_call_fiber (FoundryMcpServer     *self,
               }
           }
 
-        if (!(message = dex_await_object (foundry_llm_tool_call (tool,
-                                                                 &g_array_index (values, GValue, 0),
-                                                                 values->len),
-                                          &error)))
+        /* Track the call so notifications/cancelled can abandon it. Dropping
+         * our reference to the call future propagates to the tool.
+         */
+        key = foundry_json_node_to_string (id, FALSE);
+        cancellable = dex_cancellable_new ();
+        g_hash_table_replace (self->in_flight, g_strdup (key), dex_ref (cancellable));
+
+        message = dex_await_object (dex_future_first (foundry_mcp_server_call_tool (self, name, tool, values),
+                                                      dex_ref (cancellable),
+                                                      NULL),
+                                    &error);
+
+        if (g_hash_table_lookup (self->in_flight, key) == (gpointer)cancellable)
+          g_hash_table_remove (self->in_flight, key);
+
+        /* Per the specification no response is sent for cancelled requests */
+        if (dex_future_is_rejected (DEX_FUTURE (cancellable)))
+          return dex_future_new_true ();
+
+        if (message == NULL)
           return dex_future_new_for_error (g_steal_pointer (&error));
       }
 
@@ -567,6 +781,31 @@ foundry_mcp_server_handle_method_call (FoundryMcpServer     *self,
   return TRUE;
 }
 
+static void
+foundry_mcp_server_handle_notification (FoundryMcpServer     *self,
+                                        const char           *method,
+                                        JsonNode             *params,
+                                        FoundryJsonrpcDriver *driver)
+{
+  g_autofree char *key = NULL;
+  DexCancellable *cancellable;
+  JsonNode *request_id = NULL;
+
+  g_assert (FOUNDRY_IS_MCP_SERVER (self));
+  g_assert (FOUNDRY_IS_JSONRPC_DRIVER (driver));
+  g_assert (method != NULL);
+
+  if (!foundry_str_equal0 (method, "notifications/cancelled") ||
+      params == NULL ||
+      !FOUNDRY_JSON_OBJECT_PARSE (params, "requestId", FOUNDRY_JSON_NODE_GET_NODE (&request_id)))
+    return;
+
+  key = foundry_json_node_to_string (request_id, FALSE);
+
+  if ((cancellable = g_hash_table_lookup (self->in_flight, key)))
+    dex_cancellable_cancel (cancellable);
+}
+
 static void
 foundry_mcp_server_subscribed_resource_destroy (gpointer data)
 {
@@ -589,6 +828,7 @@ foundry_mcp_server_load_resources_fiber (gpointer data)
   g_autoptr(FoundryLlmManager) llm_manager = NULL;
   g_autoptr(GError) error = NULL;
   g_autoptr(GListModel) resources = NULL;
+  g_autoptr(GListModel) tools = NULL;
 
   g_assert (FOUNDRY_IS_MCP_SERVER (self));
 
@@ -608,6 +848,22 @@ foundry_mcp_server_load_resources_fiber (gpointer data)
                                      "Failed to get LlmManager");
     }
 
+  /* Keep the tools model for the lifetime of the server so lookups
+   * by name do not need to rebuild and scan the model per call.
+   */
+  if ((tools = dex_await_object (foundry_llm_manager_list_tools (llm_manager), &error)))
+    {
+      dex_await (foundry_list_model_await (tools), NULL);
+
+      if (self->tools == NULL)
+        _foundry_mcp_server_set_tools (self, tools);
+    }
+  else
+    {
+      g_warning ("Failed to list tools: %s", error->message);
+      g_clear_error (&error);
+    }
+
   if (!(resources = dex_await_object (foundry_llm_manager_list_resources (llm_manager), &error)))
     {
       g_warning ("Failed to list resources: %s", error->message);
@@ -632,10 +888,10 @@ foundry_mcp_server_constructed (GObject *object)
 
   G_OBJECT_CLASS (foundry_mcp_server_parent_class)->constructed (object);
 
-  dex_future_disown (dex_scheduler_spawn (NULL, 0,
-                                          foundry_mcp_server_load_resources_fiber,
-                                          g_object_ref (self),
-                                          g_object_unref));
+  self->loaded = dex_scheduler_spawn (NULL, 0,
+                                      foundry_mcp_server_load_resources_fiber,
+                                      g_object_ref (self),
+                                      g_object_unref);
 }
 
 static void
@@ -643,9 +899,23 @@ foundry_mcp_server_dispose (GObject *object)
 {
   FoundryMcpServer *self = (FoundryMcpServer *)object;
 
+  g_clear_handle_id (&self->tools_changed_source, g_source_remove);
+  g_clear_handle_id (&self->resources_changed_source, g_source_remove);
+
+  if (self->tools != NULL)
+    g_signal_handlers_disconnect_by_func (self->tools,
+                                          G_CALLBACK (foundry_mcp_server_tools_changed),
+                                          self);
+
   g_clear_pointer (&self->subscribed_resources, g_hash_table_unref);
+  g_clear_pointer (&self->tools_by_name, g_hash_table_unref);
+  g_clear_pointer (&self->tools_mirror, g_ptr_array_unref);
+  g_clear_pointer (&self->tool_limiters, g_hash_table_unref);
+  g_clear_pointer (&self->in_flight, g_hash_table_unref);
+  g_clear_object (&self->tools);
   g_clear_object (&self->resources);
   g_clear_object (&self->driver);
+  dex_clear (&self->loaded);
 
   G_OBJECT_CLASS (foundry_mcp_server_parent_class)->dispose (object);
 }
@@ -666,6 +936,10 @@ foundry_mcp_server_init (FoundryMcpServer *self)
                                                        g_str_equal,
                                                        g_free,
                                                        foundry_mcp_server_subscribed_resource_destroy);
+  self->tools_mirror = g_ptr_array_new_with_free_func (g_object_unref);
+  self->tools_by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->tool_limiters = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, dex_unref);
+  self->in_flight = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, dex_unref);
 }
 
 FoundryMcpServer *
@@ -687,6 +961,11 @@ foundry_mcp_server_new (FoundryContext *context,
                            G_CALLBACK (foundry_mcp_server_handle_method_call),
                            self,
                            G_CONNECT_SWAPPED);
+  g_signal_connect_object (self->driver,
+                           "handle-notification",
+                           G_CALLBACK (foundry_mcp_server_handle_notification),
+                           self,
+                           G_CONNECT_SWAPPED);
 
   return self;
 }
@@ -714,5 +993,15 @@ foundry_mcp_server_stop (FoundryMcpServer *self)
 
   g_hash_table_remove_all (self->subscribed_resources);
 
+  /* Abandon anything still running, nobody is left to reply to */
+  {
+    GHashTableIter iter;
+    DexCancellable *cancellable;
+
+    g_hash_table_iter_init (&iter, self->in_flight);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&cancellable))
+      dex_cancellable_cancel (cancellable);
+  }
+
   foundry_jsonrpc_driver_stop (self->driver);
 }
@@ -37,7 +37,7 @@
 
 #include "foundry-debug.h"
 #include "foundry-path.h"
-#include "foundry-process-launcher.h"
+#include "foundry-process-launcher-private.h"
 #include "foundry-shell.h"
 #include "foundry-util-private.h"
 
@@ -72,6 +72,7 @@ struct _FoundryProcessLauncher
   FoundryProcessLauncherLayer root;
   guint                       ended : 1;
   guint                       setup_tty : 1;
+  guint                       process_group : 1;
 };
 
 G_DEFINE_FINAL_TYPE (FoundryProcessLauncher, foundry_process_launcher, G_TYPE_OBJECT)
@@ -1302,6 +1303,26 @@ setup_tty (gpointer data)
     }
 }
 
+static void
+setup_process_group (gpointer data)
+{
+  setpgid (0, 0);
+}
+
+/*
+ * Places the spawned process in a new process group so that it and
+ * any children it spawns may be signaled together with killpg().
+ * The process does not claim a controlling terminal in this case.
+ */
+void
+_foundry_process_launcher_set_process_group (FoundryProcessLauncher *self,
+                                             gboolean                process_group)
+{
+  g_return_if_fail (FOUNDRY_IS_PROCESS_LAUNCHER (self));
+
+  self->process_group = !!process_group;
+}
+
 /**
  * foundry_process_launcher_spawn:
  * @self: a #FoundryProcessLauncher
@@ -1450,7 +1471,9 @@ foundry_process_launcher_spawn_with_flags (FoundryProcessLauncher  *self,
 
   g_subprocess_launcher_set_flags (launcher, flags);
 
-  if (self->setup_tty)
+  if (self->process_group)
+    g_subprocess_launcher_set_child_setup (launcher, setup_process_group, NULL, NULL);
+  else if (self->setup_tty)
     g_subprocess_launcher_set_child_setup (launcher, setup_tty, NULL, NULL);
 
 #ifdef FOUNDRY_ENABLE_TRACE
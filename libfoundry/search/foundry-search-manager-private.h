@@ -0,0 +1,35 @@
+/* foundry-search-manager-private.h
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include "foundry-search-manager.h"
+
+G_BEGIN_DECLS
+
+GListModel *_foundry_search_manager_search_providers (GPtrArray            *providers,
+                                                      FoundrySearchRequest *request,
+                                                      DexCancellable       *cancellable,
+                                                      guint                 deadline_msec,
+                                                      gboolean              ranked);
+void        _foundry_search_manager_set_providers    (FoundrySearchManager *self,
+                                                      GPtrArray            *providers);
+
+G_END_DECLS
@@ -25,9 +25,10 @@
 #include "foundry-contextual-private.h"
 #include "foundry-debug.h"
 #include "foundry-model-manager.h"
-#include "foundry-search-manager.h"
+#include "foundry-search-manager-private.h"
 #include "foundry-search-provider-private.h"
 #include "foundry-search-request.h"
+#include "foundry-search-result.h"
 #include "foundry-service-private.h"
 #include "foundry-util-private.h"
 
@@ -37,12 +38,48 @@
  * Service that manages plugins providing search capabilities.
  */
 
+/* Providers that have not completed by then are left out of the results
+ * unless the caller requests a different deadline.
+ */
+#define SEARCH_PROVIDER_DEADLINE_MSEC 5000
+
+/* Providers order their own results, so only the best of each
+ * provider is considered when merging into a single ranking.
+ */
+#define MAX_RANKED_PER_PROVIDER 50
+
 struct _FoundrySearchManager
 {
   FoundryService    parent_instance;
   PeasExtensionSet *addins;
+  GPtrArray        *providers;
 };
 
+typedef struct _RankedEntry
+{
+  double score;
+  guint  slot;
+  guint  position;
+} RankedEntry;
+
+typedef struct _SearchState
+{
+  /* One GListModel per provider in priority order. Each starts as an
+   * empty placeholder which is replaced once the provider completes.
+   */
+  GListStore *store;
+
+  /* Merged results and their sort keys, only when ranking */
+  GListStore *ranked;
+  GArray     *ranked_entries;
+} SearchState;
+
+typedef struct _Publish
+{
+  SearchState *state;
+  guint        slot;
+} Publish;
+
 struct _FoundrySearchManagerClass
 {
   FoundryServiceClass parent_class;
@@ -228,6 +265,7 @@ foundry_search_manager_finalize (GObject *object)
   FoundrySearchManager *self = (FoundrySearchManager *)object;
 
   g_clear_object (&self->addins);
+  g_clear_pointer (&self->providers, g_ptr_array_unref);
 
   G_OBJECT_CLASS (foundry_search_manager_parent_class)->finalize (object);
 }
@@ -250,79 +288,393 @@ foundry_search_manager_init (FoundrySearchManager *self)
 {
 }
 
-static DexFuture *
-foundry_search_manager_search_fiber (FoundrySearchManager *self,
-                                     FoundrySearchRequest *request)
+static void
+search_state_finalize (gpointer data)
 {
-  g_autoptr(GPtrArray) futures = NULL;
-  g_autoptr(GPtrArray) providers = NULL;
-  g_autoptr(GListStore) store = NULL;
-  g_autoptr(GError) error = NULL;
-  guint n_items;
+  SearchState *state = data;
 
-  g_assert (FOUNDRY_IS_SEARCH_MANAGER (self));
-  g_assert (FOUNDRY_IS_SEARCH_REQUEST (request));
+  g_clear_object (&state->store);
+  g_clear_object (&state->ranked);
+  g_clear_pointer (&state->ranked_entries, g_array_unref);
+}
 
-  if (!dex_await (foundry_service_when_ready (FOUNDRY_SERVICE (self)), &error))
-    return dex_future_new_for_error (g_steal_pointer (&error));
+static SearchState *
+search_state_new (gboolean ranked)
+{
+  SearchState *state = g_atomic_rc_box_new0 (SearchState);
 
-  futures = g_ptr_array_new_with_free_func (dex_unref);
-  store = g_list_store_new (G_TYPE_LIST_MODEL);
-  n_items = g_list_model_get_n_items (G_LIST_MODEL (self->addins));
+  state->store = g_list_store_new (G_TYPE_LIST_MODEL);
+
+  if (ranked)
+    {
+      state->ranked = g_list_store_new (FOUNDRY_TYPE_SEARCH_RESULT);
+      state->ranked_entries = g_array_new (FALSE, FALSE, sizeof (RankedEntry));
+    }
+
+  return state;
+}
+
+static void
+search_state_unref (SearchState *state)
+{
+  g_atomic_rc_box_release_full (state, search_state_finalize);
+}
 
-  /* Collect providers into a GPtrArray */
-  providers = g_ptr_array_new_with_free_func (g_object_unref);
+static int
+ranked_entry_compare (const RankedEntry *a,
+                      const RankedEntry *b)
+{
+  if (a->score > b->score)
+    return -1;
+
+  if (a->score < b->score)
+    return 1;
+
+  /* Fall back to provider priority and then the provider's own order */
+  if (a->slot != b->slot)
+    return a->slot < b->slot ? -1 : 1;
+
+  if (a->position != b->position)
+    return a->position < b->position ? -1 : 1;
+
+  return 0;
+}
+
+static void
+search_state_rank (SearchState *state,
+                   guint        slot,
+                   GListModel  *model)
+{
+  g_autoptr(GPtrArray) results = NULL;
+  guint n_items;
+  double max_score = 0;
+
+  g_assert (state != NULL);
+  g_assert (state->ranked != NULL);
+  g_assert (G_IS_LIST_MODEL (model));
+
+  n_items = MIN (g_list_model_get_n_items (model), MAX_RANKED_PER_PROVIDER);
+  results = g_ptr_array_new_with_free_func (g_object_unref);
 
   for (guint i = 0; i < n_items; i++)
     {
-      FoundrySearchProvider *provider = g_list_model_get_item (G_LIST_MODEL (self->addins), i);
+      g_autoptr(GObject) item = g_list_model_get_item (model, i);
+
+      if (FOUNDRY_IS_SEARCH_RESULT (item))
+        {
+          max_score = MAX (max_score, foundry_search_result_get_score (FOUNDRY_SEARCH_RESULT (item)));
+          g_ptr_array_add (results, g_steal_pointer (&item));
+        }
+    }
+
+  for (guint i = 0; i < results->len; i++)
+    {
+      FoundrySearchResult *result = g_ptr_array_index (results, i);
+      RankedEntry entry;
+      guint lo = 0;
+      guint hi = state->ranked_entries->len;
+
+      /* Normalize against the provider's best result so that providers
+       * using different scales can be compared. Unscored providers are
+       * ranked by their own ordering instead.
+       */
+      if (max_score > 0)
+        entry.score = foundry_search_result_get_score (result) / max_score;
+      else
+        entry.score = (double)(results->len - i) / results->len;
+
+      entry.slot = slot;
+      entry.position = i;
+
+      while (lo < hi)
+        {
+          guint mid = lo + (hi - lo) / 2;
+
+          if (ranked_entry_compare (&g_array_index (state->ranked_entries, RankedEntry, mid), &entry) < 0)
+            lo = mid + 1;
+          else
+            hi = mid;
+        }
 
-      g_ptr_array_add (providers, provider);
+      g_array_insert_val (state->ranked_entries, lo, entry);
+      g_list_store_insert (state->ranked, lo, result);
     }
+}
+
+static void
+publish_free (gpointer data)
+{
+  Publish *publish = data;
+
+  g_clear_pointer (&publish->state, search_state_unref);
+  g_free (publish);
+}
+
+static DexFuture *
+foundry_search_manager_publish (DexFuture *completed,
+                                gpointer   user_data)
+{
+  Publish *publish = user_data;
+  g_autoptr(GListModel) model = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (publish != NULL);
+  g_assert (publish->state != NULL);
+
+  if (!(model = dex_await_object (dex_ref (completed), &error)))
+    {
+      g_debug ("Search provider %u did not complete: %s",
+               publish->slot, error->message);
+      return dex_future_new_true ();
+    }
+
+  g_list_store_splice (publish->state->store, publish->slot, 1, (gpointer *)&model, 1);
+
+  if (publish->state->ranked != NULL)
+    search_state_rank (publish->state, publish->slot, model);
+
+  return dex_future_new_true ();
+}
 
-  /* Sort providers by priority */
-  g_ptr_array_sort (providers, foundry_search_manager_sort_providers);
+/*
+ * _foundry_search_manager_search_providers:
+ * @providers: a #GPtrArray of #FoundrySearchProvider in priority order
+ * @request: the search request
+ * @cancellable: (nullable): a #DexCancellable to stop waiting on providers
+ * @deadline_msec: how long to wait on each provider, or 0 for no limit
+ * @ranked: if the results should be merged and ranked by score
+ *
+ * Dispatches @request to every provider and returns a model which is
+ * populated as each provider completes.
+ *
+ * Unless @ranked is set, results are grouped by provider in the order of
+ * @providers regardless of which provider completes first.
+ *
+ * Use foundry_list_model_await() on the result to wait for every
+ * provider to complete, reach the deadline, or be cancelled.
+ *
+ * Returns: (transfer full): a #GListModel of #FoundrySearchResult
+ */
+GListModel *
+_foundry_search_manager_search_providers (GPtrArray            *providers,
+                                          FoundrySearchRequest *request,
+                                          DexCancellable       *cancellable,
+                                          guint                 deadline_msec,
+                                          gboolean              ranked)
+{
+  g_autoptr(GPtrArray) futures = NULL;
+  g_autoptr(GListModel) ret = NULL;
+  SearchState *state;
+
+  g_return_val_if_fail (FOUNDRY_IS_MAIN_THREAD (), NULL);
+  g_return_val_if_fail (providers != NULL, NULL);
+  g_return_val_if_fail (FOUNDRY_IS_SEARCH_REQUEST (request), NULL);
+  g_return_val_if_fail (!cancellable || DEX_IS_CANCELLABLE (cancellable), NULL);
+
+  state = search_state_new (ranked);
+  futures = g_ptr_array_new_with_free_func (dex_unref);
 
-  /* Iterate through sorted providers */
   for (guint i = 0; i < providers->len; i++)
     {
       FoundrySearchProvider *provider = g_ptr_array_index (providers, i);
+      g_autoptr(GListStore) placeholder = g_list_store_new (FOUNDRY_TYPE_SEARCH_RESULT);
+      DexFuture *future;
+      Publish *publish;
 
-      g_ptr_array_add (futures, foundry_search_provider_search (provider, request));
+      g_list_store_append (state->store, placeholder);
+
+      future = foundry_search_provider_search (provider, request);
+
+      if (deadline_msec > 0)
+        future = dex_future_first (future, dex_timeout_new_msec (deadline_msec), NULL);
+
+      if (cancellable != NULL)
+        future = dex_future_first (future, dex_ref (cancellable), NULL);
+
+      publish = g_new0 (Publish, 1);
+      publish->state = g_atomic_rc_box_acquire (state);
+      publish->slot = i;
+
+      g_ptr_array_add (futures,
+                       dex_future_finally (future,
+                                           foundry_search_manager_publish,
+                                           publish,
+                                           publish_free));
     }
 
+  if (ranked)
+    ret = g_object_ref (G_LIST_MODEL (state->ranked));
+  else
+    ret = foundry_flatten_list_model_new (g_object_ref (G_LIST_MODEL (state->store)));
+
   if (futures->len > 0)
-    dex_await (foundry_future_all (futures), NULL);
+    {
+      g_autoptr(DexFuture) future = foundry_future_all (futures);
+
+      foundry_list_model_set_future (ret, future);
+    }
 
-  for (guint i = 0; i < futures->len; i++)
+  search_state_unref (state);
+
+  return g_steal_pointer (&ret);
+}
+
+static DexFuture *
+foundry_search_manager_search_fiber (FoundrySearchManager *self,
+                                     FoundrySearchRequest *request,
+                                     DexCancellable       *cancellable,
+                                     guint                 deadline_msec,
+                                     gboolean              ranked)
+{
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_assert (FOUNDRY_IS_SEARCH_MANAGER (self));
+  g_assert (FOUNDRY_IS_SEARCH_REQUEST (request));
+  g_assert (!cancellable || DEX_IS_CANCELLABLE (cancellable));
+
+  if (!dex_await (foundry_service_when_ready (FOUNDRY_SERVICE (self)), &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  if (self->providers != NULL)
     {
-      DexFuture *future = g_ptr_array_index (futures, i);
-      g_autoptr(GListModel) model = dex_await_object (dex_ref (future), NULL);
+      providers = g_ptr_array_ref (self->providers);
+    }
+  else
+    {
+      guint n_items = g_list_model_get_n_items (G_LIST_MODEL (self->addins));
+
+      /* Collect providers into a GPtrArray */
+      providers = g_ptr_array_new_with_free_func (g_object_unref);
+
+      for (guint i = 0; i < n_items; i++)
+        {
+          FoundrySearchProvider *provider = g_list_model_get_item (G_LIST_MODEL (self->addins), i);
 
-      if (model != NULL)
-        g_list_store_append (store, model);
+          g_ptr_array_add (providers, provider);
+        }
+
+      /* Sort providers by priority */
+      g_ptr_array_sort (providers, foundry_search_manager_sort_providers);
     }
 
-  return dex_future_new_take_object (foundry_flatten_list_model_new (G_LIST_MODEL (g_steal_pointer (&store))));
+  return dex_future_new_take_object (_foundry_search_manager_search_providers (providers,
+                                                                               request,
+                                                                               cancellable,
+                                                                               deadline_msec,
+                                                                               ranked));
+}
+
+/*
+ * _foundry_search_manager_set_providers:
+ * @self: a #FoundrySearchManager
+ * @providers: (nullable): a #GPtrArray of #FoundrySearchProvider in
+ *   priority order, or %NULL to use the providers from plugins
+ *
+ * Overrides the providers used for searches. This is used by the
+ * testsuite to search through the manager with known providers.
+ */
+void
+_foundry_search_manager_set_providers (FoundrySearchManager *self,
+                                       GPtrArray            *providers)
+{
+  g_return_if_fail (FOUNDRY_IS_SEARCH_MANAGER (self));
+
+  if (providers != NULL)
+    g_ptr_array_ref (providers);
+
+  g_clear_pointer (&self->providers, g_ptr_array_unref);
+  self->providers = providers;
 }
 
 /**
  * foundry_search_manager_search:
  * @self: a [class@Foundry.SearchManager]
  *
+ * Searches all of the providers for @request.
+ *
+ * The resulting list model is populated as each provider completes,
+ * grouped by provider priority. Use [func@Foundry.list_model_await]
+ * to wait until all providers have completed.
+ *
+ * Providers which take longer than a few seconds are left out of the
+ * results. Use [method@Foundry.SearchManager.search_full] to change
+ * the deadline or to cancel the search.
+ *
  * Returns: (transfer full): a [class@Dex.Future] that resolves to a
  *   [iface@Gio.ListModel] of [class@Foundry.SearchResult].
  */
 DexFuture *
 foundry_search_manager_search (FoundrySearchManager *self,
                                FoundrySearchRequest *request)
+{
+  return foundry_search_manager_search_full (self, request, NULL, SEARCH_PROVIDER_DEADLINE_MSEC, FALSE);
+}
+
+/**
+ * foundry_search_manager_search_ranked:
+ * @self: a [class@Foundry.SearchManager]
+ *
+ * Like [method@Foundry.SearchManager.search] but results from all
+ * providers are merged into a single list ordered by
+ * [method@Foundry.SearchResult.get_score].
+ *
+ * Scores are normalized against the best result of each provider.
+ * Only the leading results of each provider are included.
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to a
+ *   [iface@Gio.ListModel] of [class@Foundry.SearchResult].
+ *
+ * Since: 1.2
+ */
+DexFuture *
+foundry_search_manager_search_ranked (FoundrySearchManager *self,
+                                      FoundrySearchRequest *request)
+{
+  return foundry_search_manager_search_full (self, request, NULL, SEARCH_PROVIDER_DEADLINE_MSEC, TRUE);
+}
+
+/**
+ * foundry_search_manager_search_full:
+ * @self: a [class@Foundry.SearchManager]
+ * @request: a [class@Foundry.SearchRequest]
+ * @cancellable: (nullable): a [class@Dex.Cancellable]
+ * @deadline_msec: how long to wait on each provider, or 0 for no limit
+ * @ranked: if results should be merged and ordered by score
+ *
+ * Like [method@Foundry.SearchManager.search] but with control over
+ * how long providers are waited on.
+ *
+ * Cancelling @cancellable stops waiting on providers which have not
+ * yet completed. Interactive callers may use this to supersede their
+ * previous search when the search text changes. Searches started by
+ * other callers are not affected.
+ *
+ * If @ranked is set, results are merged as described in
+ * [method@Foundry.SearchManager.search_ranked].
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves to a
+ *   [iface@Gio.ListModel] of [class@Foundry.SearchResult].
+ *
+ * Since: 1.2
+ */
+DexFuture *
+foundry_search_manager_search_full (FoundrySearchManager *self,
+                                    FoundrySearchRequest *request,
+                                    DexCancellable       *cancellable,
+                                    guint                 deadline_msec,
+                                    gboolean              ranked)
 {
   dex_return_error_if_fail (FOUNDRY_IS_SEARCH_MANAGER (self));
   dex_return_error_if_fail (FOUNDRY_IS_SEARCH_REQUEST (request));
+  dex_return_error_if_fail (!cancellable || DEX_IS_CANCELLABLE (cancellable));
 
   return FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
                                   foundry_search_manager_search_fiber,
-                                  2,
+                                  5,
                                   FOUNDRY_TYPE_SEARCH_MANAGER, self,
-                                  FOUNDRY_TYPE_SEARCH_REQUEST, request);
+                                  FOUNDRY_TYPE_SEARCH_REQUEST, request,
+                                  DEX_TYPE_FUTURE, cancellable,
+                                  G_TYPE_UINT, deadline_msec,
+                                  G_TYPE_BOOLEAN, !!ranked);
 }
@@ -32,7 +32,16 @@ FOUNDRY_AVAILABLE_IN_ALL
 FOUNDRY_DECLARE_INTERNAL_TYPE (FoundrySearchManager, foundry_search_manager, FOUNDRY, SEARCH_MANAGER, FoundryService)
 
 FOUNDRY_AVAILABLE_IN_ALL
-DexFuture *foundry_search_manager_search (FoundrySearchManager *self,
-                                          FoundrySearchRequest *request) G_GNUC_WARN_UNUSED_RESULT;
+DexFuture *foundry_search_manager_search        (FoundrySearchManager *self,
+                                                 FoundrySearchRequest *request) G_GNUC_WARN_UNUSED_RESULT;
+FOUNDRY_AVAILABLE_IN_1_2
+DexFuture *foundry_search_manager_search_ranked (FoundrySearchManager *self,
+                                                 FoundrySearchRequest *request) G_GNUC_WARN_UNUSED_RESULT;
+FOUNDRY_AVAILABLE_IN_1_2
+DexFuture *foundry_search_manager_search_full   (FoundrySearchManager *self,
+                                                 FoundrySearchRequest *request,
+                                                 DexCancellable       *cancellable,
+                                                 guint                 deadline_msec,
+                                                 gboolean              ranked) G_GNUC_WARN_UNUSED_RESULT;
 
 G_END_DECLS
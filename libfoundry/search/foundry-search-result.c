@@ -39,6 +39,7 @@ G_DEFINE_ABSTRACT_TYPE (FoundrySearchResult, foundry_search_result, G_TYPE_OBJEC
 enum {
   PROP_0,
   PROP_ICON,
+  PROP_SCORE,
   PROP_SUBTITLE,
   PROP_TITLE,
   PROP_USE_UNDERLINE,
@@ -61,6 +62,10 @@ foundry_search_result_get_property (GObject    *object,
       g_value_take_object (value, foundry_search_result_dup_icon (self));
       break;
 
+    case PROP_SCORE:
+      g_value_set_double (value, foundry_search_result_get_score (self));
+      break;
+
     case PROP_SUBTITLE:
       g_value_take_string (value, foundry_search_result_dup_subtitle (self));
       break;
@@ -92,6 +97,17 @@ foundry_search_result_class_init (FoundrySearchResultClass *klass)
                          (G_PARAM_READABLE |
                           G_PARAM_STATIC_STRINGS));
 
+  /**
+   * FoundrySearchResult:score:
+   *
+   * Since: 1.2
+   */
+  properties[PROP_SCORE] =
+    g_param_spec_double ("score", NULL, NULL,
+                         0, G_MAXDOUBLE, 0,
+                         (G_PARAM_READABLE |
+                          G_PARAM_STATIC_STRINGS));
+
   properties[PROP_SUBTITLE] =
     g_param_spec_string ("subtitle", NULL, NULL,
                          NULL,
@@ -233,3 +249,29 @@ foundry_search_result_get_use_underline (FoundrySearchResult *self)
 
   return FALSE;
 }
+
+/**
+ * foundry_search_result_get_score:
+ * @self: a [class@Foundry.SearchResult]
+ *
+ * Gets the relevance of the result where larger values are more
+ * relevant.
+ *
+ * Scores only need to be comparable with other results from the same
+ * provider. They are normalized against the best result of the provider
+ * when results from multiple providers are merged.
+ *
+ * Returns: the score, or 0 if the result is not scored
+ *
+ * Since: 1.2
+ */
+double
+foundry_search_result_get_score (FoundrySearchResult *self)
+{
+  g_return_val_if_fail (FOUNDRY_IS_SEARCH_RESULT (self), 0);
+
+  if (FOUNDRY_SEARCH_RESULT_GET_CLASS (self)->get_score)
+    return FOUNDRY_SEARCH_RESULT_GET_CLASS (self)->get_score (self);
+
+  return 0;
+}
@@ -43,9 +43,10 @@ struct _FoundrySearchResultClass
   FoundryIntent *(*create_intent)     (FoundrySearchResult *self,
                                        FoundryContext      *context);
   gboolean       (*get_use_underline) (FoundrySearchResult *self);
+  double         (*get_score)         (FoundrySearchResult *self);
 
   /*< private >*/
-  gpointer _reserved[9];
+  gpointer _reserved[8];
 };
 
 FOUNDRY_AVAILABLE_IN_ALL
@@ -61,5 +62,7 @@ FoundryIntent *foundry_search_result_create_intent     (FoundrySearchResult *sel
                                                         FoundryContext      *context);
 FOUNDRY_AVAILABLE_IN_1_1
 gboolean       foundry_search_result_get_use_underline (FoundrySearchResult *self);
+FOUNDRY_AVAILABLE_IN_1_2
+double         foundry_search_result_get_score         (FoundrySearchResult *self);
 
 G_END_DECLS
@@ -0,0 +1,120 @@
+/*
+ * foundry-metrics-private.h
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <time.h>
+
+#include <json-glib/json-glib.h>
+
+G_BEGIN_DECLS
+
+typedef enum _FoundryMetricKind
+{
+  FOUNDRY_METRIC_COUNTER,
+  FOUNDRY_METRIC_HISTOGRAM,
+} FoundryMetricKind;
+
+typedef struct _FoundryMetricsScope
+{
+  guint  id;
+  gint64 begin;
+} FoundryMetricsScope;
+
+guint     _foundry_metrics_register (const char        *name,
+                                     FoundryMetricKind  kind);
+guint     _foundry_metrics_register_for_type
+                                    (const char        *prefix,
+                                     GType              type,
+                                     FoundryMetricKind  kind);
+void      _foundry_metrics_add      (guint              id,
+                                     gint64             value);
+void      _foundry_metrics_record   (guint              id,
+                                     gint64             nsec);
+JsonNode *_foundry_metrics_dump     (void);
+void      _foundry_metrics_reset    (void);
+
+static inline gint64
+_foundry_metrics_now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (ts.tv_sec * G_GINT64_CONSTANT (1000000000)) + ts.tv_nsec;
+}
+
+/* Call sites cache the metric id in a static so that recording never
+ * touches the registry lock after the first sample.
+ */
+static inline guint
+_foundry_metrics_ensure (guint             *id,
+                         const char        *name,
+                         FoundryMetricKind  kind)
+{
+  guint value = (guint)g_atomic_int_get ((int *)id);
+
+  if G_UNLIKELY (value == 0)
+    {
+      value = _foundry_metrics_register (name, kind);
+      g_atomic_int_set ((int *)id, (int)value);
+    }
+
+  return value;
+}
+
+static inline void
+_foundry_metrics_scope_clear (FoundryMetricsScope *scope)
+{
+  if (scope->id != 0)
+    _foundry_metrics_record (scope->id, _foundry_metrics_now () - scope->begin);
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (FoundryMetricsScope, _foundry_metrics_scope_clear)
+
+#define FOUNDRY_METRICS_ADD(name, value) \
+  G_STMT_START { \
+    static guint __foundry_metric_id; \
+    _foundry_metrics_add (_foundry_metrics_ensure (&__foundry_metric_id, (name), \
+                                                   FOUNDRY_METRIC_COUNTER), \
+                          (value)); \
+  } G_STMT_END
+
+#define FOUNDRY_METRICS_RECORD(name, nsec) \
+  G_STMT_START { \
+    static guint __foundry_metric_id; \
+    _foundry_metrics_record (_foundry_metrics_ensure (&__foundry_metric_id, (name), \
+                                                      FOUNDRY_METRIC_HISTOGRAM), \
+                             (nsec)); \
+  } G_STMT_END
+
+#define FOUNDRY_METRICS_SCOPE(name) \
+  _Pragma ("GCC diagnostic push") \
+  _Pragma ("GCC diagnostic ignored \"-Wdeclaration-after-statement\"") \
+  static guint G_PASTE (__foundry_metric_id_, __LINE__); \
+  g_auto(FoundryMetricsScope) G_PASTE (__foundry_metrics_scope_, __LINE__) = { \
+    _foundry_metrics_ensure (&G_PASTE (__foundry_metric_id_, __LINE__), (name), \
+                             FOUNDRY_METRIC_HISTOGRAM), \
+    _foundry_metrics_now (), \
+  }; \
+  _Pragma ("GCC diagnostic pop")
+
+G_END_DECLS
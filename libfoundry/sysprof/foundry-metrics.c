@@ -0,0 +1,453 @@
+/*
+ * foundry-metrics.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "foundry-metrics-private.h"
+
+/* Metrics are always recorded, whether or not a profiler is attached.
+ *
+ * Every thread that records a sample gets its own shard of counters
+ * and histograms. Only the owning thread ever writes to a shard, so
+ * updates are plain relaxed loads and stores without a bus lock. The
+ * reader sums across all shards when a dump is requested and may
+ * observe a sample that is only partially applied (e.g. the count but
+ * not yet the sum), which is fine for reporting purposes.
+ *
+ * Shards are never freed. When a thread exits its shard is returned to
+ * a free list and picked up by the next thread so the accumulated
+ * values are preserved and the number of shards stays bounded by the
+ * peak number of recording threads.
+ *
+ * Histograms are log-linear in the style of HdrHistogram: values below
+ * 16 get an exact bucket and every power of two above that is split
+ * into 16 linear sub-buckets, giving a relative error below 7% over the
+ * entire gint64 range in under 8 KiB per metric per thread.
+ */
+
+#define MAX_METRICS     512
+#define SUB_BUCKET_BITS 4
+#define N_SUB_BUCKETS   (1 << SUB_BUCKET_BITS)
+#define N_BUCKETS       ((64 - SUB_BUCKET_BITS + 1) * N_SUB_BUCKETS)
+
+#define LOAD(p)     __atomic_load_n ((p), __ATOMIC_RELAXED)
+#define STORE(p, v) __atomic_store_n ((p), (v), __ATOMIC_RELAXED)
+
+typedef struct _Histogram
+{
+  gint64 count;
+  gint64 sum;
+  gint64 min;
+  gint64 max;
+  gint64 buckets[N_BUCKETS];
+} Histogram;
+
+typedef struct _Shard
+{
+  struct _Shard *next;
+  struct _Shard *next_free;
+  gint64         counters[MAX_METRICS];
+  Histogram     *histograms[MAX_METRICS];
+} Shard;
+
+typedef struct _Metric
+{
+  char              *name;
+  FoundryMetricKind  kind;
+} Metric;
+
+static void foundry_metrics_release_shard (gpointer data);
+
+static GMutex      registry_mutex;
+static GHashTable *metrics_by_name;
+static Metric      metrics[MAX_METRICS];
+static guint       n_metrics = 1;
+static Shard      *shards;
+static Shard      *free_shards;
+static GPrivate    current_shard = G_PRIVATE_INIT (foundry_metrics_release_shard);
+
+static void
+foundry_metrics_release_shard (gpointer data)
+{
+  Shard *shard = data;
+
+  g_mutex_lock (&registry_mutex);
+  shard->next_free = free_shards;
+  free_shards = shard;
+  g_mutex_unlock (&registry_mutex);
+}
+
+static Shard *
+foundry_metrics_get_shard (void)
+{
+  Shard *shard;
+
+  if G_LIKELY ((shard = g_private_get (&current_shard)))
+    return shard;
+
+  g_mutex_lock (&registry_mutex);
+
+  if ((shard = free_shards))
+    {
+      free_shards = shard->next_free;
+      shard->next_free = NULL;
+    }
+  else
+    {
+      shard = g_new0 (Shard, 1);
+
+      /* Publish fully initialized so the reader can walk without
+       * racing against a half-constructed shard.
+       */
+      shard->next = shards;
+      __atomic_store_n (&shards, shard, __ATOMIC_RELEASE);
+    }
+
+  g_mutex_unlock (&registry_mutex);
+
+  g_private_set (&current_shard, shard);
+
+  return shard;
+}
+
+static inline guint
+get_bucket (gint64 value)
+{
+  guint64 v = MAX (value, 0);
+  guint msb;
+
+  if (v < N_SUB_BUCKETS)
+    return v;
+
+  msb = 63 - __builtin_clzll (v);
+
+  return ((msb - SUB_BUCKET_BITS + 1) * N_SUB_BUCKETS) +
+         ((v >> (msb - SUB_BUCKET_BITS)) & (N_SUB_BUCKETS - 1));
+}
+
+static inline gint64
+get_bucket_upper (guint bucket)
+{
+  guint64 upper;
+  guint msb;
+  guint sub;
+
+  if (bucket < N_SUB_BUCKETS)
+    return bucket;
+
+  msb = bucket / N_SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  sub = bucket % N_SUB_BUCKETS;
+  upper = (((guint64)N_SUB_BUCKETS + sub + 1) << (msb - SUB_BUCKET_BITS)) - 1;
+
+  return (gint64)MIN (upper, (guint64)G_MAXINT64);
+}
+
+guint
+_foundry_metrics_register (const char        *name,
+                           FoundryMetricKind  kind)
+{
+  gpointer value;
+  guint id = 0;
+
+  g_return_val_if_fail (name != NULL, 0);
+
+  g_mutex_lock (&registry_mutex);
+
+  if (metrics_by_name == NULL)
+    metrics_by_name = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (g_hash_table_lookup_extended (metrics_by_name, name, NULL, &value))
+    {
+      id = GPOINTER_TO_UINT (value);
+
+      if (metrics[id].kind != kind)
+        {
+          g_critical ("Metric “%s” registered with conflicting kinds", name);
+          id = 0;
+        }
+    }
+  else if (n_metrics < MAX_METRICS)
+    {
+      id = n_metrics;
+      metrics[id].name = g_strdup (name);
+      metrics[id].kind = kind;
+      g_hash_table_insert (metrics_by_name, metrics[id].name, GUINT_TO_POINTER (id));
+      n_metrics++;
+    }
+  else
+    {
+      static gboolean warned;
+
+      if (!warned)
+        g_warning ("Too many metrics registered, ignoring “%s”", name);
+      warned = TRUE;
+    }
+
+  g_mutex_unlock (&registry_mutex);
+
+  return id;
+}
+
+/* Registers "@prefix.TypeName" and caches the id as qdata on @type so
+ * that per-type metrics only pay for the lookup once per type. @prefix
+ * must be a static string.
+ */
+guint
+_foundry_metrics_register_for_type (const char        *prefix,
+                                    GType              type,
+                                    FoundryMetricKind  kind)
+{
+  g_autofree char *name = NULL;
+  GQuark quark;
+  guint id;
+
+  g_return_val_if_fail (prefix != NULL, 0);
+
+  quark = g_quark_from_static_string (prefix);
+
+  if G_LIKELY ((id = GPOINTER_TO_UINT (g_type_get_qdata (type, quark))))
+    return id;
+
+  name = g_strconcat (prefix, ".", g_type_name (type), NULL);
+
+  /* Racing threads get the same id back from the registry */
+  if ((id = _foundry_metrics_register (name, kind)))
+    g_type_set_qdata (type, quark, GUINT_TO_POINTER (id));
+
+  return id;
+}
+
+void
+_foundry_metrics_add (guint  id,
+                      gint64 value)
+{
+  Shard *shard;
+
+  if G_UNLIKELY (id == 0 || id >= MAX_METRICS)
+    return;
+
+  shard = foundry_metrics_get_shard ();
+
+  STORE (&shard->counters[id], LOAD (&shard->counters[id]) + value);
+}
+
+void
+_foundry_metrics_record (guint  id,
+                         gint64 nsec)
+{
+  Histogram *histogram;
+  Shard *shard;
+  guint bucket;
+
+  if G_UNLIKELY (id == 0 || id >= MAX_METRICS)
+    return;
+
+  shard = foundry_metrics_get_shard ();
+
+  if G_UNLIKELY (!(histogram = shard->histograms[id]))
+    {
+      histogram = g_new0 (Histogram, 1);
+      histogram->min = G_MAXINT64;
+      __atomic_store_n (&shard->histograms[id], histogram, __ATOMIC_RELEASE);
+    }
+
+  nsec = MAX (nsec, 0);
+  bucket = get_bucket (nsec);
+
+  STORE (&histogram->buckets[bucket], LOAD (&histogram->buckets[bucket]) + 1);
+  STORE (&histogram->sum, LOAD (&histogram->sum) + nsec);
+
+  if (nsec < LOAD (&histogram->min))
+    STORE (&histogram->min, nsec);
+
+  if (nsec > LOAD (&histogram->max))
+    STORE (&histogram->max, nsec);
+
+  /* Count last so the reader rarely sees more samples than buckets */
+  STORE (&histogram->count, LOAD (&histogram->count) + 1);
+}
+
+static gint64
+get_percentile (const gint64 *buckets,
+                gint64        count,
+                gint64        min,
+                gint64        max,
+                double        percentile)
+{
+  gint64 target = MAX (1, (gint64)(count * percentile + .5));
+  gint64 seen = 0;
+
+  for (guint i = 0; i < N_BUCKETS; i++)
+    {
+      seen += buckets[i];
+
+      if (seen >= target)
+        return CLAMP (get_bucket_upper (i), min, max);
+    }
+
+  return max;
+}
+
+static void
+add_histogram (JsonBuilder *builder,
+               guint        id)
+{
+  g_autofree gint64 *buckets = g_new0 (gint64, N_BUCKETS);
+  gint64 count = 0;
+  gint64 sum = 0;
+  gint64 min = G_MAXINT64;
+  gint64 max = 0;
+
+  for (Shard *shard = __atomic_load_n (&shards, __ATOMIC_ACQUIRE); shard; shard = shard->next)
+    {
+      Histogram *histogram = __atomic_load_n (&shard->histograms[id], __ATOMIC_ACQUIRE);
+
+      if (histogram == NULL)
+        continue;
+
+      count += LOAD (&histogram->count);
+      sum += LOAD (&histogram->sum);
+      min = MIN (min, LOAD (&histogram->min));
+      max = MAX (max, LOAD (&histogram->max));
+
+      for (guint i = 0; i < N_BUCKETS; i++)
+        buckets[i] += LOAD (&histogram->buckets[i]);
+    }
+
+  json_builder_set_member_name (builder, "count");
+  json_builder_add_int_value (builder, count);
+
+  if (count == 0)
+    return;
+
+  json_builder_set_member_name (builder, "sum");
+  json_builder_add_int_value (builder, sum);
+  json_builder_set_member_name (builder, "min");
+  json_builder_add_int_value (builder, min);
+  json_builder_set_member_name (builder, "mean");
+  json_builder_add_int_value (builder, sum / count);
+  json_builder_set_member_name (builder, "p50");
+  json_builder_add_int_value (builder, get_percentile (buckets, count, min, max, .50));
+  json_builder_set_member_name (builder, "p90");
+  json_builder_add_int_value (builder, get_percentile (buckets, count, min, max, .90));
+  json_builder_set_member_name (builder, "p99");
+  json_builder_add_int_value (builder, get_percentile (buckets, count, min, max, .99));
+  json_builder_set_member_name (builder, "max");
+  json_builder_add_int_value (builder, max);
+}
+
+/**
+ * _foundry_metrics_dump:
+ *
+ * Collects a snapshot of every registered metric.
+ *
+ * The result is an array of objects sorted by name containing the
+ * "name" and "kind" of the metric. Counters have a "value" member and
+ * histograms have "count", "sum", "min", "mean", "p50", "p90", "p99"
+ * and "max" members in nanoseconds.
+ *
+ * Returns: (transfer full): a #JsonNode
+ */
+JsonNode *
+_foundry_metrics_dump (void)
+{
+  g_autoptr(JsonBuilder) builder = json_builder_new ();
+  g_autoptr(GPtrArray) names = g_ptr_array_new ();
+
+  g_mutex_lock (&registry_mutex);
+
+  for (guint id = 1; id < n_metrics; id++)
+    g_ptr_array_add (names, metrics[id].name);
+
+  g_ptr_array_sort_values (names, (GCompareFunc)strcmp);
+
+  json_builder_begin_array (builder);
+
+  for (guint i = 0; i < names->len; i++)
+    {
+      const char *name = g_ptr_array_index (names, i);
+      guint id = GPOINTER_TO_UINT (g_hash_table_lookup (metrics_by_name, name));
+
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "name");
+      json_builder_add_string_value (builder, name);
+      json_builder_set_member_name (builder, "kind");
+
+      if (metrics[id].kind == FOUNDRY_METRIC_COUNTER)
+        {
+          gint64 value = 0;
+
+          for (Shard *shard = shards; shard; shard = shard->next)
+            value += LOAD (&shard->counters[id]);
+
+          json_builder_add_string_value (builder, "counter");
+          json_builder_set_member_name (builder, "value");
+          json_builder_add_int_value (builder, value);
+        }
+      else
+        {
+          json_builder_add_string_value (builder, "histogram");
+          add_histogram (builder, id);
+        }
+
+      json_builder_end_object (builder);
+    }
+
+  json_builder_end_array (builder);
+
+  g_mutex_unlock (&registry_mutex);
+
+  return json_builder_get_root (builder);
+}
+
+/**
+ * _foundry_metrics_reset:
+ *
+ * Clears all recorded samples while keeping registered metrics.
+ *
+ * This is only safe when no other thread is recording and is meant
+ * for use from the testsuite and benchmarks.
+ */
+void
+_foundry_metrics_reset (void)
+{
+  g_mutex_lock (&registry_mutex);
+
+  for (Shard *shard = shards; shard; shard = shard->next)
+    {
+      memset (shard->counters, 0, sizeof shard->counters);
+
+      for (guint id = 0; id < MAX_METRICS; id++)
+        {
+          Histogram *histogram = shard->histograms[id];
+
+          if (histogram != NULL)
+            {
+              memset (histogram, 0, sizeof *histogram);
+              histogram->min = G_MAXINT64;
+            }
+        }
+    }
+
+  g_mutex_unlock (&registry_mutex);
+}
@@ -23,6 +23,8 @@
 
 #include <glib.h>
 
+#include "foundry-metrics-private.h"
+
 G_BEGIN_DECLS
 
 #define FOUNDRY_TRACE_GROUP "Foundry"
@@ -31,6 +33,7 @@ typedef struct _FoundryTraceScope FoundryTraceScope;
 
 gboolean            _foundry_trace_is_active           (void);
 gint64              _foundry_trace_now                 (void);
+gint64              _foundry_trace_to_nsec             (gint64               duration);
 void                _foundry_trace_mark                (const char          *name,
                                                         const char          *message_format,
                                                         ...) G_GNUC_PRINTF (2, 3);
@@ -46,7 +49,12 @@ void                _foundry_trace_scope_free          (FoundryTraceScope   *sco
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryTraceScope, _foundry_trace_scope_free)
 
+/* Scopes and marks are also recorded into the always-on metrics
+ * registry so they can be inspected with `foundry metrics` even when
+ * no profiler is attached. The @name must be a string constant.
+ */
 #define FOUNDRY_TRACE_SCOPE(name, ...) \
+  FOUNDRY_METRICS_SCOPE (name) \
   _Pragma ("GCC diagnostic push") \
   _Pragma ("GCC diagnostic ignored \"-Wdeclaration-after-statement\"") \
   g_autoptr(FoundryTraceScope) G_PASTE (__foundry_trace_scope_, __LINE__) = \
@@ -60,10 +68,17 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC (FoundryTraceScope, _foundry_trace_scope_free)
   (_foundry_trace_now ())
 
 #define FOUNDRY_TRACE_END_MARK(start_time, name, ...) \
-  _foundry_trace_mark_duration ((start_time), _foundry_trace_now () - (start_time), \
-                                (name), __VA_ARGS__)
+  G_STMT_START { \
+    gint64 __foundry_trace_duration = _foundry_trace_now () - (start_time); \
+    FOUNDRY_METRICS_RECORD ((name), _foundry_trace_to_nsec (__foundry_trace_duration)); \
+    _foundry_trace_mark_duration ((start_time), __foundry_trace_duration, \
+                                  (name), __VA_ARGS__); \
+  } G_STMT_END
 
 #define FOUNDRY_TRACE_MARK(name, ...) \
-  _foundry_trace_mark ((name), __VA_ARGS__)
+  G_STMT_START { \
+    FOUNDRY_METRICS_ADD ((name), 1); \
+    _foundry_trace_mark ((name), __VA_ARGS__); \
+  } G_STMT_END
 
 G_END_DECLS
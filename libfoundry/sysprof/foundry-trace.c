@@ -95,6 +95,16 @@ _foundry_trace_now (void)
 #endif
 }
 
+gint64
+_foundry_trace_to_nsec (gint64 duration)
+{
+#if HAVE_SYSPROF
+  return duration;
+#else
+  return duration * 1000;
+#endif
+}
+
 void
 _foundry_trace_mark_duration (gint64      start_time,
                               gint64      duration,
@@ -0,0 +1,71 @@
+/* foundry-test-runner-private.h
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <json-glib/json-glib.h>
+
+#include "foundry-contextual.h"
+#include "foundry-test.h"
+
+G_BEGIN_DECLS
+
+#define FOUNDRY_TYPE_TEST_RUNNER (foundry_test_runner_get_type())
+
+typedef enum _FoundryTestStatus
+{
+  FOUNDRY_TEST_STATUS_NOT_RUN = 0,
+  FOUNDRY_TEST_STATUS_PASSED,
+  FOUNDRY_TEST_STATUS_FAILED,
+  FOUNDRY_TEST_STATUS_TIMEOUT,
+  FOUNDRY_TEST_STATUS_ERROR,
+} FoundryTestStatus;
+
+typedef void (*FoundryTestRunnerCallback) (FoundryTest       *test,
+                                           FoundryTestStatus  status,
+                                           gint64             duration_usec,
+                                           GBytes            *output,
+                                           gpointer           user_data);
+
+G_DECLARE_FINAL_TYPE (FoundryTestRunner, foundry_test_runner, FOUNDRY, TEST_RUNNER, FoundryContextual)
+
+FoundryTestRunner *foundry_test_runner_new             (FoundryContext            *context);
+void               foundry_test_runner_set_jobs        (FoundryTestRunner         *self,
+                                                        guint                      jobs);
+void               foundry_test_runner_set_shard       (FoundryTestRunner         *self,
+                                                        guint                      index,
+                                                        guint                      count);
+void               foundry_test_runner_set_fail_fast   (FoundryTestRunner         *self,
+                                                        gboolean                   fail_fast);
+void               foundry_test_runner_set_timeout     (FoundryTestRunner         *self,
+                                                        gint64                     timeout_usec);
+void               foundry_test_runner_set_passthrough (FoundryTestRunner         *self,
+                                                        int                        stdout_fd,
+                                                        int                        stderr_fd);
+void               foundry_test_runner_set_callback    (FoundryTestRunner         *self,
+                                                        FoundryTestRunnerCallback  callback,
+                                                        gpointer                   user_data);
+DexFuture         *foundry_test_runner_run             (FoundryTestRunner         *self,
+                                                        GListModel                *tests) G_GNUC_WARN_UNUSED_RESULT;
+guint              foundry_test_runner_get_n_failed    (FoundryTestRunner         *self);
+JsonNode          *foundry_test_runner_to_json         (FoundryTestRunner         *self);
+char              *foundry_test_runner_to_junit        (FoundryTestRunner         *self);
+
+G_END_DECLS
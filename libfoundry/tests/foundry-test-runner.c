@@ -0,0 +1,921 @@
+/* foundry-test-runner.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+
+#include "foundry-build-manager.h"
+#include "foundry-build-pipeline.h"
+#include "foundry-command.h"
+#include "foundry-context.h"
+#include "foundry-json.h"
+#include "foundry-process-launcher-private.h"
+#include "foundry-test-runner-private.h"
+#include "foundry-util-private.h"
+
+/*
+ * FoundryTestRunner runs a set of FoundryTest concurrently using a fixed
+ * number of worker fibers which pull from a shared queue. The queue is
+ * ordered longest-first using the durations recorded by previous runs
+ * (stored in the context cache directory) so that long tests do not end
+ * up as stragglers at the end of the run.
+ *
+ * Sharding is applied before ordering and only depends on the test
+ * identifiers so that every shard agrees on the partitioning regardless
+ * of what durations each machine has recorded.
+ *
+ * Each test is placed in its own process group so that a timeout can
+ * take down anything the test spawned along with it.
+ */
+
+#define MAX_OUTPUT_SIZE (1024 * 1024)
+#define OUTPUT_DRAIN_TIMEOUT_USEC (G_USEC_PER_SEC)
+
+typedef struct _Result
+{
+  FoundryTest       *test;
+  char              *id;
+  char              *title;
+  char              *suite;
+  GBytes            *output;
+  char              *message;
+  gint64             estimate;
+  gint64             duration;
+  int                exit_status;
+  FoundryTestStatus  status;
+} Result;
+
+struct _FoundryTestRunner
+{
+  FoundryContextual          parent_instance;
+  GPtrArray                 *results;
+  FoundryBuildPipeline      *pipeline;
+  FoundryTestRunnerCallback  callback;
+  gpointer                   callback_data;
+  gint64                     timeout_usec;
+  gint64                     duration_usec;
+  guint                      jobs;
+  guint                      shard_index;
+  guint                      shard_count;
+  guint                      next;
+  int                        stdout_fd;
+  int                        stderr_fd;
+  guint                      fail_fast : 1;
+  guint                      stop : 1;
+};
+
+G_DEFINE_FINAL_TYPE (FoundryTestRunner, foundry_test_runner, FOUNDRY_TYPE_CONTEXTUAL)
+
+static void
+result_free (Result *result)
+{
+  g_clear_object (&result->test);
+  g_clear_pointer (&result->id, g_free);
+  g_clear_pointer (&result->title, g_free);
+  g_clear_pointer (&result->suite, g_free);
+  g_clear_pointer (&result->output, g_bytes_unref);
+  g_clear_pointer (&result->message, g_free);
+  g_free (result);
+}
+
+static Result *
+result_new (FoundryTest *test)
+{
+  g_auto(GStrv) suites = foundry_test_dup_suites (test);
+  Result *result;
+
+  result = g_new0 (Result, 1);
+  result->test = g_object_ref (test);
+  result->id = foundry_test_dup_id (test);
+  result->title = foundry_test_dup_title (test);
+  result->exit_status = -1;
+  result->estimate = -1;
+
+  if (result->id == NULL)
+    result->id = g_strdup (result->title ? result->title : "");
+
+  if (suites != NULL && suites[0] != NULL)
+    result->suite = g_strdup (suites[0]);
+
+  return result;
+}
+
+static const char *
+status_to_string (FoundryTestStatus status)
+{
+  switch (status)
+    {
+    case FOUNDRY_TEST_STATUS_PASSED:
+      return "passed";
+
+    case FOUNDRY_TEST_STATUS_FAILED:
+      return "failed";
+
+    case FOUNDRY_TEST_STATUS_TIMEOUT:
+      return "timeout";
+
+    case FOUNDRY_TEST_STATUS_ERROR:
+      return "error";
+
+    case FOUNDRY_TEST_STATUS_NOT_RUN:
+    default:
+      return "not-run";
+    }
+}
+
+static int
+compare_by_id (gconstpointer a,
+               gconstpointer b)
+{
+  const Result *ra = *(const Result * const *)a;
+  const Result *rb = *(const Result * const *)b;
+
+  return strcmp (ra->id, rb->id);
+}
+
+static int
+compare_by_estimate (gconstpointer a,
+                     gconstpointer b)
+{
+  const Result *ra = *(const Result * const *)a;
+  const Result *rb = *(const Result * const *)b;
+
+  if (ra->estimate > rb->estimate)
+    return -1;
+  else if (ra->estimate < rb->estimate)
+    return 1;
+
+  return strcmp (ra->id, rb->id);
+}
+
+static void
+foundry_test_runner_finalize (GObject *object)
+{
+  FoundryTestRunner *self = (FoundryTestRunner *)object;
+
+  g_clear_pointer (&self->results, g_ptr_array_unref);
+  g_clear_object (&self->pipeline);
+  g_clear_fd (&self->stdout_fd, NULL);
+  g_clear_fd (&self->stderr_fd, NULL);
+
+  G_OBJECT_CLASS (foundry_test_runner_parent_class)->finalize (object);
+}
+
+static void
+foundry_test_runner_class_init (FoundryTestRunnerClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = foundry_test_runner_finalize;
+}
+
+static void
+foundry_test_runner_init (FoundryTestRunner *self)
+{
+  self->results = g_ptr_array_new_with_free_func ((GDestroyNotify) result_free);
+  self->jobs = MAX (1, g_get_num_processors ());
+  self->shard_count = 1;
+  self->stdout_fd = -1;
+  self->stderr_fd = -1;
+}
+
+FoundryTestRunner *
+foundry_test_runner_new (FoundryContext *context)
+{
+  g_return_val_if_fail (FOUNDRY_IS_CONTEXT (context), NULL);
+
+  return g_object_new (FOUNDRY_TYPE_TEST_RUNNER,
+                       "context", context,
+                       NULL);
+}
+
+void
+foundry_test_runner_set_jobs (FoundryTestRunner *self,
+                              guint              jobs)
+{
+  g_return_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+
+  if (jobs == 0)
+    jobs = g_get_num_processors ();
+
+  self->jobs = MAX (1, jobs);
+}
+
+/**
+ * foundry_test_runner_set_shard:
+ * @self: a [class@Foundry.TestRunner]
+ * @index: the zero-based shard to run
+ * @count: the total number of shards
+ *
+ * Restricts the runner to every @count test (sorted by identifier)
+ * starting from @index.
+ */
+void
+foundry_test_runner_set_shard (FoundryTestRunner *self,
+                               guint              index,
+                               guint              count)
+{
+  g_return_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+  g_return_if_fail (count > 0);
+  g_return_if_fail (index < count);
+
+  self->shard_index = index;
+  self->shard_count = count;
+}
+
+void
+foundry_test_runner_set_fail_fast (FoundryTestRunner *self,
+                                   gboolean           fail_fast)
+{
+  g_return_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+
+  self->fail_fast = !!fail_fast;
+}
+
+void
+foundry_test_runner_set_timeout (FoundryTestRunner *self,
+                                 gint64             timeout_usec)
+{
+  g_return_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+
+  self->timeout_usec = MAX (0, timeout_usec);
+}
+
+/**
+ * foundry_test_runner_set_passthrough:
+ * @self: a [class@Foundry.TestRunner]
+ * @stdout_fd: the FD for test output, or -1
+ * @stderr_fd: the FD for test errors, or -1
+ *
+ * Passes @stdout_fd and @stderr_fd through to tests instead of
+ * capturing their output. This is only useful when running a
+ * single job at a time.
+ */
+void
+foundry_test_runner_set_passthrough (FoundryTestRunner *self,
+                                     int                stdout_fd,
+                                     int                stderr_fd)
+{
+  g_return_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+
+  g_clear_fd (&self->stdout_fd, NULL);
+  g_clear_fd (&self->stderr_fd, NULL);
+
+  if (stdout_fd != -1)
+    self->stdout_fd = dup (stdout_fd);
+
+  if (stderr_fd != -1)
+    self->stderr_fd = dup (stderr_fd);
+}
+
+void
+foundry_test_runner_set_callback (FoundryTestRunner         *self,
+                                  FoundryTestRunnerCallback  callback,
+                                  gpointer                   user_data)
+{
+  g_return_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+
+  self->callback = callback;
+  self->callback_data = user_data;
+}
+
+static GFile *
+foundry_test_runner_dup_durations_file (FoundryTestRunner *self)
+{
+  g_autoptr(FoundryContext) context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self));
+
+  return foundry_context_cache_file (context, "test-durations.json", NULL);
+}
+
+static JsonNode *
+foundry_test_runner_load_durations (FoundryTestRunner *self)
+{
+  g_autoptr(GFile) file = foundry_test_runner_dup_durations_file (self);
+  g_autoptr(JsonNode) node = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+
+  if ((bytes = dex_await_boxed (dex_file_load_contents_bytes (file), NULL)))
+    node = dex_await_boxed (foundry_json_node_from_bytes (bytes), NULL);
+
+  if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node))
+    {
+      g_clear_pointer (&node, json_node_unref);
+      node = json_node_init_object (json_node_alloc (), json_object_new ());
+    }
+
+  return g_steal_pointer (&node);
+}
+
+/* Merges the durations from this run into those on disk while holding
+ * the lock so that concurrent runners (such as other shards sharing a
+ * cache directory) do not drop each other's results.
+ */
+static void
+foundry_test_runner_save_durations (FoundryTestRunner *self)
+{
+  g_autoptr(GFile) file = foundry_test_runner_dup_durations_file (self);
+  g_autoptr(GFile) directory = g_file_get_parent (file);
+  g_autofree char *path = g_file_get_path (directory);
+  g_autofree char *lock_path = NULL;
+  g_autoptr(JsonNode) durations = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofd int lock_fd = -1;
+  JsonObject *obj;
+
+  if (!dex_await (dex_mkdir_with_parents (path, 0750), &error))
+    goto failure;
+
+  lock_path = g_strconcat (g_file_peek_path (file), ".lock", NULL);
+  lock_fd = dex_await_int (_foundry_lock_file (lock_path), &error);
+
+  if (error != NULL)
+    {
+      lock_fd = -1;
+      goto failure;
+    }
+
+  durations = foundry_test_runner_load_durations (self);
+  obj = json_node_get_object (durations);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      const Result *result = g_ptr_array_index (self->results, i);
+
+      /* Errors never ran the test so there is nothing to learn */
+      if (result->status == FOUNDRY_TEST_STATUS_PASSED ||
+          result->status == FOUNDRY_TEST_STATUS_FAILED ||
+          result->status == FOUNDRY_TEST_STATUS_TIMEOUT)
+        json_object_set_int_member (obj, result->id, result->duration);
+    }
+
+  /* Replacing writes to a temporary file and renames it over the
+   * original so readers never see a partial file.
+   */
+  if (!(bytes = dex_await_boxed (foundry_json_node_to_bytes_full (durations, FALSE), &error)) ||
+      !dex_await (dex_file_replace_contents_bytes (file,
+                                                   bytes,
+                                                   NULL,
+                                                   FALSE,
+                                                   G_FILE_CREATE_REPLACE_DESTINATION),
+                  &error))
+    goto failure;
+
+  return;
+
+failure:
+  g_debug ("Failed to save test durations: %s", error->message);
+}
+
+static DexFuture *
+foundry_test_runner_read_fiber (gpointer data)
+{
+  GInputStream *stream = data;
+  g_autoptr(GByteArray) buffer = g_byte_array_new ();
+  g_autoptr(GError) error = NULL;
+  gboolean truncated = FALSE;
+
+  g_assert (G_IS_INPUT_STREAM (stream));
+
+  for (;;)
+    {
+      g_autoptr(GBytes) bytes = NULL;
+      gconstpointer data;
+      gsize len;
+
+      if (!(bytes = dex_await_boxed (dex_input_stream_read_bytes (stream, 8192, G_PRIORITY_DEFAULT), &error)))
+        break;
+
+      data = g_bytes_get_data (bytes, &len);
+
+      if (len == 0)
+        break;
+
+      /* Keep draining so the test does not block on a full pipe */
+      if (buffer->len + len > MAX_OUTPUT_SIZE)
+        {
+          len = MAX_OUTPUT_SIZE - buffer->len;
+          truncated = TRUE;
+        }
+
+      g_byte_array_append (buffer, data, len);
+    }
+
+  if (truncated)
+    {
+      static const char message[] = "\n[output truncated]\n";
+      g_byte_array_append (buffer, (const guint8 *)message, strlen (message));
+    }
+
+  return dex_future_new_take_boxed (G_TYPE_BYTES, g_byte_array_free_to_bytes (g_steal_pointer (&buffer)));
+}
+
+static void
+foundry_test_runner_run_one (FoundryTestRunner *self,
+                             Result            *result)
+{
+  g_autoptr(FoundryProcessLauncher) launcher = NULL;
+  g_autoptr(FoundryCommand) command = NULL;
+  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(DexFuture) reader = NULL;
+  g_autoptr(DexFuture) wait = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 begin;
+
+  g_assert (FOUNDRY_IS_TEST_RUNNER (self));
+  g_assert (result != NULL);
+
+  begin = g_get_monotonic_time ();
+
+  if (!(command = foundry_test_dup_command (result->test)))
+    {
+      g_set_error (&error,
+                   G_IO_ERROR,
+                   G_IO_ERROR_NOT_SUPPORTED,
+                   "`%s` is missing a test command",
+                   result->id);
+      goto failure;
+    }
+
+  launcher = foundry_process_launcher_new ();
+  _foundry_process_launcher_set_process_group (launcher, TRUE);
+
+  if (!dex_await (foundry_command_prepare (command, self->pipeline, launcher, FOUNDRY_BUILD_PIPELINE_PHASE_BUILD), &error))
+    goto failure;
+
+  if (self->stdout_fd != -1 || self->stderr_fd != -1)
+    {
+      if (self->stdout_fd != -1)
+        foundry_process_launcher_take_fd (launcher, dup (self->stdout_fd), STDOUT_FILENO);
+
+      if (self->stderr_fd != -1)
+        foundry_process_launcher_take_fd (launcher, dup (self->stderr_fd), STDERR_FILENO);
+    }
+  else
+    {
+      int fds[2];
+
+      if (!g_unix_open_pipe (fds, O_CLOEXEC, &error))
+        goto failure;
+
+      stream = g_unix_input_stream_new (fds[0], TRUE);
+      foundry_process_launcher_take_fd (launcher, dup (fds[1]), STDOUT_FILENO);
+      foundry_process_launcher_take_fd (launcher, fds[1], STDERR_FILENO);
+    }
+
+  subprocess = foundry_process_launcher_spawn (launcher, &error);
+
+  /* Release our copy of the pipe so the reader sees EOF */
+  g_clear_object (&launcher);
+
+  if (subprocess == NULL)
+    goto failure;
+
+  if (stream != NULL)
+    reader = dex_scheduler_spawn (NULL, 0,
+                                  foundry_test_runner_read_fiber,
+                                  g_object_ref (stream),
+                                  g_object_unref);
+
+  wait = dex_subprocess_wait (subprocess);
+
+  if (self->timeout_usec > 0)
+    dex_await (dex_future_first (dex_ref (wait),
+                                 dex_timeout_new_usec (self->timeout_usec),
+                                 NULL),
+               NULL);
+
+  /* Without a timeout nothing has been awaited yet, so only a timeout
+   * winning the race above means the test is still running.
+   */
+  if (self->timeout_usec > 0 && dex_future_is_pending (wait))
+    {
+      const char *identifier = g_subprocess_get_identifier (subprocess);
+
+      /* The test leads its own process group, so signal the group
+       * to also reap any helpers it spawned.
+       */
+      if (identifier != NULL)
+        kill (-(GPid)g_ascii_strtoll (identifier, NULL, 10), SIGKILL);
+
+      g_subprocess_force_exit (subprocess);
+      result->status = FOUNDRY_TEST_STATUS_TIMEOUT;
+      result->message = g_strdup ("Timed out");
+    }
+
+  dex_await (dex_ref (wait), NULL);
+
+  result->duration = g_get_monotonic_time () - begin;
+
+  /* Children of the test may still hold the pipe open */
+  if (reader != NULL &&
+      dex_await (dex_future_first (dex_ref (reader),
+                                   dex_timeout_new_usec (OUTPUT_DRAIN_TIMEOUT_USEC),
+                                   NULL),
+                 NULL) &&
+      !dex_future_is_pending (reader))
+    result->output = dex_await_boxed (dex_ref (reader), NULL);
+
+  if (result->status == FOUNDRY_TEST_STATUS_TIMEOUT)
+    return;
+
+  if (g_subprocess_get_if_exited (subprocess))
+    {
+      result->exit_status = g_subprocess_get_exit_status (subprocess);
+      result->status = result->exit_status == 0 ? FOUNDRY_TEST_STATUS_PASSED : FOUNDRY_TEST_STATUS_FAILED;
+
+      if (result->exit_status != 0)
+        result->message = g_strdup_printf ("Exited with status %d", result->exit_status);
+    }
+  else
+    {
+      result->status = FOUNDRY_TEST_STATUS_FAILED;
+
+      if (g_subprocess_get_if_signaled (subprocess))
+        result->message = g_strdup_printf ("Terminated by signal %d",
+                                           g_subprocess_get_term_sig (subprocess));
+    }
+
+  return;
+
+failure:
+  result->duration = g_get_monotonic_time () - begin;
+  result->status = FOUNDRY_TEST_STATUS_ERROR;
+  result->message = g_strdup (error->message);
+}
+
+static DexFuture *
+foundry_test_runner_worker_fiber (gpointer data)
+{
+  FoundryTestRunner *self = data;
+
+  g_assert (FOUNDRY_IS_TEST_RUNNER (self));
+
+  /* All workers run on the same scheduler so the queue position
+   * and stop flag need no synchronization.
+   */
+  while (!self->stop && self->next < self->results->len)
+    {
+      Result *result = g_ptr_array_index (self->results, self->next);
+
+      self->next++;
+
+      foundry_test_runner_run_one (self, result);
+
+      if (self->fail_fast && result->status != FOUNDRY_TEST_STATUS_PASSED)
+        self->stop = TRUE;
+
+      if (self->callback != NULL)
+        self->callback (result->test,
+                        result->status,
+                        result->duration,
+                        result->output,
+                        self->callback_data);
+    }
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+foundry_test_runner_run_fiber (FoundryTestRunner *self,
+                               GListModel        *tests)
+{
+  g_autoptr(FoundryBuildManager) build_manager = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GPtrArray) all = NULL;
+  g_autoptr(GPtrArray) workers = NULL;
+  g_autoptr(JsonNode) durations = NULL;
+  JsonObject *durations_obj;
+  gint64 known_total = 0;
+  guint n_known = 0;
+  guint n_items;
+  gint64 begin;
+
+  g_assert (FOUNDRY_IS_TEST_RUNNER (self));
+  g_assert (G_IS_LIST_MODEL (tests));
+
+  begin = g_get_monotonic_time ();
+
+  context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self));
+  build_manager = foundry_context_dup_build_manager (context);
+
+  n_items = g_list_model_get_n_items (tests);
+  all = g_ptr_array_new ();
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(FoundryTest) test = g_list_model_get_item (tests, i);
+
+      g_ptr_array_add (all, result_new (test));
+    }
+
+  g_ptr_array_sort (all, compare_by_id);
+
+  for (guint i = 0; i < all->len; i++)
+    {
+      Result *result = g_ptr_array_index (all, i);
+
+      if (i % self->shard_count == self->shard_index)
+        g_ptr_array_add (self->results, result);
+      else
+        result_free (result);
+    }
+
+  durations = foundry_test_runner_load_durations (self);
+  durations_obj = json_node_get_object (durations);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      Result *result = g_ptr_array_index (self->results, i);
+
+      if (json_object_has_member (durations_obj, result->id))
+        {
+          result->estimate = json_object_get_int_member (durations_obj, result->id);
+          known_total += result->estimate;
+          n_known++;
+        }
+    }
+
+  /* Assume tests we have not seen before take an average amount of time */
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      Result *result = g_ptr_array_index (self->results, i);
+
+      if (result->estimate < 0)
+        result->estimate = n_known ? known_total / n_known : 0;
+    }
+
+  g_ptr_array_sort (self->results, compare_by_estimate);
+
+  self->pipeline = dex_await_object (foundry_build_manager_load_pipeline (build_manager), NULL);
+
+  workers = g_ptr_array_new_with_free_func (dex_unref);
+
+  for (guint i = 0; i < MIN (self->jobs, self->results->len); i++)
+    g_ptr_array_add (workers,
+                     dex_scheduler_spawn (NULL, 0,
+                                          foundry_test_runner_worker_fiber,
+                                          g_object_ref (self),
+                                          g_object_unref));
+
+  if (workers->len > 0)
+    dex_await (dex_future_allv ((DexFuture **)workers->pdata, workers->len), NULL);
+
+  self->duration_usec = g_get_monotonic_time () - begin;
+
+  foundry_test_runner_save_durations (self);
+
+  return dex_future_new_true ();
+}
+
+/**
+ * foundry_test_runner_run:
+ * @self: a [class@Foundry.TestRunner]
+ * @tests: a [iface@Gio.ListModel] of [class@Foundry.Test]
+ *
+ * Runs @tests (limited to the configured shard).
+ *
+ * Returns: (transfer full): a [class@Dex.Future] that resolves when
+ *   all tests have completed, or failed when fail-fast is enabled.
+ *   Check [method@Foundry.TestRunner.get_n_failed] for the outcome.
+ */
+DexFuture *
+foundry_test_runner_run (FoundryTestRunner *self,
+                         GListModel        *tests)
+{
+  dex_return_error_if_fail (FOUNDRY_IS_TEST_RUNNER (self));
+  dex_return_error_if_fail (G_IS_LIST_MODEL (tests));
+  dex_return_error_if_fail (self->results->len == 0);
+
+  return FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
+                                  foundry_test_runner_run_fiber,
+                                  2,
+                                  FOUNDRY_TYPE_TEST_RUNNER, self,
+                                  G_TYPE_LIST_MODEL, tests);
+}
+
+guint
+foundry_test_runner_get_n_failed (FoundryTestRunner *self)
+{
+  guint n_failed = 0;
+
+  g_return_val_if_fail (FOUNDRY_IS_TEST_RUNNER (self), 0);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      const Result *result = g_ptr_array_index (self->results, i);
+
+      if (result->status == FOUNDRY_TEST_STATUS_FAILED ||
+          result->status == FOUNDRY_TEST_STATUS_TIMEOUT ||
+          result->status == FOUNDRY_TEST_STATUS_ERROR)
+        n_failed++;
+    }
+
+  return n_failed;
+}
+
+/* Control characters other than whitespace are not valid in XML 1.0
+ * even when escaped, so drop them from captured output.
+ */
+static void
+strip_control_chars (char *str)
+{
+  char *dst = str;
+
+  for (const char *src = str; *src; src++)
+    {
+      if ((guchar)*src < 0x20 && *src != '\t' && *src != '\n' && *src != '\r')
+        continue;
+
+      *dst++ = *src;
+    }
+
+  *dst = 0;
+}
+
+static char *
+dup_output (const Result *result)
+{
+  const char *data;
+  gsize len;
+
+  if (result->output == NULL)
+    return NULL;
+
+  data = g_bytes_get_data (result->output, &len);
+
+  return g_utf8_make_valid (data, len);
+}
+
+JsonNode *
+foundry_test_runner_to_json (FoundryTestRunner *self)
+{
+  guint counts[FOUNDRY_TEST_STATUS_ERROR + 1] = {0};
+  JsonArray *tests;
+  JsonObject *obj;
+
+  g_return_val_if_fail (FOUNDRY_IS_TEST_RUNNER (self), NULL);
+
+  tests = json_array_sized_new (self->results->len);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      const Result *result = g_ptr_array_index (self->results, i);
+      g_autofree char *output = dup_output (result);
+      JsonObject *test = json_object_new ();
+
+      counts[result->status]++;
+
+      json_object_set_string_member (test, "id", result->id);
+      json_object_set_string_member (test, "title", result->title);
+      json_object_set_string_member (test, "suite", result->suite);
+      json_object_set_string_member (test, "status", status_to_string (result->status));
+      json_object_set_int_member (test, "duration-usec", result->duration);
+
+      if (result->exit_status >= 0)
+        json_object_set_int_member (test, "exit-status", result->exit_status);
+
+      if (result->message != NULL)
+        json_object_set_string_member (test, "message", result->message);
+
+      if (output != NULL)
+        json_object_set_string_member (test, "output", output);
+
+      json_array_add_object_element (tests, test);
+    }
+
+  obj = json_object_new ();
+  json_object_set_int_member (obj, "shard", self->shard_index + 1);
+  json_object_set_int_member (obj, "shards", self->shard_count);
+  json_object_set_int_member (obj, "duration-usec", self->duration_usec);
+  json_object_set_int_member (obj, "passed", counts[FOUNDRY_TEST_STATUS_PASSED]);
+  json_object_set_int_member (obj, "failed", counts[FOUNDRY_TEST_STATUS_FAILED]);
+  json_object_set_int_member (obj, "timeout", counts[FOUNDRY_TEST_STATUS_TIMEOUT]);
+  json_object_set_int_member (obj, "error", counts[FOUNDRY_TEST_STATUS_ERROR]);
+  json_object_set_int_member (obj, "not-run", counts[FOUNDRY_TEST_STATUS_NOT_RUN]);
+  json_object_set_array_member (obj, "tests", tests);
+
+  return json_node_init_object (json_node_alloc (), obj);
+}
+
+char *
+foundry_test_runner_to_junit (FoundryTestRunner *self)
+{
+  g_autoptr(GString) str = NULL;
+  guint failures = 0;
+  guint errors = 0;
+  guint skipped = 0;
+
+  g_return_val_if_fail (FOUNDRY_IS_TEST_RUNNER (self), NULL);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      const Result *result = g_ptr_array_index (self->results, i);
+
+      if (result->status == FOUNDRY_TEST_STATUS_FAILED ||
+          result->status == FOUNDRY_TEST_STATUS_TIMEOUT)
+        failures++;
+      else if (result->status == FOUNDRY_TEST_STATUS_ERROR)
+        errors++;
+      else if (result->status == FOUNDRY_TEST_STATUS_NOT_RUN)
+        skipped++;
+    }
+
+  str = g_string_new ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  g_string_append_printf (str,
+                          "<testsuites tests=\"%u\" failures=\"%u\" errors=\"%u\" skipped=\"%u\" time=\"%.3lf\">\n",
+                          self->results->len, failures, errors, skipped,
+                          self->duration_usec / (double)G_USEC_PER_SEC);
+  g_string_append_printf (str,
+                          "  <testsuite name=\"foundry\" tests=\"%u\" failures=\"%u\" errors=\"%u\" skipped=\"%u\" time=\"%.3lf\">\n",
+                          self->results->len, failures, errors, skipped,
+                          self->duration_usec / (double)G_USEC_PER_SEC);
+
+  for (guint i = 0; i < self->results->len; i++)
+    {
+      const Result *result = g_ptr_array_index (self->results, i);
+      g_autofree char *output = dup_output (result);
+
+      g_autofree char *testcase = NULL;
+      g_autofree char *time = g_strdup_printf ("%.3lf", result->duration / (double)G_USEC_PER_SEC);
+
+      testcase = g_markup_printf_escaped ("    <testcase name=\"%s\" classname=\"%s\" time=\"%s\">\n",
+                                          result->id,
+                                          result->suite ? result->suite : "",
+                                          time);
+      g_string_append (str, testcase);
+
+      switch (result->status)
+        {
+        case FOUNDRY_TEST_STATUS_FAILED:
+        case FOUNDRY_TEST_STATUS_TIMEOUT:
+          {
+            g_autofree char *failure = NULL;
+
+            failure = g_markup_printf_escaped ("      <failure type=\"%s\" message=\"%s\"/>\n",
+                                               status_to_string (result->status),
+                                               result->message ? result->message : "");
+            g_string_append (str, failure);
+          }
+          break;
+
+        case FOUNDRY_TEST_STATUS_ERROR:
+          {
+            g_autofree char *failure = NULL;
+
+            failure = g_markup_printf_escaped ("      <error message=\"%s\"/>\n",
+                                               result->message ? result->message : "");
+            g_string_append (str, failure);
+          }
+          break;
+
+        case FOUNDRY_TEST_STATUS_NOT_RUN:
+          g_string_append (str, "      <skipped/>\n");
+          break;
+
+        case FOUNDRY_TEST_STATUS_PASSED:
+        default:
+          break;
+        }
+
+      if (output != NULL)
+        strip_control_chars (output);
+
+      if (output != NULL && output[0] != 0)
+        {
+          g_autofree char *escaped = g_markup_escape_text (output, -1);
+          g_string_append_printf (str, "      <system-out>%s</system-out>\n", escaped);
+        }
+
+      g_string_append (str, "    </testcase>\n");
+    }
+
+  g_string_append (str, "  </testsuite>\n");
+  g_string_append (str, "</testsuites>\n");
+
+  return g_string_free (g_steal_pointer (&str), FALSE);
+}
@@ -710,6 +710,11 @@ foundry_vcs_load_tip (FoundryVcs *self)
  * Loads a graph of commits reachable from @start, excluding commits reachable
  * from @end when provided. This follows Git range semantics like `end..start`.
  *
+ * The resulting graph may be partial. Implementations may resolve once the
+ * first rows are available and lay out more rows as the end of the model is
+ * approached, emitting [signal@Gio.ListModel::items-changed] as it grows.
+ * Consumers should not rely on the number of items being final.
+ *
  * Returns: (transfer full): a [class@Dex.Future] that resolves to a
  *   [class@Foundry.VcsGraph] or rejects with error.
  *
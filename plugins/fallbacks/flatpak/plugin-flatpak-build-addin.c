@@ -33,6 +33,8 @@
 #include "plugin-flatpak-simple-stage.h"
 #include "plugin-flatpak-util.h"
 
+#include "foundry-build-stage-private.h"
+
 struct _PluginFlatpakBuildAddin
 {
   FoundryBuildAddin  parent_instance;
@@ -147,6 +149,7 @@ plugin_flatpak_build_addin_load (FoundryBuildAddin *addin)
         foundry_path_expand_inplace (&state_dir);
 
       self->download = plugin_flatpak_download_stage_new (context, staging_dir, state_dir, manifest_path, primary_module_name);
+      _foundry_build_stage_add_dependency (self->download, self->prepare);
       foundry_build_pipeline_add_stage (pipeline, self->download);
 
       self->dependencies = plugin_flatpak_dependencies_stage_new (context, staging_dir, state_dir, manifest_path, primary_module_name);
@@ -25,6 +25,7 @@
 #include "plugin-flatpak.h"
 #include "plugin-flatpak-download-stage.h"
 
+#include "foundry-build-stage-private.h"
 #include "foundry-util-private.h"
 
 struct _PluginFlatpakDownloadStage
@@ -249,6 +250,11 @@ plugin_flatpak_download_stage_class_init (PluginFlatpakDownloadStageClass *klass
 static void
 plugin_flatpak_download_stage_init (PluginFlatpakDownloadStage *self)
 {
+  /* Only needs the directories from the prepare stage (added as a
+   * dependency by the build addin) so it may overlap other stages.
+   */
+  _foundry_build_stage_set_ordered (FOUNDRY_BUILD_STAGE (self), FALSE);
+  _foundry_build_stage_set_resources (FOUNDRY_BUILD_STAGE (self), FOUNDRY_BUILD_STAGE_RESOURCE_NETWORK);
 }
 
 FoundryBuildStage *
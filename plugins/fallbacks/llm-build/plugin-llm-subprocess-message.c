@@ -0,0 +1,195 @@
+/* plugin-llm-subprocess-message.c
+ *
+ * Copyright 2026 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include "plugin-llm-subprocess-message.h"
+
+/* Keeps the first @head_size bytes and the last @tail_size bytes of a
+ * subprocess' output. The head is usually where configuration errors
+ * show up while the tail has the failure summary, so the middle is what
+ * gets dropped once the output exceeds what is useful to a model.
+ */
+struct _PluginLlmSubprocessMessage
+{
+  FoundryLlmMessage  parent_instance;
+  GByteArray        *head;
+  GByteArray        *tail;
+  gsize              head_size;
+  gsize              tail_size;
+  gsize              n_bytes;
+};
+
+G_DEFINE_FINAL_TYPE (PluginLlmSubprocessMessage, plugin_llm_subprocess_message, FOUNDRY_TYPE_LLM_MESSAGE)
+
+static char *
+plugin_llm_subprocess_message_dup_role (FoundryLlmMessage *message)
+{
+  return g_strdup ("tool");
+}
+
+static char *
+plugin_llm_subprocess_message_dup_content (FoundryLlmMessage *message)
+{
+  PluginLlmSubprocessMessage *self = PLUGIN_LLM_SUBPROCESS_MESSAGE (message);
+  g_autoptr(GString) str = g_string_new (NULL);
+  gsize n_elided = plugin_llm_subprocess_message_get_n_elided (self);
+  gsize tail_len = MIN (self->tail->len, self->tail_size);
+
+  g_string_append_len (str, (const char *)self->head->data, self->head->len);
+
+  if (n_elided > 0)
+    g_string_append_printf (str,
+                            "\n[… %"G_GSIZE_FORMAT" bytes of output elided …]\n",
+                            n_elided);
+
+  g_string_append_len (str,
+                       (const char *)self->tail->data + (self->tail->len - tail_len),
+                       tail_len);
+
+  /* Either edge of the elision may have split a multi-byte sequence */
+  return g_utf8_make_valid (str->str, str->len);
+}
+
+static void
+plugin_llm_subprocess_message_finalize (GObject *object)
+{
+  PluginLlmSubprocessMessage *self = (PluginLlmSubprocessMessage *)object;
+
+  g_clear_pointer (&self->head, g_byte_array_unref);
+  g_clear_pointer (&self->tail, g_byte_array_unref);
+
+  G_OBJECT_CLASS (plugin_llm_subprocess_message_parent_class)->finalize (object);
+}
+
+static void
+plugin_llm_subprocess_message_class_init (PluginLlmSubprocessMessageClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FoundryLlmMessageClass *llm_message_class = FOUNDRY_LLM_MESSAGE_CLASS (klass);
+
+  object_class->finalize = plugin_llm_subprocess_message_finalize;
+
+  llm_message_class->dup_role = plugin_llm_subprocess_message_dup_role;
+  llm_message_class->dup_content = plugin_llm_subprocess_message_dup_content;
+}
+
+static void
+plugin_llm_subprocess_message_init (PluginLlmSubprocessMessage *self)
+{
+  self->head = g_byte_array_new ();
+  self->tail = g_byte_array_new ();
+}
+
+FoundryLlmMessage *
+plugin_llm_subprocess_message_new (gsize head_size,
+                                   gsize tail_size)
+{
+  PluginLlmSubprocessMessage *self;
+
+  self = g_object_new (PLUGIN_TYPE_LLM_SUBPROCESS_MESSAGE, NULL);
+  self->head_size = head_size;
+  self->tail_size = tail_size;
+
+  return FOUNDRY_LLM_MESSAGE (self);
+}
+
+/**
+ * plugin_llm_subprocess_message_append:
+ * @self: a [class@Plugin.LlmSubprocessMessage]
+ *
+ * Appends output read from the subprocess. Memory use stays bounded by
+ * roughly twice the head and tail sizes regardless of how much output
+ * is appended.
+ */
+void
+plugin_llm_subprocess_message_append (PluginLlmSubprocessMessage *self,
+                                      const guint8               *data,
+                                      gsize                       len)
+{
+  gsize to_head;
+
+  g_return_if_fail (PLUGIN_IS_LLM_SUBPROCESS_MESSAGE (self));
+  g_return_if_fail (data != NULL || len == 0);
+
+  if (len == 0)
+    return;
+
+  self->n_bytes += len;
+
+  to_head = MIN (len, self->head_size - self->head->len);
+
+  if (to_head > 0)
+    {
+      g_byte_array_append (self->head, data, to_head);
+      data += to_head;
+      len -= to_head;
+    }
+
+  if (len > 0 && self->tail_size > 0)
+    {
+      /* Only the last tail_size bytes of a large chunk can survive */
+      if (len > self->tail_size)
+        {
+          data += len - self->tail_size;
+          len = self->tail_size;
+        }
+
+      g_byte_array_append (self->tail, data, len);
+
+      /* Trim lazily so we are not shifting the buffer on every read */
+      if (self->tail->len >= self->tail_size * 2)
+        g_byte_array_remove_range (self->tail, 0, self->tail->len - self->tail_size);
+    }
+
+  g_object_notify (G_OBJECT (self), "content");
+}
+
+/**
+ * plugin_llm_subprocess_message_get_n_bytes:
+ * @self: a [class@Plugin.LlmSubprocessMessage]
+ *
+ * Gets the total number of bytes appended, including elided bytes.
+ */
+gsize
+plugin_llm_subprocess_message_get_n_bytes (PluginLlmSubprocessMessage *self)
+{
+  g_return_val_if_fail (PLUGIN_IS_LLM_SUBPROCESS_MESSAGE (self), 0);
+
+  return self->n_bytes;
+}
+
+/**
+ * plugin_llm_subprocess_message_get_n_elided:
+ * @self: a [class@Plugin.LlmSubprocessMessage]
+ *
+ * Gets the number of bytes dropped from the middle of the output.
+ */
+gsize
+plugin_llm_subprocess_message_get_n_elided (PluginLlmSubprocessMessage *self)
+{
+  gsize kept;
+
+  g_return_val_if_fail (PLUGIN_IS_LLM_SUBPROCESS_MESSAGE (self), 0);
+
+  kept = self->head->len + MIN (self->tail->len, self->tail_size);
+
+  return self->n_bytes - kept;
+}
@@ -0,0 +1,39 @@
+/* plugin-llm-subprocess-message.h
+ *
+ * Copyright 2026 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#pragma once
+
+#include <foundry.h>
+
+G_BEGIN_DECLS
+
+#define PLUGIN_TYPE_LLM_SUBPROCESS_MESSAGE (plugin_llm_subprocess_message_get_type())
+
+G_DECLARE_FINAL_TYPE (PluginLlmSubprocessMessage, plugin_llm_subprocess_message, PLUGIN, LLM_SUBPROCESS_MESSAGE, FoundryLlmMessage)
+
+FoundryLlmMessage *plugin_llm_subprocess_message_new          (gsize                       head_size,
+                                                               gsize                       tail_size);
+void               plugin_llm_subprocess_message_append       (PluginLlmSubprocessMessage *self,
+                                                               const guint8               *data,
+                                                               gsize                       len);
+gsize              plugin_llm_subprocess_message_get_n_bytes  (PluginLlmSubprocessMessage *self);
+gsize              plugin_llm_subprocess_message_get_n_elided (PluginLlmSubprocessMessage *self);
+
+G_END_DECLS
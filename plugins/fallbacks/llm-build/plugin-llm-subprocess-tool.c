@@ -20,14 +20,21 @@
 
 #include "config.h"
 
+#include "plugin-llm-subprocess-message.h"
 #include "plugin-llm-subprocess-tool.h"
 
+#define DEFAULT_HEAD_SIZE (8  * 1024)
+#define DEFAULT_TAIL_SIZE (24 * 1024)
+#define READ_SIZE         (64 * 1024)
+
 struct _PluginLlmSubprocessTool
 {
   FoundryLlmTool parent_instance;
   char *name;
   char *description;
   char **argv;
+  gsize head_size;
+  gsize tail_size;
 };
 
 G_DEFINE_FINAL_TYPE (PluginLlmSubprocessTool, plugin_llm_subprocess_tool, FOUNDRY_TYPE_LLM_TOOL)
@@ -51,12 +58,12 @@ plugin_llm_subprocess_tool_call_fiber (gpointer data)
   g_autoptr(FoundryProcessLauncher) launcher = NULL;
   g_autoptr(FoundryDBusService) dbus = NULL;
   g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryLlmMessage) message = NULL;
   g_autoptr(GSubprocess) subprocess = NULL;
   g_autoptr(GError) error = NULL;
   g_autoptr(GFile) project_dir = NULL;
-  g_autofree char *output = NULL;
   g_autofree char *address = NULL;
-  g_autofree char *stdout_buf = NULL;
+  GInputStream *stdout_stream;
 
   g_assert (PLUGIN_IS_LLM_SUBPROCESS_TOOL (self));
 
@@ -83,11 +90,37 @@ plugin_llm_subprocess_tool_call_fiber (gpointer data)
                                                                 &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
-  if (!(stdout_buf = dex_await_string (foundry_subprocess_communicate_utf8 (subprocess, NULL), &error)))
-    return dex_future_new_for_error (g_steal_pointer (&error));
-
-  return dex_future_new_take_object (foundry_simple_llm_message_new (g_strdup ("tool"),
-                                                                     g_steal_pointer (&stdout_buf)));
+  /* Read incrementally rather than communicate() so that builds which
+   * produce megabytes of output only ever hold the head and tail.
+   */
+  message = plugin_llm_subprocess_message_new (self->head_size, self->tail_size);
+  stdout_stream = g_subprocess_get_stdout_pipe (subprocess);
+
+  for (;;)
+    {
+      g_autoptr(GBytes) bytes = NULL;
+
+      /* This fails once the caller discards the call, in which case
+       * there is nobody left to read output so stop the process.
+       */
+      if (!(bytes = dex_await_boxed (dex_input_stream_read_bytes (stdout_stream, READ_SIZE, G_PRIORITY_DEFAULT), &error)))
+        {
+          g_subprocess_force_exit (subprocess);
+          return dex_future_new_for_error (g_steal_pointer (&error));
+        }
+
+      if (g_bytes_get_size (bytes) == 0)
+        break;
+
+      plugin_llm_subprocess_message_append (PLUGIN_LLM_SUBPROCESS_MESSAGE (message),
+                                            g_bytes_get_data (bytes, NULL),
+                                            g_bytes_get_size (bytes));
+    }
+
+  /* Failing commands still have output the model needs to see */
+  dex_await (dex_subprocess_wait_check (subprocess), NULL);
+
+  return dex_future_new_take_object (g_steal_pointer (&message));
 }
 
 static DexFuture *
@@ -131,6 +164,8 @@ plugin_llm_subprocess_tool_class_init (PluginLlmSubprocessToolClass *klass)
 static void
 plugin_llm_subprocess_tool_init (PluginLlmSubprocessTool *self)
 {
+  self->head_size = DEFAULT_HEAD_SIZE;
+  self->tail_size = DEFAULT_TAIL_SIZE;
 }
 
 FoundryLlmTool *
@@ -154,3 +189,23 @@ plugin_llm_subprocess_tool_new (FoundryContext     *context,
 
   return FOUNDRY_LLM_TOOL (self);
 }
+
+/**
+ * plugin_llm_subprocess_tool_set_output_limits:
+ * @self: a [class@Plugin.LlmSubprocessTool]
+ * @head_size: number of leading bytes of output to keep
+ * @tail_size: number of trailing bytes of output to keep
+ *
+ * Sets how much output is returned to the model. Output beyond
+ * @head_size + @tail_size has its middle replaced with a marker.
+ */
+void
+plugin_llm_subprocess_tool_set_output_limits (PluginLlmSubprocessTool *self,
+                                              gsize                    head_size,
+                                              gsize                    tail_size)
+{
+  g_return_if_fail (PLUGIN_IS_LLM_SUBPROCESS_TOOL (self));
+
+  self->head_size = head_size;
+  self->tail_size = tail_size;
+}
@@ -28,9 +28,12 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (PluginLlmSubprocessTool, plugin_llm_subprocess_tool, PLUGIN, LLM_SUBPROCESS_TOOL, FoundryLlmTool)
 
-FoundryLlmTool *plugin_llm_subprocess_tool_new (FoundryContext     *context,
-                                                const char         *name,
-                                                const char * const *argv,
-                                                const char         *description);
+FoundryLlmTool *plugin_llm_subprocess_tool_new               (FoundryContext          *context,
+                                                              const char              *name,
+                                                              const char * const      *argv,
+                                                              const char              *description);
+void            plugin_llm_subprocess_tool_set_output_limits (PluginLlmSubprocessTool *self,
+                                                              gsize                    head_size,
+                                                              gsize                    tail_size);
 
 G_END_DECLS
@@ -72,6 +72,12 @@ plugin_file_search_result_create_intent (FoundrySearchResult *result,
   return foundry_open_file_intent_new (file, NULL);
 }
 
+static double
+plugin_file_search_result_get_score (FoundrySearchResult *result)
+{
+  return PLUGIN_FILE_SEARCH_RESULT (result)->score;
+}
+
 static void
 plugin_file_search_result_finalize (GObject *object)
 {
@@ -96,6 +102,7 @@ plugin_file_search_result_class_init (PluginFileSearchResultClass *klass)
   search_result_class->dup_subtitle = plugin_file_search_result_dup_subtitle;
   search_result_class->load = plugin_file_search_result_load;
   search_result_class->create_intent = plugin_file_search_result_create_intent;
+  search_result_class->get_score = plugin_file_search_result_get_score;
 }
 
 static void
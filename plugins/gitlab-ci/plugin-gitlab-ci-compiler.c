@@ -34,12 +34,13 @@
 
 typedef struct
 {
-  PluginGitlabCiContext *context;
-  JsonNode              *root;
-  JsonNode              *defaults;
-  JsonNode              *top_variables;
-  GHashTable            *resolved;
-  GHashTable            *visiting;
+  PluginGitlabCiContext         *context;
+  PluginGitlabCiExpressionCache *expressions;
+  JsonNode                      *root;
+  JsonNode                      *defaults;
+  JsonNode                      *top_variables;
+  GHashTable                    *resolved;
+  GHashTable                    *visiting;
 } Compiler;
 
 static JsonNode *
@@ -599,6 +600,7 @@ rule_matches (Compiler  *compiler,
   condition = member (rule, "if");
   if (condition != NULL)
     {
+      g_autoptr(PluginGitlabCiExpression) parsed = NULL;
       const char *text = scalar (condition);
 
       if (text == NULL)
@@ -610,7 +612,8 @@ rule_matches (Compiler  *compiler,
           return FALSE;
         }
 
-      if (!plugin_gitlab_ci_expression_evaluate (text, compiler->context, &expression, error))
+      if (!(parsed = plugin_gitlab_ci_expression_cache_lookup (compiler->expressions, text, error)) ||
+          !plugin_gitlab_ci_expression_evaluate (parsed, compiler->context, compiler->expressions, &expression, error))
         return FALSE;
     }
 
@@ -1339,6 +1342,7 @@ plugin_gitlab_ci_compiler_compile (FoundryCiProvider      *provider,
     return NULL;
 
   compiler.context = context;
+  compiler.expressions = plugin_gitlab_ci_expression_cache_new ();
   compiler.root = root;
   compiler.defaults = member (root, "default");
   compiler.top_variables = member (root, "variables");
@@ -1383,12 +1387,14 @@ plugin_gitlab_ci_compiler_compile (FoundryCiProvider      *provider,
 
   g_clear_pointer (&compiler.resolved, g_hash_table_unref);
   g_clear_pointer (&compiler.visiting, g_hash_table_unref);
+  g_clear_pointer (&compiler.expressions, plugin_gitlab_ci_expression_cache_free);
 
   return g_steal_pointer (&pipeline);
 
 failure:
   g_clear_pointer (&compiler.resolved, g_hash_table_unref);
   g_clear_pointer (&compiler.visiting, g_hash_table_unref);
+  g_clear_pointer (&compiler.expressions, plugin_gitlab_ci_expression_cache_free);
 
   return NULL;
 }
@@ -26,9 +26,25 @@
 
 G_BEGIN_DECLS
 
-gboolean plugin_gitlab_ci_expression_evaluate (const char             *expression,
-                                               PluginGitlabCiContext  *context,
-                                               gboolean               *result,
-                                               GError                **error);
+typedef struct _PluginGitlabCiExpression      PluginGitlabCiExpression;
+typedef struct _PluginGitlabCiExpressionCache PluginGitlabCiExpressionCache;
+
+PluginGitlabCiExpression      *plugin_gitlab_ci_expression_new          (const char                     *expression,
+                                                                         GError                        **error);
+PluginGitlabCiExpression      *plugin_gitlab_ci_expression_ref          (PluginGitlabCiExpression       *self);
+void                           plugin_gitlab_ci_expression_unref        (PluginGitlabCiExpression       *self);
+gboolean                       plugin_gitlab_ci_expression_evaluate     (PluginGitlabCiExpression       *self,
+                                                                         PluginGitlabCiContext          *context,
+                                                                         PluginGitlabCiExpressionCache  *cache,
+                                                                         gboolean                       *result,
+                                                                         GError                        **error);
+PluginGitlabCiExpressionCache *plugin_gitlab_ci_expression_cache_new    (void);
+void                           plugin_gitlab_ci_expression_cache_free   (PluginGitlabCiExpressionCache  *cache);
+PluginGitlabCiExpression      *plugin_gitlab_ci_expression_cache_lookup (PluginGitlabCiExpressionCache  *cache,
+                                                                         const char                     *expression,
+                                                                         GError                        **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PluginGitlabCiExpression, plugin_gitlab_ci_expression_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PluginGitlabCiExpressionCache, plugin_gitlab_ci_expression_cache_free)
 
 G_END_DECLS
@@ -28,6 +28,17 @@
 #define PLUGIN_GITLAB_CI_EXPRESSION_MAX_LENGTH 8192
 #define PLUGIN_GITLAB_CI_REGEX_MAX_LENGTH      1024
 #define PLUGIN_GITLAB_CI_REGEX_MAX_INPUT       8192
+#define PLUGIN_GITLAB_CI_REGEX_CACHE_SIZE      1024
+
+/* Rule expressions are parsed once into a small tree which can then
+ * be evaluated against any number of variable sets. Large pipelines
+ * repeat the same `rules:if` across hundreds of jobs so the compiler
+ * keeps a PluginGitlabCiExpressionCache for the duration of a compile
+ * which holds both the parsed expressions and compiled regexes.
+ *
+ * Evaluation intentionally does not short-circuit `&&` and `||` so
+ * that invalid operands are reported regardless of the other side.
+ */
 
 typedef enum
 {
@@ -56,20 +67,56 @@ typedef struct
 
 typedef struct
 {
-  const char             *input;
-  const char             *cursor;
-  PluginGitlabCiContext  *context;
-  Token                   token;
-  GError                **error;
+  const char  *input;
+  const char  *cursor;
+  Token        token;
+  GError     **error;
 } Parser;
 
+typedef enum
+{
+  NODE_VALUE,
+  NODE_COMPARE,
+  NODE_AND,
+  NODE_OR,
+} NodeKind;
+
+typedef struct
+{
+  TokenKind  kind;
+  char      *text;
+} Operand;
+
+typedef struct _Node
+{
+  NodeKind       kind;
+  TokenKind      operation;
+  gsize          offset;
+  Operand        left;
+  Operand        right;
+  GRegex        *regex;
+  struct _Node  *children[2];
+} Node;
+
 typedef struct
 {
-  char     *string;
-  gboolean  is_null;
-  gboolean  is_regex;
+  const char *string;
+  gboolean    is_null;
+  gboolean    is_regex;
 } Value;
 
+struct _PluginGitlabCiExpression
+{
+  gatomicrefcount  ref_count;
+  Node            *root;
+};
+
+struct _PluginGitlabCiExpressionCache
+{
+  GHashTable *expressions;
+  GHashTable *regexes;
+};
+
 static void
 token_clear (Token *token)
 {
@@ -81,40 +128,87 @@ token_clear (Token *token)
 }
 
 static void
-value_clear (Value *value)
+node_free (Node *node)
 {
-  g_assert (value != NULL);
+  if (node == NULL)
+    return;
 
-  g_clear_pointer (&value->string, g_free);
+  g_clear_pointer (&node->left.text, g_free);
+  g_clear_pointer (&node->right.text, g_free);
+  g_clear_pointer (&node->regex, g_regex_unref);
+  g_clear_pointer (&node->children[0], node_free);
+  g_clear_pointer (&node->children[1], node_free);
+  g_free (node);
 }
 
-G_GNUC_PRINTF (2, 3)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Node, node_free)
+
+static Node *
+node_new (NodeKind kind,
+          gsize    offset)
+{
+  Node *node = g_new0 (Node, 1);
+
+  node->kind = kind;
+  node->offset = offset;
+
+  return node;
+}
+
+G_GNUC_PRINTF (3, 0)
 static void
-set_syntax_error (Parser     *parser,
-                  const char *format,
-                  ...)
+set_error_valist (GError     **error,
+                  gsize        offset,
+                  const char  *format,
+                  va_list      args)
 {
   g_autofree char *detail = NULL;
-  va_list args;
 
-  g_assert (parser != NULL);
   g_assert (format != NULL);
 
-  if (parser->error == NULL || *parser->error != NULL)
+  if (error == NULL || *error != NULL)
     return;
 
-  va_start (args, format);
   detail = g_strdup_vprintf (format, args);
-  va_end (args);
 
-  g_set_error (parser->error,
+  g_set_error (error,
                PLUGIN_GITLAB_CI_ERROR,
                PLUGIN_GITLAB_CI_ERROR_INVALID_DATA,
                "rule expression at byte %" G_GSIZE_FORMAT ": %s",
-               parser->token.offset,
+               offset,
                detail);
 }
 
+G_GNUC_PRINTF (3, 4)
+static void
+set_error (GError     **error,
+           gsize        offset,
+           const char  *format,
+           ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  set_error_valist (error, offset, format, args);
+  va_end (args);
+}
+
+G_GNUC_PRINTF (2, 3)
+static void
+set_syntax_error (Parser     *parser,
+                  const char *format,
+                  ...)
+{
+  va_list args;
+
+  g_assert (parser != NULL);
+  g_assert (format != NULL);
+
+  va_start (args, format);
+  set_error_valist (parser->error, parser->token.offset, format, args);
+  va_end (args);
+}
+
 static char *
 parse_quoted (Parser *parser,
               char    quote)
@@ -367,47 +461,23 @@ parser_next (Parser *parser)
     }
 }
 
-static gboolean parse_or (Parser   *parser,
-                          gboolean *result);
+static Node *parse_or (Parser *parser);
 
 static gboolean
-parse_value (Parser *parser,
-             Value  *value)
+parse_value (Parser  *parser,
+             Operand *operand)
 {
   g_assert (parser != NULL);
-  g_assert (value != NULL);
+  g_assert (operand != NULL);
 
   switch (parser->token.kind)
     {
     case TOKEN_VARIABLE:
-      {
-        const char *variable;
-
-        variable = plugin_gitlab_ci_context_get_variable (parser->context, parser->token.text);
-
-        if (variable == NULL)
-          value->is_null = TRUE;
-        else
-          value->string = g_strdup (variable);
-
-        parser_next (parser);
-
-        return TRUE;
-      }
-
     case TOKEN_STRING:
-      value->string = g_strdup (parser->token.text);
-      parser_next (parser);
-      return TRUE;
-
     case TOKEN_REGEX:
-      value->string = g_strdup (parser->token.text);
-      value->is_regex = TRUE;
-      parser_next (parser);
-      return TRUE;
-
     case TOKEN_NULL:
-      value->is_null = TRUE;
+      operand->kind = parser->token.kind;
+      operand->text = g_steal_pointer (&parser->token.text);
       parser_next (parser);
       return TRUE;
 
@@ -427,14 +497,6 @@ parse_value (Parser *parser,
     }
 }
 
-static gboolean
-value_truthy (Value *value)
-{
-  g_assert (value != NULL);
-
-  return !value->is_null && value->string != NULL && value->string[0] != '\0';
-}
-
 static gboolean
 regex_is_bounded (const char *pattern)
 {
@@ -455,19 +517,299 @@ regex_is_bounded (const char *pattern)
   return TRUE;
 }
 
-static gboolean
-compare_values (Parser    *parser,
-                Value     *left,
-                TokenKind  operation,
-                Value     *right,
-                gboolean  *result)
+static GRegex *
+compile_regex (const char  *pattern,
+               gsize        offset,
+               GError     **error)
 {
+  g_autoptr(GError) regex_error = NULL;
+  GRegex *regex;
+
+  g_assert (pattern != NULL);
+
+  if (!regex_is_bounded (pattern))
+    {
+      set_error (error, offset, "regular expression exceeds safety limits");
+      return NULL;
+    }
+
+  if (!(regex = g_regex_new (pattern, G_REGEX_OPTIMIZE, 0, &regex_error)))
+    {
+      set_error (error, offset, "invalid regular expression: %s", regex_error->message);
+      return NULL;
+    }
+
+  return regex;
+}
+
+static Node *
+parse_comparison (Parser *parser)
+{
+  g_autoptr(Node) node = NULL;
+
   g_assert (parser != NULL);
+
+  if (parser->token.kind == TOKEN_LPAREN)
+    {
+      parser_next (parser);
+
+      if (!(node = parse_or (parser)))
+        return NULL;
+
+      if (parser->token.kind != TOKEN_RPAREN)
+        {
+          set_syntax_error (parser, "expected ')'");
+          return NULL;
+        }
+
+      parser_next (parser);
+
+      return g_steal_pointer (&node);
+    }
+
+  node = node_new (NODE_VALUE, parser->token.offset);
+
+  if (!parse_value (parser, &node->left))
+    return NULL;
+
+  if (parser->token.kind != TOKEN_EQ &&
+      parser->token.kind != TOKEN_NE &&
+      parser->token.kind != TOKEN_MATCH &&
+      parser->token.kind != TOKEN_NOT_MATCH)
+    return g_steal_pointer (&node);
+
+  node->kind = NODE_COMPARE;
+  node->operation = parser->token.kind;
+
+  parser_next (parser);
+
+  if (!parse_value (parser, &node->right))
+    return NULL;
+
+  node->offset = parser->token.offset;
+
+  /* Constant patterns are compiled once here rather than on every
+   * evaluation. Patterns coming from variables go through the cache.
+   */
+  if ((node->operation == TOKEN_MATCH || node->operation == TOKEN_NOT_MATCH) &&
+      (node->right.kind == TOKEN_REGEX || node->right.kind == TOKEN_STRING) &&
+      !(node->regex = compile_regex (node->right.text, node->offset, parser->error)))
+    return NULL;
+
+  return g_steal_pointer (&node);
+}
+
+static Node *
+parse_binary (Parser    *parser,
+              TokenKind  operation,
+              NodeKind   kind,
+              Node    *(*parse_operand) (Parser *parser))
+{
+  g_autoptr(Node) left = NULL;
+
+  g_assert (parser != NULL);
+
+  if (!(left = parse_operand (parser)))
+    return NULL;
+
+  while (parser->token.kind == operation)
+    {
+      g_autoptr(Node) node = node_new (kind, parser->token.offset);
+
+      parser_next (parser);
+
+      if (!(node->children[1] = parse_operand (parser)))
+        return NULL;
+
+      node->children[0] = g_steal_pointer (&left);
+      left = g_steal_pointer (&node);
+    }
+
+  return g_steal_pointer (&left);
+}
+
+static Node *
+parse_and (Parser *parser)
+{
+  return parse_binary (parser, TOKEN_AND, NODE_AND, parse_comparison);
+}
+
+static Node *
+parse_or (Parser *parser)
+{
+  return parse_binary (parser, TOKEN_OR, NODE_OR, parse_and);
+}
+
+/**
+ * plugin_gitlab_ci_expression_new:
+ * @expression: the text of a `rules:if` expression
+ * @error: a location for a #GError
+ *
+ * Parses @expression so that it may be evaluated any number of times
+ * using plugin_gitlab_ci_expression_evaluate().
+ *
+ * Returns: (transfer full) (nullable): a #PluginGitlabCiExpression or
+ *   %NULL and @error is set
+ */
+PluginGitlabCiExpression *
+plugin_gitlab_ci_expression_new (const char  *expression,
+                                 GError     **error)
+{
+  PluginGitlabCiExpression *self;
+  Parser parser = { 0 };
+  Node *root;
+
+  g_return_val_if_fail (expression != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (strlen (expression) > PLUGIN_GITLAB_CI_EXPRESSION_MAX_LENGTH)
+    {
+      g_set_error (error,
+                   PLUGIN_GITLAB_CI_ERROR,
+                   PLUGIN_GITLAB_CI_ERROR_LIMIT_EXCEEDED,
+                   "rule expression exceeds %u bytes",
+                   PLUGIN_GITLAB_CI_EXPRESSION_MAX_LENGTH);
+      return NULL;
+    }
+
+  parser.input = expression;
+  parser.cursor = expression;
+  parser.error = error;
+  parser_next (&parser);
+
+  root = parse_or (&parser);
+
+  if (root != NULL && parser.token.kind != TOKEN_END)
+    {
+      set_syntax_error (&parser, "unexpected token");
+      g_clear_pointer (&root, node_free);
+    }
+
+  token_clear (&parser.token);
+
+  if (root == NULL)
+    return NULL;
+
+  self = g_new0 (PluginGitlabCiExpression, 1);
+  g_atomic_ref_count_init (&self->ref_count);
+  self->root = root;
+
+  return self;
+}
+
+PluginGitlabCiExpression *
+plugin_gitlab_ci_expression_ref (PluginGitlabCiExpression *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  g_atomic_ref_count_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+plugin_gitlab_ci_expression_unref (PluginGitlabCiExpression *self)
+{
+  g_return_if_fail (self != NULL);
+
+  if (!g_atomic_ref_count_dec (&self->ref_count))
+    return;
+
+  g_clear_pointer (&self->root, node_free);
+  g_free (self);
+}
+
+static void
+operand_resolve (const Operand         *operand,
+                 PluginGitlabCiContext *context,
+                 Value                 *value)
+{
+  g_assert (operand != NULL);
+  g_assert (context != NULL);
+  g_assert (value != NULL);
+
+  switch (operand->kind)
+    {
+    case TOKEN_VARIABLE:
+      value->string = plugin_gitlab_ci_context_get_variable (context, operand->text);
+      value->is_null = value->string == NULL;
+      break;
+
+    case TOKEN_REGEX:
+      value->string = operand->text;
+      value->is_regex = TRUE;
+      break;
+
+    case TOKEN_STRING:
+      value->string = operand->text;
+      break;
+
+    case TOKEN_NULL:
+      value->is_null = TRUE;
+      break;
+
+    case TOKEN_END:
+    case TOKEN_EQ:
+    case TOKEN_NE:
+    case TOKEN_MATCH:
+    case TOKEN_NOT_MATCH:
+    case TOKEN_AND:
+    case TOKEN_OR:
+    case TOKEN_LPAREN:
+    case TOKEN_RPAREN:
+    case TOKEN_INVALID:
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static gboolean
+value_truthy (const Value *value)
+{
+  g_assert (value != NULL);
+
+  return !value->is_null && value->string != NULL && value->string[0] != '\0';
+}
+
+static GRegex *
+lookup_regex (PluginGitlabCiExpressionCache  *cache,
+              const char                     *pattern,
+              gsize                           offset,
+              GError                        **error)
+{
+  GRegex *regex;
+
+  g_assert (pattern != NULL);
+
+  if (cache == NULL)
+    return compile_regex (pattern, offset, error);
+
+  if ((regex = g_hash_table_lookup (cache->regexes, pattern)))
+    return g_regex_ref (regex);
+
+  if (!(regex = compile_regex (pattern, offset, error)))
+    return NULL;
+
+  if (g_hash_table_size (cache->regexes) < PLUGIN_GITLAB_CI_REGEX_CACHE_SIZE)
+    g_hash_table_insert (cache->regexes, g_strdup (pattern), g_regex_ref (regex));
+
+  return regex;
+}
+
+static gboolean
+compare_values (const Node                     *node,
+                const Value                    *left,
+                const Value                    *right,
+                PluginGitlabCiExpressionCache  *cache,
+                gboolean                       *result,
+                GError                        **error)
+{
+  g_assert (node != NULL);
   g_assert (left != NULL);
   g_assert (right != NULL);
   g_assert (result != NULL);
 
-  switch (operation)
+  switch (node->operation)
     {
     case TOKEN_EQ:
       *result = left->is_null == right->is_null &&
@@ -483,36 +825,33 @@ compare_values (Parser    *parser,
     case TOKEN_NOT_MATCH:
       {
         g_autoptr(GRegex) regex = NULL;
-        g_autoptr(GError) regex_error = NULL;
         gboolean matched;
 
-        if (right->is_null || right->string == NULL)
+        if (node->regex != NULL)
           {
-            set_syntax_error (parser, "regular-expression operand is null");
-            return FALSE;
+            regex = g_regex_ref (node->regex);
           }
-
-        if (!regex_is_bounded (right->string))
+        else
           {
-            set_syntax_error (parser, "regular expression exceeds safety limits");
-            return FALSE;
+            if (right->is_null || right->string == NULL)
+              {
+                set_error (error, node->offset, "regular-expression operand is null");
+                return FALSE;
+              }
+
+            if (!(regex = lookup_regex (cache, right->string, node->offset, error)))
+              return FALSE;
           }
 
         if (left->string != NULL && strlen (left->string) > PLUGIN_GITLAB_CI_REGEX_MAX_INPUT)
           {
-            set_syntax_error (parser, "regular-expression input exceeds safety limits");
-            return FALSE;
-          }
-
-        if (!(regex = g_regex_new (right->string, G_REGEX_OPTIMIZE, 0, &regex_error)))
-          {
-            set_syntax_error (parser, "invalid regular expression: %s", regex_error->message);
+            set_error (error, node->offset, "regular-expression input exceeds safety limits");
             return FALSE;
           }
 
         matched = !left->is_null &&
                   g_regex_match (regex, left->string != NULL ? left->string : "", 0, NULL);
-        *result = operation == TOKEN_MATCH ? matched : !matched;
+        *result = node->operation == TOKEN_MATCH ? matched : !matched;
 
         return TRUE;
       }
@@ -533,151 +872,146 @@ compare_values (Parser    *parser,
 }
 
 static gboolean
-parse_comparison (Parser   *parser,
-                  gboolean *result)
+node_evaluate (const Node                     *node,
+               PluginGitlabCiContext          *context,
+               PluginGitlabCiExpressionCache  *cache,
+               gboolean                       *result,
+               GError                        **error)
 {
-  Value left = { 0 };
-  Value right = { 0 };
-  TokenKind operation;
-  gboolean success = FALSE;
-
-  g_assert (parser != NULL);
+  g_assert (node != NULL);
+  g_assert (context != NULL);
   g_assert (result != NULL);
 
-  if (parser->token.kind == TOKEN_LPAREN)
+  switch (node->kind)
     {
-      parser_next (parser);
-
-      if (!parse_or (parser, result))
-        return FALSE;
-
-      if (parser->token.kind != TOKEN_RPAREN)
-        {
-          set_syntax_error (parser, "expected ')'");
-          return FALSE;
-        }
+    case NODE_VALUE:
+      {
+        Value value = { 0 };
 
-      parser_next (parser);
+        operand_resolve (&node->left, context, &value);
+        *result = value_truthy (&value);
 
-      return TRUE;
-    }
+        return TRUE;
+      }
 
-  if (!parse_value (parser, &left))
-    goto out;
+    case NODE_COMPARE:
+      {
+        Value left = { 0 };
+        Value right = { 0 };
 
-  if (parser->token.kind != TOKEN_EQ &&
-      parser->token.kind != TOKEN_NE &&
-      parser->token.kind != TOKEN_MATCH &&
-      parser->token.kind != TOKEN_NOT_MATCH)
-    {
-      *result = value_truthy (&left);
-      success = TRUE;
-      goto out;
-    }
+        operand_resolve (&node->left, context, &left);
+        operand_resolve (&node->right, context, &right);
 
-  operation = parser->token.kind;
-  parser_next (parser);
-  if (!parse_value (parser, &right))
-    goto out;
-  success = compare_values (parser, &left, operation, &right, result);
-
-out:
-  value_clear (&left);
-  value_clear (&right);
-  return success;
-}
+        return compare_values (node, &left, &right, cache, result, error);
+      }
 
-static gboolean
-parse_and (Parser   *parser,
-           gboolean *result)
-{
-  gboolean left;
+    case NODE_AND:
+    case NODE_OR:
+      {
+        gboolean left;
+        gboolean right;
 
-  g_assert (parser != NULL);
-  g_assert (result != NULL);
+        if (!node_evaluate (node->children[0], context, cache, &left, error) ||
+            !node_evaluate (node->children[1], context, cache, &right, error))
+          return FALSE;
 
-  if (!parse_comparison (parser, &left))
-    return FALSE;
+        *result = node->kind == NODE_AND ? (left && right) : (left || right);
 
-  while (parser->token.kind == TOKEN_AND)
-    {
-      gboolean right;
+        return TRUE;
+      }
 
-      parser_next (parser);
-      if (!parse_comparison (parser, &right))
-        return FALSE;
-      left = left && right;
+    default:
+      g_assert_not_reached ();
     }
-
-  *result = left;
-  return TRUE;
 }
 
-static gboolean
-parse_or (Parser   *parser,
-          gboolean *result)
+/**
+ * plugin_gitlab_ci_expression_evaluate:
+ * @self: a #PluginGitlabCiExpression
+ * @context: the context providing variables
+ * @cache: (nullable): a cache for regular expressions taken from variables
+ * @result: (out): location for the result
+ * @error: a location for a #GError
+ *
+ * Evaluates @self using the variables currently set in @context.
+ *
+ * Returns: %TRUE if @result was set, otherwise %FALSE and @error is set
+ */
+gboolean
+plugin_gitlab_ci_expression_evaluate (PluginGitlabCiExpression       *self,
+                                      PluginGitlabCiContext          *context,
+                                      PluginGitlabCiExpressionCache  *cache,
+                                      gboolean                       *result,
+                                      GError                        **error)
 {
-  gboolean left;
-
-  g_assert (parser != NULL);
-  g_assert (result != NULL);
-
-  if (!parse_and (parser, &left))
-    return FALSE;
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (context != NULL, FALSE);
+  g_return_val_if_fail (result != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
-  while (parser->token.kind == TOKEN_OR)
-    {
-      gboolean right;
+  return node_evaluate (self->root, context, cache, result, error);
+}
 
-      parser_next (parser);
-      if (!parse_and (parser, &right))
-        return FALSE;
-      left = left || right;
-    }
+PluginGitlabCiExpressionCache *
+plugin_gitlab_ci_expression_cache_new (void)
+{
+  PluginGitlabCiExpressionCache *cache;
+
+  cache = g_new0 (PluginGitlabCiExpressionCache, 1);
+  cache->expressions = g_hash_table_new_full (g_str_hash,
+                                              g_str_equal,
+                                              g_free,
+                                              (GDestroyNotify)plugin_gitlab_ci_expression_unref);
+  cache->regexes = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify)g_regex_unref);
+
+  return cache;
+}
 
-  *result = left;
+void
+plugin_gitlab_ci_expression_cache_free (PluginGitlabCiExpressionCache *cache)
+{
+  if (cache == NULL)
+    return;
 
-  return TRUE;
+  g_clear_pointer (&cache->expressions, g_hash_table_unref);
+  g_clear_pointer (&cache->regexes, g_hash_table_unref);
+  g_free (cache);
 }
 
-gboolean
-plugin_gitlab_ci_expression_evaluate (const char             *expression,
-                                      PluginGitlabCiContext  *context,
-                                      gboolean               *result,
-                                      GError                **error)
+/**
+ * plugin_gitlab_ci_expression_cache_lookup:
+ * @cache: a #PluginGitlabCiExpressionCache
+ * @expression: the text of a `rules:if` expression
+ * @error: a location for a #GError
+ *
+ * Like plugin_gitlab_ci_expression_new() but returns the previously
+ * parsed expression if @expression has been seen before.
+ *
+ * Returns: (transfer full) (nullable): a #PluginGitlabCiExpression or
+ *   %NULL and @error is set
+ */
+PluginGitlabCiExpression *
+plugin_gitlab_ci_expression_cache_lookup (PluginGitlabCiExpressionCache  *cache,
+                                          const char                     *expression,
+                                          GError                        **error)
 {
-  Parser parser = { 0 };
-  gboolean success;
+  PluginGitlabCiExpression *self;
 
-  g_return_val_if_fail (expression != NULL, FALSE);
-  g_return_val_if_fail (context != NULL, FALSE);
-  g_return_val_if_fail (result != NULL, FALSE);
-  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail (cache != NULL, NULL);
+  g_return_val_if_fail (expression != NULL, NULL);
 
-  if (strlen (expression) > PLUGIN_GITLAB_CI_EXPRESSION_MAX_LENGTH)
-    {
-      g_set_error (error,
-                   PLUGIN_GITLAB_CI_ERROR,
-                   PLUGIN_GITLAB_CI_ERROR_LIMIT_EXCEEDED,
-                   "rule expression exceeds %u bytes",
-                   PLUGIN_GITLAB_CI_EXPRESSION_MAX_LENGTH);
-      return FALSE;
-    }
-
-  parser.input = expression;
-  parser.cursor = expression;
-  parser.context = context;
-  parser.error = error;
-  parser_next (&parser);
-  success = parse_or (&parser, result);
+  if ((self = g_hash_table_lookup (cache->expressions, expression)))
+    return plugin_gitlab_ci_expression_ref (self);
 
-  if (success && parser.token.kind != TOKEN_END)
-    {
-      set_syntax_error (&parser, "unexpected token");
-      success = FALSE;
-    }
+  if (!(self = plugin_gitlab_ci_expression_new (expression, error)))
+    return NULL;
 
-  token_clear (&parser.token);
+  g_hash_table_insert (cache->expressions,
+                       g_strdup (expression),
+                       plugin_gitlab_ci_expression_ref (self));
 
-  return success;
+  return self;
 }
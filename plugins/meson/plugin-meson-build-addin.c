@@ -28,6 +28,8 @@
 #include "plugin-meson-install-stage.h"
 #include "plugin-meson-introspection-stage.h"
 
+#include "foundry-build-stage-private.h"
+
 struct _PluginMesonBuildAddin
 {
   FoundryBuildAddin  parent_instance;
@@ -97,6 +99,7 @@ plugin_meson_build_addin_load (FoundryBuildAddin *build_addin)
                                           "kind", "meson",
                                           "title", _("Extract Project Information"),
                                           NULL);
+      _foundry_build_stage_add_dependency (self->introspection, self->config);
       foundry_build_pipeline_add_stage (pipeline, self->introspection);
     }
 
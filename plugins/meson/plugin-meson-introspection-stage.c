@@ -20,18 +20,69 @@
 
 #include "config.h"
 
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
 #include "plugin-meson-build-target.h"
 #include "plugin-meson-introspection-stage.h"
 #include "plugin-meson-test.h"
 
+#include "foundry-build-stage-private.h"
+
+/*
+ * Meson writes the same information that `meson introspect --all`
+ * provides into `meson-info/intro-*.json` within the build directory
+ * whenever the project is configured. Rather than spawning meson (which
+ * can be rather slow inside of an SDK) we read only the sections we
+ * need from there on a worker thread.
+ *
+ * Parsed sections are cached along with the mtime of the file they were
+ * loaded from. A file monitor on the meson-info directory drops cached
+ * sections as soon as meson rewrites them.
+ */
+
+typedef struct _Section
+{
+  JsonNode *node;
+  gint64    mtime;
+} Section;
+
 struct _PluginMesonIntrospectionStage
 {
   PluginMesonBaseStage  parent_instance;
-  JsonNode             *introspection;
+  GMutex                mutex;
+  GHashTable           *sections;
+  DexFuture            *monitor;
 };
 
 G_DEFINE_FINAL_TYPE (PluginMesonIntrospectionStage, plugin_meson_introspection_stage, PLUGIN_TYPE_MESON_BASE_STAGE)
 
+static void
+section_free (Section *section)
+{
+  g_clear_pointer (&section->node, json_node_unref);
+  g_free (section);
+}
+
+static char *
+plugin_meson_introspection_stage_dup_info_dir (PluginMesonIntrospectionStage *self)
+{
+  g_autofree char *builddir = plugin_meson_base_stage_dup_builddir (PLUGIN_MESON_BASE_STAGE (self));
+
+  return g_build_filename (builddir, "meson-info", NULL);
+}
+
+static void
+plugin_meson_introspection_stage_clear (PluginMesonIntrospectionStage *self)
+{
+  g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
+
+  g_mutex_lock (&self->mutex);
+  g_hash_table_remove_all (self->sections);
+  g_mutex_unlock (&self->mutex);
+}
+
 static FoundryBuildPipelinePhase
 plugin_meson_introspection_stage_get_phase (FoundryBuildStage *stage)
 {
@@ -39,75 +90,171 @@ plugin_meson_introspection_stage_get_phase (FoundryBuildStage *stage)
 }
 
 static DexFuture *
-plugin_meson_introspection_stage_run_fiber (gpointer user_data)
+plugin_meson_introspection_stage_monitor_fiber (gpointer user_data)
+{
+  GWeakRef *wr = user_data;
+  g_autoptr(FoundryFileMonitor) monitor = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) directory = NULL;
+  gpointer ptr;
+
+  {
+    g_autoptr(PluginMesonIntrospectionStage) self = g_weak_ref_get (wr);
+    g_autofree char *info_dir = NULL;
+
+    if (self == NULL)
+      return foundry_future_new_disposed ();
+
+    info_dir = plugin_meson_introspection_stage_dup_info_dir (self);
+    directory = g_file_new_for_path (info_dir);
+  }
+
+  if (!(monitor = foundry_file_monitor_new (directory, &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  while ((ptr = dex_await_object (foundry_file_monitor_next (monitor), &error)))
+    {
+      g_autoptr(PluginMesonIntrospectionStage) self = g_weak_ref_get (wr);
+      g_autoptr(FoundryFileMonitorEvent) event = ptr;
+      g_autoptr(GFile) file = foundry_file_monitor_event_dup_file (event);
+      g_autofree char *name = g_file_get_basename (file);
+
+      if (self == NULL)
+        break;
+
+      if (g_str_has_prefix (name, "intro-") && g_str_has_suffix (name, ".json"))
+        {
+          g_autofree char *section = g_strndup (name + strlen ("intro-"),
+                                                strlen (name) - strlen ("intro-") - strlen (".json"));
+
+          g_mutex_lock (&self->mutex);
+          g_hash_table_remove (self->sections, section);
+          g_mutex_unlock (&self->mutex);
+        }
+    }
+
+  foundry_file_monitor_cancel (monitor);
+
+  return dex_future_new_true ();
+}
+
+static void
+plugin_meson_introspection_stage_ensure_monitor (PluginMesonIntrospectionStage *self)
+{
+  g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
+
+  if (self->monitor != NULL && dex_future_is_pending (self->monitor))
+    return;
+
+  dex_clear (&self->monitor);
+  self->monitor = dex_scheduler_spawn (NULL, 0,
+                                       plugin_meson_introspection_stage_monitor_fiber,
+                                       foundry_weak_ref_new (self),
+                                       (GDestroyNotify) foundry_weak_ref_free);
+}
+
+static DexFuture *
+plugin_meson_introspection_stage_load_section_fiber (PluginMesonIntrospectionStage *self,
+                                                     const char                    *info_dir,
+                                                     const char                    *section)
 {
-  PluginMesonIntrospectionStage *self = user_data;
-  g_autoptr(FoundryProcessLauncher) launcher = NULL;
-  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
-  g_autoptr(GSubprocess) subprocess = NULL;
   g_autoptr(JsonParser) parser = NULL;
-  g_autoptr(GIOStream) io_stream = NULL;
   g_autoptr(GError) error = NULL;
-  GInputStream *input_stream;
-  g_autofree char *builddir = NULL;
-  g_autofree char *meson = NULL;
+  g_autofree char *name = NULL;
+  g_autofree char *path = NULL;
+  Section *cached;
   JsonNode *root;
+  GStatBuf st;
+  gint64 mtime;
 
   g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
+  g_assert (info_dir != NULL);
+  g_assert (section != NULL);
 
-  builddir = plugin_meson_base_stage_dup_builddir (PLUGIN_MESON_BASE_STAGE (self));
-  meson = plugin_meson_base_stage_dup_meson (PLUGIN_MESON_BASE_STAGE (self));
+  name = g_strdup_printf ("intro-%s.json", section);
+  path = g_build_filename (info_dir, name, NULL);
 
-  if (!(pipeline = foundry_build_stage_dup_pipeline (FOUNDRY_BUILD_STAGE (self))))
-    return foundry_future_new_disposed ();
+  if (g_stat (path, &st) != 0)
+    {
+      int errsv = errno;
+      return dex_future_new_reject (G_IO_ERROR,
+                                    g_io_error_from_errno (errsv),
+                                    "%s", g_strerror (errsv));
+    }
 
-  g_assert (builddir != NULL);
-  g_assert (meson != NULL);
-  g_assert (FOUNDRY_IS_BUILD_PIPELINE (pipeline));
+  mtime = (gint64)st.st_mtim.tv_sec * G_USEC_PER_SEC + st.st_mtim.tv_nsec / 1000;
 
-  launcher = foundry_process_launcher_new ();
-  if (!dex_await (foundry_build_pipeline_prepare (pipeline, launcher, FOUNDRY_BUILD_PIPELINE_PHASE_CONFIGURE), &error))
-    return dex_future_new_for_error (g_steal_pointer (&error));
+  g_mutex_lock (&self->mutex);
+  if ((cached = g_hash_table_lookup (self->sections, section)) && cached->mtime == mtime)
+    {
+      JsonNode *node = json_node_ref (cached->node);
+      g_mutex_unlock (&self->mutex);
+      return dex_future_new_take_boxed (JSON_TYPE_NODE, node);
+    }
+  g_mutex_unlock (&self->mutex);
 
-  foundry_process_launcher_set_cwd (launcher, builddir);
-  foundry_process_launcher_append_argv (launcher, meson);
-  foundry_process_launcher_append_argv (launcher, "introspect");
-  foundry_process_launcher_append_argv (launcher, "--all");
-  foundry_process_launcher_append_argv (launcher, "--force-object-output");
+  parser = json_parser_new_immutable ();
 
-  if (!(io_stream = foundry_process_launcher_create_stdio_stream (launcher, &error)))
+  if (!json_parser_load_from_mapped_file (parser, path, &error))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
-  if (!(subprocess = foundry_process_launcher_spawn (launcher, &error)))
-    return dex_future_new_for_error (g_steal_pointer (&error));
+  if (!(root = json_parser_get_root (parser)))
+    return dex_future_new_reject (G_IO_ERROR,
+                                  G_IO_ERROR_INVALID_DATA,
+                                  "Invalid data in \"%s\"", name);
 
-  dex_future_disown (dex_subprocess_wait_check (subprocess));
+  cached = g_new0 (Section, 1);
+  cached->node = json_node_ref (root);
+  cached->mtime = mtime;
 
-  input_stream = g_io_stream_get_input_stream (io_stream);
-  parser = json_parser_new ();
+  g_mutex_lock (&self->mutex);
+  g_hash_table_replace (self->sections, g_strdup (section), cached);
+  g_mutex_unlock (&self->mutex);
 
-  if (!dex_await (foundry_json_parser_load_from_stream (parser, input_stream), &error))
-    return dex_future_new_for_error (g_steal_pointer (&error));
+  return dex_future_new_take_boxed (JSON_TYPE_NODE, json_node_ref (root));
+}
 
-  root = json_parser_get_root (parser);
+/*
+ * Resolves to the JsonNode found in `meson-info/intro-$section.json`.
+ */
+static DexFuture *
+plugin_meson_introspection_stage_load_section (PluginMesonIntrospectionStage *self,
+                                               const char                    *section)
+{
+  g_autofree char *info_dir = NULL;
 
-  g_clear_pointer (&self->introspection, json_node_unref);
+  g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
+  g_assert (section != NULL);
 
-  if (root != NULL)
-    self->introspection = json_node_ref (root);
+  info_dir = plugin_meson_introspection_stage_dup_info_dir (self);
 
-  return dex_future_new_true ();
+  plugin_meson_introspection_stage_ensure_monitor (self);
+
+  return FOUNDRY_SCHEDULER_SPAWN (dex_thread_pool_scheduler_get_default (), 0,
+                                  plugin_meson_introspection_stage_load_section_fiber,
+                                  3,
+                                  PLUGIN_TYPE_MESON_INTROSPECTION_STAGE, self,
+                                  G_TYPE_STRING, info_dir,
+                                  G_TYPE_STRING, section);
 }
 
 static DexFuture *
-plugin_meson_introspection_stage_run (PluginMesonIntrospectionStage *self)
+plugin_meson_introspection_stage_build_fiber (gpointer user_data)
 {
+  PluginMesonIntrospectionStage *self = user_data;
+  g_autoptr(GError) error = NULL;
+
   g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
 
-  return dex_scheduler_spawn (NULL, 0,
-                              plugin_meson_introspection_stage_run_fiber,
-                              g_object_ref (self),
-                              g_object_unref);
+  /* Configuring will have rewritten meson-info/ so drop everything and
+   * make sure the sections we rely upon are there.
+   */
+  plugin_meson_introspection_stage_clear (self);
+
+  if (!dex_await (plugin_meson_introspection_stage_load_section (self, "targets"), &error))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  return dex_future_new_true ();
 }
 
 static DexFuture *
@@ -117,21 +264,26 @@ plugin_meson_introspection_stage_build (FoundryBuildStage    *stage,
   dex_return_error_if_fail (PLUGIN_IS_MESON_INTROSPECTION_STAGE (stage));
   dex_return_error_if_fail (FOUNDRY_IS_BUILD_PROGRESS (progress));
 
-  return plugin_meson_introspection_stage_run (PLUGIN_MESON_INTROSPECTION_STAGE (stage));
+  return dex_scheduler_spawn (NULL, 0,
+                              plugin_meson_introspection_stage_build_fiber,
+                              g_object_ref (stage),
+                              g_object_unref);
 }
 
 static DexFuture *
 plugin_meson_introspection_stage_query_fiber (gpointer user_data)
 {
   PluginMesonIntrospectionStage *self = user_data;
+  g_autofree char *info_dir = NULL;
+  g_autoptr(GFile) file = NULL;
 
   g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
 
-  if (self->introspection == NULL)
-    dex_await (plugin_meson_introspection_stage_run (self), NULL);
+  info_dir = plugin_meson_introspection_stage_dup_info_dir (self);
+  file = g_file_new_build_filename (info_dir, "meson-info.json", NULL);
 
   foundry_build_stage_set_completed (FOUNDRY_BUILD_STAGE (self),
-                                     self->introspection != NULL);
+                                     dex_await_boolean (dex_file_query_exists (file), NULL));
 
   return dex_future_new_true ();
 }
@@ -154,29 +306,18 @@ plugin_meson_introspection_stage_list_build_targets_fiber (gpointer data)
 {
   PluginMesonIntrospectionStage *self = data;
   g_autoptr(GListStore) store = NULL;
+  g_autoptr(JsonNode) targets = NULL;
   g_autoptr(GError) error = NULL;
-  JsonNode *root = data;
-  JsonObject *root_obj;
   JsonArray *targets_ar;
-  JsonNode *targets;
 
-  g_assert (root != NULL);
+  g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
 
-  if (!dex_await (foundry_build_stage_query (FOUNDRY_BUILD_STAGE (self)), &error))
+  if (!(targets = dex_await_boxed (plugin_meson_introspection_stage_load_section (self, "targets"), &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
 
-  if (self->introspection == NULL)
-    return dex_future_new_reject (G_IO_ERROR,
-                                  G_IO_ERROR_FAILED,
-                                  "No introspection data available");
-
   store = g_list_store_new (FOUNDRY_TYPE_BUILD_TARGET);
 
-  if (JSON_NODE_HOLDS_OBJECT (root) &&
-      (root_obj = json_node_get_object (root)) &&
-      json_object_has_member (root_obj, "targets") &&
-      (targets = json_object_get_member (root_obj, "targets")) &&
-      JSON_NODE_HOLDS_ARRAY (targets) &&
+  if (JSON_NODE_HOLDS_ARRAY (targets) &&
       (targets_ar = json_node_get_array (targets)))
     {
       guint length = json_array_get_length (targets_ar);
@@ -207,8 +348,20 @@ plugin_meson_introspection_stage_list_build_targets (FoundryBuildStage *stage)
 
   return dex_scheduler_spawn (NULL, 0,
                               plugin_meson_introspection_stage_list_build_targets_fiber,
-                              json_node_ref (self->introspection),
-                              (GDestroyNotify) json_node_unref);
+                              g_object_ref (self),
+                              g_object_unref);
+}
+
+static void
+plugin_meson_introspection_stage_dispose (GObject *object)
+{
+  PluginMesonIntrospectionStage *self = (PluginMesonIntrospectionStage *)object;
+
+  dex_clear (&self->monitor);
+
+  plugin_meson_introspection_stage_clear (self);
+
+  G_OBJECT_CLASS (plugin_meson_introspection_stage_parent_class)->dispose (object);
 }
 
 static void
@@ -216,7 +369,8 @@ plugin_meson_introspection_stage_finalize (GObject *object)
 {
   PluginMesonIntrospectionStage *self = (PluginMesonIntrospectionStage *)object;
 
-  g_clear_pointer (&self->introspection, json_node_unref);
+  g_clear_pointer (&self->sections, g_hash_table_unref);
+  g_mutex_clear (&self->mutex);
 
   G_OBJECT_CLASS (plugin_meson_introspection_stage_parent_class)->finalize (object);
 }
@@ -227,6 +381,7 @@ plugin_meson_introspection_stage_class_init (PluginMesonIntrospectionStageClass
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   FoundryBuildStageClass *build_stage_class = FOUNDRY_BUILD_STAGE_CLASS (klass);
 
+  object_class->dispose = plugin_meson_introspection_stage_dispose;
   object_class->finalize = plugin_meson_introspection_stage_finalize;
 
   build_stage_class->get_phase = plugin_meson_introspection_stage_get_phase;
@@ -238,35 +393,41 @@ plugin_meson_introspection_stage_class_init (PluginMesonIntrospectionStageClass
 static void
 plugin_meson_introspection_stage_init (PluginMesonIntrospectionStage *self)
 {
+  g_mutex_init (&self->mutex);
+  self->sections = g_hash_table_new_full (g_str_hash,
+                                          g_str_equal,
+                                          g_free,
+                                          (GDestroyNotify) section_free);
+
+  _foundry_build_stage_set_ordered (FOUNDRY_BUILD_STAGE (self), FALSE);
+  _foundry_build_stage_set_resources (FOUNDRY_BUILD_STAGE (self), FOUNDRY_BUILD_STAGE_RESOURCE_IO);
 }
 
 static DexFuture *
-plugin_meson_introspection_stage_list_tests_fiber (FoundryContext *context,
-                                                   JsonNode       *root,
-                                                   const char     *builddir)
+plugin_meson_introspection_stage_list_tests_fiber (PluginMesonIntrospectionStage *self,
+                                                   FoundryContext                *context)
 {
   g_autoptr(GListStore) store = NULL;
-  JsonObject *root_obj;
-  JsonArray *member_ar;
-  JsonNode *member;
+  g_autoptr(JsonNode) tests = NULL;
+  g_autoptr(GError) error = NULL;
+  JsonArray *tests_ar;
 
+  g_assert (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
   g_assert (FOUNDRY_IS_CONTEXT (context));
-  g_assert (root != NULL);
+
+  if (!(tests = dex_await_boxed (plugin_meson_introspection_stage_load_section (self, "tests"), &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
 
   store = g_list_store_new (FOUNDRY_TYPE_TEST);
 
-  if (JSON_NODE_HOLDS_OBJECT (root) &&
-      (root_obj = json_node_get_object (root))  &&
-      json_object_has_member (root_obj, "tests") &&
-      (member = json_object_get_member (root_obj, "tests")) &&
-      JSON_NODE_HOLDS_ARRAY (member) &&
-      (member_ar = json_node_get_array (member)))
+  if (JSON_NODE_HOLDS_ARRAY (tests) &&
+      (tests_ar = json_node_get_array (tests)))
     {
-      guint length = json_array_get_length (member_ar);
+      guint length = json_array_get_length (tests_ar);
 
       for (guint i = 0; i < length; i++)
         {
-          JsonNode *element = json_array_get_element (member_ar, i);
+          JsonNode *element = json_array_get_element (tests_ar, i);
 
           if (JSON_NODE_HOLDS_OBJECT (element))
             {
@@ -284,20 +445,14 @@ DexFuture *
 plugin_meson_introspection_stage_list_tests (PluginMesonIntrospectionStage *self)
 {
   g_autoptr(FoundryContext) context = NULL;
-  g_autofree char *builddir = NULL;
 
   dex_return_error_if_fail (PLUGIN_IS_MESON_INTROSPECTION_STAGE (self));
 
-  if (self->introspection == NULL)
-    return foundry_future_new_not_supported ();
-
   context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self));
-  builddir = plugin_meson_base_stage_dup_builddir (PLUGIN_MESON_BASE_STAGE (self));
 
-  return FOUNDRY_SCHEDULER_SPAWN (dex_thread_pool_scheduler_get_default (), 0,
+  return FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
                                   plugin_meson_introspection_stage_list_tests_fiber,
                                   2,
-                                  FOUNDRY_TYPE_CONTEXT, context,
-                                  JSON_TYPE_NODE, self->introspection,
-                                  G_TYPE_STRING, builddir);
+                                  PLUGIN_TYPE_MESON_INTROSPECTION_STAGE, self,
+                                  FOUNDRY_TYPE_CONTEXT, context);
 }
@@ -30,6 +30,8 @@
 #include <foundry.h>
 #include <foundry-soup.h>
 
+#include "foundry-llm-manager-private.h"
+
 #include "plugin-ollama-client.h"
 #include "plugin-ollama-llm-model.h"
 
@@ -282,24 +284,43 @@ plugin_ollama_client_list_models (PluginOllamaClient *self)
 }
 
 static DexFuture *
-plugin_ollama_client_post_fiber (SoupSession *session,
-                                 const char  *url,
-                                 const char  *api_key,
-                                 gboolean     use_tls,
-                                 JsonNode    *body)
+plugin_ollama_client_post_fiber (SoupSession             *session,
+                                 const char              *url,
+                                 const char              *api_key,
+                                 gboolean                 use_tls,
+                                 JsonNode                *body,
+                                 FoundryLlmResponseCache *cache)
 {
   g_autoptr(GOutputStream) output = NULL;
+  g_autoptr(GInputStream) response_stream = NULL;
   g_autoptr(GInputStream) input = NULL;
   g_autoptr(SoupMessage) message = NULL;
   g_autoptr(GBytes) bytes = NULL;
   g_autoptr(GError) error = NULL;
+  g_autofree char *key = NULL;
   g_autofd int read_fd = -1;
   g_autofd int write_fd = -1;
   SoupMessageHeaders *headers;
+  guint status_code;
 
   g_assert (SOUP_IS_SESSION (session));
   g_assert (url != NULL);
   g_assert (body != NULL);
+  g_assert (!cache || FOUNDRY_IS_LLM_RESPONSE_CACHE (cache));
+
+  if (cache != NULL)
+    {
+      key = foundry_llm_response_cache_dup_key (url, body);
+
+      if ((input = dex_await_object (foundry_llm_response_cache_lookup (cache, key), NULL)))
+        return dex_future_new_take_object (g_steal_pointer (&input));
+
+      if (foundry_llm_response_cache_get_mode (cache) == FOUNDRY_LLM_RESPONSE_CACHE_REPLAY)
+        return dex_future_new_reject (G_IO_ERROR,
+                                      G_IO_ERROR_NOT_FOUND,
+                                      "No recorded response for request to `%s`",
+                                      url);
+    }
 
   if (!(bytes = dex_await_boxed (foundry_json_node_to_bytes (body), &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
@@ -320,18 +341,45 @@ plugin_ollama_client_post_fiber (SoupSession *session,
       soup_message_headers_append (headers, "Authorization", auth_header);
     }
 
-  soup_session_send_and_splice_async (session,
-                                      message,
-                                      output,
-                                      G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-                                      G_PRIORITY_DEFAULT,
-                                      NULL, NULL, NULL);
-
   if (debug_jsonrpc)
     FOUNDRY_DUMP_BYTES (ollama,
                         ((const char *)g_bytes_get_data (bytes, NULL)),
                         g_bytes_get_size (bytes));
 
+  if (cache == NULL)
+    {
+      soup_session_send_and_splice_async (session,
+                                          message,
+                                          output,
+                                          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                          G_PRIORITY_DEFAULT,
+                                          NULL, NULL, NULL);
+
+      return dex_future_new_take_object (g_steal_pointer (&input));
+    }
+
+  /* Wait for the status so that error replies are never recorded */
+  if (!(response_stream = dex_await_object (foundry_soup_session_send (session, message), &error)))
+    return dex_future_new_for_error (g_steal_pointer (&error));
+
+  status_code = soup_message_get_status (message);
+
+  if (status_code >= 200 && status_code < 300)
+    {
+      g_clear_object (&input);
+
+      if (!(input = foundry_llm_response_cache_record (cache, key, response_stream, &error)))
+        return dex_future_new_for_error (g_steal_pointer (&error));
+
+      return dex_future_new_take_object (g_steal_pointer (&input));
+    }
+
+  g_output_stream_splice_async (output,
+                                response_stream,
+                                G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+                                G_PRIORITY_DEFAULT,
+                                NULL, NULL, NULL);
+
   return dex_future_new_take_object (g_steal_pointer (&input));
 }
 
@@ -350,12 +398,21 @@ plugin_ollama_client_post (PluginOllamaClient *self,
                            const char         *path,
                            JsonNode           *body)
 {
+  g_autoptr(FoundryLlmResponseCache) cache = NULL;
+  g_autoptr(FoundryContext) context = NULL;
   g_autofree char *url = NULL;
 
   dex_return_error_if_fail (PLUGIN_IS_OLLAMA_CLIENT (self));
   dex_return_error_if_fail (path != NULL);
   dex_return_error_if_fail (body != NULL);
 
+  if ((context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self))))
+    {
+      g_autoptr(FoundryLlmManager) llm_manager = foundry_context_dup_llm_manager (context);
+
+      cache = _foundry_llm_manager_dup_response_cache (llm_manager);
+    }
+
   if (g_str_has_suffix (self->url_base, "/"))
     {
       while (path[0] == '/')
@@ -366,10 +423,11 @@ plugin_ollama_client_post (PluginOllamaClient *self,
 
   return FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
                                   plugin_ollama_client_post_fiber,
-                                  5,
+                                  6,
                                   SOUP_TYPE_SESSION, self->session,
                                   G_TYPE_STRING, url,
                                   G_TYPE_STRING, self->api_key,
                                   G_TYPE_BOOLEAN, self->use_tls,
-                                  JSON_TYPE_NODE, body);
+                                  JSON_TYPE_NODE, body,
+                                  FOUNDRY_TYPE_LLM_RESPONSE_CACHE, cache);
 }
@@ -30,6 +30,8 @@
 #include <foundry.h>
 #include <foundry-soup.h>
 
+#include "foundry-llm-manager-private.h"
+
 #include "plugin-openai-client.h"
 #include "plugin-openai-llm-model.h"
 
@@ -336,10 +338,11 @@ plugin_openai_client_list_models (PluginOpenaiClient *self)
 }
 
 static DexFuture *
-plugin_openai_client_post_fiber (SoupSession *session,
-                                 const char  *url,
-                                 const char  *api_key,
-                                 JsonNode    *body_node)
+plugin_openai_client_post_fiber (SoupSession             *session,
+                                 const char              *url,
+                                 const char              *api_key,
+                                 JsonNode                *body_node,
+                                 FoundryLlmResponseCache *cache)
 {
   g_autoptr(GOutputStream) output = NULL;
   g_autoptr(GInputStream) response_stream = NULL;
@@ -347,6 +350,7 @@ plugin_openai_client_post_fiber (SoupSession *session,
   g_autoptr(SoupMessage) message = NULL;
   g_autoptr(GBytes) bytes = NULL;
   g_autoptr(GError) error = NULL;
+  g_autofree char *key = NULL;
   g_autofd int read_fd = -1;
   g_autofd int write_fd = -1;
   SoupMessageHeaders *headers;
@@ -356,6 +360,21 @@ plugin_openai_client_post_fiber (SoupSession *session,
   g_assert (url != NULL);
   g_assert (body_node != NULL);
   g_assert (api_key != NULL);
+  g_assert (!cache || FOUNDRY_IS_LLM_RESPONSE_CACHE (cache));
+
+  if (cache != NULL)
+    {
+      key = foundry_llm_response_cache_dup_key (url, body_node);
+
+      if ((input = dex_await_object (foundry_llm_response_cache_lookup (cache, key), NULL)))
+        return dex_future_new_take_object (g_steal_pointer (&input));
+
+      if (foundry_llm_response_cache_get_mode (cache) == FOUNDRY_LLM_RESPONSE_CACHE_REPLAY)
+        return dex_future_new_reject (G_IO_ERROR,
+                                      G_IO_ERROR_NOT_FOUND,
+                                      "No recorded response for request to `%s`",
+                                      url);
+    }
 
   if (!(bytes = dex_await_boxed (foundry_json_node_to_bytes (body_node), &error)))
     return dex_future_new_for_error (g_steal_pointer (&error));
@@ -400,6 +419,21 @@ plugin_openai_client_post_fiber (SoupSession *session,
                                     error_body ? error_body : soup_status_get_phrase (status_code));
     }
 
+  if (debug_jsonrpc)
+    FOUNDRY_DUMP_BYTES (openai,
+                        ((const char *)g_bytes_get_data (bytes, NULL)),
+                        g_bytes_get_size (bytes));
+
+  if (cache != NULL)
+    {
+      g_clear_object (&input);
+
+      if (!(input = foundry_llm_response_cache_record (cache, key, response_stream, &error)))
+        return dex_future_new_for_error (g_steal_pointer (&error));
+
+      return dex_future_new_take_object (g_steal_pointer (&input));
+    }
+
   /* Splice the response body to our pipe in the background */
   g_output_stream_splice_async (output,
                                 response_stream,
@@ -409,11 +443,6 @@ plugin_openai_client_post_fiber (SoupSession *session,
                                 NULL,
                                 NULL);
 
-  if (debug_jsonrpc)
-    FOUNDRY_DUMP_BYTES (openai,
-                        ((const char *)g_bytes_get_data (bytes, NULL)),
-                        g_bytes_get_size (bytes));
-
   return dex_future_new_take_object (g_steal_pointer (&input));
 }
 
@@ -451,6 +480,8 @@ static DexFuture *
 plugin_openai_client_post_after_key_fiber (gpointer user_data)
 {
   PostState *state = user_data;
+  g_autoptr(FoundryLlmResponseCache) cache = NULL;
+  g_autoptr(FoundryContext) context = NULL;
   g_autofree char *url = NULL;
   g_autofree char *api_key = NULL;
   g_autoptr(GError) error = NULL;
@@ -477,13 +508,21 @@ plugin_openai_client_post_after_key_fiber (gpointer user_data)
       url = g_strconcat (state->client->url_base, state->path, NULL);
     }
 
+  if ((context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (state->client))))
+    {
+      g_autoptr(FoundryLlmManager) llm_manager = foundry_context_dup_llm_manager (context);
+
+      cache = _foundry_llm_manager_dup_response_cache (llm_manager);
+    }
+
   return FOUNDRY_SCHEDULER_SPAWN (NULL, 0,
                                   plugin_openai_client_post_fiber,
-                                  4,
+                                  5,
                                   SOUP_TYPE_SESSION, state->client->session,
                                   G_TYPE_STRING, url,
                                   G_TYPE_STRING, api_key,
-                                  JSON_TYPE_NODE, state->body);
+                                  JSON_TYPE_NODE, state->body,
+                                  FOUNDRY_TYPE_LLM_RESPONSE_CACHE, cache);
 }
 
 /**
@@ -23,6 +23,8 @@
 #include "plugin-sarif-build-stage.h"
 #include "plugin-sarif-service.h"
 
+#include "foundry-build-stage-private.h"
+
 struct _PluginSarifBuildStage
 {
   FoundryBuildStage parent_instance;
@@ -87,4 +89,7 @@ plugin_sarif_build_stage_class_init (PluginSarifBuildStageClass *klass)
 static void
 plugin_sarif_build_stage_init (PluginSarifBuildStage *self)
 {
+  /* Only resets the SARIF service, nothing else needs to wait on us */
+  _foundry_build_stage_set_ordered (FOUNDRY_BUILD_STAGE (self), FALSE);
+  _foundry_build_stage_set_resources (FOUNDRY_BUILD_STAGE (self), FOUNDRY_BUILD_STAGE_RESOURCE_NONE);
 }
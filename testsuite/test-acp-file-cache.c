@@ -0,0 +1,195 @@
+/* test-acp-file-cache.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <unistd.h>
+
+#include <foundry.h>
+
+#include "libfoundry/acp/foundry-acp-file-cache-private.h"
+
+#include "test-util.h"
+
+static FoundryContext *
+create_context (char **tmpdir)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *foundry_dir = NULL;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-acp-file-cache-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  foundry_dir = g_build_filename (*tmpdir, ".foundry", NULL);
+
+  context = dex_await_object (foundry_context_new (foundry_dir, *tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+
+  return g_steal_pointer (&context);
+}
+
+static GFile *
+create_file (const char *tmpdir,
+             const char *name,
+             const char *contents,
+             gssize      len)
+{
+  g_autofree char *path = g_build_filename (tmpdir, name, NULL);
+  g_autoptr(GError) error = NULL;
+
+  g_file_set_contents (path, contents, len, &error);
+  g_assert_no_error (error);
+
+  return g_file_new_for_path (path);
+}
+
+static void
+assert_read (FoundryAcpFileCache *cache,
+             GFile               *file,
+             guint                line,
+             guint                limit,
+             const char          *expected)
+{
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = NULL;
+  const char *data;
+  gsize len;
+
+  bytes = dex_await_boxed (foundry_acp_file_cache_read (cache, file, line, limit), &error);
+  g_assert_no_error (error);
+
+  data = g_bytes_get_data (bytes, &len);
+  contents = g_strndup (data ? data : "", len);
+  g_assert_cmpstr (contents, ==, expected);
+}
+
+static void
+apply_edit (FoundryTextBuffer *buffer,
+            GFile             *file,
+            const char        *replacement)
+{
+  g_autoptr(FoundryTextEdit) edit = foundry_text_edit_new (file, 1, 0, 1, 3, replacement);
+
+  g_assert_true (foundry_text_buffer_apply_edit (buffer, edit));
+}
+
+static void
+test_overlay_fiber (void)
+{
+  g_autoptr(FoundryAcpFileCache) cache = NULL;
+  g_autoptr(FoundryTextManager) text_manager = NULL;
+  g_autoptr(FoundryTextDocument) document = NULL;
+  g_autoptr(FoundryTextBuffer) buffer = NULL;
+  g_autoptr(FoundryOperation) operation = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autofree char *tmpdir = NULL;
+
+  context = create_context (&tmpdir);
+  file = create_file (tmpdir, "overlay.c", "one\ntwo\nthree\n", -1);
+  cache = foundry_acp_file_cache_new (context);
+
+  assert_read (cache, file, 2, 1, "two\n");
+
+  text_manager = foundry_context_dup_text_manager (context);
+  operation = foundry_operation_new ();
+  document = dex_await_object (foundry_text_manager_load (text_manager, file, operation, NULL), &error);
+  g_assert_no_error (error);
+  buffer = foundry_text_document_dup_buffer (document);
+
+  /* Unsaved edits in an open buffer take precedence over the disk */
+  apply_edit (buffer, file, "TWO");
+  assert_read (cache, file, 2, 1, "TWO\n");
+  assert_read (cache, file, 0, 0, "one\nTWO\nthree\n");
+
+  /* Further edits are noticed through the change count */
+  apply_edit (buffer, file, "2");
+  assert_read (cache, file, 2, 1, "2\n");
+
+  /* Once the buffer is closed the file on disk is served again */
+  g_clear_object (&buffer);
+  g_clear_object (&document);
+  assert_read (cache, file, 2, 1, "two\n");
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_overlay (void)
+{
+  test_from_fiber (test_overlay_fiber);
+}
+
+static void
+test_large_fiber (void)
+{
+  g_autoptr(FoundryAcpFileCache) cache = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GString) contents = g_string_new (NULL);
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *path = NULL;
+
+  context = create_context (&tmpdir);
+
+  /* Large enough to be read on demand rather than copied */
+  for (guint i = 1; i <= 50000; i++)
+    g_string_append_printf (contents, "line %u\n", i);
+
+  file = create_file (tmpdir, "large.txt", contents->str, contents->len);
+  cache = foundry_acp_file_cache_new (context);
+
+  assert_read (cache, file, 1, 1, "line 1\n");
+  assert_read (cache, file, 40000, 2, "line 40000\nline 40001\n");
+  assert_read (cache, file, 49999, 0, "line 49999\nline 50000\n");
+  assert_read (cache, file, 60000, 1, "");
+
+  /* Truncating the file must not fault and the new contents are used */
+  path = g_file_get_path (file);
+  g_assert_cmpint (truncate (path, strlen ("line 1\nline 2\n")), ==, 0);
+
+  assert_read (cache, file, 2, 0, "line 2\n");
+  assert_read (cache, file, 40000, 2, "");
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_large (void)
+{
+  test_from_fiber (test_large_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/AcpFileCache/overlay", test_overlay);
+  g_test_add_func ("/Foundry/AcpFileCache/large", test_large);
+  return g_test_run ();
+}
@@ -194,6 +194,99 @@ test_read_text_file (void)
   test_from_fiber (test_read_text_file_fiber);
 }
 
+static char *
+read_lines (FoundryAcpProjectClient *client,
+            FoundryAcpSession       *session,
+            guint                    line,
+            guint                    limit)
+{
+  g_autoptr(GError) error = NULL;
+  char *contents;
+
+  contents = dex_await_string (foundry_acp_client_read_text_file (FOUNDRY_ACP_CLIENT (client),
+                                                                  session,
+                                                                  "ranges.txt",
+                                                                  line,
+                                                                  limit),
+                               &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (contents);
+
+  return contents;
+}
+
+static void
+test_read_text_file_ranges_fiber (void)
+{
+  g_autoptr(FoundryAcpProjectClient) client = NULL;
+  g_autoptr(FoundryAcpSession) session = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GFile) project_directory = NULL;
+  g_autoptr(GFile) file = NULL;
+  g_autoptr(GString) all = NULL;
+  g_autofree char *project_path = NULL;
+
+  project_path = g_dir_make_tmp ("foundry-acp-project-client-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  project_directory = g_file_new_for_path (project_path);
+  file = g_file_get_child (project_directory, "ranges.txt");
+
+  all = g_string_new (NULL);
+  for (guint i = 1; i <= 1000; i++)
+    g_string_append_printf (all, "line %u\n", i);
+  write_child_contents (project_directory, "ranges.txt", all->str);
+
+  client = foundry_acp_project_client_new_for_project_directory (project_directory);
+  session = g_object_new (FOUNDRY_TYPE_ACP_SESSION, NULL);
+
+  /* Out of order so the line index is extended, then reused */
+  for (guint i = 0; i < 2; i++)
+    {
+      g_autofree char *tail = read_lines (client, session, 998, 10);
+      g_autofree char *head = read_lines (client, session, 1, 2);
+      g_autofree char *middle = read_lines (client, session, 500, 3);
+      g_autofree char *past_end = read_lines (client, session, 2000, 1);
+      g_autofree char *whole = read_lines (client, session, 0, 0);
+
+      g_assert_cmpstr (tail, ==, "line 998\nline 999\nline 1000\n");
+      g_assert_cmpstr (head, ==, "line 1\nline 2\n");
+      g_assert_cmpstr (middle, ==, "line 500\nline 501\nline 502\n");
+      g_assert_cmpstr (past_end, ==, "");
+      g_assert_cmpstr (whole, ==, all->str);
+    }
+
+  /* Changed behind our back, picked up by size/mtime or the monitor */
+  write_child_contents (project_directory, "ranges.txt", "replaced\nfile\n");
+
+  {
+    g_autofree char *contents = read_lines (client, session, 2, 1);
+    g_assert_cmpstr (contents, ==, "file\n");
+  }
+
+  /* Written through the client, which drops the cached copy */
+  dex_await (foundry_acp_client_write_text_file (FOUNDRY_ACP_CLIENT (client),
+                                                 session,
+                                                 "ranges.txt",
+                                                 "written\nagain\n"),
+             &error);
+  g_assert_no_error (error);
+
+  {
+    g_autofree char *contents = read_lines (client, session, 1, 1);
+    g_assert_cmpstr (contents, ==, "written\n");
+  }
+
+  g_file_delete (file, NULL, NULL);
+  g_file_delete (project_directory, NULL, NULL);
+}
+
+static void
+test_read_text_file_ranges (void)
+{
+  test_from_fiber (test_read_text_file_ranges_fiber);
+}
+
 static void
 test_write_text_file_fiber (void)
 {
@@ -577,6 +670,7 @@ main (int   argc,
 
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Foundry/AcpProjectClient/read-text-file", test_read_text_file);
+  g_test_add_func ("/Foundry/AcpProjectClient/read-text-file-ranges", test_read_text_file_ranges);
   g_test_add_func ("/Foundry/AcpProjectClient/write-text-file", test_write_text_file);
   g_test_add_func ("/Foundry/AcpProjectClient/write-outside-project",
                    test_write_outside_project);
@@ -0,0 +1,154 @@
+/*
+ * test-acp-terminal-scrollback.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/acp/foundry-acp-terminal-private.h"
+
+static void
+append (FoundryAcpTerminal *terminal,
+        const char         *text)
+{
+  g_autoptr(FoundryAcpTerminalOutput) output = NULL;
+
+  output = foundry_acp_terminal_output_new (text, FALSE, FALSE, 0, NULL);
+  _foundry_acp_terminal_apply_output (terminal, output);
+}
+
+static void
+on_scrollback_appended (FoundryAcpTerminal *terminal,
+                        GBytes             *delta,
+                        GString            *deltas)
+{
+  g_string_append_len (deltas,
+                       g_bytes_get_data (delta, NULL),
+                       g_bytes_get_size (delta));
+  g_string_append_c (deltas, '|');
+}
+
+static char *
+bytes_to_string (GBytes *bytes)
+{
+  gsize len;
+  const char *data = g_bytes_get_data (bytes, &len);
+
+  return g_strndup (data ? data : "", len);
+}
+
+static void
+test_unbounded (void)
+{
+  g_autoptr(FoundryAcpTerminal) terminal = foundry_acp_terminal_new ("term-1");
+  g_autoptr(GString) deltas = g_string_new (NULL);
+  g_autoptr(GBytes) range = NULL;
+  g_autoptr(GBytes) tail = NULL;
+  g_autofree char *scrollback = NULL;
+  g_autofree char *range_str = NULL;
+  g_autofree char *tail_str = NULL;
+
+  g_signal_connect (terminal, "scrollback-appended", G_CALLBACK (on_scrollback_appended), deltas);
+
+  append (terminal, "hello ");
+  append (terminal, "");
+  append (terminal, "world\n");
+
+  g_assert_cmpstr (deltas->str, ==, "hello |world\n|");
+  g_assert_cmpuint (foundry_acp_terminal_get_scrollback_length (terminal), ==, 12);
+  g_assert_cmpuint (foundry_acp_terminal_get_scrollback_start (terminal), ==, 0);
+
+  scrollback = foundry_acp_terminal_dup_scrollback (terminal);
+  g_assert_cmpstr (scrollback, ==, "hello world\n");
+
+  range = foundry_acp_terminal_dup_scrollback_range (terminal, 3, 5);
+  range_str = bytes_to_string (range);
+  g_assert_cmpstr (range_str, ==, "lo wo");
+
+  tail = foundry_acp_terminal_dup_scrollback_tail (terminal, 100);
+  tail_str = bytes_to_string (tail);
+  g_assert_cmpstr (tail_str, ==, "hello world\n");
+}
+
+static void
+test_byte_limit (void)
+{
+  g_autoptr(FoundryAcpTerminal) terminal = foundry_acp_terminal_new ("term-1");
+  g_autoptr(GString) expected = g_string_new (NULL);
+  g_autofree char *scrollback = NULL;
+  guint64 start;
+  gsize len;
+
+  _foundry_acp_terminal_set_output_byte_limit (terminal, 4096);
+
+  /* Write enough to cross several chunk boundaries */
+  for (guint i = 0; i < 2000; i++)
+    {
+      g_autofree char *line = g_strdup_printf ("line %u\n", i);
+
+      append (terminal, line);
+      g_string_append (expected, line);
+    }
+
+  len = foundry_acp_terminal_get_scrollback_length (terminal);
+  start = foundry_acp_terminal_get_scrollback_start (terminal);
+
+  g_assert_cmpuint (len, <=, 4096);
+  g_assert_cmpuint (start + len, ==, expected->len);
+  g_assert_true (foundry_acp_terminal_get_truncated (terminal));
+
+  scrollback = foundry_acp_terminal_dup_scrollback (terminal);
+  g_assert_cmpstr (scrollback, ==, expected->str + start);
+
+  /* Lowering the limit trims what is already retained */
+  _foundry_acp_terminal_set_output_byte_limit (terminal, 10);
+  g_assert_cmpuint (foundry_acp_terminal_get_scrollback_length (terminal), <=, 10);
+  g_assert_cmpuint (foundry_acp_terminal_get_scrollback_start (terminal) +
+                    foundry_acp_terminal_get_scrollback_length (terminal), ==, expected->len);
+}
+
+static void
+test_utf8_boundary (void)
+{
+  g_autoptr(FoundryAcpTerminal) terminal = foundry_acp_terminal_new ("term-1");
+  g_autofree char *scrollback = NULL;
+
+  _foundry_acp_terminal_set_output_byte_limit (terminal, 5);
+
+  /* Each "é" is two bytes so a five byte cut lands mid-character */
+  append (terminal, "éééé");
+
+  scrollback = foundry_acp_terminal_dup_scrollback (terminal);
+  g_assert_true (g_utf8_validate (scrollback, -1, NULL));
+  g_assert_cmpstr (scrollback, ==, "éé");
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/AcpTerminal/scrollback/unbounded", test_unbounded);
+  g_test_add_func ("/Foundry/AcpTerminal/scrollback/byte-limit", test_byte_limit);
+  g_test_add_func ("/Foundry/AcpTerminal/scrollback/utf8-boundary", test_utf8_boundary);
+
+  return g_test_run ();
+}
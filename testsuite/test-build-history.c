@@ -0,0 +1,308 @@
+/* test-build-history.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/build/foundry-build-history-private.h"
+#include "libfoundry/build/foundry-build-stage-private.h"
+
+#include "test-util.h"
+
+#define TEST_TYPE_STAGE (test_stage_get_type())
+G_DECLARE_FINAL_TYPE (TestStage, test_stage, TEST, STAGE, FoundryBuildStage)
+
+struct _TestStage
+{
+  FoundryBuildStage parent_instance;
+};
+
+G_DEFINE_FINAL_TYPE (TestStage, test_stage, FOUNDRY_TYPE_BUILD_STAGE)
+
+static FoundryBuildPipelinePhase
+test_stage_get_phase (FoundryBuildStage *stage)
+{
+  return FOUNDRY_BUILD_PIPELINE_PHASE_BUILD;
+}
+
+static void
+test_stage_class_init (TestStageClass *klass)
+{
+  FoundryBuildStageClass *build_stage_class = FOUNDRY_BUILD_STAGE_CLASS (klass);
+
+  build_stage_class->get_phase = test_stage_get_phase;
+}
+
+static void
+test_stage_init (TestStage *self)
+{
+}
+
+typedef struct
+{
+  GPtrArray *stages;
+  GPtrArray *records;
+} Run;
+
+static void
+run_init (Run *run)
+{
+  run->stages = g_ptr_array_new_with_free_func (g_object_unref);
+  run->records = g_ptr_array_new_with_free_func ((GDestroyNotify) _foundry_build_history_stage_unref);
+}
+
+static void
+run_clear (Run *run)
+{
+  g_clear_pointer (&run->records, g_ptr_array_unref);
+  g_clear_pointer (&run->stages, g_ptr_array_unref);
+}
+
+/* Adds a stage which ran from @begin for @wall_usec */
+static FoundryBuildStage *
+run_add (Run      *run,
+         gboolean  ordered,
+         gint64    begin,
+         gint64    wall_usec)
+{
+  FoundryBuildStage *stage = g_object_new (TEST_TYPE_STAGE, NULL);
+  FoundryBuildHistoryStage *record = _foundry_build_history_stage_new (stage);
+
+  _foundry_build_stage_set_ordered (stage, ordered);
+
+  record->begin = begin;
+  record->end = begin + wall_usec;
+  record->status = FOUNDRY_BUILD_HISTORY_STATUS_SUCCESS;
+
+  g_ptr_array_add (run->stages, stage);
+  g_ptr_array_add (run->records, record);
+
+  return stage;
+}
+
+static JsonNode *
+run_to_json (Run        *run,
+             const char *operation,
+             gboolean    sequential)
+{
+  g_autoptr(GDateTime) started_at = g_date_time_new_now_local ();
+
+  return _foundry_build_history_run_new (operation,
+                                         FOUNDRY_BUILD_PIPELINE_PHASE_BUILD,
+                                         started_at,
+                                         1,
+                                         1000,
+                                         (FoundryBuildHistoryStage * const *)run->records->pdata,
+                                         run->records->len,
+                                         sequential,
+                                         NULL);
+}
+
+static void
+assert_critical_path (JsonNode  *node,
+                      gint64     critical_usec,
+                      const int *path,
+                      guint      path_len)
+{
+  JsonObject *obj = json_node_get_object (node);
+  JsonArray *ar = json_object_get_array_member (obj, "critical-path");
+
+  g_assert_cmpint (json_object_get_int_member (obj, "critical-path-usec"), ==, critical_usec);
+  g_assert_cmpuint (json_array_get_length (ar), ==, path_len);
+
+  for (guint i = 0; i < path_len; i++)
+    g_assert_cmpint (json_array_get_int_element (ar, i), ==, path[i]);
+}
+
+static void
+test_critical_path_sequential (void)
+{
+  g_autoptr(JsonNode) node = NULL;
+  static const int path[] = { 0, 1, 2 };
+  Run run;
+
+  run_init (&run);
+
+  run_add (&run, TRUE, 1, 10);
+  run_add (&run, TRUE, 11, 20);
+  run_add (&run, TRUE, 31, 30);
+
+  node = run_to_json (&run, "clean", TRUE);
+  assert_critical_path (node, 60, path, G_N_ELEMENTS (path));
+
+  run_clear (&run);
+}
+
+static void
+test_critical_path_dependencies (void)
+{
+  g_autoptr(JsonNode) node = NULL;
+  static const int path[] = { 1, 3 };
+  FoundryBuildStage *a;
+  FoundryBuildStage *c;
+  JsonArray *stages;
+  JsonArray *deps;
+  Run run;
+
+  run_init (&run);
+
+  /* "b" runs alongside "a" and "c", and "d" waits for all of them */
+  a = run_add (&run, TRUE, 1, 10);
+  run_add (&run, FALSE, 1, 100);
+  c = run_add (&run, FALSE, 11, 20);
+  run_add (&run, TRUE, 101, 5);
+
+  _foundry_build_stage_add_dependency (c, a);
+
+  node = run_to_json (&run, "build", FALSE);
+  assert_critical_path (node, 105, path, G_N_ELEMENTS (path));
+
+  stages = json_object_get_array_member (json_node_get_object (node), "stages");
+  g_assert_cmpuint (json_array_get_length (stages), ==, 4);
+
+  deps = json_object_get_array_member (json_array_get_object_element (stages, 1), "dependencies");
+  g_assert_cmpuint (json_array_get_length (deps), ==, 0);
+
+  deps = json_object_get_array_member (json_array_get_object_element (stages, 2), "dependencies");
+  g_assert_cmpuint (json_array_get_length (deps), ==, 1);
+  g_assert_cmpint (json_array_get_int_element (deps, 0), ==, 0);
+
+  deps = json_object_get_array_member (json_array_get_object_element (stages, 3), "dependencies");
+  g_assert_cmpuint (json_array_get_length (deps), ==, 3);
+
+  run_clear (&run);
+}
+
+static void
+test_critical_path_empty (void)
+{
+  g_autoptr(JsonNode) node = NULL;
+  Run run;
+
+  run_init (&run);
+  node = run_to_json (&run, "build", FALSE);
+  assert_critical_path (node, 0, NULL, 0);
+  run_clear (&run);
+}
+
+static const char *
+get_operation (JsonArray *runs,
+               guint      position)
+{
+  return json_object_get_string_member (json_array_get_object_element (runs, position), "operation");
+}
+
+static void
+test_persistence_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GHashTable) seen = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autoptr(GPtrArray) futures = g_ptr_array_new_with_free_func (dex_unref);
+  g_autoptr(JsonNode) history = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-build-history-XXXXXX", NULL);
+  g_autofree char *foundry_dir = NULL;
+  g_autofree char *builddir = NULL;
+  JsonArray *runs;
+  Run run;
+
+  g_assert_nonnull (g_mkdtemp (tmpdir));
+
+  foundry_dir = g_build_filename (tmpdir, ".foundry", NULL);
+  builddir = g_build_filename (tmpdir, "_build", NULL);
+
+  context = dex_await_object (foundry_context_new (foundry_dir, tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+
+  run_init (&run);
+  run_add (&run, TRUE, 1, 10);
+
+  /* Nothing recorded yet */
+  history = dex_await_boxed (_foundry_build_history_load (context, builddir), &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (json_array_get_length (json_node_get_array (history)), ==, 0);
+  g_clear_pointer (&history, json_node_unref);
+
+  /* Concurrent appends must not lose each other's runs */
+  for (guint i = 0; i < 10; i++)
+    {
+      g_autofree char *operation = g_strdup_printf ("concurrent-%u", i);
+      g_autoptr(JsonNode) node = run_to_json (&run, operation, TRUE);
+
+      g_ptr_array_add (futures, _foundry_build_history_append (context, builddir, node));
+    }
+
+  dex_await (dex_future_allv ((DexFuture **)futures->pdata, futures->len), &error);
+  g_assert_no_error (error);
+
+  history = dex_await_boxed (_foundry_build_history_load (context, builddir), &error);
+  g_assert_no_error (error);
+  runs = json_node_get_array (history);
+  g_assert_cmpuint (json_array_get_length (runs), ==, 10);
+
+  for (guint i = 0; i < 10; i++)
+    g_hash_table_add (seen, (char *)get_operation (runs, i));
+  g_assert_cmpuint (g_hash_table_size (seen), ==, 10);
+
+  g_clear_pointer (&history, json_node_unref);
+
+  /* Only the most recent runs are kept */
+  for (guint i = 0; i < 20; i++)
+    {
+      g_autofree char *operation = g_strdup_printf ("sequential-%u", i);
+      g_autoptr(JsonNode) node = run_to_json (&run, operation, TRUE);
+
+      dex_await (_foundry_build_history_append (context, builddir, node), &error);
+      g_assert_no_error (error);
+    }
+
+  history = dex_await_boxed (_foundry_build_history_load (context, builddir), &error);
+  g_assert_no_error (error);
+  runs = json_node_get_array (history);
+  g_assert_cmpuint (json_array_get_length (runs), ==, 25);
+  g_assert_cmpstr (get_operation (runs, 5), ==, "sequential-0");
+  g_assert_cmpstr (get_operation (runs, 24), ==, "sequential-19");
+
+  run_clear (&run);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_persistence (void)
+{
+  test_from_fiber (test_persistence_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/BuildHistory/critical-path/sequential", test_critical_path_sequential);
+  g_test_add_func ("/Foundry/BuildHistory/critical-path/dependencies", test_critical_path_dependencies);
+  g_test_add_func ("/Foundry/BuildHistory/critical-path/empty", test_critical_path_empty);
+  g_test_add_func ("/Foundry/BuildHistory/persistence", test_persistence);
+  return g_test_run ();
+}
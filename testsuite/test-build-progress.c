@@ -0,0 +1,487 @@
+/* test-build-progress.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/build/foundry-build-stage-private.h"
+
+#include "test-util.h"
+
+typedef struct
+{
+  GPtrArray *log;
+  guint      running;
+  guint      max_running;
+} Tracker;
+
+#define TEST_TYPE_CONFIG (test_config_get_type())
+G_DECLARE_FINAL_TYPE (TestConfig, test_config, TEST, CONFIG, FoundryConfig)
+
+struct _TestConfig
+{
+  FoundryConfig parent_instance;
+};
+
+G_DEFINE_FINAL_TYPE (TestConfig, test_config, FOUNDRY_TYPE_CONFIG)
+
+static void
+test_config_class_init (TestConfigClass *klass)
+{
+}
+
+static void
+test_config_init (TestConfig *self)
+{
+}
+
+#define TEST_TYPE_SDK (test_sdk_get_type())
+G_DECLARE_FINAL_TYPE (TestSdk, test_sdk, TEST, SDK, FoundrySdk)
+
+struct _TestSdk
+{
+  FoundrySdk parent_instance;
+};
+
+G_DEFINE_FINAL_TYPE (TestSdk, test_sdk, FOUNDRY_TYPE_SDK)
+
+static void
+test_sdk_class_init (TestSdkClass *klass)
+{
+}
+
+static void
+test_sdk_init (TestSdk *self)
+{
+}
+
+/* A stage which does not complete until the test releases it */
+#define TEST_TYPE_STAGE (test_stage_get_type())
+G_DECLARE_FINAL_TYPE (TestStage, test_stage, TEST, STAGE, FoundryBuildStage)
+
+struct _TestStage
+{
+  FoundryBuildStage  parent_instance;
+  char              *name;
+  Tracker           *tracker;
+  DexPromise        *started;
+  DexPromise        *release;
+  guint              priority;
+};
+
+G_DEFINE_FINAL_TYPE (TestStage, test_stage, FOUNDRY_TYPE_BUILD_STAGE)
+
+static FoundryBuildPipelinePhase
+test_stage_get_phase (FoundryBuildStage *stage)
+{
+  return FOUNDRY_BUILD_PIPELINE_PHASE_BUILD;
+}
+
+static guint
+test_stage_get_priority (FoundryBuildStage *stage)
+{
+  return TEST_STAGE (stage)->priority;
+}
+
+static DexFuture *
+test_stage_query (FoundryBuildStage *stage)
+{
+  foundry_build_stage_set_completed (stage, FALSE);
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+test_stage_finished (DexFuture *completed,
+                     gpointer   user_data)
+{
+  TestStage *self = user_data;
+
+  g_ptr_array_add (self->tracker->log, g_strdup_printf ("end:%s", self->name));
+  self->tracker->running--;
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+test_stage_build (FoundryBuildStage    *stage,
+                  FoundryBuildProgress *progress)
+{
+  TestStage *self = TEST_STAGE (stage);
+
+  g_ptr_array_add (self->tracker->log, g_strdup_printf ("start:%s", self->name));
+  self->tracker->running++;
+  self->tracker->max_running = MAX (self->tracker->max_running, self->tracker->running);
+
+  dex_promise_resolve_boolean (self->started, TRUE);
+
+  return dex_future_finally (dex_ref (self->release),
+                             test_stage_finished,
+                             g_object_ref (self),
+                             g_object_unref);
+}
+
+static void
+test_stage_finalize (GObject *object)
+{
+  TestStage *self = (TestStage *)object;
+
+  g_clear_pointer (&self->name, g_free);
+  dex_clear (&self->started);
+  dex_clear (&self->release);
+
+  G_OBJECT_CLASS (test_stage_parent_class)->finalize (object);
+}
+
+static void
+test_stage_class_init (TestStageClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FoundryBuildStageClass *build_stage_class = FOUNDRY_BUILD_STAGE_CLASS (klass);
+
+  object_class->finalize = test_stage_finalize;
+
+  build_stage_class->get_phase = test_stage_get_phase;
+  build_stage_class->get_priority = test_stage_get_priority;
+  build_stage_class->query = test_stage_query;
+  build_stage_class->build = test_stage_build;
+}
+
+static void
+test_stage_init (TestStage *self)
+{
+  self->started = dex_promise_new ();
+  self->release = dex_promise_new ();
+}
+
+static TestStage *
+add_stage (FoundryBuildPipeline      *pipeline,
+           Tracker                   *tracker,
+           const char                *name,
+           gboolean                   ordered,
+           FoundryBuildStageResource  resources)
+{
+  g_autoptr(FoundryContext) context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (pipeline));
+  g_autoptr(TestStage) stage = NULL;
+
+  stage = g_object_new (TEST_TYPE_STAGE,
+                        "context", context,
+                        NULL);
+  stage->name = g_strdup (name);
+  stage->tracker = tracker;
+  stage->priority = g_list_model_get_n_items (G_LIST_MODEL (pipeline));
+
+  _foundry_build_stage_set_ordered (FOUNDRY_BUILD_STAGE (stage), ordered);
+  _foundry_build_stage_set_resources (FOUNDRY_BUILD_STAGE (stage), resources);
+
+  foundry_build_pipeline_add_stage (pipeline, FOUNDRY_BUILD_STAGE (stage));
+
+  /* Owned by the pipeline */
+  return stage;
+}
+
+static void
+release (TestStage *stage)
+{
+  dex_promise_resolve_boolean (stage->release, TRUE);
+}
+
+static void
+await_started (TestStage *stage)
+{
+  g_assert_true (dex_await (dex_ref (stage->started), NULL));
+}
+
+static guint
+log_index (Tracker    *tracker,
+           const char *entry)
+{
+  guint index;
+
+  if (!g_ptr_array_find_with_equal_func (tracker->log, entry, g_str_equal, &index))
+    g_error ("“%s” missing from build log", entry);
+
+  return index;
+}
+
+static FoundryBuildPipeline *
+create_pipeline (char **tmpdir)
+{
+  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryDevice) device = NULL;
+  g_autoptr(FoundryConfig) config = NULL;
+  g_autoptr(FoundrySdk) sdk = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *foundry_dir = NULL;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-build-progress-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  foundry_dir = g_build_filename (*tmpdir, ".foundry", NULL);
+  context = dex_await_object (foundry_context_new (foundry_dir, *tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+
+  config = g_object_new (TEST_TYPE_CONFIG, "context", context, NULL);
+  sdk = g_object_new (TEST_TYPE_SDK, "context", context, NULL);
+  device = foundry_local_device_new (context);
+
+  pipeline = dex_await_object (foundry_build_pipeline_new (context, config, device, sdk, FALSE), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (pipeline);
+
+  return g_steal_pointer (&pipeline);
+}
+
+static FoundryBuildProgress *
+build (FoundryBuildPipeline *pipeline)
+{
+  return foundry_build_pipeline_build (pipeline, FOUNDRY_BUILD_PIPELINE_PHASE_BUILD, -1, NULL);
+}
+
+static void
+await_progress (FoundryBuildProgress *progress)
+{
+  g_autoptr(GError) error = NULL;
+
+  dex_await (foundry_build_progress_await (progress), &error);
+  g_assert_no_error (error);
+}
+
+/* The build history is written in the background, so wait for the
+ * context to shut down before removing the project.
+ */
+static void
+destroy_pipeline (FoundryBuildPipeline *pipeline,
+                  const char           *tmpdir)
+{
+  g_autoptr(FoundryContext) context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (pipeline));
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  destroy_pipeline (pipeline, tmpdir);
+}
+
+static void
+test_ordered_fiber (void)
+{
+  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(FoundryBuildProgress) progress = NULL;
+  g_autoptr(GPtrArray) log = g_ptr_array_new_with_free_func (g_free);
+  g_autofree char *tmpdir = NULL;
+  Tracker tracker = { log, 0, 0 };
+  TestStage *a, *b, *c;
+
+  pipeline = create_pipeline (&tmpdir);
+
+  /* Ordered stages never overlap, even when they use no resources */
+  a = add_stage (pipeline, &tracker, "a", TRUE, FOUNDRY_BUILD_STAGE_RESOURCE_NONE);
+  b = add_stage (pipeline, &tracker, "b", TRUE, FOUNDRY_BUILD_STAGE_RESOURCE_NONE);
+  c = add_stage (pipeline, &tracker, "c", TRUE, FOUNDRY_BUILD_STAGE_RESOURCE_NONE);
+
+  progress = build (pipeline);
+
+  await_started (a);
+  g_assert_cmpuint (log->len, ==, 1);
+  release (a);
+
+  await_started (b);
+  g_assert_cmpuint (log_index (&tracker, "end:a"), <, log_index (&tracker, "start:b"));
+  release (b);
+
+  await_started (c);
+  g_assert_cmpuint (log_index (&tracker, "end:b"), <, log_index (&tracker, "start:c"));
+  release (c);
+
+  await_progress (progress);
+
+  g_assert_cmpuint (tracker.max_running, ==, 1);
+  g_assert_cmpuint (log->len, ==, 6);
+
+  destroy_pipeline (pipeline, tmpdir);
+}
+
+static void
+test_dependencies_fiber (void)
+{
+  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(FoundryBuildProgress) progress = NULL;
+  g_autoptr(GPtrArray) log = g_ptr_array_new_with_free_func (g_free);
+  g_autofree char *tmpdir = NULL;
+  Tracker tracker = { log, 0, 0 };
+  TestStage *a, *b, *c, *d;
+
+  pipeline = create_pipeline (&tmpdir);
+
+  a = add_stage (pipeline, &tracker, "a", TRUE, FOUNDRY_BUILD_STAGE_RESOURCE_IO);
+  b = add_stage (pipeline, &tracker, "b", FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_IO);
+  c = add_stage (pipeline, &tracker, "c", FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_IO);
+  d = add_stage (pipeline, &tracker, "d", TRUE, FOUNDRY_BUILD_STAGE_RESOURCE_IO);
+
+  _foundry_build_stage_add_dependency (FOUNDRY_BUILD_STAGE (c), FOUNDRY_BUILD_STAGE (a));
+
+  progress = build (pipeline);
+
+  /* "b" has no dependencies so it runs alongside "a" */
+  await_started (a);
+  await_started (b);
+  g_assert_cmpuint (tracker.running, ==, 2);
+
+  /* "c" must wait for "a" but not for "b" */
+  release (a);
+  await_started (c);
+  g_assert_cmpuint (log_index (&tracker, "end:a"), <, log_index (&tracker, "start:c"));
+  g_assert_false (g_ptr_array_find_with_equal_func (log, "end:b", g_str_equal, NULL));
+
+  /* "d" is ordered and waits for everything before it */
+  release (c);
+  release (b);
+  await_started (d);
+  g_assert_cmpuint (log_index (&tracker, "end:b"), <, log_index (&tracker, "start:d"));
+  g_assert_cmpuint (log_index (&tracker, "end:c"), <, log_index (&tracker, "start:d"));
+  release (d);
+
+  await_progress (progress);
+
+  g_assert_cmpuint (tracker.max_running, ==, 2);
+
+  destroy_pipeline (pipeline, tmpdir);
+}
+
+static void
+test_resources_fiber (void)
+{
+  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(FoundryBuildProgress) progress = NULL;
+  g_autoptr(GPtrArray) log = g_ptr_array_new_with_free_func (g_free);
+  g_autofree char *tmpdir = NULL;
+  Tracker tracker = { log, 0, 0 };
+  TestStage *cpu1, *cpu2, *net1, *net2;
+
+  pipeline = create_pipeline (&tmpdir);
+
+  cpu1 = add_stage (pipeline, &tracker, "cpu1", FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_CPU);
+  cpu2 = add_stage (pipeline, &tracker, "cpu2", FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_CPU);
+  net1 = add_stage (pipeline, &tracker, "net1", FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_NETWORK);
+  net2 = add_stage (pipeline, &tracker, "net2", FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_NETWORK);
+
+  progress = build (pipeline);
+
+  /* One CPU bound stage may overlap one network bound stage */
+  await_started (cpu1);
+  await_started (net1);
+  g_assert_cmpuint (tracker.running, ==, 2);
+
+  release (cpu1);
+  await_started (cpu2);
+  g_assert_cmpuint (log_index (&tracker, "end:cpu1"), <, log_index (&tracker, "start:cpu2"));
+  g_assert_false (g_ptr_array_find_with_equal_func (log, "start:net2", g_str_equal, NULL));
+
+  release (net1);
+  await_started (net2);
+  g_assert_cmpuint (log_index (&tracker, "end:net1"), <, log_index (&tracker, "start:net2"));
+
+  release (cpu2);
+  release (net2);
+
+  await_progress (progress);
+
+  g_assert_cmpuint (tracker.max_running, ==, 2);
+
+  destroy_pipeline (pipeline, tmpdir);
+}
+
+static void
+test_limit_fiber (void)
+{
+  g_autoptr(FoundryBuildPipeline) pipeline = NULL;
+  g_autoptr(FoundryBuildProgress) progress = NULL;
+  g_autoptr(GPtrArray) log = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GPtrArray) stages = g_ptr_array_new ();
+  g_autofree char *tmpdir = NULL;
+  Tracker tracker = { log, 0, 0 };
+
+  pipeline = create_pipeline (&tmpdir);
+
+  for (guint i = 0; i < 6; i++)
+    {
+      g_autofree char *name = g_strdup_printf ("%u", i);
+      g_ptr_array_add (stages, add_stage (pipeline, &tracker, name, FALSE, FOUNDRY_BUILD_STAGE_RESOURCE_NONE));
+    }
+
+  progress = build (pipeline);
+
+  for (guint i = 0; i < 4; i++)
+    await_started (g_ptr_array_index (stages, i));
+
+  g_assert_cmpuint (tracker.running, ==, 4);
+  g_assert_false (g_ptr_array_find_with_equal_func (log, "start:4", g_str_equal, NULL));
+
+  /* Each completion frees a slot for the next stage */
+  release (g_ptr_array_index (stages, 0));
+  await_started (g_ptr_array_index (stages, 4));
+  g_assert_false (g_ptr_array_find_with_equal_func (log, "start:5", g_str_equal, NULL));
+
+  for (guint i = 1; i < stages->len; i++)
+    release (g_ptr_array_index (stages, i));
+
+  await_progress (progress);
+
+  g_assert_cmpuint (tracker.max_running, ==, 4);
+  g_assert_cmpuint (log->len, ==, 12);
+
+  destroy_pipeline (pipeline, tmpdir);
+}
+
+static void
+test_ordered (void)
+{
+  test_from_fiber (test_ordered_fiber);
+}
+
+static void
+test_dependencies (void)
+{
+  test_from_fiber (test_dependencies_fiber);
+}
+
+static void
+test_resources (void)
+{
+  test_from_fiber (test_resources_fiber);
+}
+
+static void
+test_limit (void)
+{
+  test_from_fiber (test_limit_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/BuildProgress/ordered", test_ordered);
+  g_test_add_func ("/Foundry/BuildProgress/dependencies", test_dependencies);
+  g_test_add_func ("/Foundry/BuildProgress/resources", test_resources);
+  g_test_add_func ("/Foundry/BuildProgress/limit", test_limit);
+  return g_test_run ();
+}
@@ -0,0 +1,244 @@
+/* test-diagnostic-store.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/diagnostics/foundry-diagnostic-fix-private.h"
+#include "libfoundry/diagnostics/foundry-diagnostic-private.h"
+
+typedef struct
+{
+  guint position;
+  guint removed;
+  guint added;
+} Change;
+
+typedef struct
+{
+  const char *name;
+  const char *before;
+  const char *after;
+  const Change changes[4];
+} Pattern;
+
+/* Each character is a diagnostic. Lowercase letters are warnings on
+ * the line matching their position in the alphabet and the uppercase
+ * variant is an error on the same line, as if the message changed.
+ */
+static const Pattern patterns[] = {
+  { "unchanged", "abcde", "abcde", {{0}} },
+  { "append", "abcde", "abcdef", {{5, 0, 1}} },
+  { "prepend", "bcde", "abcde", {{0, 0, 1}} },
+  { "insert", "abde", "abcde", {{2, 0, 1}} },
+  { "remove-middle", "abcde", "abde", {{2, 1, 0}} },
+  { "remove-last", "abcde", "abcd", {{4, 1, 0}} },
+  { "fix-all", "abcde", "", {{0, 5, 0}} },
+  { "first-pass", "", "abc", {{0, 0, 3}} },
+  { "change-one", "abcde", "abCde", {{2, 1, 1}} },
+  { "change-two", "abcde", "aBcDe", {{3, 1, 1}, {1, 1, 1}} },
+  { "fix-and-introduce", "abcdefgh", "bcXefgY", {{7, 1, 1}, {3, 1, 1}, {0, 1, 0}} },
+  { "change-tail", "abcdef", "abCDEF", {{2, 4, 4}} },
+};
+
+static FoundryDiagnostic *
+create_diagnostic (char ch)
+{
+  FoundryDiagnostic *diagnostic = g_object_new (FOUNDRY_TYPE_DIAGNOSTIC, NULL);
+  char message[2] = { g_ascii_tolower (ch), 0 };
+
+  diagnostic->line = g_ascii_tolower (ch) - 'a' + 1;
+  diagnostic->severity = g_ascii_isupper (ch) ? FOUNDRY_DIAGNOSTIC_ERROR : FOUNDRY_DIAGNOSTIC_WARNING;
+  diagnostic->message = g_strdup (message);
+
+  return diagnostic;
+}
+
+static GPtrArray *
+create_diagnostics (const char *str)
+{
+  GPtrArray *ar = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (const char *c = str; *c; c++)
+    g_ptr_array_add (ar, create_diagnostic (*c));
+
+  return ar;
+}
+
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  GArray     *changes)
+{
+  Change change = { position, removed, added };
+
+  g_array_append_val (changes, change);
+}
+
+static void
+test_diagnostic_store_patterns (void)
+{
+  for (guint p = 0; p < G_N_ELEMENTS (patterns); p++)
+    {
+      const Pattern *pattern = &patterns[p];
+      g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_DIAGNOSTIC);
+      g_autoptr(GPtrArray) before = create_diagnostics (pattern->before);
+      g_autoptr(GPtrArray) after = create_diagnostics (pattern->after);
+      g_autoptr(GArray) changes = g_array_new (FALSE, FALSE, sizeof (Change));
+      guint n_expected = 0;
+
+      g_test_message ("%s: “%s” → “%s”", pattern->name, pattern->before, pattern->after);
+
+      g_list_store_splice (store, 0, 0, before->pdata, before->len);
+      g_signal_connect (store, "items-changed", G_CALLBACK (items_changed_cb), changes);
+
+      _foundry_diagnostic_store_update (store, (FoundryDiagnostic * const *)after->pdata, after->len);
+
+      while (n_expected < G_N_ELEMENTS (pattern->changes) &&
+             (pattern->changes[n_expected].removed || pattern->changes[n_expected].added))
+        n_expected++;
+
+      g_assert_cmpint (changes->len, ==, n_expected);
+
+      for (guint i = 0; i < n_expected; i++)
+        {
+          const Change *change = &g_array_index (changes, Change, i);
+
+          g_assert_cmpint (change->position, ==, pattern->changes[i].position);
+          g_assert_cmpint (change->removed, ==, pattern->changes[i].removed);
+          g_assert_cmpint (change->added, ==, pattern->changes[i].added);
+        }
+
+      /* Resulting contents must match the new set */
+      g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (store)), ==, after->len);
+
+      for (guint i = 0; i < after->len; i++)
+        {
+          g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (store), i);
+
+          g_assert_true (foundry_diagnostic_equal (diagnostic, g_ptr_array_index (after, i)));
+        }
+    }
+}
+
+static void
+test_diagnostic_store_stable (void)
+{
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_DIAGNOSTIC);
+  g_autoptr(GPtrArray) before = create_diagnostics ("abcde");
+  g_autoptr(GPtrArray) after = create_diagnostics ("abXde");
+
+  g_list_store_splice (store, 0, 0, before->pdata, before->len);
+  _foundry_diagnostic_store_update (store, (FoundryDiagnostic * const *)after->pdata, after->len);
+
+  /* Untouched diagnostics keep their instance so views keep their rows */
+  for (guint i = 0; i < 5; i++)
+    {
+      g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (store), i);
+
+      if (i == 2)
+        g_assert_true (diagnostic == g_ptr_array_index (after, i));
+      else
+        g_assert_true (diagnostic == g_ptr_array_index (before, i));
+    }
+}
+
+static void
+test_diagnostic_equal (void)
+{
+  g_autoptr(FoundryDiagnostic) a = create_diagnostic ('a');
+  g_autoptr(FoundryDiagnostic) b = create_diagnostic ('a');
+  g_autoptr(FoundryDiagnostic) c = create_diagnostic ('A');
+  g_autoptr(FoundryDiagnostic) d = create_diagnostic ('b');
+
+  g_assert_true (foundry_diagnostic_equal (a, b));
+  g_assert_cmpint (foundry_diagnostic_hash (a), ==, foundry_diagnostic_hash (b));
+  g_assert_cmpint (foundry_diagnostic_compare (a, b), ==, 0);
+
+  g_assert_false (foundry_diagnostic_equal (a, c));
+  g_assert_cmpint (foundry_diagnostic_compare (c, a), <, 0);
+
+  g_assert_false (foundry_diagnostic_equal (a, d));
+  g_assert_cmpint (foundry_diagnostic_compare (a, d), <, 0);
+}
+
+static GListModel *
+create_fixes (const char *replacement)
+{
+  g_autoptr(GFile) file = g_file_new_for_path ("/tmp/file.c");
+  g_autoptr(FoundryDiagnosticFix) fix = g_object_new (FOUNDRY_TYPE_DIAGNOSTIC_FIX, NULL);
+  g_autoptr(FoundryTextEdit) edit = foundry_text_edit_new (file, 1, 0, 1, 1, replacement);
+  GListStore *text_edits = g_list_store_new (FOUNDRY_TYPE_TEXT_EDIT);
+  GListStore *fixes = g_list_store_new (FOUNDRY_TYPE_DIAGNOSTIC_FIX);
+
+  g_list_store_append (text_edits, edit);
+
+  fix->description = g_strdup ("Replace");
+  fix->text_edits = G_LIST_MODEL (text_edits);
+
+  g_list_store_append (fixes, fix);
+
+  return G_LIST_MODEL (fixes);
+}
+
+static void
+test_diagnostic_equal_fixes (void)
+{
+  g_autoptr(FoundryDiagnostic) a = create_diagnostic ('a');
+  g_autoptr(FoundryDiagnostic) b = create_diagnostic ('a');
+
+  a->fixes = create_fixes ("x");
+  b->fixes = create_fixes ("x");
+  g_assert_true (foundry_diagnostic_equal (a, b));
+
+  g_clear_object (&b->fixes);
+  g_assert_false (foundry_diagnostic_equal (a, b));
+
+  b->fixes = create_fixes ("y");
+  g_assert_false (foundry_diagnostic_equal (a, b));
+
+  g_clear_object (&b->fixes);
+  b->fixes = create_fixes ("x");
+
+  a->markup = foundry_markup_new_plaintext ("a");
+  g_assert_false (foundry_diagnostic_equal (a, b));
+
+  b->markup = foundry_markup_new_plaintext ("a");
+  g_assert_true (foundry_diagnostic_equal (a, b));
+
+  g_clear_object (&b->markup);
+  b->markup = foundry_markup_new_plaintext ("b");
+  g_assert_false (foundry_diagnostic_equal (a, b));
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/Diagnostic/equal", test_diagnostic_equal);
+  g_test_add_func ("/Foundry/Diagnostic/equal-fixes", test_diagnostic_equal_fixes);
+  g_test_add_func ("/Foundry/Diagnostic/Store/patterns", test_diagnostic_store_patterns);
+  g_test_add_func ("/Foundry/Diagnostic/Store/stable", test_diagnostic_store_stable);
+  return g_test_run ();
+}
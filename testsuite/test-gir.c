@@ -0,0 +1,340 @@
+/* test-gir.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "foundry-gir-data-private.h"
+
+#include "test-util.h"
+
+static const char test_gir[] =
+  "<?xml version=\"1.0\"?>\n"
+  "<repository version=\"1.2\" xmlns=\"http://www.gtk.org/introspection/core/1.0\">\n"
+  "  <include name=\"GObject\" version=\"2.0\"/>\n"
+  "  <package name=\"test-1\"/>\n"
+  "  <namespace name=\"Test\" version=\"1\" c:identifier-prefixes=\"Test\">\n"
+  "    <class name=\"Widget\" c:type=\"TestWidget\" parent=\"GObject.Object\">\n"
+  "      <doc xml:space=\"preserve\">A widget &amp; friends.</doc>\n"
+  "      <method name=\"show\" c:identifier=\"test_widget_show\">\n"
+  "        <return-value transfer-ownership=\"none\">\n"
+  "          <type name=\"none\" c:type=\"void\"/>\n"
+  "        </return-value>\n"
+  "        <parameters>\n"
+  "          <instance-parameter name=\"self\"><type name=\"Widget\"/></instance-parameter>\n"
+  "        </parameters>\n"
+  "      </method>\n"
+  "      <glib:signal name=\"shown\"/>\n"
+  "    </class>\n"
+  "    <function c:identifier=\"test_init\"><![CDATA[ignored <text>]]></function>\n"
+  "    <constant name=\"VERSION\" value=\"1\"><type name=\"gint\"/></constant>\n"
+  "  </namespace>\n"
+  "</repository>\n";
+
+static void
+write_file (const char *path,
+            const char *contents)
+{
+  g_autoptr(GError) error = NULL;
+
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+}
+
+static char *
+get_cache_path (const char *path)
+{
+  g_autoptr(GFile) file = g_file_new_for_path (path);
+  g_autofree char *uri = g_file_get_uri (file);
+  g_autofree char *checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+  g_autofree char *name = g_strconcat (checksum, ".cache", NULL);
+
+  return g_build_filename (g_get_user_cache_dir (), "foundry", "gir", name, NULL);
+}
+
+static FoundryGir *
+load_gir (const char *path)
+{
+  g_autoptr(GError) error = NULL;
+  FoundryGir *gir;
+
+  gir = dex_await_object (foundry_gir_new_for_path (path), &error);
+  g_assert_no_error (error);
+  g_assert_true (FOUNDRY_IS_GIR (gir));
+
+  return gir;
+}
+
+static void
+assert_nodes_equal (FoundryGirNode *a,
+                    FoundryGirNode *b)
+{
+  g_autofree const char **a_attrs = NULL;
+  g_autofree const char **b_attrs = NULL;
+  const GList *a_iter;
+  const GList *b_iter;
+  guint a_n_attrs;
+  guint b_n_attrs;
+
+  g_assert_cmpint (foundry_gir_node_get_node_type (a), ==, foundry_gir_node_get_node_type (b));
+  g_assert_cmpstr (foundry_gir_node_get_tag_name (a), ==, foundry_gir_node_get_tag_name (b));
+  g_assert_cmpstr (foundry_gir_node_get_name (a), ==, foundry_gir_node_get_name (b));
+  g_assert_cmpstr (foundry_gir_node_get_content (a), ==, foundry_gir_node_get_content (b));
+
+  a_attrs = foundry_gir_node_list_attributes (a, &a_n_attrs);
+  b_attrs = foundry_gir_node_list_attributes (b, &b_n_attrs);
+  g_assert_cmpint (a_n_attrs, ==, b_n_attrs);
+
+  for (guint i = 0; i < a_n_attrs; i++)
+    {
+      g_assert_cmpstr (a_attrs[i], ==, b_attrs[i]);
+      g_assert_cmpstr (foundry_gir_node_get_attribute (a, a_attrs[i]), ==,
+                       foundry_gir_node_get_attribute (b, b_attrs[i]));
+    }
+
+  for (a_iter = foundry_gir_node_get_children (a), b_iter = foundry_gir_node_get_children (b);
+       a_iter != NULL && b_iter != NULL;
+       a_iter = a_iter->next, b_iter = b_iter->next)
+    {
+      g_assert_true (foundry_gir_node_get_parent (a_iter->data) == a);
+      g_assert_true (foundry_gir_node_get_parent (b_iter->data) == b);
+
+      assert_nodes_equal (a_iter->data, b_iter->data);
+    }
+
+  g_assert_null (a_iter);
+  g_assert_null (b_iter);
+}
+
+static void
+assert_test_gir (FoundryGir *gir)
+{
+  FoundryGirNode *repository = foundry_gir_get_repository (gir);
+  g_autofree FoundryGirNode **namespaces = NULL;
+  g_autofree FoundryGirNode **methods = NULL;
+  FoundryGirNode *namespace;
+  FoundryGirNode *klass;
+  FoundryGirNode *function;
+  FoundryGirNode *doc;
+  guint n_namespaces;
+  guint n_methods;
+
+  g_assert_nonnull (repository);
+  g_assert_cmpint (foundry_gir_node_get_node_type (repository), ==, FOUNDRY_GIR_NODE_REPOSITORY);
+  g_assert_null (foundry_gir_node_get_parent (repository));
+  g_assert_cmpstr (foundry_gir_node_get_attribute (repository, "version"), ==, "1.2");
+  g_assert_false (foundry_gir_node_has_attribute (repository, "missing"));
+  g_assert_null (foundry_gir_node_get_content (repository));
+
+  namespaces = foundry_gir_list_namespaces (gir, &n_namespaces);
+  g_assert_cmpint (n_namespaces, ==, 1);
+
+  namespace = foundry_gir_get_namespace (gir, "Test");
+  g_assert_true (namespace == namespaces[0]);
+  g_assert_true (foundry_gir_node_get_parent (namespace) == repository);
+
+  klass = foundry_gir_node_find_child (namespace, FOUNDRY_GIR_NODE_CLASS, "Widget");
+  g_assert_nonnull (klass);
+  g_assert_cmpstr (foundry_gir_node_get_attribute (klass, "parent"), ==, "GObject.Object");
+
+  doc = foundry_gir_node_find_child (klass, FOUNDRY_GIR_NODE_UNKNOWN, NULL);
+  g_assert_nonnull (doc);
+  g_assert_cmpstr (foundry_gir_node_get_tag_name (doc), ==, "doc");
+  g_assert_cmpstr (foundry_gir_node_get_content (doc), ==, "A widget & friends.");
+
+  methods = foundry_gir_node_list_children_typed (klass, FOUNDRY_GIR_NODE_METHOD, &n_methods);
+  g_assert_cmpint (n_methods, ==, 1);
+  g_assert_cmpstr (foundry_gir_node_get_name (methods[0]), ==, "show");
+  g_assert_nonnull (foundry_gir_node_find_child (methods[0], FOUNDRY_GIR_NODE_PARAMETERS, NULL));
+
+  /* Falls back to c:identifier when there is no name */
+  function = foundry_gir_node_find_child (namespace, FOUNDRY_GIR_NODE_FUNCTION, "test_init");
+  g_assert_nonnull (function);
+  g_assert_cmpstr (foundry_gir_node_get_content (function), ==, "ignored <text>");
+}
+
+static void
+test_gir_cache_fiber (void)
+{
+  g_autoptr(FoundryGir) parsed = NULL;
+  g_autoptr(FoundryGir) cached = NULL;
+  g_autoptr(FoundryGir) recovered = NULL;
+  g_autoptr(FoundryGir) changed = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *path = NULL;
+  g_autofree char *cache_path = NULL;
+  g_autofree char *contents = NULL;
+  gsize len;
+
+  tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-gir-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (tmpdir));
+
+  path = g_build_filename (tmpdir, "Test-1.gir", NULL);
+  cache_path = get_cache_path (path);
+  write_file (path, test_gir);
+
+  /* First load parses and writes the cache */
+  parsed = load_gir (path);
+  assert_test_gir (parsed);
+  g_assert_true (g_file_test (cache_path, G_FILE_TEST_IS_REGULAR));
+
+  /* Second load maps the cache */
+  cached = load_gir (path);
+  assert_test_gir (cached);
+  assert_nodes_equal (foundry_gir_get_repository (parsed),
+                      foundry_gir_get_repository (cached));
+
+  /* A corrupt cache is ignored and replaced */
+  write_file (cache_path, "FGIRDATA garbage");
+  recovered = load_gir (path);
+  assert_nodes_equal (foundry_gir_get_repository (parsed),
+                      foundry_gir_get_repository (recovered));
+  g_assert_true (g_file_get_contents (cache_path, &contents, &len, NULL));
+  g_assert_cmpint (len, !=, strlen ("FGIRDATA garbage"));
+
+  /* Changing the file invalidates the cache */
+  write_file (path,
+              "<repository version=\"1.3\">"
+              "<namespace name=\"Other\"/>"
+              "</repository>");
+  changed = load_gir (path);
+  g_assert_cmpstr (foundry_gir_node_get_attribute (foundry_gir_get_repository (changed), "version"), ==, "1.3");
+  g_assert_nonnull (foundry_gir_get_namespace (changed, "Other"));
+  g_assert_null (foundry_gir_get_namespace (changed, "Test"));
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_gir_cache (void)
+{
+  test_from_fiber (test_gir_cache_fiber);
+}
+
+static void
+test_gir_data (void)
+{
+  g_autoptr(FoundryGirData) data = NULL;
+  g_autoptr(FoundryGirData) loaded = NULL;
+  g_autoptr(GBytes) bytes = g_bytes_new_static (test_gir, strlen (test_gir));
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *path = NULL;
+  g_autofree char *contents = NULL;
+  const FoundryGirDataNode *root;
+  gsize len;
+
+  data = _foundry_gir_data_parse (bytes, 1234, strlen (test_gir), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (data);
+
+  /* Children are stored contiguously after their parent */
+  for (guint i = 0; i < _foundry_gir_data_get_n_nodes (data); i++)
+    {
+      const FoundryGirDataNode *node = _foundry_gir_data_get_node (data, i);
+
+      for (guint j = 0; j < node->n_children; j++)
+        g_assert_cmpint (_foundry_gir_data_get_node (data, node->first_child + j)->parent, ==, i);
+    }
+
+  root = _foundry_gir_data_get_node (data, 0);
+  g_assert_cmpint (root->type, ==, FOUNDRY_GIR_NODE_REPOSITORY);
+  g_assert_cmpint (root->parent, ==, FOUNDRY_GIR_DATA_NONE);
+  g_assert_cmpint (root->n_children, ==, 3);
+  g_assert_cmpstr (_foundry_gir_data_get_attribute (data, 0, "version"), ==, "1.2");
+
+  tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-gir-data-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (tmpdir));
+  path = g_build_filename (tmpdir, "cache", NULL);
+
+  g_assert_true (_foundry_gir_data_save (data, path, &error));
+  g_assert_no_error (error);
+
+  loaded = _foundry_gir_data_load (path, 1234, strlen (test_gir), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (loaded);
+  g_assert_cmpint (_foundry_gir_data_get_size (loaded), ==, _foundry_gir_data_get_size (data));
+  g_assert_cmpint (_foundry_gir_data_get_n_nodes (loaded), ==, _foundry_gir_data_get_n_nodes (data));
+
+  /* Stale caches are rejected */
+  g_assert_null (_foundry_gir_data_load (path, 1235, strlen (test_gir), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_clear_error (&error);
+
+  g_assert_null (_foundry_gir_data_load (path, 1234, strlen (test_gir) + 1, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_clear_error (&error);
+
+  /* Truncated and corrupt caches are rejected */
+  g_assert_true (g_file_get_contents (path, &contents, &len, NULL));
+
+  g_assert_true (g_file_set_contents (path, contents, len - 1, NULL));
+  g_assert_null (_foundry_gir_data_load (path, 1234, strlen (test_gir), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_clear_error (&error);
+
+  contents[len - 1] = 'x';
+  g_assert_true (g_file_set_contents (path, contents, len, NULL));
+  g_assert_null (_foundry_gir_data_load (path, 1234, strlen (test_gir), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  g_clear_error (&error);
+
+  g_unlink (path);
+  g_rmdir (tmpdir);
+}
+
+static void
+test_gir_parse_errors (void)
+{
+  static const char *invalid[] = {
+    "",
+    "<namespace name=\"Test\"/>",
+    "<repository><namespace></repository>",
+    "<repository/><repository/>",
+  };
+
+  for (guint i = 0; i < G_N_ELEMENTS (invalid); i++)
+    {
+      g_autoptr(GBytes) bytes = g_bytes_new_static (invalid[i], strlen (invalid[i]));
+      g_autoptr(FoundryGirData) data = NULL;
+      g_autoptr(GError) error = NULL;
+
+      data = _foundry_gir_data_parse (bytes, 0, 0, &error);
+      g_assert_null (data);
+      g_assert_nonnull (error);
+    }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+  g_test_add_func ("/Foundry/Gir/cache", test_gir_cache);
+  g_test_add_func ("/Foundry/Gir/data", test_gir_data);
+  g_test_add_func ("/Foundry/Gir/parse-errors", test_gir_parse_errors);
+
+  return g_test_run ();
+}
@@ -0,0 +1,398 @@
+/* test-git-blame.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+#include <git2.h>
+#include <string.h>
+
+#include "foundry-git-autocleanups.h"
+#include "foundry-git-blame-private.h"
+#include "foundry-git-private.h"
+
+#include "test-util.h"
+
+#define N_LINES   60
+#define N_EDITS   200
+#define FILE_NAME "file.txt"
+
+static const char zero_oid[GIT_OID_HEXSZ + 1] = "0000000000000000000000000000000000000000";
+
+/* Every revision rewrites a different subset of lines so the final blame
+ * has many small hunks from several commits. Line contents are unique so
+ * that a fresh blame can only ever match them one way.
+ */
+static char *
+create_contents (guint revision)
+{
+  GString *str = g_string_new (NULL);
+
+  for (guint i = 0; i < N_LINES; i++)
+    {
+      guint last = 0;
+
+      for (guint r = 1; r <= revision; r++)
+        {
+          if (i % (r + 2) == 0)
+            last = r;
+        }
+
+      g_string_append_printf (str, "line %02u from revision %u\n", i, last);
+    }
+
+  return g_string_free (str, FALSE);
+}
+
+static void
+create_repository (git_repository **repository,
+                   char           **tmpdir)
+{
+  g_autoptr(git_index) index = NULL;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-git-blame-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  g_assert_cmpint (git_repository_init (repository, *tmpdir, FALSE), ==, 0);
+  g_assert_cmpint (git_repository_index (&index, *repository), ==, 0);
+
+  for (guint revision = 0; revision < 4; revision++)
+    {
+      g_autoptr(git_signature) signature = NULL;
+      g_autoptr(git_commit) parent = NULL;
+      g_autoptr(git_tree) tree = NULL;
+      g_autofree char *contents = create_contents (revision);
+      g_autofree char *message = g_strdup_printf ("Revision %u", revision);
+      const git_commit *parents[1];
+      git_index_entry entry = {0};
+      git_oid parent_oid;
+      git_oid tree_oid;
+      git_oid oid;
+
+      entry.mode = GIT_FILEMODE_BLOB;
+      entry.path = FILE_NAME;
+
+      g_assert_cmpint (git_index_add_from_buffer (index, &entry, contents, strlen (contents)), ==, 0);
+      g_assert_cmpint (git_index_write_tree (&tree_oid, index), ==, 0);
+      g_assert_cmpint (git_tree_lookup (&tree, *repository, &tree_oid), ==, 0);
+      g_assert_cmpint (git_signature_new (&signature, "Test", "test@example.com", 1000000000 + revision * 60, 0), ==, 0);
+
+      if (git_reference_name_to_id (&parent_oid, *repository, "HEAD") == 0)
+        g_assert_cmpint (git_commit_lookup (&parent, *repository, &parent_oid), ==, 0);
+
+      parents[0] = parent;
+
+      g_assert_cmpint (git_commit_create (&oid, *repository, "HEAD",
+                                          signature, signature, NULL, message,
+                                          tree, parent ? 1 : 0, parents),
+                       ==, 0);
+    }
+}
+
+/* Compares @blame against a fresh blame of the buffer contents. Until the
+ * buffer is blamed again, lines touched by an edit are only known to be
+ * uncommitted, so @exact is %FALSE and just the committed lines must agree.
+ */
+static void
+assert_blame_matches (FoundryGitBlame   *blame,
+                      git_blame         *reference,
+                      FoundryTextBuffer *buffer,
+                      gboolean           exact)
+{
+  g_autoptr(git_blame) fresh = NULL;
+  g_autoptr(GBytes) bytes = foundry_text_buffer_dup_contents (buffer);
+  gsize hunk_count;
+  guint n_lines = 0;
+  gsize size;
+  const char *data = g_bytes_get_data (bytes, &size);
+
+  g_assert_cmpint (git_blame_buffer (&fresh, reference, data, size), ==, 0);
+
+  hunk_count = git_blame_get_hunk_count (fresh);
+  for (gsize i = 0; i < hunk_count; i++)
+    n_lines += git_blame_get_hunk_byindex (fresh, i)->lines_in_hunk;
+
+  g_assert_cmpint (foundry_vcs_blame_get_n_lines (FOUNDRY_VCS_BLAME (blame)), ==, n_lines);
+
+  for (guint i = 0; i < n_lines; i++)
+    {
+      const git_blame_hunk *hunk = git_blame_get_hunk_byline (fresh, i + 1);
+      g_autoptr(FoundryVcsSignature) signature = NULL;
+      g_autofree char *expected = NULL;
+      g_autofree char *actual = NULL;
+
+      g_assert_nonnull (hunk);
+
+      expected = _foundry_git_oid_dup_string (&hunk->final_commit_id);
+      actual = foundry_git_blame_dup_commit_id (blame, i);
+      signature = foundry_vcs_blame_query_line (FOUNDRY_VCS_BLAME (blame), i);
+
+      g_assert_nonnull (actual);
+
+      if (exact)
+        {
+          g_assert_cmpstr (actual, ==, expected);
+          g_assert_true ((signature == NULL) == (hunk->final_signature == NULL));
+        }
+      else if (!g_str_equal (actual, zero_oid))
+        {
+          g_assert_cmpstr (actual, ==, expected);
+          g_assert_nonnull (signature);
+        }
+      else
+        {
+          g_assert_null (signature);
+        }
+    }
+
+  g_assert_null (foundry_git_blame_dup_commit_id (blame, n_lines));
+}
+
+static void
+apply_edit (FoundryTextBuffer *buffer,
+            guint              begin_line,
+            int                begin_line_offset,
+            guint              end_line,
+            int                end_line_offset,
+            const char        *replacement)
+{
+  g_autoptr(FoundryTextEdit) edit = NULL;
+
+  edit = foundry_text_edit_new (NULL,
+                                begin_line, begin_line_offset,
+                                end_line, end_line_offset,
+                                replacement);
+  g_assert_true (foundry_text_buffer_apply_edit (buffer, edit));
+}
+
+static void
+apply_random_edit (FoundryTextBuffer *buffer,
+                   GRand             *rand,
+                   guint              n)
+{
+  g_autoptr(GBytes) bytes = foundry_text_buffer_dup_contents (buffer);
+  g_auto(GStrv) lines = g_strsplit (g_bytes_get_data (bytes, NULL), "\n", -1);
+  g_autofree char *replacement = NULL;
+  guint n_lines = g_strv_length (lines);
+  guint begin_line = g_rand_int_range (rand, 0, n_lines);
+  guint end_line = MIN (n_lines - 1, begin_line + g_rand_int_range (rand, 0, 2));
+  int begin_line_offset = g_rand_int_range (rand, 0, strlen (lines[begin_line]) + 1);
+  int end_line_offset = g_rand_int_range (rand, 0, strlen (lines[end_line]) + 1);
+
+  switch (g_rand_int_range (rand, 0, 6))
+    {
+    case 0:
+      break;
+
+    case 1:
+      replacement = g_strdup_printf ("#%u", n);
+      break;
+
+    case 2:
+      replacement = g_strdup_printf ("#%u\n", n);
+      break;
+
+    case 3:
+      replacement = g_strdup ("\n");
+      break;
+
+    case 4:
+      replacement = g_strdup_printf ("#%u\n#%u-b\n", n, n);
+      break;
+
+    default:
+      replacement = g_strdup_printf ("#%u\n#%u-b", n, n);
+      break;
+    }
+
+  if (begin_line == end_line && end_line_offset < begin_line_offset)
+    end_line_offset = begin_line_offset;
+
+  /* Start and end of lines, including the end of the buffer, are where
+   * the interesting cases are so favor them.
+   */
+  if (g_rand_boolean (rand))
+    begin_line_offset = 0;
+  if (g_rand_boolean (rand))
+    end_line_offset = begin_line == end_line ? begin_line_offset : 0;
+
+  apply_edit (buffer, begin_line, begin_line_offset, end_line, end_line_offset, replacement);
+}
+
+static FoundryGitBlame *
+create_blame (git_repository     *repository,
+              FoundryTextBuffer  *buffer,
+              git_blame         **reference)
+{
+  g_autoptr(git_blame) base = NULL;
+  FoundryGitBlame *blame;
+
+  g_assert_cmpint (git_blame_file (&base, repository, FILE_NAME, NULL), ==, 0);
+  g_assert_cmpint (git_blame_file (reference, repository, FILE_NAME, NULL), ==, 0);
+
+  blame = _foundry_git_blame_new (g_steal_pointer (&base), NULL);
+  foundry_git_blame_follow_buffer (blame, buffer);
+
+  assert_blame_matches (blame, *reference, buffer, TRUE);
+
+  return blame;
+}
+
+static void
+test_blame_scripted_edits_fiber (void)
+{
+  g_autoptr(git_repository) repository = NULL;
+  g_autoptr(git_blame) reference = NULL;
+  g_autoptr(FoundryGitBlame) blame = NULL;
+  g_autoptr(FoundryTextBuffer) buffer = NULL;
+  g_autoptr(GRand) rand = g_rand_new_with_seed (1234);
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = create_contents (3);
+  g_autofree char *tmpdir = NULL;
+
+  git_libgit2_init ();
+
+  create_repository (&repository, &tmpdir);
+
+  buffer = foundry_simple_text_buffer_new_for_string (contents, -1);
+  blame = create_blame (repository, buffer, &reference);
+
+  /* Split a line */
+  apply_edit (buffer, 3, 4, 3, 4, "\n");
+  assert_blame_matches (blame, reference, buffer, FALSE);
+
+  /* Join two lines */
+  apply_edit (buffer, 10, -1, 11, 0, NULL);
+  assert_blame_matches (blame, reference, buffer, FALSE);
+
+  /* Insert and remove whole lines */
+  apply_edit (buffer, 0, 0, 0, 0, "first\nsecond\n");
+  assert_blame_matches (blame, reference, buffer, FALSE);
+  apply_edit (buffer, 20, 0, 23, 0, NULL);
+  assert_blame_matches (blame, reference, buffer, FALSE);
+
+  /* Modify within a line */
+  apply_edit (buffer, 30, 2, 30, 6, "modified");
+  assert_blame_matches (blame, reference, buffer, FALSE);
+
+  /* Remove the trailing newline, then add a line after it */
+  apply_edit (buffer, 58, -1, 59, 0, NULL);
+  assert_blame_matches (blame, reference, buffer, FALSE);
+  apply_edit (buffer, 58, -1, 58, -1, "\nlast");
+  assert_blame_matches (blame, reference, buffer, FALSE);
+  apply_edit (buffer, 59, -1, 59, -1, "\n");
+  assert_blame_matches (blame, reference, buffer, FALSE);
+
+  g_assert_true (dex_await_boolean (_foundry_git_blame_reblame (blame), &error));
+  g_assert_no_error (error);
+  assert_blame_matches (blame, reference, buffer, TRUE);
+
+  for (guint i = 0; i < N_EDITS; i++)
+    {
+      apply_random_edit (buffer, rand, i);
+      assert_blame_matches (blame, reference, buffer, FALSE);
+
+      if (i % 16 == 15)
+        {
+          g_assert_true (dex_await_boolean (_foundry_git_blame_reblame (blame), &error));
+          g_assert_no_error (error);
+          assert_blame_matches (blame, reference, buffer, TRUE);
+        }
+    }
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_blame_scripted_edits (void)
+{
+  test_from_fiber (test_blame_scripted_edits_fiber);
+}
+
+static void
+test_blame_idle_fiber (void)
+{
+  g_autoptr(git_repository) repository = NULL;
+  g_autoptr(git_blame) reference = NULL;
+  g_autoptr(FoundryGitBlame) blame = NULL;
+  g_autoptr(FoundryTextBuffer) buffer = NULL;
+  g_autofree char *contents = create_contents (3);
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *committed = NULL;
+  g_autofree char *edited = NULL;
+
+  git_libgit2_init ();
+
+  create_repository (&repository, &tmpdir);
+
+  buffer = foundry_simple_text_buffer_new_for_string (contents, -1);
+  blame = create_blame (repository, buffer, &reference);
+  committed = foundry_git_blame_dup_commit_id (blame, 5);
+
+  /* Typing and then undoing it marks the line uncommitted until the
+   * buffer is blamed again after edits become idle.
+   */
+  apply_edit (buffer, 5, 0, 5, 0, "x");
+  apply_edit (buffer, 5, 0, 5, 1, NULL);
+
+  edited = foundry_git_blame_dup_commit_id (blame, 5);
+  g_assert_cmpstr (edited, ==, zero_oid);
+
+  for (guint i = 0; i < 50; i++)
+    {
+      g_autofree char *current = foundry_git_blame_dup_commit_id (blame, 5);
+
+      if (g_str_equal (current, committed))
+        break;
+
+      dex_await (dex_timeout_new_msec (100), NULL);
+    }
+
+  assert_blame_matches (blame, reference, buffer, TRUE);
+  g_clear_pointer (&edited, g_free);
+  edited = foundry_git_blame_dup_commit_id (blame, 5);
+  g_assert_cmpstr (edited, ==, committed);
+
+  /* Edits are no longer tracked once the buffer is no longer followed */
+  foundry_git_blame_follow_buffer (blame, NULL);
+  apply_edit (buffer, 0, 0, 0, 0, "unfollowed\n");
+  g_assert_cmpint (foundry_vcs_blame_get_n_lines (FOUNDRY_VCS_BLAME (blame)), ==, N_LINES);
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_blame_idle (void)
+{
+  test_from_fiber (test_blame_idle_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/Git/Blame/scripted-edits", test_blame_scripted_edits);
+  g_test_add_func ("/Foundry/Git/Blame/idle", test_blame_idle);
+
+  return g_test_run ();
+}
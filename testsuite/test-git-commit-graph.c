@@ -0,0 +1,250 @@
+/* test-git-commit-graph.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+#include <git2.h>
+#include <string.h>
+
+#include "foundry-git-autocleanups.h"
+#include "foundry-git-commit-graph-private.h"
+
+#include "test-util.h"
+
+#define N_COMMITS 50
+
+static char *
+commit_path (guint i)
+{
+  return g_strdup_printf ("dir-%u/sub/file-%u.c", i % 5, i % 10);
+}
+
+static void
+create_commits (git_repository *repository,
+                guint           first,
+                guint           last)
+{
+  g_autoptr(git_index) index = NULL;
+
+  g_assert_cmpint (git_repository_index (&index, repository), ==, 0);
+
+  for (guint i = first; i <= last; i++)
+    {
+      g_autoptr(git_signature) signature = NULL;
+      g_autoptr(git_commit) parent = NULL;
+      g_autoptr(git_tree) tree = NULL;
+      g_autofree char *path = commit_path (i);
+      g_autofree char *contents = g_strdup_printf ("%u\n", i);
+      g_autofree char *message = g_strdup_printf ("Commit %u", i);
+      const git_commit *parents[1];
+      git_index_entry entry = {0};
+      git_oid tree_oid;
+      git_oid parent_oid;
+      git_oid oid;
+
+      entry.mode = GIT_FILEMODE_BLOB;
+      entry.path = path;
+
+      g_assert_cmpint (git_index_add_from_buffer (index, &entry, contents, strlen (contents)), ==, 0);
+      g_assert_cmpint (git_index_write_tree (&tree_oid, index), ==, 0);
+      g_assert_cmpint (git_tree_lookup (&tree, repository, &tree_oid), ==, 0);
+      g_assert_cmpint (git_signature_new (&signature, "Test", "test@example.com", 1000000000 + i * 60, 0), ==, 0);
+
+      if (git_reference_name_to_id (&parent_oid, repository, "HEAD") == 0)
+        g_assert_cmpint (git_commit_lookup (&parent, repository, &parent_oid), ==, 0);
+
+      parents[0] = parent;
+
+      g_assert_cmpint (git_commit_create (&oid, repository, "HEAD",
+                                          signature, signature, NULL, message,
+                                          tree, parent ? 1 : 0, parents),
+                       ==, 0);
+    }
+}
+
+static git_repository *
+create_repository (char **tmpdir)
+{
+  git_repository *repository = NULL;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-commit-graph-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  g_assert_cmpint (git_repository_init (&repository, *tmpdir, FALSE), ==, 0);
+
+  create_commits (repository, 0, N_COMMITS - 1);
+
+  return repository;
+}
+
+static void
+assert_no_false_negatives (FoundryGitCommitGraph *graph,
+                           git_repository        *repository)
+{
+  g_autoptr(git_revwalk) walker = NULL;
+  git_oid oid;
+
+  g_assert_cmpint (git_revwalk_new (&walker, repository), ==, 0);
+  git_revwalk_push_head (walker);
+
+  while (git_revwalk_next (&oid, walker) == 0)
+    {
+      g_autoptr(git_commit) commit = NULL;
+      g_autofree char *path = NULL;
+      FoundryGitBloomKey key;
+      guint position;
+      guint i;
+
+      g_assert_cmpint (git_commit_lookup (&commit, repository, &oid), ==, 0);
+      g_assert_true (_foundry_git_commit_graph_lookup (graph, &oid, &position));
+
+      i = g_ascii_strtoull (git_commit_message (commit) + strlen ("Commit "), NULL, 10);
+      path = commit_path (i);
+
+      _foundry_git_bloom_key_init (&key, path);
+      g_assert_true (_foundry_git_commit_graph_maybe_changed (graph, position, &key));
+
+      /* Leading directories are added too */
+      *strrchr (path, '/') = 0;
+      _foundry_git_bloom_key_init (&key, path);
+      g_assert_true (_foundry_git_commit_graph_maybe_changed (graph, position, &key));
+
+      *strrchr (path, '/') = 0;
+      _foundry_git_bloom_key_init (&key, path);
+      g_assert_true (_foundry_git_commit_graph_maybe_changed (graph, position, &key));
+    }
+}
+
+static void
+test_murmur3 (void)
+{
+  /* Reference values from the canonical MurmurHash3_x86_32 */
+  g_assert_cmphex (_foundry_git_murmur3 (0, "", 0), ==, 0);
+  g_assert_cmphex (_foundry_git_murmur3 (0, "Hello world!", 12), ==, 0x627b0c2c);
+  g_assert_cmphex (_foundry_git_murmur3 (0, "The quick brown fox jumps over the lazy dog", 43), ==, 0x2e4ff723);
+
+  /* Bytes with the high bit set must be hashed as unsigned */
+  g_assert_cmphex (_foundry_git_murmur3 (0, "D\xc3\xa9j\xc3\xa0 vu", 9), ==, 0xaca4825f);
+}
+
+static void
+test_commit_graph_fiber (void)
+{
+  g_autoptr(FoundryGitCommitGraph) graph = NULL;
+  g_autoptr(FoundryGitCommitGraph) loaded = NULL;
+  g_autoptr(git_repository) repository = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *graph_path = NULL;
+  FoundryGitBloomKey missing;
+  guint n_positives = 0;
+  guint n_added = 0;
+  guint position;
+  git_oid head;
+
+  git_libgit2_init ();
+
+  repository = create_repository (&tmpdir);
+  graph_path = g_build_filename (tmpdir, "commit-graph", NULL);
+
+  g_assert_cmpint (git_reference_name_to_id (&head, repository, "HEAD"), ==, 0);
+
+  graph = _foundry_git_commit_graph_new ();
+  g_assert_true (_foundry_git_commit_graph_update (graph, repository, &head, &n_added, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (n_added, ==, N_COMMITS);
+  g_assert_cmpint (_foundry_git_commit_graph_get_n_commits (graph), ==, N_COMMITS);
+
+  g_assert_true (_foundry_git_commit_graph_lookup (graph, &head, &position));
+  g_assert_cmpint (_foundry_git_commit_graph_get_generation (graph, position), ==, N_COMMITS);
+  g_assert_cmpint (_foundry_git_commit_graph_get_n_parents (graph, position), ==, 1);
+
+  assert_no_false_negatives (graph, repository);
+
+  /* A path that was never touched should be rejected by most filters */
+  _foundry_git_bloom_key_init (&missing, "never/touched.c");
+  for (guint i = 0; i < N_COMMITS; i++)
+    n_positives += _foundry_git_commit_graph_maybe_changed (graph, i, &missing);
+  g_assert_cmpint (n_positives, <, N_COMMITS / 4);
+
+  /* Round-trip through the file format */
+  g_assert_true (_foundry_git_commit_graph_save (graph, graph_path, &error));
+  g_assert_no_error (error);
+
+  loaded = _foundry_git_commit_graph_load (graph_path, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (loaded);
+  g_assert_cmpint (_foundry_git_commit_graph_get_n_commits (loaded), ==, N_COMMITS);
+
+  for (guint i = 0; i < N_COMMITS; i++)
+    {
+      g_assert_cmpint (_foundry_git_commit_graph_get_generation (loaded, i), ==,
+                       _foundry_git_commit_graph_get_generation (graph, i));
+      g_assert_cmpint (_foundry_git_commit_graph_get_n_parents (loaded, i), ==,
+                       _foundry_git_commit_graph_get_n_parents (graph, i));
+      g_assert_cmpint (_foundry_git_commit_graph_maybe_changed (loaded, i, &missing), ==,
+                       _foundry_git_commit_graph_maybe_changed (graph, i, &missing));
+    }
+
+  assert_no_false_negatives (loaded, repository);
+
+  /* Only new commits are added on update */
+  g_assert_true (_foundry_git_commit_graph_update (loaded, repository, &head, &n_added, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (n_added, ==, 0);
+
+  create_commits (repository, N_COMMITS, N_COMMITS + 4);
+  g_assert_cmpint (git_reference_name_to_id (&head, repository, "HEAD"), ==, 0);
+
+  g_assert_true (_foundry_git_commit_graph_update (loaded, repository, &head, &n_added, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (n_added, ==, 5);
+  g_assert_true (_foundry_git_commit_graph_lookup (loaded, &head, &position));
+  g_assert_cmpint (_foundry_git_commit_graph_get_generation (loaded, position), ==, N_COMMITS + 5);
+
+  assert_no_false_negatives (loaded, repository);
+
+  /* Corrupt files are rejected rather than trusted */
+  g_assert_true (g_file_set_contents (graph_path, "CGPH", 4, NULL));
+  g_assert_null (_foundry_git_commit_graph_load (graph_path, &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_commit_graph (void)
+{
+  test_from_fiber (test_commit_graph_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/Git/CommitGraph/murmur3", test_murmur3);
+  g_test_add_func ("/Foundry/Git/CommitGraph/basic", test_commit_graph);
+
+  return g_test_run ();
+}
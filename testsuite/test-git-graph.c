@@ -0,0 +1,324 @@
+/* test-git-graph.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+#include <git2.h>
+
+#include "foundry-git-autocleanups.h"
+#include "foundry-git-graph-layout-private.h"
+#include "foundry-git-graph-private.h"
+
+#include "test-util.h"
+
+#define MAX_HEADS 12
+
+static void
+create_commit (git_repository *repository,
+               git_tree       *tree,
+               guint           n,
+               gint64          time,
+               const git_oid  *parent_oids,
+               guint           n_parents,
+               git_oid        *oid)
+{
+  g_autoptr(git_signature) signature = NULL;
+  g_autoptr(GPtrArray) parents = g_ptr_array_new_with_free_func ((GDestroyNotify) git_commit_free);
+  g_autofree char *message = g_strdup_printf ("Commit %u", n);
+
+  for (guint i = 0; i < n_parents; i++)
+    {
+      git_commit *parent = NULL;
+
+      g_assert_cmpint (git_commit_lookup (&parent, repository, &parent_oids[i]), ==, 0);
+      g_ptr_array_add (parents, parent);
+    }
+
+  g_assert_cmpint (git_signature_new (&signature, "Test", "test@example.com", time, 0), ==, 0);
+  g_assert_cmpint (git_commit_create (oid, repository, NULL,
+                                      signature, signature, NULL, message,
+                                      tree, n_parents, (const git_commit **)parents->pdata),
+                   ==, 0);
+}
+
+/* Generates a history with branches, merges, octopus merges, extra root
+ * commits and clock skew, then merges every head into @tip.
+ */
+static void
+create_history (git_repository *repository,
+                guint32         seed,
+                guint           n_commits,
+                git_oid        *tip)
+{
+  g_autoptr(GRand) rand = g_rand_new_with_seed (seed);
+  g_autoptr(GArray) heads = g_array_new (FALSE, FALSE, sizeof (git_oid));
+  g_autoptr(git_treebuilder) treebuilder = NULL;
+  g_autoptr(git_tree) tree = NULL;
+  git_oid tree_oid;
+
+  g_assert_cmpint (git_treebuilder_new (&treebuilder, repository, NULL), ==, 0);
+  g_assert_cmpint (git_treebuilder_write (&tree_oid, treebuilder), ==, 0);
+  g_assert_cmpint (git_tree_lookup (&tree, repository, &tree_oid), ==, 0);
+
+  for (guint i = 0; i < n_commits; i++)
+    {
+      gint64 time = 1000000000 + i * 60 + g_rand_int_range (rand, -600, 600);
+      guint action = g_rand_int_range (rand, 0, 100);
+      git_oid parents[3];
+      git_oid oid;
+
+      if (heads->len == 0 || action < 2)
+        {
+          /* Unrelated history */
+          create_commit (repository, tree, i, time, NULL, 0, &oid);
+          g_array_append_val (heads, oid);
+        }
+      else if (heads->len >= 2 && (action < 25 || heads->len >= MAX_HEADS))
+        {
+          guint n_parents = (heads->len >= 3 && action < 5) ? 3 : 2;
+
+          /* Merge random heads into the first one */
+          for (guint p = 0; p < n_parents; p++)
+            {
+              guint index = g_rand_int_range (rand, 0, heads->len);
+
+              parents[p] = g_array_index (heads, git_oid, index);
+              g_array_remove_index (heads, index);
+            }
+
+          create_commit (repository, tree, i, time, parents, n_parents, &oid);
+          g_array_append_val (heads, oid);
+        }
+      else if (action < 45)
+        {
+          /* Branch off, keeping the existing head */
+          parents[0] = g_array_index (heads, git_oid, g_rand_int_range (rand, 0, heads->len));
+          create_commit (repository, tree, i, time, parents, 1, &oid);
+          g_array_append_val (heads, oid);
+        }
+      else
+        {
+          guint index = g_rand_int_range (rand, 0, heads->len);
+
+          parents[0] = g_array_index (heads, git_oid, index);
+          create_commit (repository, tree, i, time, parents, 1, &oid);
+          g_array_index (heads, git_oid, index) = oid;
+        }
+    }
+
+  if (heads->len == 1)
+    *tip = g_array_index (heads, git_oid, 0);
+  else
+    create_commit (repository, tree, n_commits, 1000000000 + n_commits * 60,
+                   (const git_oid *)(gpointer)heads->data, heads->len, tip);
+}
+
+static FoundryGitGraphLayout *
+create_layout (const char    *path,
+               const git_oid *tip,
+               guint          limit)
+{
+  g_autoptr(git_repository) repository = NULL;
+  g_autoptr(GError) error = NULL;
+  FoundryGitGraphLayout *layout;
+
+  g_assert_cmpint (git_repository_open (&repository, path), ==, 0);
+
+  layout = foundry_git_graph_layout_new (g_steal_pointer (&repository), tip, NULL, limit, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (layout);
+
+  return layout;
+}
+
+static FoundryVcsGraph *
+load_one_shot (const char    *path,
+               const git_oid *tip,
+               guint          limit)
+{
+  g_autoptr(FoundryGitGraphLayout) layout = create_layout (path, tip, limit);
+  FoundryGitGraphBuilder *builder = foundry_git_graph_builder_new ();
+  g_autoptr(GError) error = NULL;
+
+  g_assert_true (foundry_git_graph_layout_step (layout, builder, G_MAXUINT, NULL, &error));
+  g_assert_no_error (error);
+  g_assert_true (foundry_git_graph_layout_is_done (layout));
+
+  return foundry_git_graph_builder_finish (builder, foundry_git_graph_layout_get_n_lanes (layout));
+}
+
+static void
+count_added (GListModel *model,
+             guint       position,
+             guint       removed,
+             guint       added,
+             guint      *n_items)
+{
+  g_assert_cmpint (removed, ==, 0);
+  g_assert_cmpint (position, ==, *n_items);
+
+  *n_items += added;
+}
+
+static FoundryVcsGraph *
+load_paged (const char    *path,
+            const git_oid *tip,
+            guint          limit,
+            guint          page_size)
+{
+  FoundryGitGraphLayout *layout = create_layout (path, tip, limit);
+  FoundryGitGraphBuilder *builder = foundry_git_graph_builder_new ();
+  g_autoptr(FoundryVcsGraph) graph = NULL;
+  g_autoptr(GError) error = NULL;
+  guint n_pages = 1;
+  guint n_items;
+
+  g_assert_true (foundry_git_graph_layout_step (layout, builder, page_size, NULL, &error));
+  g_assert_no_error (error);
+
+  graph = foundry_git_graph_new_paged (builder, layout, page_size);
+  n_items = g_list_model_get_n_items (G_LIST_MODEL (graph));
+  g_assert_cmpint (n_items, <=, page_size);
+
+  g_signal_connect (graph, "items-changed", G_CALLBACK (count_added), &n_items);
+
+  while (!foundry_git_graph_is_complete (graph))
+    {
+      guint n_added = dex_await_uint (foundry_git_graph_load_more (graph), &error);
+
+      g_assert_no_error (error);
+      g_assert_cmpint (n_added, <=, page_size);
+      g_assert_cmpint (n_items, ==, g_list_model_get_n_items (G_LIST_MODEL (graph)));
+
+      n_pages++;
+    }
+
+  g_assert_cmpint (dex_await_uint (foundry_git_graph_load_more (graph), NULL), ==, 0);
+  g_assert_cmpint (n_pages, >=, n_items / page_size);
+
+  g_signal_handlers_disconnect_by_func (graph, count_added, &n_items);
+
+  return g_steal_pointer (&graph);
+}
+
+static void
+assert_graphs_equal (FoundryVcsGraph *expected,
+                     FoundryVcsGraph *actual)
+{
+  guint n_items = g_list_model_get_n_items (G_LIST_MODEL (expected));
+
+  g_assert_cmpint (n_items, >, 0);
+  g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (actual)), ==, n_items);
+  g_assert_cmpint (foundry_vcs_graph_get_n_lanes (actual), ==, foundry_vcs_graph_get_n_lanes (expected));
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(FoundryVcsGraphEntry) a = foundry_vcs_graph_dup_entry (expected, i);
+      g_autoptr(FoundryVcsGraphEntry) b = foundry_vcs_graph_dup_entry (actual, i);
+      g_autofree char *a_id = foundry_vcs_graph_entry_dup_commit_id (a);
+      g_autofree char *b_id = foundry_vcs_graph_entry_dup_commit_id (b);
+      guint n_segments = foundry_vcs_graph_entry_get_n_segments (a);
+
+      g_assert_cmpstr (a_id, ==, b_id);
+      g_assert_cmpint (foundry_vcs_graph_entry_get_commit_lane (a), ==, foundry_vcs_graph_entry_get_commit_lane (b));
+      g_assert_cmpint (foundry_vcs_graph_entry_get_n_lanes (a), ==, foundry_vcs_graph_entry_get_n_lanes (b));
+      g_assert_cmpint (foundry_vcs_graph_entry_get_n_segments (b), ==, n_segments);
+
+      for (guint j = 0; j < n_segments; j++)
+        {
+          FoundryVcsGraphSegment sa;
+          FoundryVcsGraphSegment sb;
+
+          g_assert_true (foundry_vcs_graph_entry_get_segment (a, j, &sa));
+          g_assert_true (foundry_vcs_graph_entry_get_segment (b, j, &sb));
+
+          g_assert_cmpint (sa.from_lane, ==, sb.from_lane);
+          g_assert_cmpint (sa.to_lane, ==, sb.to_lane);
+          g_assert_cmpint (sa.from_point, ==, sb.from_point);
+          g_assert_cmpint (sa.to_point, ==, sb.to_point);
+          g_assert_cmpint (sa.color_id, ==, sb.color_id);
+        }
+    }
+}
+
+static void
+test_paged_equivalence_fiber (void)
+{
+  static const guint page_sizes[] = { 1, 7, 64, 1000 };
+  static const guint32 seeds[] = { 1, 42, 1337 };
+
+  git_libgit2_init ();
+
+  for (guint s = 0; s < G_N_ELEMENTS (seeds); s++)
+    {
+      g_autoptr(git_repository) repository = NULL;
+      g_autoptr(FoundryVcsGraph) expected = NULL;
+      g_autoptr(FoundryVcsGraph) limited = NULL;
+      g_autofree char *tmpdir = NULL;
+      git_oid tip;
+
+      tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-git-graph-XXXXXX", NULL);
+      g_assert_nonnull (g_mkdtemp (tmpdir));
+      g_assert_cmpint (git_repository_init (&repository, tmpdir, TRUE), ==, 0);
+
+      create_history (repository, seeds[s], 400, &tip);
+
+      expected = load_one_shot (tmpdir, &tip, 0);
+
+      for (guint p = 0; p < G_N_ELEMENTS (page_sizes); p++)
+        {
+          g_autoptr(FoundryVcsGraph) paged = load_paged (tmpdir, &tip, 0, page_sizes[p]);
+
+          assert_graphs_equal (expected, paged);
+        }
+
+      /* The row limit must be honored across pages too */
+      limited = load_one_shot (tmpdir, &tip, 123);
+      g_assert_cmpint (g_list_model_get_n_items (G_LIST_MODEL (limited)), ==, 123);
+
+      for (guint p = 0; p < G_N_ELEMENTS (page_sizes); p++)
+        {
+          g_autoptr(FoundryVcsGraph) paged = load_paged (tmpdir, &tip, 123, page_sizes[p]);
+
+          assert_graphs_equal (limited, paged);
+        }
+
+      rm_rf (tmpdir);
+    }
+}
+
+static void
+test_paged_equivalence (void)
+{
+  test_from_fiber (test_paged_equivalence_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/Git/Graph/paged-equivalence", test_paged_equivalence);
+
+  return g_test_run ();
+}
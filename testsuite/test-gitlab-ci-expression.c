@@ -0,0 +1,277 @@
+/* test-gitlab-ci-expression.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "plugins/gitlab-ci/plugin-gitlab-ci-error-private.h"
+#include "plugins/gitlab-ci/plugin-gitlab-ci-expression-private.h"
+
+static PluginGitlabCiContext *
+create_context (void)
+{
+  PluginGitlabCiContext *context = g_new0 (PluginGitlabCiContext, 1);
+
+  g_atomic_ref_count_init (&context->ref_count);
+  context->repository_root = g_strdup ("/nonexistent");
+  context->configuration_path = g_strdup ("/nonexistent/.gitlab-ci.yml");
+  context->server_host = g_strdup ("gitlab.com");
+  context->variables = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  context->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  context->changed_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  return context;
+}
+
+static void
+set_variable (PluginGitlabCiContext *context,
+              const char            *name,
+              const char            *value)
+{
+  g_hash_table_insert (context->variables, g_strdup (name), g_strdup (value));
+}
+
+static gboolean
+evaluate (PluginGitlabCiContext *context,
+          const char            *text)
+{
+  g_autoptr(PluginGitlabCiExpression) expression = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean result = FALSE;
+
+  expression = plugin_gitlab_ci_expression_new (text, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (expression);
+
+  g_assert_true (plugin_gitlab_ci_expression_evaluate (expression, context, NULL, &result, &error));
+  g_assert_no_error (error);
+
+  return result;
+}
+
+static void
+assert_parse_error (const char *text)
+{
+  g_autoptr(PluginGitlabCiExpression) expression = NULL;
+  g_autoptr(GError) error = NULL;
+
+  expression = plugin_gitlab_ci_expression_new (text, &error);
+  g_assert_error (error, PLUGIN_GITLAB_CI_ERROR, PLUGIN_GITLAB_CI_ERROR_INVALID_DATA);
+  g_assert_null (expression);
+}
+
+static void
+assert_evaluate_error (PluginGitlabCiContext *context,
+                       const char            *text)
+{
+  g_autoptr(PluginGitlabCiExpression) expression = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean result = FALSE;
+
+  expression = plugin_gitlab_ci_expression_new (text, &error);
+  g_assert_no_error (error);
+
+  g_assert_false (plugin_gitlab_ci_expression_evaluate (expression, context, NULL, &result, &error));
+  g_assert_error (error, PLUGIN_GITLAB_CI_ERROR, PLUGIN_GITLAB_CI_ERROR_INVALID_DATA);
+}
+
+static void
+test_compare (void)
+{
+  g_autoptr(PluginGitlabCiContext) context = create_context ();
+
+  set_variable (context, "BRANCH", "main");
+
+  g_assert_true (evaluate (context, "$BRANCH == \"main\""));
+  g_assert_true (evaluate (context, "${BRANCH} == 'main'"));
+  g_assert_false (evaluate (context, "$BRANCH == \"stable\""));
+  g_assert_true (evaluate (context, "$BRANCH != \"stable\""));
+  g_assert_false (evaluate (context, "$BRANCH != \"main\""));
+
+  g_assert_true (evaluate (context, "$BRANCH =~ /^ma/"));
+  g_assert_false (evaluate (context, "$BRANCH =~ /^st/"));
+  g_assert_true (evaluate (context, "$BRANCH !~ /^st/"));
+  g_assert_false (evaluate (context, "$BRANCH !~ /^ma/"));
+  g_assert_true (evaluate (context, "$BRANCH =~ /^(main|stable\\/.*)$/"));
+}
+
+static void
+test_null (void)
+{
+  g_autoptr(PluginGitlabCiContext) context = create_context ();
+
+  set_variable (context, "EMPTY", "");
+  set_variable (context, "SET", "1");
+
+  /* Undefined variables are null, empty ones are not */
+  g_assert_true (evaluate (context, "$UNDEFINED == null"));
+  g_assert_false (evaluate (context, "$UNDEFINED != null"));
+  g_assert_false (evaluate (context, "$EMPTY == null"));
+  g_assert_true (evaluate (context, "$EMPTY == \"\""));
+  g_assert_true (evaluate (context, "null == null"));
+  g_assert_true (evaluate (context, "$UNDEFINED != \"1\""));
+
+  /* Only non-empty values are truthy */
+  g_assert_false (evaluate (context, "$UNDEFINED"));
+  g_assert_false (evaluate (context, "$EMPTY"));
+  g_assert_true (evaluate (context, "$SET"));
+
+  /* Null never matches a pattern */
+  g_assert_false (evaluate (context, "$UNDEFINED =~ /.*/"));
+  g_assert_true (evaluate (context, "$UNDEFINED !~ /.*/"));
+}
+
+static void
+test_variable_regex (void)
+{
+  g_autoptr(PluginGitlabCiContext) context = create_context ();
+
+  set_variable (context, "PATTERN", "^(x86_64|aarch64)$");
+  set_variable (context, "TARGET", "aarch64");
+
+  g_assert_true (evaluate (context, "$TARGET =~ $PATTERN"));
+  g_assert_false (evaluate (context, "$TARGET !~ $PATTERN"));
+
+  set_variable (context, "TARGET", "i386");
+  g_assert_false (evaluate (context, "$TARGET =~ $PATTERN"));
+
+  /* Invalid patterns are only known once the variable is resolved */
+  assert_evaluate_error (context, "$TARGET =~ $UNDEFINED");
+
+  set_variable (context, "PATTERN", "(");
+  assert_evaluate_error (context, "$TARGET =~ $PATTERN");
+
+  set_variable (context, "PATTERN", "a**");
+  assert_evaluate_error (context, "$TARGET =~ $PATTERN");
+}
+
+static void
+test_precedence (void)
+{
+  g_autoptr(PluginGitlabCiContext) context = create_context ();
+
+  set_variable (context, "T", "a");
+  set_variable (context, "F", "0");
+
+  /* && binds tighter than || on either side */
+  g_assert_true (evaluate (context, "$T == \"a\" || $T == \"b\" && $F == \"1\""));
+  g_assert_true (evaluate (context, "$F == \"1\" && $T == \"b\" || $T == \"a\""));
+
+  /* Parentheses override it */
+  g_assert_false (evaluate (context, "($T == \"a\" || $T == \"b\") && $F == \"1\""));
+  g_assert_false (evaluate (context, "$F == \"1\" && ($T == \"b\" || $T == \"a\")"));
+  g_assert_true (evaluate (context, "(($T == \"a\"))"));
+  g_assert_true (evaluate (context, "$T && ($F || $UNDEFINED)"));
+  g_assert_false (evaluate (context, "$UNDEFINED && ($T || $F)"));
+}
+
+static void
+test_errors (void)
+{
+  assert_parse_error ("");
+  assert_parse_error ("$A ==");
+  assert_parse_error ("== \"x\"");
+  assert_parse_error ("($A == \"x\"");
+  assert_parse_error ("$A == \"x\")");
+  assert_parse_error ("$A == \"x");
+  assert_parse_error ("$A =~ /abc");
+  assert_parse_error ("${A == \"x\"");
+  assert_parse_error ("$ == \"x\"");
+  assert_parse_error ("$A == \"x\" $B");
+  assert_parse_error ("&& $A");
+  assert_parse_error ("$A &&");
+  assert_parse_error ("$A =~ /(/");
+  assert_parse_error ("$A =~ /a**/");
+}
+
+static void
+test_cache (void)
+{
+  static const char * const expressions[] = {
+    "$BRANCH == \"main\"",
+    "$BRANCH =~ $PATTERN && $SOURCE != \"schedule\"",
+    "$UNDEFINED == null || $BRANCH !~ /^release-/",
+    "($SOURCE == \"push\" || $SOURCE == \"web\") && $BRANCH",
+  };
+  static const char * const branches[] = { "main", "release-1.2", "" };
+  g_autoptr(PluginGitlabCiExpressionCache) cache = plugin_gitlab_ci_expression_cache_new ();
+  g_autoptr(PluginGitlabCiContext) context = create_context ();
+
+  set_variable (context, "SOURCE", "push");
+
+  for (guint b = 0; b < G_N_ELEMENTS (branches); b++)
+    {
+      set_variable (context, "BRANCH", branches[b]);
+
+      /* Changing the pattern must not reuse a regex compiled for another */
+      set_variable (context, "PATTERN", b % 2 ? "^release-" : "^main$");
+
+      for (guint i = 0; i < G_N_ELEMENTS (expressions); i++)
+        {
+          g_autoptr(PluginGitlabCiExpression) first = NULL;
+          g_autoptr(PluginGitlabCiExpression) second = NULL;
+          g_autoptr(GError) error = NULL;
+          gboolean cached_result = FALSE;
+
+          first = plugin_gitlab_ci_expression_cache_lookup (cache, expressions[i], &error);
+          g_assert_no_error (error);
+          second = plugin_gitlab_ci_expression_cache_lookup (cache, expressions[i], &error);
+          g_assert_no_error (error);
+
+          /* Hits return the same parsed expression */
+          g_assert_true (first == second);
+
+          g_assert_true (plugin_gitlab_ci_expression_evaluate (second, context, cache, &cached_result, &error));
+          g_assert_no_error (error);
+
+          g_assert_cmpint (cached_result, ==, evaluate (context, expressions[i]));
+        }
+    }
+
+  /* Failures are not cached */
+  {
+    g_autoptr(PluginGitlabCiExpression) expression = NULL;
+    g_autoptr(GError) error = NULL;
+
+    expression = plugin_gitlab_ci_expression_cache_lookup (cache, "$A ==", &error);
+    g_assert_error (error, PLUGIN_GITLAB_CI_ERROR, PLUGIN_GITLAB_CI_ERROR_INVALID_DATA);
+    g_assert_null (expression);
+    g_clear_error (&error);
+
+    expression = plugin_gitlab_ci_expression_cache_lookup (cache, "$A ==", &error);
+    g_assert_error (error, PLUGIN_GITLAB_CI_ERROR, PLUGIN_GITLAB_CI_ERROR_INVALID_DATA);
+    g_assert_null (expression);
+  }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Plugins/GitlabCi/Expression/compare", test_compare);
+  g_test_add_func ("/Plugins/GitlabCi/Expression/null", test_null);
+  g_test_add_func ("/Plugins/GitlabCi/Expression/variable-regex", test_variable_regex);
+  g_test_add_func ("/Plugins/GitlabCi/Expression/precedence", test_precedence);
+  g_test_add_func ("/Plugins/GitlabCi/Expression/errors", test_errors);
+  g_test_add_func ("/Plugins/GitlabCi/Expression/cache", test_cache);
+  return g_test_run ();
+}
@@ -0,0 +1,180 @@
+/* test-json-input-stream.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "foundry-json-input-stream-private.h"
+#include "test-util.h"
+
+static FoundryJsonInputStream *
+create_stream (const char * const *messages)
+{
+  g_autoptr(GInputStream) base = g_memory_input_stream_new ();
+
+  for (guint i = 0; messages[i]; i++)
+    {
+      g_autofree char *framed = g_strdup_printf ("Content-Length: %u\r\n\r\n%s",
+                                                 (guint)strlen (messages[i]),
+                                                 messages[i]);
+      g_memory_input_stream_add_data (G_MEMORY_INPUT_STREAM (base),
+                                      g_steal_pointer (&framed), -1, g_free);
+    }
+
+  return foundry_json_input_stream_new (base, TRUE);
+}
+
+static gint64
+read_id (FoundryJsonInputStream  *stream,
+         GError                 **error)
+{
+  g_autoptr(JsonNode) node = NULL;
+  gint64 id = -1;
+
+  if (!(node = dex_await_boxed (foundry_json_input_stream_read_http (stream), error)))
+    return -1;
+
+  if (!FOUNDRY_JSON_OBJECT_PARSE (node, "id", FOUNDRY_JSON_NODE_GET_INT (&id)))
+    return -1;
+
+  return id;
+}
+
+static void
+test_read_http_fiber (void)
+{
+  static const char * const messages[] = {
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"a\":\"}\\\"\"}}",
+    "{\"jsonrpc\":\"2.0\",\"id\":2,\"result\":[1,2,3]}",
+    "{\"id\":3,\"jsonrpc\":\"2.0\",\"result\":null}",
+    NULL
+  };
+  g_autoptr(FoundryJsonInputStream) stream = create_stream (messages);
+  g_autoptr(GError) error = NULL;
+
+  g_assert_cmpint (read_id (stream, &error), ==, 1);
+  g_assert_no_error (error);
+  g_assert_cmpint (read_id (stream, &error), ==, 2);
+  g_assert_no_error (error);
+  g_assert_cmpint (read_id (stream, &error), ==, 3);
+  g_assert_no_error (error);
+
+  g_assert_cmpint (read_id (stream, &error), ==, -1);
+  g_assert_error (error, FOUNDRY_JSON_ERROR, FOUNDRY_JSON_ERROR_EOF);
+}
+
+static void
+test_read_http (void)
+{
+  test_from_fiber (test_read_http_fiber);
+}
+
+static gboolean
+drop_even_replies (const char *method,
+                   const char *id,
+                   gpointer    user_data)
+{
+  guint *n_dropped = user_data;
+
+  if (method != NULL || id == NULL)
+    return TRUE;
+
+  if (g_ascii_strtoll (id, NULL, 10) % 2 == 0)
+    {
+      (*n_dropped)++;
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+test_read_http_filter_fiber (void)
+{
+  static const char * const messages[] = {
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":{\"method\":\"nested\"}}",
+    "{\"jsonrpc\":\"2.0\",\"id\":2,\"result\":{\"items\":[{\"label\":\"x\"}]}}",
+    "{\"jsonrpc\":\"2.0\",\"id\":4,\"method\":\"window/workDoneProgress/create\"}",
+    "{\"jsonrpc\":\"2.0\",\"result\":\"\",\"id\":6}",
+    "{\"jsonrpc\":\"2.0\",\"id\":7,\"error\":{\"code\":1,\"message\":\"x\"}}",
+    NULL
+  };
+  g_autoptr(FoundryJsonInputStream) stream = create_stream (messages);
+  g_autoptr(GError) error = NULL;
+  guint n_dropped = 0;
+
+  foundry_json_input_stream_set_filter (stream, drop_even_replies, &n_dropped, NULL);
+
+  g_assert_cmpint (read_id (stream, &error), ==, 1);
+  g_assert_no_error (error);
+
+  /* id 2 is dropped, id 4 is a method call and therefore kept */
+  g_assert_cmpint (read_id (stream, &error), ==, 4);
+  g_assert_no_error (error);
+
+  /* id 6 is dropped */
+  g_assert_cmpint (read_id (stream, &error), ==, 7);
+  g_assert_no_error (error);
+
+  g_assert_cmpint (n_dropped, ==, 2);
+}
+
+static void
+test_read_http_filter (void)
+{
+  test_from_fiber (test_read_http_filter_fiber);
+}
+
+static void
+test_read_http_budget_fiber (void)
+{
+  static const char * const messages[] = {
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":\"this message is larger than the budget\"}",
+    NULL
+  };
+  g_autoptr(FoundryJsonInputStream) stream = create_stream (messages);
+  g_autoptr(GError) error = NULL;
+
+  foundry_json_input_stream_set_max_size_bytes (stream, 16);
+
+  g_assert_cmpint (read_id (stream, &error), ==, -1);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+}
+
+static void
+test_read_http_budget (void)
+{
+  test_from_fiber (test_read_http_budget_fiber);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/JsonInputStream/read_http", test_read_http);
+  g_test_add_func ("/Foundry/JsonInputStream/read_http_filter", test_read_http_filter);
+  g_test_add_func ("/Foundry/JsonInputStream/read_http_budget", test_read_http_budget);
+
+  return g_test_run ();
+}
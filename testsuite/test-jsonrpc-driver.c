@@ -0,0 +1,286 @@
+/* test-jsonrpc-driver.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include <foundry.h>
+
+#include "libfoundry/jsonrpc/foundry-jsonrpc-driver-private.h"
+
+#include "test-util.h"
+
+typedef struct
+{
+  FoundryJsonrpcDriver *server;
+  FoundryJsonrpcDriver *client;
+  GPtrArray            *methods;
+  GPtrArray            *cancelled;
+  JsonNode             *slow_id;
+} Fixture;
+
+/* Two pipes give us a bidirectional transport without a socket */
+static void
+create_stream_pair (GIOStream **server_stream,
+                    GIOStream **client_stream)
+{
+  g_autoptr(GInputStream) server_input = NULL;
+  g_autoptr(GOutputStream) server_output = NULL;
+  g_autoptr(GInputStream) client_input = NULL;
+  g_autoptr(GOutputStream) client_output = NULL;
+  int to_server[2];
+  int to_client[2];
+
+  g_assert_true (g_unix_open_pipe (to_server, FD_CLOEXEC, NULL));
+  g_assert_true (g_unix_open_pipe (to_client, FD_CLOEXEC, NULL));
+
+  server_input = g_unix_input_stream_new (to_server[0], TRUE);
+  client_output = g_unix_output_stream_new (to_server[1], TRUE);
+  client_input = g_unix_input_stream_new (to_client[0], TRUE);
+  server_output = g_unix_output_stream_new (to_client[1], TRUE);
+
+  *server_stream = g_simple_io_stream_new (server_input, server_output);
+  *client_stream = g_simple_io_stream_new (client_input, client_output);
+}
+
+static gboolean
+server_handle_method_call (FoundryJsonrpcDriver *server,
+                           const char           *method,
+                           JsonNode             *params,
+                           JsonNode             *id,
+                           Fixture              *fixture)
+{
+  g_ptr_array_add (fixture->methods, g_strdup (method));
+
+  /* "slow" is never answered until the test decides to */
+  if (g_strcmp0 (method, "slow") == 0)
+    {
+      g_clear_pointer (&fixture->slow_id, json_node_unref);
+      fixture->slow_id = json_node_ref (id);
+      return TRUE;
+    }
+
+  dex_future_disown (foundry_jsonrpc_driver_reply (server, id, NULL));
+
+  return TRUE;
+}
+
+static void
+server_handle_notification (FoundryJsonrpcDriver *server,
+                            const char           *method,
+                            JsonNode             *params,
+                            Fixture              *fixture)
+{
+  gint64 id = 0;
+
+  if (g_strcmp0 (method, "$/cancelRequest") == 0 &&
+      FOUNDRY_JSON_OBJECT_PARSE (params, "id", FOUNDRY_JSON_NODE_GET_INT (&id)))
+    g_ptr_array_add (fixture->cancelled, g_strdup_printf ("%"G_GINT64_FORMAT, id));
+}
+
+static void
+fixture_init (Fixture *fixture)
+{
+  g_autoptr(GIOStream) server_stream = NULL;
+  g_autoptr(GIOStream) client_stream = NULL;
+
+  create_stream_pair (&server_stream, &client_stream);
+
+  fixture->methods = g_ptr_array_new_with_free_func (g_free);
+  fixture->cancelled = g_ptr_array_new_with_free_func (g_free);
+
+  fixture->server = foundry_jsonrpc_driver_new (server_stream, FOUNDRY_JSONRPC_STYLE_LF);
+  g_signal_connect (fixture->server,
+                    "handle-method-call",
+                    G_CALLBACK (server_handle_method_call),
+                    fixture);
+  g_signal_connect (fixture->server,
+                    "handle-notification",
+                    G_CALLBACK (server_handle_notification),
+                    fixture);
+  foundry_jsonrpc_driver_start (fixture->server);
+
+  fixture->client = foundry_jsonrpc_driver_new (client_stream, FOUNDRY_JSONRPC_STYLE_LF);
+  foundry_jsonrpc_driver_set_cancel_method (fixture->client, "$/cancelRequest");
+  foundry_jsonrpc_driver_start (fixture->client);
+}
+
+static void
+fixture_clear (Fixture *fixture)
+{
+  foundry_jsonrpc_driver_stop (fixture->client);
+  foundry_jsonrpc_driver_stop (fixture->server);
+
+  g_clear_object (&fixture->client);
+  g_clear_object (&fixture->server);
+  g_clear_pointer (&fixture->methods, g_ptr_array_unref);
+  g_clear_pointer (&fixture->cancelled, g_ptr_array_unref);
+  g_clear_pointer (&fixture->slow_id, json_node_unref);
+}
+
+/* Replies are delivered in order, so once "ping" has been answered the
+ * server has handled everything the client wrote before it.
+ */
+static void
+ping (Fixture *fixture)
+{
+  g_autoptr(GError) error = NULL;
+
+  dex_await (foundry_jsonrpc_driver_call (fixture->client, "ping", NULL), &error);
+  g_assert_no_error (error);
+}
+
+static DexFuture *
+return_completed (DexFuture *completed,
+                  gpointer   user_data)
+{
+  return dex_ref (completed);
+}
+
+static void
+test_cancel_queued_fiber (void)
+{
+  g_autoptr(DexFuture) future = NULL;
+  g_autoptr(JsonNode) id = NULL;
+  g_autoptr(GError) error = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  /* Cancel before the worker fiber gets a chance to run so the request
+   * is still sitting in the output channel.
+   */
+  future = foundry_jsonrpc_driver_call_full (fixture.client, "slow", NULL, &id);
+  g_assert_nonnull (id);
+  foundry_jsonrpc_driver_cancel (fixture.client, id);
+
+  g_assert_false (dex_await (dex_ref (future), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+  ping (&fixture);
+
+  /* Neither the request nor a $/cancelRequest for it reached the peer */
+  g_assert_cmpuint (fixture.methods->len, ==, 1);
+  g_assert_cmpstr (g_ptr_array_index (fixture.methods, 0), ==, "ping");
+  g_assert_cmpuint (fixture.cancelled->len, ==, 0);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_cancel_sent_fiber (void)
+{
+  g_autoptr(DexFuture) future = NULL;
+  g_autoptr(JsonNode) id = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *id_str = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  future = foundry_jsonrpc_driver_call_full (fixture.client, "slow", NULL, &id);
+  id_str = g_strdup_printf ("%"G_GINT64_FORMAT, json_node_get_int (id));
+
+  ping (&fixture);
+  g_assert_nonnull (fixture.slow_id);
+
+  foundry_jsonrpc_driver_cancel (fixture.client, id);
+
+  g_assert_false (dex_await (dex_ref (future), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+
+  ping (&fixture);
+
+  g_assert_cmpuint (fixture.cancelled->len, ==, 1);
+  g_assert_cmpstr (g_ptr_array_index (fixture.cancelled, 0), ==, id_str);
+
+  /* A late reply to the cancelled request is dropped by the client */
+  dex_future_disown (foundry_jsonrpc_driver_reply (fixture.server, fixture.slow_id, NULL));
+  ping (&fixture);
+
+  /* Cancelling again is a no-op */
+  foundry_jsonrpc_driver_cancel (fixture.client, id);
+  ping (&fixture);
+  g_assert_cmpuint (fixture.cancelled->len, ==, 1);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_discard_fiber (void)
+{
+  DexFuture *future;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  future = dex_future_finally (foundry_jsonrpc_driver_call (fixture.client, "slow", NULL),
+                               return_completed,
+                               NULL, NULL);
+
+  ping (&fixture);
+  g_assert_nonnull (fixture.slow_id);
+  g_assert_cmpuint (fixture.cancelled->len, ==, 0);
+
+  /* Dropping the only consumer of the reply cancels the request */
+  dex_unref (future);
+
+  /* The cancellation is applied from the driver's scheduler so it is
+   * only guaranteed to be on the wire ahead of the second round-trip.
+   */
+  ping (&fixture);
+  ping (&fixture);
+  g_assert_cmpuint (fixture.cancelled->len, ==, 1);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_cancel_queued (void)
+{
+  test_from_fiber (test_cancel_queued_fiber);
+}
+
+static void
+test_cancel_sent (void)
+{
+  test_from_fiber (test_cancel_sent_fiber);
+}
+
+static void
+test_discard (void)
+{
+  test_from_fiber (test_discard_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/JsonrpcDriver/cancel-queued", test_cancel_queued);
+  g_test_add_func ("/Foundry/JsonrpcDriver/cancel-sent", test_cancel_sent);
+  g_test_add_func ("/Foundry/JsonrpcDriver/discard", test_discard);
+  return g_test_run ();
+}
@@ -0,0 +1,356 @@
+/* test-llm-response-cache.c
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <libsoup/soup.h>
+
+#include <foundry.h>
+
+#include "libfoundry/llm/foundry-llm-manager-private.h"
+#include "plugins/ollama/plugin-ollama-client.h"
+
+#include "test-util.h"
+
+#define CHAT_RESPONSE \
+  "{\"message\":{\"role\":\"assistant\",\"content\":\"Hel\"},\"done\":false}\n" \
+  "{\"message\":{\"role\":\"assistant\",\"content\":\"lo\"},\"done\":true}\n"
+
+typedef struct
+{
+  SoupServer         *server;
+  SoupSession        *session;
+  FoundryContext     *context;
+  PluginOllamaClient *client;
+  char               *tmpdir;
+  guint               n_requests;
+} Fixture;
+
+/* A tiny stand-in for the Ollama chat endpoint */
+static void
+chat_handler (SoupServer        *server,
+              SoupServerMessage *message,
+              const char        *path,
+              GHashTable        *query,
+              gpointer           user_data)
+{
+  Fixture *fixture = user_data;
+  SoupMessageBody *body = soup_server_message_get_request_body (message);
+
+  fixture->n_requests++;
+
+  if (body->data != NULL && g_strstr_len (body->data, body->length, "\"broken\"") != NULL)
+    {
+      soup_server_message_set_status (message, SOUP_STATUS_INTERNAL_SERVER_ERROR, NULL);
+      return;
+    }
+
+  soup_server_message_set_status (message, SOUP_STATUS_OK, NULL);
+  soup_server_message_set_response (message,
+                                    "application/x-ndjson",
+                                    SOUP_MEMORY_STATIC,
+                                    CHAT_RESPONSE,
+                                    strlen (CHAT_RESPONSE));
+}
+
+static FoundryLlmResponseCache *
+fixture_set_cache (Fixture                     *fixture,
+                   FoundryLlmResponseCacheMode  mode,
+                   guint64                      max_size)
+{
+  g_autoptr(FoundryLlmManager) llm_manager = foundry_context_dup_llm_manager (fixture->context);
+  g_autoptr(GFile) directory = g_file_new_for_path (fixture->tmpdir);
+  FoundryLlmResponseCache *cache = foundry_llm_response_cache_new (directory, mode, max_size);
+
+  _foundry_llm_manager_set_response_cache (llm_manager, cache);
+
+  return cache;
+}
+
+static void
+fixture_init (Fixture *fixture)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *url_base = NULL;
+  GSList *uris;
+
+  fixture->context = dex_await_object (foundry_context_new_for_user (NULL), &error);
+  g_assert_no_error (error);
+
+  fixture->tmpdir = g_dir_make_tmp ("test-llm-response-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  fixture->server = soup_server_new (NULL, NULL);
+  soup_server_add_handler (fixture->server, "/api/chat", chat_handler, fixture, NULL);
+  soup_server_listen_local (fixture->server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error);
+  g_assert_no_error (error);
+
+  uris = soup_server_get_uris (fixture->server);
+  g_assert_nonnull (uris);
+  url_base = g_uri_to_string (uris->data);
+  g_slist_free_full (uris, (GDestroyNotify) g_uri_unref);
+
+  fixture->session = soup_session_new ();
+  fixture->client = plugin_ollama_client_new (fixture->context, fixture->session, url_base, NULL, FALSE);
+}
+
+static void
+fixture_clear (Fixture *fixture)
+{
+  rm_rf (fixture->tmpdir);
+
+  soup_server_disconnect (fixture->server);
+
+  g_clear_object (&fixture->client);
+  g_clear_object (&fixture->session);
+  g_clear_object (&fixture->server);
+  g_clear_object (&fixture->context);
+  g_clear_pointer (&fixture->tmpdir, g_free);
+}
+
+static char *
+post (Fixture     *fixture,
+      JsonNode    *body,
+      GError     **error)
+{
+  g_autoptr(GInputStream) stream = NULL;
+  g_autoptr(GByteArray) buffer = g_byte_array_new ();
+
+  if (!(stream = dex_await_object (plugin_ollama_client_post (fixture->client, "/api/chat", body), error)))
+    return NULL;
+
+  for (;;)
+    {
+      g_autoptr(GBytes) bytes = NULL;
+
+      if (!(bytes = dex_await_boxed (dex_input_stream_read_bytes (stream, 4096, G_PRIORITY_DEFAULT), error)))
+        return NULL;
+
+      if (g_bytes_get_size (bytes) == 0)
+        break;
+
+      g_byte_array_append (buffer, g_bytes_get_data (bytes, NULL), g_bytes_get_size (bytes));
+    }
+
+  g_byte_array_append (buffer, (const guint8 *)"", 1);
+
+  return (char *)g_byte_array_free (g_steal_pointer (&buffer), FALSE);
+}
+
+static void
+test_key (void)
+{
+  g_autoptr(JsonNode) a = FOUNDRY_JSON_OBJECT_NEW ("model", FOUNDRY_JSON_NODE_PUT_STRING ("m"),
+                                                   "options", "{",
+                                                     "seed", FOUNDRY_JSON_NODE_PUT_INT (1),
+                                                     "temperature", FOUNDRY_JSON_NODE_PUT_INT (0),
+                                                   "}");
+  g_autoptr(JsonNode) b = FOUNDRY_JSON_OBJECT_NEW ("options", "{",
+                                                     "temperature", FOUNDRY_JSON_NODE_PUT_INT (0),
+                                                     "seed", FOUNDRY_JSON_NODE_PUT_INT (1),
+                                                   "}",
+                                                   "model", FOUNDRY_JSON_NODE_PUT_STRING ("m"));
+  g_autoptr(JsonNode) c = FOUNDRY_JSON_OBJECT_NEW ("model", FOUNDRY_JSON_NODE_PUT_STRING ("n"));
+  g_autofree char *key_a = foundry_llm_response_cache_dup_key ("http://localhost/api/chat", a);
+  g_autofree char *key_b = foundry_llm_response_cache_dup_key ("http://localhost/api/chat", b);
+  g_autofree char *key_c = foundry_llm_response_cache_dup_key ("http://localhost/api/chat", c);
+  g_autofree char *key_d = foundry_llm_response_cache_dup_key ("http://localhost/v1/chat", a);
+
+  g_assert_cmpuint (strlen (key_a), ==, 64);
+  g_assert_cmpstr (key_a, ==, key_b);
+  g_assert_cmpstr (key_a, !=, key_c);
+  g_assert_cmpstr (key_a, !=, key_d);
+}
+
+static void
+test_record_and_replay_fiber (void)
+{
+  g_autoptr(FoundryLlmResponseCache) cache = NULL;
+  g_autoptr(JsonNode) request = NULL;
+  g_autoptr(JsonNode) reordered = NULL;
+  g_autoptr(JsonNode) other = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *first = NULL;
+  g_autofree char *second = NULL;
+  g_autofree char *third = NULL;
+  g_autofree char *offline = NULL;
+  g_autofree char *missing = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+  cache = fixture_set_cache (&fixture, FOUNDRY_LLM_RESPONSE_CACHE_ENABLED, 1024 * 1024);
+
+  request = FOUNDRY_JSON_OBJECT_NEW ("model", FOUNDRY_JSON_NODE_PUT_STRING ("test"),
+                                     "stream", FOUNDRY_JSON_NODE_PUT_BOOLEAN (TRUE),
+                                     "messages", "[", "{",
+                                       "role", FOUNDRY_JSON_NODE_PUT_STRING ("user"),
+                                       "content", FOUNDRY_JSON_NODE_PUT_STRING ("Hi"),
+                                     "}", "]");
+  reordered = FOUNDRY_JSON_OBJECT_NEW ("messages", "[", "{",
+                                         "content", FOUNDRY_JSON_NODE_PUT_STRING ("Hi"),
+                                         "role", FOUNDRY_JSON_NODE_PUT_STRING ("user"),
+                                       "}", "]",
+                                       "stream", FOUNDRY_JSON_NODE_PUT_BOOLEAN (TRUE),
+                                       "model", FOUNDRY_JSON_NODE_PUT_STRING ("test"));
+  other = FOUNDRY_JSON_OBJECT_NEW ("model", FOUNDRY_JSON_NODE_PUT_STRING ("other"));
+
+  first = post (&fixture, request, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (first, ==, CHAT_RESPONSE);
+  g_assert_cmpint (fixture.n_requests, ==, 1);
+  g_assert_cmpuint (foundry_llm_response_cache_get_size (cache), ==, strlen (CHAT_RESPONSE));
+
+  second = post (&fixture, request, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (second, ==, CHAT_RESPONSE);
+  g_assert_cmpint (fixture.n_requests, ==, 1);
+
+  third = post (&fixture, reordered, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (third, ==, CHAT_RESPONSE);
+  g_assert_cmpint (fixture.n_requests, ==, 1);
+
+  /* Replay mode serves from disk and never touches the network */
+  g_clear_object (&cache);
+  cache = fixture_set_cache (&fixture, FOUNDRY_LLM_RESPONSE_CACHE_REPLAY, 1024 * 1024);
+
+  offline = post (&fixture, request, &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (offline, ==, CHAT_RESPONSE);
+
+  missing = post (&fixture, other, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert_null (missing);
+  g_assert_cmpint (fixture.n_requests, ==, 1);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_record_and_replay (void)
+{
+  test_from_fiber (test_record_and_replay_fiber);
+}
+
+static void
+test_errors_not_cached_fiber (void)
+{
+  g_autoptr(FoundryLlmResponseCache) cache = NULL;
+  g_autoptr(JsonNode) request = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+  cache = fixture_set_cache (&fixture, FOUNDRY_LLM_RESPONSE_CACHE_ENABLED, 1024 * 1024);
+
+  request = FOUNDRY_JSON_OBJECT_NEW ("model", FOUNDRY_JSON_NODE_PUT_STRING ("broken"));
+
+  for (guint i = 0; i < 2; i++)
+    {
+      g_autoptr(GError) error = NULL;
+      g_autofree char *body = post (&fixture, request, &error);
+
+      g_assert_no_error (error);
+      g_assert_nonnull (body);
+    }
+
+  g_assert_cmpint (fixture.n_requests, ==, 2);
+  g_assert_cmpuint (foundry_llm_response_cache_get_size (cache), ==, 0);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_errors_not_cached (void)
+{
+  test_from_fiber (test_errors_not_cached_fiber);
+}
+
+static void
+test_eviction_fiber (void)
+{
+  g_autoptr(FoundryLlmResponseCache) cache = NULL;
+  g_autoptr(GPtrArray) keys = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr(GBytes) payload = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GInputStream) stream = NULL;
+  g_autofree char *data = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+  cache = fixture_set_cache (&fixture, FOUNDRY_LLM_RESPONSE_CACHE_ENABLED, 4096);
+
+  data = g_strnfill (1000, 'x');
+  payload = g_bytes_new (data, 1000);
+
+  for (guint i = 0; i < 6; i++)
+    {
+      g_autoptr(JsonNode) request = FOUNDRY_JSON_OBJECT_NEW ("n", FOUNDRY_JSON_NODE_PUT_INT (i));
+      char *key = foundry_llm_response_cache_dup_key ("http://localhost/", request);
+
+      dex_await (foundry_llm_response_cache_store (cache, key, payload), &error);
+      g_assert_no_error (error);
+
+      g_ptr_array_add (keys, key);
+
+      /* Keep the first entry hot so it survives eviction */
+      if (i > 0)
+        {
+          g_clear_object (&stream);
+          stream = dex_await_object (foundry_llm_response_cache_lookup (cache, g_ptr_array_index (keys, 0)), &error);
+          g_assert_no_error (error);
+        }
+    }
+
+  g_assert_cmpuint (foundry_llm_response_cache_get_size (cache), <=, 4096);
+
+  g_clear_object (&stream);
+  stream = dex_await_object (foundry_llm_response_cache_lookup (cache, g_ptr_array_index (keys, 1)), &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_clear_error (&error);
+
+  g_clear_object (&stream);
+  stream = dex_await_object (foundry_llm_response_cache_lookup (cache, g_ptr_array_index (keys, 0)), &error);
+  g_assert_no_error (error);
+
+  g_clear_object (&stream);
+  stream = dex_await_object (foundry_llm_response_cache_lookup (cache, g_ptr_array_index (keys, 5)), &error);
+  g_assert_no_error (error);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_eviction (void)
+{
+  test_from_fiber (test_eviction_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/LlmResponseCache/key", test_key);
+  g_test_add_func ("/Foundry/LlmResponseCache/record-and-replay", test_record_and_replay);
+  g_test_add_func ("/Foundry/LlmResponseCache/errors-not-cached", test_errors_not_cached);
+  g_test_add_func ("/Foundry/LlmResponseCache/eviction", test_eviction);
+  return g_test_run ();
+}
@@ -0,0 +1,206 @@
+/* test-llm-subprocess-tool.c
+ *
+ * Copyright 2026 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <signal.h>
+
+#include <glib/gstdio.h>
+
+#include <foundry.h>
+
+#include "plugins/fallbacks/llm-build/plugin-llm-subprocess-message.h"
+#include "plugins/fallbacks/llm-build/plugin-llm-subprocess-tool.h"
+
+#include "test-util.h"
+
+static FoundryLlmTool *
+create_tool (FoundryContext *context,
+             const char     *script,
+             gsize           head_size,
+             gsize           tail_size)
+{
+  const char *argv[] = { "/bin/sh", "-c", script, NULL };
+  FoundryLlmTool *tool;
+
+  tool = plugin_llm_subprocess_tool_new (context, "test", argv, "A test tool");
+  plugin_llm_subprocess_tool_set_output_limits (PLUGIN_LLM_SUBPROCESS_TOOL (tool), head_size, tail_size);
+
+  return tool;
+}
+
+static void
+test_message_caps (void)
+{
+  g_autoptr(FoundryLlmMessage) message = plugin_llm_subprocess_message_new (4, 4);
+  PluginLlmSubprocessMessage *self = PLUGIN_LLM_SUBPROCESS_MESSAGE (message);
+  g_autofree char *content = NULL;
+
+  plugin_llm_subprocess_message_append (self, (const guint8 *)"abc", 3);
+  content = foundry_llm_message_dup_content (message);
+  g_assert_cmpstr (content, ==, "abc");
+  g_clear_pointer (&content, g_free);
+
+  plugin_llm_subprocess_message_append (self, (const guint8 *)"defgh", 5);
+  content = foundry_llm_message_dup_content (message);
+  g_assert_cmpstr (content, ==, "abcdefgh");
+  g_assert_cmpuint (plugin_llm_subprocess_message_get_n_elided (self), ==, 0);
+  g_clear_pointer (&content, g_free);
+
+  for (guint i = 0; i < 100; i++)
+    plugin_llm_subprocess_message_append (self, (const guint8 *)"0123456789", 10);
+
+  content = foundry_llm_message_dup_content (message);
+  g_assert_true (g_str_has_prefix (content, "abcd\n"));
+  g_assert_true (g_str_has_suffix (content, "\n6789"));
+  g_assert_nonnull (strstr (content, " 1000 bytes "));
+  g_assert_cmpuint (plugin_llm_subprocess_message_get_n_bytes (self), ==, 1008);
+  g_assert_cmpuint (plugin_llm_subprocess_message_get_n_elided (self), ==, 1000);
+}
+
+static void
+test_large_output_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryLlmMessage) message = NULL;
+  g_autoptr(FoundryLlmTool) tool = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *content = NULL;
+
+  context = dex_await_object (foundry_context_new_for_user (NULL), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (context);
+
+  /* Roughly 1.3MB of output, most of which must never be held in memory */
+  tool = create_tool (context,
+                      "i=0; while [ $i -lt 100000 ]; do echo \"line $i\"; i=$((i+1)); done; exit 1",
+                      1024, 1024);
+
+  message = dex_await_object (foundry_llm_tool_call (tool, NULL, 0), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (message);
+
+  content = foundry_llm_message_dup_content (message);
+  g_assert_true (g_str_has_prefix (content, "line 0\nline 1\n"));
+  g_assert_true (g_str_has_suffix (content, "line 99998\nline 99999\n"));
+  g_assert_nonnull (strstr (content, "bytes of output elided"));
+  g_assert_cmpuint (strlen (content), <, 2048 + 64);
+  g_assert_cmpuint (plugin_llm_subprocess_message_get_n_bytes (PLUGIN_LLM_SUBPROCESS_MESSAGE (message)), >, 1000000);
+}
+
+static void
+test_large_output (void)
+{
+  test_from_fiber (test_large_output_fiber);
+}
+
+static void
+test_small_output_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryLlmMessage) message = NULL;
+  g_autoptr(FoundryLlmTool) tool = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *content = NULL;
+  g_autofree char *role = NULL;
+
+  context = dex_await_object (foundry_context_new_for_user (NULL), &error);
+  g_assert_no_error (error);
+
+  tool = create_tool (context, "for i in 1 2 3; do echo $i; done", 1024, 1024);
+
+  message = dex_await_object (foundry_llm_tool_call (tool, NULL, 0), &error);
+  g_assert_no_error (error);
+
+  role = foundry_llm_message_dup_role (message);
+  content = foundry_llm_message_dup_content (message);
+  g_assert_cmpstr (role, ==, "tool");
+  g_assert_cmpstr (content, ==, "1\n2\n3\n");
+}
+
+static void
+test_small_output (void)
+{
+  test_from_fiber (test_small_output_fiber);
+}
+
+static void
+test_cancel_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryLlmTool) tool = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *script = NULL;
+  g_autofree char *pidfile = NULL;
+  g_autofree char *contents = NULL;
+  g_autofree char *tmpdir = NULL;
+  GPid pid;
+
+  context = dex_await_object (foundry_context_new_for_user (NULL), &error);
+  g_assert_no_error (error);
+
+  tmpdir = g_dir_make_tmp ("test-llm-subprocess-tool-XXXXXX", &error);
+  g_assert_no_error (error);
+
+  pidfile = g_build_filename (tmpdir, "pid", NULL);
+  script = g_strdup_printf ("echo $$ > '%s'; while :; do echo y; done", pidfile);
+  tool = create_tool (context, script, 1024, 1024);
+
+  /* Discarding the call must stop the endless producer */
+  dex_await (dex_future_first (foundry_llm_tool_call (tool, NULL, 0),
+                               dex_timeout_new_msec (250),
+                               NULL),
+             &error);
+  g_assert_error (error, DEX_ERROR, DEX_ERROR_TIMED_OUT);
+
+  g_file_get_contents (pidfile, &contents, NULL, &error);
+  g_assert_no_error (error);
+  pid = g_ascii_strtoll (contents, NULL, 10);
+  g_assert_cmpint (pid, >, 0);
+
+  for (guint i = 0; i < 100 && kill (pid, 0) == 0; i++)
+    dex_await (dex_timeout_new_msec (20), NULL);
+
+  g_assert_cmpint (kill (pid, 0), ==, -1);
+  g_assert_cmpint (errno, ==, ESRCH);
+
+  g_unlink (pidfile);
+  g_rmdir (tmpdir);
+}
+
+static void
+test_cancel (void)
+{
+  test_from_fiber (test_cancel_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Plugins/LlmSubprocessTool/message-caps", test_message_caps);
+  g_test_add_func ("/Plugins/LlmSubprocessTool/large-output", test_large_output);
+  g_test_add_func ("/Plugins/LlmSubprocessTool/small-output", test_small_output);
+  g_test_add_func ("/Plugins/LlmSubprocessTool/cancel", test_cancel);
+  return g_test_run ();
+}
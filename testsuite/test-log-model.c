@@ -0,0 +1,262 @@
+/* test-log-model.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/logging/foundry-log-model-private.h"
+
+typedef struct
+{
+  guint position;
+  guint removed;
+  guint added;
+} Change;
+
+static void
+items_changed_cb (GListModel *model,
+                  guint       position,
+                  guint       removed,
+                  guint       added,
+                  GArray     *changes)
+{
+  Change change = { position, removed, added };
+
+  g_array_append_val (changes, change);
+}
+
+static void
+assert_change (GArray *changes,
+               guint   index,
+               guint   position,
+               guint   removed,
+               guint   added)
+{
+  const Change *change;
+
+  g_assert_cmpuint (index, <, changes->len);
+
+  change = &g_array_index (changes, Change, index);
+
+  g_assert_cmpuint (change->position, ==, position);
+  g_assert_cmpuint (change->removed, ==, removed);
+  g_assert_cmpuint (change->added, ==, added);
+}
+
+static void
+assert_message (FoundryLogModel *model,
+                guint            position,
+                const char      *expected)
+{
+  g_autoptr(FoundryLogMessage) message = g_list_model_get_item (G_LIST_MODEL (model), position);
+  g_autofree char *text = NULL;
+
+  g_assert_nonnull (message);
+
+  text = foundry_log_message_dup_message (message);
+  g_assert_cmpstr (text, ==, expected);
+}
+
+static void
+append (FoundryLogModel *model,
+        guint            n)
+{
+  _foundry_log_model_append (model, "Test", G_LOG_LEVEL_MESSAGE, g_strdup_printf ("m%u", n));
+}
+
+static gpointer
+append_thread (gpointer data)
+{
+  FoundryLogModel *model = data;
+
+  for (guint i = 0; i < 5; i++)
+    append (model, i);
+
+  return NULL;
+}
+
+static void
+flush_from_thread (FoundryLogModel *model,
+                   guint            expected)
+{
+  g_autoptr(GThread) thread = g_thread_new ("append", append_thread, model);
+
+  g_thread_join (g_steal_pointer (&thread));
+
+  while (g_list_model_get_n_items (G_LIST_MODEL (model)) != expected)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+static void
+test_main_thread (void)
+{
+  g_autoptr(FoundryLogModel) model = _foundry_log_model_new ();
+  g_autoptr(GArray) changes = g_array_new (FALSE, FALSE, sizeof (Change));
+
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), changes);
+
+  /* Appends from the main thread are visible immediately */
+  append (model, 0);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 1);
+  g_assert_cmpuint (changes->len, ==, 1);
+  assert_change (changes, 0, 0, 0, 1);
+
+  append (model, 1);
+  g_assert_cmpuint (changes->len, ==, 2);
+  assert_change (changes, 1, 1, 0, 1);
+
+  assert_message (model, 0, "m0");
+  assert_message (model, 1, "m1");
+}
+
+static void
+test_eviction (void)
+{
+  g_autoptr(FoundryLogModel) model = _foundry_log_model_new ();
+  g_autoptr(GArray) changes = g_array_new (FALSE, FALSE, sizeof (Change));
+
+  _foundry_log_model_set_max_items (model, 3);
+
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), changes);
+
+  for (guint i = 0; i < 5; i++)
+    append (model, i);
+
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 3);
+  assert_message (model, 0, "m2");
+  assert_message (model, 1, "m3");
+  assert_message (model, 2, "m4");
+
+  /* Each eviction removes from the head before appending */
+  g_assert_cmpuint (changes->len, ==, 7);
+  assert_change (changes, 2, 2, 0, 1);
+  assert_change (changes, 3, 0, 1, 0);
+  assert_change (changes, 4, 2, 0, 1);
+  assert_change (changes, 5, 0, 1, 0);
+  assert_change (changes, 6, 2, 0, 1);
+
+  /* Shrinking evicts the oldest records */
+  g_array_set_size (changes, 0);
+  _foundry_log_model_set_max_items (model, 1);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (model)), ==, 1);
+  g_assert_cmpuint (changes->len, ==, 1);
+  assert_change (changes, 0, 0, 2, 0);
+  assert_message (model, 0, "m4");
+}
+
+static void
+test_batch (void)
+{
+  g_autoptr(FoundryLogModel) model = _foundry_log_model_new ();
+  g_autoptr(GArray) changes = g_array_new (FALSE, FALSE, sizeof (Change));
+
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), changes);
+
+  /* Appends from other threads are delivered as one batch */
+  flush_from_thread (model, 5);
+  g_assert_cmpuint (changes->len, ==, 1);
+  assert_change (changes, 0, 0, 0, 5);
+
+  for (guint i = 0; i < 5; i++)
+    {
+      g_autofree char *expected = g_strdup_printf ("m%u", i);
+      assert_message (model, i, expected);
+    }
+}
+
+static void
+test_batch_eviction (void)
+{
+  g_autoptr(FoundryLogModel) model = _foundry_log_model_new ();
+  g_autoptr(GArray) changes = g_array_new (FALSE, FALSE, sizeof (Change));
+
+  _foundry_log_model_set_max_items (model, 4);
+  append (model, 100);
+  append (model, 101);
+
+  g_signal_connect (model, "items-changed", G_CALLBACK (items_changed_cb), changes);
+
+  /* Records added and evicted within a batch are never reported */
+  flush_from_thread (model, 4);
+  g_assert_cmpuint (changes->len, ==, 2);
+  assert_change (changes, 0, 0, 2, 0);
+  assert_change (changes, 1, 0, 0, 4);
+
+  assert_message (model, 0, "m1");
+  assert_message (model, 3, "m4");
+}
+
+static void
+test_identity (void)
+{
+  g_autoptr(FoundryLogModel) model = _foundry_log_model_new ();
+  g_autoptr(FoundryLogMessage) first = NULL;
+  g_autoptr(FoundryLogMessage) again = NULL;
+  g_autoptr(FoundryLogMessage) next = NULL;
+
+  _foundry_log_model_set_max_items (model, 2);
+
+  append (model, 0);
+  append (model, 1);
+
+  first = g_list_model_get_item (G_LIST_MODEL (model), 0);
+  again = g_list_model_get_item (G_LIST_MODEL (model), 0);
+  g_assert_true (first == again);
+  g_clear_object (&again);
+
+  /* Growing the ring must not lose track of the item */
+  _foundry_log_model_set_max_items (model, 1000);
+  for (guint i = 2; i < 600; i++)
+    append (model, i);
+
+  again = g_list_model_get_item (G_LIST_MODEL (model), 0);
+  g_assert_true (first == again);
+  g_clear_object (&again);
+
+  /* Once evicted, the position refers to a different record */
+  _foundry_log_model_set_max_items (model, 10);
+  next = g_list_model_get_item (G_LIST_MODEL (model), 0);
+  g_assert_true (first != next);
+  g_clear_object (&next);
+
+  /* Items nobody holds are recreated on demand */
+  g_clear_object (&first);
+  next = g_list_model_get_item (G_LIST_MODEL (model), 9);
+  g_assert_nonnull (next);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  /* Records the main thread so appends from here are synchronous */
+  dex_future_disown (foundry_init ());
+
+  g_test_add_func ("/Foundry/LogModel/main-thread", test_main_thread);
+  g_test_add_func ("/Foundry/LogModel/eviction", test_eviction);
+  g_test_add_func ("/Foundry/LogModel/batch", test_batch);
+  g_test_add_func ("/Foundry/LogModel/batch-eviction", test_batch_eviction);
+  g_test_add_func ("/Foundry/LogModel/identity", test_identity);
+  return g_test_run ();
+}
@@ -0,0 +1,401 @@
+/* test-lsp-client.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include <foundry.h>
+
+#include "libfoundry/jsonrpc/foundry-jsonrpc-driver-private.h"
+#include "libfoundry/lsp/foundry-lsp-client-private.h"
+#include "libfoundry/lsp/foundry-lsp-completion-results-private.h"
+
+#include "test-util.h"
+
+typedef struct
+{
+  FoundryContext       *context;
+  GSubprocess          *subprocess;
+  FoundryJsonrpcDriver *server;
+  FoundryLspClient     *client;
+  GPtrArray            *pending;
+  guint                 n_hover;
+  guint                 n_cancelled;
+} Fixture;
+
+static void
+create_stream_pair (GIOStream **server_stream,
+                    GIOStream **client_stream)
+{
+  g_autoptr(GInputStream) server_input = NULL;
+  g_autoptr(GOutputStream) server_output = NULL;
+  g_autoptr(GInputStream) client_input = NULL;
+  g_autoptr(GOutputStream) client_output = NULL;
+  int to_server[2];
+  int to_client[2];
+
+  g_assert_true (g_unix_open_pipe (to_server, FD_CLOEXEC, NULL));
+  g_assert_true (g_unix_open_pipe (to_client, FD_CLOEXEC, NULL));
+
+  server_input = g_unix_input_stream_new (to_server[0], TRUE);
+  client_output = g_unix_output_stream_new (to_server[1], TRUE);
+  client_input = g_unix_input_stream_new (to_client[0], TRUE);
+  server_output = g_unix_output_stream_new (to_client[1], TRUE);
+
+  *server_stream = g_simple_io_stream_new (server_input, server_output);
+  *client_stream = g_simple_io_stream_new (client_input, client_output);
+}
+
+static gboolean
+server_handle_method_call (FoundryJsonrpcDriver *server,
+                           const char           *method,
+                           JsonNode             *params,
+                           JsonNode             *id,
+                           Fixture              *fixture)
+{
+  if (g_strcmp0 (method, "initialize") == 0)
+    {
+      g_autoptr(JsonNode) reply = FOUNDRY_JSON_OBJECT_NEW ("capabilities", "{", "}");
+
+      dex_future_disown (foundry_jsonrpc_driver_reply (server, id, reply));
+      return TRUE;
+    }
+
+  /* Hover requests are held until the test replies to them */
+  if (g_strcmp0 (method, "textDocument/hover") == 0)
+    {
+      fixture->n_hover++;
+      g_ptr_array_add (fixture->pending, json_node_ref (id));
+      return TRUE;
+    }
+
+  if (g_strcmp0 (method, "test/ping") == 0)
+    {
+      dex_future_disown (foundry_jsonrpc_driver_reply (server, id, NULL));
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+server_handle_notification (FoundryJsonrpcDriver *server,
+                            const char           *method,
+                            JsonNode             *params,
+                            Fixture              *fixture)
+{
+  if (g_strcmp0 (method, "$/cancelRequest") == 0)
+    fixture->n_cancelled++;
+}
+
+static void
+fixture_init (Fixture *fixture)
+{
+  g_autoptr(GIOStream) server_stream = NULL;
+  g_autoptr(GIOStream) client_stream = NULL;
+  g_autoptr(GError) error = NULL;
+
+  fixture->context = dex_await_object (foundry_context_new_for_user (NULL), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (fixture->context);
+
+  /* The client bails out of calls when its subprocess exits, so give
+   * it something that stays alive for the duration of the test.
+   */
+  fixture->subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error, "sleep", "3600", NULL);
+  g_assert_no_error (error);
+
+  fixture->pending = g_ptr_array_new_with_free_func ((GDestroyNotify) json_node_unref);
+
+  create_stream_pair (&server_stream, &client_stream);
+
+  fixture->server = foundry_jsonrpc_driver_new (server_stream, FOUNDRY_JSONRPC_STYLE_HTTP);
+  g_signal_connect (fixture->server,
+                    "handle-method-call",
+                    G_CALLBACK (server_handle_method_call),
+                    fixture);
+  g_signal_connect (fixture->server,
+                    "handle-notification",
+                    G_CALLBACK (server_handle_notification),
+                    fixture);
+  foundry_jsonrpc_driver_start (fixture->server);
+
+  fixture->client = dex_await_object (foundry_lsp_client_new (fixture->context,
+                                                              client_stream,
+                                                              fixture->subprocess),
+                                      &error);
+  g_assert_no_error (error);
+  g_assert_true (FOUNDRY_IS_LSP_CLIENT (fixture->client));
+}
+
+static void
+fixture_clear (Fixture *fixture)
+{
+  foundry_jsonrpc_driver_stop (fixture->server);
+  g_subprocess_force_exit (fixture->subprocess);
+
+  g_clear_object (&fixture->client);
+  g_clear_object (&fixture->server);
+  g_clear_object (&fixture->subprocess);
+  g_clear_object (&fixture->context);
+  g_clear_pointer (&fixture->pending, g_ptr_array_unref);
+}
+
+/* Replies are delivered in order, so once this returns the server has
+ * handled everything the client wrote before it.
+ */
+static void
+ping (Fixture *fixture)
+{
+  g_autoptr(GError) error = NULL;
+
+  dex_await (foundry_lsp_client_call (fixture->client, "test/ping", NULL), &error);
+  g_assert_no_error (error);
+}
+
+static JsonNode *
+hover_params (const char *uri)
+{
+  return FOUNDRY_JSON_OBJECT_NEW ("textDocument", "{",
+                                    "uri", FOUNDRY_JSON_NODE_PUT_STRING (uri),
+                                  "}",
+                                  "position", "{",
+                                    "line", FOUNDRY_JSON_NODE_PUT_INT (0),
+                                    "character", FOUNDRY_JSON_NODE_PUT_INT (0),
+                                  "}");
+}
+
+static void
+test_supersede_fiber (void)
+{
+  g_autoptr(JsonNode) params = hover_params ("file:///tmp/a.c");
+  g_autoptr(JsonNode) other_params = hover_params ("file:///tmp/b.c");
+  g_autoptr(DexFuture) first = NULL;
+  g_autoptr(DexFuture) second = NULL;
+  g_autoptr(DexFuture) third = NULL;
+  g_autoptr(DexFuture) other = NULL;
+  g_autoptr(GError) error = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  /* Superseded while still queued: the peer never sees the request
+   * nor a $/cancelRequest for it.
+   */
+  first = foundry_lsp_client_call (fixture.client, "textDocument/hover", params);
+  second = foundry_lsp_client_call (fixture.client, "textDocument/hover", params);
+
+  g_assert_false (dex_await (dex_ref (first), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&error);
+
+  ping (&fixture);
+  g_assert_cmpuint (fixture.n_hover, ==, 1);
+  g_assert_cmpuint (fixture.n_cancelled, ==, 0);
+  g_assert_cmpuint (_foundry_lsp_client_get_n_superseding (fixture.client), ==, 1);
+
+  /* A request for another document does not supersede anything */
+  other = foundry_lsp_client_call (fixture.client, "textDocument/hover", other_params);
+  ping (&fixture);
+  g_assert_cmpuint (fixture.n_hover, ==, 2);
+  g_assert_cmpuint (_foundry_lsp_client_get_n_superseding (fixture.client), ==, 2);
+
+  /* Superseded after it was written: the peer is told to stop */
+  third = foundry_lsp_client_call (fixture.client, "textDocument/hover", params);
+
+  g_assert_false (dex_await (dex_ref (second), &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&error);
+
+  ping (&fixture);
+  g_assert_cmpuint (fixture.n_hover, ==, 3);
+  g_assert_cmpuint (fixture.n_cancelled, ==, 1);
+  g_assert_cmpuint (fixture.pending->len, ==, 3);
+
+  /* Completed requests are pruned from the supersede table */
+  dex_future_disown (foundry_jsonrpc_driver_reply (fixture.server, g_ptr_array_index (fixture.pending, 1), NULL));
+  dex_future_disown (foundry_jsonrpc_driver_reply (fixture.server, g_ptr_array_index (fixture.pending, 2), NULL));
+
+  g_assert_true (dex_await (dex_ref (other), &error));
+  g_assert_no_error (error);
+  g_assert_true (dex_await (dex_ref (third), &error));
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (_foundry_lsp_client_get_n_superseding (fixture.client), ==, 0);
+
+  fixture_clear (&fixture);
+}
+
+static FoundryLspCompletionResults *
+create_results (Fixture    *fixture,
+                JsonNode   *items,
+                const char *typed_text)
+{
+  g_autoptr(JsonNode) reply = FOUNDRY_JSON_OBJECT_NEW ("items", FOUNDRY_JSON_NODE_PUT_NODE (items));
+  g_autoptr(GError) error = NULL;
+  FoundryLspCompletionResults *results;
+
+  results = dex_await_object (foundry_lsp_completion_results_new (fixture->client, reply, typed_text), &error);
+  g_assert_no_error (error);
+  g_assert_true (FOUNDRY_IS_LSP_COMPLETION_RESULTS (results));
+
+  return results;
+}
+
+static char *
+dup_label (GListModel *model,
+           guint       position)
+{
+  g_autoptr(FoundryCompletionProposal) proposal = g_list_model_get_item (model, position);
+
+  g_assert_nonnull (proposal);
+
+  return foundry_completion_proposal_dup_typed_text (proposal);
+}
+
+static void
+assert_label (GListModel *model,
+              guint       position,
+              const char *label)
+{
+  g_autofree char *copy = dup_label (model, position);
+
+  g_assert_cmpstr (copy, ==, label);
+}
+
+static void
+test_completion_ranking_fiber (void)
+{
+  static const char *labels[] = { "foo_bar", "zzz", "fb", "xfb", "Foo_Baz" };
+  g_autoptr(FoundryLspCompletionResults) results = NULL;
+  g_autoptr(JsonArray) ar = json_array_new ();
+  g_autoptr(JsonNode) items = json_node_new (JSON_NODE_ARRAY);
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  for (guint i = 0; i < G_N_ELEMENTS (labels); i++)
+    json_array_add_element (ar, FOUNDRY_JSON_OBJECT_NEW ("label", FOUNDRY_JSON_NODE_PUT_STRING (labels[i])));
+  json_node_set_array (items, ar);
+
+  results = create_results (&fixture, items, "fb");
+
+  /* Exact prefix first, then by match distance, ties by label */
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, 4);
+  assert_label (G_LIST_MODEL (results), 0, "fb");
+  assert_label (G_LIST_MODEL (results), 1, "xfb");
+  assert_label (G_LIST_MODEL (results), 2, "Foo_Baz");
+  assert_label (G_LIST_MODEL (results), 3, "foo_bar");
+
+  /* Narrowing reuses the previous matches */
+  foundry_lsp_completion_results_refilter (results, "fba");
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, 2);
+  assert_label (G_LIST_MODEL (results), 0, "Foo_Baz");
+  assert_label (G_LIST_MODEL (results), 1, "foo_bar");
+
+  /* Widening brings everything back */
+  foundry_lsp_completion_results_refilter (results, NULL);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (results)), ==, G_N_ELEMENTS (labels));
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_completion_tail_fiber (void)
+{
+  g_autoptr(FoundryLspCompletionResults) results = NULL;
+  g_autoptr(JsonArray) ar = json_array_new ();
+  g_autoptr(JsonNode) items = json_node_new (JSON_NODE_ARRAY);
+  GListModel *model;
+  Fixture fixture = {0};
+  guint n_items = 1500;
+
+  fixture_init (&fixture);
+
+  /* sortText runs backwards so the ranked head is the reverse of the
+   * order provided by the server.
+   */
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autofree char *label = g_strdup_printf ("item%04u", i);
+      g_autofree char *sort_text = g_strdup_printf ("%04u", n_items - i);
+
+      json_array_add_element (ar, FOUNDRY_JSON_OBJECT_NEW ("label", FOUNDRY_JSON_NODE_PUT_STRING (label),
+                                                           "sortText", FOUNDRY_JSON_NODE_PUT_STRING (sort_text)));
+    }
+  json_node_set_array (items, ar);
+
+  results = create_results (&fixture, items, "");
+  model = G_LIST_MODEL (results);
+
+  /* Nothing is dropped, even with more matches than are ranked */
+  g_assert_cmpuint (g_list_model_get_n_items (model), ==, n_items);
+
+  /* The best 1000 are ranked... */
+  assert_label (model, 0, "item1499");
+  assert_label (model, 1, "item1498");
+  assert_label (model, 999, "item0500");
+
+  /* ...and the rest follow in server order */
+  assert_label (model, 1000, "item0000");
+  assert_label (model, 1001, "item0001");
+  assert_label (model, n_items - 1, "item0499");
+
+  /* The same applies once there is typed text */
+  foundry_lsp_completion_results_refilter (results, "item");
+  g_assert_cmpuint (g_list_model_get_n_items (model), ==, n_items);
+  assert_label (model, 0, "item1499");
+  assert_label (model, 1000, "item0000");
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_completion_ranking (void)
+{
+  test_from_fiber (test_completion_ranking_fiber);
+}
+
+static void
+test_completion_tail (void)
+{
+  test_from_fiber (test_completion_tail_fiber);
+}
+
+static void
+test_supersede (void)
+{
+  test_from_fiber (test_supersede_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/LspClient/supersede", test_supersede);
+  g_test_add_func ("/Foundry/LspClient/completion-ranking", test_completion_ranking);
+  g_test_add_func ("/Foundry/LspClient/completion-tail", test_completion_tail);
+  return g_test_run ();
+}
@@ -0,0 +1,461 @@
+/* test-mcp-server.c
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <glib-unix.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include <foundry.h>
+
+#include "libfoundry/jsonrpc/foundry-jsonrpc-driver-private.h"
+#include "libfoundry/mcp/foundry-mcp-server-private.h"
+
+#include "test-util.h"
+
+/* Shared by every tool in a test so that we can observe how many
+ * calls overlap without relying on wall-clock time.
+ */
+typedef struct
+{
+  DexPromise *release;
+  guint       started;
+  guint       running;
+  guint       max_running;
+} Tracker;
+
+#define TEST_TYPE_BLOCKING_TOOL (test_blocking_tool_get_type())
+
+G_DECLARE_FINAL_TYPE (TestBlockingTool, test_blocking_tool, TEST, BLOCKING_TOOL, FoundryLlmTool)
+
+struct _TestBlockingTool
+{
+  FoundryLlmTool parent_instance;
+  char *name;
+  Tracker *tracker;
+};
+
+G_DEFINE_FINAL_TYPE (TestBlockingTool, test_blocking_tool, FOUNDRY_TYPE_LLM_TOOL)
+
+static char *
+test_blocking_tool_dup_name (FoundryLlmTool *tool)
+{
+  return g_strdup (TEST_BLOCKING_TOOL (tool)->name);
+}
+
+static char *
+test_blocking_tool_dup_description (FoundryLlmTool *tool)
+{
+  return g_strdup ("Waits until released");
+}
+
+static DexFuture *
+test_blocking_tool_done (DexFuture *completed,
+                         gpointer   user_data)
+{
+  Tracker *tracker = user_data;
+
+  tracker->running--;
+
+  return dex_future_new_take_object (foundry_simple_llm_message_new (g_strdup ("tool"),
+                                                                     g_strdup ("done")));
+}
+
+static DexFuture *
+test_blocking_tool_call (FoundryLlmTool *tool,
+                         const GValue   *arguments,
+                         guint           n_arguments)
+{
+  Tracker *tracker = TEST_BLOCKING_TOOL (tool)->tracker;
+
+  tracker->started++;
+  tracker->running++;
+  tracker->max_running = MAX (tracker->max_running, tracker->running);
+
+  return dex_future_finally (dex_ref (tracker->release),
+                             test_blocking_tool_done,
+                             tracker, NULL);
+}
+
+static void
+test_blocking_tool_finalize (GObject *object)
+{
+  g_clear_pointer (&TEST_BLOCKING_TOOL (object)->name, g_free);
+
+  G_OBJECT_CLASS (test_blocking_tool_parent_class)->finalize (object);
+}
+
+static void
+test_blocking_tool_class_init (TestBlockingToolClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FoundryLlmToolClass *tool_class = FOUNDRY_LLM_TOOL_CLASS (klass);
+
+  object_class->finalize = test_blocking_tool_finalize;
+
+  tool_class->dup_name = test_blocking_tool_dup_name;
+  tool_class->dup_description = test_blocking_tool_dup_description;
+  tool_class->call = test_blocking_tool_call;
+}
+
+static void
+test_blocking_tool_init (TestBlockingTool *self)
+{
+}
+
+static FoundryLlmTool *
+test_blocking_tool_new (FoundryContext *context,
+                        const char     *name,
+                        Tracker        *tracker)
+{
+  TestBlockingTool *self = g_object_new (TEST_TYPE_BLOCKING_TOOL,
+                                         "context", context,
+                                         NULL);
+
+  self->name = g_strdup (name);
+  self->tracker = tracker;
+
+  return FOUNDRY_LLM_TOOL (self);
+}
+
+typedef struct
+{
+  FoundryContext       *context;
+  FoundryMcpServer     *server;
+  FoundryJsonrpcDriver *client;
+  GListStore           *tools;
+  Tracker               tracker;
+  guint                 n_tools_changed;
+} Fixture;
+
+static void
+tools_changed_cb (FoundryJsonrpcDriver *client,
+                  const char           *method,
+                  JsonNode             *params,
+                  Fixture              *fixture)
+{
+  if (g_strcmp0 (method, "notifications/tools/list_changed") == 0)
+    fixture->n_tools_changed++;
+}
+
+/* Two pipes give us a bidirectional transport without a socket */
+static void
+create_stream_pair (GIOStream **server_stream,
+                    GIOStream **client_stream)
+{
+  g_autoptr(GInputStream) server_input = NULL;
+  g_autoptr(GOutputStream) server_output = NULL;
+  g_autoptr(GInputStream) client_input = NULL;
+  g_autoptr(GOutputStream) client_output = NULL;
+  int to_server[2];
+  int to_client[2];
+
+  g_assert_true (g_unix_open_pipe (to_server, FD_CLOEXEC, NULL));
+  g_assert_true (g_unix_open_pipe (to_client, FD_CLOEXEC, NULL));
+
+  server_input = g_unix_input_stream_new (to_server[0], TRUE);
+  client_output = g_unix_output_stream_new (to_server[1], TRUE);
+  client_input = g_unix_input_stream_new (to_client[0], TRUE);
+  server_output = g_unix_output_stream_new (to_client[1], TRUE);
+
+  *server_stream = g_simple_io_stream_new (server_input, server_output);
+  *client_stream = g_simple_io_stream_new (client_input, client_output);
+}
+
+static void
+fixture_init (Fixture *fixture)
+{
+  g_autoptr(GIOStream) server_stream = NULL;
+  g_autoptr(GIOStream) client_stream = NULL;
+  g_autoptr(JsonNode) params = NULL;
+  g_autoptr(JsonNode) reply = NULL;
+  g_autoptr(GError) error = NULL;
+
+  fixture->context = dex_await_object (foundry_context_new_for_user (NULL), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (fixture->context);
+
+  create_stream_pair (&server_stream, &client_stream);
+
+  fixture->tracker.release = dex_promise_new ();
+  fixture->tools = g_list_store_new (FOUNDRY_TYPE_LLM_TOOL);
+  fixture->server = foundry_mcp_server_new (fixture->context, server_stream);
+  _foundry_mcp_server_set_tools (fixture->server, G_LIST_MODEL (fixture->tools));
+  foundry_mcp_server_start (fixture->server);
+
+  fixture->client = foundry_jsonrpc_driver_new (client_stream, FOUNDRY_JSONRPC_STYLE_LF);
+  g_signal_connect (fixture->client,
+                    "handle-notification",
+                    G_CALLBACK (tools_changed_cb),
+                    fixture);
+  foundry_jsonrpc_driver_start (fixture->client);
+
+  params = FOUNDRY_JSON_OBJECT_NEW ("protocolVersion", FOUNDRY_JSON_NODE_PUT_STRING ("2025-06-18"));
+  reply = dex_await_boxed (foundry_jsonrpc_driver_call (fixture->client, "initialize", params), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (reply);
+
+  /* Let the notification for the initial (empty) tool set settle */
+  dex_await (dex_timeout_new_msec (50), NULL);
+  fixture->n_tools_changed = 0;
+}
+
+static void
+fixture_clear (Fixture *fixture)
+{
+  foundry_jsonrpc_driver_stop (fixture->client);
+  foundry_mcp_server_stop (fixture->server);
+
+  g_clear_object (&fixture->client);
+  g_clear_object (&fixture->server);
+  g_clear_object (&fixture->tools);
+  g_clear_object (&fixture->context);
+  dex_clear (&fixture->tracker.release);
+}
+
+static void
+release_tools (Fixture *fixture)
+{
+  dex_promise_resolve_boolean (fixture->tracker.release, TRUE);
+}
+
+/* Tool calls arrive over the transport, so give the server a chance to
+ * process what has been written so far.
+ */
+static void
+await_started (Fixture *fixture,
+               guint    n_started)
+{
+  for (guint i = 0; i < 500 && fixture->tracker.started < n_started; i++)
+    dex_await (dex_timeout_new_msec (10), NULL);
+
+  g_assert_cmpuint (fixture->tracker.started, ==, n_started);
+}
+
+static DexFuture *
+call_tool (Fixture    *fixture,
+           const char *name)
+{
+  g_autoptr(JsonNode) params = FOUNDRY_JSON_OBJECT_NEW ("name", FOUNDRY_JSON_NODE_PUT_STRING (name),
+                                                        "arguments", "{", "}");
+
+  return foundry_jsonrpc_driver_call (fixture->client, "tools/call", params);
+}
+
+static void
+test_mcp_server_concurrent_fiber (void)
+{
+  g_autoptr(GPtrArray) futures = g_ptr_array_new_with_free_func (dex_unref);
+  g_autoptr(GError) error = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  for (guint i = 0; i < 4; i++)
+    {
+      g_autofree char *name = g_strdup_printf ("blocking-%u", i);
+      g_autoptr(FoundryLlmTool) tool = test_blocking_tool_new (fixture.context, name, &fixture.tracker);
+
+      g_list_store_append (fixture.tools, tool);
+    }
+
+  for (guint i = 0; i < 4; i++)
+    {
+      g_autofree char *name = g_strdup_printf ("blocking-%u", i);
+      g_ptr_array_add (futures, call_tool (&fixture, name));
+    }
+
+  /* Every call must be running at once before any of them may finish,
+   * which could never happen if calls were serialized.
+   */
+  await_started (&fixture, 4);
+  g_assert_cmpuint (fixture.tracker.running, ==, 4);
+
+  for (guint i = 0; i < futures->len; i++)
+    g_assert_true (dex_future_is_pending (g_ptr_array_index (futures, i)));
+
+  release_tools (&fixture);
+
+  dex_await (dex_future_allv ((DexFuture **)futures->pdata, futures->len), &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (fixture.tracker.running, ==, 0);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_mcp_server_concurrent (void)
+{
+  test_from_fiber (test_mcp_server_concurrent_fiber);
+}
+
+static void
+test_mcp_server_per_tool_limit_fiber (void)
+{
+  g_autoptr(GPtrArray) futures = g_ptr_array_new_with_free_func (dex_unref);
+  g_autoptr(FoundryLlmTool) tool = NULL;
+  g_autoptr(GError) error = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  tool = test_blocking_tool_new (fixture.context, "blocking", &fixture.tracker);
+  g_list_store_append (fixture.tools, tool);
+
+  for (guint i = 0; i < 8; i++)
+    g_ptr_array_add (futures, call_tool (&fixture, "blocking"));
+
+  /* Only four calls to one tool may run at once. The others must wait
+   * for a slot, so they cannot start until the first batch finishes.
+   */
+  await_started (&fixture, 4);
+  dex_await (dex_timeout_new_msec (50), NULL);
+  g_assert_cmpuint (fixture.tracker.started, ==, 4);
+  g_assert_cmpuint (fixture.tracker.running, ==, 4);
+
+  release_tools (&fixture);
+
+  dex_await (dex_future_allv ((DexFuture **)futures->pdata, futures->len), &error);
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (fixture.tracker.started, ==, 8);
+  g_assert_cmpuint (fixture.tracker.max_running, ==, 4);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_mcp_server_per_tool_limit (void)
+{
+  test_from_fiber (test_mcp_server_per_tool_limit_fiber);
+}
+
+static void
+test_mcp_server_cancelled_fiber (void)
+{
+  g_autoptr(FoundryLlmTool) blocking = NULL;
+  g_autoptr(FoundryLlmTool) other = NULL;
+  g_autoptr(DexFuture) cancelled = NULL;
+  g_autoptr(JsonNode) request_id = NULL;
+  g_autoptr(JsonNode) params = NULL;
+  g_autoptr(JsonNode) call_params = NULL;
+  g_autoptr(JsonNode) reply = NULL;
+  g_autoptr(GError) error = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  blocking = test_blocking_tool_new (fixture.context, "blocking", &fixture.tracker);
+  other = test_blocking_tool_new (fixture.context, "other", &fixture.tracker);
+  g_list_store_append (fixture.tools, blocking);
+  g_list_store_append (fixture.tools, other);
+
+  call_params = FOUNDRY_JSON_OBJECT_NEW ("name", "blocking",
+                                         "arguments", "{", "}");
+  cancelled = foundry_jsonrpc_driver_call_full (fixture.client, "tools/call", call_params, &request_id);
+  await_started (&fixture, 1);
+
+  params = FOUNDRY_JSON_OBJECT_NEW ("requestId", FOUNDRY_JSON_NODE_PUT_NODE (request_id));
+  dex_await (foundry_jsonrpc_driver_notify (fixture.client, "notifications/cancelled", params), &error);
+  g_assert_no_error (error);
+
+  /* The tool finishing later must not produce a reply for the cancelled
+   * request. Replies for requests made afterwards still arrive, so once
+   * we have one the cancelled request has been fully processed.
+   */
+  release_tools (&fixture);
+
+  reply = dex_await_boxed (call_tool (&fixture, "other"), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (reply);
+
+  g_assert_true (dex_future_is_pending (cancelled));
+
+  foundry_jsonrpc_driver_cancel (fixture.client, request_id);
+  g_clear_pointer (&reply, json_node_unref);
+  reply = dex_await_boxed (g_steal_pointer (&cancelled), &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (reply);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_mcp_server_cancelled (void)
+{
+  test_from_fiber (test_mcp_server_cancelled_fiber);
+}
+
+static void
+test_mcp_server_list_changed_fiber (void)
+{
+  g_autoptr(JsonNode) reply = NULL;
+  g_autoptr(GError) error = NULL;
+  Fixture fixture = {0};
+
+  fixture_init (&fixture);
+
+  for (guint i = 0; i < 10; i++)
+    {
+      g_autofree char *name = g_strdup_printf ("tool-%u", i);
+      g_autoptr(FoundryLlmTool) tool = test_blocking_tool_new (fixture.context, name, &fixture.tracker);
+
+      g_list_store_append (fixture.tools, tool);
+    }
+
+  g_list_store_remove (fixture.tools, 0);
+
+  dex_await (dex_timeout_new_msec (100), NULL);
+  g_assert_cmpint (fixture.n_tools_changed, ==, 1);
+
+  /* Removed tools are no longer callable, the rest still are */
+  reply = dex_await_boxed (call_tool (&fixture, "tool-0"), &error);
+  g_assert_nonnull (error);
+  g_assert_null (reply);
+  g_clear_error (&error);
+
+  release_tools (&fixture);
+
+  reply = dex_await_boxed (call_tool (&fixture, "tool-9"), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (reply);
+
+  fixture_clear (&fixture);
+}
+
+static void
+test_mcp_server_list_changed (void)
+{
+  test_from_fiber (test_mcp_server_list_changed_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/McpServer/concurrent", test_mcp_server_concurrent);
+  g_test_add_func ("/Foundry/McpServer/per-tool-limit", test_mcp_server_per_tool_limit);
+  g_test_add_func ("/Foundry/McpServer/cancelled", test_mcp_server_cancelled);
+  g_test_add_func ("/Foundry/McpServer/list-changed", test_mcp_server_list_changed);
+  return g_test_run ();
+}
@@ -0,0 +1,214 @@
+/* test-metrics.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/sysprof/foundry-metrics-private.h"
+#include "libfoundry/sysprof/foundry-trace-private.h"
+
+#define N_THREADS 8
+#define N_SAMPLES 10000
+
+static JsonObject *
+find_metric (JsonNode   *dump,
+             const char *name)
+{
+  JsonArray *ar = json_node_get_array (dump);
+
+  for (guint i = 0; i < json_array_get_length (ar); i++)
+    {
+      JsonObject *obj = json_array_get_object_element (ar, i);
+
+      if (g_strcmp0 (json_object_get_string_member (obj, "name"), name) == 0)
+        return obj;
+    }
+
+  return NULL;
+}
+
+static void
+test_metrics_counter (void)
+{
+  g_autoptr(JsonNode) dump = NULL;
+  JsonObject *obj;
+
+  _foundry_metrics_reset ();
+
+  for (guint i = 0; i < 10; i++)
+    FOUNDRY_METRICS_ADD ("test.counter", 3);
+
+  for (guint i = 0; i < 5; i++)
+    FOUNDRY_TRACE_MARK ("test.mark", NULL);
+
+  dump = _foundry_metrics_dump ();
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.counter")));
+  g_assert_cmpstr (json_object_get_string_member (obj, "kind"), ==, "counter");
+  g_assert_cmpint (json_object_get_int_member (obj, "value"), ==, 30);
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.mark")));
+  g_assert_cmpint (json_object_get_int_member (obj, "value"), ==, 5);
+
+  /* Registering again must yield the same metric */
+  g_assert_cmpint (_foundry_metrics_register ("test.counter", FOUNDRY_METRIC_COUNTER),
+                   ==,
+                   _foundry_metrics_register ("test.counter", FOUNDRY_METRIC_COUNTER));
+}
+
+static void
+test_metrics_for_type (void)
+{
+  g_autoptr(JsonNode) dump = NULL;
+  JsonObject *obj;
+  guint id;
+
+  _foundry_metrics_reset ();
+
+  id = _foundry_metrics_register_for_type ("test.type", G_TYPE_OBJECT, FOUNDRY_METRIC_HISTOGRAM);
+  g_assert_cmpuint (id, !=, 0);
+
+  /* The id is cached on the type and shared with the registry */
+  g_assert_cmpuint (id, ==, _foundry_metrics_register_for_type ("test.type", G_TYPE_OBJECT, FOUNDRY_METRIC_HISTOGRAM));
+  g_assert_cmpuint (id, ==, _foundry_metrics_register ("test.type.GObject", FOUNDRY_METRIC_HISTOGRAM));
+
+  /* Other prefixes and types are distinct metrics */
+  g_assert_cmpuint (id, !=, _foundry_metrics_register_for_type ("test.other", G_TYPE_OBJECT, FOUNDRY_METRIC_HISTOGRAM));
+  g_assert_cmpuint (id, !=, _foundry_metrics_register_for_type ("test.type", G_TYPE_INITIALLY_UNOWNED, FOUNDRY_METRIC_HISTOGRAM));
+
+  _foundry_metrics_record (id, 1000);
+
+  dump = _foundry_metrics_dump ();
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.type.GObject")));
+  g_assert_cmpint (json_object_get_int_member (obj, "count"), ==, 1);
+}
+
+static void
+test_metrics_histogram (void)
+{
+  g_autoptr(JsonNode) dump = NULL;
+  JsonObject *obj;
+  gint64 p50, p90, p99;
+
+  _foundry_metrics_reset ();
+
+  /* 1µs .. 1000µs uniformly */
+  for (guint i = 1; i <= 1000; i++)
+    FOUNDRY_METRICS_RECORD ("test.histogram", i * 1000);
+
+  dump = _foundry_metrics_dump ();
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.histogram")));
+  g_assert_cmpstr (json_object_get_string_member (obj, "kind"), ==, "histogram");
+  g_assert_cmpint (json_object_get_int_member (obj, "count"), ==, 1000);
+  g_assert_cmpint (json_object_get_int_member (obj, "min"), ==, 1000);
+  g_assert_cmpint (json_object_get_int_member (obj, "max"), ==, 1000000);
+  g_assert_cmpint (json_object_get_int_member (obj, "mean"), ==, 500500);
+
+  p50 = json_object_get_int_member (obj, "p50");
+  p90 = json_object_get_int_member (obj, "p90");
+  p99 = json_object_get_int_member (obj, "p99");
+
+  /* Buckets are within 1/16th of the value */
+  g_assert_cmpint (p50, >=, 500000);
+  g_assert_cmpint (p50, <=, 500000 + 500000 / 16);
+  g_assert_cmpint (p90, >=, 900000);
+  g_assert_cmpint (p90, <=, 900000 + 900000 / 16);
+  g_assert_cmpint (p99, >=, 990000);
+  g_assert_cmpint (p99, <=, 1000000);
+}
+
+static void
+test_metrics_scope (void)
+{
+  g_autoptr(JsonNode) dump = NULL;
+  JsonObject *obj;
+
+  _foundry_metrics_reset ();
+
+  for (guint i = 0; i < 3; i++)
+    {
+      FOUNDRY_TRACE_SCOPE ("test.scope", NULL);
+      g_usleep (1000);
+    }
+
+  dump = _foundry_metrics_dump ();
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.scope")));
+  g_assert_cmpint (json_object_get_int_member (obj, "count"), ==, 3);
+  g_assert_cmpint (json_object_get_int_member (obj, "min"), >=, 1000000);
+}
+
+static gpointer
+record_thread (gpointer data)
+{
+  for (guint i = 0; i < N_SAMPLES; i++)
+    {
+      FOUNDRY_METRICS_ADD ("test.threads.counter", 1);
+      FOUNDRY_METRICS_RECORD ("test.threads.histogram", i);
+    }
+
+  return NULL;
+}
+
+static void
+test_metrics_threads (void)
+{
+  g_autoptr(JsonNode) dump = NULL;
+  GThread *threads[N_THREADS];
+  JsonObject *obj;
+
+  _foundry_metrics_reset ();
+
+  for (guint i = 0; i < N_THREADS; i++)
+    threads[i] = g_thread_new ("record", record_thread, NULL);
+
+  for (guint i = 0; i < N_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  /* Shards of exited threads are kept and reused */
+  threads[0] = g_thread_new ("record", record_thread, NULL);
+  g_thread_join (threads[0]);
+
+  dump = _foundry_metrics_dump ();
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.threads.counter")));
+  g_assert_cmpint (json_object_get_int_member (obj, "value"), ==, (N_THREADS + 1) * N_SAMPLES);
+
+  g_assert_nonnull ((obj = find_metric (dump, "test.threads.histogram")));
+  g_assert_cmpint (json_object_get_int_member (obj, "count"), ==, (N_THREADS + 1) * N_SAMPLES);
+  g_assert_cmpint (json_object_get_int_member (obj, "min"), ==, 0);
+  g_assert_cmpint (json_object_get_int_member (obj, "max"), ==, N_SAMPLES - 1);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/Metrics/counter", test_metrics_counter);
+  g_test_add_func ("/Foundry/Metrics/for-type", test_metrics_for_type);
+  g_test_add_func ("/Foundry/Metrics/histogram", test_metrics_histogram);
+  g_test_add_func ("/Foundry/Metrics/scope", test_metrics_scope);
+  g_test_add_func ("/Foundry/Metrics/threads", test_metrics_threads);
+  return g_test_run ();
+}
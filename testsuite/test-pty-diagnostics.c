@@ -0,0 +1,212 @@
+/* test-pty-diagnostics.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/build/foundry-pty-diagnostics-private.h"
+#include "libfoundry/build/pty-intercept.h"
+
+#include "test-util.h"
+
+static FoundryPtyDiagnostics *
+create_diagnostics (FoundryContext **context,
+                    char           **tmpdir)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree char *foundry_dir = NULL;
+  g_autofd int consumer_fd = -1;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-pty-diagnostics-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  foundry_dir = g_build_filename (*tmpdir, ".foundry", NULL);
+
+  *context = dex_await_object (foundry_context_new (foundry_dir, *tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+
+  consumer_fd = pty_intercept_create_consumer ();
+  g_assert_cmpint (consumer_fd, >, -1);
+
+  return foundry_pty_diagnostics_new (*context, consumer_fd);
+}
+
+static void
+destroy_diagnostics (FoundryPtyDiagnostics *diagnostics,
+                     FoundryContext        *context,
+                     char                  *tmpdir)
+{
+  g_object_unref (diagnostics);
+  dex_await (foundry_context_shutdown (context), NULL);
+  g_object_unref (context);
+  rm_rf (tmpdir);
+  g_free (tmpdir);
+}
+
+static void
+feed (FoundryPtyDiagnostics *diagnostics,
+      const char            *text)
+{
+  _foundry_pty_diagnostics_feed (diagnostics, (const guint8 *)text, strlen (text));
+}
+
+/* Diagnostics are extracted on a worker and delivered to the main
+ * thread, so wait until at least @n_items have arrived.
+ */
+static void
+await_n_items (FoundryPtyDiagnostics *diagnostics,
+               guint                  n_items)
+{
+  for (guint i = 0; i < 500; i++)
+    {
+      if (g_list_model_get_n_items (G_LIST_MODEL (diagnostics)) >= n_items)
+        return;
+
+      dex_await (dex_timeout_new_msec (10), NULL);
+    }
+
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (diagnostics)), >=, n_items);
+}
+
+static void
+assert_diagnostic (FoundryPtyDiagnostics *diagnostics,
+                   guint                  position,
+                   const char            *message)
+{
+  g_autoptr(FoundryDiagnostic) diagnostic = g_list_model_get_item (G_LIST_MODEL (diagnostics), position);
+  g_autofree char *text = NULL;
+
+  g_assert_nonnull (diagnostic);
+
+  text = foundry_diagnostic_dup_message (diagnostic);
+  g_assert_cmpstr (text, ==, message);
+}
+
+static void
+test_split_line_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  FoundryPtyDiagnostics *diagnostics;
+  char *tmpdir = NULL;
+
+  diagnostics = create_diagnostics (&context, &tmpdir);
+
+  /* One diagnostic split across two reads, with "n" in both halves */
+  feed (diagnostics, "main.c:12:3: warning: unused variable in fun");
+  feed (diagnostics, "ction main\nnothing to see here\n");
+
+  await_n_items (diagnostics, 1);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (diagnostics)), ==, 1);
+  assert_diagnostic (diagnostics, 0, "unused variable in function main");
+
+  destroy_diagnostics (diagnostics, g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_split_line (void)
+{
+  test_from_fiber (test_split_line_fiber);
+}
+
+static void
+test_reset_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  FoundryPtyDiagnostics *diagnostics;
+  char *tmpdir = NULL;
+
+  diagnostics = create_diagnostics (&context, &tmpdir);
+
+  feed (diagnostics, "first.c:1:1: error: before reset\n");
+  await_n_items (diagnostics, 1);
+
+  /* A partial line from before the reset must not be completed by
+   * output that follows it.
+   */
+  feed (diagnostics, "stale.c:2:2: error: partial");
+  foundry_pty_diagnostics_reset (diagnostics);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (diagnostics)), ==, 0);
+
+  feed (diagnostics, "\nsecond.c:3:3: warning: after reset\n");
+
+  await_n_items (diagnostics, 1);
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (diagnostics)), ==, 1);
+  assert_diagnostic (diagnostics, 0, "after reset");
+
+  destroy_diagnostics (diagnostics, g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_reset (void)
+{
+  test_from_fiber (test_reset_fiber);
+}
+
+static void
+test_reset_queued_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  FoundryPtyDiagnostics *diagnostics;
+  char *tmpdir = NULL;
+
+  diagnostics = create_diagnostics (&context, &tmpdir);
+
+  /* Complete lines are already on their way to the worker, along with
+   * a directory change, when the reset happens.
+   */
+  for (guint i = 0; i < 100; i++)
+    feed (diagnostics, "stale.c:1:1: error: queued\n");
+  feed (diagnostics, "make: Entering directory '/stale'\n");
+  foundry_pty_diagnostics_reset (diagnostics);
+
+  feed (diagnostics, "fresh.c:2:2: warning: after reset\n");
+  await_n_items (diagnostics, 1);
+
+  /* Give anything stale a chance to be delivered */
+  dex_await (dex_timeout_new_msec (100), NULL);
+
+  g_assert_cmpuint (g_list_model_get_n_items (G_LIST_MODEL (diagnostics)), ==, 1);
+  assert_diagnostic (diagnostics, 0, "after reset");
+
+  destroy_diagnostics (diagnostics, g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_reset_queued (void)
+{
+  test_from_fiber (test_reset_queued_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+
+  /* Diagnostics are only delivered on the main thread */
+  dex_future_disown (foundry_init ());
+
+  g_test_add_func ("/Foundry/PtyDiagnostics/split-line", test_split_line);
+  g_test_add_func ("/Foundry/PtyDiagnostics/reset", test_reset);
+  g_test_add_func ("/Foundry/PtyDiagnostics/reset-queued", test_reset_queued);
+  return g_test_run ();
+}
@@ -0,0 +1,470 @@
+/* test-search-manager.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "foundry-search-manager-private.h"
+
+#include "test-util.h"
+
+#define N_RESULTS 3
+
+#define TEST_TYPE_SEARCH_RESULT (test_search_result_get_type())
+G_DECLARE_FINAL_TYPE (TestSearchResult, test_search_result, TEST, SEARCH_RESULT, FoundrySearchResult)
+
+struct _TestSearchResult
+{
+  FoundrySearchResult parent_instance;
+  char *title;
+  double score;
+};
+
+G_DEFINE_FINAL_TYPE (TestSearchResult, test_search_result, FOUNDRY_TYPE_SEARCH_RESULT)
+
+static char *
+test_search_result_dup_title (FoundrySearchResult *result)
+{
+  return g_strdup (TEST_SEARCH_RESULT (result)->title);
+}
+
+static double
+test_search_result_get_score (FoundrySearchResult *result)
+{
+  return TEST_SEARCH_RESULT (result)->score;
+}
+
+static void
+test_search_result_finalize (GObject *object)
+{
+  TestSearchResult *self = TEST_SEARCH_RESULT (object);
+
+  g_clear_pointer (&self->title, g_free);
+
+  G_OBJECT_CLASS (test_search_result_parent_class)->finalize (object);
+}
+
+static void
+test_search_result_class_init (TestSearchResultClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FoundrySearchResultClass *search_result_class = FOUNDRY_SEARCH_RESULT_CLASS (klass);
+
+  object_class->finalize = test_search_result_finalize;
+
+  search_result_class->dup_title = test_search_result_dup_title;
+  search_result_class->get_score = test_search_result_get_score;
+}
+
+static void
+test_search_result_init (TestSearchResult *self)
+{
+}
+
+#define TEST_TYPE_SEARCH_PROVIDER (test_search_provider_get_type())
+G_DECLARE_FINAL_TYPE (TestSearchProvider, test_search_provider, TEST, SEARCH_PROVIDER, FoundrySearchProvider)
+
+struct _TestSearchProvider
+{
+  FoundrySearchProvider parent_instance;
+  char *name;
+  guint delay_msec;
+  double scale;
+};
+
+G_DEFINE_FINAL_TYPE (TestSearchProvider, test_search_provider, FOUNDRY_TYPE_SEARCH_PROVIDER)
+
+static DexFuture *
+test_search_provider_search_fiber (gpointer data)
+{
+  TestSearchProvider *self = data;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_SEARCH_RESULT);
+
+  dex_await (dex_timeout_new_msec (self->delay_msec), NULL);
+
+  for (guint i = 0; i < N_RESULTS; i++)
+    {
+      g_autoptr(TestSearchResult) result = g_object_new (TEST_TYPE_SEARCH_RESULT, NULL);
+
+      result->title = g_strdup_printf ("%s-%u", self->name, i);
+      result->score = (N_RESULTS - i) * self->scale;
+
+      g_list_store_append (store, result);
+    }
+
+  return dex_future_new_take_object (g_steal_pointer (&store));
+}
+
+static DexFuture *
+test_search_provider_search (FoundrySearchProvider *provider,
+                             FoundrySearchRequest  *request)
+{
+  return dex_scheduler_spawn (NULL, 0,
+                              test_search_provider_search_fiber,
+                              g_object_ref (provider),
+                              g_object_unref);
+}
+
+static void
+test_search_provider_finalize (GObject *object)
+{
+  TestSearchProvider *self = TEST_SEARCH_PROVIDER (object);
+
+  g_clear_pointer (&self->name, g_free);
+
+  G_OBJECT_CLASS (test_search_provider_parent_class)->finalize (object);
+}
+
+static void
+test_search_provider_class_init (TestSearchProviderClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FoundrySearchProviderClass *search_provider_class = FOUNDRY_SEARCH_PROVIDER_CLASS (klass);
+
+  object_class->finalize = test_search_provider_finalize;
+
+  search_provider_class->search = test_search_provider_search;
+}
+
+static void
+test_search_provider_init (TestSearchProvider *self)
+{
+}
+
+static void
+add_provider (GPtrArray      *providers,
+              FoundryContext *context,
+              const char     *name,
+              guint           delay_msec,
+              double          scale)
+{
+  TestSearchProvider *provider = g_object_new (TEST_TYPE_SEARCH_PROVIDER,
+                                               "context", context,
+                                               NULL);
+
+  provider->name = g_strdup (name);
+  provider->delay_msec = delay_msec;
+  provider->scale = scale;
+
+  g_ptr_array_add (providers, provider);
+}
+
+static FoundryContext *
+create_context (char **tmpdir)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autofree char *foundry_dir = NULL;
+  g_autoptr(GError) error = NULL;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-search-manager-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  foundry_dir = g_build_filename (*tmpdir, ".foundry", NULL);
+  context = dex_await_object (foundry_context_new (foundry_dir, *tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (context);
+
+  return g_steal_pointer (&context);
+}
+
+static void
+assert_titles (GListModel         *model,
+               const char * const *titles)
+{
+  guint n_items = g_list_model_get_n_items (model);
+
+  g_assert_cmpint (n_items, ==, g_strv_length ((char **)titles));
+
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr(FoundrySearchResult) result = g_list_model_get_item (model, i);
+      g_autofree char *title = foundry_search_result_dup_title (result);
+
+      g_assert_cmpstr (title, ==, titles[i]);
+    }
+}
+
+static gint64
+wait_for_first_result (GListModel *model)
+{
+  gint64 begin = g_get_monotonic_time ();
+
+  while (g_list_model_get_n_items (model) == 0)
+    dex_await (dex_timeout_new_msec (1), NULL);
+
+  return g_get_monotonic_time () - begin;
+}
+
+static void
+test_streaming_fiber (void)
+{
+  static const char * const expected[] = {
+    "slow-0", "slow-1", "slow-2",
+    "medium-0", "medium-1", "medium-2",
+    "fast-0", "fast-1", "fast-2",
+    NULL
+  };
+  g_autoptr(FoundrySearchRequest) request = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GListModel) model = NULL;
+  g_autofree char *tmpdir = NULL;
+  gint64 begin;
+  gint64 first;
+
+  context = create_context (&tmpdir);
+  request = foundry_search_request_new (context, "test");
+
+  /* Highest priority first, which is also the slowest */
+  providers = g_ptr_array_new_with_free_func (g_object_unref);
+  add_provider (providers, context, "slow", 600, 1);
+  add_provider (providers, context, "medium", 300, 1);
+  add_provider (providers, context, "fast", 10, 1);
+
+  begin = g_get_monotonic_time ();
+  model = _foundry_search_manager_search_providers (providers, request, NULL, 0, FALSE);
+  g_assert_cmpint (g_list_model_get_n_items (model), ==, 0);
+
+  /* The fastest provider is visible before the others complete */
+  first = wait_for_first_result (model);
+  g_assert_cmpint (first, <, 300 * 1000);
+  g_assert_cmpint (g_list_model_get_n_items (model), ==, N_RESULTS);
+
+  g_assert_true (dex_await (foundry_list_model_await (model), NULL));
+  g_assert_cmpint (g_get_monotonic_time () - begin, >=, 600 * 1000);
+
+  /* Results stay grouped by provider priority, not completion order */
+  assert_titles (model, expected);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_streaming (void)
+{
+  test_from_fiber (test_streaming_fiber);
+}
+
+static void
+test_deadline_fiber (void)
+{
+  static const char * const expected[] = { "fast-0", "fast-1", "fast-2", NULL };
+  g_autoptr(FoundrySearchRequest) request = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GListModel) model = NULL;
+  g_autofree char *tmpdir = NULL;
+  gint64 begin;
+
+  context = create_context (&tmpdir);
+  request = foundry_search_request_new (context, "test");
+
+  providers = g_ptr_array_new_with_free_func (g_object_unref);
+  add_provider (providers, context, "hung", 3000, 1);
+  add_provider (providers, context, "fast", 10, 1);
+
+  begin = g_get_monotonic_time ();
+  model = _foundry_search_manager_search_providers (providers, request, NULL, 200, FALSE);
+
+  g_assert_true (dex_await (foundry_list_model_await (model), NULL));
+  g_assert_cmpint (g_get_monotonic_time () - begin, <, 5000 * 1000);
+
+  assert_titles (model, expected);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_deadline (void)
+{
+  test_from_fiber (test_deadline_fiber);
+}
+
+static void
+test_cancel_fiber (void)
+{
+  static const char * const expected[] = { "fast-0", "fast-1", "fast-2", NULL };
+  g_autoptr(FoundrySearchRequest) request = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(DexCancellable) cancellable = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GListModel) model = NULL;
+  g_autofree char *tmpdir = NULL;
+  gint64 begin;
+
+  context = create_context (&tmpdir);
+  request = foundry_search_request_new (context, "test");
+  cancellable = dex_cancellable_new ();
+
+  providers = g_ptr_array_new_with_free_func (g_object_unref);
+  add_provider (providers, context, "slow", 2000, 1);
+  add_provider (providers, context, "fast", 10, 1);
+
+  begin = g_get_monotonic_time ();
+  model = _foundry_search_manager_search_providers (providers, request, cancellable, 0, FALSE);
+
+  /* Superseded once the first results arrive */
+  wait_for_first_result (model);
+  dex_cancellable_cancel (cancellable);
+
+  g_assert_true (dex_await (foundry_list_model_await (model), NULL));
+  g_assert_cmpint (g_get_monotonic_time () - begin, <, 2000 * 1000);
+
+  assert_titles (model, expected);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_cancel (void)
+{
+  test_from_fiber (test_cancel_fiber);
+}
+
+static void
+test_ranked_fiber (void)
+{
+  /* Scores are normalized per provider, ties go to provider priority */
+  static const char * const expected[] = {
+    "small-0", "large-0", "unscored-0",
+    "small-1", "large-1", "unscored-1",
+    "small-2", "large-2", "unscored-2",
+    NULL
+  };
+  g_autoptr(FoundrySearchRequest) request = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GListModel) model = NULL;
+  g_autofree char *tmpdir = NULL;
+
+  context = create_context (&tmpdir);
+  request = foundry_search_request_new (context, "test");
+
+  providers = g_ptr_array_new_with_free_func (g_object_unref);
+  add_provider (providers, context, "small", 100, 0.25);
+  add_provider (providers, context, "large", 10, 64);
+  add_provider (providers, context, "unscored", 50, 0);
+
+  model = _foundry_search_manager_search_providers (providers, request, NULL, 0, TRUE);
+
+  g_assert_true (dex_await (foundry_list_model_await (model), NULL));
+
+  assert_titles (model, expected);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_ranked (void)
+{
+  test_from_fiber (test_ranked_fiber);
+}
+
+static void
+test_supersede_fiber (void)
+{
+  static const char * const superseded[] = { "fast-0", "fast-1", "fast-2", NULL };
+  static const char * const complete[] = {
+    "slow-0", "slow-1", "slow-2",
+    "fast-0", "fast-1", "fast-2",
+    NULL
+  };
+  g_autoptr(FoundrySearchManager) search_manager = NULL;
+  g_autoptr(FoundrySearchRequest) request = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(DexCancellable) first_cancellable = NULL;
+  g_autoptr(DexCancellable) second_cancellable = NULL;
+  g_autoptr(DexCancellable) other_cancellable = NULL;
+  g_autoptr(GPtrArray) providers = NULL;
+  g_autoptr(GListModel) first = NULL;
+  g_autoptr(GListModel) second = NULL;
+  g_autoptr(GListModel) other = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+
+  context = create_context (&tmpdir);
+  request = foundry_search_request_new (context, "test");
+
+  providers = g_ptr_array_new_with_free_func (g_object_unref);
+  add_provider (providers, context, "slow", 600, 1);
+  add_provider (providers, context, "fast", 10, 1);
+
+  search_manager = foundry_context_dup_search_manager (context);
+  _foundry_search_manager_set_providers (search_manager, providers);
+
+  first_cancellable = dex_cancellable_new ();
+  other_cancellable = dex_cancellable_new ();
+
+  first = dex_await_object (foundry_search_manager_search_full (search_manager, request, first_cancellable, 0, FALSE), &error);
+  g_assert_no_error (error);
+
+  other = dex_await_object (foundry_search_manager_search_full (search_manager, request, other_cancellable, 0, FALSE), &error);
+  g_assert_no_error (error);
+
+  /* Supersede only the first search, like a search entry would */
+  wait_for_first_result (first);
+  dex_cancellable_cancel (first_cancellable);
+
+  second_cancellable = dex_cancellable_new ();
+  second = dex_await_object (foundry_search_manager_search_full (search_manager, request, second_cancellable, 0, FALSE), &error);
+  g_assert_no_error (error);
+
+  g_assert_true (dex_await (foundry_list_model_await (first), NULL));
+  assert_titles (first, superseded);
+
+  /* Neither the new search nor another caller's search is cut short */
+  g_assert_true (dex_await (foundry_list_model_await (second), NULL));
+  assert_titles (second, complete);
+
+  g_assert_true (dex_await (foundry_list_model_await (other), NULL));
+  assert_titles (other, complete);
+
+  _foundry_search_manager_set_providers (search_manager, NULL);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+}
+
+static void
+test_supersede (void)
+{
+  test_from_fiber (test_supersede_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/SearchManager/streaming", test_streaming);
+  g_test_add_func ("/Foundry/SearchManager/deadline", test_deadline);
+  g_test_add_func ("/Foundry/SearchManager/cancel", test_cancel);
+  g_test_add_func ("/Foundry/SearchManager/ranked", test_ranked);
+  g_test_add_func ("/Foundry/SearchManager/supersede", test_supersede);
+
+  return g_test_run ();
+}
@@ -64,11 +64,106 @@ test_simple_text_buffer (void)
   }
 }
 
+typedef struct
+{
+  guint  handler_id;
+  guint  other_id;
+  guint  count;
+  guint *removed;
+} Notify;
+
+static void
+count_notify (FoundryTextBuffer            *buffer,
+              FoundryTextBufferNotifyFlags  flags,
+              guint                         position,
+              guint                         length,
+              gpointer                      user_data)
+{
+  Notify *notify = user_data;
+
+  notify->count++;
+}
+
+static void
+remove_other_notify (FoundryTextBuffer            *buffer,
+                     FoundryTextBufferNotifyFlags  flags,
+                     guint                         position,
+                     guint                         length,
+                     gpointer                      user_data)
+{
+  Notify *notify = user_data;
+
+  notify->count++;
+
+  /* Removing another handler from inside a callback must not skip the
+   * remaining handlers or call the removed one.
+   */
+  if (notify->other_id != 0)
+    {
+      foundry_text_buffer_remove_commit_notify (buffer, notify->other_id);
+      notify->other_id = 0;
+
+      /* Enough to reallocate the array, none of which may be called
+       * for the commit that is being dispatched.
+       */
+      for (guint i = 0; i < 32; i++)
+        foundry_text_buffer_add_commit_notify (buffer,
+                                               FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT,
+                                               count_notify,
+                                               notify, NULL);
+    }
+}
+
+static void
+notify_removed (gpointer user_data)
+{
+  Notify *notify = user_data;
+
+  (*notify->removed)++;
+}
+
+static void
+test_simple_text_buffer_commit_notify (void)
+{
+  g_autoptr(FoundryTextBuffer) buffer = foundry_simple_text_buffer_new ();
+  g_autoptr(FoundryTextEdit) edit = foundry_text_edit_new (NULL, 0, 0, 0, 0, "text");
+  guint removed = 0;
+  Notify first = { .removed = &removed };
+  Notify second = { .removed = &removed };
+  Notify third = { .removed = &removed };
+
+  first.handler_id = foundry_text_buffer_add_commit_notify (buffer,
+                                                            FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT,
+                                                            remove_other_notify,
+                                                            &first, notify_removed);
+  second.handler_id = foundry_text_buffer_add_commit_notify (buffer,
+                                                             FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT,
+                                                             count_notify,
+                                                             &second, notify_removed);
+  third.handler_id = foundry_text_buffer_add_commit_notify (buffer,
+                                                            FOUNDRY_TEXT_BUFFER_NOTIFY_AFTER_INSERT,
+                                                            count_notify,
+                                                            &third, notify_removed);
+  first.other_id = second.handler_id;
+
+  g_assert_true (foundry_text_buffer_apply_edit (buffer, edit));
+
+  g_assert_cmpuint (first.count, ==, 1);
+  g_assert_cmpuint (second.count, ==, 0);
+  g_assert_cmpuint (third.count, ==, 1);
+  g_assert_cmpuint (removed, ==, 1);
+
+  foundry_text_buffer_remove_commit_notify (buffer, first.handler_id);
+  foundry_text_buffer_remove_commit_notify (buffer, third.handler_id);
+  g_assert_cmpuint (removed, ==, 3);
+}
+
 int
 main (int argc,
       char *argv[])
 {
   g_test_init (&argc, &argv, NULL);
   g_test_add_func ("/Foundry/SimpleTextBuffer/basic", test_simple_text_buffer);
+  g_test_add_func ("/Foundry/SimpleTextBuffer/commit-notify", test_simple_text_buffer_commit_notify);
   return g_test_run ();
 }
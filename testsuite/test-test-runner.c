@@ -0,0 +1,541 @@
+/* test-test-runner.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "libfoundry/tests/foundry-test-runner-private.h"
+
+#include "test-util.h"
+
+#define TEST_TYPE_CASE (test_case_get_type())
+G_DECLARE_FINAL_TYPE (TestCase, test_case, TEST, CASE, FoundryTest)
+
+struct _TestCase
+{
+  FoundryTest   parent_instance;
+  char         *id;
+  char         *suite;
+  char        **argv;
+};
+
+G_DEFINE_FINAL_TYPE (TestCase, test_case, FOUNDRY_TYPE_TEST)
+
+static char *
+test_case_dup_id (FoundryTest *test)
+{
+  return g_strdup (TEST_CASE (test)->id);
+}
+
+static char **
+test_case_dup_suites (FoundryTest *test)
+{
+  TestCase *self = TEST_CASE (test);
+  const char *suites[] = { self->suite, NULL };
+
+  if (self->suite == NULL)
+    return NULL;
+
+  return g_strdupv ((char **)suites);
+}
+
+static FoundryCommand *
+test_case_dup_command (FoundryTest *test)
+{
+  TestCase *self = TEST_CASE (test);
+  g_autoptr(FoundryContext) context = foundry_contextual_dup_context (FOUNDRY_CONTEXTUAL (self));
+  g_autoptr(FoundryCommand) command = NULL;
+
+  /* Tests without a command fail without ever running */
+  if (self->argv == NULL)
+    return NULL;
+
+  command = foundry_command_new (context);
+  foundry_command_set_locality (command, FOUNDRY_COMMAND_LOCALITY_SUBPROCESS);
+  foundry_command_set_argv (command, (const char * const *)self->argv);
+
+  return g_steal_pointer (&command);
+}
+
+static void
+test_case_finalize (GObject *object)
+{
+  TestCase *self = (TestCase *)object;
+
+  g_clear_pointer (&self->id, g_free);
+  g_clear_pointer (&self->suite, g_free);
+  g_clear_pointer (&self->argv, g_strfreev);
+
+  G_OBJECT_CLASS (test_case_parent_class)->finalize (object);
+}
+
+static void
+test_case_class_init (TestCaseClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  FoundryTestClass *test_class = FOUNDRY_TEST_CLASS (klass);
+
+  object_class->finalize = test_case_finalize;
+
+  test_class->dup_id = test_case_dup_id;
+  test_class->dup_suites = test_case_dup_suites;
+  test_class->dup_command = test_case_dup_command;
+}
+
+static void
+test_case_init (TestCase *self)
+{
+}
+
+static void
+add_test (GListStore         *store,
+          FoundryContext     *context,
+          const char         *id,
+          const char         *suite,
+          const char * const *argv)
+{
+  g_autoptr(TestCase) test = g_object_new (TEST_TYPE_CASE,
+                                           "context", context,
+                                           NULL);
+
+  test->id = g_strdup (id);
+  test->suite = g_strdup (suite);
+  test->argv = g_strdupv ((char **)argv);
+
+  g_list_store_append (store, test);
+}
+
+static FoundryContext *
+create_context (char **tmpdir)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *foundry_dir = NULL;
+
+  *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-test-runner-XXXXXX", NULL);
+  g_assert_nonnull (g_mkdtemp (*tmpdir));
+
+  foundry_dir = g_build_filename (*tmpdir, ".foundry", NULL);
+
+  context = dex_await_object (foundry_context_new (foundry_dir, *tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+
+  return g_steal_pointer (&context);
+}
+
+static void
+destroy_context (FoundryContext *context,
+                 char           *tmpdir)
+{
+  dex_await (foundry_context_shutdown (context), NULL);
+  rm_rf (tmpdir);
+  g_free (tmpdir);
+}
+
+static void
+write_durations (FoundryContext *context,
+                 const char     *contents)
+{
+  g_autofree char *path = foundry_context_cache_filename (context, "test-durations.json", NULL);
+  g_autofree char *dir = g_path_get_dirname (path);
+  g_autoptr(GError) error = NULL;
+
+  g_assert_cmpint (g_mkdir_with_parents (dir, 0750), ==, 0);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+}
+
+static JsonObject *
+read_durations (FoundryContext *context,
+                JsonNode      **node)
+{
+  g_autofree char *path = foundry_context_cache_filename (context, "test-durations.json", NULL);
+  g_autoptr(JsonParser) parser = json_parser_new ();
+  g_autoptr(GError) error = NULL;
+
+  json_parser_load_from_file (parser, path, &error);
+  g_assert_no_error (error);
+
+  *node = json_node_copy (json_parser_get_root (parser));
+
+  return json_node_get_object (*node);
+}
+
+static JsonArray *
+run_tests (FoundryTestRunner  *runner,
+           GListStore         *store,
+           JsonNode          **node)
+{
+  g_autoptr(GError) error = NULL;
+
+  dex_await (foundry_test_runner_run (runner, G_LIST_MODEL (store)), &error);
+  g_assert_no_error (error);
+
+  *node = foundry_test_runner_to_json (runner);
+
+  return json_object_get_array_member (json_node_get_object (*node), "tests");
+}
+
+static const char *
+get_test_string (JsonArray  *tests,
+                 guint       position,
+                 const char *member)
+{
+  return json_object_get_string_member (json_array_get_object_element (tests, position), member);
+}
+
+static void
+test_shard_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_TEST);
+  char *tmpdir = NULL;
+
+  context = create_context (&tmpdir);
+
+  /* Added out of order since sharding must only depend on identifiers */
+  add_test (store, context, "t3", NULL, NULL);
+  add_test (store, context, "t0", NULL, NULL);
+  add_test (store, context, "t5", NULL, NULL);
+  add_test (store, context, "t1", NULL, NULL);
+  add_test (store, context, "t4", NULL, NULL);
+  add_test (store, context, "t2", NULL, NULL);
+
+  for (guint index = 0; index < 3; index++)
+    {
+      g_autoptr(FoundryTestRunner) runner = foundry_test_runner_new (context);
+      g_autoptr(JsonNode) node = NULL;
+      JsonArray *tests;
+
+      foundry_test_runner_set_shard (runner, index, 3);
+      tests = run_tests (runner, store, &node);
+
+      g_assert_cmpuint (json_array_get_length (tests), ==, 2);
+      g_assert_cmpuint (json_object_get_int_member (json_node_get_object (node), "shard"), ==, index + 1);
+
+      for (guint i = 0; i < 2; i++)
+        {
+          g_autofree char *expected = g_strdup_printf ("t%u", index + i * 3);
+          g_assert_cmpstr (get_test_string (tests, i, "id"), ==, expected);
+        }
+    }
+
+  destroy_context (g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_shard (void)
+{
+  test_from_fiber (test_shard_fiber);
+}
+
+static void
+test_ordering_fiber (void)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryTestRunner) runner = NULL;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_TEST);
+  g_autoptr(JsonNode) node = NULL;
+  char *tmpdir = NULL;
+  JsonArray *tests;
+
+  context = create_context (&tmpdir);
+
+  /* "d" has no history so it is assumed to take the average (20) and
+   * ties with "c" are broken by identifier.
+   */
+  write_durations (context, "{\"a\":10,\"b\":30,\"c\":20}");
+
+  add_test (store, context, "a", NULL, NULL);
+  add_test (store, context, "b", NULL, NULL);
+  add_test (store, context, "c", NULL, NULL);
+  add_test (store, context, "d", NULL, NULL);
+
+  runner = foundry_test_runner_new (context);
+  foundry_test_runner_set_jobs (runner, 1);
+  tests = run_tests (runner, store, &node);
+
+  g_assert_cmpuint (json_array_get_length (tests), ==, 4);
+  g_assert_cmpstr (get_test_string (tests, 0, "id"), ==, "b");
+  g_assert_cmpstr (get_test_string (tests, 1, "id"), ==, "c");
+  g_assert_cmpstr (get_test_string (tests, 2, "id"), ==, "d");
+  g_assert_cmpstr (get_test_string (tests, 3, "id"), ==, "a");
+
+  destroy_context (g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_ordering (void)
+{
+  test_from_fiber (test_ordering_fiber);
+}
+
+static void
+test_durations_merge_fiber (void)
+{
+  static const char * const pass_argv[] = { "true", NULL };
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryTestRunner) runner = NULL;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_TEST);
+  g_autoptr(JsonNode) durations = NULL;
+  g_autoptr(JsonNode) node = NULL;
+  char *tmpdir = NULL;
+  JsonObject *obj;
+  JsonArray *tests;
+
+  context = create_context (&tmpdir);
+
+  /* Durations from other shards must survive this run */
+  write_durations (context, "{\"other\":5}");
+
+  add_test (store, context, "pass", NULL, pass_argv);
+  add_test (store, context, "error", NULL, NULL);
+
+  runner = foundry_test_runner_new (context);
+  tests = run_tests (runner, store, &node);
+  g_assert_cmpuint (json_array_get_length (tests), ==, 2);
+
+  obj = read_durations (context, &durations);
+  g_assert_cmpint (json_object_get_int_member (obj, "other"), ==, 5);
+  g_assert_true (json_object_has_member (obj, "pass"));
+  g_assert_false (json_object_has_member (obj, "error"));
+
+  destroy_context (g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_durations_merge (void)
+{
+  test_from_fiber (test_durations_merge_fiber);
+}
+
+static void
+test_passed_fiber (void)
+{
+  static const char * const argv[] = { "sh", "-c", "sleep 0.2; echo ok", NULL };
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryTestRunner) runner = NULL;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_TEST);
+  g_autoptr(JsonNode) node = NULL;
+  char *tmpdir = NULL;
+  JsonArray *tests;
+
+  context = create_context (&tmpdir);
+
+  add_test (store, context, "pass", NULL, argv);
+
+  /* No timeout is set, so the test must be left to run to completion */
+  runner = foundry_test_runner_new (context);
+  tests = run_tests (runner, store, &node);
+
+  g_assert_cmpuint (json_array_get_length (tests), ==, 1);
+  g_assert_cmpstr (get_test_string (tests, 0, "status"), ==, "passed");
+  g_assert_cmpstr (get_test_string (tests, 0, "output"), ==, "ok\n");
+
+  destroy_context (g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_passed (void)
+{
+  test_from_fiber (test_passed_fiber);
+}
+
+static void
+test_timeout_fiber (void)
+{
+  static const char * const argv[] = { "sh", "-c", "sleep 30 & echo started; wait", NULL };
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryTestRunner) runner = NULL;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_TEST);
+  g_autoptr(JsonNode) node = NULL;
+  char *tmpdir = NULL;
+  JsonArray *tests;
+
+  context = create_context (&tmpdir);
+
+  add_test (store, context, "hang", NULL, argv);
+
+  runner = foundry_test_runner_new (context);
+  foundry_test_runner_set_timeout (runner, G_USEC_PER_SEC / 2);
+  tests = run_tests (runner, store, &node);
+
+  /* Output is only collected once every holder of the pipe exits,
+   * which requires the background sleep to be killed with the test.
+   */
+  g_assert_cmpstr (get_test_string (tests, 0, "status"), ==, "timeout");
+  g_assert_cmpstr (get_test_string (tests, 0, "output"), ==, "started\n");
+
+  destroy_context (g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_timeout (void)
+{
+  test_from_fiber (test_timeout_fiber);
+}
+
+typedef struct
+{
+  GHashTable *testcases;
+  GString    *output;
+  char       *current;
+  gboolean    in_output;
+} JUnit;
+
+static void
+junit_start_element (GMarkupParseContext  *context,
+                     const char           *element_name,
+                     const char          **attribute_names,
+                     const char          **attribute_values,
+                     gpointer              user_data,
+                     GError              **error)
+{
+  JUnit *junit = user_data;
+
+  if (g_str_equal (element_name, "testcase"))
+    {
+      for (guint i = 0; attribute_names[i]; i++)
+        {
+          if (g_str_equal (attribute_names[i], "name"))
+            {
+              g_free (junit->current);
+              junit->current = g_strdup (attribute_values[i]);
+            }
+        }
+
+      g_hash_table_insert (junit->testcases, g_strdup (junit->current), g_strdup (""));
+    }
+  else if (g_str_equal (element_name, "error") ||
+           g_str_equal (element_name, "failure"))
+    {
+      for (guint i = 0; attribute_names[i]; i++)
+        {
+          if (g_str_equal (attribute_names[i], "message"))
+            g_hash_table_insert (junit->testcases, g_strdup (junit->current), g_strdup (attribute_values[i]));
+        }
+    }
+  else if (g_str_equal (element_name, "system-out"))
+    {
+      junit->in_output = TRUE;
+    }
+}
+
+static void
+junit_end_element (GMarkupParseContext  *context,
+                   const char           *element_name,
+                   gpointer              user_data,
+                   GError              **error)
+{
+  JUnit *junit = user_data;
+
+  if (g_str_equal (element_name, "system-out"))
+    junit->in_output = FALSE;
+}
+
+static void
+junit_text (GMarkupParseContext  *context,
+            const char           *text,
+            gsize                 text_len,
+            gpointer              user_data,
+            GError              **error)
+{
+  JUnit *junit = user_data;
+
+  if (junit->in_output)
+    g_string_append_len (junit->output, text, text_len);
+}
+
+static const GMarkupParser junit_parser = {
+  .start_element = junit_start_element,
+  .end_element = junit_end_element,
+  .text = junit_text,
+};
+
+static void
+test_junit_fiber (void)
+{
+  static const char * const fail_argv[] = { "printf", "a\033b<c>&\n", NULL };
+  static const char * const exit_argv[] = { "sh", "-c", "exit 3", NULL };
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(FoundryTestRunner) runner = NULL;
+  g_autoptr(GListStore) store = g_list_store_new (FOUNDRY_TYPE_TEST);
+  g_autoptr(GMarkupParseContext) parse = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *xml = NULL;
+  char *tmpdir = NULL;
+  JUnit junit = {0};
+
+  context = create_context (&tmpdir);
+
+  add_test (store, context, "quote\"amp&lt<", "suite\"&", NULL);
+  add_test (store, context, "output", NULL, fail_argv);
+  add_test (store, context, "exit", NULL, exit_argv);
+
+  runner = foundry_test_runner_new (context);
+  dex_await (foundry_test_runner_run (runner, G_LIST_MODEL (store)), &error);
+  g_assert_no_error (error);
+
+  xml = foundry_test_runner_to_junit (runner);
+
+  junit.testcases = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  junit.output = g_string_new (NULL);
+
+  parse = g_markup_parse_context_new (&junit_parser, 0, &junit, NULL);
+  g_markup_parse_context_parse (parse, xml, -1, &error);
+  g_assert_no_error (error);
+  g_markup_parse_context_end_parse (parse, &error);
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (g_hash_table_size (junit.testcases), ==, 3);
+  g_assert_cmpstr (g_hash_table_lookup (junit.testcases, "quote\"amp&lt<"), ==,
+                   "`quote\"amp&lt<` is missing a test command");
+  g_assert_cmpstr (g_hash_table_lookup (junit.testcases, "exit"), ==, "Exited with status 3");
+  g_assert_cmpstr (g_hash_table_lookup (junit.testcases, "output"), ==, "");
+  g_assert_cmpstr (junit.output->str, ==, "ab<c>&\n");
+
+  g_hash_table_unref (junit.testcases);
+  g_string_free (junit.output, TRUE);
+  g_free (junit.current);
+
+  destroy_context (g_steal_pointer (&context), tmpdir);
+}
+
+static void
+test_junit (void)
+{
+  test_from_fiber (test_junit_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/TestRunner/shard", test_shard);
+  g_test_add_func ("/Foundry/TestRunner/ordering", test_ordering);
+  g_test_add_func ("/Foundry/TestRunner/durations-merge", test_durations_merge);
+  g_test_add_func ("/Foundry/TestRunner/passed", test_passed);
+  g_test_add_func ("/Foundry/TestRunner/timeout", test_timeout);
+  g_test_add_func ("/Foundry/TestRunner/junit", test_junit);
+  return g_test_run ();
+}
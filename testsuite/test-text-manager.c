@@ -0,0 +1,345 @@
+/* test-text-manager.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#include <foundry.h>
+
+#include "test-util.h"
+
+#define N_FILES 250
+
+#define OLD_CONTENTS "int old_name;\nint other_%03u = old_name + %u;\n"
+#define NEW_CONTENTS "int new_name;\nint other_%03u = new_name + %u;\n"
+
+static char *
+create_project (GPtrArray *files)
+{
+  g_autofree char *tmpdir = g_build_filename (g_get_tmp_dir (), "test-foundry-text-manager-XXXXXX", NULL);
+
+  g_assert_nonnull (g_mkdtemp (tmpdir));
+
+  /* Spread across a few directories like a real rename would be */
+  for (guint i = 0; i < N_FILES; i++)
+    {
+      g_autofree char *dir = g_strdup_printf ("%s/src/dir-%u", tmpdir, i % 5);
+      g_autofree char *path = g_strdup_printf ("%s/file-%03u.c", dir, i);
+      g_autofree char *contents = g_strdup_printf (OLD_CONTENTS, i, i);
+      g_autoptr(GError) error = NULL;
+
+      g_assert_cmpint (g_mkdir_with_parents (dir, 0750), ==, 0);
+      g_file_set_contents (path, contents, -1, &error);
+      g_assert_no_error (error);
+
+      g_ptr_array_add (files, g_file_new_for_path (path));
+    }
+
+  return g_steal_pointer (&tmpdir);
+}
+
+static FoundryContext *
+create_context (const char *tmpdir)
+{
+  g_autoptr(FoundryContext) context = NULL;
+  g_autofree char *foundry_dir = g_build_filename (tmpdir, ".foundry", NULL);
+  g_autoptr(GError) error = NULL;
+
+  context = dex_await_object (foundry_context_new (foundry_dir, tmpdir, FOUNDRY_CONTEXT_FLAGS_CREATE, NULL), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (context);
+
+  return g_steal_pointer (&context);
+}
+
+static GListStore *
+create_rename (GPtrArray *files)
+{
+  GListStore *edits = g_list_store_new (FOUNDRY_TYPE_TEXT_EDIT);
+
+  for (guint i = 0; i < files->len; i++)
+    {
+      GFile *file = g_ptr_array_index (files, i);
+      g_autoptr(FoundryTextEdit) declaration = foundry_text_edit_new (file, 0, 4, 0, 12, "new_name");
+      g_autoptr(FoundryTextEdit) reference = foundry_text_edit_new (file, 1, 16, 1, 24, "new_name");
+
+      /* Out of order on purpose, as language servers do not sort them */
+      g_list_store_append (edits, reference);
+      g_list_store_append (edits, declaration);
+    }
+
+  return edits;
+}
+
+static void
+assert_contents (GPtrArray  *files,
+                 const char *format)
+{
+  for (guint i = 0; i < files->len; i++)
+    {
+      g_autofree char *path = g_file_get_path (g_ptr_array_index (files, i));
+      g_autofree char *expected = g_strdup_printf (format, i, i);
+      g_autofree char *contents = NULL;
+      g_autoptr(GError) error = NULL;
+
+      g_file_get_contents (path, &contents, NULL, &error);
+      g_assert_no_error (error);
+      g_assert_cmpstr (contents, ==, expected);
+    }
+}
+
+static void
+assert_no_backups (FoundryContext *context,
+                   const char     *tmpdir)
+{
+  g_autofree char *tmp_path = foundry_context_tmp_filename (context, NULL);
+  g_autoptr(GDir) tmp_dir = NULL;
+  const char *name;
+
+  for (guint i = 0; i < 5; i++)
+    {
+      g_autofree char *path = g_strdup_printf ("%s/src/dir-%u", tmpdir, i);
+      g_autoptr(GDir) dir = g_dir_open (path, 0, NULL);
+
+      g_assert_nonnull (dir);
+
+      while ((name = g_dir_read_name (dir)))
+        g_assert_false (name[0] == '.');
+    }
+
+  /* The batch's private backup directory must be gone too */
+  if ((tmp_dir = g_dir_open (tmp_path, 0, NULL)))
+    {
+      while ((name = g_dir_read_name (tmp_dir)))
+        g_assert_false (g_str_has_prefix (name, "apply-edits-"));
+    }
+}
+
+static void
+assert_buffer (FoundryTextDocument *document,
+               const char          *expected)
+{
+  g_autoptr(FoundryTextBuffer) buffer = foundry_text_document_dup_buffer (document);
+  g_autoptr(GBytes) bytes = foundry_text_buffer_dup_contents (buffer);
+  g_autofree char *contents = NULL;
+  const char *data;
+  gsize len;
+
+  data = g_bytes_get_data (bytes, &len);
+  contents = g_strndup (data ? data : "", len);
+  g_assert_cmpstr (contents, ==, expected);
+}
+
+static void
+test_apply_edits_rename_fiber (void)
+{
+  g_autoptr(GPtrArray) files = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(FoundryTextManager) text_manager = NULL;
+  g_autoptr(FoundryOperation) operation = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GListStore) edits = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+
+  tmpdir = create_project (files);
+  context = create_context (tmpdir);
+  text_manager = foundry_context_dup_text_manager (context);
+  operation = foundry_operation_new ();
+  edits = create_rename (files);
+
+  dex_await (foundry_text_manager_apply_edits (text_manager, G_LIST_MODEL (edits), operation), &error);
+  g_assert_no_error (error);
+
+  assert_contents (files, NEW_CONTENTS);
+  assert_no_backups (context, tmpdir);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_apply_edits_rename (void)
+{
+  test_from_fiber (test_apply_edits_rename_fiber);
+}
+
+static void
+test_apply_edits_atomic_fiber (void)
+{
+  g_autoptr(GPtrArray) files = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(FoundryTextManager) text_manager = NULL;
+  g_autoptr(FoundryOperation) operation = NULL;
+  g_autoptr(FoundryTextEdit) missing_edit = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GListStore) edits = NULL;
+  g_autoptr(GFile) missing = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *missing_path = NULL;
+
+  tmpdir = create_project (files);
+  context = create_context (tmpdir);
+  text_manager = foundry_context_dup_text_manager (context);
+  operation = foundry_operation_new ();
+  edits = create_rename (files);
+
+  /* One file of the batch cannot be loaded */
+  missing_path = g_build_filename (tmpdir, "src", "dir-0", "missing.c", NULL);
+  missing = g_file_new_for_path (missing_path);
+  missing_edit = foundry_text_edit_new (missing, 0, 4, 0, 12, "new_name");
+  g_list_store_insert (edits, N_FILES, missing_edit);
+
+  dex_await (foundry_text_manager_apply_edits (text_manager, G_LIST_MODEL (edits), operation), &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+
+  /* None of the other files may have been written */
+  assert_contents (files, OLD_CONTENTS);
+  assert_no_backups (context, tmpdir);
+  g_assert_false (g_file_query_exists (missing, NULL));
+
+  dex_await (foundry_context_shutdown (context), NULL);
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_apply_edits_atomic (void)
+{
+  test_from_fiber (test_apply_edits_atomic_fiber);
+}
+
+static void
+set_writable (const char *tmpdir,
+              GPtrArray  *files,
+              gboolean    writable)
+{
+  g_autofree char *dir = g_build_filename (tmpdir, "src", "dir-4", NULL);
+
+  /* GIO writes in place when it cannot create a temporary file, so
+   * both the directory and the files need to be read-only.
+   */
+  for (guint i = 4; i < files->len; i += 5)
+    {
+      g_autofree char *path = g_file_get_path (g_ptr_array_index (files, i));
+
+      g_assert_cmpint (g_chmod (path, writable ? 0640 : 0440), ==, 0);
+    }
+
+  g_assert_cmpint (g_chmod (dir, writable ? 0750 : 0550), ==, 0);
+}
+
+static void
+test_apply_edits_rollback_fiber (void)
+{
+  g_autoptr(GPtrArray) files = g_ptr_array_new_with_free_func (g_object_unref);
+  g_autoptr(FoundryTextManager) text_manager = NULL;
+  g_autoptr(FoundryTextDocument) saved = NULL;
+  g_autoptr(FoundryTextDocument) unsaved = NULL;
+  g_autoptr(FoundryTextDocument) failed = NULL;
+  g_autoptr(FoundryOperation) operation = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GListStore) edits = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *tmpdir = NULL;
+  g_autofree char *expected = NULL;
+
+  /* Permissions do not stop root from writing the files */
+  if (geteuid () == 0)
+    {
+      g_test_skip ("Cannot make a file fail to save as root");
+      return;
+    }
+
+  tmpdir = create_project (files);
+  context = create_context (tmpdir);
+  text_manager = foundry_context_dup_text_manager (context);
+  operation = foundry_operation_new ();
+  edits = create_rename (files);
+
+  /* Keep a few documents open so their buffers can be checked */
+  saved = dex_await_object (foundry_text_manager_load (text_manager, g_ptr_array_index (files, 0), operation, NULL), &error);
+  g_assert_no_error (error);
+  unsaved = dex_await_object (foundry_text_manager_load (text_manager, g_ptr_array_index (files, 1), operation, NULL), &error);
+  g_assert_no_error (error);
+  failed = dex_await_object (foundry_text_manager_load (text_manager, g_ptr_array_index (files, 4), operation, NULL), &error);
+  g_assert_no_error (error);
+
+  /* An unsaved change must survive the rollback */
+  {
+    g_autoptr(FoundryTextBuffer) buffer = foundry_text_document_dup_buffer (unsaved);
+    g_autoptr(FoundryTextEdit) edit = foundry_text_edit_new (g_ptr_array_index (files, 1), 2, 0, 2, 0, "/* unsaved */\n");
+
+    g_assert_true (foundry_text_buffer_apply_edit (buffer, edit));
+  }
+
+  /* Every file in dir-4 fails to save while the others succeed */
+  set_writable (tmpdir, files, FALSE);
+
+  dex_await (foundry_text_manager_apply_edits (text_manager, G_LIST_MODEL (edits), operation), &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED);
+
+  set_writable (tmpdir, files, TRUE);
+
+  /* Both the files and the open buffers are back where they started */
+  assert_contents (files, OLD_CONTENTS);
+  assert_no_backups (context, tmpdir);
+
+  expected = g_strdup_printf (OLD_CONTENTS, 0, 0);
+  assert_buffer (saved, expected);
+  g_clear_pointer (&expected, g_free);
+
+  expected = g_strdup_printf (OLD_CONTENTS "/* unsaved */\n", 1, 1);
+  assert_buffer (unsaved, expected);
+  g_clear_pointer (&expected, g_free);
+
+  expected = g_strdup_printf (OLD_CONTENTS, 4, 4);
+  assert_buffer (failed, expected);
+
+  g_clear_object (&saved);
+  g_clear_object (&unsaved);
+  g_clear_object (&failed);
+
+  dex_await (foundry_context_shutdown (context), NULL);
+
+  rm_rf (tmpdir);
+}
+
+static void
+test_apply_edits_rollback (void)
+{
+  test_from_fiber (test_apply_edits_rollback_fiber);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  dex_init ();
+
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/Foundry/TextManager/apply-edits/rename", test_apply_edits_rename);
+  g_test_add_func ("/Foundry/TextManager/apply-edits/atomic", test_apply_edits_atomic);
+  g_test_add_func ("/Foundry/TextManager/apply-edits/rollback", test_apply_edits_rollback);
+
+  return g_test_run ();
+}
@@ -0,0 +1,266 @@
+/* bench-git-history.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+#include <git2.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "foundry-git-autocleanups.h"
+#include "foundry-git-commit-graph-private.h"
+
+static int n_commits = 100000;
+static int n_files = 1000;
+static char *repository_dir;
+
+static const GOptionEntry entries[] = {
+  { "commits", 'c', 0, G_OPTION_ARG_INT, &n_commits, "Number of commits in the generated repository", "N" },
+  { "files", 'f', 0, G_OPTION_ARG_INT, &n_files, "Number of files touched by the generated commits", "N" },
+  { "repository", 'r', 0, G_OPTION_ARG_FILENAME, &repository_dir, "Use an existing repository instead", "DIR" },
+  { NULL }
+};
+
+static char *
+file_path (guint i)
+{
+  return g_strdup_printf ("src/dir-%02u/sub-%u/file-%04u.c", i % 16, (i / 16) % 8, i);
+}
+
+static void
+run_command (const char  *cwd,
+             GBytes      *stdin_bytes,
+             const char **argv)
+{
+  g_autoptr(GSubprocessLauncher) launcher = NULL;
+  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(GError) error = NULL;
+  GSubprocessFlags flags = G_SUBPROCESS_FLAGS_NONE;
+
+  if (stdin_bytes != NULL)
+    flags |= G_SUBPROCESS_FLAGS_STDIN_PIPE;
+
+  launcher = g_subprocess_launcher_new (flags);
+  g_subprocess_launcher_set_cwd (launcher, cwd);
+
+  if (!(subprocess = g_subprocess_launcher_spawnv (launcher, argv, &error)) ||
+      !g_subprocess_communicate (subprocess, stdin_bytes, NULL, NULL, NULL, &error) ||
+      !g_subprocess_get_successful (subprocess))
+    g_error ("Failed to run %s: %s", argv[0], error ? error->message : "exited with failure");
+}
+
+/* Generates a linear history where every commit touches a single file
+ * so that any one file is changed by roughly n_commits/n_files commits.
+ */
+static char *
+generate_repository (void)
+{
+  g_autofree char *tmpdir = g_build_filename (g_get_tmp_dir (), "bench-git-history-XXXXXX", NULL);
+  g_autoptr(GString) stream = g_string_new (NULL);
+  g_autoptr(GBytes) bytes = NULL;
+  gint64 begin;
+
+  g_assert_nonnull (g_mkdtemp (tmpdir));
+
+  begin = g_get_monotonic_time ();
+
+  for (guint i = 1; i <= (guint)n_commits; i++)
+    {
+      g_autofree char *path = file_path (i % n_files);
+      g_autofree char *message = g_strdup_printf ("Commit %u\n", i);
+      g_autofree char *contents = g_strdup_printf ("int value = %u;\n", i);
+
+      g_string_append (stream, "commit refs/heads/main\n");
+      g_string_append_printf (stream, "mark :%u\n", i);
+      g_string_append_printf (stream, "committer Bench <bench@example.com> %u +0000\n", 1000000000 + i * 60);
+      g_string_append_printf (stream, "data %zu\n%s", strlen (message), message);
+      if (i > 1)
+        g_string_append_printf (stream, "from :%u\n", i - 1);
+      g_string_append_printf (stream, "M 100644 inline %s\n", path);
+      g_string_append_printf (stream, "data %zu\n%s\n", strlen (contents), contents);
+    }
+
+  bytes = g_string_free_to_bytes (g_steal_pointer (&stream));
+
+  run_command (tmpdir, NULL, (const char *[]) { "git", "init", "-q", NULL });
+  run_command (tmpdir, bytes, (const char *[]) { "git", "fast-import", "--quiet", NULL });
+  run_command (tmpdir, NULL, (const char *[]) { "git", "symbolic-ref", "HEAD", "refs/heads/main", NULL });
+
+  g_print ("Generated %d commits in %.3lf s\n",
+           n_commits,
+           (g_get_monotonic_time () - begin) / (double)G_USEC_PER_SEC);
+
+  return g_steal_pointer (&tmpdir);
+}
+
+static guint
+walk_history (git_repository        *repository,
+              FoundryGitCommitGraph *graph,
+              const char            *relative_path,
+              guint                 *n_diffs)
+{
+  g_autoptr(git_revwalk) walker = NULL;
+  git_diff_options diff_opts = GIT_DIFF_OPTIONS_INIT;
+  const char *paths[2] = { relative_path, NULL };
+  git_strarray pathspec = { (char **)paths, 1 };
+  FoundryGitBloomKey key;
+  guint n_matches = 0;
+  git_oid oid;
+
+  *n_diffs = 0;
+
+  diff_opts.pathspec = pathspec;
+  _foundry_git_bloom_key_init (&key, relative_path);
+
+  g_assert_cmpint (git_revwalk_new (&walker, repository), ==, 0);
+  git_revwalk_sorting (walker, GIT_SORT_TIME | GIT_SORT_REVERSE);
+  git_revwalk_push_head (walker);
+
+  while (git_revwalk_next (&oid, walker) == 0)
+    {
+      g_autoptr(git_commit) commit = NULL;
+      g_autoptr(git_commit) parent = NULL;
+      g_autoptr(git_tree) parent_tree = NULL;
+      g_autoptr(git_tree) commit_tree = NULL;
+      g_autoptr(git_diff) diff = NULL;
+      guint position;
+
+      if (graph != NULL &&
+          _foundry_git_commit_graph_lookup (graph, &oid, &position) &&
+          (_foundry_git_commit_graph_get_n_parents (graph, position) == 0 ||
+           !_foundry_git_commit_graph_maybe_changed (graph, position, &key)))
+        continue;
+
+      if (git_commit_lookup (&commit, repository, &oid) != 0 ||
+          git_commit_parentcount (commit) == 0 ||
+          git_commit_parent (&parent, commit, 0) != 0 ||
+          git_commit_tree (&commit_tree, commit) != 0 ||
+          git_commit_tree (&parent_tree, parent) != 0 ||
+          git_diff_tree_to_tree (&diff, repository, parent_tree, commit_tree, &diff_opts) != 0)
+        continue;
+
+      (*n_diffs)++;
+
+      for (gsize i = 0; i < git_diff_num_deltas (diff); i++)
+        {
+          const git_diff_delta *delta = git_diff_get_delta (diff, i);
+
+          if (g_str_equal (delta->new_file.path, relative_path) ||
+              g_str_equal (delta->old_file.path, relative_path))
+            {
+              n_matches++;
+              break;
+            }
+        }
+    }
+
+  return n_matches;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark per-file git history");
+  g_autoptr(FoundryGitCommitGraph) graph = NULL;
+  g_autoptr(FoundryGitCommitGraph) loaded = NULL;
+  g_autoptr(git_repository) repository = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *generated = NULL;
+  g_autofree char *graph_path = NULL;
+  g_autofree char *relative_path = NULL;
+  const char *dir;
+  git_oid head;
+  gint64 begin;
+  guint n_added;
+  guint n_plain;
+  guint n_filtered;
+  guint n_plain_diffs;
+  guint n_filtered_diffs;
+
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (n_commits <= 0 || n_files <= 0)
+    {
+      g_printerr ("Invalid arguments\n");
+      return EXIT_FAILURE;
+    }
+
+  git_libgit2_init ();
+
+  if (repository_dir != NULL)
+    dir = repository_dir;
+  else
+    dir = generated = generate_repository ();
+
+  if (git_repository_open (&repository, dir) != 0 ||
+      git_reference_name_to_id (&head, repository, "HEAD") != 0)
+    g_error ("Failed to open repository at %s", dir);
+
+  graph_path = g_build_filename (g_get_tmp_dir (), "bench-git-history-commit-graph", NULL);
+  relative_path = argc > 1 ? g_strdup (argv[1]) : file_path (0);
+
+  begin = g_get_monotonic_time ();
+  n_plain = walk_history (repository, NULL, relative_path, &n_plain_diffs);
+  g_print ("Diff walk:      %8.3lf s, %u commits for %s, %u diffs\n",
+           (g_get_monotonic_time () - begin) / (double)G_USEC_PER_SEC,
+           n_plain, relative_path, n_plain_diffs);
+
+  begin = g_get_monotonic_time ();
+  graph = _foundry_git_commit_graph_new ();
+  if (!_foundry_git_commit_graph_update (graph, repository, &head, &n_added, &error) ||
+      !_foundry_git_commit_graph_save (graph, graph_path, &error))
+    g_error ("%s", error->message);
+  g_print ("Graph build:    %8.3lf s, %u commits\n",
+           (g_get_monotonic_time () - begin) / (double)G_USEC_PER_SEC,
+           n_added);
+
+  begin = g_get_monotonic_time ();
+  if (!(loaded = _foundry_git_commit_graph_load (graph_path, &error)) ||
+      !_foundry_git_commit_graph_update (loaded, repository, &head, &n_added, &error))
+    g_error ("%s", error->message);
+  g_assert_cmpint (n_added, ==, 0);
+  g_print ("Graph reload:   %8.3lf s, %u commits\n",
+           (g_get_monotonic_time () - begin) / (double)G_USEC_PER_SEC,
+           _foundry_git_commit_graph_get_n_commits (loaded));
+
+  begin = g_get_monotonic_time ();
+  n_filtered = walk_history (repository, loaded, relative_path, &n_filtered_diffs);
+  g_print ("Filtered walk:  %8.3lf s, %u commits for %s, %u diffs\n",
+           (g_get_monotonic_time () - begin) / (double)G_USEC_PER_SEC,
+           n_filtered, relative_path, n_filtered_diffs);
+
+  if (n_plain != n_filtered)
+    g_error ("Filtered walk found %u commits, expected %u", n_filtered, n_plain);
+
+  g_unlink (graph_path);
+
+  if (generated != NULL)
+    run_command (g_get_tmp_dir (), NULL, (const char *[]) { "rm", "-rf", generated, NULL });
+
+  return EXIT_SUCCESS;
+}
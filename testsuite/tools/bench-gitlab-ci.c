@@ -0,0 +1,247 @@
+/* bench-gitlab-ci.c
+ *
+ * Copyright 2026 Christian Hergert
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "../../plugins/gitlab-ci/plugin-gitlab-ci-compiler-private.h"
+#include "../../plugins/gitlab-ci/plugin-gitlab-ci-expression-private.h"
+#include "../../plugins/gitlab-ci/plugin-gitlab-ci-provider.h"
+
+static int n_jobs = 1000;
+static int n_iterations = 20;
+
+static const GOptionEntry entries[] = {
+  { "jobs", 'j', 0, G_OPTION_ARG_INT, &n_jobs, "Number of jobs in the generated pipeline", "N" },
+  { "iterations", 'i', 0, G_OPTION_ARG_INT, &n_iterations, "Number of times to compile the pipeline", "N" },
+  { NULL }
+};
+
+/* Typical `rules:if` found in large monorepo pipelines. Most jobs share
+ * the same handful of expressions and differ only in their variables.
+ */
+static const char *rules[] = {
+  "$CI_PIPELINE_SOURCE == \"merge_request_event\"",
+  "$CI_COMMIT_BRANCH == $CI_DEFAULT_BRANCH && $CI_PIPELINE_SOURCE != \"schedule\"",
+  "$CI_COMMIT_REF_NAME =~ /^release-[0-9]+\\.[0-9]+$/ || $CI_COMMIT_TAG",
+  "($TARGET =~ $TARGET_PATTERN) && $SKIP_TARGET != \"true\"",
+  "$CI_COMMIT_BRANCH =~ /^(main|master|stable\\/.*)$/",
+};
+
+static const char *targets[] = { "x86_64", "aarch64", "i386", "ppc64le", "s390x" };
+
+static JsonNode *
+generate_config (void)
+{
+  g_autoptr(JsonBuilder) builder = json_builder_new ();
+
+  json_builder_begin_object (builder);
+
+  json_builder_set_member_name (builder, "stages");
+  json_builder_begin_array (builder);
+  json_builder_add_string_value (builder, "build");
+  json_builder_add_string_value (builder, "test");
+  json_builder_add_string_value (builder, "deploy");
+  json_builder_end_array (builder);
+
+  json_builder_set_member_name (builder, "variables");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "TARGET_PATTERN");
+  json_builder_add_string_value (builder, "^(x86_64|aarch64)$");
+  json_builder_end_object (builder);
+
+  for (int i = 0; i < n_jobs; i++)
+    {
+      g_autofree char *name = g_strdup_printf ("job-%04d", i);
+
+      json_builder_set_member_name (builder, name);
+      json_builder_begin_object (builder);
+
+      json_builder_set_member_name (builder, "stage");
+      json_builder_add_string_value (builder, i % 3 == 0 ? "build" : i % 3 == 1 ? "test" : "deploy");
+
+      json_builder_set_member_name (builder, "script");
+      json_builder_begin_array (builder);
+      json_builder_add_string_value (builder, "make");
+      json_builder_end_array (builder);
+
+      json_builder_set_member_name (builder, "variables");
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "TARGET");
+      json_builder_add_string_value (builder, targets[i % G_N_ELEMENTS (targets)]);
+      json_builder_set_member_name (builder, "SKIP_TARGET");
+      json_builder_add_string_value (builder, i % 7 == 0 ? "true" : "false");
+      json_builder_end_object (builder);
+
+      json_builder_set_member_name (builder, "rules");
+      json_builder_begin_array (builder);
+
+      for (guint r = 0; r < 3; r++)
+        {
+          json_builder_begin_object (builder);
+          json_builder_set_member_name (builder, "if");
+          json_builder_add_string_value (builder, rules[(i + r) % G_N_ELEMENTS (rules)]);
+          json_builder_end_object (builder);
+        }
+
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "when");
+      json_builder_add_string_value (builder, "manual");
+      json_builder_end_object (builder);
+
+      json_builder_end_array (builder);
+
+      json_builder_end_object (builder);
+    }
+
+  json_builder_end_object (builder);
+
+  return json_builder_get_root (builder);
+}
+
+static PluginGitlabCiContext *
+create_context (void)
+{
+  PluginGitlabCiContext *context = g_new0 (PluginGitlabCiContext, 1);
+
+  g_atomic_ref_count_init (&context->ref_count);
+  context->repository_root = g_strdup ("/nonexistent");
+  context->configuration_path = g_strdup ("/nonexistent/.gitlab-ci.yml");
+  context->server_host = g_strdup ("gitlab.com");
+  context->variables = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  context->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  context->changed_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  g_hash_table_insert (context->variables, g_strdup ("CI"), g_strdup ("true"));
+  g_hash_table_insert (context->variables, g_strdup ("CI_COMMIT_BRANCH"), g_strdup ("main"));
+  g_hash_table_insert (context->variables, g_strdup ("CI_COMMIT_REF_NAME"), g_strdup ("main"));
+  g_hash_table_insert (context->variables, g_strdup ("CI_DEFAULT_BRANCH"), g_strdup ("main"));
+  g_hash_table_insert (context->variables, g_strdup ("CI_PIPELINE_SOURCE"), g_strdup ("push"));
+
+  return context;
+}
+
+static void
+bench_expressions (PluginGitlabCiContext *context)
+{
+  g_autoptr(PluginGitlabCiExpressionCache) cache = plugin_gitlab_ci_expression_cache_new ();
+  g_autoptr(PluginGitlabCiExpression) expression = NULL;
+  g_autoptr(GError) error = NULL;
+  const char *text = rules[2];
+  guint n = n_jobs * 100;
+  gboolean result;
+  gint64 begin;
+  gint64 parse;
+  gint64 evaluate;
+
+  begin = g_get_monotonic_time ();
+
+  for (guint i = 0; i < n; i++)
+    {
+      g_autoptr(PluginGitlabCiExpression) parsed = NULL;
+
+      if (!(parsed = plugin_gitlab_ci_expression_new (text, &error)))
+        g_error ("%s", error->message);
+    }
+
+  parse = g_get_monotonic_time () - begin;
+
+  if (!(expression = plugin_gitlab_ci_expression_new (text, &error)))
+    g_error ("%s", error->message);
+
+  begin = g_get_monotonic_time ();
+
+  for (guint i = 0; i < n; i++)
+    {
+      if (!plugin_gitlab_ci_expression_evaluate (expression, context, cache, &result, &error))
+        g_error ("%s", error->message);
+    }
+
+  evaluate = g_get_monotonic_time () - begin;
+
+  g_print ("Parse (and compile regex): %.3lf µs/expression\n", parse / (double)n);
+  g_print ("Evaluate parsed:           %.3lf µs/expression\n", evaluate / (double)n);
+}
+
+static void
+bench_compile (FoundryCiProvider     *provider,
+               PluginGitlabCiContext *context)
+{
+  g_autoptr(JsonNode) config = generate_config ();
+  gint64 begin;
+  gint64 elapsed;
+  guint n_compiled = 0;
+
+  begin = g_get_monotonic_time ();
+
+  for (int i = 0; i < n_iterations; i++)
+    {
+      g_autoptr(PluginGitlabCiPipeline) pipeline = NULL;
+      g_autoptr(GError) error = NULL;
+
+      if (!(pipeline = plugin_gitlab_ci_compiler_compile (provider, context, config, &error)))
+        g_error ("%s", error->message);
+
+      n_compiled = pipeline->jobs->len;
+    }
+
+  elapsed = g_get_monotonic_time () - begin;
+
+  g_print ("Compiled %u jobs in %.3lf ms (average of %d)\n",
+           n_compiled,
+           elapsed / (double)n_iterations / 1000.,
+           n_iterations);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark GitLab CI pipeline compilation");
+  g_autoptr(PluginGitlabCiContext) ci_context = NULL;
+  g_autoptr(FoundryCiProvider) provider = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (n_jobs <= 0 || n_iterations <= 0)
+    {
+      g_printerr ("Invalid arguments\n");
+      return EXIT_FAILURE;
+    }
+
+  dex_init ();
+  foundry_init ();
+
+  ci_context = create_context ();
+  provider = g_object_new (PLUGIN_TYPE_GITLAB_CI_PROVIDER, NULL);
+
+  bench_expressions (ci_context);
+  bench_compile (provider, ci_context);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,172 @@
+/* bench-jsonrpc.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+
+#include <foundry.h>
+
+#include "foundry-jsonrpc-driver-private.h"
+
+#include "../test-util.h"
+
+static int n_messages = 100000;
+static int n_inflight = 1000;
+static int style = FOUNDRY_JSONRPC_STYLE_HTTP;
+
+static const GOptionEntry entries[] = {
+  { "messages", 'n', 0, G_OPTION_ARG_INT, &n_messages, "Number of messages to send", "N" },
+  { "inflight", 'j', 0, G_OPTION_ARG_INT, &n_inflight, "Number of concurrent calls in flight", "N" },
+  { "style", 's', 0, G_OPTION_ARG_INT, &style, "JSON-RPC framing (1=http, 2=lf, 3=nil)", "STYLE" },
+  { NULL }
+};
+
+static gboolean
+echo_method_call (FoundryJsonrpcDriver *driver,
+                  const char           *method,
+                  JsonNode             *params,
+                  JsonNode             *id,
+                  gpointer              user_data)
+{
+  dex_future_disown (foundry_jsonrpc_driver_reply (driver, id, params));
+  return TRUE;
+}
+
+static GIOStream *
+create_stream (int read_fd,
+               int write_fd)
+{
+  g_autoptr(GInputStream) input = g_unix_input_stream_new (read_fd, TRUE);
+  g_autoptr(GOutputStream) output = g_unix_output_stream_new (write_fd, TRUE);
+
+  return g_simple_io_stream_new (input, output);
+}
+
+static JsonNode *
+create_params (int i)
+{
+  return FOUNDRY_JSON_OBJECT_NEW ("textDocument", "{",
+                                    "uri", FOUNDRY_JSON_NODE_PUT_STRING ("file:///tmp/bench.c"),
+                                  "}",
+                                  "position", "{",
+                                    "line", FOUNDRY_JSON_NODE_PUT_INT (i),
+                                    "character", FOUNDRY_JSON_NODE_PUT_INT (0),
+                                  "}");
+}
+
+static void
+main_fiber (void)
+{
+  g_autoptr(FoundryJsonrpcDriver) client = NULL;
+  g_autoptr(FoundryJsonrpcDriver) server = NULL;
+  g_autoptr(GIOStream) client_stream = NULL;
+  g_autoptr(GIOStream) server_stream = NULL;
+  g_autoptr(GPtrArray) futures = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 begin;
+  gint64 end;
+  int to_server[2];
+  int to_client[2];
+  int sent = 0;
+
+  if (!g_unix_open_pipe (to_server, O_CLOEXEC, &error) ||
+      !g_unix_open_pipe (to_client, O_CLOEXEC, &error))
+    g_error ("%s", error->message);
+
+  client_stream = create_stream (to_client[0], to_server[1]);
+  server_stream = create_stream (to_server[0], to_client[1]);
+
+  client = foundry_jsonrpc_driver_new (client_stream, style);
+  server = foundry_jsonrpc_driver_new (server_stream, style);
+
+  g_signal_connect (server,
+                    "handle-method-call",
+                    G_CALLBACK (echo_method_call),
+                    NULL);
+
+  foundry_jsonrpc_driver_start (client);
+  foundry_jsonrpc_driver_start (server);
+
+  futures = g_ptr_array_new_with_free_func (dex_unref);
+
+  begin = g_get_monotonic_time ();
+
+  while (sent < n_messages)
+    {
+      g_ptr_array_set_size (futures, 0);
+
+      for (int i = 0; i < n_inflight && sent < n_messages; i++, sent++)
+        {
+          g_autoptr(JsonNode) params = create_params (sent);
+
+          g_ptr_array_add (futures,
+                           foundry_jsonrpc_driver_call (client, "textDocument/hover", params));
+        }
+
+      if (!dex_await (dex_future_allv ((DexFuture **)futures->pdata, futures->len), &error))
+        g_error ("%s", error->message);
+    }
+
+  end = g_get_monotonic_time ();
+
+  g_print ("%d round-trips in %.3lf seconds (%.0lf messages/sec)\n",
+           n_messages,
+           (end - begin) / (double)G_USEC_PER_SEC,
+           (n_messages * 2) / ((end - begin) / (double)G_USEC_PER_SEC));
+
+  foundry_jsonrpc_driver_stop (client);
+  foundry_jsonrpc_driver_stop (server);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark JSON-RPC driver throughput");
+  g_autoptr(GError) error = NULL;
+
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (n_messages <= 0 || n_inflight <= 0 ||
+      style < FOUNDRY_JSONRPC_STYLE_HTTP || style > FOUNDRY_JSONRPC_STYLE_NIL)
+    {
+      g_printerr ("Invalid arguments\n");
+      return EXIT_FAILURE;
+    }
+
+  dex_init ();
+
+  test_from_fiber (main_fiber);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/* bench-metrics.c
+ *
+ * Copyright 2026 Christian Hergert <christian@sourceandstack.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <foundry.h>
+
+#include "foundry-metrics-private.h"
+
+static gint64 iterations = 10000000;
+static int n_threads = 4;
+
+static const GOptionEntry entries[] = {
+  { "iterations", 'i', 0, G_OPTION_ARG_INT64, &iterations, "Number of samples per thread", "N" },
+  { "threads", 't', 0, G_OPTION_ARG_INT, &n_threads, "Number of threads for the contended run", "N" },
+  { NULL }
+};
+
+static GMutex start_mutex;
+static GCond start_cond;
+static gboolean started;
+
+static void
+report (const char *name,
+        gint64      elapsed,
+        gint64      n_samples)
+{
+  g_print ("%-24s %.2lf ns/sample (%"G_GINT64_FORMAT" samples in %.3lf seconds)\n",
+           name,
+           elapsed / (double)n_samples,
+           n_samples,
+           elapsed / 1000000000.);
+}
+
+static void
+bench_counter (void)
+{
+  gint64 begin = _foundry_metrics_now ();
+
+  for (gint64 i = 0; i < iterations; i++)
+    FOUNDRY_METRICS_ADD ("bench.counter", 1);
+
+  report ("counter", _foundry_metrics_now () - begin, iterations);
+}
+
+static void
+bench_histogram (void)
+{
+  gint64 begin = _foundry_metrics_now ();
+
+  for (gint64 i = 0; i < iterations; i++)
+    FOUNDRY_METRICS_RECORD ("bench.histogram", i & 0xFFFFF);
+
+  report ("histogram", _foundry_metrics_now () - begin, iterations);
+}
+
+/* Includes reading the monotonic clock twice, which is what every
+ * FOUNDRY_TRACE_SCOPE() pays.
+ */
+static void
+bench_scope (void)
+{
+  gint64 begin = _foundry_metrics_now ();
+
+  for (gint64 i = 0; i < iterations; i++)
+    {
+      FOUNDRY_METRICS_SCOPE ("bench.scope");
+    }
+
+  report ("scope", _foundry_metrics_now () - begin, iterations);
+}
+
+static gpointer
+histogram_thread (gpointer data)
+{
+  g_mutex_lock (&start_mutex);
+  while (!started)
+    g_cond_wait (&start_cond, &start_mutex);
+  g_mutex_unlock (&start_mutex);
+
+  for (gint64 i = 0; i < iterations; i++)
+    FOUNDRY_METRICS_RECORD ("bench.histogram.threads", i & 0xFFFFF);
+
+  return NULL;
+}
+
+static void
+bench_threads (void)
+{
+  g_autofree GThread **threads = g_new0 (GThread *, n_threads);
+  g_autofree char *name = g_strdup_printf ("histogram (%d threads)", n_threads);
+  gint64 begin;
+
+  for (int i = 0; i < n_threads; i++)
+    threads[i] = g_thread_new ("bench", histogram_thread, NULL);
+
+  begin = _foundry_metrics_now ();
+
+  g_mutex_lock (&start_mutex);
+  started = TRUE;
+  g_cond_broadcast (&start_cond);
+  g_mutex_unlock (&start_mutex);
+
+  for (int i = 0; i < n_threads; i++)
+    g_thread_join (threads[i]);
+
+  /* Wall time per sample on each thread, contention shows up as growth */
+  report (name, _foundry_metrics_now () - begin, iterations);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark metrics recording overhead");
+  g_autoptr(GError) error = NULL;
+
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (iterations <= 0 || n_threads <= 0)
+    {
+      g_printerr ("Invalid arguments\n");
+      return EXIT_FAILURE;
+    }
+
+  bench_counter ();
+  bench_histogram ();
+  bench_scope ();
+  bench_threads ();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,270 @@
+/* bench-pty-diagnostics.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <glib-unix.h>
+
+#include <foundry.h>
+
+#include "pty-intercept.h"
+
+#include "../test-util.h"
+
+static char *log_path;
+static int n_lines = 200000;
+static int chunk_size = 4093;
+
+static const GOptionEntry entries[] = {
+  { "log", 'l', 0, G_OPTION_ARG_FILENAME, &log_path, "Replay a captured build log", "FILE" },
+  { "lines", 'n', 0, G_OPTION_ARG_INT, &n_lines, "Number of lines to generate without --log", "N" },
+  { "chunk-size", 'c', 0, G_OPTION_ARG_INT, &chunk_size, "Bytes per write to the PTY", "BYTES" },
+  { NULL }
+};
+
+typedef struct
+{
+  GBytes     *contents;
+  DexPromise *done;
+  int         fd;
+} Writer;
+
+typedef struct
+{
+  gint64 last;
+  gint64 longest;
+} Stall;
+
+/* Roughly what a large meson/ninja build looks like with a diagnostic
+ * every fifty lines, some of which span two writes.
+ */
+static GBytes *
+generate_log (guint *n_expected)
+{
+  GString *str = g_string_new (NULL);
+
+  *n_expected = 0;
+
+  for (int i = 0; i < n_lines; i++)
+    {
+      if (i % 50 == 49)
+        {
+          g_string_append_printf (str,
+                                  "../src/module-%u/file-%u.c:%u:%u: warning: unused variable ‘tmp’ [-Wunused-variable]\n",
+                                  i % 97, i, i % 2000 + 1, i % 80 + 1);
+          (*n_expected)++;
+        }
+      else if (i % 10 == 0)
+        g_string_append_printf (str, "[%u/%u] Compiling C object src/libfoundry.so.p/file-%u.c.o\n", i, n_lines, i);
+      else
+        g_string_append_printf (str, "  %u | static const char *value_%u = \"%u: this is not a diagnostic\";\n", i, i, i);
+    }
+
+  return g_string_free_to_bytes (str);
+}
+
+static gpointer
+writer_thread (gpointer data)
+{
+  Writer *writer = data;
+  const guint8 *buf;
+  gsize len;
+  gsize pos = 0;
+
+  buf = g_bytes_get_data (writer->contents, &len);
+
+  while (pos < len)
+    {
+      gssize n = write (writer->fd, buf + pos, MIN ((gsize)chunk_size, len - pos));
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        break;
+
+      pos += n;
+    }
+
+  dex_promise_resolve_boolean (writer->done, TRUE);
+
+  return NULL;
+}
+
+static gboolean
+drain_cb (int          fd,
+          GIOCondition condition,
+          gpointer     user_data)
+{
+  guint8 buf[8192];
+
+  if (read (fd, buf, sizeof buf) <= 0)
+    return G_SOURCE_REMOVE;
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+stall_cb (gpointer user_data)
+{
+  Stall *stall = user_data;
+  gint64 now = g_get_monotonic_time ();
+
+  if (stall->last > 0)
+    stall->longest = MAX (stall->longest, now - stall->last);
+
+  stall->last = now;
+
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+main_fiber (void)
+{
+  g_autoptr(FoundryPtyDiagnostics) diagnostics = NULL;
+  g_autoptr(FoundryContext) context = NULL;
+  g_autoptr(GBytes) contents = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GThread) thread = NULL;
+  struct termios tios;
+  Writer writer = {0};
+  Stall stall = {0};
+  guint n_expected = 0;
+  guint n_items = 0;
+  guint n_stable = 0;
+  guint stall_source;
+  guint drain_source;
+  gint64 begin;
+  gint64 end;
+  int consumer;
+  int drain;
+
+  if (!(context = dex_await_object (foundry_context_new_for_user (NULL), &error)))
+    g_error ("%s", error->message);
+
+  if (log_path != NULL)
+    {
+      g_autoptr(GMappedFile) mapped = NULL;
+
+      if (!(mapped = g_mapped_file_new (log_path, FALSE, &error)))
+        g_error ("%s", error->message);
+
+      contents = g_mapped_file_get_bytes (mapped);
+    }
+  else
+    {
+      contents = generate_log (&n_expected);
+    }
+
+  /* Our side of the terminal; drain it so the intercept never blocks */
+  if (-1 == (consumer = pty_intercept_create_consumer ()) ||
+      -1 == (drain = pty_intercept_create_producer (consumer, FALSE)))
+    g_error ("Failed to create PTY: %s", g_strerror (errno));
+
+  if (tcgetattr (drain, &tios) == 0)
+    {
+      cfmakeraw (&tios);
+      tcsetattr (drain, TCSANOW, &tios);
+    }
+
+  drain_source = g_unix_fd_add (drain, G_IO_IN, drain_cb, NULL);
+
+  diagnostics = foundry_pty_diagnostics_new (context, consumer);
+
+  writer.contents = contents;
+  writer.done = dex_promise_new ();
+
+  if (-1 == (writer.fd = foundry_pty_diagnostics_create_producer (diagnostics, &error)))
+    g_error ("%s", error->message);
+
+  stall_source = g_timeout_add (1, stall_cb, &stall);
+
+  begin = g_get_monotonic_time ();
+
+  thread = g_thread_new ("writer", writer_thread, &writer);
+  dex_await (dex_ref (DEX_FUTURE (writer.done)), NULL);
+
+  /* Wait for the worker to catch up with everything that was written */
+  while (n_stable < 5 && (n_expected == 0 || n_items < n_expected))
+    {
+      guint n = g_list_model_get_n_items (G_LIST_MODEL (diagnostics));
+
+      n_stable = n == n_items ? n_stable + 1 : 0;
+      n_items = n;
+
+      if (n_expected == 0 || n_items < n_expected)
+        dex_await (dex_timeout_new_msec (20), NULL);
+    }
+
+  end = g_get_monotonic_time ();
+
+  g_source_remove (stall_source);
+  g_source_remove (drain_source);
+
+  g_print ("%"G_GSIZE_FORMAT" bytes, %u diagnostics in %.3lf seconds\n",
+           g_bytes_get_size (contents),
+           n_items,
+           (end - begin) / (double)G_USEC_PER_SEC);
+  g_print ("Longest main loop stall: %.1lf ms\n",
+           stall.longest / 1000.);
+
+  if (n_expected > 0 && n_items != n_expected)
+    g_printerr ("Expected %u diagnostics\n", n_expected);
+
+  close (writer.fd);
+  close (drain);
+  close (consumer);
+
+  g_thread_join (g_steal_pointer (&thread));
+  dex_clear (&writer.done);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark diagnostic extraction from a PTY");
+  g_autoptr(GError) error = NULL;
+
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (n_lines <= 0 || chunk_size <= 0)
+    {
+      g_printerr ("Invalid arguments\n");
+      return EXIT_FAILURE;
+    }
+
+  dex_init ();
+  foundry_init ();
+
+  test_from_fiber (main_fiber);
+
+  return EXIT_SUCCESS;
+}
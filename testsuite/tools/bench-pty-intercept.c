@@ -0,0 +1,248 @@
+/* bench-pty-intercept.c
+ *
+ * Copyright 2025 Christian Hergert <chergert@redhat.com>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of the
+ * License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <gio/gio.h>
+
+#include "pty-intercept.h"
+
+static gint64 size = 1024 * 1024 * 1024;
+static char *mode = NULL;
+
+static const GOptionEntry entries[] = {
+  { "size", 's', 0, G_OPTION_ARG_INT64, &size, "Number of bytes to produce", "BYTES" },
+  { "mode", 'm', 0, G_OPTION_ARG_STRING, &mode, "Which intercept to use (classic, threaded, both)", "MODE" },
+  { NULL }
+};
+
+typedef struct
+{
+  GMainLoop *main_loop;
+  int        fd;
+  gint64     n_read;
+  gint64     end;
+} Drain;
+
+typedef struct
+{
+  guint  n_callbacks;
+  gint64 n_bytes;
+} Callback;
+
+static void
+set_raw (int fd)
+{
+  struct termios tios;
+
+  if (tcgetattr (fd, &tios) == 0)
+    {
+      cfmakeraw (&tios);
+      tcsetattr (fd, TCSANOW, &tios);
+    }
+}
+
+static gboolean
+quit_cb (gpointer data)
+{
+  g_main_loop_quit (data);
+  return G_SOURCE_REMOVE;
+}
+
+/* Read from the far side of the intercept on a thread so that the
+ * drain is never the bottleneck being measured.
+ */
+static gpointer
+drain_thread (gpointer data)
+{
+  Drain *drain = data;
+  guint8 *buf = g_malloc (1024 * 1024);
+
+  while (drain->n_read < size)
+    {
+      gssize n = read (drain->fd, buf, 1024 * 1024);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+        break;
+
+      drain->n_read += n;
+    }
+
+  drain->end = g_get_monotonic_time ();
+
+  g_free (buf);
+
+  g_idle_add_full (G_PRIORITY_DEFAULT,
+                   quit_cb,
+                   g_main_loop_ref (drain->main_loop),
+                   (GDestroyNotify) g_main_loop_unref);
+
+  return NULL;
+}
+
+static void
+intercept_cb (const PtyIntercept     *intercept,
+              const PtyInterceptSide *side,
+              const guint8           *data,
+              gsize                   len,
+              gpointer                user_data)
+{
+  Callback *callback = user_data;
+
+  callback->n_callbacks++;
+  callback->n_bytes += len;
+}
+
+static void
+wait_cb (GObject      *object,
+         GAsyncResult *result,
+         gpointer      user_data)
+{
+  g_autoptr(GMainLoop) main_loop = user_data;
+
+  g_subprocess_wait_finish (G_SUBPROCESS (object), result, NULL);
+
+  /* Give the intercept a moment to flush if the drain is short */
+  g_timeout_add_seconds_full (G_PRIORITY_DEFAULT,
+                              1,
+                              quit_cb,
+                              g_main_loop_ref (main_loop),
+                              (GDestroyNotify) g_main_loop_unref);
+}
+
+static void
+run (gboolean threaded)
+{
+  g_autoptr(GSubprocessLauncher) launcher = NULL;
+  g_autoptr(GSubprocess) subprocess = NULL;
+  g_autoptr(GMainLoop) main_loop = NULL;
+  g_autoptr(GThread) thread = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *command = NULL;
+  PtyIntercept intercept;
+  Callback callback = {0};
+  Drain drain = {0};
+  gint64 begin;
+  double seconds;
+  int consumer;
+  int producer;
+
+  main_loop = g_main_loop_new (NULL, FALSE);
+
+  if (-1 == (consumer = pty_intercept_create_consumer ()) ||
+      -1 == (drain.fd = pty_intercept_create_producer (consumer, TRUE)))
+    g_error ("Failed to create PTY: %s", g_strerror (errno));
+
+  set_raw (drain.fd);
+
+  if (threaded)
+    {
+      if (!pty_intercept_init_threaded (&intercept, consumer, NULL))
+        g_error ("Failed to create threaded intercept");
+    }
+  else
+    {
+      if (!pty_intercept_init (&intercept, consumer, NULL))
+        g_error ("Failed to create intercept");
+    }
+
+  pty_intercept_set_callback (&intercept, &intercept.consumer, intercept_cb, &callback);
+
+  if (-1 == (producer = pty_intercept_create_producer (pty_intercept_get_fd (&intercept), TRUE)))
+    g_error ("Failed to create PTY: %s", g_strerror (errno));
+
+  set_raw (producer);
+
+  command = g_strdup_printf ("yes | head -c %"G_GINT64_FORMAT, size);
+
+  launcher = g_subprocess_launcher_new (0);
+  g_subprocess_launcher_take_stdout_fd (launcher, producer);
+
+  drain.main_loop = main_loop;
+
+  begin = g_get_monotonic_time ();
+
+  thread = g_thread_new ("drain", drain_thread, &drain);
+
+  if (!(subprocess = g_subprocess_launcher_spawn (launcher, &error, "/bin/sh", "-c", command, NULL)))
+    g_error ("%s", error->message);
+
+  g_clear_object (&launcher);
+
+  g_subprocess_wait_async (subprocess, NULL, wait_cb, g_main_loop_ref (main_loop));
+  g_main_loop_run (main_loop);
+
+  /* Unblock the drain thread if the intercept gave up early */
+  pty_intercept_clear (&intercept);
+  close (consumer);
+
+  g_thread_join (g_steal_pointer (&thread));
+  close (drain.fd);
+
+  seconds = (drain.end - begin) / (double)G_USEC_PER_SEC;
+
+  g_print ("%-9s %"G_GINT64_FORMAT" bytes in %.3lf seconds (%.1lf MB/s), %u callbacks\n",
+           threaded ? "threaded" : "classic",
+           drain.n_read,
+           seconds,
+           drain.n_read / seconds / (1024. * 1024.),
+           callback.n_callbacks);
+
+  if (drain.n_read != size)
+    g_printerr ("Expected %"G_GINT64_FORMAT" bytes\n", size);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_autoptr(GOptionContext) context = g_option_context_new ("- benchmark PTY intercept throughput");
+  g_autoptr(GError) error = NULL;
+
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (size <= 0 ||
+      (mode != NULL && !g_strv_contains ((const char * const []) {"classic", "threaded", "both", NULL}, mode)))
+    {
+      g_printerr ("Invalid arguments\n");
+      return EXIT_FAILURE;
+    }
+
+  if (mode == NULL || g_str_equal (mode, "classic") || g_str_equal (mode, "both"))
+    run (FALSE);
+
+  if (mode == NULL || g_str_equal (mode, "threaded") || g_str_equal (mode, "both"))
+    run (TRUE);
+
+  return EXIT_SUCCESS;
+}
@@ -20,10 +20,17 @@
 
 #include "config.h"
 
+#include <stdio.h>
+#include <unistd.h>
+
 #include <glib/gi18n.h>
+#include <glib/gstdio.h>
 
 #include "foundry.h"
 
+#include "foundry-gir-data-private.h"
+#include "foundry-gir-node-private.h"
+
 #include "../test-util.h"
 
 static void
@@ -117,6 +124,130 @@ print_namespace_summary (FoundryGirNode *namespace)
 
 static int argc;
 static char **argv;
+static gboolean benchmark;
+static int iterations = 10;
+
+static const GOptionEntry entries[] = {
+  { "benchmark", 'b', 0, G_OPTION_ARG_NONE, &benchmark, "Compare parsing against loading from the cache" },
+  { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Number of iterations to run", "N" },
+  { NULL }
+};
+
+static gsize
+get_rss (void)
+{
+  g_autofree char *contents = NULL;
+  gsize size = 0;
+  gsize resident = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+    sscanf (contents, "%" G_GSIZE_FORMAT " %" G_GSIZE_FORMAT, &size, &resident);
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+static guint
+walk (FoundryGirNode *node)
+{
+  guint count = 1;
+
+  foundry_gir_node_get_name (node);
+  foundry_gir_node_get_content (node);
+
+  for (const GList *iter = foundry_gir_node_get_children (node); iter; iter = iter->next)
+    count += walk (iter->data);
+
+  return count;
+}
+
+static void
+benchmark_file (const char *path)
+{
+  g_autoptr(FoundryGirData) data = NULL;
+  g_autoptr(FoundryGirNode) root = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *contents = NULL;
+  g_autofree char *cache_path = NULL;
+  gint64 parse_usec = 0;
+  gint64 load_usec = 0;
+  gint64 walk_usec;
+  gint64 begin;
+  gsize rss_before;
+  gsize rss_after;
+  gsize len;
+  guint n_visited;
+
+  if (!g_file_get_contents (path, &contents, &len, &error))
+    {
+      g_printerr ("failed to read %s: %s\n", path, error->message);
+      exit (EXIT_FAILURE);
+    }
+
+  bytes = g_bytes_new_take (g_steal_pointer (&contents), len);
+
+  for (int i = 0; i < iterations; i++)
+    {
+      g_autoptr(FoundryGirData) parsed = NULL;
+
+      begin = g_get_monotonic_time ();
+      parsed = _foundry_gir_data_parse (bytes, 0, len, &error);
+      parse_usec += g_get_monotonic_time () - begin;
+
+      if (parsed == NULL)
+        {
+          g_printerr ("failed to parse %s: %s\n", path, error->message);
+          exit (EXIT_FAILURE);
+        }
+
+      g_clear_pointer (&data, _foundry_gir_data_unref);
+      data = g_steal_pointer (&parsed);
+    }
+
+  cache_path = g_build_filename (g_get_tmp_dir (), "gir-dump-XXXXXX.cache", NULL);
+  g_close (g_mkstemp (cache_path), NULL);
+
+  if (!_foundry_gir_data_save (data, cache_path, &error))
+    {
+      g_printerr ("failed to save %s: %s\n", cache_path, error->message);
+      exit (EXIT_FAILURE);
+    }
+
+  for (int i = 0; i < iterations; i++)
+    {
+      g_autoptr(FoundryGirData) loaded = NULL;
+
+      begin = g_get_monotonic_time ();
+      loaded = _foundry_gir_data_load (cache_path, 0, len, &error);
+      load_usec += g_get_monotonic_time () - begin;
+
+      if (loaded == NULL)
+        {
+          g_printerr ("failed to load %s: %s\n", cache_path, error->message);
+          exit (EXIT_FAILURE);
+        }
+    }
+
+  g_unlink (cache_path);
+
+  /* Creating every node is the worst case for the lazy views */
+  rss_before = get_rss ();
+  begin = g_get_monotonic_time ();
+  root = _foundry_gir_node_new_for_data (data, 0, NULL);
+  n_visited = walk (root);
+  walk_usec = g_get_monotonic_time () - begin;
+  rss_after = get_rss ();
+
+  g_print ("File: %s\n", path);
+  g_print ("  Source:        %" G_GSIZE_FORMAT " bytes\n", len);
+  g_print ("  Nodes:         %u\n", _foundry_gir_data_get_n_nodes (data));
+  g_print ("  Arena:         %" G_GSIZE_FORMAT " bytes\n", _foundry_gir_data_get_size (data));
+  g_print ("  Parse:         %.3lf ms\n", parse_usec / 1000.0 / iterations);
+  g_print ("  Cached load:   %.3lf ms\n", load_usec / 1000.0 / iterations);
+  g_print ("  Full walk:     %.3lf ms (%u nodes)\n", walk_usec / 1000.0, n_visited);
+  g_print ("  Walk RSS:      %" G_GSIZE_FORMAT " KiB\n", (rss_after - MIN (rss_before, rss_after)) / 1024);
+  g_print ("\n");
+}
 
 static void
 main_fiber (void)
@@ -125,10 +256,17 @@ main_fiber (void)
 
   if (argc < 2)
     {
-      g_printerr ("usage: %s GIR_FILE...\n", argv[0]);
+      g_printerr ("usage: %s [--benchmark] [--iterations=N] GIR_FILE...\n", argv[0]);
       exit (EXIT_FAILURE);
     }
 
+  if (benchmark)
+    {
+      for (int i = 1; i < argc; i++)
+        benchmark_file (argv[i]);
+      return;
+    }
+
   futures = g_ptr_array_new_with_free_func (dex_unref);
 
   for (int i = 1; i < argc; i++)
@@ -182,8 +320,22 @@ int
 main (int    real_argc,
       char **real_argv)
 {
+  g_autoptr(GOptionContext) context = g_option_context_new ("GIR_FILE...");
+  g_autoptr(GError) error = NULL;
+
   dex_init ();
 
+  g_option_context_add_main_entries (context, entries, NULL);
+
+  if (!g_option_context_parse (context, &real_argc, &real_argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  if (iterations < 1)
+    iterations = 1;
+
   argc = real_argc;
   argv = real_argv;
 